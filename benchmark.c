@@ -0,0 +1,449 @@
+/* Benchmark for the UTF-8 functions in main.c.
+ *
+ * Times every public function on generated corpora (pure ASCII, Latin-1 heavy, CJK, emoji heavy,
+ * mixed, and mixed with invalid bytes sprinkled in) at sizes from 64 bytes up to 1 GB, and prints
+ * one JSON object per measurement with ns/byte, GB/s and cycles/byte (time stamp counter cycles,
+ * null where there is none).
+ *
+ * Usage: utf8_benchmark [max_size_in_bytes]   (default 1073741824)
+ * Each size needs about fifteen times its size in memory, so the 1 GB step needs about 15 GB.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "my_utf8.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+
+#define BENCH_MIN_SECONDS 0.2 // every measurement is a batch of calls that took at least this long
+
+// Small deterministic generator so every run measures the same corpora
+static uint64_t benchState = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t bench_random(void) {
+    benchState ^= benchState << 13;
+    benchState ^= benchState >> 7;
+    benchState ^= benchState << 17;
+    return (uint32_t)(benchState >> 32);
+}
+
+// Writes one code point as UTF-8 and returns its length
+static size_t bench_put(uint32_t codePoint, uint8_t *out) {
+    if (codePoint < 0x80) {
+        out[0] = (uint8_t)codePoint;
+        return 1;
+    } else if (codePoint < 0x800) {
+        out[0] = (uint8_t)(0xC0 | (codePoint >> 6));
+        out[1] = (uint8_t)(0x80 | (codePoint & 0x3F));
+        return 2;
+    } else if (codePoint < 0x10000) {
+        out[0] = (uint8_t)(0xE0 | (codePoint >> 12));
+        out[1] = (uint8_t)(0x80 | ((codePoint >> 6) & 0x3F));
+        out[2] = (uint8_t)(0x80 | (codePoint & 0x3F));
+        return 3;
+    }
+    out[0] = (uint8_t)(0xF0 | (codePoint >> 18));
+    out[1] = (uint8_t)(0x80 | ((codePoint >> 12) & 0x3F));
+    out[2] = (uint8_t)(0x80 | ((codePoint >> 6) & 0x3F));
+    out[3] = (uint8_t)(0x80 | (codePoint & 0x3F));
+    return 4;
+}
+
+enum bench_corpus {
+    CORPUS_ASCII,
+    CORPUS_LATIN1,
+    CORPUS_CJK,
+    CORPUS_EMOJI,
+    CORPUS_MIXED,
+    CORPUS_INVALID,
+    CORPUS_COUNT
+};
+
+static const char *corpusNames[CORPUS_COUNT] = {"ascii", "latin1", "cjk", "emoji", "mixed", "invalid"};
+
+// Picks the next character of a corpus: text-like, with a space every few characters
+static uint32_t bench_character(enum bench_corpus corpus) {
+    uint32_t r = bench_random();
+    if (r % 7 == 0) {
+        return ' ';
+    }
+    r >>= 3;
+    switch (corpus) {
+        case CORPUS_ASCII:
+            return 'a' + r % 26;
+        case CORPUS_LATIN1:
+            return (r & 1) ? 'a' + (r >> 1) % 26 : 0xC0 + (r >> 1) % 0x40; // half accented letters
+        case CORPUS_CJK:
+            return (r % 10 == 0) ? ',' : 0x4E00 + r % 0x5200;
+        case CORPUS_EMOJI:
+            return (r % 4 == 0) ? 'a' + r % 26 : 0x1F300 + r % 0x700;
+        default:
+            // mixed: every encoded length
+            switch (r & 3) {
+                case 0:
+                    return 'a' + (r >> 2) % 26;
+                case 1:
+                    return 0xC0 + (r >> 2) % 0x40;
+                case 2:
+                    return 0x4E00 + (r >> 2) % 0x5200;
+                default:
+                    return 0x1F300 + (r >> 2) % 0x700;
+            }
+    }
+}
+
+// Fills buf with exactly len bytes of the corpus (whole characters, padded with spaces)
+static void bench_generate(enum bench_corpus corpus, uint8_t *buf, size_t len) {
+    size_t pos = 0;
+    uint8_t character[4];
+    while (pos < len) {
+        size_t n = bench_put(bench_character(corpus), character);
+        if (n > len - pos) {
+            memset(buf + pos, ' ', len - pos);
+            break;
+        }
+        memcpy(buf + pos, character, n);
+        pos += n;
+    }
+    if (corpus == CORPUS_INVALID) {
+        // one bad byte (invalid lead, stray continuation or truncated lead) about every 1000 bytes
+        static const uint8_t bad[] = {0xFF, 0x80, 0xE4};
+        for (size_t i = bench_random() % 1000; i < len; i += 500 + bench_random() % 1000) {
+            buf[i] = bad[bench_random() % 3];
+        }
+    }
+}
+
+static double bench_now(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static uint64_t bench_cycles(void) {
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Everything a measured function may need
+typedef struct bench_input {
+    const uint8_t *buf;
+    size_t len;
+    const uint8_t *copy;    // same bytes in another buffer, for strcmp
+    const uint8_t *upper;   // the same with the ASCII letters in upper case, for strcasecmp
+    const uint8_t *escaped; // the corpus run through decode, for encode
+    size_t escapedLength;
+    const uint16_t *utf16;  // the corpus as UTF-16LE (up to its first error), for the UTF-16 to UTF-8 direction
+    size_t utf16Length;
+    const uint32_t *utf32;  // the corpus as code points (up to its first error), for the UTF-32 to UTF-8 direction
+    size_t utf32Length;
+    size_t characters;
+    uint8_t *output;        // big enough for any output
+    const int32_t *offsets; // the corpus cut into rows of 4 to 20 bytes, as a string column
+    size_t rows;
+} bench_input;
+
+// Result sink, so the compiler cannot drop the calls
+static volatile size_t benchSink;
+
+static void run_check(const bench_input *in) {
+    benchSink += (size_t)my_utf8_check_n(in->buf, in->len);
+}
+
+static void run_check_all(const bench_input *in) {
+    benchSink += my_utf8_check_all(in->buf, in->len, NULL, 0);
+}
+
+static void run_repair(const bench_input *in) {
+    size_t written;
+    my_utf8_repair(in->buf, in->len, in->output, 4 * in->len, &written, NULL);
+    benchSink += written;
+}
+
+static void run_check_parallel(const bench_input *in) {
+    benchSink += (size_t)my_utf8_check_parallel(in->buf, in->len, 0, NULL);
+}
+
+static void run_strlen(const bench_input *in) {
+    benchSink += my_utf8_strlen_n(in->buf, in->len);
+}
+
+static void run_strlen_parallel(const bench_input *in) {
+    benchSink += my_utf8_strlen_parallel(in->buf, in->len, 0);
+}
+
+static void run_decode(const bench_input *in) {
+    benchSink += my_utf8_decode_n(in->buf, in->len, in->output);
+}
+
+static void run_encode(const bench_input *in) {
+    benchSink += my_utf8_encode_n(in->escaped, in->escapedLength, in->output);
+}
+
+static void run_to_utf16(const bench_input *in) {
+    my_utf8_transcode_result result;
+    my_utf8_to_utf16(in->buf, in->len, (uint16_t *)in->output, MY_UTF16_LE, &result);
+    benchSink += result.written;
+}
+
+static void run_from_utf16(const bench_input *in) {
+    my_utf8_transcode_result result;
+    my_utf8_from_utf16(in->utf16, in->utf16Length, MY_UTF16_LE, in->output, &result);
+    benchSink += result.written;
+}
+
+static void run_to_utf32(const bench_input *in) {
+    my_utf8_transcode_result result;
+    my_utf8_to_utf32(in->buf, in->len, (uint32_t *)in->output, &result);
+    benchSink += result.written;
+}
+
+static void run_from_utf32(const bench_input *in) {
+    my_utf8_transcode_result result;
+    my_utf8_from_utf32(in->utf32, in->utf32Length, in->output, &result);
+    benchSink += result.written;
+}
+
+static void run_is_normalized(const bench_input *in) {
+    benchSink += (size_t)my_utf8_is_normalized(in->buf, in->len, MY_UTF8_NFC);
+}
+
+static void run_normalize(const bench_input *in) {
+    size_t written;
+    my_utf8_normalize(in->buf, in->len, MY_UTF8_NFC, in->output, 4 * in->len, &written);
+    benchSink += written;
+}
+
+static void run_casefold(const bench_input *in) {
+    size_t written;
+    my_utf8_casefold(in->buf, in->len, MY_UTF8_FOLD_FULL, in->output, 4 * in->len, &written);
+    benchSink += written;
+}
+
+static void run_strcasecmp(const bench_input *in) {
+    benchSink += (size_t)my_utf8_strcasecmp(in->buf, in->len, in->upper, in->len, MY_UTF8_FOLD_FULL);
+}
+
+static void run_casefold_hash(const bench_input *in) {
+    benchSink += (size_t)my_utf8_casefold_hash(in->buf, in->len, MY_UTF8_FOLD_FULL);
+}
+
+static void run_grapheme_count(const bench_input *in) {
+    benchSink += my_utf8_grapheme_count(in->buf, in->len);
+}
+
+static void run_longest_sequence(const bench_input *in) {
+    my_utf8_run longest;
+    benchSink += (size_t)my_utf8_longest_sequence_n(in->buf, in->len, &longest) + longest.bytes;
+}
+
+static void run_charat(const bench_input *in) {
+    // the last character, so the whole string is walked
+    benchSink += (size_t)my_utf8_charat_n(in->buf, in->len, in->characters - 1);
+}
+
+static void run_strcmp(const bench_input *in) {
+    benchSink += (size_t)my_utf8_strcmp_n(in->buf, in->len, in->copy, in->len);
+}
+
+static void run_strcmp_checked(const bench_input *in) {
+    int status;
+    benchSink += (size_t)my_utf8_strcmp_checked(in->buf, in->len, in->copy, in->len, &status);
+}
+
+static void run_substring(const bench_input *in) {
+    benchSink += my_utf8_substring_n(in->buf, in->len, in->characters / 4, in->characters / 2, in->output);
+}
+
+static void run_substring_view(const bench_input *in) {
+    my_utf8_view view = my_utf8_substring_view_n(in->buf, in->len, in->characters / 4, in->characters / 2);
+    benchSink += view.bytes;
+}
+
+static void run_check_batch(const bench_input *in) {
+    benchSink += my_utf8_check_batch(in->buf, in->offsets, in->rows, in->output + 2 * in->len, (int32_t *)in->output);
+}
+
+// what the batch replaces: a check and a count per row
+static void run_check_rows(const bench_input *in) {
+    for (size_t r = 0; r < in->rows; r++) {
+        const uint8_t *row = in->buf + in->offsets[r];
+        size_t rowLength = (size_t)(in->offsets[r + 1] - in->offsets[r]);
+        benchSink += (size_t)my_utf8_check_n(row, rowLength) + my_utf8_strlen_n(row, rowLength);
+    }
+}
+
+static void run_index(const bench_input *in) {
+    // build the index and look up a character near the end
+    my_utf8_index index;
+    my_utf8_index_init(&index, in->buf, in->len, 0);
+    benchSink += (size_t)my_utf8_index_charat(&index, in->characters - 1);
+    my_utf8_index_free(&index);
+}
+
+typedef struct bench_function {
+    const char *name;
+    void (*run)(const bench_input *);
+    int escapedInput; // measured on the escaped text rather than on the corpus
+    int utf16Input;   // measured on the UTF-16 text
+    int utf32Input;   // measured on the code points
+} bench_function;
+
+static const bench_function benchFunctions[] = {
+        {"my_utf8_check_n", run_check, 0, 0, 0},
+        {"my_utf8_check_all", run_check_all, 0, 0, 0},
+        {"my_utf8_check_parallel", run_check_parallel, 0, 0, 0},
+        {"my_utf8_repair", run_repair, 0, 0, 0},
+        {"my_utf8_strlen_n", run_strlen, 0, 0, 0},
+        {"my_utf8_strlen_parallel", run_strlen_parallel, 0, 0, 0},
+        {"my_utf8_decode_n", run_decode, 0, 0, 0},
+        {"my_utf8_encode_n", run_encode, 1, 0, 0},
+        {"my_utf8_to_utf16", run_to_utf16, 0, 0, 0},
+        {"my_utf8_from_utf16", run_from_utf16, 0, 1, 0},
+        {"my_utf8_to_utf32", run_to_utf32, 0, 0, 0},
+        {"my_utf8_from_utf32", run_from_utf32, 0, 0, 1},
+        {"my_utf8_is_normalized", run_is_normalized, 0, 0, 0},
+        {"my_utf8_normalize", run_normalize, 0, 0, 0},
+        {"my_utf8_casefold", run_casefold, 0, 0, 0},
+        {"my_utf8_strcasecmp", run_strcasecmp, 0, 0, 0},
+        {"my_utf8_casefold_hash", run_casefold_hash, 0, 0, 0},
+        {"my_utf8_grapheme_count", run_grapheme_count, 0, 0, 0},
+        {"my_utf8_longest_sequence_n", run_longest_sequence, 0, 0, 0},
+        {"my_utf8_charat_n", run_charat, 0, 0, 0},
+        {"my_utf8_strcmp_n", run_strcmp, 0, 0, 0},
+        {"my_utf8_strcmp_checked", run_strcmp_checked, 0, 0, 0},
+        {"my_utf8_substring_n", run_substring, 0, 0, 0},
+        {"my_utf8_substring_view_n", run_substring_view, 0, 0, 0},
+        {"my_utf8_index", run_index, 0, 0, 0},
+        {"my_utf8_check_batch", run_check_batch, 0, 0, 0},
+        {"my_utf8_check_n+strlen_n per row", run_check_rows, 0, 0, 0}
+};
+
+// Times one function on one input and prints the JSON line
+static void bench_measure(const bench_function *function, const char *corpus, const bench_input *in, int *first) {
+    size_t bytes = function->escapedInput ? in->escapedLength
+                 : function->utf16Input   ? 2 * in->utf16Length
+                 : function->utf32Input   ? 4 * in->utf32Length
+                                          : in->len;
+    // the clock is only read around a whole batch of calls, so reading it costs nothing per call;
+    // the batch doubles until one takes long enough, and only that batch is reported
+    size_t iterations = 1;
+    double elapsed;
+    uint64_t cycles;
+    for (;;) {
+        double start = bench_now();
+        uint64_t startCycles = bench_cycles();
+        for (size_t i = 0; i < iterations; i++) {
+            function->run(in);
+        }
+        cycles = bench_cycles() - startCycles;
+        elapsed = bench_now() - start;
+        if (elapsed >= BENCH_MIN_SECONDS) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    double totalBytes = (double)bytes * (double)iterations;
+    printf("%s\n  {\"corpus\": \"%s\", \"function\": \"%s\", \"bytes\": %zu, \"iterations\": %zu, "
+           "\"ns_per_byte\": %.4f, \"gb_per_s\": %.3f, \"cycles_per_byte\": ",
+           *first ? "" : ",", corpus, function->name, bytes, iterations,
+           elapsed * 1e9 / totalBytes, totalBytes / elapsed / 1e9);
+#ifdef BENCH_HAVE_TSC
+    printf("%.4f}", (double)cycles / totalBytes);
+#else
+    (void)cycles;
+    printf("null}");
+#endif
+    fflush(stdout);
+    *first = 0;
+}
+
+int main(int argc, char *argv[]) {
+    size_t maxSize = (size_t)1 << 30;
+    if (argc > 1) {
+        maxSize = (size_t)strtoull(argv[1], NULL, 10);
+    }
+
+    int first = 1;
+    printf("[");
+    for (size_t size = 64; size <= maxSize; size *= 16) {
+        uint8_t *buf = malloc(size);
+        uint8_t *copy = malloc(size);
+        uint8_t *upper = malloc(size);
+        uint8_t *escaped = malloc(size);
+        uint16_t *utf16 = malloc(size * sizeof(uint16_t));
+        uint32_t *utf32 = malloc(size * sizeof(uint32_t));
+        uint8_t *output = malloc(4 * size); // at most one code point (four bytes) per input byte
+        int32_t *offsets = malloc((size / 4 + 2) * sizeof(int32_t));
+        if (buf == NULL || copy == NULL || upper == NULL || escaped == NULL || utf16 == NULL || utf32 == NULL ||
+            output == NULL || offsets == NULL) {
+            fprintf(stderr, "skipping %zu bytes: out of memory\n", size);
+            free(buf);
+            free(copy);
+            free(upper);
+            free(escaped);
+            free(utf16);
+            free(utf32);
+            free(output);
+            free(offsets);
+            break;
+        }
+        for (int corpus = 0; corpus < CORPUS_COUNT; corpus++) {
+            bench_generate((enum bench_corpus)corpus, buf, size);
+            memcpy(copy, buf, size);
+            for (size_t i = 0; i < size; i++) {
+                upper[i] = (buf[i] >= 'a' && buf[i] <= 'z') ? (uint8_t)(buf[i] - 32) : buf[i];
+            }
+            bench_input in = {buf, size, copy, upper, escaped, 0, utf16, 0, utf32, 0, my_utf8_strlen_n(buf, size),
+                              output, offsets, 0};
+            // encode input: the first third of the corpus decoded to escapes, which fits in 'size' bytes
+            size_t prefix = size / 3;
+            while (prefix > 0 && (buf[prefix] & 0xC0) == 0x80) {
+                prefix--;
+            }
+            in.escapedLength = my_utf8_decode_n(buf, prefix, escaped);
+            my_utf8_transcode_result converted;
+            my_utf8_to_utf16(buf, size, utf16, MY_UTF16_LE, &converted);
+            in.utf16Length = converted.written;
+            my_utf8_to_utf32(buf, size, utf32, &converted);
+            in.utf32Length = converted.written;
+            // string column: rows end in front of a character, 4 to 20 bytes apart
+            size_t rows = 0;
+            offsets[0] = 0;
+            for (size_t end = 4 + bench_random() % 17; end < size; end += 4 + bench_random() % 17) {
+                while (end < size && (buf[end] & 0xC0) == 0x80) {
+                    end++;
+                }
+                offsets[++rows] = (int32_t)end;
+            }
+            offsets[++rows] = (int32_t)size;
+            in.rows = rows;
+            for (size_t f = 0; f < sizeof(benchFunctions) / sizeof(benchFunctions[0]); f++) {
+                bench_measure(&benchFunctions[f], corpusNames[corpus], &in, &first);
+            }
+        }
+        free(buf);
+        free(copy);
+        free(upper);
+        free(escaped);
+        free(utf16);
+        free(utf32);
+        free(output);
+        free(offsets);
+        if (size > maxSize / 16) {
+            break; // the next step would overflow or pass the limit
+        }
+    }
+    printf("\n]\n");
+    return 0;
+}
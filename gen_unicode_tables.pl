@@ -0,0 +1,241 @@
+#!/usr/bin/perl
+# Generates unicode_tables.h, the Unicode property tables main.c needs, from the Unicode character
+# database that ships with Perl (Unicode::UCD and Unicode::Normalize), so no data files have to be
+# downloaded. The Unicode version is the one of the Perl used; it is recorded in the output.
+#
+# Usage: perl gen_unicode_tables.pl [output file]   (default unicode_tables.h)
+use strict;
+use warnings;
+use Unicode::UCD qw(all_casefolds prop_invmap prop_invlist);
+use Unicode::Normalize qw(NFD NFKD getCombinClass isComp_Ex
+                          isNFD_NO isNFKD_NO isNFC_NO isNFC_MAYBE isNFKC_NO isNFKC_MAYBE);
+
+my $output = shift // 'unicode_tables.h';
+my $version = Unicode::UCD::UnicodeVersion();
+my $MAX = 0x10FFFF;
+
+# Hangul syllables are decomposed and composed by arithmetic in main.c
+sub is_hangul_syllable { my $cp = shift; return $cp >= 0xAC00 && $cp <= 0xD7A3; }
+
+my @out;
+sub emit { push @out, @_; }
+
+# Writes a C array, 'perLine' values a line
+sub emit_array {
+    my ($type, $name, $values, $perLine, $format) = @_;
+    $format //= '%d';
+    emit("static const $type ${name}[" . scalar(@$values) . "] = {\n");
+    for (my $i = 0; $i < @$values; $i += $perLine) {
+        my $end = $i + $perLine - 1;
+        $end = $#$values if $end > $#$values;
+        my $line = join(', ', map { sprintf($format, $_) } @{$values}[$i .. $end]);
+        emit("        $line" . ($end < $#$values ? ",\n" : "\n"));
+    }
+    emit("};\n\n");
+}
+
+# Splits a per-code-point value array into a two-level table: stage1[cp >> shift] picks a block,
+# stage2[(block << shift) | (cp & mask)] is the value. Identical blocks are stored once, and stage1
+# stops after the last block that is not all default values (lookups past it use block 0).
+sub two_level {
+    my ($values, $shift) = @_;
+    my $blockSize = 1 << $shift;
+    my (%blockIds, @stage1, @stage2);
+    my $default = join(',', ($values->[$MAX]) x $blockSize);
+    $blockIds{$default} = 0;
+    push @stage2, ($values->[$MAX]) x $blockSize;
+    my $last = 0;
+    for (my $start = 0; $start <= $MAX; $start += $blockSize) {
+        my @block = @{$values}[$start .. $start + $blockSize - 1];
+        my $key = join(',', @block);
+        if (!exists $blockIds{$key}) {
+            $blockIds{$key} = scalar(keys %blockIds);
+            push @stage2, @block;
+        }
+        push @stage1, $blockIds{$key};
+        $last = scalar(@stage1) if $blockIds{$key} != 0;
+    }
+    splice(@stage1, $last);
+    return (\@stage1, \@stage2);
+}
+
+emit("/* Generated by gen_unicode_tables.pl from the Unicode $version character database - do not edit,\n");
+emit(" * re-run the script instead. Included by main.c only. */\n");
+emit("#ifndef UNICODE_TABLES_H\n#define UNICODE_TABLES_H\n\n");
+emit("#include <stdint.h>\n\n");
+emit("#define UTF8_UNICODE_VERSION \"$version\"\n\n");
+
+# ---------------------------------------------------------------------------------------------
+# Normalization: canonical combining class and quick check flags per code point, the full
+# decompositions, and the primary composites
+my %flagBits = (NFD_NO => 0x01, NFKD_NO => 0x02, NFC_NO => 0x04, NFC_MAYBE => 0x08, NFKC_NO => 0x10,
+                NFKC_MAYBE => 0x20);
+my (%propIds, @props, @normValues, %firstAffected);
+my (@canonical, @compat, @decompositionData);
+for my $cp (0 .. $MAX) {
+    my $flags = 0;
+    $flags |= $flagBits{NFD_NO} if isNFD_NO($cp);
+    $flags |= $flagBits{NFKD_NO} if isNFKD_NO($cp);
+    $flags |= $flagBits{NFC_NO} if isNFC_NO($cp);
+    $flags |= $flagBits{NFC_MAYBE} if isNFC_MAYBE($cp);
+    $flags |= $flagBits{NFKC_NO} if isNFKC_NO($cp);
+    $flags |= $flagBits{NFKC_MAYBE} if isNFKC_MAYBE($cp);
+    my $ccc = getCombinClass($cp);
+    for my $form (['NFC', 'NFC_NO', 'NFC_MAYBE'], ['NFD', 'NFD_NO'], ['NFKC', 'NFKC_NO', 'NFKC_MAYBE'], ['NFKD', 'NFKD_NO']) {
+        my ($name, @quickCheck) = @$form;
+        my $mask = 0;
+        $mask |= $flagBits{$_} for @quickCheck;
+        $firstAffected{$name} //= $cp if ($flags & $mask) || $ccc != 0;
+    }
+    my $key = $ccc . ',' . $flags;
+    if (!exists $propIds{$key}) {
+        $propIds{$key} = scalar(@props);
+        push @props, $key;
+    }
+    push @normValues, $propIds{$key};
+
+    next if ($flags & ($flagBits{NFD_NO} | $flagBits{NFKD_NO})) == 0 || is_hangul_syllable($cp);
+    my $nfd = NFD(chr($cp));
+    my $nfkd = NFKD(chr($cp));
+    if ($nfd ne chr($cp)) {
+        push @canonical, [$cp, scalar(@decompositionData), length($nfd)];
+        push @decompositionData, map { ord } split //, $nfd;
+    }
+    if ($nfkd ne $nfd) {
+        push @compat, [$cp, scalar(@decompositionData), length($nfkd)];
+        push @decompositionData, map { ord } split //, $nfkd;
+    }
+}
+die "too many normalization property records" if @props > 256;
+
+# Primary composites: canonical decompositions into exactly two code points, less the full composition
+# exclusions
+my @compositions;
+for my $cp (0 .. $MAX) {
+    next if is_hangul_syllable($cp) || !isNFD_NO($cp) || isComp_Ex($cp);
+    my $mapping = Unicode::UCD::charinfo($cp)->{decomposition};
+    next if !defined $mapping || $mapping eq '' || $mapping =~ /</;
+    my @parts = map { hex } split / /, $mapping;
+    next if @parts != 2;
+    push @compositions, [@parts, $cp];
+}
+@compositions = sort { $a->[0] <=> $b->[0] || $a->[1] <=> $b->[1] } @compositions;
+
+my ($normStage1, $normStage2) = two_level(\@normValues, 7);
+emit("// Normalization: utf8_norm_props_table[utf8_norm_stage2[(utf8_norm_stage1[cp >> 7] << 7) | (cp & 127)]]\n");
+emit("// (stage1 ends after the last block that is not all zero; further code points use block 0)\n");
+emit("#define UTF8_NORM_SHIFT 7\n");
+for my $name (sort { $flagBits{$a} <=> $flagBits{$b} } keys %flagBits) {
+    emit(sprintf("#define UTF8_NORM_%s 0x%02X\n", $name, $flagBits{$name}));
+}
+emit("// Below these every code point is \"Yes\" in the quick check of the form and has combining class 0\n");
+for my $name ('NFC', 'NFD', 'NFKC', 'NFKD') {
+    die "main.c expects the first $name code point below U+0800" if $firstAffected{$name} >= 0x800;
+    emit(sprintf("#define UTF8_NORM_%s_FIRST 0x%04X\n", $name, $firstAffected{$name}));
+}
+emit("\ntypedef struct utf8_norm_props {\n    uint8_t ccc;   // canonical combining class\n");
+emit("    uint8_t flags; // UTF8_NORM_* quick check flags\n} utf8_norm_props;\n\n");
+emit("static const utf8_norm_props utf8_norm_props_table[" . scalar(@props) . "] = {\n");
+emit(join(",\n", map { "        {$_}" } @props) . "\n};\n\n");
+emit_array('uint8_t', 'utf8_norm_stage1', $normStage1, 32);
+emit_array('uint8_t', 'utf8_norm_stage2', $normStage2, 32);
+
+emit("// Full decompositions (already recursively decomposed), sorted by code point. The compatibility\n");
+emit("// list only has the code points whose compatibility decomposition differs from the canonical one.\n");
+emit("typedef struct utf8_decomposition {\n    uint32_t codePoint;\n");
+emit("    uint16_t offset; // into utf8_decomposition_data\n    uint16_t length;\n} utf8_decomposition;\n\n");
+for my $list (['utf8_canonical_decompositions', \@canonical], ['utf8_compat_decompositions', \@compat]) {
+    emit("static const utf8_decomposition $list->[0]\[" . scalar(@{$list->[1]}) . "] = {\n");
+    emit(join(",\n", map { sprintf("        {0x%04X, %d, %d}", @$_) } @{$list->[1]}) . "\n};\n\n");
+}
+emit_array('uint32_t', 'utf8_decomposition_data', \@decompositionData, 12, '0x%04X');
+
+emit("// Primary composites, sorted by (first, second)\n");
+emit("typedef struct utf8_composition {\n    uint32_t first;\n    uint32_t second;\n");
+emit("    uint32_t composite;\n} utf8_composition;\n\n");
+emit("static const utf8_composition utf8_compositions[" . scalar(@compositions) . "] = {\n");
+emit(join(",\n", map { sprintf("        {0x%04X, 0x%04X, 0x%04X}", @$_) } @compositions) . "\n};\n\n");
+
+# ---------------------------------------------------------------------------------------------
+# Case folding (CaseFolding.txt statuses C, S and F; the Turkic T mappings are left out): per code
+# point the distance to its simple folding, and the full folding where it is a different string
+my $casefolds = all_casefolds();
+my (%foldIds, @foldRecords, @foldValues, @fullFoldData);
+push @foldRecords, [0, 0, 0];
+$foldIds{'0,'} = 0;
+@foldValues = (0) x ($MAX + 1);
+for my $cp (sort { $a <=> $b } keys %$casefolds) {
+    my $entry = $casefolds->{$cp};
+    my $simple = ($entry->{simple} ne '') ? hex($entry->{simple}) : $cp;
+    my @full = map { hex } split / /, $entry->{full};
+    my $full = (@full == 1 && $full[0] == $simple) ? '' : join(' ', @full);
+    my $key = ($simple - $cp) . ',' . $full;
+    if (!exists $foldIds{$key}) {
+        $foldIds{$key} = scalar(@foldRecords);
+        if ($full eq '') {
+            push @foldRecords, [$simple - $cp, 0, 0];
+        } else {
+            push @foldRecords, [$simple - $cp, scalar(@fullFoldData), scalar(@full)];
+            push @fullFoldData, @full;
+        }
+    }
+    $foldValues[$cp] = $foldIds{$key};
+}
+die "too many case folding records" if @foldRecords > 256;
+
+my ($foldStage1, $foldStage2) = two_level(\@foldValues, 7);
+emit("// Case folding: utf8_fold_records[utf8_fold_stage2[(utf8_fold_stage1[cp >> 7] << 7) | (cp & 127)]]\n");
+emit("// (stage1 ends after the last block with a folding; further code points fold to themselves)\n");
+emit("#define UTF8_FOLD_SHIFT 7\n\n");
+emit("typedef struct utf8_fold_record {\n    int32_t delta;       // simple folding: cp + delta\n");
+emit("    uint16_t fullOffset; // full folding, when it differs from the simple one: utf8_full_fold_data\n");
+emit("    uint16_t fullLength; // 0 when it does not\n} utf8_fold_record;\n\n");
+emit("static const utf8_fold_record utf8_fold_records[" . scalar(@foldRecords) . "] = {\n");
+emit(join(",\n", map { sprintf("        {%d, %d, %d}", @$_) } @foldRecords) . "\n};\n\n");
+emit_array('uint8_t', 'utf8_fold_stage1', $foldStage1, 32);
+emit_array('uint8_t', 'utf8_fold_stage2', $foldStage2, 32);
+emit_array('uint32_t', 'utf8_full_fold_data', \@fullFoldData, 12, '0x%04X');
+
+# ---------------------------------------------------------------------------------------------
+# Grapheme clusters (UAX #29): the Grapheme_Cluster_Break value of every code point in the low bits,
+# with a flag for Extended_Pictographic (emoji ZWJ sequences)
+my @gcbNames = qw(Other CR LF Control Extend ZWJ Regional_Indicator Prepend SpacingMark L V T LV LVT);
+my %gcbIds = map { $gcbNames[$_] => $_ } 0 .. $#gcbNames;
+$gcbIds{ExtPict_XX} = $gcbIds{Other}; # Perl's own name for the pictographic part of Other
+my $pictographic = 0x10;
+my @gcbValues;
+my ($gcbRanges, $gcbMap) = prop_invmap('Grapheme_Cluster_Break');
+for my $i (0 .. $#$gcbRanges) {
+    my $end = ($i < $#$gcbRanges) ? $gcbRanges->[$i + 1] - 1 : $MAX;
+    die "unknown Grapheme_Cluster_Break value $gcbMap->[$i]" if !exists $gcbIds{$gcbMap->[$i]};
+    @gcbValues[$gcbRanges->[$i] .. $end] = ($gcbIds{$gcbMap->[$i]}) x ($end - $gcbRanges->[$i] + 1);
+}
+my @pictographicRanges = prop_invlist('Extended_Pictographic');
+push @pictographicRanges, $MAX + 1 if @pictographicRanges % 2;
+for (my $i = 0; $i < @pictographicRanges; $i += 2) {
+    $gcbValues[$_] |= $pictographic for $pictographicRanges[$i] .. $pictographicRanges[$i + 1] - 1;
+}
+
+my ($gcbStage1, $gcbStage2) = two_level(\@gcbValues, 7);
+emit("// Grapheme clusters: utf8_gcb_stage2[(utf8_gcb_stage1[cp >> 7] << 7) | (cp & 127)] is the\n");
+emit("// Grapheme_Cluster_Break value, or'ed with UTF8_GCB_PICTOGRAPHIC for Extended_Pictographic\n");
+emit("// (stage1 ends after the last block that is not all Other)\n");
+emit("#define UTF8_GCB_SHIFT 7\n");
+for my $i (0 .. $#gcbNames) {
+    emit(sprintf("#define UTF8_GCB_%s %d\n", uc($gcbNames[$i] eq 'Regional_Indicator' ? 'RI' : $gcbNames[$i]), $i));
+}
+emit(sprintf("#define UTF8_GCB_PICTOGRAPHIC 0x%02X\n\n", $pictographic));
+emit_array('uint8_t', 'utf8_gcb_stage1', $gcbStage1, 32);
+emit_array('uint8_t', 'utf8_gcb_stage2', $gcbStage2, 32);
+
+emit("#endif // UNICODE_TABLES_H\n");
+
+open(my $file, '>', $output) or die "$output: $!";
+print $file @out;
+close($file);
+printf STDERR "%s: normalization %d records, %d + %d bytes stages, %d + %d decompositions (%d code points), %d compositions\n",
+       $output, scalar(@props), scalar(@$normStage1), scalar(@$normStage2), scalar(@canonical), scalar(@compat),
+       scalar(@decompositionData), scalar(@compositions);
+printf STDERR "%s: case folding %d records, %d + %d bytes stages, %d full folding code points\n",
+       $output, scalar(@foldRecords), scalar(@$foldStage1), scalar(@$foldStage2), scalar(@fullFoldData);
+printf STDERR "%s: grapheme break %d + %d bytes stages\n", $output, scalar(@$gcbStage1), scalar(@$gcbStage2);
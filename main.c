@@ -1,731 +1,4629 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L // mmap and friends for the file mode
+#endif
 #include <stdio.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-void my_utf8_encode(char *input, char *output) {
-    // Iterate through each character in the input string until the null terminator is reached.
-    while (*input != '\0') {
-        //Check if the current character and the next one form the start of a Unicode escape sequence.
-        if (*input == '\\' && *(input + 1) == 'u') {
-            // Get the Unicode code point
-            unsigned int codePoint = 0;
-            //Extract the Unicode code point from the input string using sscanf.
-            //input + 2 skips the "\u" part of the escape sequence
-            //%4x specifies that we want to read up to four hexadecimal digits.
-            sscanf(input + 2, "%4x", &codePoint);
-
-            // Move the input pointer past the Unicode escape sequence
-            input += 6;
-
-            // Encode the UTF-8 sequence based on the code point, using the UTF-8 encoding logic from wikipedia
-            if (codePoint <= 0x007F) { // byte format 0xxxxxxx - x unicode code point-
-                // numerical value (in hexadecimal) assigned to every character and symbol in the Unicode standard
-                //within the Ascii range 0 to 127 - one byte (according to wikipedia table)
-                *output++ = (char)codePoint;
-            } else if (codePoint <= 0x07FF) { // two bytes - 0x0080 to 0x7FF
-                //110xxxxx
-                *output++ = (char)(0xC0 | (codePoint >> 6)); // shifting to "xxxxx" part of the first byte
-                //0xCO the binary 11000000 leading byte and casts the results to char
-                //combined leading byte with unicode point
-                // store the value at the memory location pointed to by output and then increment the output pointer
-                // to point to the next memory location.
-                *output++ = (char)(0x80 | (codePoint & 0x3F)); // 00111111 binary rep od 0x3F, 10000000 0x80 in binary
-                //continuation bytes in a multi-byte UTF-8 character.
-            } else if (codePoint <= 0xFFFF) { // three bytes 0x0800 to 0xFFFF
-                *output++ = (char)(0xE0 | (codePoint >> 12)); //right shifting by 12 because 3 bytes
-                //11100000 is binary leading for 3 bytes (0xE0)
-                *output++ = (char)(0x80 | ((codePoint >> 6) & 0x3F)); //second byte
-                *output++ = (char)(0x80 | (codePoint & 0x3F)); //similar to second byte encoding
-            } else { // 4-bytes: 0x10000 to maximum
-                *output++ = (char)(0xF0 | (codePoint >> 18)); //shifting 18 times to get to the first of thr four bytes
-                *output++ = (char)(0x80 | ((codePoint >> 12) & 0x3F)); //same as the others
-                *output++ = (char)(0x80 | ((codePoint >> 6) & 0x3F));
-                *output++ = (char)(0x80 | (codePoint & 0x3F));
-            }
-        } else {
-            // Copy regular ASCII character
-            //copying a regular ASCII character from the input buffer to the output buffer and advancing
-            // the pointers to the next characters in their respective buffers
-            *output++ = *input++;
+#include "my_utf8.h"
+#include "unicode_tables.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define UTF8_HAVE_MMAP 1
+#define UTF8_HAVE_PTHREADS 1
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// SIMD kernels are compiled with per-function target attributes and picked at runtime,
+// so the project itself still builds with plain default compiler flags.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UTF8_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// Instruction set levels the kernels are written for, best one supported by the CPU is used
+enum utf8_cpu_level {
+    UTF8_CPU_SCALAR,
+    UTF8_CPU_SSE42,
+    UTF8_CPU_AVX2,
+    UTF8_CPU_AVX512
+};
+
+// Detects the CPU once and remembers the answer
+static enum utf8_cpu_level utf8_detect_cpu(void) {
+    static int detected = -1;
+    if (detected < 0) {
+        enum utf8_cpu_level level = UTF8_CPU_SCALAR;
+#ifdef UTF8_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512bw")) {
+            level = UTF8_CPU_AVX512;
+        } else if (__builtin_cpu_supports("avx2")) {
+            level = UTF8_CPU_AVX2;
+        } else if (__builtin_cpu_supports("sse4.2")) {
+            level = UTF8_CPU_SSE42;
         }
+#endif
+        detected = level;
     }
-
-    *output = '\0'; // Null-terminate the output string
+    return (enum utf8_cpu_level)detected;
 }
 
-void appendUnicodeEscape(unsigned int codePoint, char **output) {
-    //"helper function"
-    //specifies that we want a four-digit hexadecimal representation with leading zeros.
-    //format the Unicode escape sequence and write it to the output.
-    sprintf(*output, "\\u%04X", codePoint);
-    *output += 6; // Move the output pointer to the end of the escape sequence
+// Length of the run of ASCII bytes at the start of buf, eight bytes at a time
+static size_t utf8_ascii_prefix_swar(const uint8_t *buf, size_t len) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, buf + i, sizeof(word));
+        if (word & 0x8080808080808080ULL) {
+            break; // the first non-ASCII byte is somewhere in these eight
+        }
+    }
+    while (i < len && buf[i] < 0x80) {
+        i++;
+    }
+    return i;
 }
 
-int my_utf8_decode(unsigned char *input, unsigned char *output) {
-    // The loop iterates through each character in the input string until the null terminator ('\0') is encountered.
-    while (*input != '\0') {
-        // retrieve the byte at the memory location pointed to by input and store it as an unsigned char named ch
-        unsigned char ch = (unsigned char)*input;
-
-        if (ch < 0x80) {
-            // ASCII character
-            //for ASCII - Unicode code points ranging from U+0000 to U+007F.
-            *output++ = *input++;
-        } else if ((ch & 0xE0) == 0xC0) { // 11100000 is binary of 0xE0 - using to mask the bytes and check
-            //if its 11000000 - leading 110 meaning : 2 bytes-sequence
-            // 2-byte UTF-8 sequence
-            unsigned int codePoint = ((ch & 0x1F) << 6) | (input[1] & 0x3F);
-            // Extracts the lower 5 bits of ch (since 0x1F is 00011111 in binary) and left-shifts them by 6 positions.
-            //input[1] - second byte in the sequence
-            //the binary value of 0x3F is 00111111
-            //performing input[1] & 0x3F retains only the lower 6 bits of input[1] and sets the higher bits to 0.
-            input += 2; //moving to next 2 character in the input (+2 because each is two bytes)
-            appendUnicodeEscape(codePoint, &output);
-        } else if ((ch & 0xF0) == 0xE0) {
-            // 3-byte UTF-8 sequence
-            unsigned int codePoint = ((ch & 0x0F) << 12) | ((input[1] & 0x3F) << 6) | (input[2] & 0x3F);
-            input += 3;
-            appendUnicodeEscape(codePoint, &output);
-        } else if ((ch & 0xF8) == 0xF0) {
-            // 4-byte UTF-8 sequence
-            unsigned int codePoint = ((ch & 0x07) << 18) | ((input[1] & 0x3F) << 12) | ((input[2] & 0x3F) << 6) | (input[3] & 0x3F);
-            input += 4;
-            appendUnicodeEscape(codePoint, &output);
-        } else {
-            // Invalid UTF-8 sequence, treat as ASCII
-            *output++ = *input++;
+#ifdef UTF8_X86_SIMD
+// The top bit of every byte goes into the movemask, so the first set bit is the first non-ASCII byte
+__attribute__((target("sse4.2")))
+static size_t utf8_ascii_prefix_sse42(const uint8_t *buf, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(buf + i)));
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctz((unsigned int)mask);
         }
     }
-
-    *output = '\0'; // Null-terminate the output string
-    return 0; // Success
+    return i + utf8_ascii_prefix_swar(buf + i, len - i);
 }
 
-int my_utf8_strlen(char *string) {
-    // Initializes a counter variable (count) to keep track of the number of characters in the string.
-    int count = 0;
-    //continues until the end of the string is reached (indicated by the null terminator '\0')
-    while (*string != '\0') {
-
-        /* Checks if the current byte is the start of a new UTF-8 character. The bitwise AND operation with 0xC0 and
-        the inequality != 0x80 checks if the two most significant bits are not '10', which indicates the start of a
-        new character */
-        if ((*string & 0xC0) != 0x80) { //if the bits are not 10 - new char
-            //The condition checks whether the two most significant bits of the byte are not the continuation
-            // byte pattern, which would indicate the start of a new character.
-            // If it's the start of a new UTF-8 character
-            count++;
+__attribute__((target("avx2")))
+static size_t utf8_ascii_prefix_avx2(const uint8_t *buf, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        int mask = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(buf + i)));
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctz((unsigned int)mask);
         }
-        //moves the pointer to the next byte in the string
-        string++;
     }
-    return count;
+    return i + utf8_ascii_prefix_swar(buf + i, len - i);
 }
 
-char *my_utf8_charat(unsigned char *string, int index) {
-    if (index < 0) {
-        // Negative indices are considered invalid.
-        return NULL;
+__attribute__((target("avx512f,avx512bw")))
+static size_t utf8_ascii_prefix_avx512(const uint8_t *buf, size_t len) {
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __mmask64 mask = _mm512_movepi8_mask(_mm512_loadu_si512((const void *)(buf + i)));
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctzll(mask);
+        }
     }
+    return i + utf8_ascii_prefix_swar(buf + i, len - i);
+}
+#endif
 
-    // Iterate through the input string until either the end of the string ('\0') is reached or the specified index is 0
-    while (*string != '\0' && index > 0) {
-        unsigned char ch = (unsigned char)*string;
+typedef size_t (*utf8_scan_fn)(const uint8_t *, size_t);
 
-        if ((ch & 0xC0) != 0x80) {
-            // Check if the current byte is the start of a new UTF-8 character
-            index--;
+// Picks the ASCII scanning kernel for this CPU on the first call
+static size_t utf8_ascii_prefix(const uint8_t *buf, size_t len) {
+    static utf8_scan_fn scan = NULL;
+    if (scan == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                scan = utf8_ascii_prefix_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                scan = utf8_ascii_prefix_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                scan = utf8_ascii_prefix_sse42;
+                break;
+#endif
+            default:
+                scan = utf8_ascii_prefix_swar;
         }
-
-        string++;
     }
+    return scan(buf, len);
+}
 
-    if (*string == '\0' || (index > 0 && *string == '\0')) {
-        // Check for out-of-bounds indices
-        return NULL;
-    }
+// Parses exactly four hex digits with no branches: all four bytes are checked and converted at once
+// inside one 32-bit word (first digit in the top byte). Returns 1 and sets *value if every byte is a
+// hex digit, 0 otherwise.
+static int parse_hex4(const uint8_t *digits, unsigned int *value) {
+    uint32_t word = ((uint32_t)digits[0] << 24) | ((uint32_t)digits[1] << 16) | ((uint32_t)digits[2] << 8) | digits[3];
+    uint32_t low = word & 0x7F7F7F7F; // keeps the per-byte additions below from carrying into the next byte
+    uint32_t lower = low | 0x20202020; // 'A'-'F' -> 'a'-'f'
+
+    // a byte x is in [lo, hi] when x + (0x80 - lo) has the top bit set and x + (0x7F - hi) does not
+    uint32_t isDigit = (low + 0x50505050) & ~(low + 0x46464646);   // '0'..'9'
+    uint32_t isLetter = (lower + 0x1F1F1F1F) & ~(lower + 0x19191919); // 'a'..'f'
+    uint32_t valid = (isDigit | isLetter) & ~word & 0x80808080;
 
-    // At this point, 'string' points to the start of the character at the specified index
-    // Return only the first byte of the character
-    return string;
+    // '0'-'9' keep their low nibble, letters get 9 added to theirs (bit 6 is set only for letters)
+    uint32_t nibbles = (word & 0x0F0F0F0F) + 9 * ((word >> 6) & 0x01010101);
+    nibbles = (nibbles | (nibbles >> 4)) & 0x00FF00FF; // two nibbles per byte
+    *value = (nibbles | (nibbles >> 8)) & 0xFFFF;
+    return valid == 0x80808080;
 }
 
-// Function to compare two UTF-8 strings
-int my_utf8_strcmp( unsigned char *string1, unsigned char *string2) {
-    while (*string1 != '\0' && *string2 != '\0') {
-        // Decode the next character in each string
-        unsigned int code_point1 = 0;
-        unsigned int code_point2 = 0;
-        int bytes1 = my_utf8_decode(string1, &code_point1); // decoded Unicode code points
-        int bytes2 = my_utf8_decode(string2, &code_point2); // should contain the number of bytes used to
-        // encode those characters in UTF-8.
-
-        if (bytes1 == -1 || bytes2 == -1) {
-            // Invalid UTF-8 sequence in either string
-            // represent the number of bytes consumed during the UTF-8 decoding of string1 and string2
-            // bytes1 and bytes2 should be greater than or equal to 0, indicating the number of bytes consumed
-            return -1;
-        }
+// Eight hex digits, for \UXXXXXXXX
+static int parse_hex8(const uint8_t *digits, unsigned int *value) {
+    unsigned int high, low;
+    int valid = parse_hex4(digits, &high) & parse_hex4(digits + 4, &low);
+    *value = (high << 16) | low;
+    return valid;
+}
 
-        // Compare the decoded code points
-        if (code_point1 != code_point2) {
-            return code_point1 - code_point2;
-        }
+// Writes the UTF-8 encoding of a code point and returns its length (1 to 4 bytes)
+static size_t utf8_encode_code_point(unsigned int codePoint, uint8_t *output) {
+    // Encode the UTF-8 sequence based on the code point, using the UTF-8 encoding logic from wikipedia
+    if (codePoint <= 0x007F) { // byte format 0xxxxxxx - x unicode code point-
+        // numerical value (in hexadecimal) assigned to every character and symbol in the Unicode standard
+        //within the Ascii range 0 to 127 - one byte (according to wikipedia table)
+        output[0] = (uint8_t)codePoint;
+        return 1;
+    } else if (codePoint <= 0x07FF) { // two bytes - 0x0080 to 0x7FF
+        //110xxxxx
+        output[0] = (uint8_t)(0xC0 | (codePoint >> 6)); // shifting to "xxxxx" part of the first byte
+        //0xCO the binary 11000000 leading byte and casts the results to char
+        //combined leading byte with unicode point
+        output[1] = (uint8_t)(0x80 | (codePoint & 0x3F)); // 00111111 binary rep od 0x3F, 10000000 0x80 in binary
+        //continuation bytes in a multi-byte UTF-8 character.
+        return 2;
+    } else if (codePoint <= 0xFFFF) { // three bytes 0x0800 to 0xFFFF
+        output[0] = (uint8_t)(0xE0 | (codePoint >> 12)); //right shifting by 12 because 3 bytes
+        //11100000 is binary leading for 3 bytes (0xE0)
+        output[1] = (uint8_t)(0x80 | ((codePoint >> 6) & 0x3F)); //second byte
+        output[2] = (uint8_t)(0x80 | (codePoint & 0x3F)); //similar to second byte encoding
+        return 3;
+    }
+    // 4-bytes: 0x10000 to maximum
+    output[0] = (uint8_t)(0xF0 | (codePoint >> 18)); //shifting 18 times to get to the first of thr four bytes
+    output[1] = (uint8_t)(0x80 | ((codePoint >> 12) & 0x3F)); //same as the others
+    output[2] = (uint8_t)(0x80 | ((codePoint >> 6) & 0x3F));
+    output[3] = (uint8_t)(0x80 | (codePoint & 0x3F));
+    return 4;
+}
 
-        // Move to the next character
-        string1 += bytes1;
-        string2 += bytes2;
+// Reads the escape at the start of buf (\uXXXX, a \uXXXX\uXXXX surrogate pair, or \UXXXXXXXX) into
+// *codePoint and returns how many bytes it used, or 0 if buf does not start with a well-formed escape.
+// Lone surrogates and values above U+10FFFF come back as U+FFFD so the output is always valid UTF-8.
+static size_t utf8_parse_escape(const uint8_t *buf, size_t len, unsigned int *codePoint) {
+    if (len >= 6 && buf[1] == 'u' && parse_hex4(buf + 2, codePoint)) {
+        if (*codePoint >= 0xD800 && *codePoint <= 0xDBFF) {
+            // high surrogate - joined with the low surrogate escape right after it into one code point
+            unsigned int low;
+            if (len >= 12 && buf[6] == '\\' && buf[7] == 'u' && parse_hex4(buf + 8, &low) &&
+                low >= 0xDC00 && low <= 0xDFFF) {
+                *codePoint = 0x10000 + ((*codePoint - 0xD800) << 10) + (low - 0xDC00);
+                return 12;
+            }
+            *codePoint = 0xFFFD;
+        } else if (*codePoint >= 0xDC00 && *codePoint <= 0xDFFF) {
+            *codePoint = 0xFFFD; // low surrogate with no high surrogate before it
+        }
+        return 6;
+    }
+    if (len >= 10 && buf[1] == 'U' && parse_hex8(buf + 2, codePoint)) {
+        if (*codePoint > 0x10FFFF || (*codePoint >= 0xD800 && *codePoint <= 0xDFFF)) {
+            *codePoint = 0xFFFD;
+        }
+        return 10;
     }
+    return 0;
+}
 
-    // Check if one string is shorter than the other
-    if (*string1 != '\0') {
-        return 1; // string2 is shorter
-    } else if (*string2 != '\0') {
-        return -1; // string1 is shorter
+// Length-delimited version of my_utf8_encode - converts exactly len bytes of buf, so it also works on
+// slices of bigger buffers. Does not null-terminate; returns the number of bytes written to output.
+// Understands \uXXXX, UTF-16 surrogate pairs written as two \u escapes, and \UXXXXXXXX. A backslash
+// that does not start a well-formed escape is copied through like any other character.
+size_t my_utf8_encode_n(const uint8_t *buf, size_t len, uint8_t *output) {
+    const uint8_t *end = buf + len;
+    uint8_t *outputStart = output;
+
+    // Iterate through each byte of the slice
+    while (buf < end) {
+        if (*buf != '\\') {
+            // Everything up to the next backslash is copied as it is, in one go (memchr does the wide compare)
+            const uint8_t *backslash = memchr(buf, '\\', (size_t)(end - buf));
+            size_t run = (size_t)((backslash != NULL ? backslash : end) - buf);
+            memcpy(output, buf, run);
+            output += run;
+            buf += run;
+            continue;
+        }
+        //Check if the backslash starts a Unicode escape sequence whose hex digits are still inside the slice
+        unsigned int codePoint;
+        size_t escapeLength = utf8_parse_escape(buf, (size_t)(end - buf), &codePoint);
+        if (escapeLength > 0) {
+            // Move the input pointer past the Unicode escape sequence and write the character
+            buf += escapeLength;
+            output += utf8_encode_code_point(codePoint, output);
+        } else {
+            // Copy regular ASCII character
+            //copying a regular ASCII character from the input buffer to the output buffer and advancing
+            // the pointers to the next characters in their respective buffers
+            *output++ = *buf++;
+        }
     }
 
-    return 0; // Both strings are equal
+    return (size_t)(output - outputStart);
 }
 
-/* one of the 2 creative functions I decided to add - this function will take as an input
- * from the user the string, start index for substring extraction and length of the substring,
- * and returns a substring */
+void my_utf8_encode(char *input, char *output) {
+    // Convert everything up to the null terminator, then null-terminate the output string
+    size_t written = my_utf8_encode_n((const uint8_t *)input, strlen(input), (uint8_t *)output);
+    output[written] = '\0';
+}
 
-void my_utf8_substring(char *input, int start, int length, char *output) {
-    int i = 0; //iteration purposes
-    int inputLength = 0; //length of input string in bytes
+// Hex digits indexed by nibble value - the escapes are built from this table instead of sprintf
+static const char utf8_hex_digits[16] = {
+        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
+};
 
-    // Find the actual length of the input string in bytes
-    while (input[i] != '\0') {
-        inputLength++;
-        i++;
+// Writes the escape for one code point and returns its length: \uXXXX for the BMP, and for code
+// points above U+FFFF as many digits as they need (same text as sprintf "\\u%04X")
+static size_t utf8_write_escape(unsigned int codePoint, char *out) {
+    out[0] = '\\';
+    out[1] = 'u';
+    if (codePoint <= 0xFFFF) {
+        out[2] = utf8_hex_digits[(codePoint >> 12) & 0xF];
+        out[3] = utf8_hex_digits[(codePoint >> 8) & 0xF];
+        out[4] = utf8_hex_digits[(codePoint >> 4) & 0xF];
+        out[5] = utf8_hex_digits[codePoint & 0xF];
+        return 6;
     }
+    size_t digits = 5;
+    while (digits < 8 && (codePoint >> (4 * digits)) != 0) {
+        digits++;
+    }
+    for (size_t i = 0; i < digits; i++) {
+        out[2 + i] = utf8_hex_digits[(codePoint >> (4 * (digits - 1 - i))) & 0xF];
+    }
+    return 2 + digits;
+}
+
+void appendUnicodeEscape(unsigned int codePoint, char **output) {
+    //"helper function"
+    //four-digit hexadecimal representation with leading zeros, written straight from the digit table.
+    //code points above U+FFFF get five or six digits
+    *output += utf8_write_escape(codePoint, *output); // Move the output pointer to the end of the escape sequence
+}
 
-    // Initialize variables for UTF-8 decoding
-    int currentIndex = 0; //Keep track of the current index in the input string
+// Batched version of appendUnicodeEscape - escapes 'count' code points one after the other and moves
+// the output pointer past all of them. Does not null-terminate.
+void appendUnicodeEscapes(const unsigned int *codePoints, size_t count, char **output) {
+    char *out = *output;
+    for (size_t i = 0; i < count; i++) {
+        out += utf8_write_escape(codePoints[i], out);
+    }
+    *output = out;
+}
 
-    // Iterate through the input string to find the starting index
-    i = 0;
-    while (i < inputLength && currentIndex < start) {
-        unsigned char ch = (unsigned char)input[i];
+/* UTF-8 as a table-driven automaton (after Bjoern Hoehrmann's decoder), shared by decode, substring,
+ * strcmp and the scalar validator instead of a chain of lead-byte tests.
+ * Every byte maps to one of 12 classes; the state is a multiple of 12, so state + class indexes the
+ * transition table directly. The classes split the continuation bytes into 80-8F, 90-9F and A0-BF and
+ * give E0, ED, F0 and F4 their own class, which is how the table rejects overlong encodings, surrogates
+ * and code points above U+10FFFF: it accepts exactly the strings my_utf8_check accepts. */
+#define UTF8_DFA_ACCEPT 0
+#define UTF8_DFA_REJECT 12
 
-        // Move to the next character based on UTF-8 encoding rules
-        if (ch < 0x80) {
-            i += 1;
-        } else if ((ch & 0xE0) == 0xC0) {
-            i += 2;
-        } else if ((ch & 0xF0) == 0xE0) {
-            i += 3;
-        } else if ((ch & 0xF8) == 0xF0) {
-            i += 4;
-        } else {
-            // Invalid UTF-8 sequence, move to the next byte
-            i += 1;
-        }
+static const uint8_t utf8_dfa_class[256] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 00-1F
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 20-3F
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 40-5F
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 60-7F
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, // 80-9F
+        7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, // A0-BF
+        8, 8, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, // C0-DF
+        10, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 3, 3, 11, 6, 6, 6, 5, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8 // E0-FF
+};
 
-        currentIndex++;
-    }
+// utf8_dfa_transition[state + class] is the next state
+static const uint8_t utf8_dfa_transition[108] = {
+        0, 12, 24, 36, 60, 96, 84, 12, 12, 12, 48, 72,     // 0: between characters
+        12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,    // 12: rejected (stays rejected)
+        12, 0, 12, 12, 12, 12, 12, 0, 12, 0, 12, 12,       // 24: one continuation byte missing
+        12, 24, 12, 12, 12, 12, 12, 24, 12, 24, 12, 12,    // 36: two missing
+        12, 12, 12, 12, 12, 12, 12, 24, 12, 12, 12, 12,    // 48: after E0, needs A0-BF
+        12, 24, 12, 12, 12, 12, 12, 12, 12, 24, 12, 12,    // 60: after ED, needs 80-9F
+        12, 12, 12, 12, 12, 12, 12, 36, 12, 36, 12, 12,    // 72: after F0, needs 90-BF
+        12, 36, 12, 12, 12, 12, 12, 36, 12, 36, 12, 12,    // 84: three missing
+        12, 36, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12     // 96: after F4, needs 80-8F
+};
 
-    // Extract the substring
-    int j = 0;
-    while (j < length && i < inputLength) {
-        output[j] = input[i];
-        j++;
+// Feeds one byte to the automaton and returns the new state. The payload bits collect in *codePoint,
+// which holds the decoded character once the state is back to UTF8_DFA_ACCEPT.
+static inline unsigned int utf8_dfa_step(unsigned int state, unsigned int *codePoint, uint8_t byte) {
+    unsigned int type = utf8_dfa_class[byte];
+    *codePoint = (state != UTF8_DFA_ACCEPT) ? (*codePoint << 6) | (byte & 0x3Fu) : (0xFFu >> type) & byte;
+    return utf8_dfa_transition[state + type];
+}
 
-        unsigned char ch = (unsigned char)input[i];
+// Length of the character a byte of each class starts (1 for classes that can't start one)
+static const uint8_t utf8_dfa_length[12] = {1, 1, 2, 3, 3, 4, 4, 1, 1, 1, 3, 4};
 
-        // Move to the next character based on UTF-8 encoding rules
-        if (ch < 0x80) {
-            i += 1;
-        } else if ((ch & 0xE0) == 0xC0) {
-            i += 2;
-        } else if ((ch & 0xF0) == 0xE0) {
-            i += 3;
-        } else if ((ch & 0xF8) == 0xF0) {
-            i += 4;
-        } else {
-            // Invalid UTF-8 sequence, move to the next byte
-            i += 1;
+// Decodes the character at the start of buf (len > 0). Returns its length in bytes with the code point
+// in *codePoint, -1 if the bytes are not valid UTF-8, or 0 if they are the valid start of a character
+// cut off by the end of the buffer.
+static inline int utf8_dfa_next(const uint8_t *buf, size_t len, unsigned int *codePoint) {
+    // The class of the lead byte already says how long the character is, so the automaton runs that
+    // many steps and is only asked once, at the end, whether it accepted
+    int bytes = utf8_dfa_length[utf8_dfa_class[buf[0]]];
+    unsigned int state = UTF8_DFA_ACCEPT;
+    if ((size_t)bytes <= len) {
+        for (int i = 0; i < bytes; i++) {
+            state = utf8_dfa_step(state, codePoint, buf[i]);
         }
+        return (state == UTF8_DFA_ACCEPT) ? bytes : -1;
     }
 
-    // Null-terminate the output string
-    output[j] = '\0';
+    // Cut off by the end of the buffer: either still valid so far, or already broken
+    for (size_t i = 0; i < len; i++) {
+        state = utf8_dfa_step(state, codePoint, buf[i]);
+        if (state == UTF8_DFA_REJECT) {
+            return -1;
+        }
+    }
+    return 0;
 }
 
-// Function to check if a character is a UTF-8 whitespace character
-bool isUTF8Whitespace(unsigned char ch) {
-    return (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r');
+// How many bytes the decoder handles as one character at the start of buf: a whole valid character, or
+// a single byte that is copied through (invalid, or the start of a character cut off by the end).
+// The bytes after an invalid one are looked at again on their own, so an ASCII byte or a good lead
+// byte right behind a broken character is never swallowed by it.
+static size_t utf8_decode_unit(const uint8_t *buf, size_t len) {
+    if (buf[0] < 0x80) {
+        return 1;
+    }
+    unsigned int codePoint;
+    int bytes = utf8_dfa_next(buf, len, &codePoint);
+    return (bytes > 0) ? (size_t)bytes : 1;
 }
 
-// Function to find the longest continuous sequence in a UTF-8 string
-void findLongestContinuousSequence(char *input) {
-    int i = 0;
-    int currentLength = 0; //Length of the current continuous sequence
-    int maxLength = 0; //current longest
-    char *currentStart = NULL; //pointers to each one, points to NULL while initializes to avoid errors
-    char *maxStart = NULL;
-
-    // Iterate through the input string
-    while (input[i] != '\0') {
-        unsigned char ch = (unsigned char)input[i];
-
-        // Move to the next character based on UTF-8 encoding rules
-        if (ch < 0x80) {
-            if (isUTF8Whitespace(ch)) {
-                //  Reset the current sequence if the character is a whitespace
-                currentLength = 0;
-                currentStart = NULL;
-            } else {
-                // Update the current sequence
-                if (currentStart == NULL) {
-                    currentStart = &input[i];
-                }
-                currentLength++;
-            }
-            i++;
-        } else if ((ch & 0xE0) == 0xC0) {
-            i += 2;
-        } else if ((ch & 0xF0) == 0xE0) {
-            i += 3;
-        } else if ((ch & 0xF8) == 0xF0) {
-            i += 4;
-        } else {
-            // Invalid UTF-8 sequence, move to the next byte
-            i++;
+// The decode loop. With 'consumed' set it stops in front of a multi-byte character cut off by the end
+// of the buffer instead of copying it through, and reports how many input bytes it used (streaming).
+static size_t utf8_decode_run(const uint8_t *buf, size_t len, uint8_t *output, size_t *consumed) {
+    const uint8_t *start = buf;
+    const uint8_t *end = buf + len;
+    char *out = (char *)output; // appendUnicodeEscape works on char pointers
+
+    // The loop iterates through each character of the slice
+    while (buf < end) {
+        size_t remaining = (size_t)(end - buf);
+
+        if (*buf < 0x80) {
+            // ASCII character
+            //for ASCII - Unicode code points ranging from U+0000 to U+007F.
+            //Copy the whole ASCII run up to the next non-ASCII byte at once
+            size_t run = utf8_ascii_prefix(buf, remaining);
+            memcpy(out, buf, run);
+            out += run;
+            buf += run;
+            continue;
         }
 
-        // Update the maximum sequence if needed
-        if (currentLength > maxLength) {
-            maxLength = currentLength;
-            maxStart = currentStart;
+        // Multi-byte character: let the automaton decode (and validate) it
+        unsigned int codePoint;
+        int bytes = utf8_dfa_next(buf, remaining, &codePoint);
+        if (bytes > 0) {
+            buf += bytes;
+            appendUnicodeEscape(codePoint, &out);
+        } else if (bytes == 0 && consumed != NULL) {
+            // the rest of this character is in the next chunk
+            break;
+        } else {
+            // Invalid UTF-8 sequence, copy the byte through and go on with the next one
+            *out++ = (char)*buf++;
         }
     }
 
-    // Output the result
-    if (maxStart != NULL) {
-        printf("Longest continuous sequence: %.*s (length: %d)\n", maxLength, maxStart, maxLength);
-    } else {
-        printf("No continuous sequence found.\n");
+    if (consumed != NULL) {
+        *consumed = (size_t)(buf - start);
     }
+    return (size_t)(out - (char *)output);
 }
 
+// Length-delimited version of my_utf8_decode. Bytes that are not valid UTF-8 (including a character cut
+// off by the end of the slice) are copied through one at a time.
+// Does not null-terminate; returns the number of bytes written to output.
+size_t my_utf8_decode_n(const uint8_t *buf, size_t len, uint8_t *output) {
+    return utf8_decode_run(buf, len, output, NULL);
+}
 
-// Function to check if a given byte is a continuation byte
-//continuation bytes start with pattern "10xxxxxx"
-int is_continuation_byte(unsigned char byte) {
-    return (byte & 0xC0) == 0x80; // checks if 10
+
+int my_utf8_decode(unsigned char *input, unsigned char *output) {
+    // Decode everything up to the null terminator, then null-terminate the output string
+    size_t written = my_utf8_decode_n(input, strlen((const char *)input), output);
+    output[written] = '\0';
+    return 0; // Success
 }
 
-// Function to check if a given byte is a start byte of a UTF-8 character
-int is_start_byte(unsigned char byte) {
-    return (byte & 0xC0) != 0x80; // ensure does not have '10' pattern
+// Bits set in a 64-bit mask. __builtin_popcountll is a library call unless the whole file is built
+// for a CPU with POPCNT, so the bit masks of the block scans are counted with the usual SWAR sum.
+static inline unsigned int utf8_popcount64(uint64_t x) {
+    x -= (x >> 1) & 0x5555555555555555ULL;
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (unsigned int)((x * 0x0101010101010101ULL) >> 56);
 }
 
-// Function to check if a given byte is a valid lead byte (for 2, 3, or 4-byte sequence)
-//For example, valid-lead for 2-byte sequence: 110xxxxx	 (case 2)
-int is_valid_lead_byte(unsigned char byte, int num_bytes) {
-    // Check the high bits based on the number of bytes expected
-    switch (num_bytes) {
-        case 2:
-            return (byte & 0xE0) == 0xC0;
-        case 3:
-            return (byte & 0xF0) == 0xE0;
-        case 4:
-            return (byte & 0xF8) == 0xF0;
-        default:
-            return 0;
+// Counts the bytes that start a character (anything but 10xxxxxx) eight at a time: a byte is a
+// continuation byte when its top bit is set and the bit below it is clear.
+static size_t utf8_count_swar(const uint8_t *buf, size_t len) {
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, buf + i, sizeof(word));
+        uint64_t continuation = (word & ~(word << 1)) & 0x8080808080808080ULL;
+        // one bit per continuation byte, moved down to bit 0 and summed by the multiply
+        count += 8 - (size_t)(((continuation >> 7) * 0x0101010101010101ULL) >> 56);
     }
+    for (; i < len; i++) {
+        if ((buf[i] & 0xC0) != 0x80) { //if the bits are not 10 - new char
+            count++;
+        }
+    }
+    return count;
 }
 
-// Function to check if a given code point is a surrogate
-//use in UTF-16 so should not appear in UTF-8
-int is_surrogate(unsigned int code_point) {
-    return (code_point >= 0xD800 && code_point <= 0xDFFF);
+#ifdef UTF8_X86_SIMD
+/* Vectorized counting: as signed bytes the continuation bytes 0x80..0xBF are exactly the values
+ * -128..-65, so one compare against -65 marks every byte that starts a character, and the
+ * popcount of the compare mask is the number of characters in the block. */
+__attribute__((target("sse4.2,popcnt")))
+static size_t utf8_count_sse42(const uint8_t *buf, size_t len) {
+    const __m128i last_continuation = _mm_set1_epi8(-65); // 0xBF
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i *)(buf + i));
+        count += (size_t)_mm_popcnt_u32((unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(input, last_continuation)));
+    }
+    return count + utf8_count_swar(buf + i, len - i);
 }
 
-// Function to check if a given code point is overlong encoded
-int is_overlong_encoding(unsigned char byte, unsigned int code_point) {
-    if (code_point <= 0x7F) {
-        // One-byte character, should not be overlong - range (0X00 to 0X7F)
-        return (byte & 0x80) == 0x80;
-    } else if (code_point <= 0x7FF) {
-        // Two-byte character (0x80 to 0x7FF)
-        return (byte & 0xE0) == 0xC0 && code_point <= 0x7F;
-    } else if (code_point <= 0xFFFF) {
-        // Three-byte character
-        return (byte & 0xF0) == 0xE0 && code_point <= 0x7FF;
-    } else {
-        // Four-byte character
-        return (byte & 0xF8) == 0xF0 && code_point <= 0xFFFF;
+__attribute__((target("avx2,popcnt")))
+static size_t utf8_count_avx2(const uint8_t *buf, size_t len) {
+    const __m256i last_continuation = _mm256_set1_epi8(-65);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(buf + i));
+        count += (size_t)_mm_popcnt_u32((unsigned int)_mm256_movemask_epi8(_mm256_cmpgt_epi8(input, last_continuation)));
     }
+    _mm256_zeroupper(); // before the scalar tail and the caller's SSE code
+    return count + utf8_count_swar(buf + i, len - i);
 }
 
-// Function to check if a given code point is valid
-//does not exceed maximum value in Unicode
-int is_valid_code_point(unsigned int code_point) {
-    return !is_surrogate(code_point) && code_point <= 0x10FFFF;
+__attribute__((target("avx512f,avx512bw,popcnt")))
+static size_t utf8_count_avx512(const uint8_t *buf, size_t len) {
+    const __m512i last_continuation = _mm512_set1_epi8(-65);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i input = _mm512_loadu_si512((const void *)(buf + i));
+        count += (size_t)_mm_popcnt_u64(_mm512_cmpgt_epi8_mask(input, last_continuation));
+    }
+    _mm256_zeroupper();
+    return count + utf8_count_swar(buf + i, len - i);
 }
+#endif
 
-// Function to check if a UTF-8 string is valid
-int my_utf8_check(unsigned char *string) {
-    while (*string != '\0') {
-        unsigned char lead_byte = *string;
-
-        if (is_start_byte(lead_byte)) {
-            // Determine the number of bytes for this character
-            int num_bytes = 0;
-            if ((lead_byte & 0x80) == 0) {
-                num_bytes = 1; // 1-byte character
-            } else if ((lead_byte & 0xE0) == 0xC0) {
-                num_bytes = 2; // 2-byte character
-            } else if ((lead_byte & 0xF0) == 0xE0) {
-                num_bytes = 3; // 3-byte character
-            } else if ((lead_byte & 0xF8) == 0xF0) {
-                num_bytes = 4; // 4-byte character
-            } else {
-                return -1; // Invalid lead byte
-            }
+typedef size_t (*utf8_count_fn)(const uint8_t *, size_t);
 
-            // Check continuation bytes
-            for (int i = 1; i < num_bytes; i++) {
-                if (!is_continuation_byte(string[i])) {
-                    return -2; // Invalid continuation byte
-                }
-            }
+// Picks the counting kernel for this CPU on the first call
+static size_t utf8_count(const uint8_t *buf, size_t len) {
+    static utf8_count_fn count = NULL;
+    if (count == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                count = utf8_count_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                count = utf8_count_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                count = utf8_count_sse42;
+                break;
+#endif
+            default:
+                count = utf8_count_swar;
+        }
+    }
+    return count(buf, len);
+}
 
-            // Decode the code point
-            unsigned int code_point = 0;
-            for (int i = 0; i < num_bytes; i++) {
-                code_point = (code_point << 6) | (string[i] & 0x3F);
-            }
+// Length-delimited version of my_utf8_strlen - number of characters in len bytes of buf.
+// Every byte that is not a continuation byte (10xxxxxx) starts a new character.
+size_t my_utf8_strlen_n(const uint8_t *buf, size_t len) {
+    return utf8_count(buf, len);
+}
 
-            // Check for overlong encoding
-            if (is_overlong_encoding(lead_byte, code_point)) {
-                return -3; // Overlong encoding
-            }
+int my_utf8_strlen(char *string) {
+    return (int)my_utf8_strlen_n((const uint8_t *)string, strlen(string));
+}
 
-            // Check if the code point is valid
-            if (!is_valid_code_point(code_point)) {
-                return -4; // Invalid code point
-            }
+// Length-delimited version of my_utf8_charat - returns a pointer to the first byte of the character at
+// 'index', or NULL if the slice has no such character. Characters are counted like my_utf8_strlen_n, so
+// stray continuation bytes at the start of the slice belong to no character and are skipped.
+const uint8_t *my_utf8_charat_n(const uint8_t *buf, size_t len, size_t index) {
+    const uint8_t *end = buf + len;
+    while (buf < end && (*buf & 0xC0) == 0x80) {
+        buf++;
+    }
 
-            // Move to the next character
-            string += num_bytes;
-        } else {
-            return -5; // Unexpected continuation byte
+    // Skip 'index' characters: every start byte we pass ends one character
+    while (buf < end && index > 0) {
+        buf++;
+        // step over the continuation bytes of the character we just left
+        while (buf < end && (*buf & 0xC0) == 0x80) {
+            buf++;
         }
+        index--;
+    }
+
+    if (buf == end) {
+        // Check for out-of-bounds indices
+        return NULL;
     }
 
-    return 0; // Valid UTF-8 string
+    // At this point, 'buf' points to the start of the character at the specified index
+    return buf;
 }
 
-// Function to test the my_utf8_check function with meaningful names and error codes
-void test_utf8_check(char *test_string, int expected_error) {
-    int result = my_utf8_check((unsigned char *)test_string);
+char *my_utf8_charat(unsigned char *string, int index) {
+    if (index < 0) {
+        // Negative indices are considered invalid.
+        return NULL;
+    }
+    return (char *)my_utf8_charat_n(string, strlen((const char *)string), (size_t)index);
+}
 
-    printf("Testing: %s\n", test_string);
+// Length of the UTF-8 sequence announced by a lead byte (1 for ASCII and for bytes that can't start one)
+static int utf8_sequence_length(unsigned char ch) {
+    if (ch < 0x80) {
+        return 1;
+    } else if ((ch & 0xE0) == 0xC0) {
+        return 2;
+    } else if ((ch & 0xF0) == 0xE0) {
+        return 3;
+    } else if ((ch & 0xF8) == 0xF0) {
+        return 4;
+    }
+    // Invalid UTF-8 sequence, move to the next byte
+    return 1;
+}
 
-    if (result == expected_error) {
-        printf("Result: Passed\n");
-    } else {
-        printf("Result: Failed (Expected: %d, Actual: %d)\n", expected_error, result);
+// Index of the first byte where a and b differ, or len if the first len bytes are equal
+static size_t utf8_mismatch_swar(const uint8_t *a, const uint8_t *b, size_t len) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t wordA;
+        uint64_t wordB;
+        memcpy(&wordA, a + i, sizeof(wordA));
+        memcpy(&wordB, b + i, sizeof(wordB));
+        if (wordA != wordB) {
+            break; // the byte loop below finds it within these eight bytes
+        }
+    }
+    while (i < len && a[i] == b[i]) {
+        i++;
     }
+    return i;
+}
 
-    printf("\n");
+#ifdef UTF8_X86_SIMD
+__attribute__((target("sse4.2")))
+static size_t utf8_mismatch_sse42(const uint8_t *a, const uint8_t *b, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i blockA = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i blockB = _mm_loadu_si128((const __m128i *)(b + i));
+        unsigned int differ = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(blockA, blockB)) ^ 0xFFFFu;
+        if (differ != 0) {
+            return i + (size_t)__builtin_ctz(differ);
+        }
+    }
+    return i + utf8_mismatch_swar(a + i, b + i, len - i);
 }
 
-// Function to test all UTF-8 check cases
-void test_all_utf8_checks() {
-    // Test cases with meaningful names and error codes
-    test_utf8_check("Valid string", 0);
-    test_utf8_check("Invalid lead byte", -1);
-    test_utf8_check("Invalid continuation byte", -2);
-    test_utf8_check("Overlong encoding", -3); /* for example, using more bytes than necessary,
-    U0041 need two bytes to encode, if you use 3 - overlong */
-    //code point outside of valid Unicode range (0xD800 to 0xFFFF)
-    test_utf8_check("Invalid code point", -4);
-    //if continuation byte encountered by unexpected position
-    test_utf8_check("Unexpected continuation byte", -5);
+__attribute__((target("avx2")))
+static size_t utf8_mismatch_avx2(const uint8_t *a, const uint8_t *b, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i blockA = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i blockB = _mm256_loadu_si256((const __m256i *)(b + i));
+        unsigned int differ = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(blockA, blockB));
+        if (differ != 0) {
+            return i + (size_t)__builtin_ctz(differ);
+        }
+    }
+    return i + utf8_mismatch_swar(a + i, b + i, len - i);
 }
-//tests for every function
-// "helper function" since we cant not use any str library
-int compareStrings(const char *str1, const char *str2) {
-    while (*str1 != '\0' && *str2 != '\0') {
-        if (*str1 != *str2) {
-            return 1; // Strings are not equal
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t utf8_mismatch_avx512(const uint8_t *a, const uint8_t *b, size_t len) {
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i blockA = _mm512_loadu_si512((const void *)(a + i));
+        __m512i blockB = _mm512_loadu_si512((const void *)(b + i));
+        uint64_t differ = _mm512_cmpneq_epi8_mask(blockA, blockB);
+        if (differ != 0) {
+            return i + (size_t)__builtin_ctzll(differ);
         }
-        str1++;
-        str2++;
     }
+    return i + utf8_mismatch_swar(a + i, b + i, len - i);
+}
+#endif
 
-    if (*str1 != '\0' || *str2 != '\0') {
-        return 1; // One string is shorter than the other
+typedef size_t (*utf8_mismatch_fn)(const uint8_t *, const uint8_t *, size_t);
+
+// Picks the byte comparison kernel for this CPU on the first call
+static size_t utf8_mismatch(const uint8_t *a, const uint8_t *b, size_t len) {
+    static utf8_mismatch_fn mismatch = NULL;
+    if (mismatch == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                mismatch = utf8_mismatch_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                mismatch = utf8_mismatch_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                mismatch = utf8_mismatch_sse42;
+                break;
+#endif
+            default:
+                mismatch = utf8_mismatch_swar;
+        }
     }
+    return mismatch(a, b, len);
+}
 
-    return 0; // Strings are equal
+/* UTF-8 was designed so that comparing the bytes orders strings exactly like comparing their code
+ * points: a lead byte with more leading ones starts a bigger code point, and after equal lead bytes
+ * the continuation bytes hold the remaining bits from the top down. So the strings are compared as
+ * bytes, with wide compares, and only the two characters at the first difference are decoded (to
+ * catch invalid sequences there). Bytes the strings share are not validated; use
+ * my_utf8_strcmp_checked for that. */
+
+// Decodes the character of buf that byte i is in, walking from 'start', a character boundary in front
+// of i that both strings share. Returns 1 with the code point in *codePoint, or 0 if that character is
+// not valid UTF-8 (a broken sequence, or a continuation byte at i that no lead byte takes in).
+static int utf8_character_over(const uint8_t *buf, size_t len, size_t start, size_t i, unsigned int *codePoint) {
+    while (start <= i) {
+        int bytes = utf8_dfa_next(buf + start, len - start, codePoint);
+        if (bytes <= 0) {
+            return 0;
+        }
+        start += (size_t)bytes;
+    }
+    return 1;
 }
-//Tests for deocding
-void test_my_utf8_decode() {
-    // Test with ASCII characters
-    unsigned char input1[] = "Hello";
-    unsigned char output1[20];
-    int result1 = my_utf8_decode(input1, output1);
-    printf("%s: input='%s', expected='Hello', actual='%s'\n",
-           (result1 == 0 && compareStrings(output1, "Hello") == 0) ? "PASSED" : "FAILED", input1, output1);
 
-    // Test with non-ASCII characters
-    unsigned char input2[] = "你好";
-    unsigned char output2[20];
-    int result2 = my_utf8_decode(input2, output2);
-    printf("%s: input='%s', expected='你好', actual='%s'\n",
-           (result2 == 0 && compareStrings(output2, "你好") == 0) ? "PASSED" : "FAILED", input2, output2);
+// Length-delimited version of my_utf8_strcmp: -1, 0 or 1. When the character at the first difference
+// is not valid UTF-8 in one string, that string sorts first (-1 when it is the first one); when it is
+// invalid in both, they go by byte order. So swapping the arguments always flips the sign.
+int my_utf8_strcmp_n(const uint8_t *buf1, size_t len1, const uint8_t *buf2, size_t len2) {
+    size_t shorter = (len1 < len2) ? len1 : len2;
+    size_t i = utf8_mismatch(buf1, buf2, shorter);
 
-    // Test with invalid UTF-8 sequence
-    unsigned char input3[] = "abc\xFFxyz";
-    unsigned char output3[20];
-    int result3 = my_utf8_decode(input3, output3);
-    printf("%s: input='%s', expected=-1, actual=%d\n", (result3 == -1) ? "PASSED" : "FAILED", input3, result3);
+    if (i == shorter) {
+        // one string is the start of the other
+        if (len1 == len2) {
+            return 0; // Both strings are equal
+        }
+        return (len1 < len2) ? -1 : 1;
+    }
 
-    // Test with a mix of ASCII and non-ASCII characters
-    unsigned char input4[] = "Hello 你好 😊";
-    unsigned char output4[20];
-    int result4 = my_utf8_decode(input4, output4);
-    printf("%s: input='%s', expected='Hello 你好 😊', actual='%s'\n",
-           (result4 == 0 && compareStrings(output4, "Hello 你好 😊") == 0) ? "PASSED" : "FAILED", input4, output4);
+    // Step back to a character start in front of the difference - the bytes before it are the same in
+    // both strings - and decode from there, in each string, the character byte i is in
+    size_t start = i;
+    while (start > 0 && i - start < 3 && (is_continuation_byte(buf1[start]) || is_continuation_byte(buf2[start]))) {
+        start--;
+    }
+    unsigned int code_point1 = 0;
+    unsigned int code_point2 = 0;
+    int valid1 = utf8_character_over(buf1, len1, start, i, &code_point1);
+    int valid2 = utf8_character_over(buf2, len2, start, i, &code_point2);
+    if (!valid1 || !valid2) {
+        // Invalid UTF-8 sequence in either string
+        return (valid1 != valid2) ? (valid1 ? 1 : -1) : (buf1[i] < buf2[i]) ? -1 : 1;
+    }
+    return (code_point1 < code_point2) ? -1 : 1;
 }
-//Tests for strcmp
 
-void test_my_utf8_strcmp() {
-    // Test with equal strings
-    unsigned char string1_1[] = "Hello";
-    unsigned char string2_1[] = "Hello";
-    int result1 = my_utf8_strcmp(string1_1, string2_1);
-    printf("%s: string1='%s', string2='%s', expected=0, actual=%d\n", (result1 == 0) ? "PASSED" : "FAILED", string1_1,
-           string2_1, result1);
+// Function to compare two UTF-8 strings
+int my_utf8_strcmp( unsigned char *string1, unsigned char *string2) {
+    return my_utf8_strcmp_n(string1, strlen((const char *)string1), string2, strlen((const char *)string2));
+}
 
-    // Test with string1 shorter than string2
-    unsigned char string1_2[] = "Hi";
-    unsigned char string2_2[] = "Hello";
-    int result2 = my_utf8_strcmp(string1_2, string2_2);
-    printf("%s: string1='%s', string2='%s', expected<0, actual=%d\n", (result2 < 0) ? "PASSED" : "FAILED", string1_2,
-           string2_2, result2);
+/* one of the 2 creative functions I decided to add - this function will take as an input
+ * from the user the string, start index for substring extraction and length of the substring,
+ * and returns a substring */
 
-    // Test with string1 longer than string2
-    unsigned char string1_3[] = "Hello";
-    unsigned char string2_3[] = "Hi";
-    int result3 = my_utf8_strcmp(string1_3, string2_3);
-    printf("%s: string1='%s', string2='%s', expected>0, actual=%d\n", (result3 > 0) ? "PASSED" : "FAILED", string1_3,
-           string2_3, result3);
+// Moves pos forward over up to *count characters that start below 'stop', and takes the characters
+// passed off *count. Characters are counted like my_utf8_strlen_n: each starts at a byte that is not
+// 10xxxxxx and takes the continuation bytes behind it (read up to len), so pos always ends up on the
+// start of a character or at the end. Runs of ASCII go by with the vector kernel, and never further than
+// the characters still wanted.
+static size_t utf8_skip_characters(const uint8_t *buf, size_t len, size_t stop, size_t pos, size_t *count) {
+    size_t remaining = *count;
+    // continuation bytes at pos belong to the character before it, or to none at the start of buf
+    while (pos < len && is_continuation_byte(buf[pos])) {
+        pos++;
+    }
+    while (remaining > 0 && pos < stop) {
+        if (buf[pos] < 0x80) {
+            size_t limit = (stop - pos < remaining) ? stop - pos : remaining;
+            size_t run = (limit > 1 && buf[pos + 1] < 0x80) ? utf8_ascii_prefix(buf + pos, limit) : 1;
+            pos += run;
+            remaining -= run;
+        } else {
+            pos++;
+            remaining--;
+        }
+        while (pos < len && is_continuation_byte(buf[pos])) {
+            pos++;
+        }
+    }
+    *count -= remaining;
+    return pos;
+}
 
-    // Test with non-ASCII characters
-    unsigned char string1_4[] = "你好";
-    unsigned char string2_4[] = "こんにちは";
-    int result4 = my_utf8_strcmp(string1_4, string2_4);
-    printf("%s: string1='%s', string2='%s', expected<0, actual=%d\n", (result4 < 0) ? "PASSED" : "FAILED", string1_4,
-           string2_4, result4);
+// utf8_skip_characters on a null-terminated string whose length is not known: *known is how much of
+// it has been looked at so far, extended a piece at a time, so a short prefix of a long string is
+// found without reading all of it
+static size_t utf8_skip_characters_terminated(const char *input, size_t *known, size_t pos, size_t *count) {
+    size_t left = *count; // characters still to skip
+    while (left > 0) {
+        int ended = (input[*known] == '\0');
+        if (!ended && *known - pos < 64) {
+            *known += strnlen(input + *known, 256);
+            continue;
+        }
+        // short of the end, a character starting in the last three known bytes may go on past them
+        size_t stop = ended ? *known : *known - 3;
+        size_t passed = left;
+        pos = utf8_skip_characters((const uint8_t *)input, *known, stop, pos, &passed);
+        left -= passed;
+        if (ended) {
+            break;
+        }
+    }
+    // the continuation bytes of the last character may go on past what is known (the terminator ends them)
+    while (is_continuation_byte((unsigned char)input[pos])) {
+        pos++;
+    }
+    if (pos > *known) {
+        *known = pos;
+    }
+    *count -= left;
+    return pos;
+}
 
-    // Test with equal non-ASCII characters
-    unsigned char string1_5[] = "你好";
-    unsigned char string2_5[] = "你好";
-    int result5 = my_utf8_strcmp(string1_5, string2_5);
-    printf("%s: string1='%s', string2='%s', expected=0, actual=%d\n", (result5 == 0) ? "PASSED" : "FAILED", string1_5,
-           string2_5, result5);
+// Zero-copy my_utf8_substring_n: the 'length' characters starting at character 'start' as a pointer into
+// buf and a byte length. Scanning stops at the end of the range.
+my_utf8_view my_utf8_substring_view_n(const uint8_t *buf, size_t len, size_t start, size_t length) {
+    size_t first = utf8_skip_characters(buf, len, len, 0, &start);
+    size_t end = utf8_skip_characters(buf, len, len, first, &length);
+    my_utf8_view view = {buf + first, end - first};
+    return view;
+}
 
-    // Test with an empty string
-    unsigned char string1_6[] = "";
-    unsigned char string2_6[] = "Hello";
-    int result6 = my_utf8_strcmp(string1_6, string2_6);
-    printf("%s: string1='%s', string2='%s', expected<0, actual=%d\n", (result6 < 0) ? "PASSED" : "FAILED", string1_6,
-           string2_6, result6);
+// my_utf8_substring_view_n on a null-terminated string: only reads as far as the range goes (and a
+// little ahead), never the whole string
+my_utf8_view my_utf8_substring_view(const char *input, size_t start, size_t length) {
+    size_t known = 0;
+    size_t first = utf8_skip_characters_terminated(input, &known, 0, &start);
+    size_t end = utf8_skip_characters_terminated(input, &known, first, &length);
+    my_utf8_view view = {(const uint8_t *)input + first, end - first};
+    return view;
+}
 
+// Length-delimited version of my_utf8_substring - copies 'length' characters starting at character 'start'.
+// Does not null-terminate; returns the number of bytes written to output.
+size_t my_utf8_substring_n(const uint8_t *buf, size_t len, size_t start, size_t length, uint8_t *output) {
+    my_utf8_view view = my_utf8_substring_view_n(buf, len, start, length);
+    memcpy(output, view.data, view.bytes);
+    return view.bytes;
 }
 
-//tests for my strlen function
-void test_my_utf8_strlen() {
-    // Test with ASCII characters
-    unsigned char string1[] = "Hello";
-    int result1 = my_utf8_strlen(string1);
-    printf("%s: string='%s', expected=5, actual=%d\n", (result1 == 5) ? "PASSED" : "FAILED", string1, result1);
+void my_utf8_substring(char *input, int start, int length, char *output) {
+    size_t written = 0;
+    if (length > 0) {
+        // a negative start behaves like 0
+        my_utf8_view view = my_utf8_substring_view(input, start > 0 ? (size_t)start : 0, (size_t)length);
+        memcpy(output, view.data, view.bytes);
+        written = view.bytes;
+    }
 
-    // Test with non-ASCII characters
-    unsigned char string2[] = "你好";
-    int result2 = my_utf8_strlen(string2);
-    printf("%s: string='%s', expected=2, actual=%d\n", (result2 == 2) ? "PASSED" : "FAILED", string2, result2);
+    // Null-terminate the output string
+    output[written] = '\0';
+}
 
-    // Test with a mix of ASCII and non-ASCII characters
-    unsigned char string3[] = "Hello 你好";
-    int result3 = my_utf8_strlen(string3);
-    printf("%s: string='%s', expected=9, actual=%d\n", (result3 == 9) ? "PASSED" : "FAILED", string3, result3);
+/* Sampled offset index - remembers the byte offset of every 'stride'-th character of a buffer, so
+ * charat/substring on a long string only scan from the nearest sample instead of from the start.
+ * Nothing is allocated until the first query; my_utf8_index_free throws the samples away again.
+ * Positions are counted like my_utf8_strlen_n: every byte that is not 10xxxxxx starts a character. */
 
-    // Test with an empty string
-    unsigned char string4[] = "";
-    int result4 = my_utf8_strlen(string4);
-    printf("%s: string='%s', expected=0, actual=%d\n", (result4 == 0) ? "PASSED" : "FAILED", string4, result4);
+void my_utf8_index_init(my_utf8_index *index, const uint8_t *buf, size_t len, size_t stride) {
+    index->buf = buf;
+    index->len = len;
+    index->stride = (stride > 0) ? stride : UTF8_INDEX_DEFAULT_STRIDE;
+    index->offsets = NULL;
+    index->length = 0;
+    index->built = 0;
 }
 
-//Tests for my chrat function
-void test_my_utf8_charat() {
-    // Test with valid index within the string
-    unsigned char string1[] = "Hello";
-    char *result1 = my_utf8_charat(string1, 2);
-    printf("%s: string='%s', index=2, expected='l', actual='%s'\n",
-           (result1 != NULL && compareStrings(result1, "l") == 0) ? "PASSED" : "FAILED", string1, result1);
+void my_utf8_index_free(my_utf8_index *index) {
+    free(index->offsets);
+    index->offsets = NULL;
+    index->built = 0;
+}
 
-    // Test with valid index at the end of the string
-    unsigned char string2[] = "你好";
-    char *result2 = my_utf8_charat(string2, 2);
-    printf("%s: string='%s', index=2, expected='好', actual='%s'\n",
-           (result2 != NULL && compareStrings(result2, "好") == 0) ? "PASSED" : "FAILED", string2, result2);
+// Builds the samples in one pass. Every 64-byte block is counted once; only in a block that holds a
+// sampled character is that character looked for.
+static void utf8_index_build(my_utf8_index *index) {
+    const uint8_t *buf = index->buf;
+    size_t len = index->len;
+    // every character is at least one byte, so there are at most len / stride + 1 samples
+    index->offsets = malloc((len / index->stride + 1) * sizeof(size_t));
+    if (index->offsets == NULL) {
+        index->built = -1; // queries fall back to scanning from the start
+        index->length = my_utf8_strlen_n(buf, len);
+        return;
+    }
 
-    // Test with valid index at the start of the string
-    unsigned char string3[] = "Hello 你好";
-    char *result3 = my_utf8_charat(string3, 0);
-    printf("%s: string='%s', index=0, expected='H', actual='%s'\n",
-           (result3 != NULL && compareStrings(result3, "H") == 0) ? "PASSED" : "FAILED", string3, result3);
+    size_t characters = 0;
+    size_t nextSample = 0; // character index of the next sample
+    size_t samples = 0;
+    for (size_t i = 0; i < len; i += 64) {
+        size_t block = (len - i < 64) ? len - i : 64;
+        size_t blockCharacters = my_utf8_strlen_n(buf + i, block);
+        while (nextSample < characters + blockCharacters) {
+            // in an all-ASCII block the character is at its index, otherwise it is looked up in the block
+            size_t skip = nextSample - characters;
+            index->offsets[samples++] =
+                (blockCharacters == block) ? i + skip : (size_t)(my_utf8_charat_n(buf + i, block, skip) - buf);
+            nextSample += index->stride;
+        }
+        characters += blockCharacters;
+    }
+    index->length = characters;
+    index->built = 1;
+}
 
-    // Test with invalid negative index
-    unsigned char string4[] = "Hello";
-    char *result4 = my_utf8_charat(string4, -1);
-    printf("%s: string='%s', index=-1, expected=NULL, actual='%s'\n", (result4 == NULL) ? "PASSED" : "FAILED", string4,
-           result4);
+// Byte offset of character 'charIndex', or the length of the buffer if there is no such character
+size_t my_utf8_index_offset(my_utf8_index *index, size_t charIndex) {
+    if (index->built == 0) {
+        utf8_index_build(index);
+    }
+    if (charIndex >= index->length) {
+        return index->len;
+    }
 
-    // Test with invalid index beyond the string length
-    unsigned char string5[] = "Hello";
-    char *result5 = my_utf8_charat(string5, 10);
-    printf("%s: string='%s', index=10, expected=NULL, actual='%s'\n", (result5 == NULL) ? "PASSED" : "FAILED", string5,
-           result5);
+    size_t start = 0;
+    size_t skip = charIndex;
+    if (index->built == 1) {
+        start = index->offsets[charIndex / index->stride];
+        skip = charIndex % index->stride;
+    }
+    return (size_t)(my_utf8_charat_n(index->buf + start, index->len - start, skip) - index->buf);
+}
 
-    // Test with an empty string
-    unsigned char string6[] = "";
-    char *result6 = my_utf8_charat(string6, 0);
-    printf("%s: string='%s', index=0, expected=NULL, actual='%s'\n", (result6 == NULL) ? "PASSED" : "FAILED", string6,
-           result6);
+// Number of characters in the indexed buffer
+size_t my_utf8_index_strlen(my_utf8_index *index) {
+    if (index->built == 0) {
+        utf8_index_build(index);
+    }
+    return index->length;
 }
-//Tests for substring
-void test_my_utf8_substring() {
-    // Test with valid substring within the string
-    char input1[] = "Hello World";
-    char output1[20];
-    my_utf8_substring(input1, 6, 5, output1);
-    printf("%s: input='%s', start=6, length=5, expected='World', actual='%s'\n",
-           (compareStrings(output1, "World") == 0) ? "PASSED" : "FAILED", input1, output1);
 
-    // Test with valid substring starting from the beginning
-    char input2[] = "你好 World";
-    char output2[20];
-    my_utf8_substring(input2, 0, 6, output2);
-    printf("%s: input='%s', start=0, length=6, expected='你好 Wo', actual='%s'\n",
-           (compareStrings(output2, "你好 Wo") == 0) ? "PASSED" : "FAILED", input2, output2);
+// Indexed version of my_utf8_charat_n - pointer to the character at 'charIndex', or NULL
+const uint8_t *my_utf8_index_charat(my_utf8_index *index, size_t charIndex) {
+    size_t offset = my_utf8_index_offset(index, charIndex);
+    return (offset < index->len) ? index->buf + offset : NULL;
+}
 
-    // Test with valid substring starting from the middle
-    char input3[] = "Hello 你好";
-    char output3[20];
-    my_utf8_substring(input3, 6, 2, output3);
-    printf("%s: input='%s', start=6, length=2, expected='你好', actual='%s'\n",
-           (compareStrings(output3, "你好") == 0) ? "PASSED" : "FAILED", input3, output3);
+// Number of bytes taken by 'length' characters starting at character 'start' (cut at the end of the buffer)
+size_t my_utf8_index_range_length(my_utf8_index *index, size_t start, size_t length) {
+    size_t first = my_utf8_index_offset(index, start);
+    if (start >= index->length) {
+        return 0;
+    }
+    size_t last = (length < index->length - start) ? my_utf8_index_offset(index, start + length) : index->len;
+    return (first < last) ? last - first : 0;
+}
 
-    // Test with valid substring until the end of the string
-    char input4[] = "Hello 你好";
-    char output4[20];
-    my_utf8_substring(input4, 6, 10, output4);
-    printf("%s: input='%s', start=6, length=10, expected='你好', actual='%s'\n",
-           (compareStrings(output4, "你好") == 0) ? "PASSED" : "FAILED", input4, output4);
+// Indexed version of my_utf8_substring_n. Does not null-terminate; returns the number of bytes written.
+size_t my_utf8_index_substring(my_utf8_index *index, size_t start, size_t length, uint8_t *output) {
+    size_t first = my_utf8_index_offset(index, start);
+    size_t bytes = my_utf8_index_range_length(index, start, length);
+    memcpy(output, index->buf + first, bytes);
+    return bytes;
+}
 
-    // Test with invalid negative start index
-    char input5[] = "Hello";
-    char output5[20];
-    my_utf8_substring(input5, -2, 3, output5);
-    printf("%s: input='%s', start=-2, length=3, expected='', actual='%s'\n",
-           (compareStrings(output5, "") == 0) ? "PASSED" : "FAILED", input5, output5);
+// Function to check if a character is a UTF-8 whitespace character (the ASCII ones; see
+// utf8_whitespace_length for the others)
+bool isUTF8Whitespace(unsigned char ch) {
+    return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
 
-    // Test with invalid length exceeding the string length
-    char input6[] = "Hello";
-    char output6[20];
-    my_utf8_substring(input6, 2, 10, output6);
-    printf("%s: input='%s', start=2, length=10, expected='llo', actual='%s'\n",
-           (compareStrings(output6, "llo") == 0) ? "PASSED" : "FAILED", input6, output6);
+/* Unicode White_Space outside ASCII is U+0085, U+00A0, U+1680, U+2000..U+200A, U+2028, U+2029, U+202F,
+ * U+205F and U+3000. Encoded, every one of them starts with C2, E1, E2 or E3 and a known second byte,
+ * so the kernels below look for those byte pairs and for bytes up to 0x20 all at once, and only the
+ * few bytes they stop at are looked at closely. */
 
-    // Test with an empty string
-    char input7[] = "";
-    char output7[20];
-    my_utf8_substring(input7, 0, 5, output7);
-    printf("%s: input='%s', start=0, length=5, expected='', actual='%s'\n",
-           (compareStrings(output7, "") == 0) ? "PASSED" : "FAILED", input7, output7);
+// Byte length of the whitespace character at the start of buf, or 0 if it is something else
+static size_t utf8_whitespace_length(const uint8_t *buf, size_t len) {
+    uint8_t lead = buf[0];
+    if (lead < 0x80) {
+        return isUTF8Whitespace(lead) ? 1 : 0;
+    }
+    if (lead == 0xC2) {
+        return (len >= 2 && (buf[1] == 0x85 || buf[1] == 0xA0)) ? 2 : 0;
+    }
+    if (len < 3 || (lead & 0xF0) != 0xE0 || (buf[1] & 0xC0) != 0x80 || (buf[2] & 0xC0) != 0x80) {
+        return 0;
+    }
+    unsigned int codePoint = ((lead & 0x0Fu) << 12) | ((buf[1] & 0x3Fu) << 6) | (buf[2] & 0x3Fu);
+    return (codePoint == 0x1680 || (codePoint >= 0x2000 && codePoint <= 0x200A) || codePoint == 0x2028 ||
+            codePoint == 0x2029 || codePoint == 0x202F || codePoint == 0x205F || codePoint == 0x3000) ? 3 : 0;
 }
-//Tests for my longest sequence
-void test_findLongestContinuousSequence() {
-    // Test with multiple spaces
-    char input1[] = "Hello   World";
-    printf("Input: %s\n", input1);
-    printf("Expected: Hello\n");
-    printf("Actual: ");
-    findLongestContinuousSequence(input1);
-    printf("\n");
-
-    // Test with a mix of spaces and tabs
-    char input2[] = "Hello\t\tWorld";
-    printf("Input: %s\n", input2);
-    printf("Expected: Hello\n");
-    printf("Actual: ");
-    findLongestContinuousSequence(input2);
-    printf("\n");
 
-    // Test with a mix of spaces, tabs, and newlines
-    char input3[] = "Hello  \tWorld\n";
-    printf("Input: %s\n", input3);
-    printf("Expected: Hello\n");
-    printf("Actual: ");
-    findLongestContinuousSequence(input3);
-    printf("\n");
+// Whether block[i] could start a whitespace character: a byte up to 0x20, or the first two bytes of
+// one of the longer ones (block[i + 1] must be readable)
+static inline int utf8_space_candidate_at(const uint8_t *block, size_t i) {
+    uint8_t byte = block[i];
+    uint8_t next = block[i + 1];
+    return byte <= 0x20 || (byte == 0xC2 && (next == 0x85 || next == 0xA0)) || (byte == 0xE1 && next == 0x9A) ||
+           (byte == 0xE2 && (next == 0x80 || next == 0x81)) || (byte == 0xE3 && next == 0x80);
+}
 
-    // Test with continuous sequence at the end
-    char input4[] = "Hello World   ";
-    printf("Input: %s\n", input4);
-    printf("Expected: World\n");
-    printf("Actual: ");
-    findLongestContinuousSequence(input4);
-    printf("\n");
+// Classifies a block of 64 bytes (65 readable): returns a bit per byte that could start a whitespace
+// character, and puts a bit per byte that starts a character (not 10xxxxxx) in *starts
+static uint64_t utf8_space_mask_scalar(const uint8_t *block, uint64_t *starts) {
+    uint64_t candidates = 0;
+    uint64_t characters = 0;
+    for (size_t i = 0; i < 64; i++) {
+        candidates |= (uint64_t)utf8_space_candidate_at(block, i) << i;
+        characters |= (uint64_t)((block[i] & 0xC0) != 0x80) << i;
+    }
+    *starts = characters;
+    return candidates;
+}
 
-    // Test with an empty string
-    char input5[] = "";
-    printf("Input: %s\n", input5);
-    printf("Expected: No continuous sequence found.\n");
-    printf("Actual: ");
-    findLongestContinuousSequence(input5);
-    printf("\n");
+#ifdef UTF8_X86_SIMD
+// The same tests on 16 bytes and the 16 after each of them; the start bits go to *starts
+__attribute__((target("sse4.2")))
+static inline unsigned int utf8_space_mask_16(const uint8_t *p, unsigned int *starts) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+    __m128i next = _mm_loadu_si128((const __m128i *)(p + 1));
+    __m128i low = _mm_cmpeq_epi8(_mm_min_epu8(bytes, _mm_set1_epi8(0x20)), bytes);
+    __m128i c2 = _mm_and_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)0xC2)),
+                               _mm_or_si128(_mm_cmpeq_epi8(next, _mm_set1_epi8((char)0x85)),
+                                            _mm_cmpeq_epi8(next, _mm_set1_epi8((char)0xA0))));
+    __m128i e1 = _mm_and_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)0xE1)),
+                               _mm_cmpeq_epi8(next, _mm_set1_epi8((char)0x9A)));
+    __m128i e2 = _mm_and_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)0xE2)),
+                               _mm_cmpeq_epi8(_mm_and_si128(next, _mm_set1_epi8((char)0xFE)),
+                                              _mm_set1_epi8((char)0x80)));
+    __m128i e3 = _mm_and_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)0xE3)),
+                               _mm_cmpeq_epi8(next, _mm_set1_epi8((char)0x80)));
+    *starts = (unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(-65)));
+    return (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(low, c2), _mm_or_si128(_mm_or_si128(e1, e2), e3)));
+}
 
-    // Test with a single character
-    char input6[] = "H";
-    printf("Input: %s\n", input6);
-    printf("Expected: H (length: 1)\n");
-    printf("Actual: ");
-    findLongestContinuousSequence(input6);
-    printf("\n");
+__attribute__((target("sse4.2")))
+static uint64_t utf8_space_mask_sse42(const uint8_t *block, uint64_t *starts) {
+    uint64_t candidates = 0;
+    uint64_t characters = 0;
+    for (int i = 0; i < 64; i += 16) {
+        unsigned int blockStarts;
+        candidates |= (uint64_t)utf8_space_mask_16(block + i, &blockStarts) << i;
+        characters |= (uint64_t)blockStarts << i;
+    }
+    *starts = characters;
+    return candidates;
+}
 
-    // Test with multiple continuous sequences
-    char input7[] = "Hello  World   ";
-    printf("Input: %s\n", input7);
-    printf("Expected: World\n");
-    printf("Actual: ");
-    findLongestContinuousSequence(input7);
-    printf("\n");
+__attribute__((target("avx2")))
+static uint64_t utf8_space_mask_avx2(const uint8_t *block, uint64_t *starts) {
+    uint64_t candidates = 0;
+    uint64_t characters = 0;
+    for (int i = 0; i < 64; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(block + i));
+        __m256i next = _mm256_loadu_si256((const __m256i *)(block + i + 1));
+        __m256i low = _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, _mm256_set1_epi8(0x20)), bytes);
+        __m256i c2 = _mm256_and_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8((char)0xC2)),
+                                      _mm256_or_si256(_mm256_cmpeq_epi8(next, _mm256_set1_epi8((char)0x85)),
+                                                      _mm256_cmpeq_epi8(next, _mm256_set1_epi8((char)0xA0))));
+        __m256i e1 = _mm256_and_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8((char)0xE1)),
+                                      _mm256_cmpeq_epi8(next, _mm256_set1_epi8((char)0x9A)));
+        __m256i e2 = _mm256_and_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8((char)0xE2)),
+                                      _mm256_cmpeq_epi8(_mm256_and_si256(next, _mm256_set1_epi8((char)0xFE)),
+                                                        _mm256_set1_epi8((char)0x80)));
+        __m256i e3 = _mm256_and_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8((char)0xE3)),
+                                      _mm256_cmpeq_epi8(next, _mm256_set1_epi8((char)0x80)));
+        __m256i any = _mm256_or_si256(_mm256_or_si256(low, c2), _mm256_or_si256(_mm256_or_si256(e1, e2), e3));
+        candidates |= (uint64_t)(uint32_t)_mm256_movemask_epi8(any) << i;
+        characters |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(-65))) << i;
+    }
+    *starts = characters;
+    return candidates;
 }
 
-//Testing for encoding
-void test_my_utf8_encode() {
-    // Test with a simple ASCII string
-    char input1[] = "Hello";
-    char output1[20];
-    my_utf8_encode(input1, output1);
-    printf("%s: input='%s', expected='%s', actual='%s'\n", (compareStrings(input1, output1) == 0) ? "PASSED" : "FAILED",
-           input1, input1, output1);
+__attribute__((target("avx512f,avx512bw")))
+static uint64_t utf8_space_mask_avx512(const uint8_t *block, uint64_t *starts) {
+    __m512i bytes = _mm512_loadu_si512((const void *)block);
+    __m512i next = _mm512_loadu_si512((const void *)(block + 1));
+    __mmask64 candidates = _mm512_cmple_epu8_mask(bytes, _mm512_set1_epi8(0x20));
+    candidates |= _mm512_cmpeq_epi8_mask(bytes, _mm512_set1_epi8((char)0xC2)) &
+                  (_mm512_cmpeq_epi8_mask(next, _mm512_set1_epi8((char)0x85)) |
+                   _mm512_cmpeq_epi8_mask(next, _mm512_set1_epi8((char)0xA0)));
+    candidates |= _mm512_cmpeq_epi8_mask(bytes, _mm512_set1_epi8((char)0xE1)) &
+                  _mm512_cmpeq_epi8_mask(next, _mm512_set1_epi8((char)0x9A));
+    candidates |= _mm512_cmpeq_epi8_mask(bytes, _mm512_set1_epi8((char)0xE2)) &
+                  _mm512_cmpeq_epi8_mask(_mm512_and_si512(next, _mm512_set1_epi8((char)0xFE)),
+                                         _mm512_set1_epi8((char)0x80));
+    candidates |= _mm512_cmpeq_epi8_mask(bytes, _mm512_set1_epi8((char)0xE3)) &
+                  _mm512_cmpeq_epi8_mask(next, _mm512_set1_epi8((char)0x80));
+    *starts = _mm512_cmpgt_epi8_mask(bytes, _mm512_set1_epi8(-65));
+    return candidates;
+}
+#endif
 
-    // Test with a string containing a single Unicode escape sequence
-    char input2[] = "H\\u00E9llo"; // "é" in Unicode
-    char output2[20];
-    my_utf8_encode(input2, output2);
-    printf("%s: input='%s', expected='Héllo', actual='%s'\n",
-           (compareStrings("Hé llo", output2) == 0) ? "PASSED" : "FAILED", input2, output2);
+typedef uint64_t (*utf8_space_mask_fn)(const uint8_t *, uint64_t *);
+
+// Picks the whitespace classifying kernel for this CPU on the first call
+static uint64_t utf8_space_mask(const uint8_t *block, uint64_t *starts) {
+    static utf8_space_mask_fn classify = NULL;
+    if (classify == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                classify = utf8_space_mask_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                classify = utf8_space_mask_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                classify = utf8_space_mask_sse42;
+                break;
+#endif
+            default:
+                classify = utf8_space_mask_scalar;
+        }
+    }
+    return classify(block, starts);
+}
+
+// Finds the longest run of characters without Unicode White_Space in it. Fills *longest with its byte
+// offset, byte length and number of characters (counted like my_utf8_strlen_n; the first of equally
+// long runs wins) and returns 1, or returns 0 if buf is empty or all whitespace.
+// Works through 64-byte blocks: only the bytes the classifier marks are looked at one by one, and the
+// characters of a run are counted with popcounts of the start bits.
+int my_utf8_longest_sequence_n(const uint8_t *buf, size_t len, my_utf8_run *longest) {
+    longest->offset = 0;
+    longest->bytes = 0;
+    longest->characters = 0;
+    size_t runStart = 0;
+    size_t runStartCount = 0; // characters before runStart
+    size_t counted = 0;       // characters before the current block
+
+    for (size_t base = 0; base < len; base += 64) {
+        uint64_t starts;
+        uint64_t candidates;
+        if (len - base > 64) {
+            candidates = utf8_space_mask(buf + base, &starts);
+        } else {
+            // the last block, padded with bytes that are neither whitespace nor continuation bytes
+            uint8_t padded[65];
+            memset(padded, 'x', sizeof(padded));
+            memcpy(padded, buf + base, len - base);
+            uint64_t valid = (len - base == 64) ? ~0ULL : (1ULL << (len - base)) - 1;
+            candidates = utf8_space_mask(padded, &starts) & valid;
+            starts &= valid;
+        }
+        while (candidates != 0) {
+            unsigned int bit = (unsigned int)__builtin_ctzll(candidates);
+            candidates &= candidates - 1;
+            size_t pos = base + bit;
+            size_t space = utf8_whitespace_length(buf + pos, len - pos);
+            if (space == 0) {
+                continue; // a control character or a lookalike, part of the run
+            }
+            size_t before = counted + (size_t)utf8_popcount64(starts & ((1ULL << bit) - 1));
+            if (before - runStartCount > longest->characters) {
+                longest->offset = runStart;
+                longest->bytes = pos - runStart;
+                longest->characters = before - runStartCount;
+            }
+            runStart = pos + space;
+            runStartCount = before + 1;
+        }
+        counted += (size_t)utf8_popcount64(starts);
+    }
+    if (counted - runStartCount > longest->characters) {
+        longest->offset = runStart;
+        longest->bytes = len - runStart;
+        longest->characters = counted - runStartCount;
+    }
+    return longest->bytes > 0;
+}
+
+// Function to find the longest continuous sequence in a UTF-8 string and print it
+void findLongestContinuousSequence(char *input) {
+    my_utf8_run longest;
+    if (my_utf8_longest_sequence_n((const uint8_t *)input, strlen(input), &longest)) {
+        printf("Longest continuous sequence: %.*s (length: %zu)\n", (int)longest.bytes, input + longest.offset,
+               longest.characters);
+    } else {
+        printf("No continuous sequence found.\n");
+    }
+}
+
+
+// Function to check if a given byte is a continuation byte
+//continuation bytes start with pattern "10xxxxxx"
+int is_continuation_byte(unsigned char byte) {
+    return (byte & 0xC0) == 0x80; // checks if 10
+}
+
+// Function to check if a given byte is a start byte of a UTF-8 character
+int is_start_byte(unsigned char byte) {
+    return (byte & 0xC0) != 0x80; // ensure does not have '10' pattern
+}
+
+// Function to check if a given byte is a valid lead byte (for 2, 3, or 4-byte sequence)
+//For example, valid-lead for 2-byte sequence: 110xxxxx	 (case 2)
+int is_valid_lead_byte(unsigned char byte, int num_bytes) {
+    // Check the high bits based on the number of bytes expected
+    switch (num_bytes) {
+        case 2:
+            return (byte & 0xE0) == 0xC0;
+        case 3:
+            return (byte & 0xF0) == 0xE0;
+        case 4:
+            return (byte & 0xF8) == 0xF0;
+        default:
+            return 0;
+    }
+}
+
+// Function to check if a given code point is a surrogate
+//use in UTF-16 so should not appear in UTF-8
+int is_surrogate(unsigned int code_point) {
+    return (code_point >= 0xD800 && code_point <= 0xDFFF);
+}
+
+// Function to check if a given code point is overlong encoded
+//the lead byte tells how many bytes were used, the code point tells how many were needed
+int is_overlong_encoding(unsigned char byte, unsigned int code_point) {
+    if ((byte & 0xE0) == 0xC0) {
+        // Two-byte character, must be at least 0x80
+        return code_point <= 0x7F;
+    } else if ((byte & 0xF0) == 0xE0) {
+        // Three-byte character, must be at least 0x800
+        return code_point <= 0x7FF;
+    } else if ((byte & 0xF8) == 0xF0) {
+        // Four-byte character, must be at least 0x10000
+        return code_point <= 0xFFFF;
+    }
+    // One-byte character (0X00 to 0X7F) can never be overlong
+    return 0;
+}
+
+// Function to check if a given code point is valid
+//does not exceed maximum value in Unicode
+int is_valid_code_point(unsigned int code_point) {
+    return !is_surrogate(code_point) && code_point <= 0x10FFFF;
+}
+
+// Reports an error code from utf8_check_scalar_at together with where it happened
+static int utf8_check_error(int code, size_t offset, size_t *errorOffset) {
+    if (errorOffset != NULL) {
+        *errorOffset = offset;
+    }
+    return code;
+}
+
+// Error code of the character at the start of string (0 if it is valid): -1 invalid lead byte,
+// -2 invalid or missing continuation byte, -3 overlong encoding, -4 invalid code point,
+// -5 unexpected continuation byte. Only asked once the automaton has found a bad character.
+static int utf8_character_error(const unsigned char *string, const unsigned char *end) {
+    unsigned char lead_byte = *string;
+    if (!is_start_byte(lead_byte)) {
+        return -5; // Unexpected continuation byte
+    }
+
+    // Determine the number of bytes for this character
+    int num_bytes = 0;
+    unsigned int code_point = 0;
+    if ((lead_byte & 0x80) == 0) {
+        num_bytes = 1; // 1-byte character
+        code_point = lead_byte;
+    } else if ((lead_byte & 0xE0) == 0xC0) {
+        num_bytes = 2; // 2-byte character
+        code_point = lead_byte & 0x1F;
+    } else if ((lead_byte & 0xF0) == 0xE0) {
+        num_bytes = 3; // 3-byte character
+        code_point = lead_byte & 0x0F;
+    } else if ((lead_byte & 0xF8) == 0xF0) {
+        num_bytes = 4; // 4-byte character
+        code_point = lead_byte & 0x07;
+    } else {
+        return -1; // Invalid lead byte
+    }
+
+    // Check continuation bytes - running off the end of the buffer counts as a missing one
+    for (int i = 1; i < num_bytes; i++) {
+        if (string + i >= end || !is_continuation_byte(string[i])) {
+            return -2; // Invalid continuation byte
+        }
+    }
+
+    // Decode the code point (payload bits of the lead byte were taken above)
+    for (int i = 1; i < num_bytes; i++) {
+        code_point = (code_point << 6) | (string[i] & 0x3F);
+    }
+
+    // Check for overlong encoding
+    if (is_overlong_encoding(lead_byte, code_point)) {
+        return -3; // Overlong encoding
+    }
+
+    // Check if the code point is valid
+    if (!is_valid_code_point(code_point)) {
+        return -4; // Invalid code point
+    }
+    return 0;
+}
+
+// Scalar validator over a buffer of known length - the reference behaviour for all the SIMD kernels
+// below, and what they fall back to when they need the exact error code. If errorOffset is set it
+// receives the offset of the first byte of the bad character (len when the buffer is valid).
+// The automaton runs over the bytes without looking at lead bytes; only when it rejects (or ends in
+// the middle of a character) is that one character classified for the error code.
+static int utf8_check_scalar_at(const unsigned char *string, size_t len, size_t *errorOffset) {
+    unsigned int state = UTF8_DFA_ACCEPT;
+    size_t start = 0; // first byte of the character being read
+    for (size_t i = 0; i < len; i++) {
+        state = utf8_dfa_transition[state + utf8_dfa_class[string[i]]];
+        if (state == UTF8_DFA_REJECT) {
+            break;
+        }
+        start = (state == UTF8_DFA_ACCEPT) ? i + 1 : start;
+    }
+
+    if (state == UTF8_DFA_ACCEPT) {
+        return utf8_check_error(0, len, errorOffset); // Valid UTF-8 string
+    }
+    return utf8_check_error(utf8_character_error(string + start, string + len), start, errorOffset);
+}
+
+static int utf8_check_scalar(const unsigned char *string, size_t len) {
+    return utf8_check_scalar_at(string, len, NULL);
+}
+
+// Re-runs the scalar validator from 'pos' to the end of the buffer. If a multi-byte character
+// starts in the last 3 bytes before 'pos' we step back to its lead byte so it is checked as a whole.
+// Used by the SIMD kernels for the tail and for the block in which they detected an error, which is
+// why finding the error offset costs nothing on the way there: the scalar code only ever starts at
+// most 3 bytes before the failing block and stops at the first bad character.
+static int utf8_check_from(const unsigned char *string, size_t len, size_t pos, size_t *errorOffset) {
+    size_t start = pos;
+    for (size_t k = 1; k <= 3 && k <= pos; k++) {
+        unsigned char byte = string[pos - k];
+        if (!is_continuation_byte(byte)) {
+            if (byte >= 0xC0) {
+                start = pos - k;
+            }
+            break;
+        }
+    }
+    int result = utf8_check_scalar_at(string + start, len - start, errorOffset);
+    if (errorOffset != NULL) {
+        *errorOffset += start;
+    }
+    return result;
+}
+
+#ifdef UTF8_X86_SIMD
+/* Vectorized validation using the "lookup" algorithm (Keiser & Lemire, "Validating UTF-8 In Less
+ * Than One Instruction Per Byte"). Every byte is classified together with the byte before it using
+ * three 16-entry nibble tables; any bit that survives the AND of the three lookups is an error.
+ * The kernels only answer valid/invalid per block - the exact -1..-5 code comes from the scalar code. */
+#define UTF8_TOO_SHORT (1 << 0)      // lead byte not followed by enough continuation bytes
+#define UTF8_TOO_LONG (1 << 1)       // ASCII followed by a continuation byte
+#define UTF8_OVERLONG_3 (1 << 2)     // 11100000 100xxxxx
+#define UTF8_TOO_LARGE (1 << 3)      // above U+10FFFF
+#define UTF8_SURROGATE (1 << 4)      // 11101101 101xxxxx
+#define UTF8_OVERLONG_2 (1 << 5)     // 1100000x 10xxxxxx
+#define UTF8_TOO_LARGE_1000 (1 << 6) // 11110101+ 1000xxxx
+#define UTF8_OVERLONG_4 (1 << 6)     // 11110000 1000xxxx
+#define UTF8_TWO_CONTS (1 << 7)      // two continuation bytes where the first was not expected to continue
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+// indexed by the high nibble of the previous byte
+static const unsigned char utf8_byte_1_high[16] = {
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+};
+
+// indexed by the low nibble of the previous byte
+static const unsigned char utf8_byte_1_low[16] = {
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        UTF8_CARRY,
+        UTF8_CARRY,
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+};
+
+// indexed by the high nibble of the current byte
+static const unsigned char utf8_byte_2_high[16] = {
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+
+// a block is incomplete if one of its last 3 bytes starts a character that does not fit in it
+static const unsigned char utf8_max_incomplete[64] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1
+};
+
+__attribute__((target("sse4.2")))
+static int utf8_check_sse42(const unsigned char *string, size_t len, size_t *errorOffset) {
+    const __m128i byte_1_high = _mm_loadu_si128((const __m128i *)utf8_byte_1_high);
+    const __m128i byte_1_low = _mm_loadu_si128((const __m128i *)utf8_byte_1_low);
+    const __m128i byte_2_high = _mm_loadu_si128((const __m128i *)utf8_byte_2_high);
+    const __m128i max_incomplete = _mm_loadu_si128((const __m128i *)(utf8_max_incomplete + 48));
+    const __m128i low_nibble = _mm_set1_epi8(0x0F);
+    __m128i prev = _mm_setzero_si128();
+    __m128i prev_incomplete = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i *)(string + i));
+        __m128i error;
+        if (_mm_movemask_epi8(input) == 0) {
+            // all ASCII - only a character left open by the previous block can be wrong
+            error = prev_incomplete;
+            prev_incomplete = _mm_setzero_si128();
+        } else {
+            __m128i prev1 = _mm_alignr_epi8(input, prev, 15);
+            __m128i special = _mm_and_si128(
+                    _mm_and_si128(_mm_shuffle_epi8(byte_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), low_nibble)),
+                                  _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, low_nibble))),
+                    _mm_shuffle_epi8(byte_2_high, _mm_and_si128(_mm_srli_epi16(input, 4), low_nibble)));
+            // bytes 2 or 3 places after a 3/4-byte lead must be continuation bytes
+            __m128i must_continue = _mm_or_si128(
+                    _mm_subs_epu8(_mm_alignr_epi8(input, prev, 14), _mm_set1_epi8((char)(0xE0 - 0x80))),
+                    _mm_subs_epu8(_mm_alignr_epi8(input, prev, 13), _mm_set1_epi8((char)(0xF0 - 0x80))));
+            error = _mm_xor_si128(_mm_and_si128(must_continue, _mm_set1_epi8((char)0x80)), special);
+            prev_incomplete = _mm_subs_epu8(input, max_incomplete);
+        }
+        if (!_mm_testz_si128(error, error)) {
+            break;
+        }
+        prev = input;
+    }
+    return utf8_check_from(string, len, i, errorOffset);
+}
+
+// shifts 'n' bytes of the previous 32-byte block in front of the current one
+#define UTF8_AVX2_PREV(input, prev, n) \
+    _mm256_alignr_epi8((input), _mm256_permute2x128_si256((prev), (input), 0x21), 16 - (n))
+
+__attribute__((target("avx2")))
+static int utf8_check_avx2(const unsigned char *string, size_t len, size_t *errorOffset) {
+    const __m256i byte_1_high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)utf8_byte_1_high));
+    const __m256i byte_1_low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)utf8_byte_1_low));
+    const __m256i byte_2_high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)utf8_byte_2_high));
+    const __m256i max_incomplete = _mm256_loadu_si256((const __m256i *)(utf8_max_incomplete + 32));
+    const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+    __m256i prev = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(string + i));
+        __m256i error;
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = prev_incomplete;
+            prev_incomplete = _mm256_setzero_si256();
+        } else {
+            __m256i prev1 = UTF8_AVX2_PREV(input, prev, 1);
+            __m256i special = _mm256_and_si256(
+                    _mm256_and_si256(
+                            _mm256_shuffle_epi8(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble)),
+                            _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, low_nibble))),
+                    _mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(input, 4), low_nibble)));
+            __m256i must_continue = _mm256_or_si256(
+                    _mm256_subs_epu8(UTF8_AVX2_PREV(input, prev, 2), _mm256_set1_epi8((char)(0xE0 - 0x80))),
+                    _mm256_subs_epu8(UTF8_AVX2_PREV(input, prev, 3), _mm256_set1_epi8((char)(0xF0 - 0x80))));
+            error = _mm256_xor_si256(_mm256_and_si256(must_continue, _mm256_set1_epi8((char)0x80)), special);
+            prev_incomplete = _mm256_subs_epu8(input, max_incomplete);
+        }
+        if (!_mm256_testz_si256(error, error)) {
+            break;
+        }
+        prev = input;
+    }
+    // the scalar tail and the caller may run legacy SSE code: clear the upper halves first
+    _mm256_zeroupper();
+    return utf8_check_from(string, len, i, errorOffset);
+}
+
+// same as UTF8_AVX2_PREV for 64-byte blocks: move the previous block's top 16 bytes under the current one
+#define UTF8_AVX512_PREV(input, prev, n) \
+    _mm512_alignr_epi8((input), _mm512_permutex2var_epi64((prev), _mm512_set_epi64(13, 12, 11, 10, 9, 8, 7, 6), (input)), 16 - (n))
+
+__attribute__((target("avx512f,avx512bw")))
+static int utf8_check_avx512(const unsigned char *string, size_t len, size_t *errorOffset) {
+    const __m512i byte_1_high = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)utf8_byte_1_high));
+    const __m512i byte_1_low = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)utf8_byte_1_low));
+    const __m512i byte_2_high = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)utf8_byte_2_high));
+    const __m512i max_incomplete = _mm512_loadu_si512((const void *)utf8_max_incomplete);
+    const __m512i low_nibble = _mm512_set1_epi8(0x0F);
+    __m512i prev = _mm512_setzero_si512();
+    __m512i prev_incomplete = _mm512_setzero_si512();
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        __m512i input = _mm512_loadu_si512((const void *)(string + i));
+        __m512i error;
+        if (_mm512_movepi8_mask(input) == 0) {
+            error = prev_incomplete;
+            prev_incomplete = _mm512_setzero_si512();
+        } else {
+            __m512i prev1 = UTF8_AVX512_PREV(input, prev, 1);
+            __m512i special = _mm512_and_si512(
+                    _mm512_and_si512(
+                            _mm512_shuffle_epi8(byte_1_high, _mm512_and_si512(_mm512_srli_epi16(prev1, 4), low_nibble)),
+                            _mm512_shuffle_epi8(byte_1_low, _mm512_and_si512(prev1, low_nibble))),
+                    _mm512_shuffle_epi8(byte_2_high, _mm512_and_si512(_mm512_srli_epi16(input, 4), low_nibble)));
+            __m512i must_continue = _mm512_or_si512(
+                    _mm512_subs_epu8(UTF8_AVX512_PREV(input, prev, 2), _mm512_set1_epi8((char)(0xE0 - 0x80))),
+                    _mm512_subs_epu8(UTF8_AVX512_PREV(input, prev, 3), _mm512_set1_epi8((char)(0xF0 - 0x80))));
+            error = _mm512_xor_si512(_mm512_and_si512(must_continue, _mm512_set1_epi8((char)0x80)), special);
+            prev_incomplete = _mm512_subs_epu8(input, max_incomplete);
+        }
+        if (_mm512_test_epi8_mask(error, error) != 0) {
+            break;
+        }
+        prev = input;
+    }
+    _mm256_zeroupper(); // clears the upper ZMM state too
+    return utf8_check_from(string, len, i, errorOffset);
+}
+#endif
+
+typedef int (*utf8_check_fn)(const unsigned char *, size_t, size_t *);
+
+// Picks the validation kernel for this CPU on the first call. If errorOffset is set it receives the
+// offset of the first byte of the first bad character (len when the buffer is valid).
+static int utf8_validate_at(const unsigned char *string, size_t len, size_t *errorOffset) {
+    static utf8_check_fn check = NULL;
+    if (check == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                check = utf8_check_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                check = utf8_check_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                check = utf8_check_sse42;
+                break;
+#endif
+            default:
+                check = utf8_check_scalar_at;
+        }
+    }
+    return check(string, len, errorOffset);
+}
+
+static int utf8_validate(const unsigned char *string, size_t len) {
+    return utf8_validate_at(string, len, NULL);
+}
+
+// Length-delimited version of my_utf8_check - same result codes
+int my_utf8_check_n(const uint8_t *buf, size_t len) {
+    return utf8_validate(buf, len);
+}
+
+// Function to check if a UTF-8 string is valid
+//0 for valid, otherwise the error code of the first bad character:
+//-1 invalid lead byte, -2 invalid continuation byte, -3 overlong encoding, -4 invalid code point,
+//-5 unexpected continuation byte
+int my_utf8_check(unsigned char *string) {
+    return my_utf8_check_n(string, strlen((const char *)string));
+}
+
+// Length of the bad sequence at the start of buf (len > 0), cut the way Unicode's "maximal subpart"
+// practice and the WHATWG decoder cut it: the longest start of a character that could still have
+// been valid, or the single byte when that byte can't start one. One U+FFFD replaces exactly this.
+static size_t utf8_maximal_subpart(const uint8_t *buf, size_t len) {
+    unsigned int state = UTF8_DFA_ACCEPT;
+    size_t i = 0;
+    for (; i < len && i < 4; i++) {
+        state = utf8_dfa_transition[state + utf8_dfa_class[buf[i]]];
+        if (state == UTF8_DFA_REJECT || state == UTF8_DFA_ACCEPT) {
+            break;
+        }
+    }
+    return (i > 0) ? i : 1;
+}
+
+// Fills *error for a bad character at 'offset' (status 0 and offset len for none)
+static void utf8_error_at(const uint8_t *buf, size_t len, int status, size_t offset, size_t index,
+                          my_utf8_error *error) {
+    error->status = status;
+    error->offset = offset;
+    error->index = index;
+    error->length = (status != 0) ? utf8_maximal_subpart(buf + offset, len - offset) : 0;
+}
+
+// my_utf8_check_n that also says where: *error gets the result code, the byte offset of the first
+// byte of the first bad character (len for valid input), its code point index (the number of
+// characters in front of it, 0 for valid input) and the length of the bad sequence. The vectorized
+// check runs as it always does and only the block it fails in is looked at byte by byte; only once a
+// failure is known is the index counted over the valid prefix, so valid input costs one pass.
+int my_utf8_check_located(const uint8_t *buf, size_t len, my_utf8_error *error) {
+    size_t offset = len;
+    int status = utf8_validate_at(buf, len, &offset);
+    utf8_error_at(buf, len, status, offset, (status != 0) ? utf8_count(buf, offset) : 0, error);
+    return status;
+}
+
+// All-errors mode for quarantine reports: finds every bad sequence in one pass. The first 'capacity'
+// of them go to errors[] (located as in my_utf8_check_located) and the return value is how many
+// there are in all, so 0 means valid. After a bad sequence the check resumes right behind it; every
+// bad sequence counts as one character in the index, as its U+FFFD does in lossy decoding.
+size_t my_utf8_check_all(const uint8_t *buf, size_t len, my_utf8_error *errors, size_t capacity) {
+    size_t found = 0;
+    size_t pos = 0;
+    size_t index = 0;
+    while (pos < len) {
+        size_t offset;
+        int status = utf8_validate_at(buf + pos, len - pos, &offset);
+        if (status == 0) {
+            break;
+        }
+        offset += pos;
+        index += utf8_count(buf + pos, offset - pos);
+        my_utf8_error error;
+        utf8_error_at(buf, len, status, offset, index, &error);
+        if (found < capacity) {
+            errors[found] = error;
+        }
+        found++;
+        index++;
+        pos = offset + error.length;
+    }
+    return found;
+}
+
+/* Lossy repair: invalid input is rewritten as valid UTF-8 with every bad sequence replaced by U+FFFD,
+ * cut the way the WHATWG decoder cuts it (one U+FFFD per maximal subpart, see utf8_maximal_subpart).
+ * Valid stretches are found with the vectorized check and copied with memmove, a chunk at a time so the
+ * copy reads what the check has just brought into the cache. A replacement covers at most three bytes
+ * and is three bytes long, so the repaired text is never shorter than the input. */
+#define UTF8_REPAIR_CHUNK (16u << 10)
+
+static const uint8_t utf8_replacement[3] = {0xEF, 0xBF, 0xBD}; // U+FFFD
+
+// The repair loop. Writes to output while the result fits in capacity and returns its full size.
+// output may overlap buf as long as it never gets ahead of the byte being read (in-place repair).
+static size_t utf8_repair_run(const uint8_t *buf, size_t len, uint8_t *output, size_t capacity, size_t *replaced,
+                              int *stopped) {
+    size_t pos = 0;
+    size_t size = 0;
+    while (pos < len) {
+        size_t chunk = (len - pos < UTF8_REPAIR_CHUNK) ? len - pos : UTF8_REPAIR_CHUNK;
+        size_t run;
+        int status = utf8_validate_at(buf + pos, chunk, &run);
+        size_t bad = 0;
+        if (pos + chunk < len && chunk - run < 4) {
+            // a character may be cut by the end of the chunk: leave it to the next chunk
+            while (run > 0 && chunk - run < 4 && (buf[pos + run] & 0xC0) == 0x80) {
+                run--;
+            }
+        } else if (status != 0) {
+            bad = utf8_maximal_subpart(buf + pos + run, len - pos - run);
+        }
+
+        if (!*stopped) {
+            size_t copy = run;
+            if (run > capacity - size) {
+                // only whole characters go out
+                copy = capacity - size;
+                while (copy > 0 && (buf[pos + copy] & 0xC0) == 0x80) {
+                    copy--;
+                }
+                *stopped = 1;
+            }
+            if (copy > 0) {
+                memmove(output + size, buf + pos, copy);
+            }
+        }
+        size += run;
+        pos += run;
+
+        if (bad > 0) {
+            if (!*stopped && capacity - size >= sizeof(utf8_replacement)) {
+                memcpy(output + size, utf8_replacement, sizeof(utf8_replacement));
+            } else {
+                *stopped = 1;
+            }
+            size += sizeof(utf8_replacement);
+            pos += bad;
+            (*replaced)++;
+        }
+    }
+    return size;
+}
+
+// Repairs len bytes of buf into output (which must not overlap it): valid text is copied as it is and
+// every invalid sequence becomes U+FFFD. *written gets the size of the repaired text whether or not it
+// fits (at most 3 * len), *replaced (if set) the number of replacements. Returns 0, or -6 if the output
+// is too small (it then holds the start of the result, cut at a character boundary).
+int my_utf8_repair(const uint8_t *buf, size_t len, uint8_t *output, size_t capacity, size_t *written,
+                   size_t *replaced) {
+    size_t count = 0;
+    int stopped = 0;
+    *written = utf8_repair_run(buf, len, output, capacity, &count, &stopped);
+    if (replaced != NULL) {
+        *replaced = count;
+    }
+    return stopped ? -6 : 0;
+}
+
+// my_utf8_repair in place: buf holds len bytes of input and has room for capacity bytes. Valid input is
+// not touched at all. Otherwise the size of the result is worked out first; if it fits, the part behind
+// the first error is moved to the end of the room it needs and repaired forward from there into place, so
+// the output never overtakes the input. Returns 0, or -6 (buf unchanged) if the result is longer than
+// capacity; *written and *replaced as for my_utf8_repair.
+int my_utf8_repair_in_place(uint8_t *buf, size_t len, size_t capacity, size_t *written, size_t *replaced) {
+    size_t first;
+    size_t count = 0;
+    int stopped = 0;
+    if (utf8_validate_at(buf, len, &first) == 0) {
+        *written = len;
+    } else {
+        int counting = 0;
+        size_t size = first + utf8_repair_run(buf + first, len - first, NULL, 0, &count, &counting);
+        *written = size;
+        if (size > capacity) {
+            stopped = 1;
+        } else {
+            size_t growth = size - len;
+            memmove(buf + first + growth, buf + first, len - first);
+            count = 0;
+            utf8_repair_run(buf + first + growth, len - first, buf + first, size - first, &count, &stopped);
+        }
+    }
+    if (replaced != NULL) {
+        *replaced = count;
+    }
+    return stopped ? -6 : 0;
+}
+
+// Validating version of my_utf8_strcmp_n. *status gets 0 if both strings are valid UTF-8, otherwise
+// the my_utf8_check code of the first invalid one. The result is the byte order (-1, 0 or 1) either
+// way, which is the code point order for valid strings and still a consistent order for sorting
+// input that is not.
+int my_utf8_strcmp_checked(const uint8_t *buf1, size_t len1, const uint8_t *buf2, size_t len2, int *status) {
+    *status = utf8_validate(buf1, len1);
+    if (*status == 0) {
+        *status = utf8_validate(buf2, len2);
+    }
+
+    size_t shorter = (len1 < len2) ? len1 : len2;
+    size_t i = utf8_mismatch(buf1, buf2, shorter);
+    if (i == shorter) {
+        return (len1 == len2) ? 0 : (len1 < len2) ? -1 : 1;
+    }
+    return (buf1[i] < buf2[i]) ? -1 : 1;
+}
+
+/* Streaming API: data that arrives in chunks (socket reads, fixed-size file buffers) is validated or
+ * decoded one chunk at a time. A character cut by the end of a chunk is kept in the state and finished
+ * with the next chunk, so feeding the chunks gives exactly the result of one call on the whole input. */
+
+void my_utf8_stream_init(my_utf8_stream *state) {
+    state->pendingLength = 0;
+    state->status = 0;
+}
+
+// Number of bytes at the end of buf that belong to a character it cuts off: the lead byte of a
+// multi-byte character that does not fit, plus the continuation bytes after it
+static size_t utf8_cut_tail(const uint8_t *buf, size_t len) {
+    for (size_t k = 1; k <= 3 && k <= len; k++) {
+        unsigned char byte = buf[len - k];
+        if (!is_continuation_byte(byte)) {
+            return (byte >= 0xC0 && (size_t)utf8_sequence_length(byte) > k) ? k : 0;
+        }
+    }
+    return 0;
+}
+
+// Moves the bytes at the end of a chunk into the state's pending buffer
+static void utf8_stream_keep(my_utf8_stream *state, const uint8_t *bytes, size_t count) {
+    memcpy(state->pending + state->pendingLength, bytes, count);
+    state->pendingLength += (int)count;
+}
+
+// Validates the next chunk. Returns 0 if everything fed so far is valid (or may still become valid
+// once the cut character is finished), otherwise the my_utf8_check code of the first error.
+int my_utf8_check_feed(my_utf8_stream *state, const uint8_t *chunk, size_t len) {
+    if (state->status != 0) {
+        return state->status;
+    }
+
+    if (state->pendingLength > 0) {
+        // Finish the character left over from the last chunk first
+        size_t missing = (size_t)(utf8_sequence_length(state->pending[0]) - state->pendingLength);
+        size_t taken = 0;
+        while (taken < missing && taken < len && is_continuation_byte(chunk[taken])) {
+            taken++;
+        }
+        if (taken < missing && taken == len) {
+            utf8_stream_keep(state, chunk, taken); // still not complete - wait for more
+            return 0;
+        }
+        if (taken < missing) {
+            taken++; // include the byte that broke the character, so the scalar check sees it
+        }
+        uint8_t character[4];
+        memcpy(character, state->pending, (size_t)state->pendingLength);
+        memcpy(character + state->pendingLength, chunk, taken);
+        state->status = utf8_check_scalar(character, (size_t)state->pendingLength + taken);
+        state->pendingLength = 0;
+        if (state->status != 0) {
+            return state->status;
+        }
+        chunk += taken;
+        len -= taken;
+    }
+
+    size_t tail = utf8_cut_tail(chunk, len);
+    state->status = utf8_validate(chunk, len - tail);
+    if (state->status == 0) {
+        utf8_stream_keep(state, chunk + len - tail, tail);
+    }
+    return state->status;
+}
+
+// Ends a checked stream: returns the final my_utf8_check code. A character still cut off at the end
+// is -2, the same as my_utf8_check_n on the whole input.
+int my_utf8_check_finish(my_utf8_stream *state) {
+    if (state->status == 0 && state->pendingLength > 0) {
+        state->status = -2;
+    }
+    state->pendingLength = 0;
+    return state->status;
+}
+
+// Decodes the next chunk like my_utf8_decode_n and returns the number of bytes written to output.
+// A character cut off by the end of the chunk is written by a later feed (or by finish).
+size_t my_utf8_decode_feed(my_utf8_stream *state, const uint8_t *chunk, size_t len, uint8_t *output) {
+    size_t written = 0;
+
+    if (state->pendingLength > 0) {
+        // Decode the character left over from the last chunk together with the first bytes of this one.
+        // Four more bytes always finish it (or show that it is broken), and anything decoded past it
+        // was going to be decoded from the chunk anyway.
+        size_t pending = (size_t)state->pendingLength;
+        size_t taken = (len < 4) ? len : 4;
+        uint8_t joined[8];
+        memcpy(joined, state->pending, pending);
+        memcpy(joined + pending, chunk, taken);
+        size_t used;
+        written = utf8_decode_run(joined, pending + taken, output, &used);
+        state->pendingLength = 0;
+        if (used < pending) {
+            // still not complete, so the whole chunk was part of it - wait for more
+            utf8_stream_keep(state, joined + used, pending + taken - used);
+            return written;
+        }
+        chunk += used - pending;
+        len -= used - pending;
+    }
+
+    size_t consumed;
+    written += utf8_decode_run(chunk, len, output + written, &consumed);
+    utf8_stream_keep(state, chunk + consumed, len - consumed);
+    return written;
+}
+
+// Ends a decoded stream: a character still cut off at the end is copied through as invalid bytes,
+// like my_utf8_decode_n does. Returns the number of bytes written to output.
+size_t my_utf8_decode_finish(my_utf8_stream *state, uint8_t *output) {
+    size_t written = my_utf8_decode_n(state->pending, (size_t)state->pendingLength, output);
+    state->pendingLength = 0;
+    return written;
+}
+
+/* Output sizes and bounded encode/decode. The size queries return exactly what my_utf8_encode_n /
+ * my_utf8_decode_n would write, so the output can be allocated once; the bounded variants never
+ * write more than 'capacity' bytes, stop in front of the first character that would not fit, and
+ * report how much of the input they used so the caller can continue from there. */
+
+// Length of the escape appendUnicodeEscape writes for a code point
+static size_t utf8_escape_length(unsigned int codePoint) {
+    size_t digits = 4;
+    while (digits < 8 && (codePoint >> (4 * digits)) != 0) {
+        digits++;
+    }
+    return 2 + digits;
+}
+
+// Decoded size of valid UTF-8, one weight per byte: ASCII 1, continuation bytes 0, 2 and 3-byte
+// leads 6 (\uXXXX), F0-F3 leads 7 (five hex digits) and F4 leads 8 (six digits). Counting the bytes
+// at or above 0x80, 0xC0, 0xF0 and 0xF4 is enough: size = len - n80 + 6 * nC0 + nF0 + nF4.
+static size_t utf8_escaped_size_scalar(const uint8_t *buf, size_t len) {
+    size_t size = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = buf[i];
+        size += (byte < 0x80) ? 1 : (byte < 0xC0) ? 0 : (byte < 0xF0) ? 6 : (byte < 0xF4) ? 7 : 8;
+    }
+    return size;
+}
+
+#ifdef UTF8_X86_SIMD
+// byte >= threshold (unsigned) is max(byte, threshold) == byte
+#define UTF8_SSE_AT_LEAST(input, threshold) \
+    (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8((input), (threshold)), (input)))
+#define UTF8_AVX2_AT_LEAST(input, threshold) \
+    (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8((input), (threshold)), (input)))
+
+__attribute__((target("sse4.2,popcnt")))
+static size_t utf8_escaped_size_sse42(const uint8_t *buf, size_t len) {
+    const __m128i t80 = _mm_set1_epi8((char)0x80);
+    const __m128i tC0 = _mm_set1_epi8((char)0xC0);
+    const __m128i tF0 = _mm_set1_epi8((char)0xF0);
+    const __m128i tF4 = _mm_set1_epi8((char)0xF4);
+    size_t size = 0;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i *)(buf + i));
+        size += 16 - (size_t)_mm_popcnt_u32(UTF8_SSE_AT_LEAST(input, t80)) +
+                6 * (size_t)_mm_popcnt_u32(UTF8_SSE_AT_LEAST(input, tC0)) +
+                (size_t)_mm_popcnt_u32(UTF8_SSE_AT_LEAST(input, tF0)) +
+                (size_t)_mm_popcnt_u32(UTF8_SSE_AT_LEAST(input, tF4));
+    }
+    return size + utf8_escaped_size_scalar(buf + i, len - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t utf8_escaped_size_avx2(const uint8_t *buf, size_t len) {
+    const __m256i t80 = _mm256_set1_epi8((char)0x80);
+    const __m256i tC0 = _mm256_set1_epi8((char)0xC0);
+    const __m256i tF0 = _mm256_set1_epi8((char)0xF0);
+    const __m256i tF4 = _mm256_set1_epi8((char)0xF4);
+    size_t size = 0;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(buf + i));
+        size += 32 - (size_t)_mm_popcnt_u32(UTF8_AVX2_AT_LEAST(input, t80)) +
+                6 * (size_t)_mm_popcnt_u32(UTF8_AVX2_AT_LEAST(input, tC0)) +
+                (size_t)_mm_popcnt_u32(UTF8_AVX2_AT_LEAST(input, tF0)) +
+                (size_t)_mm_popcnt_u32(UTF8_AVX2_AT_LEAST(input, tF4));
+    }
+    return size + utf8_escaped_size_scalar(buf + i, len - i);
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+static size_t utf8_escaped_size_avx512(const uint8_t *buf, size_t len) {
+    const __m512i t80 = _mm512_set1_epi8((char)0x80);
+    const __m512i tC0 = _mm512_set1_epi8((char)0xC0);
+    const __m512i tF0 = _mm512_set1_epi8((char)0xF0);
+    const __m512i tF4 = _mm512_set1_epi8((char)0xF4);
+    size_t size = 0;
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i input = _mm512_loadu_si512((const void *)(buf + i));
+        size += 64 - (size_t)_mm_popcnt_u64(_mm512_cmpge_epu8_mask(input, t80)) +
+                6 * (size_t)_mm_popcnt_u64(_mm512_cmpge_epu8_mask(input, tC0)) +
+                (size_t)_mm_popcnt_u64(_mm512_cmpge_epu8_mask(input, tF0)) +
+                (size_t)_mm_popcnt_u64(_mm512_cmpge_epu8_mask(input, tF4));
+    }
+    return size + utf8_escaped_size_scalar(buf + i, len - i);
+}
+#endif
+
+// Picks the decoded-size kernel for this CPU on the first call
+static size_t utf8_escaped_size(const uint8_t *buf, size_t len) {
+    static utf8_count_fn size = NULL;
+    if (size == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                size = utf8_escaped_size_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                size = utf8_escaped_size_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                size = utf8_escaped_size_sse42;
+                break;
+#endif
+            default:
+                size = utf8_escaped_size_scalar;
+        }
+    }
+    return size(buf, len);
+}
+
+// Exact number of bytes my_utf8_decode_n writes for this input (without a terminator)
+size_t my_utf8_decode_size(const uint8_t *buf, size_t len) {
+    if (utf8_validate(buf, len) == 0) {
+        return utf8_escaped_size(buf, len);
+    }
+
+    // Invalid input: follow the decode loop character by character
+    size_t size = 0;
+    size_t i = 0;
+    while (i < len) {
+        unsigned int codePoint;
+        int bytes = utf8_dfa_next(buf + i, len - i, &codePoint);
+        if (bytes > 1) {
+            size += utf8_escape_length(codePoint);
+            i += (size_t)bytes;
+        } else {
+            size += 1; // ASCII, or a byte copied through
+            i += 1;
+        }
+    }
+    return size;
+}
+
+// Exact number of bytes my_utf8_encode_n writes for this input (without a terminator)
+size_t my_utf8_encode_size(const uint8_t *buf, size_t len) {
+    const uint8_t *end = buf + len;
+    size_t size = 0;
+    while (buf < end) {
+        // plain bytes up to the next backslash are copied one to one
+        const uint8_t *backslash = memchr(buf, '\\', (size_t)(end - buf));
+        if (backslash == NULL) {
+            return size + (size_t)(end - buf);
+        }
+        size += (size_t)(backslash - buf);
+        buf = backslash;
+
+        unsigned int codePoint;
+        size_t escapeLength = utf8_parse_escape(buf, (size_t)(end - buf), &codePoint);
+        if (escapeLength > 0) {
+            uint8_t character[4];
+            size += utf8_encode_code_point(codePoint, character);
+            buf += escapeLength;
+        } else {
+            size += 1;
+            buf += 1;
+        }
+    }
+    return size;
+}
+
+// my_utf8_decode_n that writes at most 'capacity' bytes. Whole escapes only: it stops in front of the
+// first character whose escape does not fit. Returns the bytes written; *consumed gets the number of
+// input bytes decoded. No terminator is written.
+size_t my_utf8_decode_bounded(const uint8_t *buf, size_t len, uint8_t *output, size_t capacity, size_t *consumed) {
+    size_t written = 0;
+    size_t pos = 0;
+
+    // Every input byte decodes to at most three output bytes, so slices of a third of the free space
+    // always fit. A slice ends in front of a cut character unless it reaches the end of the input.
+    while (pos < len && (capacity - written) / 3 >= 4) {
+        size_t slice = (capacity - written) / 3;
+        if (slice >= len - pos) {
+            written += utf8_decode_run(buf + pos, len - pos, output + written, NULL);
+            pos = len;
+            break;
+        }
+        size_t used;
+        written += utf8_decode_run(buf + pos, slice, output + written, &used);
+        pos += used;
+    }
+
+    // Close to the end of the space: one character at a time, as long as its escape fits
+    while (pos < len) {
+        size_t unit = utf8_decode_unit(buf + pos, len - pos);
+        uint8_t escape[16];
+        size_t length = utf8_decode_run(buf + pos, unit, escape, NULL);
+        if (length > capacity - written) {
+            break;
+        }
+        memcpy(output + written, escape, length);
+        written += length;
+        pos += unit;
+    }
+
+    *consumed = pos;
+    return written;
+}
+
+// my_utf8_encode_n that writes at most 'capacity' bytes, stopping in front of the first character
+// that does not fit. Returns the bytes written; *consumed gets the number of input bytes converted.
+// No terminator is written.
+size_t my_utf8_encode_bounded(const uint8_t *buf, size_t len, uint8_t *output, size_t capacity, size_t *consumed) {
+    const uint8_t *start = buf;
+    const uint8_t *end = buf + len;
+    size_t written = 0;
+
+    while (buf < end && written < capacity) {
+        if (*buf != '\\') {
+            const uint8_t *backslash = memchr(buf, '\\', (size_t)(end - buf));
+            size_t run = (size_t)((backslash != NULL ? backslash : end) - buf);
+            if (run > capacity - written) {
+                run = capacity - written;
+            }
+            memcpy(output + written, buf, run);
+            written += run;
+            buf += run;
+            continue;
+        }
+        unsigned int codePoint;
+        size_t escapeLength = utf8_parse_escape(buf, (size_t)(end - buf), &codePoint);
+        if (escapeLength > 0) {
+            uint8_t character[4];
+            size_t length = utf8_encode_code_point(codePoint, character);
+            if (length > capacity - written) {
+                break;
+            }
+            memcpy(output + written, character, length);
+            written += length;
+            buf += escapeLength;
+        } else {
+            output[written++] = *buf++;
+        }
+    }
+
+    *consumed = (size_t)(buf - start);
+    return written;
+}
+
+/* UTF-16 transcoding, for consumers (Windows APIs, Java, JavaScript) that want UTF-16 rather than
+ * escaped text. UTF-16 is read and written as 16-bit units in the byte order asked for, whatever
+ * the byte order of the machine. Both directions validate: UTF-8 input with the same rules and error
+ * codes as my_utf8_check, UTF-16 input for unpaired surrogates. Runs of ASCII, the bulk of most text,
+ * are widened or narrowed 16 to 64 characters at a time by the SIMD kernels; the rest goes through
+ * the automaton (UTF-8) or the surrogate checks (UTF-16) one character at a time. */
+
+// Reads unit i of a UTF-16 buffer in the given byte order
+static inline unsigned int utf16_load(const uint16_t *units, size_t i, int bigEndian) {
+    const uint8_t *bytes = (const uint8_t *)(units + i);
+    return bigEndian ? ((unsigned int)bytes[0] << 8) | bytes[1] : bytes[0] | ((unsigned int)bytes[1] << 8);
+}
+
+// Writes unit i of a UTF-16 buffer in the given byte order
+static inline void utf16_store(uint16_t *units, size_t i, unsigned int unit, int bigEndian) {
+    uint8_t *bytes = (uint8_t *)(units + i);
+    bytes[bigEndian ? 1 : 0] = (uint8_t)(unit & 0xFF);
+    bytes[bigEndian ? 0 : 1] = (uint8_t)(unit >> 8);
+}
+
+// Widens the ASCII bytes at the start of buf into UTF-16 units and returns how many there were
+static size_t utf8_widen_ascii_scalar(const uint8_t *buf, size_t len, uint16_t *output, int bigEndian) {
+    size_t run = utf8_ascii_prefix_swar(buf, len);
+    for (size_t i = 0; i < run; i++) {
+        utf16_store(output, i, buf[i], bigEndian);
+    }
+    return run;
+}
+
+// Narrows the ASCII units at the start of a UTF-16 buffer into bytes and returns how many there were
+static size_t utf16_narrow_ascii_scalar(const uint16_t *units, size_t count, uint8_t *output, int bigEndian) {
+    size_t i = 0;
+    while (i < count) {
+        unsigned int unit = utf16_load(units, i, bigEndian);
+        if (unit >= 0x80) {
+            break;
+        }
+        output[i++] = (uint8_t)unit;
+    }
+    return i;
+}
+
+#ifdef UTF8_X86_SIMD
+/* Zero-extending a byte to 16 bits gives the little-endian unit; shifting it up by 8 gives the
+ * big-endian one. In the other direction a block is ASCII when no unit has a bit above 0x7F set
+ * (after swapping the two bytes of each unit for big-endian input), and packing keeps the low bytes. */
+__attribute__((target("sse4.2")))
+static size_t utf8_widen_ascii_sse42(const uint8_t *buf, size_t len, uint16_t *output, int bigEndian) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i *)(buf + i));
+        if (_mm_movemask_epi8(input) != 0) {
+            break;
+        }
+        __m128i low = _mm_cvtepu8_epi16(input);
+        __m128i high = _mm_cvtepu8_epi16(_mm_srli_si128(input, 8));
+        if (bigEndian) {
+            low = _mm_slli_epi16(low, 8);
+            high = _mm_slli_epi16(high, 8);
+        }
+        _mm_storeu_si128((__m128i *)(output + i), low);
+        _mm_storeu_si128((__m128i *)(output + i + 8), high);
+    }
+    return i + utf8_widen_ascii_scalar(buf + i, len - i, output + i, bigEndian);
+}
+
+__attribute__((target("sse4.2")))
+static size_t utf16_narrow_ascii_sse42(const uint16_t *units, size_t count, uint8_t *output, int bigEndian) {
+    const __m128i nonAscii = _mm_set1_epi16((short)0xFF80);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i input = _mm_loadu_si128((const __m128i *)(units + i));
+        if (bigEndian) {
+            input = _mm_or_si128(_mm_slli_epi16(input, 8), _mm_srli_epi16(input, 8));
+        }
+        if (!_mm_testz_si128(input, nonAscii)) {
+            break;
+        }
+        _mm_storel_epi64((__m128i *)(output + i), _mm_packus_epi16(input, input));
+    }
+    return i + utf16_narrow_ascii_scalar(units + i, count - i, output + i, bigEndian);
+}
+
+__attribute__((target("avx2")))
+static size_t utf8_widen_ascii_avx2(const uint8_t *buf, size_t len, uint16_t *output, int bigEndian) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(buf + i));
+        if (_mm256_movemask_epi8(input) != 0) {
+            break;
+        }
+        __m256i low = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(input));
+        __m256i high = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(input, 1));
+        if (bigEndian) {
+            low = _mm256_slli_epi16(low, 8);
+            high = _mm256_slli_epi16(high, 8);
+        }
+        _mm256_storeu_si256((__m256i *)(output + i), low);
+        _mm256_storeu_si256((__m256i *)(output + i + 16), high);
+    }
+    return i + utf8_widen_ascii_scalar(buf + i, len - i, output + i, bigEndian);
+}
+
+__attribute__((target("avx2")))
+static size_t utf16_narrow_ascii_avx2(const uint16_t *units, size_t count, uint8_t *output, int bigEndian) {
+    const __m256i nonAscii = _mm256_set1_epi16((short)0xFF80);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(units + i));
+        if (bigEndian) {
+            input = _mm256_or_si256(_mm256_slli_epi16(input, 8), _mm256_srli_epi16(input, 8));
+        }
+        if (!_mm256_testz_si256(input, nonAscii)) {
+            break;
+        }
+        // pack the two 128-bit halves, so the bytes stay in order
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(input), _mm256_extracti128_si256(input, 1));
+        _mm_storeu_si128((__m128i *)(output + i), packed);
+    }
+    return i + utf16_narrow_ascii_scalar(units + i, count - i, output + i, bigEndian);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t utf8_widen_ascii_avx512(const uint8_t *buf, size_t len, uint16_t *output, int bigEndian) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(buf + i));
+        if (_mm256_movemask_epi8(input) != 0) {
+            break;
+        }
+        __m512i units = _mm512_cvtepu8_epi16(input);
+        if (bigEndian) {
+            units = _mm512_slli_epi16(units, 8);
+        }
+        _mm512_storeu_si512((void *)(output + i), units);
+    }
+    return i + utf8_widen_ascii_scalar(buf + i, len - i, output + i, bigEndian);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t utf16_narrow_ascii_avx512(const uint16_t *units, size_t count, uint8_t *output, int bigEndian) {
+    const __m512i nonAscii = _mm512_set1_epi16((short)0xFF80);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m512i input = _mm512_loadu_si512((const void *)(units + i));
+        if (bigEndian) {
+            input = _mm512_or_si512(_mm512_slli_epi16(input, 8), _mm512_srli_epi16(input, 8));
+        }
+        if (_mm512_test_epi16_mask(input, nonAscii) != 0) {
+            break;
+        }
+        _mm256_storeu_si256((__m256i *)(output + i), _mm512_cvtepi16_epi8(input));
+    }
+    return i + utf16_narrow_ascii_scalar(units + i, count - i, output + i, bigEndian);
+}
+#endif
+
+typedef size_t (*utf8_widen_fn)(const uint8_t *, size_t, uint16_t *, int);
+typedef size_t (*utf16_narrow_fn)(const uint16_t *, size_t, uint8_t *, int);
+
+// Picks the widening kernel for this CPU on the first call
+static size_t utf8_widen_ascii(const uint8_t *buf, size_t len, uint16_t *output, int bigEndian) {
+    static utf8_widen_fn widen = NULL;
+    if (widen == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                widen = utf8_widen_ascii_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                widen = utf8_widen_ascii_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                widen = utf8_widen_ascii_sse42;
+                break;
+#endif
+            default:
+                widen = utf8_widen_ascii_scalar;
+        }
+    }
+    return widen(buf, len, output, bigEndian);
+}
+
+// Picks the narrowing kernel for this CPU on the first call
+static size_t utf16_narrow_ascii(const uint16_t *units, size_t count, uint8_t *output, int bigEndian) {
+    static utf16_narrow_fn narrow = NULL;
+    if (narrow == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                narrow = utf16_narrow_ascii_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                narrow = utf16_narrow_ascii_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                narrow = utf16_narrow_ascii_sse42;
+                break;
+#endif
+            default:
+                narrow = utf16_narrow_ascii_scalar;
+        }
+    }
+    return narrow(units, count, output, bigEndian);
+}
+
+// Fills in the optional result of a transcode and returns its status
+static int utf8_transcode_done(my_utf8_transcode_result *result, int status, size_t read, size_t written) {
+    if (result != NULL) {
+        result->status = status;
+        result->read = read;
+        result->written = written;
+    }
+    return status;
+}
+
+// Converts UTF-8 to UTF-16 in the given byte order. 'output' needs room for 'len' units (every
+// byte gives at most one unit). Returns 0, or the my_utf8_check code of the first bad character, in
+// which case everything before it has been converted. 'result' (may be NULL) gets the status, the
+// bytes read and the units written.
+int my_utf8_to_utf16(const uint8_t *buf, size_t len, uint16_t *output, enum my_utf16_byte_order order,
+                     my_utf8_transcode_result *result) {
+    int bigEndian = (order == MY_UTF16_BE);
+    size_t pos = 0;
+    size_t written = 0;
+
+    while (pos < len) {
+        if (buf[pos] < 0x80) {
+            size_t run = utf8_widen_ascii(buf + pos, len - pos, output + written, bigEndian);
+            pos += run;
+            written += run;
+            continue;
+        }
+
+        unsigned int codePoint;
+        int bytes = utf8_dfa_next(buf + pos, len - pos, &codePoint);
+        if (bytes <= 0) {
+            return utf8_transcode_done(result, utf8_character_error(buf + pos, buf + len), pos, written);
+        }
+        if (codePoint >= 0x10000) {
+            // outside the BMP: a surrogate pair
+            codePoint -= 0x10000;
+            utf16_store(output, written++, 0xD800 | (codePoint >> 10), bigEndian);
+            utf16_store(output, written++, 0xDC00 | (codePoint & 0x3FF), bigEndian);
+        } else {
+            utf16_store(output, written++, codePoint, bigEndian);
+        }
+        pos += (size_t)bytes;
+    }
+    return utf8_transcode_done(result, 0, pos, written);
+}
+
+// Converts UTF-16 in the given byte order to UTF-8. 'output' needs room for 3 bytes per unit.
+// Returns 0, or -4 (invalid code point) at an unpaired surrogate, in which case everything before it
+// has been converted. 'result' (may be NULL) gets the status, the units read and the bytes written.
+int my_utf8_from_utf16(const uint16_t *units, size_t count, enum my_utf16_byte_order order, uint8_t *output,
+                       my_utf8_transcode_result *result) {
+    int bigEndian = (order == MY_UTF16_BE);
+    size_t pos = 0;
+    size_t written = 0;
+
+    while (pos < count) {
+        unsigned int codePoint = utf16_load(units, pos, bigEndian);
+        if (codePoint < 0x80) {
+            size_t run = utf16_narrow_ascii(units + pos, count - pos, output + written, bigEndian);
+            pos += run;
+            written += run;
+            continue;
+        }
+
+        size_t used = 1;
+        if (is_surrogate(codePoint)) {
+            // only a high surrogate followed by a low one makes a character
+            unsigned int low = (pos + 1 < count) ? utf16_load(units, pos + 1, bigEndian) : 0;
+            if (codePoint > 0xDBFF || low < 0xDC00 || low > 0xDFFF) {
+                return utf8_transcode_done(result, -4, pos, written);
+            }
+            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+            used = 2;
+        }
+        written += utf8_encode_code_point(codePoint, output + written);
+        pos += used;
+    }
+    return utf8_transcode_done(result, 0, pos, written);
+}
+
+/* UTF-32 conversion: code points as a plain uint32_t array, for callers that want random access.
+ * Decoding validates like my_utf8_check and encoding rejects surrogates and values above U+10FFFF.
+ * The decode kernels expand 16 bytes at a time into 16 lanes as long as a block holds only ASCII and
+ * whole 2-byte characters (Latin, Greek, Cyrillic, Hebrew, Arabic text); blocks with longer characters
+ * go through the automaton. The encode kernels pack runs of ASCII code points back into bytes. */
+
+// Expands the ASCII bytes at the start of buf into code points and returns how many there were
+static size_t utf8_expand_scalar(const uint8_t *buf, size_t len, uint32_t *output, size_t *written) {
+    size_t run = utf8_ascii_prefix_swar(buf, len);
+    for (size_t i = 0; i < run; i++) {
+        output[i] = buf[i];
+    }
+    *written = run;
+    return run;
+}
+
+// Packs the ASCII code points at the start of the array into bytes and returns how many there were
+static size_t utf32_pack_ascii_scalar(const uint32_t *codePoints, size_t count, uint8_t *output) {
+    size_t i = 0;
+    while (i < count && codePoints[i] < 0x80) {
+        output[i] = (uint8_t)codePoints[i];
+        i++;
+    }
+    return i;
+}
+
+#ifdef UTF8_X86_SIMD
+/* One 16-byte block of ASCII and 2-byte characters, shared by all the decode kernels (buf + 16 must
+ * still be readable). A 2-byte character is a lead C2-DF followed by one continuation byte, so the
+ * block is taken only when the continuation bytes are exactly the bytes after the leads and no lead
+ * is C0/C1 (overlong) or E0 and above. A character started by the last byte is left for the next
+ * block. The code point is built at every lead from the lead and the byte after it; dropping the
+ * lanes of the continuation bytes then leaves one lane per character. Returns the number of code
+ * points written and sets *consumed to 16 or 15, or returns -1 if the block is not ASCII and 2-byte
+ * characters only. */
+__attribute__((target("sse4.2,popcnt")))
+static inline int utf8_expand_block16(const uint8_t *buf, uint32_t *output, size_t *consumed) {
+    __m128i input = _mm_loadu_si128((const __m128i *)buf);
+    unsigned int high = (unsigned int)_mm_movemask_epi8(input);
+    if (high == 0) {
+        _mm_storeu_si128((__m128i *)output, _mm_cvtepu8_epi32(input));
+        _mm_storeu_si128((__m128i *)(output + 4), _mm_cvtepu8_epi32(_mm_srli_si128(input, 4)));
+        _mm_storeu_si128((__m128i *)(output + 8), _mm_cvtepu8_epi32(_mm_srli_si128(input, 8)));
+        _mm_storeu_si128((__m128i *)(output + 12), _mm_cvtepu8_epi32(_mm_srli_si128(input, 12)));
+        *consumed = 16;
+        return 16;
+    }
+
+    // as signed bytes: leads C0-FF are -64..-1, E0-FF are -32..-1
+    unsigned int leads = high & (unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(input, _mm_set1_epi8(-65)));
+    unsigned int longLeads = high & (unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(input, _mm_set1_epi8(-33)));
+    unsigned int overlong = (unsigned int)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_and_si128(input, _mm_set1_epi8((char)0xFE)), _mm_set1_epi8((char)0xC0)));
+    unsigned int continuations = high & ~leads;
+    unsigned int cut = (leads >> 15) & 1; // the last byte starts a character that ends in the next block
+    unsigned int inBlock = cut ? 0x7FFF : 0xFFFF;
+    leads &= inBlock;
+    if ((longLeads & inBlock) != 0 || (overlong & inBlock) != 0 || (continuations & inBlock) != (leads << 1)) {
+        return -1;
+    }
+
+    // code point at every lead: (lead & 0x1F) << 6 | (next & 0x3F); ASCII bytes stay as they are
+    __m128i next = _mm_loadu_si128((const __m128i *)(buf + 1));
+    __m128i isLead = _mm_cmpgt_epi8(input, _mm_set1_epi8(-65));
+    isLead = _mm_and_si128(isLead, _mm_cmplt_epi8(input, _mm_setzero_si128()));
+    uint16_t values[16];
+    for (int half = 0; half < 2; half++) {
+        __m128i bytes = _mm_cvtepu8_epi16(half ? _mm_srli_si128(input, 8) : input);
+        __m128i following = _mm_cvtepu8_epi16(half ? _mm_srli_si128(next, 8) : next);
+        __m128i leadLanes = _mm_cvtepi8_epi16(half ? _mm_srli_si128(isLead, 8) : isLead);
+        __m128i twoByte = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(bytes, _mm_set1_epi16(0x1F)), 6),
+                                       _mm_and_si128(following, _mm_set1_epi16(0x3F)));
+        _mm_storeu_si128((__m128i *)(values + 8 * half), _mm_blendv_epi8(bytes, twoByte, leadLanes));
+    }
+
+    // drop the continuation lanes without branching: every lane is written, only kept ones advance
+    unsigned int keep = ~continuations & inBlock;
+    int count = 0;
+    for (int k = 0; k < 16; k++) {
+        output[count] = values[k];
+        count += (int)(keep >> k) & 1;
+    }
+    *consumed = 16 - cut;
+    return count;
+}
+
+__attribute__((target("sse4.2,popcnt")))
+static size_t utf8_expand_sse42(const uint8_t *buf, size_t len, uint32_t *output, size_t *written) {
+    size_t i = 0;
+    size_t count = 0;
+    while (i + 17 <= len) {
+        size_t consumed;
+        int block = utf8_expand_block16(buf + i, output + count, &consumed);
+        if (block < 0) {
+            break;
+        }
+        count += (size_t)block;
+        i += consumed;
+    }
+    *written = count;
+    return i;
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t utf8_expand_avx2(const uint8_t *buf, size_t len, uint32_t *output, size_t *written) {
+    size_t i = 0;
+    size_t count = 0;
+    while (i + 17 <= len) {
+        if (i + 32 <= len) {
+            __m256i input = _mm256_loadu_si256((const __m256i *)(buf + i));
+            if (_mm256_movemask_epi8(input) == 0) {
+                for (int k = 0; k < 4; k++) {
+                    __m128i bytes = _mm_loadl_epi64((const __m128i *)(buf + i + 8 * k));
+                    _mm256_storeu_si256((__m256i *)(output + count + 8 * k), _mm256_cvtepu8_epi32(bytes));
+                }
+                i += 32;
+                count += 32;
+                continue;
+            }
+        }
+        size_t consumed;
+        int block = utf8_expand_block16(buf + i, output + count, &consumed);
+        if (block < 0) {
+            break;
+        }
+        count += (size_t)block;
+        i += consumed;
+    }
+    *written = count;
+    return i;
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+static size_t utf8_expand_avx512(const uint8_t *buf, size_t len, uint32_t *output, size_t *written) {
+    size_t i = 0;
+    size_t count = 0;
+    while (i + 17 <= len) {
+        if (i + 64 <= len) {
+            __m512i input = _mm512_loadu_si512((const void *)(buf + i));
+            if (_mm512_movepi8_mask(input) == 0) {
+                for (int k = 0; k < 4; k++) {
+                    __m128i bytes = _mm_loadu_si128((const __m128i *)(buf + i + 16 * k));
+                    _mm512_storeu_si512((void *)(output + count + 16 * k), _mm512_cvtepu8_epi32(bytes));
+                }
+                i += 64;
+                count += 64;
+                continue;
+            }
+        }
+        size_t consumed;
+        int block = utf8_expand_block16(buf + i, output + count, &consumed);
+        if (block < 0) {
+            break;
+        }
+        count += (size_t)block;
+        i += consumed;
+    }
+    *written = count;
+    return i;
+}
+
+// 16 code points at a time: ASCII when no lane has a bit above 0x7F set, then saturating packs
+__attribute__((target("sse4.2")))
+static size_t utf32_pack_ascii_sse42(const uint32_t *codePoints, size_t count, uint8_t *output) {
+    const __m128i nonAscii = _mm_set1_epi32((int)0xFFFFFF80);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(codePoints + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(codePoints + i + 4));
+        __m128i c = _mm_loadu_si128((const __m128i *)(codePoints + i + 8));
+        __m128i d = _mm_loadu_si128((const __m128i *)(codePoints + i + 12));
+        if (!_mm_testz_si128(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)), nonAscii)) {
+            break;
+        }
+        __m128i packed = _mm_packus_epi16(_mm_packus_epi32(a, b), _mm_packus_epi32(c, d));
+        _mm_storeu_si128((__m128i *)(output + i), packed);
+    }
+    return i + utf32_pack_ascii_scalar(codePoints + i, count - i, output + i);
+}
+
+__attribute__((target("avx2")))
+static size_t utf32_pack_ascii_avx2(const uint32_t *codePoints, size_t count, uint8_t *output) {
+    const __m256i nonAscii = _mm256_set1_epi32((int)0xFFFFFF80);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(codePoints + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(codePoints + i + 8));
+        if (!_mm256_testz_si256(_mm256_or_si256(a, b), nonAscii)) {
+            break;
+        }
+        // the 256-bit pack works per 128-bit lane, the permute puts the 16-bit values back in order
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        _mm_storeu_si128((__m128i *)(output + i), packed);
+    }
+    return i + utf32_pack_ascii_scalar(codePoints + i, count - i, output + i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t utf32_pack_ascii_avx512(const uint32_t *codePoints, size_t count, uint8_t *output) {
+    const __m512i nonAscii = _mm512_set1_epi32((int)0xFFFFFF80);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512i input = _mm512_loadu_si512((const void *)(codePoints + i));
+        if (_mm512_test_epi32_mask(input, nonAscii) != 0) {
+            break;
+        }
+        _mm_storeu_si128((__m128i *)(output + i), _mm512_cvtepi32_epi8(input));
+    }
+    return i + utf32_pack_ascii_scalar(codePoints + i, count - i, output + i);
+}
+#endif
+
+typedef size_t (*utf8_expand_fn)(const uint8_t *, size_t, uint32_t *, size_t *);
+typedef size_t (*utf32_pack_fn)(const uint32_t *, size_t, uint8_t *);
+
+// Picks the decode-to-code-points kernel for this CPU on the first call
+static size_t utf8_expand(const uint8_t *buf, size_t len, uint32_t *output, size_t *written) {
+    static utf8_expand_fn expand = NULL;
+    if (expand == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                expand = utf8_expand_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                expand = utf8_expand_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                expand = utf8_expand_sse42;
+                break;
+#endif
+            default:
+                expand = utf8_expand_scalar;
+        }
+    }
+    return expand(buf, len, output, written);
+}
+
+// Picks the ASCII packing kernel for this CPU on the first call
+static size_t utf32_pack_ascii(const uint32_t *codePoints, size_t count, uint8_t *output) {
+    static utf32_pack_fn pack = NULL;
+    if (pack == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                pack = utf32_pack_ascii_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                pack = utf32_pack_ascii_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                pack = utf32_pack_ascii_sse42;
+                break;
+#endif
+            default:
+                pack = utf32_pack_ascii_scalar;
+        }
+    }
+    return pack(codePoints, count, output);
+}
+
+// Decodes UTF-8 into code points. 'output' needs room for 'len' code points (one per byte at most).
+// Returns 0, or the my_utf8_check code of the first bad character, in which case everything before it
+// has been decoded. 'result' (may be NULL) gets the status, the bytes read and the number of code
+// points written.
+int my_utf8_to_utf32(const uint8_t *buf, size_t len, uint32_t *output, my_utf8_transcode_result *result) {
+    size_t pos = 0;
+    size_t written = 0;
+
+    while (pos < len) {
+        size_t count;
+        pos += utf8_expand(buf + pos, len - pos, output + written, &count);
+        written += count;
+
+        // the kernel stopped at a block it can't take (or near the end): go past it a character at a time
+        size_t stop = pos + 16;
+        while (pos < len && pos < stop) {
+            if (buf[pos] < 0x80) {
+                output[written++] = buf[pos++];
+                continue;
+            }
+            unsigned int codePoint;
+            int bytes = utf8_dfa_next(buf + pos, len - pos, &codePoint);
+            if (bytes <= 0) {
+                return utf8_transcode_done(result, utf8_character_error(buf + pos, buf + len), pos, written);
+            }
+            output[written++] = codePoint;
+            pos += (size_t)bytes;
+        }
+    }
+    return utf8_transcode_done(result, 0, pos, written);
+}
+
+// Encodes code points as UTF-8. 'output' needs room for 4 bytes per code point. Returns 0, or -4
+// (invalid code point) at the first surrogate or value above U+10FFFF, in which case everything
+// before it has been encoded. 'result' (may be NULL) gets the status, the code points read and the
+// bytes written.
+int my_utf8_from_utf32(const uint32_t *codePoints, size_t count, uint8_t *output, my_utf8_transcode_result *result) {
+    size_t pos = 0;
+    size_t written = 0;
+
+    while (pos < count) {
+        if (codePoints[pos] < 0x80) {
+            size_t run = utf32_pack_ascii(codePoints + pos, count - pos, output + written);
+            pos += run;
+            written += run;
+            continue;
+        }
+        if (!is_valid_code_point(codePoints[pos])) {
+            return utf8_transcode_done(result, -4, pos, written);
+        }
+        written += utf8_encode_code_point(codePoints[pos], output + written);
+        pos++;
+    }
+    return utf8_transcode_done(result, 0, pos, written);
+}
+
+/* Unicode normalization (UAX #15) into NFC, NFD, NFKC or NFKD. The tables come from unicode_tables.h,
+ * which gen_unicode_tables.pl generates: the combining class and quick check flags of every code point
+ * (a two-level table), the full decompositions and the primary composites. Hangul syllables are
+ * decomposed and composed by arithmetic instead. A character whose quick check answer is "Yes" and
+ * whose combining class is 0 is a boundary nothing before it can interact with, so text is passed
+ * through as it is until a character that is not "Yes" (or a combining mark out of order) turns up,
+ * and only the span around it, from the boundary before to the boundary after, is decomposed,
+ * reordered and recomposed. Already normalized text is confirmed by the quick check alone, in one
+ * pass with no allocation or copy. */
+
+#define UTF8_HANGUL_S_BASE 0xAC00
+#define UTF8_HANGUL_L_BASE 0x1100
+#define UTF8_HANGUL_V_BASE 0x1161
+#define UTF8_HANGUL_T_BASE 0x11A7
+#define UTF8_HANGUL_L_COUNT 19
+#define UTF8_HANGUL_V_COUNT 21
+#define UTF8_HANGUL_T_COUNT 28
+#define UTF8_HANGUL_N_COUNT (UTF8_HANGUL_V_COUNT * UTF8_HANGUL_T_COUNT)
+#define UTF8_HANGUL_S_COUNT (UTF8_HANGUL_L_COUNT * UTF8_HANGUL_N_COUNT)
+
+// Quick check flags that make a character "No" / "Maybe", by enum my_utf8_normal_form
+static const uint8_t utf8_norm_no_flag[4] = {UTF8_NORM_NFC_NO, UTF8_NORM_NFD_NO, UTF8_NORM_NFKC_NO,
+                                             UTF8_NORM_NFKD_NO};
+static const uint8_t utf8_norm_maybe_flag[4] = {UTF8_NORM_NFC_MAYBE, 0, UTF8_NORM_NFKC_MAYBE, 0};
+
+// Code points below these need no table lookup: "Yes" with combining class 0
+static const unsigned int utf8_norm_first[4] = {UTF8_NORM_NFC_FIRST, UTF8_NORM_NFD_FIRST, UTF8_NORM_NFKC_FIRST,
+                                                UTF8_NORM_NFKD_FIRST};
+
+// Combining class and quick check flags of a code point
+static inline const utf8_norm_props *utf8_norm_lookup(unsigned int codePoint) {
+    unsigned int block = codePoint >> UTF8_NORM_SHIFT;
+    unsigned int id = (block < sizeof(utf8_norm_stage1)) ? utf8_norm_stage1[block] : 0;
+    return &utf8_norm_props_table[utf8_norm_stage2[(id << UTF8_NORM_SHIFT) |
+                                                   (codePoint & ((1u << UTF8_NORM_SHIFT) - 1))]];
+}
+
+// Length of the run of bytes below 'limit' at the start of buf. With 'limit' the lead byte of the first
+// code point the form can change, such a run is text that needs no lookup at all (for NFC: everything
+// up to U+02FF, so all of Latin-1 and the Latin extensions).
+static size_t utf8_bytes_below_scalar(const uint8_t *buf, size_t len, uint8_t limit) {
+    size_t i = 0;
+    while (i < len && buf[i] < limit) {
+        i++;
+    }
+    return i;
+}
+
+#ifdef UTF8_X86_SIMD
+// byte < limit exactly when min(byte, limit - 1) == byte
+__attribute__((target("sse4.2")))
+static size_t utf8_bytes_below_sse42(const uint8_t *buf, size_t len, uint8_t limit) {
+    const __m128i highest = _mm_set1_epi8((char)(limit - 1));
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(buf + i));
+        int mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(bytes, highest), bytes)) & 0xFFFF;
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctz((unsigned int)mask);
+        }
+    }
+    return i + utf8_bytes_below_scalar(buf + i, len - i, limit);
+}
+
+__attribute__((target("avx2")))
+static size_t utf8_bytes_below_avx2(const uint8_t *buf, size_t len, uint8_t limit) {
+    const __m256i highest = _mm256_set1_epi8((char)(limit - 1));
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(buf + i));
+        unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(bytes, highest), bytes));
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return i + utf8_bytes_below_scalar(buf + i, len - i, limit);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t utf8_bytes_below_avx512(const uint8_t *buf, size_t len, uint8_t limit) {
+    const __m512i limits = _mm512_set1_epi8((char)limit);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __mmask64 mask = _mm512_cmpge_epu8_mask(_mm512_loadu_si512((const void *)(buf + i)), limits);
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctzll(mask);
+        }
+    }
+    return i + utf8_bytes_below_scalar(buf + i, len - i, limit);
+}
+#endif
+
+typedef size_t (*utf8_below_fn)(const uint8_t *, size_t, uint8_t);
+
+// Picks the kernel for this CPU on the first call
+static size_t utf8_bytes_below(const uint8_t *buf, size_t len, uint8_t limit) {
+    static utf8_below_fn below = NULL;
+    if (below == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                below = utf8_bytes_below_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                below = utf8_bytes_below_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                below = utf8_bytes_below_sse42;
+                break;
+#endif
+            default:
+                below = utf8_bytes_below_scalar;
+        }
+    }
+    return below(buf, len, limit);
+}
+
+// Skips the characters of valid UTF-8 that start with a byte below 'limit' (buf[0] is one) and returns
+// how many bytes they take. A lone one, as between the characters of CJK text, is not worth a call to
+// the kernel.
+static inline size_t utf8_norm_skip(const uint8_t *buf, size_t len, uint8_t limit) {
+    size_t i = (len > 1 && buf[1] < limit) ? utf8_bytes_below(buf, len, limit) : 1;
+    while (i < len && (buf[i] & 0xC0) == 0x80) {
+        i++; // the rest of the last character
+    }
+    return i;
+}
+
+// The lead byte of the first code point a form can change
+static uint8_t utf8_norm_limit(enum my_utf8_normal_form form) {
+    unsigned int first = utf8_norm_first[form];
+    return (first < 0x80) ? (uint8_t)first : (uint8_t)(0xC0 | (first >> 6));
+}
+
+static unsigned int utf8_combining_class(unsigned int codePoint) {
+    return utf8_norm_lookup(codePoint)->ccc;
+}
+
+// Binary search of a decomposition list
+static const utf8_decomposition *utf8_find_decomposition(const utf8_decomposition *list, size_t count,
+                                                         unsigned int codePoint) {
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (list[middle].codePoint < codePoint) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return (low < count && list[low].codePoint == codePoint) ? &list[low] : NULL;
+}
+
+// The primary composite of two code points, or 0 if they don't compose
+static unsigned int utf8_compose_pair(unsigned int first, unsigned int second) {
+    if (first - UTF8_HANGUL_L_BASE < UTF8_HANGUL_L_COUNT && second - UTF8_HANGUL_V_BASE < UTF8_HANGUL_V_COUNT) {
+        return UTF8_HANGUL_S_BASE + ((first - UTF8_HANGUL_L_BASE) * UTF8_HANGUL_V_COUNT +
+                                     (second - UTF8_HANGUL_V_BASE)) * UTF8_HANGUL_T_COUNT;
+    }
+    if (first - UTF8_HANGUL_S_BASE < UTF8_HANGUL_S_COUNT && (first - UTF8_HANGUL_S_BASE) % UTF8_HANGUL_T_COUNT == 0 &&
+        second - UTF8_HANGUL_T_BASE - 1 < UTF8_HANGUL_T_COUNT - 1) {
+        return first + (second - UTF8_HANGUL_T_BASE);
+    }
+
+    size_t low = 0;
+    size_t high = sizeof(utf8_compositions) / sizeof(utf8_compositions[0]);
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        const utf8_composition *entry = &utf8_compositions[middle];
+        if (entry->first < first || (entry->first == first && entry->second < second)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low < sizeof(utf8_compositions) / sizeof(utf8_compositions[0]) && utf8_compositions[low].first == first &&
+        utf8_compositions[low].second == second) {
+        return utf8_compositions[low].composite;
+    }
+    return 0;
+}
+
+// Code points of the span being normalized: on the stack, moved to the heap only for very long spans
+typedef struct utf8_code_points {
+    uint32_t *data;
+    size_t length;
+    size_t capacity;
+    uint32_t local[64];
+} utf8_code_points;
+
+static int utf8_code_points_push(utf8_code_points *points, uint32_t codePoint) {
+    if (points->length == points->capacity) {
+        size_t capacity = points->capacity * 2;
+        uint32_t *data = (points->data == points->local) ? malloc(capacity * sizeof(uint32_t))
+                                                          : realloc(points->data, capacity * sizeof(uint32_t));
+        if (data == NULL) {
+            return -1;
+        }
+        if (points->data == points->local) {
+            memcpy(data, points->local, sizeof(points->local));
+        }
+        points->data = data;
+        points->capacity = capacity;
+    }
+    points->data[points->length++] = codePoint;
+    return 0;
+}
+
+// Appends the full decomposition of a code point (itself if it has none)
+static int utf8_decompose(unsigned int codePoint, const utf8_norm_props *props, int compat, utf8_code_points *points) {
+    unsigned int index = codePoint - UTF8_HANGUL_S_BASE;
+    if (index < UTF8_HANGUL_S_COUNT) {
+        unsigned int trailing = index % UTF8_HANGUL_T_COUNT;
+        if (utf8_code_points_push(points, UTF8_HANGUL_L_BASE + index / UTF8_HANGUL_N_COUNT) != 0 ||
+            utf8_code_points_push(points, UTF8_HANGUL_V_BASE + (index % UTF8_HANGUL_N_COUNT) / UTF8_HANGUL_T_COUNT) != 0) {
+            return -1;
+        }
+        return (trailing != 0) ? utf8_code_points_push(points, UTF8_HANGUL_T_BASE + trailing) : 0;
+    }
+
+    const utf8_decomposition *decomposition = NULL;
+    if (compat && (props->flags & UTF8_NORM_NFKD_NO)) {
+        decomposition = utf8_find_decomposition(utf8_compat_decompositions,
+                                                sizeof(utf8_compat_decompositions) / sizeof(utf8_decomposition),
+                                                codePoint);
+    }
+    if (decomposition == NULL && (props->flags & UTF8_NORM_NFD_NO)) {
+        decomposition = utf8_find_decomposition(utf8_canonical_decompositions,
+                                                sizeof(utf8_canonical_decompositions) / sizeof(utf8_decomposition),
+                                                codePoint);
+    }
+    if (decomposition == NULL) {
+        return utf8_code_points_push(points, codePoint);
+    }
+    for (size_t i = 0; i < decomposition->length; i++) {
+        if (utf8_code_points_push(points, utf8_decomposition_data[decomposition->offset + i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Where normalized text goes: into a buffer of limited capacity, or (is_normalized) compared against
+// the input itself
+typedef struct utf8_norm_output {
+    uint8_t *output;
+    size_t capacity;
+    size_t written;         // counts on past the capacity, to report the size needed
+    const uint8_t *compare; // comparing: the input, the output has to come out identical
+    int stopped;            // 1 once the output no longer fits or, comparing, no longer matches
+} utf8_norm_output;
+
+static void utf8_norm_emit(utf8_norm_output *out, const uint8_t *bytes, size_t count) {
+    if (out->compare != NULL) {
+        // the input passed through unchanged matches itself; only normalized spans need comparing
+        if (bytes != out->compare + out->written &&
+            (count > out->capacity - out->written || memcmp(out->compare + out->written, bytes, count) != 0)) {
+            out->stopped = 1;
+        }
+    } else if (!out->stopped && count <= out->capacity - out->written) {
+        if (out->output != NULL && count > 0) { // a size query has no output at all
+            memcpy(out->output + out->written, bytes, count);
+        }
+    } else {
+        out->stopped = 1;
+    }
+    out->written += count;
+}
+
+// Normalizes one span of valid UTF-8: decompose, put the combining marks in canonical order and, for
+// NFC and NFKC, compose again. Returns 0, or -7 if a very long span could not get the memory it needs.
+static int utf8_normalize_span(const uint8_t *buf, size_t len, enum my_utf8_normal_form form, utf8_norm_output *out) {
+    utf8_code_points points = {NULL, 0, 64, {0}};
+    points.data = points.local;
+    int compat = (form == MY_UTF8_NFKC || form == MY_UTF8_NFKD);
+    int status = 0;
+
+    for (size_t pos = 0; pos < len && status == 0;) {
+        unsigned int codePoint = 0;
+        int bytes = utf8_dfa_next(buf + pos, len - pos, &codePoint);
+        status = utf8_decompose(codePoint, utf8_norm_lookup(codePoint), compat, &points);
+        pos += (size_t)bytes;
+    }
+    if (status != 0) {
+        if (points.data != points.local) {
+            free(points.data);
+        }
+        return -7;
+    }
+
+    // canonical ordering: a stable sort of every run of combining marks by combining class
+    uint32_t *data = points.data;
+    size_t count = points.length;
+    for (size_t i = 1; i < count; i++) {
+        unsigned int ccc = utf8_combining_class(data[i]);
+        if (ccc == 0) {
+            continue;
+        }
+        uint32_t codePoint = data[i];
+        size_t j = i;
+        while (j > 0 && utf8_combining_class(data[j - 1]) > ccc) {
+            data[j] = data[j - 1];
+            j--;
+        }
+        data[j] = codePoint;
+    }
+
+    if (form == MY_UTF8_NFC || form == MY_UTF8_NFKC) {
+        // canonical composition: a mark composes with the last starter unless a mark of the same or a
+        // higher class stands between them
+        size_t starter = 0;
+        unsigned int lastClass = utf8_combining_class(data[0]) ? 256 : 0;
+        size_t kept = 1;
+        for (size_t i = 1; i < count; i++) {
+            unsigned int ccc = utf8_combining_class(data[i]);
+            unsigned int composite = utf8_compose_pair(data[starter], data[i]);
+            if (composite != 0 && (lastClass < ccc || lastClass == 0)) {
+                data[starter] = composite;
+                continue;
+            }
+            if (ccc == 0) {
+                starter = kept;
+            }
+            lastClass = ccc;
+            data[kept++] = data[i];
+        }
+        count = kept;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t bytes[4];
+        utf8_norm_emit(out, bytes, utf8_encode_code_point(data[i], bytes));
+    }
+    if (points.data != points.local) {
+        free(points.data);
+    }
+    return 0;
+}
+
+// Passes valid UTF-8 through to 'out', normalizing only the spans that need it
+static int utf8_normalize_run(const uint8_t *buf, size_t len, enum my_utf8_normal_form form, utf8_norm_output *out) {
+    uint8_t notYes = utf8_norm_no_flag[form] | utf8_norm_maybe_flag[form];
+    uint8_t limit = utf8_norm_limit(form);
+    size_t copied = 0;   // the input before this is already in the output
+    size_t boundary = 0; // the last character nothing before it can interact with
+    unsigned int lastClass = 0;
+    size_t pos = 0;
+
+    while (pos < len) {
+        if (buf[pos] < limit) {
+            pos += utf8_norm_skip(buf + pos, len - pos, limit);
+            boundary = pos - 1;
+            while ((buf[boundary] & 0xC0) == 0x80) {
+                boundary--; // the start of the last character skipped
+            }
+            lastClass = 0;
+            continue;
+        }
+        unsigned int codePoint = 0;
+        int bytes = utf8_dfa_next(buf + pos, len - pos, &codePoint);
+        const utf8_norm_props *props = utf8_norm_lookup(codePoint);
+        if ((props->flags & notYes) == 0 && (props->ccc == 0 || props->ccc >= lastClass)) {
+            if (props->ccc == 0) {
+                boundary = pos;
+            }
+            lastClass = props->ccc;
+            pos += (size_t)bytes;
+            continue;
+        }
+
+        // this character needs normalizing, along with everything up to the next boundary
+        size_t end = pos + (size_t)bytes;
+        while (end < len && buf[end] >= limit) {
+            bytes = utf8_dfa_next(buf + end, len - end, &codePoint);
+            props = utf8_norm_lookup(codePoint);
+            if (props->ccc == 0 && (props->flags & notYes) == 0) {
+                break;
+            }
+            end += (size_t)bytes;
+        }
+        utf8_norm_emit(out, buf + copied, boundary - copied);
+        if (utf8_normalize_span(buf + boundary, end - boundary, form, out) != 0) {
+            return -7;
+        }
+        if (out->compare != NULL && out->stopped) {
+            return 0;
+        }
+        copied = boundary = pos = end;
+        lastClass = 0;
+    }
+    utf8_norm_emit(out, buf + copied, len - copied);
+    return 0;
+}
+
+// Quick check (UAX #15): whether the text is certainly in the normalization form (MY_UTF8_QC_YES),
+// certainly not (MY_UTF8_QC_NO, also for invalid UTF-8), or maybe, which only normalizing can tell
+// (only for NFC and NFKC). After the vector validation a single scan that skips the stretches of
+// characters the form never changes; nothing is allocated.
+enum my_utf8_quick_check my_utf8_quick_check(const uint8_t *buf, size_t len, enum my_utf8_normal_form form) {
+    uint8_t no = utf8_norm_no_flag[form];
+    uint8_t maybe = utf8_norm_maybe_flag[form];
+    uint8_t limit = utf8_norm_limit(form);
+    enum my_utf8_quick_check answer = MY_UTF8_QC_YES;
+    unsigned int lastClass = 0;
+    size_t pos = 0;
+
+    if (utf8_validate(buf, len) != 0) {
+        return MY_UTF8_QC_NO;
+    }
+    while (pos < len) {
+        if (buf[pos] < limit) {
+            pos += utf8_norm_skip(buf + pos, len - pos, limit);
+            lastClass = 0;
+            continue;
+        }
+        unsigned int codePoint = 0;
+        pos += (size_t)utf8_dfa_next(buf + pos, len - pos, &codePoint);
+        const utf8_norm_props *props = utf8_norm_lookup(codePoint);
+        if ((props->flags & no) || (props->ccc != 0 && props->ccc < lastClass)) {
+            return MY_UTF8_QC_NO;
+        }
+        if (props->flags & maybe) {
+            answer = MY_UTF8_QC_MAYBE;
+        }
+        lastClass = props->ccc;
+    }
+    return answer;
+}
+
+// Whether the text is in the normalization form (0 for invalid UTF-8). The quick check decides almost
+// all text; for a "Maybe" the spans around the doubtful characters are normalized and compared with
+// the input, still without copying it.
+int my_utf8_is_normalized(const uint8_t *buf, size_t len, enum my_utf8_normal_form form) {
+    enum my_utf8_quick_check answer = my_utf8_quick_check(buf, len, form);
+    if (answer != MY_UTF8_QC_MAYBE) {
+        return answer == MY_UTF8_QC_YES;
+    }
+    utf8_norm_output out = {NULL, len, 0, buf, 0};
+    if (utf8_normalize_run(buf, len, form, &out) != 0) {
+        return 0;
+    }
+    return !out.stopped && out.written == len;
+}
+
+// Normalizes UTF-8 into the given form. *written gets the size of the normalized text whether or not
+// it fits (call with capacity 0 to ask for the size; NFKD can grow text up to 11 times). Returns 0,
+// the my_utf8_check code of invalid input (nothing is written), -6 if the output is too small (it
+// then holds an unspecified part of the result), or -7 if a span of thousands of combining marks
+// could not get working memory.
+int my_utf8_normalize(const uint8_t *buf, size_t len, enum my_utf8_normal_form form, uint8_t *output,
+                      size_t capacity, size_t *written) {
+    *written = 0;
+    int status = utf8_validate(buf, len);
+    if (status != 0) {
+        return status;
+    }
+    utf8_norm_output out = {output, capacity, 0, NULL, 0};
+    if (utf8_normalize_run(buf, len, form, &out) != 0) {
+        return -7;
+    }
+    *written = out.written;
+    return out.stopped ? -6 : 0;
+}
+
+/* Case folding (the C, S and F mappings of CaseFolding.txt), for case-insensitive comparison and
+ * hashing. Simple folding maps every code point to one code point; full folding may give up to three
+ * (U+00DF sharp s folds to "ss"). Per code point the table in unicode_tables.h gives the distance to
+ * the simple folding and, where it differs, the full one. ASCII is folded 16 to 64 bytes at a time, and
+ * the comparison and the hash fold as they go, without building the folded strings. */
+
+// The folding record of a code point (utf8_fold_records itself for one that folds to itself)
+static inline const utf8_fold_record *utf8_fold_lookup(unsigned int codePoint) {
+    unsigned int block = codePoint >> UTF8_FOLD_SHIFT;
+    unsigned int id = (block < sizeof(utf8_fold_stage1)) ? utf8_fold_stage1[block] : 0;
+    return &utf8_fold_records[utf8_fold_stage2[(id << UTF8_FOLD_SHIFT) | (codePoint & ((1u << UTF8_FOLD_SHIFT) - 1))]];
+}
+
+// Writes the folding of a code point (1 to 3 code points) and returns how many there are
+static size_t utf8_fold_code_point(unsigned int codePoint, const utf8_fold_record *record, enum my_utf8_case_fold fold,
+                                   uint32_t *folded) {
+    if (fold == MY_UTF8_FOLD_FULL && record->fullLength != 0) {
+        for (size_t i = 0; i < record->fullLength; i++) {
+            folded[i] = utf8_full_fold_data[record->fullOffset + i];
+        }
+        return record->fullLength;
+    }
+    folded[0] = (uint32_t)((int32_t)codePoint + record->delta);
+    return 1;
+}
+
+static inline uint8_t utf8_fold_ascii_byte(uint8_t byte) {
+    return ((unsigned)(byte - 'A') < 26u) ? (uint8_t)(byte | 0x20) : byte;
+}
+
+// Lowercases the ASCII letters in a word of eight bytes; other bytes, non-ASCII ones too, stay as they
+// are. On the low seven bits of every byte, bit 7 ends up set where they are at least 'A' and not
+// above 'Z'; moved down to bit 5 it is the case bit.
+static inline uint64_t utf8_fold_ascii_word(uint64_t word) {
+    uint64_t low = word & 0x7F7F7F7F7F7F7F7FULL;
+    uint64_t atLeastA = low + 0x3F3F3F3F3F3F3F3FULL; // 0x80 - 'A' in every byte
+    uint64_t aboveZ = low + 0x2525252525252525ULL;   // 0x7F - 'Z' in every byte
+    return word | (((atLeastA & ~aboveZ & ~word) & 0x8080808080808080ULL) >> 2);
+}
+
+// Folds the run of ASCII bytes at the start of buf into output and returns its length
+static size_t utf8_fold_ascii_scalar(const uint8_t *buf, size_t len, uint8_t *output) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, buf + i, sizeof(word));
+        if (word & 0x8080808080808080ULL) {
+            break;
+        }
+        word = utf8_fold_ascii_word(word);
+        memcpy(output + i, &word, sizeof(word));
+    }
+    for (; i < len && buf[i] < 0x80; i++) {
+        output[i] = utf8_fold_ascii_byte(buf[i]);
+    }
+    return i;
+}
+
+// Length of the start of a and b (len bytes each) that is the same once their ASCII letters are
+// lowercased. Non-ASCII bytes have to be identical, so text that only differs in the case of ASCII
+// letters goes by in one call.
+static size_t utf8_casecmp_prefix_scalar(const uint8_t *a, const uint8_t *b, size_t len) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t wordA;
+        uint64_t wordB;
+        memcpy(&wordA, a + i, sizeof(wordA));
+        memcpy(&wordB, b + i, sizeof(wordB));
+        if (wordA != wordB && utf8_fold_ascii_word(wordA) != utf8_fold_ascii_word(wordB)) {
+            break;
+        }
+    }
+    while (i < len && utf8_fold_ascii_byte(a[i]) == utf8_fold_ascii_byte(b[i])) {
+        i++;
+    }
+    return i;
+}
+
+#ifdef UTF8_X86_SIMD
+/* Shifted so that 'A'..'Z' are the lowest 26 signed bytes, one signed compare finds the upper case
+ * letters (no byte of 0x80 or above lands there); their case bit is then set. */
+__attribute__((target("sse4.2")))
+static inline __m128i utf8_fold_ascii_16(__m128i bytes) {
+    __m128i shifted = _mm_add_epi8(bytes, _mm_set1_epi8((char)(0x80 - 'A')));
+    __m128i upper = _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(0x80 + 26)));
+    return _mm_or_si128(bytes, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+__attribute__((target("sse4.2")))
+static size_t utf8_fold_ascii_sse42(const uint8_t *buf, size_t len, uint8_t *output) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(buf + i));
+        if (_mm_movemask_epi8(bytes) != 0) {
+            break;
+        }
+        _mm_storeu_si128((__m128i *)(output + i), utf8_fold_ascii_16(bytes));
+    }
+    return i + utf8_fold_ascii_scalar(buf + i, len - i, output + i);
+}
+
+__attribute__((target("sse4.2")))
+static size_t utf8_casecmp_prefix_sse42(const uint8_t *a, const uint8_t *b, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i foldedA = utf8_fold_ascii_16(_mm_loadu_si128((const __m128i *)(a + i)));
+        __m128i foldedB = utf8_fold_ascii_16(_mm_loadu_si128((const __m128i *)(b + i)));
+        unsigned int different = ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(foldedA, foldedB)) & 0xFFFF;
+        if (different != 0) {
+            return i + (size_t)__builtin_ctz(different);
+        }
+    }
+    return i + utf8_casecmp_prefix_scalar(a + i, b + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i utf8_fold_ascii_32(__m256i bytes) {
+    __m256i shifted = _mm256_add_epi8(bytes, _mm256_set1_epi8((char)(0x80 - 'A')));
+    __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + 26)), shifted);
+    return _mm256_or_si256(bytes, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2")))
+static size_t utf8_fold_ascii_avx2(const uint8_t *buf, size_t len, uint8_t *output) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(buf + i));
+        if (_mm256_movemask_epi8(bytes) != 0) {
+            break;
+        }
+        _mm256_storeu_si256((__m256i *)(output + i), utf8_fold_ascii_32(bytes));
+    }
+    _mm256_zeroupper(); // before the scalar tail and the caller's SSE code
+    return i + utf8_fold_ascii_scalar(buf + i, len - i, output + i);
+}
+
+__attribute__((target("avx2")))
+static size_t utf8_casecmp_prefix_avx2(const uint8_t *a, const uint8_t *b, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i foldedA = utf8_fold_ascii_32(_mm256_loadu_si256((const __m256i *)(a + i)));
+        __m256i foldedB = utf8_fold_ascii_32(_mm256_loadu_si256((const __m256i *)(b + i)));
+        unsigned int different = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(foldedA, foldedB));
+        if (different != 0) {
+            return i + (size_t)__builtin_ctz(different);
+        }
+    }
+    return i + utf8_casecmp_prefix_scalar(a + i, b + i, len - i);
+}
+
+// With AVX-512 the letters are picked out with an unsigned compare into a mask
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i utf8_fold_ascii_64(__m512i bytes) {
+    __mmask64 upper = _mm512_cmplt_epu8_mask(_mm512_sub_epi8(bytes, _mm512_set1_epi8('A')), _mm512_set1_epi8(26));
+    return _mm512_mask_add_epi8(bytes, upper, bytes, _mm512_set1_epi8(0x20));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t utf8_fold_ascii_avx512(const uint8_t *buf, size_t len, uint8_t *output) {
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i bytes = _mm512_loadu_si512((const void *)(buf + i));
+        if (_mm512_movepi8_mask(bytes) != 0) {
+            break;
+        }
+        _mm512_storeu_si512((void *)(output + i), utf8_fold_ascii_64(bytes));
+    }
+    _mm256_zeroupper();
+    return i + utf8_fold_ascii_scalar(buf + i, len - i, output + i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t utf8_casecmp_prefix_avx512(const uint8_t *a, const uint8_t *b, size_t len) {
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i foldedA = utf8_fold_ascii_64(_mm512_loadu_si512((const void *)(a + i)));
+        __m512i foldedB = utf8_fold_ascii_64(_mm512_loadu_si512((const void *)(b + i)));
+        __mmask64 different = _mm512_cmpneq_epi8_mask(foldedA, foldedB);
+        if (different != 0) {
+            return i + (size_t)__builtin_ctzll(different);
+        }
+    }
+    return i + utf8_casecmp_prefix_scalar(a + i, b + i, len - i);
+}
+#endif
+
+typedef size_t (*utf8_fold_ascii_fn)(const uint8_t *, size_t, uint8_t *);
+
+// Picks the ASCII folding kernel for this CPU on the first call
+static size_t utf8_fold_ascii(const uint8_t *buf, size_t len, uint8_t *output) {
+    static utf8_fold_ascii_fn foldAscii = NULL;
+    if (foldAscii == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                foldAscii = utf8_fold_ascii_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                foldAscii = utf8_fold_ascii_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                foldAscii = utf8_fold_ascii_sse42;
+                break;
+#endif
+            default:
+                foldAscii = utf8_fold_ascii_scalar;
+        }
+    }
+    return foldAscii(buf, len, output);
+}
+
+// Picks the case-insensitive comparison kernel for this CPU on the first call (same signature as the
+// byte comparison kernels)
+static size_t utf8_casecmp_prefix(const uint8_t *a, const uint8_t *b, size_t len) {
+    static utf8_mismatch_fn casecmpPrefix = NULL;
+    if (casecmpPrefix == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                casecmpPrefix = utf8_casecmp_prefix_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                casecmpPrefix = utf8_casecmp_prefix_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                casecmpPrefix = utf8_casecmp_prefix_sse42;
+                break;
+#endif
+            default:
+                casecmpPrefix = utf8_casecmp_prefix_scalar;
+        }
+    }
+    return casecmpPrefix(a, b, len);
+}
+
+// Folds the character at buf[*pos] into code points and moves *pos past it. A byte that does not
+// start a valid character is a unit of its own, folded to 0x110000 + its value: above every code
+// point, so invalid input still compares in a consistent order.
+static size_t utf8_fold_next(const uint8_t *buf, size_t len, size_t *pos, enum my_utf8_case_fold fold,
+                             uint32_t *folded) {
+    uint8_t byte = buf[*pos];
+    if (byte < 0x80) {
+        folded[0] = utf8_fold_ascii_byte(byte);
+        *pos += 1;
+        return 1;
+    }
+    unsigned int codePoint;
+    int bytes = utf8_dfa_next(buf + *pos, len - *pos, &codePoint);
+    if (bytes <= 0) {
+        folded[0] = 0x110000u + byte;
+        *pos += 1;
+        return 1;
+    }
+    *pos += (size_t)bytes;
+    return utf8_fold_code_point(codePoint, utf8_fold_lookup(codePoint), fold, folded);
+}
+
+// Folds the character at buf[*pos] into UTF-8 (at most 12 bytes), moves *pos past it and returns the
+// number of bytes written. Characters that fold to themselves, and bytes that do not start a valid
+// character, are copied as they are.
+static size_t utf8_fold_character(const uint8_t *buf, size_t len, size_t *pos, enum my_utf8_case_fold fold,
+                                  uint8_t *output) {
+    if (buf[*pos] < 0x80) {
+        output[0] = utf8_fold_ascii_byte(buf[*pos]);
+        *pos += 1;
+        return 1;
+    }
+    unsigned int codePoint;
+    int bytes = utf8_dfa_next(buf + *pos, len - *pos, &codePoint);
+    if (bytes <= 0) {
+        output[0] = buf[*pos];
+        *pos += 1;
+        return 1;
+    }
+    const utf8_fold_record *record = utf8_fold_lookup(codePoint);
+    if (record == utf8_fold_records) {
+        memcpy(output, buf + *pos, (size_t)bytes);
+        *pos += (size_t)bytes;
+        return (size_t)bytes;
+    }
+    *pos += (size_t)bytes;
+    uint32_t folded[3];
+    size_t count = utf8_fold_code_point(codePoint, record, fold, folded);
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++) {
+        written += utf8_encode_code_point(folded[i], output + written);
+    }
+    return written;
+}
+
+// Whether the eight bytes at p are all ASCII
+static inline int utf8_fold_ascii_ahead(const uint8_t *p) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return (word & 0x8080808080808080ULL) == 0;
+}
+
+// Case folds UTF-8. *written gets the size of the folded text whether or not it fits (full folding
+// can make text up to three times longer). Returns 0, the my_utf8_check code of invalid input (nothing
+// is written), or -6 if the output is too small (it then holds the start of the result).
+int my_utf8_casefold(const uint8_t *buf, size_t len, enum my_utf8_case_fold fold, uint8_t *output,
+                     size_t capacity, size_t *written) {
+    *written = 0;
+    int status = utf8_validate(buf, len);
+    if (status != 0) {
+        return status;
+    }
+
+    size_t pos = 0;
+    size_t size = 0;
+    int stopped = 0; // set once something did not fit; from then on only the size is counted
+    while (pos < len) {
+        if (len - pos >= 8 && utf8_fold_ascii_ahead(buf + pos)) {
+            // a run of ASCII (a few ASCII bytes between other characters are not worth a kernel call)
+            size_t room = stopped ? 0 : capacity - size;
+            size_t run = (room > 0) ? utf8_fold_ascii(buf + pos, (len - pos < room) ? len - pos : room, output + size)
+                                    : utf8_ascii_prefix(buf + pos, len - pos);
+            stopped |= (room == 0);
+            pos += run;
+            size += run;
+            continue;
+        }
+        if (!stopped && capacity - size >= 12) {
+            size += utf8_fold_character(buf, len, &pos, fold, output + size);
+            continue;
+        }
+        uint8_t folded[12];
+        size_t length = utf8_fold_character(buf, len, &pos, fold, folded);
+        if (!stopped && length <= capacity - size) {
+            memcpy(output + size, folded, length);
+        } else {
+            stopped = 1;
+        }
+        size += length;
+    }
+    *written = size;
+    return stopped ? -6 : 0;
+}
+
+// Case-insensitive my_utf8_strcmp_n: -1, 0 or 1 by the code points of the case folded strings, which
+// are folded a character at a time as they are compared. Stretches that only differ in the case of
+// ASCII letters (or not at all) are skipped with the wide compare first.
+int my_utf8_strcasecmp(const uint8_t *buf1, size_t len1, const uint8_t *buf2, size_t len2,
+                       enum my_utf8_case_fold fold) {
+    uint32_t folded1[3];
+    uint32_t folded2[3];
+    size_t count1 = 0; // folded code points of the current character of each string,
+    size_t count2 = 0; // and how many of them have been compared
+    size_t next1 = 0;
+    size_t next2 = 0;
+    size_t pos1 = 0;
+    size_t pos2 = 0;
+
+    for (;;) {
+        if (next1 == count1 && next2 == count2 && pos1 < len1 && pos2 < len2 &&
+            utf8_fold_ascii_byte(buf1[pos1]) == utf8_fold_ascii_byte(buf2[pos2])) {
+            size_t shorter = (len1 - pos1 < len2 - pos2) ? len1 - pos1 : len2 - pos2;
+            size_t same = utf8_casecmp_prefix(buf1 + pos1, buf2 + pos2, shorter);
+            while (same > 0 && ((pos1 + same < len1 && (buf1[pos1 + same] & 0xC0) == 0x80) ||
+                                (pos2 + same < len2 && (buf2[pos2 + same] & 0xC0) == 0x80))) {
+                same--; // back to the start of the character that differs
+            }
+            pos1 += same;
+            pos2 += same;
+        }
+        if (next1 == count1 && pos1 < len1) {
+            count1 = utf8_fold_next(buf1, len1, &pos1, fold, folded1);
+            next1 = 0;
+        }
+        if (next2 == count2 && pos2 < len2) {
+            count2 = utf8_fold_next(buf2, len2, &pos2, fold, folded2);
+            next2 = 0;
+        }
+        if (next1 == count1 || next2 == count2) {
+            // one of them is at its end
+            return (next1 == count1 && next2 == count2) ? 0 : (next1 == count1) ? -1 : 1;
+        }
+        uint32_t codePoint1 = folded1[next1++];
+        uint32_t codePoint2 = folded2[next2++];
+        if (codePoint1 != codePoint2) {
+            return (codePoint1 < codePoint2) ? -1 : 1;
+        }
+    }
+}
+
+// Mixes whole 8-byte words of folded text into the hash
+static uint64_t utf8_fold_hash_words(uint64_t hash, const uint8_t *bytes, size_t count) {
+    for (size_t i = 0; i + 8 <= count; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (((hash << 23) | (hash >> 41)) ^ word) * 0x9E3779B97F4A7C15ULL;
+    }
+    return hash;
+}
+
+// 64-bit hash of the case folded text, without building it: strings that my_utf8_strcasecmp finds
+// equal hash the same. The text is folded into a small buffer (ASCII with the vector kernels) that is
+// hashed a word at a time whenever it fills up.
+uint64_t my_utf8_casefold_hash(const uint8_t *buf, size_t len, enum my_utf8_case_fold fold) {
+    uint8_t chunk[256 + 16];
+    size_t filled = 0;
+    uint64_t hash = 0;
+    uint64_t total = 0;
+    size_t pos = 0;
+
+    while (pos < len) {
+        if (len - pos >= 8 && utf8_fold_ascii_ahead(buf + pos)) {
+            size_t room = 256 - filled;
+            size_t run = utf8_fold_ascii(buf + pos, (len - pos < room) ? len - pos : room, chunk + filled);
+            filled += run;
+            pos += run;
+        } else {
+            filled += utf8_fold_character(buf, len, &pos, fold, chunk + filled);
+        }
+        if (filled >= 256) {
+            // keep the bytes after the last whole word for the next round
+            size_t whole = filled & ~(size_t)7;
+            hash = utf8_fold_hash_words(hash, chunk, whole);
+            total += whole;
+            memmove(chunk, chunk + whole, filled - whole);
+            filled -= whole;
+        }
+    }
+
+    size_t whole = filled & ~(size_t)7;
+    hash = utf8_fold_hash_words(hash, chunk, whole);
+    uint8_t tail[8] = {0};
+    memcpy(tail, chunk + whole, filled - whole);
+    hash = utf8_fold_hash_words(hash, tail, sizeof(tail));
+    hash ^= total + filled; // the length of the folded text, so the zero padding does not collide
+
+    // final avalanche (the MurmurHash3 finalizer)
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/* Grapheme clusters (UAX #29 extended grapheme clusters): what a reader takes for one character, such
+ * as e + combining acute, a flag (two regional indicators) or an emoji with a skin tone or a ZWJ
+ * sequence. The boundaries come from the Grapheme_Cluster_Break property in unicode_tables.h. A byte
+ * that is not valid UTF-8 is a cluster of its own, like a control character. Nothing is allocated:
+ * clusters are byte spans of the input. */
+
+// Grapheme_Cluster_Break value (with UTF8_GCB_PICTOGRAPHIC) of the character at the start of buf in
+// the low byte, its length in bytes above
+static inline unsigned int utf8_grapheme_property(const uint8_t *buf, size_t len) {
+    unsigned int codePoint = buf[0];
+    int length = 1;
+    if (buf[0] >= 0x80) {
+        length = utf8_dfa_next(buf, len, &codePoint);
+        if (length <= 0) {
+            return UTF8_GCB_CONTROL | 1u << 8;
+        }
+    }
+    unsigned int block = codePoint >> UTF8_GCB_SHIFT;
+    unsigned int id = (block < sizeof(utf8_gcb_stage1)) ? utf8_gcb_stage1[block] : 0;
+    return utf8_gcb_stage2[(id << UTF8_GCB_SHIFT) | (codePoint & ((1u << UTF8_GCB_SHIFT) - 1))] |
+           (unsigned int)length << 8;
+}
+
+// Whether two characters stay in one cluster (rules GB3 to GB13). emojiZwj: the cluster so far ends in
+// a pictograph, Extend characters and a ZWJ; oddRegional: it ends in an odd number of regional
+// indicators.
+static inline int utf8_grapheme_joins(unsigned int before, unsigned int after, int emojiZwj, int oddRegional) {
+    unsigned int b = before & (UTF8_GCB_PICTOGRAPHIC - 1);
+    unsigned int a = after & (UTF8_GCB_PICTOGRAPHIC - 1);
+    if (b == UTF8_GCB_CR) {
+        return a == UTF8_GCB_LF;
+    }
+    if (b == UTF8_GCB_LF || b == UTF8_GCB_CONTROL || a == UTF8_GCB_CR || a == UTF8_GCB_LF || a == UTF8_GCB_CONTROL) {
+        return 0;
+    }
+    // Hangul syllable sequences
+    if (b == UTF8_GCB_L && (a == UTF8_GCB_L || a == UTF8_GCB_V || a == UTF8_GCB_LV || a == UTF8_GCB_LVT)) {
+        return 1;
+    }
+    if ((b == UTF8_GCB_LV || b == UTF8_GCB_V) && (a == UTF8_GCB_V || a == UTF8_GCB_T)) {
+        return 1;
+    }
+    if ((b == UTF8_GCB_LVT || b == UTF8_GCB_T) && a == UTF8_GCB_T) {
+        return 1;
+    }
+    if (a == UTF8_GCB_EXTEND || a == UTF8_GCB_ZWJ || a == UTF8_GCB_SPACINGMARK || b == UTF8_GCB_PREPEND) {
+        return 1;
+    }
+    if (b == UTF8_GCB_ZWJ && (after & UTF8_GCB_PICTOGRAPHIC)) {
+        return emojiZwj;
+    }
+    if (b == UTF8_GCB_RI && a == UTF8_GCB_RI) {
+        return oddRegional;
+    }
+    return 0;
+}
+
+// End of the grapheme cluster that starts at buf[pos] (pos < len). The character after the cluster is
+// usually looked up to find the boundary; *lookahead hands it to the next call (0: not looked up).
+static size_t utf8_grapheme_end(const uint8_t *buf, size_t len, size_t pos, unsigned int *lookahead) {
+    unsigned int before = (*lookahead != 0) ? *lookahead : utf8_grapheme_property(buf + pos, len - pos);
+    int emoji = (before & UTF8_GCB_PICTOGRAPHIC) ? 1 : 0; // 1 after a pictograph and Extend*, 2 after its ZWJ
+    size_t regional = ((before & (UTF8_GCB_PICTOGRAPHIC - 1)) == UTF8_GCB_RI); // regional indicators in a row
+    *lookahead = 0;
+    pos += before >> 8;
+    while (pos < len) {
+        // a lone ASCII byte (other than CR) ends the cluster before it, and starts the next one
+        if (buf[pos] < 0x80 && (before & (UTF8_GCB_PICTOGRAPHIC - 1)) != UTF8_GCB_CR &&
+            (before & (UTF8_GCB_PICTOGRAPHIC - 1)) != UTF8_GCB_PREPEND) {
+            break;
+        }
+        unsigned int after = utf8_grapheme_property(buf + pos, len - pos);
+        if (!utf8_grapheme_joins(before, after, emoji == 2, regional & 1)) {
+            *lookahead = after;
+            break;
+        }
+        unsigned int type = after & (UTF8_GCB_PICTOGRAPHIC - 1);
+        if (after & UTF8_GCB_PICTOGRAPHIC) {
+            emoji = 1;
+        } else if (emoji == 1 && (type == UTF8_GCB_EXTEND || type == UTF8_GCB_ZWJ)) {
+            emoji = (type == UTF8_GCB_ZWJ) ? 2 : 1;
+        } else {
+            emoji = 0;
+        }
+        regional = (type == UTF8_GCB_RI) ? regional + 1 : 0;
+        before = after;
+        pos += after >> 8;
+    }
+    return pos;
+}
+
+// Number of one-byte clusters at buf[pos]: the run of ASCII there up to its first CR (which may pair
+// with an LF), less its last byte when a combining mark could follow. Lets long ASCII text be skipped
+// with the vector kernel.
+static size_t utf8_grapheme_ascii_run(const uint8_t *buf, size_t len, size_t pos) {
+    size_t run = utf8_ascii_prefix(buf + pos, len - pos);
+    const uint8_t *cr = memchr(buf + pos, '\r', run);
+    if (cr != NULL) {
+        return (size_t)(cr - (buf + pos));
+    }
+    return (pos + run < len && run > 0) ? run - 1 : run;
+}
+
+// Moves pos forward by up to *count clusters; *count gets the number actually skipped
+static size_t utf8_grapheme_skip(const uint8_t *buf, size_t len, size_t pos, size_t *count) {
+    size_t remaining = *count;
+    unsigned int lookahead = 0;
+    while (pos < len && remaining > 0) {
+        if (buf[pos] < 0x80 && pos + 1 < len && buf[pos + 1] < 0x80) {
+            size_t run = utf8_grapheme_ascii_run(buf, len, pos);
+            if (run > 0) {
+                run = (run < remaining) ? run : remaining;
+                pos += run;
+                remaining -= run;
+                lookahead = 0;
+                continue;
+            }
+        }
+        pos = utf8_grapheme_end(buf, len, pos, &lookahead);
+        remaining--;
+    }
+    *count -= remaining;
+    return pos;
+}
+
+void my_utf8_graphemes_init(my_utf8_graphemes *iterator, const uint8_t *buf, size_t len) {
+    iterator->buf = buf;
+    iterator->len = len;
+    iterator->pos = 0;
+    iterator->lookahead = 0;
+}
+
+// Next grapheme cluster as a byte span of the buffer: returns 1 with its offset and length, or 0 at the
+// end
+int my_utf8_graphemes_next(my_utf8_graphemes *iterator, size_t *offset, size_t *length) {
+    const uint8_t *buf = iterator->buf;
+    size_t pos = iterator->pos;
+    if (pos >= iterator->len) {
+        return 0;
+    }
+    size_t end;
+    if (buf[pos] < 0x80 && buf[pos] != '\r' && pos + 1 < iterator->len && buf[pos + 1] < 0x80) {
+        end = pos + 1; // ASCII followed by ASCII: nothing can join it
+        iterator->lookahead = 0;
+    } else {
+        end = utf8_grapheme_end(buf, iterator->len, pos, &iterator->lookahead);
+    }
+    *offset = pos;
+    *length = end - pos;
+    iterator->pos = end;
+    return 1;
+}
+
+// Number of grapheme clusters (user-perceived characters) in buf
+size_t my_utf8_grapheme_count(const uint8_t *buf, size_t len) {
+    size_t count = SIZE_MAX;
+    utf8_grapheme_skip(buf, len, 0, &count);
+    return count;
+}
+
+// my_utf8_charat_n in grapheme clusters: a pointer to the cluster at 'index' with its byte length in
+// *length, or NULL if there is no such cluster
+const uint8_t *my_utf8_grapheme_charat(const uint8_t *buf, size_t len, size_t index, size_t *length) {
+    size_t skipped = index;
+    size_t pos = utf8_grapheme_skip(buf, len, 0, &skipped);
+    if (pos >= len) {
+        *length = 0;
+        return NULL;
+    }
+    unsigned int lookahead = 0;
+    *length = utf8_grapheme_end(buf, len, pos, &lookahead) - pos;
+    return buf + pos;
+}
+
+// my_utf8_substring_n in grapheme clusters: copies 'length' clusters starting at cluster 'start', so
+// no accent, flag or emoji sequence is cut in two. Returns the number of bytes written.
+size_t my_utf8_grapheme_substring(const uint8_t *buf, size_t len, size_t start, size_t length, uint8_t *output) {
+    size_t first = utf8_grapheme_skip(buf, len, 0, &start);
+    size_t end = utf8_grapheme_skip(buf, len, first, &length);
+    memcpy(output, buf + first, end - first);
+    return end - first;
+}
+
+/* File mode: validate, count or decode a whole file. On POSIX systems the file is memory-mapped
+ * (with a sequential access hint) and processed in place with no read() copies; elsewhere it is
+ * read into memory in one go. */
+
+// Wall clock time in seconds
+static double utf8_now(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// Makes the whole file readable at *data. Returns 0, or -1 with errno set.
+static int utf8_map_file(const char *path, const uint8_t **data, size_t *len) {
+#ifdef UTF8_HAVE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return -1;
+    }
+    *len = (size_t)info.st_size;
+    *data = (const uint8_t *)"";
+    if (*len > 0) {
+        void *mapping = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        posix_madvise(mapping, *len, POSIX_MADV_SEQUENTIAL);
+        *data = mapping;
+    }
+    close(fd); // the mapping stays valid after the descriptor is closed
+    return 0;
+#else
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    uint8_t *buffer = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    for (;;) {
+        if (size == capacity) {
+            capacity = (capacity > 0) ? capacity * 2 : 1 << 20;
+            uint8_t *bigger = realloc(buffer, capacity);
+            if (bigger == NULL) {
+                free(buffer);
+                fclose(file);
+                return -1;
+            }
+            buffer = bigger;
+        }
+        size_t got = fread(buffer + size, 1, capacity - size, file);
+        size += got;
+        if (got == 0) {
+            break;
+        }
+    }
+    fclose(file);
+    *data = buffer;
+    *len = size;
+    return 0;
+#endif
+}
+
+static void utf8_unmap_file(const uint8_t *data, size_t len) {
+#ifdef UTF8_HAVE_MMAP
+    if (len > 0) {
+        munmap((void *)data, len);
+    }
+#else
+    (void)len;
+    free((void *)data);
+#endif
+}
+
+// Runs one operation over a whole file. Decoded text goes to 'output' (decode mode only).
+// Returns 0, or -1 with errno set if the file could not be opened or read (or, decoding, the output
+// buffer could not be allocated). Safe to call from several threads at once.
+int my_utf8_file(const char *path, enum my_utf8_file_mode mode, FILE *output, my_utf8_file_result *result) {
+    const uint8_t *data;
+    size_t len;
+    if (utf8_map_file(path, &data, &len) != 0) {
+        return -1;
+    }
+    memset(result, 0, sizeof(*result));
+    result->bytes = len;
+
+    double start = utf8_now();
+    switch (mode) {
+        case MY_UTF8_FILE_CHECK:
+            result->status = my_utf8_check_located(data, len, &result->error);
+            break;
+        case MY_UTF8_FILE_COUNT:
+            result->characters = my_utf8_strlen_n(data, len);
+            break;
+        case MY_UTF8_FILE_DECODE: {
+            // Decoded through a buffer of its own per call: one input byte becomes at most three output bytes
+            enum { CHUNK = 1 << 20 };
+            uint8_t *decoded = malloc(3 * (CHUNK + 4));
+            if (decoded == NULL) {
+                utf8_unmap_file(data, len);
+                return -1; // errno is ENOMEM
+            }
+            my_utf8_stream state;
+            my_utf8_stream_init(&state);
+            for (size_t pos = 0; pos < len; pos += CHUNK) {
+                size_t chunk = (len - pos < CHUNK) ? len - pos : CHUNK;
+                size_t written = my_utf8_decode_feed(&state, data + pos, chunk, decoded);
+                result->written += fwrite(decoded, 1, written, output);
+            }
+            size_t written = my_utf8_decode_finish(&state, decoded);
+            result->written += fwrite(decoded, 1, written, output);
+            free(decoded);
+            break;
+        }
+    }
+    result->seconds = utf8_now() - start;
+
+    utf8_unmap_file(data, len);
+    return 0;
+}
+
+/* Parallel check and count: the buffer is cut into chunks, every cut is moved back to the start of
+ * a character, and a pool of worker threads takes chunks in order until none are left. For the check
+ * the earliest failing chunk decides, so the result and error offset are exactly those of the
+ * sequential check; chunks after a known failure are skipped. Without POSIX threads, or for inputs
+ * too small to be worth it, everything runs on the calling thread. */
+#define UTF8_PARALLEL_CHUNK (4u << 20)    // bytes per chunk handed to a worker
+#define UTF8_PARALLEL_MIN (8u << 20)      // inputs smaller than this are not split
+#define UTF8_PARALLEL_MAX_THREADS 256
+
+typedef struct utf8_parallel_job {
+    const uint8_t *buf;
+    size_t len;
+    size_t chunks;
+    size_t *starts;                // starts[c] is the first byte of chunk c, starts[chunks] == len
+    int counting;                  // 1 for strlen, 0 for check
+    int *status;                   // check: result of each chunk
+    size_t *values;                // check: error offset of each chunk, strlen: characters in it
+    _Atomic size_t nextChunk;      // next chunk nobody has taken yet
+    _Atomic size_t firstFailure;   // check: lowest chunk known to fail (chunks if none)
+} utf8_parallel_job;
+
+// Worker loop: takes chunks one at a time until all are done
+static void *utf8_parallel_worker(void *argument) {
+    utf8_parallel_job *job = argument;
+    for (;;) {
+        size_t c = atomic_fetch_add(&job->nextChunk, 1);
+        if (c >= job->chunks) {
+            break;
+        }
+        const uint8_t *chunk = job->buf + job->starts[c];
+        size_t chunkLength = job->starts[c + 1] - job->starts[c];
+        if (job->counting) {
+            job->values[c] = my_utf8_strlen_n(chunk, chunkLength);
+            continue;
+        }
+        if (c > atomic_load(&job->firstFailure)) {
+            continue; // an earlier chunk already failed, so this one cannot change the result
+        }
+        job->status[c] = utf8_validate_at(chunk, chunkLength, &job->values[c]);
+        if (job->status[c] != 0) {
+            job->values[c] += job->starts[c];
+            size_t bad = job->values[c];
+            if (c + 1 < job->chunks && job->starts[c + 1] - bad < 4) {
+                // the bad character runs into the cut: take its code from the bytes after the cut too,
+                // as the sequential check sees them
+                size_t unused;
+                size_t window = (job->len - bad < 4) ? job->len - bad : 4;
+                job->status[c] = utf8_validate_at(job->buf + bad, window, &unused);
+            }
+            size_t known = atomic_load(&job->firstFailure);
+            while (c < known && !atomic_compare_exchange_weak(&job->firstFailure, &known, c)) {
+            }
+        }
+    }
+    return NULL;
+}
+
+// Number of threads to use when the caller passes 0 or less: one per online CPU
+static int utf8_default_threads(void) {
+#ifdef UTF8_HAVE_PTHREADS
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return (cpus > 0) ? (int)cpus : 1;
+#else
+    return 1;
+#endif
+}
+
+// Splits the buffer, runs the job on 'threads' threads (the caller is one of them) and returns 0,
+// or -1 if the bookkeeping could not be allocated
+static int utf8_parallel_run(utf8_parallel_job *job, int threads) {
+    job->chunks = (job->len + UTF8_PARALLEL_CHUNK - 1) / UTF8_PARALLEL_CHUNK;
+    job->starts = malloc((job->chunks + 1) * sizeof(size_t));
+    job->status = calloc(job->chunks, sizeof(int));
+    job->values = calloc(job->chunks, sizeof(size_t));
+    if (job->starts == NULL || job->status == NULL || job->values == NULL) {
+        free(job->starts);
+        free(job->status);
+        free(job->values);
+        return -1;
+    }
+    job->starts[0] = 0;
+    for (size_t c = 1; c < job->chunks; c++) {
+        size_t cut = c * UTF8_PARALLEL_CHUNK;
+        // step back over at most 3 continuation bytes, so the cut is in front of a lead byte. After
+        // 4 or more continuation bytes the one at the cut is stray anyway: cut there, in front of it,
+        // so no character that might be complete is split
+        size_t k = 0;
+        while (k < 3 && is_continuation_byte(job->buf[cut - k])) {
+            k++;
+        }
+        job->starts[c] = is_continuation_byte(job->buf[cut - k]) ? cut : cut - k;
+    }
+    job->starts[job->chunks] = job->len;
+    atomic_init(&job->nextChunk, 0);
+    atomic_init(&job->firstFailure, job->chunks);
+    // let the kernels pick their CPU level on this thread, before the workers use them
+    utf8_validate(job->buf, 0);
+    my_utf8_strlen_n(job->buf, 0);
+
+    if (threads > (int)job->chunks) {
+        threads = (int)job->chunks;
+    }
+    if (threads > UTF8_PARALLEL_MAX_THREADS) {
+        threads = UTF8_PARALLEL_MAX_THREADS;
+    }
+#ifdef UTF8_HAVE_PTHREADS
+    pthread_t workers[UTF8_PARALLEL_MAX_THREADS];
+    int started = 0;
+    while (started < threads - 1 && pthread_create(&workers[started], NULL, utf8_parallel_worker, job) == 0) {
+        started++;
+    }
+    utf8_parallel_worker(job);
+    for (int t = 0; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+#else
+    (void)threads;
+    utf8_parallel_worker(job);
+#endif
+    return 0;
+}
+
+// Parallel version of my_utf8_check_n - same result code. If errorOffset is set it receives the
+// offset of the first byte of the first bad character, the same one the sequential check stops at
+// (len for valid input). threads <= 0 uses one thread per CPU.
+int my_utf8_check_parallel(const uint8_t *buf, size_t len, int threads, size_t *errorOffset) {
+    if (len < UTF8_PARALLEL_MIN) {
+        return utf8_validate_at(buf, len, errorOffset);
+    }
+    if (threads <= 0) {
+        threads = utf8_default_threads();
+    }
+    utf8_parallel_job job = {.buf = buf, .len = len, .counting = 0};
+    if (threads == 1 || utf8_parallel_run(&job, threads) != 0) {
+        return utf8_validate_at(buf, len, errorOffset);
+    }
+
+    size_t failed = atomic_load(&job.firstFailure);
+    int result = (failed < job.chunks) ? job.status[failed] : 0;
+    if (errorOffset != NULL) {
+        *errorOffset = (failed < job.chunks) ? job.values[failed] : len;
+    }
+    free(job.starts);
+    free(job.status);
+    free(job.values);
+    return result;
+}
+
+// Parallel version of my_utf8_strlen_n. threads <= 0 uses one thread per CPU.
+size_t my_utf8_strlen_parallel(const uint8_t *buf, size_t len, int threads) {
+    if (len < UTF8_PARALLEL_MIN) {
+        return my_utf8_strlen_n(buf, len);
+    }
+    if (threads <= 0) {
+        threads = utf8_default_threads();
+    }
+    utf8_parallel_job job = {.buf = buf, .len = len, .counting = 1};
+    if (threads == 1 || utf8_parallel_run(&job, threads) != 0) {
+        return my_utf8_strlen_n(buf, len);
+    }
+
+    size_t count = 0;
+    for (size_t c = 0; c < job.chunks; c++) {
+        count += job.values[c];
+    }
+    free(job.starts);
+    free(job.status);
+    free(job.values);
+    return count;
+}
+
+/* Columnar batches: Arrow-style string columns, one contiguous data buffer and count + 1 offsets
+ * (row r is data[offsets[r]] up to data[offsets[r + 1]]). Instead of a check and a count per row the
+ * rows are taken in groups of up to 4 KB: one kernel call validates the whole group, and one sweep of
+ * start-of-character bit masks over it gives every row its character count with two popcounts. Only
+ * the rows of a group that fails are checked one by one (and the next groups are made smaller, so a
+ * column with scattered bad rows does not throw away 4 KB of work per bad row). Rows longer than a
+ * group are checked and counted on their own. */
+#define UTF8_BATCH_GROUP 4096     // most bytes validated with one call
+#define UTF8_BATCH_MIN_GROUP 256  // the group size after repeated failures
+
+// Bit i set when block[i] starts a character (is not 10xxxxxx), for 64 bytes
+static uint64_t utf8_starts_mask_swar(const uint8_t *block) {
+    uint64_t mask = 0;
+    for (int w = 0; w < 8; w++) {
+        uint64_t word;
+        memcpy(&word, block + 8 * w, sizeof(word));
+        uint64_t starts = ~(word & ~(word << 1)) & 0x8080808080808080ULL;
+        // gathers the top bit of every byte into the low 8 bits, byte 0 first
+        mask |= (((starts >> 7) * 0x0102040810204080ULL) >> 56) << (8 * w);
+    }
+    return mask;
+}
+
+#ifdef UTF8_X86_SIMD
+// Same compare as the counting kernels, keeping the mask instead of its popcount
+__attribute__((target("sse4.2")))
+static uint64_t utf8_starts_mask_sse42(const uint8_t *block) {
+    const __m128i last_continuation = _mm_set1_epi8(-65);
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i input = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+        mask |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(input, last_continuation)) << (16 * i);
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t utf8_starts_mask_avx2(const uint8_t *block) {
+    const __m256i last_continuation = _mm256_set1_epi8(-65);
+    __m256i low = _mm256_loadu_si256((const __m256i *)block);
+    __m256i high = _mm256_loadu_si256((const __m256i *)(block + 32));
+    return (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_cmpgt_epi8(low, last_continuation)) |
+           (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_cmpgt_epi8(high, last_continuation)) << 32;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static uint64_t utf8_starts_mask_avx512(const uint8_t *block) {
+    return _mm512_cmpgt_epi8_mask(_mm512_loadu_si512((const void *)block), _mm512_set1_epi8(-65));
+}
+#endif
+
+typedef uint64_t (*utf8_starts_mask_fn)(const uint8_t *);
+
+// Picks the start-of-character kernel for this CPU on the first call
+static uint64_t utf8_starts_mask(const uint8_t *block) {
+    static utf8_starts_mask_fn starts = NULL;
+    if (starts == NULL) {
+        switch (utf8_detect_cpu()) {
+#ifdef UTF8_X86_SIMD
+            case UTF8_CPU_AVX512:
+                starts = utf8_starts_mask_avx512;
+                break;
+            case UTF8_CPU_AVX2:
+                starts = utf8_starts_mask_avx2;
+                break;
+            case UTF8_CPU_SSE42:
+                starts = utf8_starts_mask_sse42;
+                break;
+#endif
+            default:
+                starts = utf8_starts_mask_swar;
+        }
+    }
+    return starts(block);
+}
+
+// Start bits of the len bytes of a group and the characters in front of each 64-byte block of it.
+// Entry len / 64 is the partial last block (padded with continuation bytes, which are not counted) or,
+// when there is none, an empty block, so every position 0..len can be looked up.
+static void utf8_batch_starts(const uint8_t *bytes, size_t len, uint64_t *starts, uint32_t *before) {
+    size_t blocks = len / 64;
+    uint32_t count = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        starts[b] = utf8_starts_mask(bytes + 64 * b);
+        before[b] = count;
+        count += (uint32_t)utf8_popcount64(starts[b]);
+    }
+    uint8_t padded[64];
+    memset(padded, 0x80, sizeof(padded));
+    memcpy(padded, bytes + 64 * blocks, len % 64);
+    starts[blocks] = utf8_starts_mask(padded);
+    before[blocks] = count;
+}
+
+// Characters starting in front of position pos of the group
+static inline size_t utf8_batch_characters(const uint64_t *starts, const uint32_t *before, size_t pos) {
+    return before[pos / 64] + (size_t)utf8_popcount64(starts[pos / 64] & ((1ULL << (pos % 64)) - 1));
+}
+
+static inline int utf8_batch_starts_at(const uint64_t *starts, size_t pos) {
+    return (int)((starts[pos / 64] >> (pos % 64)) & 1);
+}
+
+static inline size_t utf8_batch_offset(const void *offsets, int large, size_t row) {
+    return large ? (size_t)((const int64_t *)offsets)[row] : (size_t)((const int32_t *)offsets)[row];
+}
+
+// Stores the result of one row; the validity bits are collected in *bits and written a byte at a time
+static inline void utf8_batch_store(uint8_t *validity, void *lengths, int large, size_t row, size_t count,
+                                    int valid, size_t characters, unsigned int *bits) {
+    if (validity != NULL) {
+        *bits |= (unsigned int)valid << (row % 8);
+        if (row % 8 == 7 || row == count - 1) {
+            validity[row / 8] = (uint8_t)*bits;
+            *bits = 0;
+        }
+    }
+    if (lengths != NULL && large) {
+        ((int64_t *)lengths)[row] = (int64_t)characters;
+    } else if (lengths != NULL) {
+        ((int32_t *)lengths)[row] = (int32_t)characters;
+    }
+}
+
+// Shared body of the 32- and 64-bit offset versions; 'large' is a constant in both callers
+static inline size_t utf8_check_batch(const uint8_t *data, const void *offsets, int large, size_t count,
+                                      uint8_t *validity, void *lengths) {
+    uint64_t starts[UTF8_BATCH_GROUP / 64 + 1];
+    uint32_t before[UTF8_BATCH_GROUP / 64 + 1];
+    size_t groupSize = UTF8_BATCH_GROUP;
+    unsigned int bits = 0;
+    size_t invalid = 0;
+    size_t row = 0;
+    while (row < count) {
+        size_t groupStart = utf8_batch_offset(offsets, large, row);
+        size_t rowEnd = utf8_batch_offset(offsets, large, row + 1);
+        if (rowEnd - groupStart > UTF8_BATCH_GROUP) {
+            // a long row: the plain kernels are already the fastest way through it
+            int valid = utf8_validate(data + groupStart, rowEnd - groupStart) == 0;
+            invalid += !valid;
+            utf8_batch_store(validity, lengths, large, row, count, valid,
+                             utf8_count(data + groupStart, rowEnd - groupStart), &bits);
+            row++;
+            continue;
+        }
+
+        size_t last = row + 1;
+        while (last < count && utf8_batch_offset(offsets, large, last + 1) - groupStart <= groupSize) {
+            last++;
+        }
+        size_t groupLength = utf8_batch_offset(offsets, large, last) - groupStart;
+        const uint8_t *group = data + groupStart;
+        utf8_batch_starts(group, groupLength, starts, before);
+        int groupValid = utf8_validate(group, groupLength) == 0;
+        if (groupValid) {
+            groupSize = (groupSize < UTF8_BATCH_GROUP) ? 2 * groupSize : groupSize;
+        } else {
+            groupSize = (groupSize > UTF8_BATCH_MIN_GROUP) ? groupSize / 2 : groupSize;
+        }
+
+        // rows follow each other, so one row's end is the next one's start
+        size_t start = utf8_batch_offset(offsets, large, row) - groupStart;
+        size_t first = utf8_batch_characters(starts, before, start);
+        int startsCharacter = utf8_batch_starts_at(starts, start);
+        for (; row < last; row++) {
+            size_t end = utf8_batch_offset(offsets, large, row + 1) - groupStart;
+            size_t after = utf8_batch_characters(starts, before, end);
+            int endsCharacter = end == groupLength || utf8_batch_starts_at(starts, end);
+            int valid;
+            if (groupValid) {
+                // the group is valid, so a row of it is valid exactly when it is not cut inside a character
+                valid = start == end || (startsCharacter && endsCharacter);
+            } else {
+                valid = utf8_validate(group + start, end - start) == 0;
+            }
+            invalid += !valid;
+            utf8_batch_store(validity, lengths, large, row, count, valid, after - first, &bits);
+            start = end;
+            first = after;
+            startsCharacter = endsCharacter;
+        }
+    }
+    return invalid;
+}
+
+// Validates and measures every row of a string column with 32-bit offsets (Arrow's utf8 type).
+// offsets holds count + 1 non-decreasing byte offsets into data. Bit r of validity (least significant
+// bit first, as in Arrow bitmaps) is set when row r is valid UTF-8, and lengths[r] is its number of
+// characters as my_utf8_strlen_n counts them (for invalid rows too). Either output may be NULL.
+// Returns the number of invalid rows.
+size_t my_utf8_check_batch(const uint8_t *data, const int32_t *offsets, size_t count, uint8_t *validity,
+                           int32_t *lengths) {
+    return utf8_check_batch(data, offsets, 0, count, validity, lengths);
+}
+
+// my_utf8_check_batch for columns with 64-bit offsets (Arrow's large_utf8 type)
+size_t my_utf8_check_batch_large(const uint8_t *data, const int64_t *offsets, size_t count, uint8_t *validity,
+                                 int64_t *lengths) {
+    return utf8_check_batch(data, offsets, 1, count, validity, lengths);
+}
+
+// Function to test the my_utf8_check function with meaningful names and error codes
+void test_utf8_check(char *test_string, int expected_error) {
+    int result = my_utf8_check((unsigned char *)test_string);
+
+    printf("Testing: %s\n", test_string);
+
+    if (result == expected_error) {
+        printf("Result: Passed\n");
+    } else {
+        printf("Result: Failed (Expected: %d, Actual: %d)\n", expected_error, result);
+    }
+
+    printf("\n");
+}
+
+// Function to test all UTF-8 check cases
+void test_all_utf8_checks() {
+    // Test cases with meaningful names and error codes
+    test_utf8_check("Valid string", 0);
+    test_utf8_check("Invalid lead byte", -1);
+    test_utf8_check("Invalid continuation byte", -2);
+    test_utf8_check("Overlong encoding", -3); /* for example, using more bytes than necessary,
+    U0041 need two bytes to encode, if you use 3 - overlong */
+    //code point outside of valid Unicode range (0xD800 to 0xFFFF)
+    test_utf8_check("Invalid code point", -4);
+    //if continuation byte encountered by unexpected position
+    test_utf8_check("Unexpected continuation byte", -5);
+}
+//tests for every function
+// "helper function" since we cant not use any str library
+int compareStrings(const char *str1, const char *str2) {
+    while (*str1 != '\0' && *str2 != '\0') {
+        if (*str1 != *str2) {
+            return 1; // Strings are not equal
+        }
+        str1++;
+        str2++;
+    }
+
+    if (*str1 != '\0' || *str2 != '\0') {
+        return 1; // One string is shorter than the other
+    }
+
+    return 0; // Strings are equal
+}
+//Tests for deocding
+void test_my_utf8_decode() {
+    // Test with ASCII characters
+    unsigned char input1[] = "Hello";
+    unsigned char output1[20];
+    int result1 = my_utf8_decode(input1, output1);
+    printf("%s: input='%s', expected='Hello', actual='%s'\n",
+           (result1 == 0 && compareStrings(output1, "Hello") == 0) ? "PASSED" : "FAILED", input1, output1);
+
+    // Test with non-ASCII characters
+    unsigned char input2[] = "你好";
+    unsigned char output2[20];
+    int result2 = my_utf8_decode(input2, output2);
+    printf("%s: input='%s', expected='你好', actual='%s'\n",
+           (result2 == 0 && compareStrings(output2, "你好") == 0) ? "PASSED" : "FAILED", input2, output2);
+
+    // Test with invalid UTF-8 sequence
+    unsigned char input3[] = "abc\xFFxyz";
+    unsigned char output3[20];
+    int result3 = my_utf8_decode(input3, output3);
+    printf("%s: input='%s', expected=-1, actual=%d\n", (result3 == -1) ? "PASSED" : "FAILED", input3, result3);
+
+    // Test with a mix of ASCII and non-ASCII characters
+    unsigned char input4[] = "Hello 你好 😊";
+    unsigned char output4[32]; // "Hello \u4F60\u597D \u1F60A" and the terminator
+    int result4 = my_utf8_decode(input4, output4);
+    printf("%s: input='%s', expected='Hello 你好 😊', actual='%s'\n",
+           (result4 == 0 && compareStrings(output4, "Hello 你好 😊") == 0) ? "PASSED" : "FAILED", input4, output4);
+}
+//Tests for strcmp
+
+void test_my_utf8_strcmp() {
+    // Test with equal strings
+    unsigned char string1_1[] = "Hello";
+    unsigned char string2_1[] = "Hello";
+    int result1 = my_utf8_strcmp(string1_1, string2_1);
+    printf("%s: string1='%s', string2='%s', expected=0, actual=%d\n", (result1 == 0) ? "PASSED" : "FAILED", string1_1,
+           string2_1, result1);
+
+    // Test with string1 shorter than string2
+    unsigned char string1_2[] = "Hi";
+    unsigned char string2_2[] = "Hello";
+    int result2 = my_utf8_strcmp(string1_2, string2_2);
+    printf("%s: string1='%s', string2='%s', expected<0, actual=%d\n", (result2 < 0) ? "PASSED" : "FAILED", string1_2,
+           string2_2, result2);
+
+    // Test with string1 longer than string2
+    unsigned char string1_3[] = "Hello";
+    unsigned char string2_3[] = "Hi";
+    int result3 = my_utf8_strcmp(string1_3, string2_3);
+    printf("%s: string1='%s', string2='%s', expected>0, actual=%d\n", (result3 > 0) ? "PASSED" : "FAILED", string1_3,
+           string2_3, result3);
+
+    // Test with non-ASCII characters
+    unsigned char string1_4[] = "你好";
+    unsigned char string2_4[] = "こんにちは";
+    int result4 = my_utf8_strcmp(string1_4, string2_4);
+    printf("%s: string1='%s', string2='%s', expected<0, actual=%d\n", (result4 < 0) ? "PASSED" : "FAILED", string1_4,
+           string2_4, result4);
+
+    // Test with equal non-ASCII characters
+    unsigned char string1_5[] = "你好";
+    unsigned char string2_5[] = "你好";
+    int result5 = my_utf8_strcmp(string1_5, string2_5);
+    printf("%s: string1='%s', string2='%s', expected=0, actual=%d\n", (result5 == 0) ? "PASSED" : "FAILED", string1_5,
+           string2_5, result5);
+
+    // Test with an empty string
+    unsigned char string1_6[] = "";
+    unsigned char string2_6[] = "Hello";
+    int result6 = my_utf8_strcmp(string1_6, string2_6);
+    printf("%s: string1='%s', string2='%s', expected<0, actual=%d\n", (result6 < 0) ? "PASSED" : "FAILED", string1_6,
+           string2_6, result6);
+
+}
+
+//tests for my strlen function
+void test_my_utf8_strlen() {
+    // Test with ASCII characters
+    unsigned char string1[] = "Hello";
+    int result1 = my_utf8_strlen(string1);
+    printf("%s: string='%s', expected=5, actual=%d\n", (result1 == 5) ? "PASSED" : "FAILED", string1, result1);
+
+    // Test with non-ASCII characters
+    unsigned char string2[] = "你好";
+    int result2 = my_utf8_strlen(string2);
+    printf("%s: string='%s', expected=2, actual=%d\n", (result2 == 2) ? "PASSED" : "FAILED", string2, result2);
+
+    // Test with a mix of ASCII and non-ASCII characters
+    unsigned char string3[] = "Hello 你好";
+    int result3 = my_utf8_strlen(string3);
+    printf("%s: string='%s', expected=9, actual=%d\n", (result3 == 9) ? "PASSED" : "FAILED", string3, result3);
+
+    // Test with an empty string
+    unsigned char string4[] = "";
+    int result4 = my_utf8_strlen(string4);
+    printf("%s: string='%s', expected=0, actual=%d\n", (result4 == 0) ? "PASSED" : "FAILED", string4, result4);
+}
+
+//Tests for my chrat function
+void test_my_utf8_charat() {
+    // Test with valid index within the string
+    unsigned char string1[] = "Hello";
+    char *result1 = my_utf8_charat(string1, 2);
+    printf("%s: string='%s', index=2, expected='l', actual='%s'\n",
+           (result1 != NULL && compareStrings(result1, "l") == 0) ? "PASSED" : "FAILED", string1, result1);
+
+    // Test with valid index at the end of the string
+    unsigned char string2[] = "你好";
+    char *result2 = my_utf8_charat(string2, 2);
+    printf("%s: string='%s', index=2, expected='好', actual='%s'\n",
+           (result2 != NULL && compareStrings(result2, "好") == 0) ? "PASSED" : "FAILED", string2, result2);
+
+    // Test with valid index at the start of the string
+    unsigned char string3[] = "Hello 你好";
+    char *result3 = my_utf8_charat(string3, 0);
+    printf("%s: string='%s', index=0, expected='H', actual='%s'\n",
+           (result3 != NULL && compareStrings(result3, "H") == 0) ? "PASSED" : "FAILED", string3, result3);
+
+    // Test with invalid negative index
+    unsigned char string4[] = "Hello";
+    char *result4 = my_utf8_charat(string4, -1);
+    printf("%s: string='%s', index=-1, expected=NULL, actual='%s'\n", (result4 == NULL) ? "PASSED" : "FAILED", string4,
+           result4);
+
+    // Test with invalid index beyond the string length
+    unsigned char string5[] = "Hello";
+    char *result5 = my_utf8_charat(string5, 10);
+    printf("%s: string='%s', index=10, expected=NULL, actual='%s'\n", (result5 == NULL) ? "PASSED" : "FAILED", string5,
+           result5);
+
+    // Test with an empty string
+    unsigned char string6[] = "";
+    char *result6 = my_utf8_charat(string6, 0);
+    printf("%s: string='%s', index=0, expected=NULL, actual='%s'\n", (result6 == NULL) ? "PASSED" : "FAILED", string6,
+           result6);
+}
+//Tests for substring
+void test_my_utf8_substring() {
+    // Test with valid substring within the string
+    char input1[] = "Hello World";
+    char output1[20];
+    my_utf8_substring(input1, 6, 5, output1);
+    printf("%s: input='%s', start=6, length=5, expected='World', actual='%s'\n",
+           (compareStrings(output1, "World") == 0) ? "PASSED" : "FAILED", input1, output1);
+
+    // Test with valid substring starting from the beginning
+    char input2[] = "你好 World";
+    char output2[20];
+    my_utf8_substring(input2, 0, 6, output2);
+    printf("%s: input='%s', start=0, length=6, expected='你好 Wo', actual='%s'\n",
+           (compareStrings(output2, "你好 Wo") == 0) ? "PASSED" : "FAILED", input2, output2);
+
+    // Test with valid substring starting from the middle
+    char input3[] = "Hello 你好";
+    char output3[20];
+    my_utf8_substring(input3, 6, 2, output3);
+    printf("%s: input='%s', start=6, length=2, expected='你好', actual='%s'\n",
+           (compareStrings(output3, "你好") == 0) ? "PASSED" : "FAILED", input3, output3);
+
+    // Test with valid substring until the end of the string
+    char input4[] = "Hello 你好";
+    char output4[20];
+    my_utf8_substring(input4, 6, 10, output4);
+    printf("%s: input='%s', start=6, length=10, expected='你好', actual='%s'\n",
+           (compareStrings(output4, "你好") == 0) ? "PASSED" : "FAILED", input4, output4);
+
+    // Test with invalid negative start index
+    char input5[] = "Hello";
+    char output5[20];
+    my_utf8_substring(input5, -2, 3, output5);
+    printf("%s: input='%s', start=-2, length=3, expected='', actual='%s'\n",
+           (compareStrings(output5, "") == 0) ? "PASSED" : "FAILED", input5, output5);
+
+    // Test with invalid length exceeding the string length
+    char input6[] = "Hello";
+    char output6[20];
+    my_utf8_substring(input6, 2, 10, output6);
+    printf("%s: input='%s', start=2, length=10, expected='llo', actual='%s'\n",
+           (compareStrings(output6, "llo") == 0) ? "PASSED" : "FAILED", input6, output6);
+
+    // Test with an empty string
+    char input7[] = "";
+    char output7[20];
+    my_utf8_substring(input7, 0, 5, output7);
+    printf("%s: input='%s', start=0, length=5, expected='', actual='%s'\n",
+           (compareStrings(output7, "") == 0) ? "PASSED" : "FAILED", input7, output7);
+}
+//Tests for my longest sequence
+void test_findLongestContinuousSequence() {
+    // Test with multiple spaces
+    char input1[] = "Hello   World";
+    printf("Input: %s\n", input1);
+    printf("Expected: Hello\n");
+    printf("Actual: ");
+    findLongestContinuousSequence(input1);
+    printf("\n");
+
+    // Test with a mix of spaces and tabs
+    char input2[] = "Hello\t\tWorld";
+    printf("Input: %s\n", input2);
+    printf("Expected: Hello\n");
+    printf("Actual: ");
+    findLongestContinuousSequence(input2);
+    printf("\n");
+
+    // Test with a mix of spaces, tabs, and newlines
+    char input3[] = "Hello  \tWorld\n";
+    printf("Input: %s\n", input3);
+    printf("Expected: Hello\n");
+    printf("Actual: ");
+    findLongestContinuousSequence(input3);
+    printf("\n");
+
+    // Test with continuous sequence at the end
+    char input4[] = "Hello World   ";
+    printf("Input: %s\n", input4);
+    printf("Expected: World\n");
+    printf("Actual: ");
+    findLongestContinuousSequence(input4);
+    printf("\n");
+
+    // Test with an empty string
+    char input5[] = "";
+    printf("Input: %s\n", input5);
+    printf("Expected: No continuous sequence found.\n");
+    printf("Actual: ");
+    findLongestContinuousSequence(input5);
+    printf("\n");
+
+    // Test with a single character
+    char input6[] = "H";
+    printf("Input: %s\n", input6);
+    printf("Expected: H (length: 1)\n");
+    printf("Actual: ");
+    findLongestContinuousSequence(input6);
+    printf("\n");
+
+    // Test with multiple continuous sequences
+    char input7[] = "Hello  World   ";
+    printf("Input: %s\n", input7);
+    printf("Expected: World\n");
+    printf("Actual: ");
+    findLongestContinuousSequence(input7);
+    printf("\n");
+}
+
+//Testing for encoding
+void test_my_utf8_encode() {
+    // Test with a simple ASCII string
+    char input1[] = "Hello";
+    char output1[20];
+    my_utf8_encode(input1, output1);
+    printf("%s: input='%s', expected='%s', actual='%s'\n", (compareStrings(input1, output1) == 0) ? "PASSED" : "FAILED",
+           input1, input1, output1);
+
+    // Test with a string containing a single Unicode escape sequence
+    char input2[] = "H\\u00E9llo"; // "é" in Unicode
+    char output2[20];
+    my_utf8_encode(input2, output2);
+    printf("%s: input='%s', expected='Héllo', actual='%s'\n",
+           (compareStrings("Hé llo", output2) == 0) ? "PASSED" : "FAILED", input2, output2);
 
     // Test with a string containing multiple Unicode escape sequences
     char input3[] = "He\\u006C\\u006Co";
@@ -734,22 +4632,1547 @@ void test_my_utf8_encode() {
     printf("%s: input='%s', expected='Hello', actual='%s'\n",
            (compareStrings("Hello", output3) == 0) ? "PASSED" : "FAILED", input3, output3);
 
-    // Test with an empty string
-    char input4[] = "";
-    char output4[20];
-    my_utf8_encode(input4, output4);
-    printf("%s: input='%s', expected='', actual='%s'\n", (compareStrings("", output4) == 0) ? "PASSED" : "FAILED",
-           input4, output4);
+    // Test with an empty string
+    char input4[] = "";
+    char output4[20];
+    my_utf8_encode(input4, output4);
+    printf("%s: input='%s', expected='', actual='%s'\n", (compareStrings("", output4) == 0) ? "PASSED" : "FAILED",
+           input4, output4);
+
+    // Test with a string containing only Unicode escape sequences
+    char input5[] = "\\u0041\\u0042\\u0043";
+    char output5[20];
+    my_utf8_encode(input5, output5);
+    printf("%s: input='%s', expected='ABC', actual='%s'\n", (compareStrings("ABC", output5) == 0) ? "PASSED" : "FAILED",
+           input5, output5);
+}
+
+//Tests for check on inputs long enough to go through the SIMD kernels
+void test_my_utf8_check_long() {
+    unsigned char input[200];
+    // 150 bytes of mixed text: ASCII, 2, 3 and 4-byte characters, repeated
+    const char *pattern = "Hello \xC3\xA9 \xE4\xBD\xA0\xE5\xA5\xBD \xF0\x9F\x98\x8A ";
+    int pos = 0;
+    while (pos < 150) {
+        for (int k = 0; pattern[k] != '\0' && pos < 150; k++) {
+            input[pos++] = (unsigned char)pattern[k];
+        }
+    }
+    while ((input[pos - 1] & 0xC0) == 0x80 || input[pos - 1] >= 0xC0) {
+        pos--; // don't end on a cut character
+    }
+    input[pos] = '\0';
+    int result1 = my_utf8_check(input);
+    printf("%s: long valid input, expected=0, actual=%d\n", (result1 == 0) ? "PASSED" : "FAILED", result1);
+
+    // Corrupt one byte near the end of the buffer with each kind of error
+    struct {
+        unsigned char bytes[4];
+        int length;
+        int expected;
+    } cases[] = {
+            {{0xFF}, 1, -1},                   // invalid lead byte
+            {{0xE4, 0x41, 0x41}, 3, -2},       // missing continuation byte
+            {{0xC1, 0x81}, 2, -3},             // overlong 'A'
+            {{0xE0, 0x81, 0x81}, 3, -3},       // overlong 3-byte encoding
+            {{0xED, 0xA0, 0x80}, 3, -4},       // surrogate U+D800
+            {{0xF4, 0x90, 0x80, 0x80}, 4, -4}, // above U+10FFFF
+            {{0x80}, 1, -5}                    // stray continuation byte
+    };
+    for (int c = 0; c < (int)(sizeof(cases) / sizeof(cases[0])); c++) {
+        unsigned char corrupted[200];
+        for (int k = 0; k <= pos; k++) {
+            corrupted[k] = input[k];
+        }
+        // offset 105 is the start of "Hello " so the error bytes replace whole characters
+        for (int k = 0; k < cases[c].length; k++) {
+            corrupted[105 + k] = cases[c].bytes[k];
+        }
+        int result = my_utf8_check(corrupted);
+        printf("%s: error case %d at offset 105, expected=%d, actual=%d\n",
+               (result == cases[c].expected) ? "PASSED" : "FAILED", c, cases[c].expected, result);
+    }
+}
+
+//Tests for the length-delimited variants - every call works on a slice in the middle of one buffer,
+//so nothing may read up to the null terminator
+void test_my_utf8_n_variants() {
+    // "xxHello 你好 😊yy" - the slice is everything between the x's and the y's
+    const uint8_t buffer[] = "xxHello \xE4\xBD\xA0\xE5\xA5\xBD \xF0\x9F\x98\x8Ayy";
+    const uint8_t *slice = buffer + 2;
+    size_t sliceLength = sizeof(buffer) - 1 - 4;
+    uint8_t output[64];
+
+    size_t length = my_utf8_strlen_n(slice, sliceLength);
+    printf("%s: strlen_n, expected=10, actual=%zu\n", (length == 10) ? "PASSED" : "FAILED", length);
+
+    int check = my_utf8_check_n(slice, sliceLength);
+    printf("%s: check_n, expected=0, actual=%d\n", (check == 0) ? "PASSED" : "FAILED", check);
+    check = my_utf8_check_n(slice, sliceLength - 1); // cuts the emoji in half
+    printf("%s: check_n on cut character, expected=-2, actual=%d\n", (check == -2) ? "PASSED" : "FAILED", check);
+
+    const uint8_t *character = my_utf8_charat_n(slice, sliceLength, 7);
+    printf("%s: charat_n, index=7, expected offset 9, actual=%d\n",
+           (character == slice + 9) ? "PASSED" : "FAILED", character ? (int)(character - slice) : -1);
+    character = my_utf8_charat_n(slice, sliceLength, 10);
+    printf("%s: charat_n, index=10, expected=NULL\n", (character == NULL) ? "PASSED" : "FAILED");
+
+    size_t written = my_utf8_substring_n(slice, sliceLength, 6, 2, output);
+    output[written] = '\0';
+    printf("%s: substring_n, start=6, length=2, expected='你好', actual='%s'\n",
+           (compareStrings((char *)output, "\xE4\xBD\xA0\xE5\xA5\xBD") == 0) ? "PASSED" : "FAILED", output);
+
+    written = my_utf8_decode_n(slice, sliceLength, output);
+    output[written] = '\0';
+    printf("%s: decode_n, expected='Hello \\u4F60\\u597D \\u1F60A', actual='%s'\n",
+           (compareStrings((char *)output, "Hello \\u4F60\\u597D \\u1F60A") == 0) ? "PASSED" : "FAILED", output);
+
+    const uint8_t escaped[] = "\\u0041\\u00E9\\u00";
+    written = my_utf8_encode_n(escaped, 12, output); // the trailing "\u00" is outside the slice
+    output[written] = '\0';
+    printf("%s: encode_n, expected='A\xC3\xA9', actual='%s'\n",
+           (compareStrings((char *)output, "A\xC3\xA9") == 0) ? "PASSED" : "FAILED", output);
+
+    int compare = my_utf8_strcmp_n(slice, 5, (const uint8_t *)"Help", 4);
+    printf("%s: strcmp_n 'Hello' vs 'Help', expected<0, actual=%d\n", (compare < 0) ? "PASSED" : "FAILED", compare);
+    compare = my_utf8_strcmp_n(slice, 5, buffer + 2, 5);
+    printf("%s: strcmp_n equal slices, expected=0, actual=%d\n", (compare == 0) ? "PASSED" : "FAILED", compare);
+}
+
+//Tests for strlen on inputs long enough to go through the counting kernels, at every length and
+//alignment so each kernel's tail handling is covered
+void test_my_utf8_strlen_long() {
+    uint8_t input[300];
+    const char *pattern = "Hello \xC3\xA9 \xE4\xBD\xA0\xE5\xA5\xBD \xF0\x9F\x98\x8A ";
+    size_t patternLength = strlen(pattern);
+    for (size_t k = 0; k < sizeof(input); k++) {
+        input[k] = (uint8_t)pattern[k % patternLength];
+    }
+
+    int failures = 0;
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t length = 0; offset + length <= sizeof(input); length++) {
+            size_t expected = 0;
+            for (size_t k = offset; k < offset + length; k++) {
+                if ((input[k] & 0xC0) != 0x80) {
+                    expected++;
+                }
+            }
+            if (my_utf8_strlen_n(input + offset, length) != expected) {
+                failures++;
+            }
+        }
+    }
+    printf("%s: strlen_n on every slice of a 300-byte mixed buffer, mismatches=%d\n",
+           (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for the ASCII runs in decode and encode - one non-ASCII character or escape at every position
+//of a long ASCII string, so the run is cut at every offset inside and across the SIMD blocks
+void test_my_utf8_ascii_runs() {
+    uint8_t input[160];
+    uint8_t output[200];
+    uint8_t expected[200];
+    int failures = 0;
+
+    for (size_t k = 0; k < 140; k++) {
+        // decode: 'a' * k + "ébc"  ->  'a' * k + "\\u00E9bc"
+        memset(input, 'a', k);
+        memcpy(input + k, "\xC3\xA9" "bc", 4);
+        memset(expected, 'a', k);
+        memcpy(expected + k, "\\u00E9bc", 8);
+        size_t written = my_utf8_decode_n(input, k + 4, output);
+        if (written != k + 8 || memcmp(output, expected, written) != 0) {
+            failures++;
+        }
+
+        // encode: 'a' * k + "\\u00E9bc"  ->  'a' * k + "ébc"
+        memcpy(input, expected, k + 8);
+        memcpy(expected + k, "\xC3\xA9" "bc", 4);
+        written = my_utf8_encode_n(input, k + 8, output);
+        if (written != k + 4 || memcmp(output, expected, written) != 0) {
+            failures++;
+        }
+    }
+    printf("%s: decode_n/encode_n with an ASCII run of every length up to 140, mismatches=%d\n",
+           (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for the escape emitter - every code point must come out exactly like sprintf("\\u%04X") did
+void test_appendUnicodeEscape() {
+    int failures = 0;
+    char expected[16];
+    char actual[16];
+    for (unsigned int codePoint = 0; codePoint <= 0x10FFFF; codePoint += 7) {
+        int expectedLength = sprintf(expected, "\\u%04X", codePoint);
+        char *out = actual;
+        appendUnicodeEscape(codePoint, &out);
+        if (out - actual != expectedLength || memcmp(actual, expected, (size_t)expectedLength) != 0) {
+            failures++;
+        }
+    }
+    printf("%s: appendUnicodeEscape matches sprintf up to U+10FFFF, mismatches=%d\n",
+           (failures == 0) ? "PASSED" : "FAILED", failures);
+
+    // 你, 好, 😊 in one batch
+    unsigned int codePoints[] = {0x4F60, 0x597D, 0x1F60A};
+    char escapes[3 * 8 + 1]; // up to 8 bytes ("\\u10FFFF") per code point and the terminator
+    char *out = escapes;
+    appendUnicodeEscapes(codePoints, 3, &out);
+    *out = '\0';
+    printf("%s: appendUnicodeEscapes, expected='\\u4F60\\u597D\\u1F60A', actual='%s'\n",
+           (compareStrings(escapes, "\\u4F60\\u597D\\u1F60A") == 0) ? "PASSED" : "FAILED", escapes);
+}
+
+//Tests for the escapes my_utf8_encode understands besides plain \uXXXX
+void test_my_utf8_encode_escapes() {
+    struct {
+        const char *input;
+        const char *expected;
+    } cases[] = {
+            {"\\uD83D\\uDE0A", "\xF0\x9F\x98\x8A"},          // surrogate pair -> one 4-byte 😊
+            {"\\ud83d\\ude0a!", "\xF0\x9F\x98\x8A!"},        // lower case hex digits
+            {"\\U0001F60A", "\xF0\x9F\x98\x8A"},             // 8-digit escape
+            {"a\\uD83Db", "a\xEF\xBF\xBD" "b"},              // lone high surrogate -> U+FFFD
+            {"\\uDE0A\\uD83D", "\xEF\xBF\xBD\xEF\xBF\xBD"},  // pair in the wrong order
+            {"\\U00110000", "\xEF\xBF\xBD"},                 // above U+10FFFF
+            {"\\u12G4", "\\u12G4"},                          // not a hex digit - copied through
+            {"\\u00E", "\\u00E"},                            // too short
+            {"C:\\\\path", "C:\\\\path"}                     // other backslashes are left alone
+    };
+    for (int c = 0; c < (int)(sizeof(cases) / sizeof(cases[0])); c++) {
+        char output[32];
+        my_utf8_encode((char *)cases[c].input, output);
+        printf("%s: input='%s', expected='%s', actual='%s'\n",
+               (compareStrings(output, cases[c].expected) == 0) ? "PASSED" : "FAILED", cases[c].input,
+               cases[c].expected, output);
+    }
+
+    // The branchless hex parser against a plain digit loop, for every byte value in every position
+    int failures = 0;
+    for (int position = 0; position < 4; position++) {
+        for (int byte = 0; byte < 256; byte++) {
+            uint8_t digits[4] = {'7', 'a', 'F', '0'};
+            digits[position] = (uint8_t)byte;
+            unsigned int expected = 0;
+            int expectedValid = 1;
+            for (int k = 0; k < 4; k++) {
+                int c = digits[k];
+                int nibble = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                                                                 (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+                if (nibble < 0) {
+                    expectedValid = 0;
+                }
+                expected = (expected << 4) | (unsigned int)(nibble & 0xF);
+            }
+            unsigned int value;
+            int valid = parse_hex4(digits, &value);
+            if (valid != expectedValid || (valid && value != expected)) {
+                failures++;
+            }
+        }
+    }
+    printf("%s: parse_hex4 on every byte value, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Feeds one chunk to both a check and a decode stream (helper for test_my_utf8_stream)
+static void test_stream_feed(my_utf8_stream *checkState, my_utf8_stream *decodeState, const uint8_t *chunk,
+                             size_t len, uint8_t *decoded, size_t *decodedLength) {
+    my_utf8_check_feed(checkState, chunk, len);
+    *decodedLength += my_utf8_decode_feed(decodeState, chunk, len, decoded + *decodedLength);
+}
+
+//Tests for the streaming API - every input is fed in two chunks split at every position, and one byte
+//at a time, and must give the same result as one call on the whole input
+void test_my_utf8_stream() {
+    const char *inputs[] = {
+            "Hello \xC3\xA9 \xE4\xBD\xA0\xE5\xA5\xBD \xF0\x9F\x98\x8A!",
+            "ab\xE4\xBD",             // cut off at the end
+            "ab\xE4\x41\x42",         // missing continuation byte
+            "\xE4\xC3\xA9",           // lead byte followed by another lead byte
+            "\xE0\x80\x80xyz",        // overlong
+            "\xF0\x9F\x98\x8A\x80",   // stray continuation byte
+            "\xED\xA0\x80",           // surrogate
+            "a\xFF" "b"               // invalid lead byte
+    };
+    int failures = 0;
+    for (int c = 0; c < (int)(sizeof(inputs) / sizeof(inputs[0])); c++) {
+        const uint8_t *input = (const uint8_t *)inputs[c];
+        size_t len = strlen(inputs[c]);
+        int expectedCheck = my_utf8_check_n(input, len);
+        uint8_t expectedDecode[128];
+        size_t expectedLength = my_utf8_decode_n(input, len, expectedDecode);
+
+        for (size_t split = 0; split <= len + 1; split++) {
+            my_utf8_stream checkState;
+            my_utf8_stream decodeState;
+            my_utf8_stream_init(&checkState);
+            my_utf8_stream_init(&decodeState);
+            uint8_t decoded[128];
+            size_t decodedLength = 0;
+            if (split <= len) {
+                // two chunks, the first one may be empty
+                test_stream_feed(&checkState, &decodeState, input, split, decoded, &decodedLength);
+                test_stream_feed(&checkState, &decodeState, input + split, len - split, decoded, &decodedLength);
+            } else {
+                // one byte per chunk
+                for (size_t pos = 0; pos < len; pos++) {
+                    test_stream_feed(&checkState, &decodeState, input + pos, 1, decoded, &decodedLength);
+                }
+            }
+            int check = my_utf8_check_finish(&checkState);
+            decodedLength += my_utf8_decode_finish(&decodeState, decoded + decodedLength);
+
+            if (check != expectedCheck || decodedLength != expectedLength ||
+                memcmp(decoded, expectedDecode, decodedLength) != 0) {
+                failures++;
+            }
+        }
+    }
+    printf("%s: check/decode fed in chunks match the whole-input calls, mismatches=%d\n",
+           (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for the offset index - every charat and a spread of substrings must match the linear scans,
+//for a stride that puts samples everywhere and one bigger than the test string
+void test_my_utf8_index() {
+    uint8_t input[500];
+    const char *pattern = "Hello \xC3\xA9 \xE4\xBD\xA0\xE5\xA5\xBD \xF0\x9F\x98\x8A ";
+    size_t patternLength = strlen(pattern);
+    for (size_t k = 0; k < sizeof(input); k++) {
+        input[k] = (uint8_t)pattern[k % patternLength];
+    }
+    size_t len = sizeof(input) - 2; // ends in the middle of a character
+
+    size_t strides[] = {1, 7, 64, 1000};
+    int failures = 0;
+    for (int s = 0; s < 4; s++) {
+        my_utf8_index index;
+        my_utf8_index_init(&index, input, len, strides[s]);
+        size_t characters = my_utf8_strlen_n(input, len);
+        if (my_utf8_index_strlen(&index) != characters) {
+            failures++;
+        }
+        for (size_t i = 0; i <= characters + 1; i++) {
+            if (my_utf8_index_charat(&index, i) != my_utf8_charat_n(input, len, i)) {
+                failures++;
+            }
+        }
+        for (size_t start = 0; start <= characters + 1; start += 5) {
+            for (size_t length = 0; length < 40; length += 3) {
+                uint8_t expected[500];
+                uint8_t actual[500];
+                size_t expectedLength = my_utf8_substring_n(input, len, start, length, expected);
+                size_t actualLength = my_utf8_index_substring(&index, start, length, actual);
+                if (actualLength != expectedLength || memcmp(actual, expected, actualLength) != 0) {
+                    failures++;
+                }
+            }
+        }
+        my_utf8_index_free(&index);
+    }
+
+    // stray continuation bytes at the start belong to no character, for the index (sampled, and the
+    // scan it falls back to without samples) as for my_utf8_charat_n and my_utf8_strlen_n
+    const uint8_t stray[] = "\x80\xBF\x80" "a\xC3\xA9" "b";
+    size_t strayLength = sizeof(stray) - 1;
+    for (int fallback = 0; fallback < 2; fallback++) {
+        my_utf8_index index;
+        my_utf8_index_init(&index, stray, strayLength, 1);
+        if (fallback) {
+            index.built = -1; // as if the samples could not be allocated
+            index.length = my_utf8_strlen_n(stray, strayLength);
+        }
+        if (my_utf8_index_strlen(&index) != 3 || my_utf8_index_offset(&index, 0) != 3 ||
+            my_utf8_index_offset(&index, 2) != 6 || my_utf8_index_offset(&index, 3) != strayLength) {
+            failures++;
+        }
+        for (size_t i = 0; i <= 4; i++) {
+            if (my_utf8_index_charat(&index, i) != my_utf8_charat_n(stray, strayLength, i)) {
+                failures++;
+            }
+        }
+        my_utf8_index_free(&index);
+    }
+    printf("%s: index charat/substring match the linear scans, mismatches=%d\n",
+           (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for the file mode - writes a small file, runs every mode on it and removes it again
+void test_my_utf8_file() {
+    const char *path = "utf8_file_test.tmp";
+    const char *content = "Hello \xE4\xBD\xA0\xE5\xA5\xBD \xF0\x9F\x98\x8A";
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("FAILED: could not create %s\n", path);
+        return;
+    }
+    fputs(content, file);
+    fclose(file);
 
-    // Test with a string containing only Unicode escape sequences
-    char input5[] = "\\u0041\\u0042\\u0043";
-    char output5[20];
-    my_utf8_encode(input5, output5);
-    printf("%s: input='%s', expected='ABC', actual='%s'\n", (compareStrings("ABC", output5) == 0) ? "PASSED" : "FAILED",
-           input5, output5);
+    my_utf8_file_result result;
+    int opened = my_utf8_file(path, MY_UTF8_FILE_CHECK, NULL, &result);
+    printf("%s: file check, expected=0, actual=%d\n", (opened == 0 && result.status == 0) ? "PASSED" : "FAILED",
+           result.status);
+
+    opened = my_utf8_file(path, MY_UTF8_FILE_COUNT, NULL, &result);
+    printf("%s: file count, expected=10, actual=%zu\n", (opened == 0 && result.characters == 10) ? "PASSED" : "FAILED",
+           result.characters);
+
+    FILE *decoded = tmpfile();
+    char output[64] = "";
+    opened = my_utf8_file(path, MY_UTF8_FILE_DECODE, decoded, &result);
+    if (decoded != NULL) {
+        rewind(decoded);
+        output[fread(output, 1, sizeof(output) - 1, decoded)] = '\0';
+        fclose(decoded);
+    }
+    printf("%s: file decode, expected='Hello \\u4F60\\u597D \\u1F60A', actual='%s'\n",
+           (opened == 0 && compareStrings(output, "Hello \\u4F60\\u597D \\u1F60A") == 0) ? "PASSED" : "FAILED", output);
+    remove(path);
+
+    opened = my_utf8_file(path, MY_UTF8_FILE_CHECK, NULL, &result);
+    printf("%s: missing file, expected=-1, actual=%d\n", (opened == -1) ? "PASSED" : "FAILED", opened);
+}
+
+//Tests for the parallel check and count on a buffer big enough to be split, with errors placed
+//right around the chunk cuts
+void test_my_utf8_parallel() {
+    size_t len = 3 * UTF8_PARALLEL_CHUNK + 1000;
+    uint8_t *input = malloc(len);
+    if (input == NULL) {
+        printf("FAILED: could not allocate the parallel test buffer\n");
+        return;
+    }
+    const char *pattern = "Hello \xC3\xA9 \xE4\xBD\xA0\xE5\xA5\xBD \xF0\x9F\x98\x8A ";
+    size_t patternLength = strlen(pattern);
+    for (size_t k = 0; k < len; k++) {
+        input[k] = (uint8_t)pattern[k % patternLength];
+    }
+    len -= len % patternLength; // whole characters only
+
+    size_t offset;
+    int result = my_utf8_check_parallel(input, len, 4, &offset);
+    printf("%s: parallel check, expected=0, actual=%d\n", (result == 0 && offset == len) ? "PASSED" : "FAILED", result);
+    size_t count = my_utf8_strlen_parallel(input, len, 4);
+    size_t expectedCount = my_utf8_strlen_n(input, len);
+    printf("%s: parallel strlen, expected=%zu, actual=%zu\n", (count == expectedCount) ? "PASSED" : "FAILED",
+           expectedCount, count);
+
+    // a stray continuation byte and a truncated character just before, at and after the second cut,
+    // with a second error further on that must not win
+    size_t positions[] = {2 * UTF8_PARALLEL_CHUNK - 2, 2 * UTF8_PARALLEL_CHUNK, 2 * UTF8_PARALLEL_CHUNK + 1};
+    uint8_t bytes[] = {0x80, 0xE4, 0xFF};
+    int failures = 0;
+    for (int p = 0; p < 3; p++) {
+        for (int b = 0; b < 3; b++) {
+            uint8_t saved = input[positions[p]];
+            uint8_t savedLater = input[len - 10];
+            input[positions[p]] = bytes[b];
+            input[len - 10] = 0xFF;
+            size_t expectedOffset;
+            int expected = utf8_check_scalar_at(input, len, &expectedOffset);
+            result = my_utf8_check_parallel(input, len, 4, &offset);
+            if (result != expected || offset != expectedOffset) {
+                failures++;
+            }
+            input[positions[p]] = saved;
+            input[len - 10] = savedLater;
+        }
+    }
+    printf("%s: parallel check errors around the chunk cuts match the sequential check, mismatches=%d\n",
+           (failures == 0) ? "PASSED" : "FAILED", failures);
+
+    // a lead byte a few bytes before the cut followed by 1 to 5 continuation bytes, so the cut falls
+    // inside the character, right after it or inside a run of stray continuation bytes
+    memset(input, 'a', len);
+    size_t cut = 2 * UTF8_PARALLEL_CHUNK;
+    uint8_t leads[] = {0xC3, 0xE4, 0xF0};
+    failures = 0;
+    for (int l = 0; l < 3; l++) {
+        for (size_t at = cut - 6; at <= cut + 1; at++) {
+            for (size_t run = 1; run <= 5; run++) {
+                input[at] = leads[l];
+                for (size_t r = 1; r <= run; r++) {
+                    input[at + r] = (leads[l] == 0xF0 && r == 1) ? 0x90 : 0x80;
+                }
+                size_t expectedOffset;
+                int expected = utf8_check_scalar_at(input, len, &expectedOffset);
+                result = my_utf8_check_parallel(input, len, 4, &offset);
+                if (result != expected || offset != expectedOffset) {
+                    failures++;
+                }
+                memset(input + at, 'a', run + 1);
+            }
+        }
+    }
+    printf("%s: parallel check of characters cut by a chunk boundary matches the sequential check, mismatches=%d\n",
+           (failures == 0) ? "PASSED" : "FAILED", failures);
+    free(input);
+}
+
+//Tests for the size queries and the bounded variants - sizes must match what the functions write,
+//and every capacity must give a prefix of the full output that stops on a character boundary
+void test_my_utf8_sizes() {
+    const char *inputs[] = {
+            "Hello \xC3\xA9 \xE4\xBD\xA0\xE5\xA5\xBD \xF0\x9F\x98\x8A \xF4\x8F\xBF\xBF!",
+            "ab\xE4\x41\x42\xFF\x80\xF0\x80\x80\x80\xF7\xBF\xBF\xBF\xC3", // invalid and cut sequences
+            "H\\u00E9llo \\uD83D\\uDE0A \\U0001F60A \\u12G4 \\u00"       // escapes for encode
+    };
+    int failures = 0;
+    for (int c = 0; c < 3; c++) {
+        const uint8_t *input = (const uint8_t *)inputs[c];
+        size_t len = strlen(inputs[c]);
+        uint8_t full[256];
+        uint8_t bounded[256];
+
+        for (int encode = 0; encode < 2; encode++) {
+            size_t fullLength = encode ? my_utf8_encode_n(input, len, full) : my_utf8_decode_n(input, len, full);
+            size_t size = encode ? my_utf8_encode_size(input, len) : my_utf8_decode_size(input, len);
+            if (size != fullLength) {
+                failures++;
+            }
+            for (size_t capacity = 0; capacity <= fullLength; capacity++) {
+                size_t consumed;
+                size_t written = encode ? my_utf8_encode_bounded(input, len, bounded, capacity, &consumed)
+                                        : my_utf8_decode_bounded(input, len, bounded, capacity, &consumed);
+                // the bytes written must be exactly the output of the consumed part of the input
+                uint8_t part[256];
+                size_t partLength = encode ? my_utf8_encode_n(input, consumed, part)
+                                           : my_utf8_decode_n(input, consumed, part);
+                if (written > capacity || written != partLength || memcmp(bounded, part, written) != 0 ||
+                    memcmp(bounded, full, written) != 0 || (capacity == fullLength && consumed != len)) {
+                    failures++;
+                }
+            }
+        }
+    }
+
+    // long mixed input, so the vectorized size count and the sliced bounded decode are used
+    uint8_t longInput[1000];
+    const char *pattern = "Hello \xC3\xA9 \xE4\xBD\xA0\xE5\xA5\xBD \xF0\x9F\x98\x8A \xF4\x8F\xBF\xBF ";
+    size_t patternLength = strlen(pattern);
+    for (size_t k = 0; k < sizeof(longInput); k++) {
+        longInput[k] = (uint8_t)pattern[k % patternLength];
+    }
+    static uint8_t longOutput[3000];
+    static uint8_t longBounded[3000];
+    for (size_t len = 0; len <= sizeof(longInput); len += 37) {
+        size_t fullLength = my_utf8_decode_n(longInput, len, longOutput);
+        if (my_utf8_decode_size(longInput, len) != fullLength) {
+            failures++;
+        }
+        size_t consumed;
+        size_t written = my_utf8_decode_bounded(longInput, len, longBounded, fullLength / 2, &consumed);
+        if (written > fullLength / 2 || memcmp(longBounded, longOutput, written) != 0 ||
+            written != my_utf8_decode_size(longInput, consumed)) {
+            failures++;
+        }
+    }
+    printf("%s: encode/decode sizes and bounded variants, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED",
+           failures);
+}
+
+//Tests for the shared automaton: broken characters are handled the same way by decode, substring and
+//strcmp, and validation agrees with the rules for every two and three byte sequence
+void test_my_utf8_dfa() {
+    int failures = 0;
+    uint8_t output[64];
+
+    // decode copies invalid bytes through one at a time and does not swallow the bytes behind them
+    struct {
+        const char *input;
+        const char *expected;
+    } decodeCases[] = {
+            {"ab\xE4\x41\x42", "ab\xE4" "AB"},                   // missing continuation bytes
+            {"\xC0\x80x", "\xC0\x80x"},                            // overlong
+            {"\xED\xA0\x80", "\xED\xA0\x80"},                      // surrogate
+            {"\xF4\x90\x80\x80", "\xF4\x90\x80\x80"},              // above U+10FFFF
+            {"\xE4\xBD\xC3\xA9", "\xE4\xBD\\u00E9"},               // cut character followed by a good one
+            {"\xF0\x9F\x98\x8A\xF0\x9F", "\\u1F60A\xF0\x9F"}       // cut by the end of the input
+    };
+    for (size_t c = 0; c < sizeof(decodeCases) / sizeof(decodeCases[0]); c++) {
+        size_t written = my_utf8_decode_n((const uint8_t *)decodeCases[c].input, strlen(decodeCases[c].input), output);
+        if (written != strlen(decodeCases[c].expected) || memcmp(output, decodeCases[c].expected, written) != 0) {
+            failures++;
+        }
+    }
+
+    // substring counts an invalid byte as one character, like decode
+    size_t written = my_utf8_substring_n((const uint8_t *)"a\xFF\xC3\xA9z", 5, 1, 2, output);
+    if (written != 3 || memcmp(output, "\xFF\xC3\xA9", 3) != 0) {
+        failures++;
+    }
+
+    // strcmp no longer compares overlong encodings or surrogates as if they were code points
+    int status;
+    if (my_utf8_strcmp((unsigned char *)"\xC1\x81", (unsigned char *)"A") != -1 ||
+        my_utf8_strcmp_checked((const uint8_t *)"\xED\xA0\x80", 3, (const uint8_t *)"\xED\xA0\x80", 3, &status) != 0 ||
+        status != -4) {
+        failures++;
+    }
+
+    // two byte sequences: valid exactly for leads C2-DF followed by a continuation byte
+    for (unsigned int lead = 0x80; lead <= 0xFF; lead++) {
+        for (unsigned int next = 0; next <= 0xFF; next++) {
+            uint8_t bytes[2] = {(uint8_t)lead, (uint8_t)next};
+            int valid = (lead >= 0xC2 && lead <= 0xDF && next >= 0x80 && next <= 0xBF);
+            if ((my_utf8_check_n(bytes, 2) == 0) != valid) {
+                failures++;
+            }
+        }
+    }
+
+    // three byte sequences: E0-EF, not overlong (E0 needs A0-BF) and not a surrogate (ED needs 80-9F)
+    for (unsigned int lead = 0xE0; lead <= 0xEF; lead++) {
+        for (unsigned int second = 0x80; second <= 0xBF; second++) {
+            uint8_t bytes[3] = {(uint8_t)lead, (uint8_t)second, 0xBF};
+            int valid = !(lead == 0xE0 && second < 0xA0) && !(lead == 0xED && second > 0x9F);
+            unsigned int codePoint;
+            if ((my_utf8_check_n(bytes, 3) == 0) != valid || (my_utf8_decode_n(bytes, 3, output) == 3) == valid) {
+                failures++;
+            }
+            if (valid && (utf8_dfa_next(bytes, 3, &codePoint) != 3 ||
+                          codePoint != (((lead & 0x0F) << 12) | ((second & 0x3F) << 6) | 0x3F))) {
+                failures++;
+            }
+        }
+    }
+    printf("%s: shared UTF-8 automaton, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for UTF-16 transcoding - the byte layout of both orders, surrogate pairs, errors, and round trips
+//of long inputs so the SIMD kernels run with every alignment of the non-ASCII characters
+void test_my_utf8_utf16() {
+    int failures = 0;
+    uint16_t units[512];
+    uint8_t bytes[1024];
+    my_utf8_transcode_result result;
+
+    // "Aé你\U0001F60A" in both byte orders, as raw bytes
+    const char *text = "A\xC3\xA9\xE4\xBD\xA0\xF0\x9F\x98\x8A";
+    const uint8_t little[] = {0x41, 0x00, 0xE9, 0x00, 0x60, 0x4F, 0x3D, 0xD8, 0x0A, 0xDE};
+    const uint8_t big[] = {0x00, 0x41, 0x00, 0xE9, 0x4F, 0x60, 0xD8, 0x3D, 0xDE, 0x0A};
+    for (int order = 0; order < 2; order++) {
+        const uint8_t *expected = order ? big : little;
+        enum my_utf16_byte_order byteOrder = order ? MY_UTF16_BE : MY_UTF16_LE;
+        if (my_utf8_to_utf16((const uint8_t *)text, strlen(text), units, byteOrder, &result) != 0 ||
+            result.written != 5 || result.read != strlen(text) || memcmp(units, expected, 10) != 0) {
+            failures++;
+        }
+        if (my_utf8_from_utf16((const uint16_t *)expected, 5, byteOrder, bytes, &result) != 0 ||
+            result.written != strlen(text) || memcmp(bytes, text, strlen(text)) != 0) {
+            failures++;
+        }
+    }
+
+    // invalid UTF-8 stops at the bad character with the my_utf8_check code
+    const char *invalidUtf8[] = {"ab\xFF", "ab\xE4\x41", "ab\xC0\x80", "ab\xED\xA0\x80", "ab\x80", "ab\xF0\x9F"};
+    const int utf8Codes[] = {-1, -2, -3, -4, -5, -2};
+    for (int c = 0; c < 6; c++) {
+        if (my_utf8_to_utf16((const uint8_t *)invalidUtf8[c], strlen(invalidUtf8[c]), units, MY_UTF16_LE, &result) !=
+            utf8Codes[c] || result.read != 2 || result.written != 2) {
+            failures++;
+        }
+    }
+
+    // unpaired surrogates: a lone low one, a high one followed by a non-surrogate, a high one at the end
+    const uint16_t invalidUtf16[][3] = {{0x41, 0xDC00, 0x41}, {0x41, 0xD800, 0x41}, {0x41, 0x42, 0xD800}};
+    const size_t badPositions[] = {1, 1, 2};
+    for (int c = 0; c < 3; c++) {
+        if (my_utf8_from_utf16(invalidUtf16[c], 3, MY_UTF16_LE, bytes, &result) != -4 ||
+            result.read != badPositions[c] || result.written != badPositions[c]) {
+            failures++;
+        }
+    }
+
+    // round trips of long mixed text, starting at every offset so the ASCII blocks are cut everywhere
+    uint8_t longText[300];
+    const char *pattern = "The quick brown fox jumps over the lazy dog. \xC3\xA9\xE4\xBD\xA0\xF0\x9F\x98\x8A ";
+    for (size_t k = 0; k < sizeof(longText); k++) {
+        longText[k] = (uint8_t)pattern[k % strlen(pattern)];
+    }
+    size_t end = sizeof(longText);
+    while ((longText[end - 1] & 0xC0) == 0x80 || longText[end - 1] >= 0xC0) {
+        end--; // do not cut the last character
+    }
+    for (size_t start = 0; start < 64; start++) {
+        if ((longText[start] & 0xC0) == 0x80) {
+            continue;
+        }
+        for (int order = 0; order < 2; order++) {
+            enum my_utf16_byte_order byteOrder = order ? MY_UTF16_BE : MY_UTF16_LE;
+            size_t len = end - start;
+            if (my_utf8_to_utf16(longText + start, len, units, byteOrder, &result) != 0) {
+                failures++;
+                continue;
+            }
+            size_t count = result.written;
+            if (my_utf8_from_utf16(units, count, byteOrder, bytes, &result) != 0 || result.written != len ||
+                memcmp(bytes, longText + start, len) != 0) {
+                failures++;
+            }
+        }
+    }
+    printf("%s: UTF-8 <-> UTF-16 transcoding, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for UTF-32 conversion - code point values and counts, errors, and round trips of long Latin and
+//mixed text from every starting offset so the block kernels see every alignment
+void test_my_utf8_utf32() {
+    int failures = 0;
+    uint32_t codePoints[512];
+    uint8_t bytes[2048];
+    my_utf8_transcode_result result;
+
+    const char *text = "A\xC3\xA9\xE4\xBD\xA0\xF0\x9F\x98\x8A";
+    const uint32_t expected[] = {0x41, 0xE9, 0x4F60, 0x1F60A};
+    if (my_utf8_to_utf32((const uint8_t *)text, strlen(text), codePoints, &result) != 0 || result.written != 4 ||
+        memcmp(codePoints, expected, sizeof(expected)) != 0) {
+        failures++;
+    }
+    if (my_utf8_from_utf32(expected, 4, bytes, &result) != 0 || result.written != strlen(text) ||
+        memcmp(bytes, text, strlen(text)) != 0) {
+        failures++;
+    }
+
+    // invalid UTF-8 stops at the bad character with the my_utf8_check code
+    const char *invalid[] = {"ab\xFF", "ab\xE4\x41", "ab\xC0\x80", "ab\xED\xA0\x80", "ab\x80", "ab\xF0\x9F"};
+    const int codes[] = {-1, -2, -3, -4, -5, -2};
+    for (int c = 0; c < 6; c++) {
+        if (my_utf8_to_utf32((const uint8_t *)invalid[c], strlen(invalid[c]), codePoints, &result) != codes[c] ||
+            result.read != 2 || result.written != 2) {
+            failures++;
+        }
+    }
+
+    // surrogates and values above U+10FFFF can't be encoded
+    const uint32_t badCodePoints[][2] = {{0x41, 0xD800}, {0x41, 0xDFFF}, {0x41, 0x110000}};
+    for (int c = 0; c < 3; c++) {
+        if (my_utf8_from_utf32(badCodePoints[c], 2, bytes, &result) != -4 || result.read != 1 || result.written != 1) {
+            failures++;
+        }
+    }
+
+    // long Latin and mixed text, every starting offset
+    const char *patterns[] = {"Stra\xC3\x9F" "e, caf\xC3\xA9, na\xC3\xAFve \xD0\x9C\xD0\xBE\xD1\x81\xD0\xBA\xD0\xB2\xD0\xB0 ",
+                              "The quick brown fox jumps over the lazy dog. \xC3\xA9\xE4\xBD\xA0\xF0\x9F\x98\x8A "};
+    for (int p = 0; p < 2; p++) {
+        uint8_t longText[400];
+        for (size_t k = 0; k < sizeof(longText); k++) {
+            longText[k] = (uint8_t)patterns[p][k % strlen(patterns[p])];
+        }
+        size_t end = sizeof(longText);
+        while ((longText[end - 1] & 0xC0) == 0x80 || longText[end - 1] >= 0xC0) {
+            end--; // do not cut the last character
+        }
+        for (size_t start = 0; start < 64; start++) {
+            if ((longText[start] & 0xC0) == 0x80) {
+                continue;
+            }
+            size_t len = end - start;
+            if (my_utf8_to_utf32(longText + start, len, codePoints, &result) != 0 ||
+                result.written != my_utf8_strlen_n(longText + start, len)) {
+                failures++;
+                continue;
+            }
+            size_t count = result.written;
+            if (my_utf8_from_utf32(codePoints, count, bytes, &result) != 0 || result.written != len ||
+                memcmp(bytes, longText + start, len) != 0) {
+                failures++;
+            }
+        }
+    }
+    printf("%s: UTF-8 <-> UTF-32 conversion, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for the byte-order strcmp - on long strings that differ at every position and in every kind of
+//character, the result must match comparing the decoded code points one by one
+void test_my_utf8_strcmp_order() {
+    int failures = 0;
+    const uint32_t alphabet[] = {'a', 'z', 0xE9, 0x7FF, 0x800, 0x4F60, 0xFFFD, 0x10000, 0x1F60A, 0x10FFFF};
+    const size_t letters = sizeof(alphabet) / sizeof(alphabet[0]);
+    uint32_t text[100];
+    for (size_t k = 0; k < 100; k++) {
+        text[k] = alphabet[(k * 7) % letters];
+    }
+
+    uint8_t string1[400];
+    uint8_t string2[400];
+    my_utf8_transcode_result result;
+    for (size_t position = 0; position < 100; position += 3) {
+        for (size_t letter = 0; letter < letters; letter++) {
+            uint32_t changed[100];
+            memcpy(changed, text, sizeof(text));
+            changed[position] = alphabet[letter];
+            for (size_t cut = 0; cut < 2; cut++) {
+                size_t count = 100 - cut * (100 - position - 1); // the whole text, or up to the change
+                my_utf8_from_utf32(text, 100, string1, &result);
+                size_t len1 = result.written;
+                my_utf8_from_utf32(changed, count, string2, &result);
+                size_t len2 = result.written;
+
+                int expected = 0;
+                for (size_t k = 0; k < count && expected == 0; k++) {
+                    expected = (text[k] < changed[k]) ? -1 : (text[k] > changed[k]) ? 1 : 0;
+                }
+                if (expected == 0 && count < 100) {
+                    expected = 1; // string2 is a prefix of string1
+                }
+                int status;
+                if (my_utf8_strcmp_n(string1, len1, string2, len2) != expected ||
+                    my_utf8_strcmp_n(string2, len2, string1, len1) != -expected ||
+                    my_utf8_strcmp_checked(string1, len1, string2, len2, &status) != expected || status != 0) {
+                    failures++;
+                }
+            }
+        }
+    }
+
+    // a string with an invalid character at the first difference sorts first, in either argument order
+    // (a stray continuation byte there too); the checked variant reports them
+    const char *invalid[][2] = {{"a\x80", "aB"}, {"\xC3\xA9\x80", "\xC3\xA9\x41"}, {"ab\xFF", "abc"},
+                                {"ab\xC3\x41", "ab\xC3\xA9"}, {"x\xE4\xBD", "x\xE4\xBD\xA0"}};
+    for (size_t k = 0; k < sizeof(invalid) / sizeof(invalid[0]); k++) {
+        const uint8_t *bad = (const uint8_t *)invalid[k][0];
+        const uint8_t *good = (const uint8_t *)invalid[k][1];
+        if (my_utf8_strcmp_n(bad, strlen(invalid[k][0]), good, strlen(invalid[k][1])) != -1 ||
+            my_utf8_strcmp_n(good, strlen(invalid[k][1]), bad, strlen(invalid[k][0])) != 1) {
+            failures++;
+        }
+    }
+    if (my_utf8_strcmp_n((const uint8_t *)"a\x80", 2, (const uint8_t *)"a\xFF", 2) != -1 ||
+        my_utf8_strcmp_n((const uint8_t *)"a\xFF", 2, (const uint8_t *)"a\x80", 2) != 1) {
+        failures++; // invalid in both: byte order
+    }
+    int status;
+    if (my_utf8_strcmp_n((const uint8_t *)"ab\xFF", 3, (const uint8_t *)"abc", 3) != -1 ||
+        my_utf8_strcmp_n((const uint8_t *)"ab\xC3\x41", 4, (const uint8_t *)"ab\xC3\xA9", 4) != -1 ||
+        my_utf8_strcmp_checked((const uint8_t *)"ab\xFF", 3, (const uint8_t *)"abc", 3, &status) != 1 ||
+        status != -1 ||
+        my_utf8_strcmp_checked((const uint8_t *)"abc", 3, (const uint8_t *)"ab\xE4", 3, &status) != -1 ||
+        status != -2) {
+        failures++;
+    }
+    printf("%s: strcmp by byte order agrees with code point order, mismatches=%d\n",
+           (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for normalization - the composed and decomposed forms of the same text compare equal once
+//normalized, the quick check answers, Hangul and compatibility characters, and long text that needs
+//no change or only a few spans changed
+void test_my_utf8_normalize() {
+    int failures = 0;
+    uint8_t output[1024];
+    size_t written;
+
+    // "café" with a precomposed e-acute, and with e + U+0301
+    const char *composed = "caf\xC3\xA9";
+    const char *decomposed = "cafe\xCC\x81";
+    if (my_utf8_strcmp_n((const uint8_t *)composed, 5, (const uint8_t *)decomposed, 6) == 0) {
+        failures++;
+    }
+    uint8_t nfc1[16];
+    uint8_t nfc2[16];
+    size_t len1;
+    size_t len2;
+    if (my_utf8_normalize((const uint8_t *)composed, 5, MY_UTF8_NFC, nfc1, sizeof(nfc1), &len1) != 0 ||
+        my_utf8_normalize((const uint8_t *)decomposed, 6, MY_UTF8_NFC, nfc2, sizeof(nfc2), &len2) != 0 ||
+        my_utf8_strcmp_n(nfc1, len1, nfc2, len2) != 0 || len1 != 5) {
+        failures++;
+    }
+    if (my_utf8_normalize((const uint8_t *)composed, 5, MY_UTF8_NFD, output, sizeof(output), &written) != 0 ||
+        written != 6 || memcmp(output, decomposed, 6) != 0) {
+        failures++;
+    }
+
+    // quick check: precomposed text is NFC but not NFD, a combining mark is only "maybe" for NFC
+    if (my_utf8_quick_check((const uint8_t *)composed, 5, MY_UTF8_NFC) != MY_UTF8_QC_YES ||
+        my_utf8_quick_check((const uint8_t *)composed, 5, MY_UTF8_NFD) != MY_UTF8_QC_NO ||
+        my_utf8_quick_check((const uint8_t *)decomposed, 6, MY_UTF8_NFC) != MY_UTF8_QC_MAYBE ||
+        my_utf8_is_normalized((const uint8_t *)decomposed, 6, MY_UTF8_NFC) ||
+        !my_utf8_is_normalized((const uint8_t *)decomposed, 6, MY_UTF8_NFD) ||
+        my_utf8_quick_check((const uint8_t *)"ab\xFF", 3, MY_UTF8_NFC) != MY_UTF8_QC_NO ||
+        my_utf8_is_normalized((const uint8_t *)"ab\xFF", 3, MY_UTF8_NFC)) {
+        failures++;
+    }
+
+    // expected results (from the Unicode character database): input, NFC, NFD, NFKC, NFKD
+    const char *cases[][5] = {
+            // A-ring from U+212B ANGSTROM SIGN (a singleton) and from A + U+030A
+            {"\xE2\x84\xAB", "\xC3\x85", "A\xCC\x8A", "\xC3\x85", "A\xCC\x8A"},
+            // d + dot below + dot above in the wrong order
+            {"d\xCC\x87\xCC\xA3", "\xE1\xB8\x8D\xCC\x87", "d\xCC\xA3\xCC\x87", "\xE1\xB8\x8D\xCC\x87", "d\xCC\xA3\xCC\x87"},
+            // Hangul: a syllable with a trailing consonant, and the jamo that compose to it
+            {"\xEA\xB0\x81", "\xEA\xB0\x81", "\xE1\x84\x80\xE1\x85\xA1\xE1\x86\xA8", "\xEA\xB0\x81",
+             "\xE1\x84\x80\xE1\x85\xA1\xE1\x86\xA8"},
+            {"\xE1\x84\x80\xE1\x85\xA1\xE1\x86\xA8", "\xEA\xB0\x81", "\xE1\x84\x80\xE1\x85\xA1\xE1\x86\xA8", "\xEA\xB0\x81",
+             "\xE1\x84\x80\xE1\x85\xA1\xE1\x86\xA8"},
+            // the fi ligature only changes in the compatibility forms
+            {"\xEF\xAC\x81le", "\xEF\xAC\x81le", "\xEF\xAC\x81le", "file", "file"},
+            // U+0958 is excluded from composition, so NFC keeps it decomposed
+            {"\xE0\xA5\x98", "\xE0\xA4\x95\xE0\xA4\xBC", "\xE0\xA4\x95\xE0\xA4\xBC", "\xE0\xA4\x95\xE0\xA4\xBC",
+             "\xE0\xA4\x95\xE0\xA4\xBC"},
+            // halfwidth katakana KA + halfwidth voiced mark becomes GA in NFKC
+            {"\xEF\xBD\xB6\xEF\xBE\x9E", "\xEF\xBD\xB6\xEF\xBE\x9E", "\xEF\xBD\xB6\xEF\xBE\x9E", "\xE3\x82\xAC",
+             "\xE3\x82\xAB\xE3\x82\x99"},
+            // a combining mark at the very start has nothing to compose with
+            {"\xCC\x81" "e", "\xCC\x81" "e", "\xCC\x81" "e", "\xCC\x81" "e", "\xCC\x81" "e"}};
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        for (int form = 0; form < 4; form++) {
+            const char *expected = cases[c][form + 1];
+            size_t len = strlen(cases[c][0]);
+            int status = my_utf8_normalize((const uint8_t *)cases[c][0], len, (enum my_utf8_normal_form)form, output,
+                                           sizeof(output), &written);
+            if (status != 0 || written != strlen(expected) || memcmp(output, expected, written) != 0 ||
+                my_utf8_is_normalized((const uint8_t *)cases[c][0], len, (enum my_utf8_normal_form)form) !=
+                (strcmp(cases[c][0], expected) == 0)) {
+                failures++;
+            }
+        }
+    }
+
+    // U+FDFA grows to 18 code points (33 bytes) in NFKD: sizes are reported even when the output is short
+    const char *ligature = "\xEF\xB7\xBA";
+    if (my_utf8_normalize((const uint8_t *)ligature, 3, MY_UTF8_NFKD, NULL, 0, &written) != -6 || written != 33 ||
+        my_utf8_normalize((const uint8_t *)ligature, 3, MY_UTF8_NFKD, output, 32, &written) != -6 || written != 33 ||
+        my_utf8_normalize((const uint8_t *)ligature, 3, MY_UTF8_NFKD, output, 33, &written) != 0 ||
+        my_utf8_strlen_n(output, written) != 18) {
+        failures++;
+    }
+    if (my_utf8_normalize((const uint8_t *)"ab\xE4\x41", 4, MY_UTF8_NFC, output, sizeof(output), &written) != -2 ||
+        written != 0) {
+        failures++;
+    }
+
+    // long text: NFC as it is, and with every tenth e-acute decomposed
+    uint8_t longText[600];
+    uint8_t longDecomposed[700];
+    size_t longLength = 0;
+    size_t decomposedLength = 0;
+    for (int k = 0; k < 100; k++) {
+        memcpy(longText + longLength, "caf\xC3\xA9 ", 6);
+        longLength += 6;
+        const char *word = (k % 10 == 0) ? "cafe\xCC\x81 " : "caf\xC3\xA9 ";
+        memcpy(longDecomposed + decomposedLength, word, strlen(word));
+        decomposedLength += strlen(word);
+    }
+    if (!my_utf8_is_normalized(longText, longLength, MY_UTF8_NFC) ||
+        my_utf8_is_normalized(longDecomposed, decomposedLength, MY_UTF8_NFC) ||
+        my_utf8_normalize(longDecomposed, decomposedLength, MY_UTF8_NFC, output, sizeof(output), &written) != 0 ||
+        written != longLength || memcmp(output, longText, longLength) != 0) {
+        failures++;
+    }
+    printf("%s: normalization, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for case folding - simple and full folding of special cases, case-insensitive comparison and
+//hashing, reported sizes and invalid input, and long mixed-case text at every alignment
+void test_my_utf8_casefold() {
+    int failures = 0;
+    uint8_t output[1024];
+    size_t written;
+
+    // expected results: input, simple folding, full folding
+    const char *cases[][3] = {
+            {"Hello, World", "hello, world", "hello, world"},
+            // sharp s only grows to "ss" in full folding; U+1E9E CAPITAL SHARP S folds to it
+            {"Stra\xC3\x9F" "e", "stra\xC3\x9F" "e", "strasse"},
+            {"\xE1\xBA\x9E", "\xC3\x9F", "ss"},
+            // final sigma and capital sigma fold to the small sigma
+            {"\xCE\xA3\xCE\xB9\xCF\x82", "\xCF\x83\xCE\xB9\xCF\x83", "\xCF\x83\xCE\xB9\xCF\x83"},
+            // U+212A KELVIN SIGN is a k, U+FB03 "ffi" ligature only unfolds in full folding
+            {"\xE2\x84\xAA\xEF\xAC\x83", "k\xEF\xAC\x83", "kffi"},
+            // Deseret capital letter long i (four bytes)
+            {"\xF0\x90\x90\x80", "\xF0\x90\x90\xA8", "\xF0\x90\x90\xA8"},
+            // no case at all
+            {"\xE4\xBD\xA0\xE5\xA5\xBD", "\xE4\xBD\xA0\xE5\xA5\xBD", "\xE4\xBD\xA0\xE5\xA5\xBD"}};
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        for (int fold = 0; fold < 2; fold++) {
+            const char *expected = cases[c][fold + 1];
+            size_t len = strlen(cases[c][0]);
+            if (my_utf8_casefold((const uint8_t *)cases[c][0], len, (enum my_utf8_case_fold)fold, output,
+                                 sizeof(output), &written) != 0 ||
+                written != strlen(expected) || memcmp(output, expected, written) != 0 ||
+                my_utf8_strcasecmp((const uint8_t *)cases[c][0], len, (const uint8_t *)expected, strlen(expected),
+                                   (enum my_utf8_case_fold)fold) != 0 ||
+                my_utf8_casefold_hash((const uint8_t *)cases[c][0], len, (enum my_utf8_case_fold)fold) !=
+                my_utf8_casefold_hash((const uint8_t *)expected, strlen(expected), (enum my_utf8_case_fold)fold)) {
+                failures++;
+            }
+        }
+    }
+
+    // "STRASSE" equals "straße" only with full folding, and orders before it with simple folding
+    const uint8_t *upper = (const uint8_t *)"STRASSE";
+    const uint8_t *sharp = (const uint8_t *)"stra\xC3\x9F" "e";
+    if (my_utf8_strcasecmp(upper, 7, sharp, 7, MY_UTF8_FOLD_FULL) != 0 ||
+        my_utf8_strcasecmp(upper, 7, sharp, 7, MY_UTF8_FOLD_SIMPLE) != -1 ||
+        my_utf8_strcasecmp(sharp, 7, upper, 7, MY_UTF8_FOLD_SIMPLE) != 1 ||
+        my_utf8_casefold_hash(upper, 7, MY_UTF8_FOLD_FULL) != my_utf8_casefold_hash(sharp, 7, MY_UTF8_FOLD_FULL) ||
+        my_utf8_casefold_hash(upper, 7, MY_UTF8_FOLD_SIMPLE) == my_utf8_casefold_hash(sharp, 7, MY_UTF8_FOLD_SIMPLE)) {
+        failures++;
+    }
+    // a prefix orders first; invalid bytes order after every character, consistently both ways
+    if (my_utf8_strcasecmp((const uint8_t *)"ABC", 3, (const uint8_t *)"abcd", 4, MY_UTF8_FOLD_FULL) != -1 ||
+        my_utf8_strcasecmp((const uint8_t *)"abcd", 4, (const uint8_t *)"ABC", 3, MY_UTF8_FOLD_FULL) != 1 ||
+        my_utf8_strcasecmp((const uint8_t *)"a\xFF", 2, (const uint8_t *)"A\xF4\x8F\xBF\xBF", 5,
+                           MY_UTF8_FOLD_FULL) != 1 ||
+        my_utf8_strcasecmp((const uint8_t *)"a\xFF", 2, (const uint8_t *)"A\xFF", 2, MY_UTF8_FOLD_FULL) != 0) {
+        failures++;
+    }
+
+    // sizes are reported even when the output is short (a folding that does not fit is left out whole),
+    // invalid input gives the my_utf8_check code
+    if (my_utf8_casefold(sharp, 7, MY_UTF8_FOLD_FULL, NULL, 0, &written) != -6 || written != 7 ||
+        my_utf8_casefold(sharp, 7, MY_UTF8_FOLD_FULL, output, 5, &written) != -6 || written != 7 ||
+        memcmp(output, "stra", 4) != 0 ||
+        my_utf8_casefold((const uint8_t *)"ab\xE4\x41", 4, MY_UTF8_FOLD_FULL, output, sizeof(output), &written) != -2 ||
+        written != 0) {
+        failures++;
+    }
+
+    // long mixed-case text, compared from several starting points so the wide compares see every alignment
+    uint8_t lower[700];
+    uint8_t mixed[700];
+    size_t length = 0;
+    for (int k = 0; k < 100; k++) {
+        memcpy(lower + length, "caf\xC3\xA9 ", 6);
+        memcpy(mixed + length, (k % 3 == 0) ? "CAF\xC3\x89 " : "Caf\xC3\xA9 ", 6);
+        length += 6;
+    }
+    for (size_t start = 0; start < 40; start += 6) {
+        size_t rest = length - start;
+        if (my_utf8_strcasecmp(lower + start, rest, mixed + start, rest, MY_UTF8_FOLD_SIMPLE) != 0 ||
+            my_utf8_casefold_hash(lower + start, rest, MY_UTF8_FOLD_SIMPLE) !=
+            my_utf8_casefold_hash(mixed + start, rest, MY_UTF8_FOLD_SIMPLE) ||
+            my_utf8_casefold(mixed + start, rest, MY_UTF8_FOLD_SIMPLE, output, sizeof(output), &written) != 0 ||
+            written != rest || memcmp(output, lower + start, written) != 0) {
+            failures++;
+        }
+    }
+    mixed[length - 5] = 'G'; // "Café" -> "CGfé" near the end
+    if (my_utf8_strcasecmp(lower, length, mixed, length, MY_UTF8_FOLD_FULL) != -1) {
+        failures++;
+    }
+    printf("%s: case folding, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for grapheme clusters - cluster boundaries for combining marks, CR LF, flags, emoji sequences,
+//Hangul, Indic and Prepend, invalid bytes, substring and charat by cluster, and a long mostly-ASCII text
+void test_my_utf8_graphemes() {
+    int failures = 0;
+
+    // expected results: input and the byte lengths of its clusters
+    struct {
+        const char *input;
+        size_t lengths[8];
+    } cases[] = {
+            // e + combining acute is one cluster, CR LF too
+            {"cafe\xCC\x81\r\n!", {1, 1, 1, 3, 2, 1}},
+            // two flags (pairs of regional indicators), and a lone third indicator
+            {"\xF0\x9F\x87\xAB\xF0\x9F\x87\xB7\xF0\x9F\x87\xBA\xF0\x9F\x87\xB8\xF0\x9F\x87\xBA", {8, 8, 4}},
+            // thumbs up with a skin tone, and man ZWJ woman ZWJ girl
+            {"\xF0\x9F\x91\x8D\xF0\x9F\x8F\xBD\xF0\x9F\x91\xA8\xE2\x80\x8D\xF0\x9F\x91\xA9\xE2\x80\x8D\xF0\x9F\x91\xA7",
+             {8, 18}},
+            // Hangul jamo L V T make one syllable; a precomposed LV syllable takes a T
+            {"\xE1\x84\x80\xE1\x85\xA1\xE1\x86\xA8\xEA\xB0\x80\xE1\x86\xA8", {9, 6}},
+            // Devanagari: a virama extends its consonant, a vowel sign (SpacingMark) joins the next one
+            {"\xE0\xA4\x95\xE0\xA5\x8D\xE0\xA4\xB7\xE0\xA4\xBF", {6, 6}},
+            // an Arabic number sign (Prepend) joins the digit after it
+            {"\xD8\x80" "1a", {3, 1}},
+            // invalid bytes are clusters of one byte, and a mark does not join them
+            {"a\xFF\xCC\x81\xE4\xBD", {1, 1, 2, 1, 1}}};
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const uint8_t *buf = (const uint8_t *)cases[c].input;
+        size_t len = strlen(cases[c].input);
+        my_utf8_graphemes iterator;
+        my_utf8_graphemes_init(&iterator, buf, len);
+        size_t offset;
+        size_t length;
+        size_t count = 0;
+        size_t expectedOffset = 0;
+        while (my_utf8_graphemes_next(&iterator, &offset, &length)) {
+            size_t charLength;
+            if (offset != expectedOffset || length != cases[c].lengths[count] ||
+                my_utf8_grapheme_charat(buf, len, count, &charLength) != buf + offset || charLength != length) {
+                failures++;
+            }
+            expectedOffset += length;
+            count++;
+        }
+        size_t charLength;
+        if (expectedOffset != len || count != my_utf8_grapheme_count(buf, len) ||
+            (count < 8 && cases[c].lengths[count] != 0) ||
+            my_utf8_grapheme_charat(buf, len, count, &charLength) != NULL) {
+            failures++;
+        }
+    }
+
+    // substring never cuts the accent or the flag off, unlike my_utf8_substring_n
+    const char *text = "Cafe\xCC\x81 \xF0\x9F\x87\xAB\xF0\x9F\x87\xB7!";
+    uint8_t output[64];
+    size_t written = my_utf8_grapheme_substring((const uint8_t *)text, strlen(text), 3, 3, output);
+    if (written != 12 || memcmp(output, "e\xCC\x81 \xF0\x9F\x87\xAB\xF0\x9F\x87\xB7", 12) != 0 ||
+        my_utf8_grapheme_substring((const uint8_t *)text, strlen(text), 6, 5, output) != 1 || output[0] != '!' ||
+        my_utf8_grapheme_substring((const uint8_t *)text, strlen(text), 7, 1, output) != 0) {
+        failures++;
+    }
+
+    // long ASCII text with an accent after every tenth letter is skipped in bulk and counted right
+    uint8_t longText[1200];
+    size_t longLength = 0;
+    for (int k = 0; k < 100; k++) {
+        memcpy(longText + longLength, "abcdefghij", 10);
+        longLength += 10;
+        if (k % 3 == 0) {
+            memcpy(longText + longLength, "\xCC\x81", 2);
+            longLength += 2;
+        }
+    }
+    size_t length;
+    const uint8_t *accented = my_utf8_grapheme_charat(longText, longLength, 999, &length);
+    if (my_utf8_grapheme_count(longText, longLength) != 1000 || accented != longText + longLength - 3 || length != 3) {
+        failures++;
+    }
+    printf("%s: grapheme clusters, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for the longest non-whitespace run - offsets, bytes and characters of the run, with Unicode
+//White_Space separators and non-separators, and a long document with every kind of space
+void test_my_utf8_longest_sequence() {
+    int failures = 0;
+
+    // expected results: input, offset, bytes and characters of the longest run (bytes 0: none)
+    struct {
+        const char *input;
+        size_t offset;
+        size_t bytes;
+        size_t characters;
+    } cases[] = {
+            {"Hello   World", 0, 5, 5},
+            {"Hi\v\fthere\r\n", 4, 5, 5},
+            // non-ASCII characters count, and the first of two equally long runs wins
+            {"caf\xC3\xA9 cafe", 0, 5, 4},
+            // no-break space, em space and the ideographic space all separate
+            {"ab\xC2\xA0" "abc\xE2\x80\x83" "abcd\xE3\x80\x80"
+             "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE3\x81\xA7\xE3\x81\x99",
+             17, 15, 5},
+            // the ideographic comma and a zero width space are not White_Space
+            {"x \xE6\x97\xA5\xE3\x80\x81\xE2\x80\x8B" "a", 2, 10, 4},
+            // a control character that is not whitespace stays in the run
+            {"a\x01" "b c", 0, 3, 3},
+            {"", 0, 0, 0},
+            {" \t\xE2\x80\xA8\xC2\x85 ", 0, 0, 0}};
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        my_utf8_run longest;
+        int found = my_utf8_longest_sequence_n((const uint8_t *)cases[c].input, strlen(cases[c].input), &longest);
+        if (found != (cases[c].bytes > 0) || longest.bytes != cases[c].bytes ||
+            (found && (longest.offset != cases[c].offset || longest.characters != cases[c].characters))) {
+            failures++;
+        }
+    }
+
+    // a long document: the longest word is near the end, behind runs of every kind of space
+    uint8_t text[2000];
+    size_t length = 0;
+    const char *spaces[] = {" ", "\n", "\xC2\xA0", "\xE2\x80\x89", "\xE3\x80\x80"};
+    for (int k = 0; k < 200; k++) {
+        const char *word = (k == 190) ? "unbelievable" : "word";
+        memcpy(text + length, word, strlen(word));
+        length += strlen(word);
+        memcpy(text + length, spaces[k % 5], strlen(spaces[k % 5]));
+        length += strlen(spaces[k % 5]);
+    }
+    my_utf8_run longest;
+    if (!my_utf8_longest_sequence_n(text, length, &longest) || longest.bytes != 12 || longest.characters != 12 ||
+        memcmp(text + longest.offset, "unbelievable", 12) != 0) {
+        failures++;
+    }
+    printf("%s: longest sequence, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for substring views - the view points into the input and ends where the characters end, also at
+//an invalid byte or a cut-off character
+void test_my_utf8_substring_view() {
+    int failures = 0;
+    const char *text = "na\xC3\xAFve caf\xC3\xA9 \xF0\x9F\x98\x80!";
+
+    // expected results: start, length and the bytes of the view
+    struct {
+        size_t start;
+        size_t length;
+        const char *expected;
+    } cases[] = {{0, 5, "na\xC3\xAFve"}, {6, 4, "caf\xC3\xA9"}, {11, 5, "\xF0\x9F\x98\x80!"}, {13, 2, ""}, {3, 0, ""}};
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        my_utf8_view view = my_utf8_substring_view_n((const uint8_t *)text, strlen(text), cases[c].start,
+                                                      cases[c].length);
+        my_utf8_view terminated = my_utf8_substring_view(text, cases[c].start, cases[c].length);
+        size_t bytes = strlen(cases[c].expected);
+        const uint8_t *end = (const uint8_t *)text + strlen(text);
+        if (view.bytes != bytes || memcmp(view.data, cases[c].expected, bytes) != 0 ||
+            (bytes > 0 && (view.data < (const uint8_t *)text || view.data + bytes > end)) ||
+            terminated.data != view.data || terminated.bytes != view.bytes) {
+            failures++;
+        }
+    }
+
+    // a prefix of a long string: the view points into it and ends where the characters end, also when an
+    // invalid byte or a cut-off character sits in the range
+    static char longText[20000];
+    for (size_t i = 0; i < sizeof(longText) - 1; i++) {
+        longText[i] = (i % 100 == 50) ? '\xFF' : 'a' + (char)(i % 26);
+    }
+    my_utf8_view prefix = my_utf8_substring_view(longText, 10, 100);
+    my_utf8_view late = my_utf8_substring_view(longText, 19000, 5000);
+    if (prefix.data != (const uint8_t *)longText + 10 || prefix.bytes != 100 ||
+        late.data != (const uint8_t *)longText + 19000 || late.bytes != sizeof(longText) - 1 - 19000) {
+        failures++;
+    }
+    my_utf8_view cut = my_utf8_substring_view_n((const uint8_t *)"ab\xE6\x97", 4, 2, 5);
+    if (cut.bytes != 2) {
+        failures++;
+    }
+
+    // broken input: views, charat, strlen and the index count the same characters
+    const char *broken[] = {"\xE4\xBD" "ab", "\x80\x80" "a\xFF" "b", "a\xE2\x82z\x80\x80\x80\x80", "\xF0\x9F\x98\x80\x80" "c\xC3"};
+    for (size_t b = 0; b < sizeof(broken) / sizeof(broken[0]); b++) {
+        const uint8_t *buf = (const uint8_t *)broken[b];
+        size_t len = strlen(broken[b]);
+        size_t characters = my_utf8_strlen_n(buf, len);
+        my_utf8_index index;
+        my_utf8_index_init(&index, buf, len, 2);
+        if (my_utf8_index_strlen(&index) != characters) {
+            failures++;
+        }
+        for (size_t start = 0; start <= characters; start++) {
+            for (size_t length = 0; length <= characters - start + 1; length++) {
+                const uint8_t *first = my_utf8_charat_n(buf, len, start);
+                const uint8_t *last = my_utf8_charat_n(buf, len, start + length);
+                first = (first != NULL) ? first : buf + len;
+                last = (last != NULL) ? last : buf + len;
+                my_utf8_view view = my_utf8_substring_view_n(buf, len, start, length);
+                my_utf8_view terminated = my_utf8_substring_view(broken[b], start, length);
+                uint8_t output[32];
+                size_t bytes = my_utf8_index_substring(&index, start, length, output);
+                if (view.data != first || view.bytes != (size_t)(last - first) || terminated.data != view.data ||
+                    terminated.bytes != view.bytes || bytes != view.bytes || memcmp(output, view.data, bytes) != 0) {
+                    failures++;
+                }
+            }
+        }
+        my_utf8_index_free(&index);
+    }
+    printf("%s: substring views, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
 }
 
-int main() {
+//Tests for the columnar batch check - validity bits and lengths of a small column with bad and cut rows,
+//random columns against a check and a count per row, and the start-of-character kernels against each other
+void test_my_utf8_check_batch() {
+    int failures = 0;
+
+    // a small column: valid rows, an empty row, a row with a bad byte and two rows cut inside a character
+    const char *column = "abc" "caf\xC3\xA9" "" "x\xFFy" "\xE6\x97" "\xA5z" "\xF0\x9F\x98\x80";
+    const int32_t offsets[] = {0, 3, 8, 8, 11, 13, 15, 19};
+    const uint8_t expectedValid = 0x01 | 0x02 | 0x04 | 0x40;
+    const int32_t expectedLengths[] = {3, 4, 0, 3, 1, 1, 1};
+    uint8_t validity = 0xFF;
+    int32_t lengths[7];
+    size_t invalid = my_utf8_check_batch((const uint8_t *)column, offsets, 7, &validity, lengths);
+    if (invalid != 3 || validity != expectedValid || memcmp(lengths, expectedLengths, sizeof(lengths)) != 0) {
+        failures++;
+    }
+
+    // random columns of short and long rows, cut anywhere, against a check and a count per row
+    static uint8_t data[70000];
+    static int64_t offsets64[20001];
+    static int32_t offsets32[20001];
+    static int64_t lengths64[20000];
+    static int32_t lengths32[20000];
+    static uint8_t validity64[2500];
+    static uint8_t validity32[2500];
+    static const char *pieces[] = {"a", "b ", "\xC3\xA9", "\xE6\x97\xA5", "\xF0\x9F\x98\x80", "\xFF", "\x80",
+                                   "\xED\xA0\x80", "\xC0\xAF"};
+    unsigned int seed = 12345;
+    for (int round = 0; round < 20; round++) {
+        size_t len = 0;
+        while (len < sizeof(data) - 4) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned int pick = (seed >> 16) % ((round % 4 == 0) ? 5 : 9);
+            const char *piece = pieces[(round % 2 == 0 && pick > 4) ? 0 : pick];
+            memcpy(data + len, piece, strlen(piece));
+            len += strlen(piece);
+        }
+        size_t rows = 0;
+        size_t pos = (size_t)round; // the column does not have to start at the first byte
+        offsets64[0] = (int64_t)pos;
+        while (rows < 20000) {
+            seed = seed * 1103515245u + 12345u;
+            size_t step = (round % 3 == 0) ? (seed >> 16) % 400 : (seed >> 16) % 12;
+            if (pos + step > len) {
+                break;
+            }
+            pos += step;
+            offsets64[++rows] = (int64_t)pos;
+        }
+        for (size_t r = 0; r <= rows; r++) {
+            offsets32[r] = (int32_t)offsets64[r];
+        }
+
+        size_t expectedInvalid = 0;
+        size_t invalid64 = my_utf8_check_batch_large(data, offsets64, rows, validity64, lengths64);
+        size_t invalid32 = my_utf8_check_batch(data, offsets32, rows, validity32, lengths32);
+        for (size_t r = 0; r < rows && failures < 10; r++) {
+            size_t start = (size_t)offsets64[r];
+            size_t rowLength = (size_t)offsets64[r + 1] - start;
+            int valid = my_utf8_check_n(data + start, rowLength) == 0;
+            size_t characters = my_utf8_strlen_n(data + start, rowLength);
+            expectedInvalid += !valid;
+            if (((validity64[r / 8] >> (r % 8)) & 1) != valid || ((validity32[r / 8] >> (r % 8)) & 1) != valid ||
+                (size_t)lengths64[r] != characters || (size_t)lengths32[r] != characters) {
+                failures++;
+            }
+        }
+        if (invalid64 != expectedInvalid || invalid32 != expectedInvalid) {
+            failures++;
+        }
+    }
+
+    // the start-of-character kernels agree with each other
+    for (size_t base = 0; base + 64 <= 4096; base += 7) {
+        if (utf8_starts_mask(data + base) != utf8_starts_mask_swar(data + base)) {
+            failures++;
+        }
+    }
+    if (my_utf8_check_batch(data, offsets32, 0, NULL, NULL) != 0) {
+        failures++;
+    }
+    printf("%s: columnar batch check, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for located errors - offset, index and length of each kind of error, maximal subparts, and long
+//random input where the located and all-errors checks agree with the scalar check
+void test_my_utf8_check_located() {
+    int failures = 0;
+
+    // "ab" "é" then an overlong, a stray continuation byte, a cut-off character and a good one
+    const uint8_t text[] = "ab\xC3\xA9\xC0\xAF" "x\x80" "\xE6\x97" "y\xF0\x9F\x98\x80";
+    size_t len = sizeof(text) - 1;
+    my_utf8_error first;
+    int status = my_utf8_check_located(text, len, &first);
+    if (status != -3 || first.status != -3 || first.offset != 4 || first.index != 3 || first.length != 1) {
+        failures++;
+    }
+    // C0 and AF are bad on their own (C0 can't start anything), E6 97 is one maximal subpart
+    const size_t offsets[] = {4, 5, 7, 8};
+    const size_t indexes[] = {3, 4, 6, 7};
+    const size_t lengths[] = {1, 1, 1, 2};
+    my_utf8_error all[4];
+    size_t count = my_utf8_check_all(text, len, all, 4);
+    if (count != 4 || my_utf8_check_all(text, len, all, 1) != 4) {
+        failures++;
+    }
+    for (size_t e = 0; e < 4 && count == 4; e++) {
+        if (all[e].offset != offsets[e] || all[e].index != indexes[e] || all[e].length != lengths[e] ||
+            all[e].status == 0) {
+            failures++;
+        }
+    }
+    if (my_utf8_check_located((const uint8_t *)"valid \xE2\x82\xAC", 9, &first) != 0 || first.offset != 9 ||
+        first.index != 0 || first.length != 0 || my_utf8_check_all((const uint8_t *)"", 0, all, 4) != 0) {
+        failures++;
+    }
+
+    // long random input with scattered errors: the located check agrees with the scalar check, and the
+    // all-errors pass agrees with restarting the scalar check behind every error
+    static uint8_t data[5000];
+    static my_utf8_error found[5000];
+    static const char *pieces[] = {"a", "bc ", "\xC3\xA9", "\xE6\x97\xA5", "\xF0\x9F\x98\x80", "\xFF", "\x80",
+                                   "\xED\xA0\x80", "\xC0\xAF", "\xF0\x9F\x98", "\xE0\x80"};
+    unsigned int seed = 99;
+    for (int round = 0; round < 200; round++) {
+        size_t size = 0;
+        seed = seed * 1103515245u + 12345u;
+        size_t target = (seed >> 16) % (sizeof(data) - 4);
+        while (size < target) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned int pick = (seed >> 16) % 400;
+            const char *piece = pieces[(pick < 5 * 78) ? pick % 5 : 5 + pick % 6];
+            memcpy(data + size, piece, strlen(piece));
+            size += strlen(piece);
+        }
+
+        size_t expectedOffset;
+        int expected = utf8_check_scalar_at(data, size, &expectedOffset);
+        status = my_utf8_check_located(data, size, &first);
+        if (status != expected || first.offset != expectedOffset ||
+            first.index != ((expected != 0) ? my_utf8_strlen_n(data, expectedOffset) : 0)) {
+            failures++;
+        }
+
+        count = my_utf8_check_all(data, size, found, sizeof(found) / sizeof(found[0]));
+        size_t pos = 0;
+        size_t index = 0;
+        size_t e = 0;
+        while (pos < size) {
+            size_t offset;
+            int code = utf8_check_scalar_at(data + pos, size - pos, &offset);
+            if (code == 0) {
+                break;
+            }
+            index += my_utf8_strlen_n(data + pos, offset);
+            pos += offset;
+            size_t bad = utf8_maximal_subpart(data + pos, size - pos);
+            if (e >= count || found[e].offset != pos || found[e].status != code || found[e].index != index ||
+                found[e].length != bad) {
+                failures++;
+                break;
+            }
+            e++;
+            index++;
+            pos += bad;
+        }
+        if (e != count) {
+            failures++;
+        }
+    }
+    printf("%s: located errors, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+//Tests for lossy repair - U+FFFD substitution of maximal subparts as in the Unicode standard, short
+//outputs, and long inputs across the chunk size, into a second buffer and in place
+void test_my_utf8_repair() {
+    int failures = 0;
+
+    // the example of the Unicode standard (U+FFFD substitution of maximal subparts) and a few more
+    struct {
+        const char *input;
+        const char *expected;
+        size_t replaced;
+    } cases[] = {
+            {"a\xF1\x80\x80\xE1\x80\xC2" "b\x80" "c\x80\xBF" "d",
+             "a\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD" "b\xEF\xBF\xBD" "c\xEF\xBF\xBD\xEF\xBF\xBD" "d", 6},
+            {"\xE0\x80\xAF", "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD", 3},           // overlong
+            {"\xED\xA0\x80" "x", "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD" "x", 3},   // surrogate
+            {"\xF0\x9F\x98" "A", "\xEF\xBF\xBD" "A", 1},                            // cut-off emoji
+            {"\xF4\x90\x80\x80", "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD", 4}, // above U+10FFFF
+            {"caf\xC3\xA9 \xFF", "caf\xC3\xA9 \xEF\xBF\xBD", 1},
+            {"caf\xC3\xA9", "caf\xC3\xA9", 0},
+            {"", "", 0}};
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        size_t len = strlen(cases[c].input);
+        size_t expectedLength = strlen(cases[c].expected);
+        uint8_t output[64];
+        size_t written;
+        size_t replaced;
+        int status = my_utf8_repair((const uint8_t *)cases[c].input, len, output, sizeof(output), &written, &replaced);
+        if (status != 0 || written != expectedLength || replaced != cases[c].replaced ||
+            memcmp(output, cases[c].expected, written) != 0) {
+            failures++;
+        }
+        uint8_t inPlace[64];
+        memcpy(inPlace, cases[c].input, len);
+        status = my_utf8_repair_in_place(inPlace, len, expectedLength, &written, &replaced);
+        if (status != 0 || written != expectedLength || replaced != cases[c].replaced ||
+            memcmp(inPlace, cases[c].expected, written) != 0) {
+            failures++;
+        }
+        // one byte short: -6, and the in-place buffer is left alone
+        memcpy(inPlace, cases[c].input, len);
+        if (expectedLength > len && (my_utf8_repair_in_place(inPlace, len, expectedLength - 1, &written, NULL) != -6 ||
+                                     written != expectedLength || memcmp(inPlace, cases[c].input, len) != 0)) {
+            failures++;
+        }
+    }
+    uint8_t small[5];
+    size_t written;
+    if (my_utf8_repair((const uint8_t *)"ab\xFF" "cd", 5, small, 4, &written, NULL) != -6 || written != 7 ||
+        memcmp(small, "ab", 2) != 0) {
+        failures++;
+    }
+
+    // long inputs across the chunk size: the result is valid, every error of my_utf8_check_all became one
+    // U+FFFD, and in-place repair gives the same bytes
+    static uint8_t data[80000];
+    static uint8_t repaired[3 * sizeof(data)];
+    static uint8_t inPlace[3 * sizeof(data)];
+    static const char *pieces[] = {"a", "bc ", "\xC3\xA9", "\xE6\x97\xA5", "\xF0\x9F\x98\x80", "\xFF", "\x80",
+                                   "\xED\xA0\x80", "\xC0\xAF", "\xF0\x9F\x98", "\xE0\x80"};
+    unsigned int seed = 4242;
+    for (int round = 0; round < 12; round++) {
+        size_t len = 0;
+        seed = seed * 1103515245u + 12345u;
+        size_t target = (round < 6) ? (seed >> 8) % (sizeof(data) - 4) : sizeof(data) - 4;
+        while (len < target) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned int pick = (seed >> 16) % 1000;
+            const char *piece = pieces[(round % 3 == 0 || pick < 990) ? pick % 5 : 5 + pick % 6];
+            memcpy(data + len, piece, strlen(piece));
+            len += strlen(piece);
+        }
+        size_t replaced;
+        size_t inPlaceWritten;
+        size_t inPlaceReplaced;
+        my_utf8_repair(data, len, repaired, sizeof(repaired), &written, &replaced);
+        memcpy(inPlace, data, len);
+        my_utf8_repair_in_place(inPlace, len, sizeof(inPlace), &inPlaceWritten, &inPlaceReplaced);
+        size_t errors = my_utf8_check_all(data, len, NULL, 0);
+        if (my_utf8_check_n(repaired, written) != 0 || replaced != errors || inPlaceWritten != written ||
+            inPlaceReplaced != replaced || memcmp(inPlace, repaired, written) != 0 ||
+            (errors == 0 && (written != len || memcmp(repaired, data, len) != 0))) {
+            failures++;
+        }
+    }
+    printf("%s: lossy repair, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
+}
+
+#ifndef UTF8_NO_MAIN // other programs (the benchmark) link main.c as a library
+// Command line file mode: "check <file>", "count <file>" or "decode <file>" (decoded text goes to stdout,
+// the report to stderr). Prints the result and the throughput; exit code 1 for invalid or unreadable files.
+static int run_file_command(const char *command, const char *path) {
+    enum my_utf8_file_mode mode;
+    if (strcmp(command, "check") == 0) {
+        mode = MY_UTF8_FILE_CHECK;
+    } else if (strcmp(command, "count") == 0) {
+        mode = MY_UTF8_FILE_COUNT;
+    } else if (strcmp(command, "decode") == 0) {
+        mode = MY_UTF8_FILE_DECODE;
+    } else {
+        fprintf(stderr, "Unknown command '%s' - use check, count or decode\n", command);
+        return 2;
+    }
+
+    my_utf8_file_result result;
+    if (my_utf8_file(path, mode, stdout, &result) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    FILE *report = (mode == MY_UTF8_FILE_DECODE) ? stderr : stdout;
+    double gigabytes = (double)result.bytes / 1e9;
+    if (mode == MY_UTF8_FILE_CHECK) {
+        if (result.status == 0) {
+            fprintf(report, "%s: valid UTF-8\n", path);
+        } else {
+            fprintf(report, "%s: invalid UTF-8 (result %d) at byte %zu, character %zu\n", path, result.status,
+                    result.error.offset, result.error.index);
+        }
+    } else if (mode == MY_UTF8_FILE_COUNT) {
+        fprintf(report, "%s: %zu characters\n", path, result.characters);
+    } else {
+        fprintf(report, "%s: %zu bytes decoded\n", path, result.written);
+    }
+    fprintf(report, "%zu bytes in %.3f s, %.2f GB/s\n", result.bytes, result.seconds,
+            (result.seconds > 0) ? gigabytes / result.seconds : 0.0);
+    return (result.status == 0) ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 3) {
+        // File mode, e.g. "my_utf8 check export.txt" (the my_utf8 CMake target)
+        return run_file_command(argv[1], argv[2]);
+    }
+
     char input1[1024], input2[1024];
     char encodedOutput1[2048], encodedOutput2[2048];
     char decodedOutput1[2048], decodedOutput2[2048];
@@ -768,12 +6191,18 @@ int main() {
     // Decoding
     printf("Hey, please enter an input for Decoding: ");
     fgets(input1, sizeof(input1), stdin);
-    my_utf8_decode(input1, decodedOutput1);
+    // a 1024-byte line can decode to more than the output array holds, so decode only what fits
+    size_t consumed1;
+    decodedOutput1[my_utf8_decode_bounded((uint8_t *)input1, strlen(input1), (uint8_t *)decodedOutput1,
+                                         sizeof(decodedOutput1) - 1, &consumed1)] = '\0';
     printf("Decoded version 1: %s\nLength: %d characters\n", decodedOutput1, my_utf8_strlen(decodedOutput1));
 
     printf("Hey, please enter another input for Decoding: ");
     fgets(input2, sizeof(input2), stdin);
-    my_utf8_decode(input2, decodedOutput2);
+    // a 1024-byte line can decode to more than the output array holds, so decode only what fits
+    size_t consumed2;
+    decodedOutput2[my_utf8_decode_bounded((uint8_t *)input2, strlen(input2), (uint8_t *)decodedOutput2,
+                                         sizeof(decodedOutput2) - 1, &consumed2)] = '\0';
     printf("Decoded version 2: %s\nLength: %d characters\n", decodedOutput2, my_utf8_strlen(decodedOutput2));
 
 
@@ -840,4 +6269,5 @@ int main() {
     }
     return 0;
 }
+#endif
 
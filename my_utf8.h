@@ -0,0 +1,223 @@
+#ifndef MY_UTF8_H
+#define MY_UTF8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Public functions of main.c, for programs that link against it (the benchmark, C++ wrappers).
+// The _n variants take a pointer and a length and never read past it; see main.c for details.
+
+// Encoding (\uXXXX escapes -> UTF-8) and decoding (UTF-8 -> \uXXXX escapes)
+size_t my_utf8_encode_n(const uint8_t *buf, size_t len, uint8_t *output);
+void my_utf8_encode(char *input, char *output);
+void appendUnicodeEscape(unsigned int codePoint, char **output);
+void appendUnicodeEscapes(const unsigned int *codePoints, size_t count, char **output);
+size_t my_utf8_decode_n(const uint8_t *buf, size_t len, uint8_t *output);
+int my_utf8_decode(unsigned char *input, unsigned char *output);
+
+// Characters. strlen, charat, substring, the substring views and the index all count the same way:
+// every byte that is not a continuation byte (10xxxxxx) starts a character, which takes the
+// continuation bytes behind it, valid or not. Continuation bytes at the very start belong to no character.
+size_t my_utf8_strlen_n(const uint8_t *buf, size_t len);
+int my_utf8_strlen(char *string);
+const uint8_t *my_utf8_charat_n(const uint8_t *buf, size_t len, size_t index);
+char *my_utf8_charat(unsigned char *string, int index);
+int my_utf8_strcmp_n(const uint8_t *buf1, size_t len1, const uint8_t *buf2, size_t len2);
+int my_utf8_strcmp(unsigned char *string1, unsigned char *string2);
+int my_utf8_strcmp_checked(const uint8_t *buf1, size_t len1, const uint8_t *buf2, size_t len2, int *status);
+size_t my_utf8_substring_n(const uint8_t *buf, size_t len, size_t start, size_t length, uint8_t *output);
+void my_utf8_substring(char *input, int start, int length, char *output);
+
+// Zero-copy substrings: a pointer into the input and a byte length
+typedef struct my_utf8_view {
+    const uint8_t *data;
+    size_t bytes;
+} my_utf8_view;
+
+my_utf8_view my_utf8_substring_view_n(const uint8_t *buf, size_t len, size_t start, size_t length);
+my_utf8_view my_utf8_substring_view(const char *input, size_t start, size_t length);
+
+// Sampled offset index for sub-linear charat/substring on long strings
+#define UTF8_INDEX_DEFAULT_STRIDE 64
+
+typedef struct my_utf8_index {
+    const uint8_t *buf;
+    size_t len;
+    size_t stride;   // a sample every 'stride' characters
+    size_t *offsets; // offsets[s] is the byte offset of character s * stride
+    size_t length;   // number of characters in buf
+    int built;       // 1 once the samples are built, -1 if they could not be allocated
+} my_utf8_index;
+
+void my_utf8_index_init(my_utf8_index *index, const uint8_t *buf, size_t len, size_t stride);
+void my_utf8_index_free(my_utf8_index *index);
+size_t my_utf8_index_offset(my_utf8_index *index, size_t charIndex);
+size_t my_utf8_index_strlen(my_utf8_index *index);
+const uint8_t *my_utf8_index_charat(my_utf8_index *index, size_t charIndex);
+size_t my_utf8_index_range_length(my_utf8_index *index, size_t start, size_t length);
+size_t my_utf8_index_substring(my_utf8_index *index, size_t start, size_t length, uint8_t *output);
+
+// Whitespace runs (Unicode White_Space)
+typedef struct my_utf8_run {
+    size_t offset;     // byte offset of the run
+    size_t bytes;      // its length in bytes
+    size_t characters; // and in characters
+} my_utf8_run;
+
+bool isUTF8Whitespace(unsigned char ch);
+int my_utf8_longest_sequence_n(const uint8_t *buf, size_t len, my_utf8_run *longest);
+void findLongestContinuousSequence(char *input);
+
+// Byte and code point classification
+int is_continuation_byte(unsigned char byte);
+int is_start_byte(unsigned char byte);
+int is_valid_lead_byte(unsigned char byte, int num_bytes);
+int is_surrogate(unsigned int code_point);
+int is_overlong_encoding(unsigned char byte, unsigned int code_point);
+int is_valid_code_point(unsigned int code_point);
+
+// Validation: 0 for valid, otherwise -1 invalid lead byte, -2 invalid continuation byte,
+// -3 overlong encoding, -4 invalid code point, -5 unexpected continuation byte
+int my_utf8_check_n(const uint8_t *buf, size_t len);
+int my_utf8_check(unsigned char *string);
+
+// Where the check failed
+typedef struct my_utf8_error {
+    int status;    // the my_utf8_check code, 0 for valid input
+    size_t offset; // byte offset of the bad sequence (len for valid input)
+    size_t index;  // code point index: characters in front of it (0 for valid input)
+    size_t length; // bytes of the bad sequence, the ones one U+FFFD replaces (0 for valid input)
+} my_utf8_error;
+
+int my_utf8_check_located(const uint8_t *buf, size_t len, my_utf8_error *error);
+size_t my_utf8_check_all(const uint8_t *buf, size_t len, my_utf8_error *errors, size_t capacity);
+
+// Lossy repair: every invalid sequence becomes U+FFFD (WHATWG maximal subparts)
+int my_utf8_repair(const uint8_t *buf, size_t len, uint8_t *output, size_t capacity, size_t *written,
+                   size_t *replaced);
+int my_utf8_repair_in_place(uint8_t *buf, size_t len, size_t capacity, size_t *written, size_t *replaced);
+
+// Streaming check/decode of input that arrives in chunks
+typedef struct my_utf8_stream {
+    uint8_t pending[4]; // start of a character cut off by the end of the last chunk
+    int pendingLength;
+    int status;         // check only: 0 while valid, otherwise the code of the first error (it sticks)
+} my_utf8_stream;
+
+void my_utf8_stream_init(my_utf8_stream *state);
+int my_utf8_check_feed(my_utf8_stream *state, const uint8_t *chunk, size_t len);
+int my_utf8_check_finish(my_utf8_stream *state);
+size_t my_utf8_decode_feed(my_utf8_stream *state, const uint8_t *chunk, size_t len, uint8_t *output);
+size_t my_utf8_decode_finish(my_utf8_stream *state, uint8_t *output);
+
+// Exact output sizes, and encode/decode into a buffer of limited capacity
+size_t my_utf8_decode_size(const uint8_t *buf, size_t len);
+size_t my_utf8_encode_size(const uint8_t *buf, size_t len);
+size_t my_utf8_decode_bounded(const uint8_t *buf, size_t len, uint8_t *output, size_t capacity, size_t *consumed);
+size_t my_utf8_encode_bounded(const uint8_t *buf, size_t len, uint8_t *output, size_t capacity, size_t *consumed);
+
+// UTF-8 <-> UTF-16 in either byte order
+enum my_utf16_byte_order {
+    MY_UTF16_LE,
+    MY_UTF16_BE
+};
+
+typedef struct my_utf8_transcode_result {
+    int status;     // 0, or the error code of the first bad character (see the functions)
+    size_t read;    // input units read, up to the bad character
+    size_t written; // output units written
+} my_utf8_transcode_result;
+
+int my_utf8_to_utf16(const uint8_t *buf, size_t len, uint16_t *output, enum my_utf16_byte_order order,
+                     my_utf8_transcode_result *result);
+int my_utf8_from_utf16(const uint16_t *units, size_t count, enum my_utf16_byte_order order, uint8_t *output,
+                       my_utf8_transcode_result *result);
+
+// UTF-8 <-> UTF-32 code point arrays (the same result struct: written counts code points or bytes)
+int my_utf8_to_utf32(const uint8_t *buf, size_t len, uint32_t *output, my_utf8_transcode_result *result);
+int my_utf8_from_utf32(const uint32_t *codePoints, size_t count, uint8_t *output, my_utf8_transcode_result *result);
+
+// Unicode normalization
+enum my_utf8_normal_form {
+    MY_UTF8_NFC,
+    MY_UTF8_NFD,
+    MY_UTF8_NFKC,
+    MY_UTF8_NFKD
+};
+
+enum my_utf8_quick_check {
+    MY_UTF8_QC_NO,
+    MY_UTF8_QC_YES,
+    MY_UTF8_QC_MAYBE
+};
+
+enum my_utf8_quick_check my_utf8_quick_check(const uint8_t *buf, size_t len, enum my_utf8_normal_form form);
+int my_utf8_is_normalized(const uint8_t *buf, size_t len, enum my_utf8_normal_form form);
+int my_utf8_normalize(const uint8_t *buf, size_t len, enum my_utf8_normal_form form, uint8_t *output,
+                      size_t capacity, size_t *written);
+
+// Case folding, case-insensitive comparison and hashing
+enum my_utf8_case_fold {
+    MY_UTF8_FOLD_SIMPLE, // one code point for one (CaseFolding.txt C + S)
+    MY_UTF8_FOLD_FULL    // may give up to three, e.g. U+00DF to "ss" (C + F)
+};
+
+int my_utf8_casefold(const uint8_t *buf, size_t len, enum my_utf8_case_fold fold, uint8_t *output,
+                     size_t capacity, size_t *written);
+int my_utf8_strcasecmp(const uint8_t *buf1, size_t len1, const uint8_t *buf2, size_t len2,
+                       enum my_utf8_case_fold fold);
+uint64_t my_utf8_casefold_hash(const uint8_t *buf, size_t len, enum my_utf8_case_fold fold);
+
+// Grapheme clusters (UAX #29): iteration, counting, charat and substring in user-perceived characters
+typedef struct my_utf8_graphemes {
+    const uint8_t *buf;
+    size_t len;
+    size_t pos;             // start of the next cluster
+    unsigned int lookahead; // the character at pos when it was already looked up (internal)
+} my_utf8_graphemes;
+
+void my_utf8_graphemes_init(my_utf8_graphemes *iterator, const uint8_t *buf, size_t len);
+int my_utf8_graphemes_next(my_utf8_graphemes *iterator, size_t *offset, size_t *length);
+size_t my_utf8_grapheme_count(const uint8_t *buf, size_t len);
+const uint8_t *my_utf8_grapheme_charat(const uint8_t *buf, size_t len, size_t index, size_t *length);
+size_t my_utf8_grapheme_substring(const uint8_t *buf, size_t len, size_t start, size_t length, uint8_t *output);
+
+// Whole-file check/count/decode
+enum my_utf8_file_mode {
+    MY_UTF8_FILE_CHECK,
+    MY_UTF8_FILE_COUNT,
+    MY_UTF8_FILE_DECODE
+};
+
+typedef struct my_utf8_file_result {
+    int status;          // check: my_utf8_check code of the file
+    my_utf8_error error; // check: where the first bad character is
+    size_t bytes;        // size of the file
+    size_t characters;   // count: number of characters
+    size_t written;      // decode: bytes written to the output stream
+    double seconds;      // time spent on the data itself, without opening and mapping the file
+} my_utf8_file_result;
+
+int my_utf8_file(const char *path, enum my_utf8_file_mode mode, FILE *output, my_utf8_file_result *result);
+
+// Multithreaded check/count (threads <= 0 uses one thread per CPU)
+int my_utf8_check_parallel(const uint8_t *buf, size_t len, int threads, size_t *errorOffset);
+size_t my_utf8_strlen_parallel(const uint8_t *buf, size_t len, int threads);
+
+// Columnar batches (Arrow-style data buffer + count + 1 offsets): per-row validity bits and lengths
+size_t my_utf8_check_batch(const uint8_t *data, const int32_t *offsets, size_t count, uint8_t *validity,
+                           int32_t *lengths);
+size_t my_utf8_check_batch_large(const uint8_t *data, const int64_t *offsets, size_t count, uint8_t *validity,
+                                 int64_t *lengths);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MY_UTF8_H
@@ -0,0 +1,640 @@
+#ifndef MY_UTF8_HPP
+#define MY_UTF8_HPP
+
+// C++ interface of main.c, header only: link main.c built with -DUTF8_NO_MAIN, as for the benchmark.
+// Needs C++17; the std::span overloads need C++20.
+//
+// Text is taken as std::string_view. Encoding, decoding, length, validation and character offsets are
+// constexpr, so string literals and tables of code points are handled at compile time; the same calls
+// at run time go to the vectorized C functions, and both give the same results. What is known about the
+// input is a template parameter: unknown_input (the default) is checked, while valid_input and
+// ascii_input select specializations that skip the checks entirely.
+//
+// Lengths, offsets, substrings and char_at count characters the way main.c does (see my_utf8.h): a byte
+// that is not a continuation byte (10xxxxxx) starts a character, which takes the continuation bytes
+// behind it. Decoding works in code points instead, where every bad sequence (one maximal subpart) is a
+// U+FFFD of its own; for valid text the two are the same, so offset(text, i) is where code point i of
+// decode(text) comes from.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#define MY_UTF8_HAVE_SPAN 1
+#endif
+
+#include "my_utf8.h"
+
+// Whether the call is being evaluated at compile time, to pick the constexpr loop or the C function
+#if defined(__cpp_lib_is_constant_evaluated)
+#define MY_UTF8_CONSTANT_EVALUATED() std::is_constant_evaluated()
+#elif defined(__GNUC__) || defined(__clang__)
+#define MY_UTF8_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#else
+#define MY_UTF8_CONSTANT_EVALUATED() true // can't tell: always the inline loops
+#endif
+
+namespace my_utf8 {
+
+inline constexpr char32_t replacement_character = 0xFFFD;
+
+// One decoded character: its code point (U+FFFD for a bad sequence) and the bytes it took. A bad
+// sequence is cut the way my_utf8_repair cuts it (one maximal subpart).
+struct decoded_character {
+    char32_t code_point;
+    std::size_t length;
+    bool valid;
+};
+
+namespace detail {
+
+inline const std::uint8_t *bytes(std::string_view text) noexcept {
+    return reinterpret_cast<const std::uint8_t *>(text.data());
+}
+
+constexpr unsigned char byte_at(std::string_view text, std::size_t pos) noexcept {
+    return static_cast<unsigned char>(text[pos]);
+}
+
+// Decodes the character at pos with the well-formed ranges of Unicode Table 3-7: the lead byte
+// decides the length and the range of the second byte, later bytes are 80..BF
+constexpr decoded_character next(std::string_view text, std::size_t pos) noexcept {
+    unsigned char lead = byte_at(text, pos);
+    if (lead < 0x80) {
+        return {lead, 1, true};
+    }
+    std::size_t length = 0;
+    char32_t codePoint = 0;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+        codePoint = lead & 0x1F;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        codePoint = lead & 0x0F;
+        low = (lead == 0xE0) ? 0xA0 : 0x80;  // overlong
+        high = (lead == 0xED) ? 0x9F : 0xBF; // surrogates
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        codePoint = lead & 0x07;
+        low = (lead == 0xF0) ? 0x90 : 0x80;  // overlong
+        high = (lead == 0xF4) ? 0x8F : 0xBF; // above U+10FFFF
+    } else {
+        return {replacement_character, 1, false};
+    }
+    for (std::size_t i = 1; i < length; i++) {
+        if (pos + i >= text.size() || byte_at(text, pos + i) < low || byte_at(text, pos + i) > high) {
+            return {replacement_character, i, false}; // the bad sequence ends in front of this byte
+        }
+        codePoint = (codePoint << 6) | (byte_at(text, pos + i) & 0x3F);
+        low = 0x80;
+        high = 0xBF;
+    }
+    return {codePoint, length, true};
+}
+
+// The same for text known to be valid: the lead byte gives the length and nothing is checked
+constexpr decoded_character next_valid(std::string_view text, std::size_t pos) noexcept {
+    unsigned char lead = byte_at(text, pos);
+    if (lead < 0x80) {
+        return {lead, 1, true};
+    }
+    std::size_t length = (lead >= 0xF0) ? 4 : (lead >= 0xE0) ? 3 : 2;
+    char32_t codePoint = lead & (0x7F >> length);
+    for (std::size_t i = 1; i < length; i++) {
+        codePoint = (codePoint << 6) | (byte_at(text, pos + i) & 0x3F);
+    }
+    return {codePoint, length, true};
+}
+
+// Whether a byte starts a character: anything but a continuation byte (10xxxxxx)
+constexpr bool starts_character(unsigned char byte) noexcept {
+    return (byte & 0xC0) != 0x80;
+}
+
+// Characters from pos to the end, as my_utf8_strlen_n counts them
+constexpr std::size_t count(std::string_view text, std::size_t pos) noexcept {
+    std::size_t characters = 0;
+    for (; pos < text.size(); pos++) {
+        characters += starts_character(byte_at(text, pos));
+    }
+    return characters;
+}
+
+// Byte offset of the character 'index' characters behind pos, text.size() past the end. Continuation
+// bytes at pos belong to the character before it, as in my_utf8_charat_n.
+constexpr std::size_t offset(std::string_view text, std::size_t pos, std::size_t index) noexcept {
+    while (pos < text.size() && !starts_character(byte_at(text, pos))) {
+        pos++;
+    }
+    for (; pos < text.size() && index > 0; index--) {
+        pos++;
+        while (pos < text.size() && !starts_character(byte_at(text, pos))) {
+            pos++;
+        }
+    }
+    return pos;
+}
+
+constexpr bool valid(std::string_view text) noexcept {
+    for (std::size_t pos = 0; pos < text.size();) {
+        decoded_character character = next(text, pos);
+        if (!character.valid) {
+            return false;
+        }
+        pos += character.length;
+    }
+    return true;
+}
+
+// Run time versions over the C functions
+
+// Byte offset of character 'index' with my_utf8_charat_n, text.size() past the end
+inline std::size_t offset(std::string_view text, std::size_t index) noexcept {
+    const std::uint8_t *found = my_utf8_charat_n(bytes(text), text.size(), index);
+    return (found != nullptr) ? static_cast<std::size_t>(found - bytes(text)) : text.size();
+}
+
+inline std::string_view substring(std::string_view text, std::size_t start, std::size_t length) noexcept {
+    my_utf8_view view = my_utf8_substring_view_n(bytes(text), text.size(), start, length);
+    return text.substr(static_cast<std::size_t>(view.data - bytes(text)), view.bytes);
+}
+
+} // namespace detail
+
+// What is known about the input
+struct unknown_input {}; // anything: checked, bad sequences decode to U+FFFD
+struct valid_input {};   // known to be valid UTF-8: decoded without any checks
+struct ascii_input {};   // known to be ASCII: every byte is a character
+
+template <class Input = unknown_input>
+struct codec {
+    static constexpr bool is_valid(std::string_view text) noexcept {
+        if (!MY_UTF8_CONSTANT_EVALUATED()) {
+            return my_utf8_check_n(detail::bytes(text), text.size()) == 0;
+        }
+        return detail::valid(text);
+    }
+
+    static constexpr decoded_character next(std::string_view text, std::size_t pos) noexcept {
+        return detail::next(text, pos);
+    }
+
+    static constexpr std::size_t length(std::string_view text) noexcept {
+        if (!MY_UTF8_CONSTANT_EVALUATED()) {
+            return my_utf8_strlen_n(detail::bytes(text), text.size());
+        }
+        return detail::count(text, 0);
+    }
+
+    static constexpr std::size_t offset(std::string_view text, std::size_t index) noexcept {
+        if (!MY_UTF8_CONSTANT_EVALUATED()) {
+            return detail::offset(text, index);
+        }
+        return detail::offset(text, 0, index);
+    }
+
+    static constexpr std::string_view substring(std::string_view text, std::size_t start,
+                                                std::size_t length) noexcept {
+        if (!MY_UTF8_CONSTANT_EVALUATED()) {
+            return detail::substring(text, start, length);
+        }
+        std::size_t first = detail::offset(text, 0, start);
+        return text.substr(first, detail::offset(text, first, length) - first);
+    }
+};
+
+// Valid text: decoded without any checks. Characters are counted the same way for any input.
+template <>
+struct codec<valid_input> {
+    static constexpr bool is_valid(std::string_view) noexcept {
+        return true;
+    }
+
+    static constexpr decoded_character next(std::string_view text, std::size_t pos) noexcept {
+        return detail::next_valid(text, pos);
+    }
+
+    static constexpr std::size_t length(std::string_view text) noexcept {
+        return codec<>::length(text);
+    }
+
+    static constexpr std::size_t offset(std::string_view text, std::size_t index) noexcept {
+        return codec<>::offset(text, index);
+    }
+
+    static constexpr std::string_view substring(std::string_view text, std::size_t start,
+                                                std::size_t length) noexcept {
+        return codec<>::substring(text, start, length);
+    }
+};
+
+template <>
+struct codec<ascii_input> {
+    static constexpr bool is_valid(std::string_view) noexcept {
+        return true;
+    }
+
+    static constexpr decoded_character next(std::string_view text, std::size_t pos) noexcept {
+        return {detail::byte_at(text, pos), 1, true};
+    }
+
+    static constexpr std::size_t length(std::string_view text) noexcept {
+        return text.size();
+    }
+
+    static constexpr std::size_t offset(std::string_view text, std::size_t index) noexcept {
+        return (index < text.size()) ? index : text.size();
+    }
+
+    static constexpr std::string_view substring(std::string_view text, std::size_t start,
+                                                std::size_t length) noexcept {
+        return text.substr(offset(text, start), length);
+    }
+};
+
+// Validation, length in characters, character offsets and zero-copy substrings
+
+template <class Input = unknown_input>
+constexpr bool is_valid(std::string_view text) noexcept {
+    return codec<Input>::is_valid(text);
+}
+
+template <class Input = unknown_input>
+constexpr std::size_t length(std::string_view text) noexcept {
+    return codec<Input>::length(text);
+}
+
+// Byte offset of character 'index', text.size() if there is no such character
+template <class Input = unknown_input>
+constexpr std::size_t offset(std::string_view text, std::size_t index) noexcept {
+    return codec<Input>::offset(text, index);
+}
+
+template <class Input = unknown_input>
+constexpr std::string_view substring(std::string_view text, std::size_t start, std::size_t length) noexcept {
+    return codec<Input>::substring(text, start, length);
+}
+
+// The character at 'index' as a view of its bytes (empty past the end)
+template <class Input = unknown_input>
+constexpr std::string_view char_at(std::string_view text, std::size_t index) noexcept {
+    return codec<Input>::substring(text, index, 1);
+}
+
+// Encoding. Surrogates and values above U+10FFFF are encoded as U+FFFD.
+
+constexpr bool is_code_point(char32_t codePoint) noexcept {
+    return codePoint <= 0x10FFFF && (codePoint < 0xD800 || codePoint > 0xDFFF);
+}
+
+constexpr std::size_t encoded_length(char32_t codePoint) noexcept {
+    if (!is_code_point(codePoint)) {
+        return 3; // U+FFFD
+    }
+    return (codePoint < 0x80) ? 1 : (codePoint < 0x800) ? 2 : (codePoint < 0x10000) ? 3 : 4;
+}
+
+// Writes one code point (1 to 4 bytes) and returns its length
+constexpr std::size_t encode(char32_t codePoint, char *output) noexcept {
+    if (!is_code_point(codePoint)) {
+        codePoint = replacement_character;
+    }
+    if (codePoint < 0x80) {
+        output[0] = static_cast<char>(codePoint);
+        return 1;
+    }
+    std::size_t length = encoded_length(codePoint);
+    for (std::size_t i = length - 1; i > 0; i--) {
+        output[i] = static_cast<char>(0x80 | (codePoint & 0x3F));
+        codePoint >>= 6;
+    }
+    output[0] = static_cast<char>((0xF00 >> length) | codePoint); // 0xC0, 0xE0 or 0xF0 plus the payload
+    return length;
+}
+
+constexpr std::size_t encoded_size(std::u32string_view codePoints) noexcept {
+    std::size_t size = 0;
+    for (char32_t codePoint : codePoints) {
+        size += encoded_length(codePoint);
+    }
+    return size;
+}
+
+// Encodes code points into output (room for 4 bytes per code point) and returns the number of bytes
+// written
+constexpr std::size_t encode(std::u32string_view codePoints, char *output) noexcept {
+    std::size_t read = 0;
+    std::size_t written = 0;
+    if (!MY_UTF8_CONSTANT_EVALUATED()) {
+        // the vectorized encoder stops in front of an invalid code point, which becomes U+FFFD here
+        while (read < codePoints.size()) {
+            my_utf8_transcode_result result{};
+            my_utf8_from_utf32(reinterpret_cast<const std::uint32_t *>(codePoints.data() + read),
+                               codePoints.size() - read, reinterpret_cast<std::uint8_t *>(output + written),
+                               &result);
+            read += result.read;
+            written += result.written;
+            if (result.status == 0) {
+                return written;
+            }
+            written += encode(replacement_character, output + written);
+            read++;
+        }
+        return written;
+    }
+    for (; read < codePoints.size(); read++) {
+        written += encode(codePoints[read], output + written);
+    }
+    return written;
+}
+
+inline std::string encode(std::u32string_view codePoints) {
+    std::string text(4 * codePoints.size(), '\0');
+    text.resize(encode(codePoints, text.data()));
+    return text;
+}
+
+// UTF-8 of a string of code points, built at compile time:
+//     constexpr auto euro = my_utf8::encoded(U"€ 5");   // euro.view() == "\xE2\x82\xAC 5"
+// The array is sized for the worst case; size holds the bytes used. The terminating U+0000 of a
+// string literal is dropped.
+template <std::size_t N>
+struct encoded_text {
+    std::array<char, 4 * N> bytes{};
+    std::size_t size = 0;
+
+    constexpr std::string_view view() const noexcept {
+        return std::string_view(bytes.data(), size);
+    }
+};
+
+template <std::size_t N>
+constexpr encoded_text<N> encoded(const char32_t (&codePoints)[N]) noexcept {
+    encoded_text<N> text;
+    std::size_t count = (N > 0 && codePoints[N - 1] == 0) ? N - 1 : N;
+    for (std::size_t i = 0; i < count; i++) {
+        text.size += encode(codePoints[i], text.bytes.data() + text.size);
+    }
+    return text;
+}
+
+// Decoding. output needs room for text.size() code points (the vectorized decoder may use all of it);
+// returns the number written. With unknown_input every bad sequence becomes one U+FFFD; valid_input is
+// decoded by the loop without checks, as the C decoder validates.
+
+template <class Input = unknown_input>
+constexpr std::size_t decode(std::string_view text, char32_t *output) noexcept {
+    std::size_t written = 0;
+    std::size_t pos = 0;
+    if (!MY_UTF8_CONSTANT_EVALUATED() && std::is_same_v<Input, unknown_input>) {
+        while (pos < text.size()) {
+            my_utf8_transcode_result result{};
+            my_utf8_to_utf32(detail::bytes(text) + pos, text.size() - pos,
+                             reinterpret_cast<std::uint32_t *>(output + written), &result);
+            pos += result.read;
+            written += result.written;
+            if (result.status == 0) {
+                return written;
+            }
+            output[written++] = replacement_character;
+            pos += detail::next(text, pos).length;
+        }
+        return written;
+    }
+    while (pos < text.size()) {
+        decoded_character character = codec<Input>::next(text, pos);
+        output[written++] = character.code_point;
+        pos += character.length;
+    }
+    return written;
+}
+
+template <class Input = unknown_input>
+std::u32string decode(std::string_view text) {
+    std::u32string codePoints(text.size(), U'\0');
+    codePoints.resize(decode<Input>(text, codePoints.data()));
+    return codePoints;
+}
+
+// Code points decoded at compile time: my_utf8::decoded("caf\xC3\xA9").size == 4
+template <std::size_t N>
+struct decoded_text {
+    std::array<char32_t, N> code_points{};
+    std::size_t size = 0;
+
+    constexpr std::u32string_view view() const noexcept {
+        return std::u32string_view(code_points.data(), size);
+    }
+};
+
+template <std::size_t N>
+constexpr decoded_text<N> decoded(const char (&text)[N]) noexcept {
+    decoded_text<N> result;
+    std::string_view view(text, (N > 0 && text[N - 1] == '\0') ? N - 1 : N);
+    for (std::size_t pos = 0; pos < view.size(); result.size++) {
+        decoded_character character = detail::next(view, pos);
+        result.code_points[result.size] = character.code_point;
+        pos += character.length;
+    }
+    return result;
+}
+
+// Iteration over the code points of a text: for (char32_t c : my_utf8::code_points<valid_input>(text))
+template <class Input = unknown_input>
+class code_points {
+public:
+    class iterator {
+    public:
+        using value_type = char32_t;
+        using difference_type = std::ptrdiff_t;
+
+        constexpr iterator(std::string_view text, std::size_t pos) noexcept : text_(text), pos_(pos) {
+            load();
+        }
+
+        constexpr char32_t operator*() const noexcept {
+            return current_.code_point;
+        }
+
+        // byte offset of the current character
+        constexpr std::size_t offset() const noexcept {
+            return pos_;
+        }
+
+        constexpr iterator &operator++() noexcept {
+            pos_ += current_.length;
+            load();
+            return *this;
+        }
+
+        constexpr bool operator==(const iterator &other) const noexcept {
+            return pos_ == other.pos_;
+        }
+
+        constexpr bool operator!=(const iterator &other) const noexcept {
+            return pos_ != other.pos_;
+        }
+
+    private:
+        constexpr void load() noexcept {
+            current_ = (pos_ < text_.size()) ? codec<Input>::next(text_, pos_) : decoded_character{0, 0, true};
+        }
+
+        std::string_view text_;
+        std::size_t pos_;
+        decoded_character current_{0, 0, true};
+    };
+
+    constexpr explicit code_points(std::string_view text) noexcept : text_(text) {
+    }
+
+    constexpr iterator begin() const noexcept {
+        return iterator(text_, 0);
+    }
+
+    constexpr iterator end() const noexcept {
+        return iterator(text_, text_.size());
+    }
+
+private:
+    std::string_view text_;
+};
+
+// Run-time operations over the C functions
+
+// Where the first error is (status 0 and offset text.size() for valid text)
+inline my_utf8_error check(std::string_view text) noexcept {
+    my_utf8_error error;
+    my_utf8_check_located(detail::bytes(text), text.size(), &error);
+    return error;
+}
+
+// Every bad sequence, in one pass
+inline std::vector<my_utf8_error> check_all(std::string_view text) {
+    std::vector<my_utf8_error> errors(my_utf8_check_all(detail::bytes(text), text.size(), nullptr, 0));
+    my_utf8_check_all(detail::bytes(text), text.size(), errors.data(), errors.size());
+    return errors;
+}
+
+// Valid UTF-8 with every bad sequence replaced by U+FFFD
+inline std::string repair(std::string_view text) {
+    std::string repaired(text.size(), '\0');
+    std::size_t written;
+    if (my_utf8_repair(detail::bytes(text), text.size(), reinterpret_cast<std::uint8_t *>(repaired.data()),
+                       repaired.size(), &written, nullptr) != 0) {
+        repaired.resize(written);
+        my_utf8_repair(detail::bytes(text), text.size(), reinterpret_cast<std::uint8_t *>(repaired.data()),
+                       repaired.size(), &written, nullptr);
+    }
+    repaired.resize(written);
+    return repaired;
+}
+
+// Byte (and so code point) order: negative, 0 or positive
+inline int compare(std::string_view a, std::string_view b) noexcept {
+    return my_utf8_strcmp_n(detail::bytes(a), a.size(), detail::bytes(b), b.size());
+}
+
+inline std::u16string to_utf16(std::string_view text, enum my_utf16_byte_order order = MY_UTF16_LE) {
+    std::u16string units(text.size(), u'\0');
+    my_utf8_transcode_result result{};
+    my_utf8_to_utf16(detail::bytes(text), text.size(), reinterpret_cast<std::uint16_t *>(units.data()), order,
+                     &result);
+    units.resize(result.written);
+    return units;
+}
+
+namespace detail {
+// Calls one of the C functions that report the full output size: once into a guess, and again with
+// the exact size if it was too small. Empty for invalid input.
+template <class Call>
+std::optional<std::string> sized_output(std::size_t guess, Call call) {
+    std::string output(guess, '\0');
+    std::size_t written;
+    int status = call(reinterpret_cast<std::uint8_t *>(output.data()), output.size(), &written);
+    if (status == -6) {
+        output.resize(written);
+        status = call(reinterpret_cast<std::uint8_t *>(output.data()), output.size(), &written);
+    }
+    if (status != 0) {
+        return std::nullopt;
+    }
+    output.resize(written);
+    return output;
+}
+} // namespace detail
+
+inline std::optional<std::string> normalize(std::string_view text, enum my_utf8_normal_form form) {
+    return detail::sized_output(text.size() + text.size() / 4 + 16, [&](std::uint8_t *out, std::size_t capacity,
+                                                                          std::size_t *written) {
+        return my_utf8_normalize(detail::bytes(text), text.size(), form, out, capacity, written);
+    });
+}
+
+inline bool is_normalized(std::string_view text, enum my_utf8_normal_form form) noexcept {
+    return my_utf8_is_normalized(detail::bytes(text), text.size(), form) == 1;
+}
+
+inline std::optional<std::string> casefold(std::string_view text, enum my_utf8_case_fold fold = MY_UTF8_FOLD_FULL) {
+    return detail::sized_output(text.size() + 16, [&](std::uint8_t *out, std::size_t capacity, std::size_t *written) {
+        return my_utf8_casefold(detail::bytes(text), text.size(), fold, out, capacity, written);
+    });
+}
+
+inline int casecmp(std::string_view a, std::string_view b, enum my_utf8_case_fold fold = MY_UTF8_FOLD_FULL) noexcept {
+    return my_utf8_strcasecmp(detail::bytes(a), a.size(), detail::bytes(b), b.size(), fold);
+}
+
+inline std::uint64_t casefold_hash(std::string_view text, enum my_utf8_case_fold fold = MY_UTF8_FOLD_FULL) noexcept {
+    return my_utf8_casefold_hash(detail::bytes(text), text.size(), fold);
+}
+
+inline std::size_t grapheme_count(std::string_view text) noexcept {
+    return my_utf8_grapheme_count(detail::bytes(text), text.size());
+}
+
+#ifdef MY_UTF8_HAVE_SPAN
+// Span versions of the decoding and column operations
+
+template <class Input = unknown_input>
+constexpr std::size_t decode(std::string_view text, std::span<char32_t> output) noexcept {
+    return decode<Input>(text, output.data()); // output.size() >= text.size()
+}
+
+inline std::size_t encode(std::u32string_view codePoints, std::span<char> output) noexcept {
+    return encode(codePoints, output.data()); // output.size() >= 4 * codePoints.size()
+}
+
+// The first output.size() errors; returns how many there are in all
+inline std::size_t check_all(std::string_view text, std::span<my_utf8_error> output) noexcept {
+    return my_utf8_check_all(detail::bytes(text), text.size(), output.data(), output.size());
+}
+
+// A string column (offsets.size() - 1 rows): validity bits and lengths, see my_utf8_check_batch.
+// validity needs (rows + 7) / 8 bytes and lengths one entry per row; either may be empty.
+inline std::size_t check_batch(std::string_view data, std::span<const std::int32_t> offsets,
+                               std::span<std::uint8_t> validity, std::span<std::int32_t> lengths) noexcept {
+    return my_utf8_check_batch(detail::bytes(data), offsets.data(), offsets.empty() ? 0 : offsets.size() - 1,
+                               validity.empty() ? nullptr : validity.data(),
+                               lengths.empty() ? nullptr : lengths.data());
+}
+
+inline std::size_t check_batch(std::string_view data, std::span<const std::int64_t> offsets,
+                               std::span<std::uint8_t> validity, std::span<std::int64_t> lengths) noexcept {
+    return my_utf8_check_batch_large(detail::bytes(data), offsets.data(), offsets.empty() ? 0 : offsets.size() - 1,
+                                     validity.empty() ? nullptr : validity.data(),
+                                     lengths.empty() ? nullptr : lengths.data());
+}
+#endif
+
+} // namespace my_utf8
+
+#endif // MY_UTF8_HPP
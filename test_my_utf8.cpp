@@ -0,0 +1,252 @@
+/* Tests for my_utf8.hpp, the C++ interface of main.c.
+ *
+ * Every constexpr function of the header has two paths, the inline loops it runs at compile time and
+ * the C functions it calls at run time, and both must give the same results. So the same samples are
+ * summarized once in a constant expression and once at run time and compared; long random texts then
+ * compare the C paths with the loops directly. The run time wrappers get a few checks of their own.
+ *
+ * Build: the my_utf8_hpp_test CMake target (main.c with -DUTF8_NO_MAIN, C++20 for the span overloads).
+ */
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <utility>
+
+#include "my_utf8.hpp"
+
+using my_utf8::ascii_input;
+using my_utf8::unknown_input;
+using my_utf8::valid_input;
+
+// Compile time checks: literals, invalid sequences, and the character counting of offset and length
+static_assert(my_utf8::length("caf\xC3\xA9 \xE2\x82\xAC\xF0\x9F\x98\x80!") == 8);
+static_assert(my_utf8::is_valid("caf\xC3\xA9"));
+static_assert(!my_utf8::is_valid("\xC0\x80") && !my_utf8::is_valid("\xED\xA0\x80") &&
+              !my_utf8::is_valid("\xF4\x90\x80\x80") && !my_utf8::is_valid("\xE2\x82"));
+static_assert(my_utf8::length("\x80\x80" "a\xFF" "b") == 3); // the leading continuation bytes are no character
+static_assert(my_utf8::offset("\x80\x80" "a\xFF" "b", 0) == 2 && my_utf8::offset("\x80\x80" "a\xFF" "b", 2) == 4);
+static_assert(my_utf8::substring("\x80\x80" "a\xFF" "b", 1, 2) == "\xFF" "b");
+static_assert(my_utf8::length("a\xE2\x82z") == 3); // the cut-off euro sign is one character
+static_assert(my_utf8::char_at("a\xE2\x82z", 1) == "\xE2\x82");
+static_assert(my_utf8::char_at("\xE4\xBD" "ab", 1) == "a" && my_utf8::substring("\xE4\xBD" "ab", 1, 1) == "a");
+static_assert(my_utf8::char_at("a\x80\x80\x80\x80" "b", 0) == "a\x80\x80\x80\x80"); // stray bytes join it
+static_assert(my_utf8::substring<valid_input>("\xC3\xA9t\xC3\xA9", 1, 5) == "t\xC3\xA9");
+static_assert(my_utf8::length<ascii_input>("abc") == 3 && my_utf8::char_at<ascii_input>("abc", 1) == "b");
+static_assert(my_utf8::encoded(U"€ 5").view() == "\xE2\x82\xAC 5");
+static_assert(my_utf8::encoded(U"\U0001F600").view() == "\xF0\x9F\x98\x80");
+static_assert(my_utf8::decoded("caf\xC3\xA9").size == 4 && my_utf8::decoded("caf\xC3\xA9").code_points[3] == 0xE9);
+static_assert(my_utf8::decoded("a\xE2\x82z").view() == U"a�z");
+static_assert(my_utf8::decoded("\xF0\x80\x80").size == 3); // F0 80 is overlong, so every byte is bad
+
+// Everything the header says about a short text, worked out in one go
+struct summary {
+    bool valid = false;
+    std::size_t length = 0;
+    std::size_t offsets[18] = {};
+    std::size_t characters[18] = {};      // byte length of char_at
+    std::size_t substrings[18][2] = {};   // offset and byte length of substring(i, 2)
+    char32_t decoded[18] = {};
+    std::size_t decodedLength = 0;
+};
+
+static bool operator==(const summary &a, const summary &b) {
+    if (a.valid != b.valid || a.length != b.length || a.decodedLength != b.decodedLength) {
+        return false;
+    }
+    for (std::size_t i = 0; i < 18; i++) {
+        if (a.offsets[i] != b.offsets[i] || a.characters[i] != b.characters[i] ||
+            a.substrings[i][0] != b.substrings[i][0] || a.substrings[i][1] != b.substrings[i][1] ||
+            a.decoded[i] != b.decoded[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class Input>
+constexpr summary summarize(std::string_view text) {
+    summary result;
+    result.valid = my_utf8::is_valid<Input>(text);
+    result.length = my_utf8::length<Input>(text);
+    for (std::size_t i = 0; i < 18; i++) {
+        result.offsets[i] = my_utf8::offset<Input>(text, i);
+        result.characters[i] = my_utf8::char_at<Input>(text, i).size();
+        std::string_view range = my_utf8::substring<Input>(text, i, 2);
+        result.substrings[i][0] = static_cast<std::size_t>(range.data() - text.data());
+        result.substrings[i][1] = range.size();
+    }
+    result.decodedLength = my_utf8::decode<Input>(text, result.decoded);
+    return result;
+}
+
+// Samples (up to 16 bytes) for each kind of input
+struct unknown_samples {
+    using input = unknown_input;
+    static constexpr std::string_view texts[] = {
+        "", "Hello", "caf\xC3\xA9 \xE2\x82\xAC\xF0\x9F\x98\x80!", "\x80\x80" "a\xFF" "b", "ab\xE2\x82z\xFF\xC3\xA9",
+        "\xF0\x9F\x98", "\xED\xA0\x80x", "\xC3\xA9\x80\xC3", "\xC0\xAF\xE0\x80\xAF", "x\xF4\x90\x80\x80y",
+        "\xE6\x97\xA5\xE6\x97\xA5\xE6\x97", "abc\xC3\xA9" "defghijkl\xC3",
+    };
+};
+
+struct valid_samples {
+    using input = valid_input;
+    static constexpr std::string_view texts[] = {
+        "", "Hello", "caf\xC3\xA9 \xE2\x82\xAC\xF0\x9F\x98\x80!", "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E",
+        "\xF4\x8F\xBF\xBF\xEF\xBF\xBD\xC2\x80\x7F", "abcdefghijklmnop",
+    };
+};
+
+struct ascii_samples {
+    using input = ascii_input;
+    static constexpr std::string_view texts[] = {"", "a", "Hello, world", "0123456789abcdef"};
+};
+
+template <class Samples, std::size_t K>
+static int compare_sample() {
+    constexpr summary expected = summarize<typename Samples::input>(Samples::texts[K]);
+    std::string copy(Samples::texts[K]); // not a constant: the run time path
+    return (summarize<typename Samples::input>(copy) == expected) ? 0 : 1;
+}
+
+template <class Samples, std::size_t... K>
+static int compare_samples(std::index_sequence<K...>) {
+    return (compare_sample<Samples, K>() + ... + 0);
+}
+
+template <class Samples>
+static int compare_samples() {
+    return compare_samples<Samples>(std::make_index_sequence<std::size(Samples::texts)>());
+}
+
+//Tests for the two paths - the samples summarized at compile time and at run time must agree
+static int test_constexpr_matches_runtime() {
+    int failures = compare_samples<unknown_samples>() + compare_samples<valid_samples>() +
+                   compare_samples<ascii_samples>();
+    std::printf("%s: compile time and run time results agree, mismatches=%d\n",
+                (failures == 0) ? "PASSED" : "FAILED", failures);
+    return failures;
+}
+
+// Small deterministic generator, as in the benchmark
+static std::uint32_t random_state = 0x2545F491u;
+
+static std::uint32_t next_random() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+//Tests for the C paths on long texts - length, offsets, substrings and decoding against the loops,
+//on valid text and with bad bytes inserted
+static int test_runtime_matches_loops() {
+    int failures = 0;
+    const char32_t alphabet[] = {U'a', U' ', 0xE9, 0x20AC, 0x4F60, 0x1F600, 0x10FFFF};
+    for (int round = 0; round < 40; round++) {
+        std::u32string codePoints;
+        for (int k = 0; k < 3000; k++) {
+            codePoints += alphabet[next_random() % 7];
+        }
+        std::string text = my_utf8::encode(codePoints);
+        if (round % 2 == 1) {
+            // bad bytes: stray continuations, cut-off characters, overlongs and surrogates
+            const char *bad[] = {"\x80", "\xE2\x82", "\xC0\xAF", "\xED\xA0\x80", "\xF0\x9F\x98", "\xFF"};
+            for (int k = 0; k < 5; k++) {
+                std::size_t at = next_random() % text.size();
+                text.insert(at, bad[next_random() % 6]);
+            }
+        }
+
+        std::size_t length = my_utf8::detail::count(text, 0);
+        if (my_utf8::length(text) != length || my_utf8::is_valid(text) != my_utf8::detail::valid(text)) {
+            failures++;
+        }
+        for (std::size_t index = 0; index <= length + 1; index += 1 + next_random() % 97) {
+            std::size_t offset = my_utf8::detail::offset(text, 0, index);
+            std::size_t end = my_utf8::detail::offset(text, offset, 7);
+            if (my_utf8::offset(text, index) != offset ||
+                my_utf8::substring(text, index, 7) != text.substr(offset, end - offset)) {
+                failures++;
+            }
+        }
+
+        std::u32string decoded = my_utf8::decode(text);
+        std::size_t pos = 0;
+        for (char32_t codePoint : decoded) {
+            my_utf8::decoded_character character = my_utf8::detail::next(text, pos);
+            failures += (character.code_point != codePoint);
+            pos += character.length;
+        }
+        // bad sequences decode to a U+FFFD each, so only valid text has a code point per character
+        failures += ((round % 2 == 0 && decoded.size() != length) || pos != text.size());
+
+        if (round % 2 == 0) {
+            // the same text as valid_input: no checks, the same answers
+            if (my_utf8::length<valid_input>(text) != length || my_utf8::decode<valid_input>(text) != decoded ||
+                my_utf8::offset<valid_input>(text, length / 2) != my_utf8::offset(text, length / 2) ||
+                my_utf8::substring<valid_input>(text, 100, 50) != my_utf8::substring(text, 100, 50)) {
+                failures++;
+            }
+        }
+    }
+    std::printf("%s: C paths agree with the loops on long texts, mismatches=%d\n",
+                (failures == 0) ? "PASSED" : "FAILED", failures);
+    return failures;
+}
+
+//Tests for encoding - invalid code points become U+FFFD, the C encoder and the loop agree
+static int test_encode() {
+    int failures = 0;
+    const char32_t codePoints[] = {U'a', 0xD800, 0x110000, U'b', 0xE9, 0x1F600};
+    std::string expected = "a\xEF\xBF\xBD\xEF\xBF\xBD" "b\xC3\xA9\xF0\x9F\x98\x80";
+    failures += (my_utf8::encode(std::u32string_view(codePoints, 6)) != expected);
+    failures += (my_utf8::encoded_size(std::u32string_view(codePoints, 6)) != expected.size());
+    char output[4];
+    failures += (my_utf8::encode(char32_t(0x20AC), output) != 3 || std::string(output, 3) != "\xE2\x82\xAC");
+    std::printf("%s: encoding, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
+    return failures;
+}
+
+//Tests for the run time wrappers - check, repair, folding, normalization and the rest over the C functions
+static int test_wrappers() {
+    int failures = 0;
+    std::string bad = "ab\xE2\x82z\xFF\xC3\xA9";
+    my_utf8_error error = my_utf8::check(bad);
+    failures += (error.status == 0 || error.offset != 2 || error.index != 2 || error.length != 2);
+    failures += (my_utf8::check_all(bad).size() != 2 || !my_utf8::check_all("ok").empty());
+    failures += (my_utf8::repair(bad) != "ab\xEF\xBF\xBDz\xEF\xBF\xBD\xC3\xA9");
+    failures += (my_utf8::repair(std::string(100, '\xFF')).size() != 300);
+    failures += (my_utf8::casefold("Stra\xC3\x9F" "E") != std::optional<std::string>("strasse"));
+    failures += my_utf8::casefold(bad).has_value();
+    failures += (my_utf8::casecmp("ABC", "abc") != 0 || my_utf8::casefold_hash("ABC") != my_utf8::casefold_hash("abc"));
+    failures += (my_utf8::normalize("e\xCC\x81", MY_UTF8_NFC) != std::optional<std::string>("\xC3\xA9"));
+    failures += !my_utf8::is_normalized("\xC3\xA9", MY_UTF8_NFC);
+    failures += (my_utf8::grapheme_count("e\xCC\x81x") != 2);
+    failures += (my_utf8::to_utf16("\xC3\xA9\xF0\x9F\x98\x80") != u"é\U0001F600");
+    failures += (my_utf8::compare("a", "b") >= 0);
+    std::size_t count = 0;
+    for (char32_t codePoint : my_utf8::code_points<>(bad)) {
+        count += (codePoint != 0);
+    }
+    failures += (count != 6);
+#ifdef MY_UTF8_HAVE_SPAN
+    std::int32_t offsets[] = {0, 2, 4, 7};
+    std::uint8_t validity[1] = {0};
+    std::int32_t lengths[3];
+    std::string column = "ab\xC3\xA9\xE2\x82z";
+    failures += (my_utf8::check_batch(column, std::span<const std::int32_t>(offsets), validity, lengths) != 1);
+    failures += (validity[0] != 3 || lengths[1] != 1);
+    char32_t decoded[8];
+    failures += (my_utf8::decode(std::string_view("xy"), std::span<char32_t>(decoded)) != 2);
+    my_utf8_error errors[1];
+    failures += (my_utf8::check_all(bad, errors) != 2 || errors[0].offset != 2);
+#endif
+    std::printf("%s: run time wrappers, mismatches=%d\n", (failures == 0) ? "PASSED" : "FAILED", failures);
+    return failures;
+}
+
+int main() {
+    int failures = test_constexpr_matches_runtime() + test_runtime_matches_loops() + test_encode() + test_wrappers();
+    return (failures == 0) ? 0 : 1;
+}
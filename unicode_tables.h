@@ -0,0 +1,9572 @@
+/* Generated by gen_unicode_tables.pl from the Unicode 14.0.0 character database - do not edit,
+ * re-run the script instead. Included by main.c only. */
+#ifndef UNICODE_TABLES_H
+#define UNICODE_TABLES_H
+
+#include <stdint.h>
+
+#define UTF8_UNICODE_VERSION "14.0.0"
+
+// Normalization: utf8_norm_props_table[utf8_norm_stage2[(utf8_norm_stage1[cp >> 7] << 7) | (cp & 127)]]
+// (stage1 ends after the last block that is not all zero; further code points use block 0)
+#define UTF8_NORM_SHIFT 7
+#define UTF8_NORM_NFD_NO 0x01
+#define UTF8_NORM_NFKD_NO 0x02
+#define UTF8_NORM_NFC_NO 0x04
+#define UTF8_NORM_NFC_MAYBE 0x08
+#define UTF8_NORM_NFKC_NO 0x10
+#define UTF8_NORM_NFKC_MAYBE 0x20
+// Below these every code point is "Yes" in the quick check of the form and has combining class 0
+#define UTF8_NORM_NFC_FIRST 0x0300
+#define UTF8_NORM_NFD_FIRST 0x00C0
+#define UTF8_NORM_NFKC_FIRST 0x00A0
+#define UTF8_NORM_NFKD_FIRST 0x00A0
+
+typedef struct utf8_norm_props {
+    uint8_t ccc;   // canonical combining class
+    uint8_t flags; // UTF8_NORM_* quick check flags
+} utf8_norm_props;
+
+static const utf8_norm_props utf8_norm_props_table[69] = {
+        {0,0},
+        {0,18},
+        {0,3},
+        {230,40},
+        {230,0},
+        {232,0},
+        {220,0},
+        {216,40},
+        {202,0},
+        {220,40},
+        {202,40},
+        {1,0},
+        {1,40},
+        {230,23},
+        {240,40},
+        {233,0},
+        {234,0},
+        {0,23},
+        {0,19},
+        {222,0},
+        {228,0},
+        {10,0},
+        {11,0},
+        {12,0},
+        {13,0},
+        {14,0},
+        {15,0},
+        {16,0},
+        {17,0},
+        {18,0},
+        {19,0},
+        {20,0},
+        {21,0},
+        {22,0},
+        {23,0},
+        {24,0},
+        {25,0},
+        {30,0},
+        {31,0},
+        {32,0},
+        {27,0},
+        {28,0},
+        {29,0},
+        {33,0},
+        {34,0},
+        {35,0},
+        {36,0},
+        {7,40},
+        {9,0},
+        {7,0},
+        {0,40},
+        {84,0},
+        {91,40},
+        {9,40},
+        {103,0},
+        {107,0},
+        {118,0},
+        {122,0},
+        {216,0},
+        {129,0},
+        {130,0},
+        {132,0},
+        {214,0},
+        {218,0},
+        {224,0},
+        {8,40},
+        {26,0},
+        {6,0},
+        {226,0}
+};
+
+static const uint8_t utf8_norm_stage1[1525] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30,
+        31, 32, 33, 34, 0, 0, 35, 0, 0, 0, 0, 0, 0, 0, 36, 37, 0, 38, 39, 0, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,
+        52, 53, 54, 55, 56, 57, 58, 0, 59, 60, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 61, 62, 0, 0, 63, 64, 65, 66, 0, 67, 68, 69,
+        70, 71, 72, 73, 74, 68, 68, 68, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 75, 76, 77, 78, 79, 80, 81, 82, 0, 83, 84, 85, 48, 48, 48, 48, 48, 48, 48, 48,
+        48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48,
+        48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48,
+        48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 86, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 87, 87, 88, 89, 90, 91, 68, 68, 92, 93, 94, 95, 96, 97,
+        0, 0, 0, 98, 0, 99, 100, 0, 0, 0, 0, 0, 0, 0, 0, 101, 0, 0, 0, 0, 102, 103, 0, 0, 0, 0, 104, 0, 0, 105, 106, 107,
+        108, 109, 110, 111, 112, 113, 114, 0, 115, 116, 0, 117, 118, 119, 120, 0, 121, 0, 122, 123, 124, 125, 0, 0, 118, 0, 126, 127, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 128, 129, 0, 0, 0, 0, 0, 0, 0, 0, 130,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 131, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 132, 133, 134, 0, 0, 0, 135, 136, 137, 68, 68, 138, 68, 139, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        140, 0, 129, 0, 0, 141, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 142, 143, 0, 0, 0, 0, 0, 0, 0, 0, 0, 144, 145, 0, 0,
+        0, 0, 146, 147, 148, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 149, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 87, 87, 87, 87, 150
+};
+
+static const uint8_t utf8_norm_stage2[19328] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0, 1, 1, 1, 0,
+        2, 2, 2, 2, 2, 2, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 2, 2, 2, 2, 2, 2, 0, 0, 2, 2, 2, 2, 2, 0, 0,
+        2, 2, 2, 2, 2, 2, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 2, 2, 2, 2, 2, 2, 0, 0, 2, 2, 2, 2, 2, 0, 2,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 2, 2, 2, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 1, 2, 2, 2, 2, 0, 2, 2, 2, 2, 2, 2, 1,
+        1, 0, 0, 2, 2, 2, 2, 2, 2, 1, 0, 0, 2, 2, 2, 2, 2, 2, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 2, 2, 2, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 2, 2,
+        2, 2, 2, 2, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, 2, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 2, 2,
+        0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0,
+        1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        3, 3, 3, 3, 3, 4, 3, 3, 3, 3, 3, 3, 3, 4, 4, 3, 4, 3, 4, 3, 3, 5, 6, 6, 6, 6, 5, 7, 6, 6, 6, 6,
+        6, 8, 8, 9, 9, 9, 9, 10, 10, 6, 6, 6, 6, 9, 9, 6, 9, 9, 6, 6, 11, 11, 11, 11, 12, 6, 6, 6, 6, 4, 4, 4,
+        13, 13, 3, 13, 13, 14, 4, 6, 6, 6, 4, 4, 4, 6, 6, 0, 4, 4, 4, 6, 6, 6, 6, 4, 5, 6, 6, 4, 15, 16, 16, 15,
+        16, 16, 15, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 17, 0, 0, 0, 0, 0, 1, 0, 0, 0, 17, 0,
+        0, 0, 0, 0, 1, 18, 2, 17, 2, 2, 2, 0, 2, 0, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 0, 1, 1, 1, 18, 18, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+        2, 2, 0, 2, 0, 0, 0, 2, 0, 0, 0, 0, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 0, 2, 0, 0, 0, 2, 0, 0, 0, 0, 2, 2, 2, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 2, 2, 2, 2,
+        0, 0, 2, 2, 2, 2, 2, 2, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 4, 4, 4, 4, 6, 4, 4, 4, 19, 6, 4, 4, 4, 4,
+        4, 4, 6, 6, 6, 6, 6, 6, 4, 4, 6, 4, 4, 19, 20, 4, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 30, 31, 32, 33, 0, 34,
+        0, 35, 36, 0, 4, 6, 0, 29, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 37, 38, 39, 0, 0, 0, 0, 0,
+        0, 0, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 40, 41, 42, 37, 38, 39, 43, 44, 3, 3, 9, 6, 4, 4, 4, 4, 4, 6, 4, 4, 6,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 45, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        2, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 4, 4, 4, 4, 4, 4, 4, 0, 0, 4,
+        4, 4, 4, 6, 4, 0, 0, 4, 4, 0, 6, 4, 4, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 46, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 6, 4, 4, 6, 4, 4, 6, 6, 6, 4, 6, 6, 4, 6, 4,
+        4, 4, 6, 4, 6, 4, 6, 4, 6, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 6, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 0, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 0, 4, 4, 4, 0, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 6, 6, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 6, 6, 6, 4, 4, 4, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 6, 6, 6, 6, 6, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 0, 6, 4, 4, 6, 4, 4, 6, 4, 4, 4, 6, 6, 6, 40, 41, 42, 4, 4, 4, 6, 4, 4, 6, 6, 4, 4, 4, 4, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 47, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 4, 6, 4, 4, 0, 0, 0, 17, 17, 17, 17, 17, 17, 17, 17,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 0, 50, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 50, 0, 0, 0, 0, 17, 17, 0, 17,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 17, 0, 0, 17, 0, 0, 0, 0, 0, 49, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 17, 17, 17, 0, 0, 17, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 0, 50, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 2, 2, 48, 0, 0, 0, 0, 0, 0, 0, 0, 50, 50, 0, 0, 0, 0, 17, 17, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 50, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 50, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 51, 52, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 0, 0, 0,
+        2, 0, 50, 0, 0, 0, 0, 2, 2, 0, 2, 2, 0, 48, 0, 0, 0, 0, 0, 0, 0, 50, 50, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 48, 0, 50, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 50, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 53, 0, 0, 0, 0, 50, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 2, 2, 2, 50,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 54, 54, 48, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 55, 55, 55, 55, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 56, 56, 48, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 57, 57, 57, 57, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 6, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 0, 6, 0, 58, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 17, 0, 0, 0, 0, 0, 0, 0, 0, 0, 17, 0, 0, 0, 0, 17, 0, 0, 0, 0, 17, 0, 0, 0, 0, 17, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 17, 0, 0, 0, 0, 0, 0, 0, 59, 60, 17, 61, 17, 17, 1, 17, 1, 60, 60, 60, 60, 0, 0,
+        60, 17, 4, 4, 48, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 17, 0, 0, 0, 0, 0, 0, 0, 0, 0, 17, 0, 0,
+        0, 0, 17, 0, 0, 0, 0, 17, 0, 0, 0, 0, 17, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 17, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 50, 0, 0, 0, 0, 0, 0, 0, 0, 49, 0, 48, 48, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50,
+        50, 50, 50, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 19, 4, 6, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 6, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 6,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 6, 6, 6, 6, 6, 6, 4, 4, 6, 0, 6,
+        6, 4, 4, 6, 6, 4, 4, 4, 4, 4, 6, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 50, 0, 0, 0, 0, 0, 2, 0, 2, 0, 0,
+        2, 2, 0, 2, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 6, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 0, 11, 6, 6, 6, 6, 6, 4, 4, 6, 6, 6, 6,
+        4, 0, 11, 11, 11, 11, 11, 11, 11, 0, 0, 0, 0, 6, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 4, 4, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        4, 4, 6, 4, 4, 4, 4, 4, 4, 4, 6, 4, 4, 16, 62, 6, 8, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 5, 20, 20, 6, 63, 4, 15, 6, 4, 6,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 18, 0, 0, 0, 0,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 2, 2, 2, 2, 2, 2, 0, 0,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 2, 2, 2, 0, 0, 2, 2, 2, 2, 2, 2, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 0, 2, 0, 2, 0, 2, 0, 2,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 17, 2, 17, 2, 17, 2, 17, 2, 17, 2, 17, 2, 17, 0, 0,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 2, 2, 2, 2, 2, 17, 2, 1, 17, 1,
+        1, 18, 2, 2, 2, 0, 2, 2, 2, 17, 2, 17, 2, 18, 18, 18, 2, 2, 2, 17, 0, 0, 2, 2, 2, 2, 2, 17, 0, 18, 18, 18,
+        2, 2, 2, 17, 2, 2, 2, 2, 2, 2, 2, 17, 2, 18, 17, 17, 0, 0, 2, 2, 2, 0, 2, 2, 2, 17, 2, 17, 2, 17, 1, 0,
+        17, 17, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 0, 1, 0, 1, 0,
+        0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 11, 11, 4, 4, 4, 4, 11, 11, 11, 4, 4, 0, 0, 0,
+        0, 4, 0, 0, 0, 11, 11, 4, 6, 4, 11, 11, 6, 6, 6, 6, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0,
+        1, 1, 1, 0, 1, 0, 17, 0, 1, 0, 17, 17, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1,
+        1, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 2, 0, 0, 0, 0, 2, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 2, 0, 2, 0, 0, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 2, 0, 0, 2, 0, 0, 2, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        2, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0,
+        2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        2, 2, 2, 2, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 17, 17, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 17, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 63, 20, 5, 19, 64, 64, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0,
+        2, 0, 2, 0, 0, 2, 0, 2, 0, 2, 0, 0, 0, 0, 0, 0, 2, 2, 0, 2, 2, 0, 2, 2, 0, 2, 2, 0, 2, 2, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 65, 65, 1, 1, 0, 2, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0,
+        2, 0, 2, 0, 0, 2, 0, 2, 0, 2, 0, 0, 0, 0, 0, 0, 2, 2, 0, 2, 2, 0, 2, 2, 0, 2, 2, 0, 2, 2, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 2, 2, 2, 2, 0, 0, 0, 2, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 4, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 6, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 4, 4, 6, 0, 0, 4, 4, 0, 0, 0, 0, 0, 4, 4,
+        0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17,
+        17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17,
+        17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17,
+        17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17,
+        17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 0, 0, 17, 0, 17, 0, 0, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 0,
+        17, 0, 17, 0, 0, 17, 17, 0, 0, 0, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17,
+        17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17,
+        17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 0, 0, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17,
+        17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17,
+        17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17,
+        17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 17, 66, 17,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 0, 17, 17, 17, 17, 17, 0, 17, 0,
+        17, 17, 0, 17, 17, 0, 17, 17, 17, 17, 17, 17, 17, 17, 17, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 4, 4, 4, 4, 6, 6, 6, 6, 6, 6, 6, 4, 4, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0,
+        0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0,
+        0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0,
+        0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 11, 6, 0, 0, 0, 0, 48,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 4, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 6, 6, 4, 4, 4, 6, 4, 6, 6, 6, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 6, 4, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 2, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 47, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 50, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 48, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 49, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 49, 0, 50, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 50, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 48, 0, 0, 0, 49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 50, 0, 0, 0, 0, 0, 0, 0, 0, 0, 50, 2, 2, 50, 2, 0,
+        0, 0, 48, 49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 50, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 48,
+        49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 49, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 49, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 50, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 48, 48, 0,
+        0, 0, 0, 49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 49, 0, 48, 48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 11, 11, 11, 11, 11, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 67, 67, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 11, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 17, 17,
+        17, 17, 17, 17, 17, 58, 58, 11, 11, 11, 0, 0, 0, 68, 58, 58, 58, 58, 58, 0, 0, 0, 0, 0, 0, 0, 0, 6, 6, 6, 6, 6,
+        6, 6, 6, 0, 0, 4, 4, 4, 4, 4, 6, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 17, 17, 17, 17, 17,
+        17, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1,
+        0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 1, 1,
+        1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 0,
+        1, 1, 1, 1, 1, 0, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        4, 4, 4, 4, 4, 4, 4, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 4, 4, 4, 4, 4,
+        4, 4, 0, 4, 4, 0, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 6, 6, 6, 6, 6, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 0, 1, 0, 0, 0, 0,
+        0, 0, 1, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 1, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1,
+        0, 1, 1, 0, 1, 0, 0, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0,
+        0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+        17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+// Full decompositions (already recursively decomposed), sorted by code point. The compatibility
+// list only has the code points whose compatibility decomposition differs from the canonical one.
+typedef struct utf8_decomposition {
+    uint32_t codePoint;
+    uint16_t offset; // into utf8_decomposition_data
+    uint16_t length;
+} utf8_decomposition;
+
+static const utf8_decomposition utf8_canonical_decompositions[2061] = {
+        {0x00C0, 24, 2},
+        {0x00C1, 26, 2},
+        {0x00C2, 28, 2},
+        {0x00C3, 30, 2},
+        {0x00C4, 32, 2},
+        {0x00C5, 34, 2},
+        {0x00C7, 36, 2},
+        {0x00C8, 38, 2},
+        {0x00C9, 40, 2},
+        {0x00CA, 42, 2},
+        {0x00CB, 44, 2},
+        {0x00CC, 46, 2},
+        {0x00CD, 48, 2},
+        {0x00CE, 50, 2},
+        {0x00CF, 52, 2},
+        {0x00D1, 54, 2},
+        {0x00D2, 56, 2},
+        {0x00D3, 58, 2},
+        {0x00D4, 60, 2},
+        {0x00D5, 62, 2},
+        {0x00D6, 64, 2},
+        {0x00D9, 66, 2},
+        {0x00DA, 68, 2},
+        {0x00DB, 70, 2},
+        {0x00DC, 72, 2},
+        {0x00DD, 74, 2},
+        {0x00E0, 76, 2},
+        {0x00E1, 78, 2},
+        {0x00E2, 80, 2},
+        {0x00E3, 82, 2},
+        {0x00E4, 84, 2},
+        {0x00E5, 86, 2},
+        {0x00E7, 88, 2},
+        {0x00E8, 90, 2},
+        {0x00E9, 92, 2},
+        {0x00EA, 94, 2},
+        {0x00EB, 96, 2},
+        {0x00EC, 98, 2},
+        {0x00ED, 100, 2},
+        {0x00EE, 102, 2},
+        {0x00EF, 104, 2},
+        {0x00F1, 106, 2},
+        {0x00F2, 108, 2},
+        {0x00F3, 110, 2},
+        {0x00F4, 112, 2},
+        {0x00F5, 114, 2},
+        {0x00F6, 116, 2},
+        {0x00F9, 118, 2},
+        {0x00FA, 120, 2},
+        {0x00FB, 122, 2},
+        {0x00FC, 124, 2},
+        {0x00FD, 126, 2},
+        {0x00FF, 128, 2},
+        {0x0100, 130, 2},
+        {0x0101, 132, 2},
+        {0x0102, 134, 2},
+        {0x0103, 136, 2},
+        {0x0104, 138, 2},
+        {0x0105, 140, 2},
+        {0x0106, 142, 2},
+        {0x0107, 144, 2},
+        {0x0108, 146, 2},
+        {0x0109, 148, 2},
+        {0x010A, 150, 2},
+        {0x010B, 152, 2},
+        {0x010C, 154, 2},
+        {0x010D, 156, 2},
+        {0x010E, 158, 2},
+        {0x010F, 160, 2},
+        {0x0112, 162, 2},
+        {0x0113, 164, 2},
+        {0x0114, 166, 2},
+        {0x0115, 168, 2},
+        {0x0116, 170, 2},
+        {0x0117, 172, 2},
+        {0x0118, 174, 2},
+        {0x0119, 176, 2},
+        {0x011A, 178, 2},
+        {0x011B, 180, 2},
+        {0x011C, 182, 2},
+        {0x011D, 184, 2},
+        {0x011E, 186, 2},
+        {0x011F, 188, 2},
+        {0x0120, 190, 2},
+        {0x0121, 192, 2},
+        {0x0122, 194, 2},
+        {0x0123, 196, 2},
+        {0x0124, 198, 2},
+        {0x0125, 200, 2},
+        {0x0128, 202, 2},
+        {0x0129, 204, 2},
+        {0x012A, 206, 2},
+        {0x012B, 208, 2},
+        {0x012C, 210, 2},
+        {0x012D, 212, 2},
+        {0x012E, 214, 2},
+        {0x012F, 216, 2},
+        {0x0130, 218, 2},
+        {0x0134, 224, 2},
+        {0x0135, 226, 2},
+        {0x0136, 228, 2},
+        {0x0137, 230, 2},
+        {0x0139, 232, 2},
+        {0x013A, 234, 2},
+        {0x013B, 236, 2},
+        {0x013C, 238, 2},
+        {0x013D, 240, 2},
+        {0x013E, 242, 2},
+        {0x0143, 248, 2},
+        {0x0144, 250, 2},
+        {0x0145, 252, 2},
+        {0x0146, 254, 2},
+        {0x0147, 256, 2},
+        {0x0148, 258, 2},
+        {0x014C, 262, 2},
+        {0x014D, 264, 2},
+        {0x014E, 266, 2},
+        {0x014F, 268, 2},
+        {0x0150, 270, 2},
+        {0x0151, 272, 2},
+        {0x0154, 274, 2},
+        {0x0155, 276, 2},
+        {0x0156, 278, 2},
+        {0x0157, 280, 2},
+        {0x0158, 282, 2},
+        {0x0159, 284, 2},
+        {0x015A, 286, 2},
+        {0x015B, 288, 2},
+        {0x015C, 290, 2},
+        {0x015D, 292, 2},
+        {0x015E, 294, 2},
+        {0x015F, 296, 2},
+        {0x0160, 298, 2},
+        {0x0161, 300, 2},
+        {0x0162, 302, 2},
+        {0x0163, 304, 2},
+        {0x0164, 306, 2},
+        {0x0165, 308, 2},
+        {0x0168, 310, 2},
+        {0x0169, 312, 2},
+        {0x016A, 314, 2},
+        {0x016B, 316, 2},
+        {0x016C, 318, 2},
+        {0x016D, 320, 2},
+        {0x016E, 322, 2},
+        {0x016F, 324, 2},
+        {0x0170, 326, 2},
+        {0x0171, 328, 2},
+        {0x0172, 330, 2},
+        {0x0173, 332, 2},
+        {0x0174, 334, 2},
+        {0x0175, 336, 2},
+        {0x0176, 338, 2},
+        {0x0177, 340, 2},
+        {0x0178, 342, 2},
+        {0x0179, 344, 2},
+        {0x017A, 346, 2},
+        {0x017B, 348, 2},
+        {0x017C, 350, 2},
+        {0x017D, 352, 2},
+        {0x017E, 354, 2},
+        {0x01A0, 357, 2},
+        {0x01A1, 359, 2},
+        {0x01AF, 361, 2},
+        {0x01B0, 363, 2},
+        {0x01CD, 386, 2},
+        {0x01CE, 388, 2},
+        {0x01CF, 390, 2},
+        {0x01D0, 392, 2},
+        {0x01D1, 394, 2},
+        {0x01D2, 396, 2},
+        {0x01D3, 398, 2},
+        {0x01D4, 400, 2},
+        {0x01D5, 402, 3},
+        {0x01D6, 405, 3},
+        {0x01D7, 408, 3},
+        {0x01D8, 411, 3},
+        {0x01D9, 414, 3},
+        {0x01DA, 417, 3},
+        {0x01DB, 420, 3},
+        {0x01DC, 423, 3},
+        {0x01DE, 426, 3},
+        {0x01DF, 429, 3},
+        {0x01E0, 432, 3},
+        {0x01E1, 435, 3},
+        {0x01E2, 438, 2},
+        {0x01E3, 440, 2},
+        {0x01E6, 442, 2},
+        {0x01E7, 444, 2},
+        {0x01E8, 446, 2},
+        {0x01E9, 448, 2},
+        {0x01EA, 450, 2},
+        {0x01EB, 452, 2},
+        {0x01EC, 454, 3},
+        {0x01ED, 457, 3},
+        {0x01EE, 460, 2},
+        {0x01EF, 462, 2},
+        {0x01F0, 464, 2},
+        {0x01F4, 472, 2},
+        {0x01F5, 474, 2},
+        {0x01F8, 476, 2},
+        {0x01F9, 478, 2},
+        {0x01FA, 480, 3},
+        {0x01FB, 483, 3},
+        {0x01FC, 486, 2},
+        {0x01FD, 488, 2},
+        {0x01FE, 490, 2},
+        {0x01FF, 492, 2},
+        {0x0200, 494, 2},
+        {0x0201, 496, 2},
+        {0x0202, 498, 2},
+        {0x0203, 500, 2},
+        {0x0204, 502, 2},
+        {0x0205, 504, 2},
+        {0x0206, 506, 2},
+        {0x0207, 508, 2},
+        {0x0208, 510, 2},
+        {0x0209, 512, 2},
+        {0x020A, 514, 2},
+        {0x020B, 516, 2},
+        {0x020C, 518, 2},
+        {0x020D, 520, 2},
+        {0x020E, 522, 2},
+        {0x020F, 524, 2},
+        {0x0210, 526, 2},
+        {0x0211, 528, 2},
+        {0x0212, 530, 2},
+        {0x0213, 532, 2},
+        {0x0214, 534, 2},
+        {0x0215, 536, 2},
+        {0x0216, 538, 2},
+        {0x0217, 540, 2},
+        {0x0218, 542, 2},
+        {0x0219, 544, 2},
+        {0x021A, 546, 2},
+        {0x021B, 548, 2},
+        {0x021E, 550, 2},
+        {0x021F, 552, 2},
+        {0x0226, 554, 2},
+        {0x0227, 556, 2},
+        {0x0228, 558, 2},
+        {0x0229, 560, 2},
+        {0x022A, 562, 3},
+        {0x022B, 565, 3},
+        {0x022C, 568, 3},
+        {0x022D, 571, 3},
+        {0x022E, 574, 2},
+        {0x022F, 576, 2},
+        {0x0230, 578, 3},
+        {0x0231, 581, 3},
+        {0x0232, 584, 2},
+        {0x0233, 586, 2},
+        {0x0340, 614, 1},
+        {0x0341, 615, 1},
+        {0x0343, 616, 1},
+        {0x0344, 617, 2},
+        {0x0374, 619, 1},
+        {0x037E, 622, 1},
+        {0x0385, 625, 2},
+        {0x0386, 630, 2},
+        {0x0387, 632, 1},
+        {0x0388, 633, 2},
+        {0x0389, 635, 2},
+        {0x038A, 637, 2},
+        {0x038C, 639, 2},
+        {0x038E, 641, 2},
+        {0x038F, 643, 2},
+        {0x0390, 645, 3},
+        {0x03AA, 648, 2},
+        {0x03AB, 650, 2},
+        {0x03AC, 652, 2},
+        {0x03AD, 654, 2},
+        {0x03AE, 656, 2},
+        {0x03AF, 658, 2},
+        {0x03B0, 660, 3},
+        {0x03CA, 663, 2},
+        {0x03CB, 665, 2},
+        {0x03CC, 667, 2},
+        {0x03CD, 669, 2},
+        {0x03CE, 671, 2},
+        {0x03D3, 676, 2},
+        {0x03D4, 680, 2},
+        {0x0400, 692, 2},
+        {0x0401, 694, 2},
+        {0x0403, 696, 2},
+        {0x0407, 698, 2},
+        {0x040C, 700, 2},
+        {0x040D, 702, 2},
+        {0x040E, 704, 2},
+        {0x0419, 706, 2},
+        {0x0439, 708, 2},
+        {0x0450, 710, 2},
+        {0x0451, 712, 2},
+        {0x0453, 714, 2},
+        {0x0457, 716, 2},
+        {0x045C, 718, 2},
+        {0x045D, 720, 2},
+        {0x045E, 722, 2},
+        {0x0476, 724, 2},
+        {0x0477, 726, 2},
+        {0x04C1, 728, 2},
+        {0x04C2, 730, 2},
+        {0x04D0, 732, 2},
+        {0x04D1, 734, 2},
+        {0x04D2, 736, 2},
+        {0x04D3, 738, 2},
+        {0x04D6, 740, 2},
+        {0x04D7, 742, 2},
+        {0x04DA, 744, 2},
+        {0x04DB, 746, 2},
+        {0x04DC, 748, 2},
+        {0x04DD, 750, 2},
+        {0x04DE, 752, 2},
+        {0x04DF, 754, 2},
+        {0x04E2, 756, 2},
+        {0x04E3, 758, 2},
+        {0x04E4, 760, 2},
+        {0x04E5, 762, 2},
+        {0x04E6, 764, 2},
+        {0x04E7, 766, 2},
+        {0x04EA, 768, 2},
+        {0x04EB, 770, 2},
+        {0x04EC, 772, 2},
+        {0x04ED, 774, 2},
+        {0x04EE, 776, 2},
+        {0x04EF, 778, 2},
+        {0x04F0, 780, 2},
+        {0x04F1, 782, 2},
+        {0x04F2, 784, 2},
+        {0x04F3, 786, 2},
+        {0x04F4, 788, 2},
+        {0x04F5, 790, 2},
+        {0x04F8, 792, 2},
+        {0x04F9, 794, 2},
+        {0x0622, 798, 2},
+        {0x0623, 800, 2},
+        {0x0624, 802, 2},
+        {0x0625, 804, 2},
+        {0x0626, 806, 2},
+        {0x06C0, 816, 2},
+        {0x06C2, 818, 2},
+        {0x06D3, 820, 2},
+        {0x0929, 822, 2},
+        {0x0931, 824, 2},
+        {0x0934, 826, 2},
+        {0x0958, 828, 2},
+        {0x0959, 830, 2},
+        {0x095A, 832, 2},
+        {0x095B, 834, 2},
+        {0x095C, 836, 2},
+        {0x095D, 838, 2},
+        {0x095E, 840, 2},
+        {0x095F, 842, 2},
+        {0x09CB, 844, 2},
+        {0x09CC, 846, 2},
+        {0x09DC, 848, 2},
+        {0x09DD, 850, 2},
+        {0x09DF, 852, 2},
+        {0x0A33, 854, 2},
+        {0x0A36, 856, 2},
+        {0x0A59, 858, 2},
+        {0x0A5A, 860, 2},
+        {0x0A5B, 862, 2},
+        {0x0A5E, 864, 2},
+        {0x0B48, 866, 2},
+        {0x0B4B, 868, 2},
+        {0x0B4C, 870, 2},
+        {0x0B5C, 872, 2},
+        {0x0B5D, 874, 2},
+        {0x0B94, 876, 2},
+        {0x0BCA, 878, 2},
+        {0x0BCB, 880, 2},
+        {0x0BCC, 882, 2},
+        {0x0C48, 884, 2},
+        {0x0CC0, 886, 2},
+        {0x0CC7, 888, 2},
+        {0x0CC8, 890, 2},
+        {0x0CCA, 892, 2},
+        {0x0CCB, 894, 3},
+        {0x0D4A, 897, 2},
+        {0x0D4B, 899, 2},
+        {0x0D4C, 901, 2},
+        {0x0DDA, 903, 2},
+        {0x0DDC, 905, 2},
+        {0x0DDD, 907, 3},
+        {0x0DDE, 910, 2},
+        {0x0F43, 921, 2},
+        {0x0F4D, 923, 2},
+        {0x0F52, 925, 2},
+        {0x0F57, 927, 2},
+        {0x0F5C, 929, 2},
+        {0x0F69, 931, 2},
+        {0x0F73, 933, 2},
+        {0x0F75, 935, 2},
+        {0x0F76, 937, 2},
+        {0x0F78, 942, 2},
+        {0x0F81, 947, 2},
+        {0x0F93, 949, 2},
+        {0x0F9D, 951, 2},
+        {0x0FA2, 953, 2},
+        {0x0FA7, 955, 2},
+        {0x0FAC, 957, 2},
+        {0x0FB9, 959, 2},
+        {0x1026, 961, 2},
+        {0x1B06, 964, 2},
+        {0x1B08, 966, 2},
+        {0x1B0A, 968, 2},
+        {0x1B0C, 970, 2},
+        {0x1B0E, 972, 2},
+        {0x1B12, 974, 2},
+        {0x1B3B, 976, 2},
+        {0x1B3D, 978, 2},
+        {0x1B40, 980, 2},
+        {0x1B41, 982, 2},
+        {0x1B43, 984, 2},
+        {0x1E00, 1084, 2},
+        {0x1E01, 1086, 2},
+        {0x1E02, 1088, 2},
+        {0x1E03, 1090, 2},
+        {0x1E04, 1092, 2},
+        {0x1E05, 1094, 2},
+        {0x1E06, 1096, 2},
+        {0x1E07, 1098, 2},
+        {0x1E08, 1100, 3},
+        {0x1E09, 1103, 3},
+        {0x1E0A, 1106, 2},
+        {0x1E0B, 1108, 2},
+        {0x1E0C, 1110, 2},
+        {0x1E0D, 1112, 2},
+        {0x1E0E, 1114, 2},
+        {0x1E0F, 1116, 2},
+        {0x1E10, 1118, 2},
+        {0x1E11, 1120, 2},
+        {0x1E12, 1122, 2},
+        {0x1E13, 1124, 2},
+        {0x1E14, 1126, 3},
+        {0x1E15, 1129, 3},
+        {0x1E16, 1132, 3},
+        {0x1E17, 1135, 3},
+        {0x1E18, 1138, 2},
+        {0x1E19, 1140, 2},
+        {0x1E1A, 1142, 2},
+        {0x1E1B, 1144, 2},
+        {0x1E1C, 1146, 3},
+        {0x1E1D, 1149, 3},
+        {0x1E1E, 1152, 2},
+        {0x1E1F, 1154, 2},
+        {0x1E20, 1156, 2},
+        {0x1E21, 1158, 2},
+        {0x1E22, 1160, 2},
+        {0x1E23, 1162, 2},
+        {0x1E24, 1164, 2},
+        {0x1E25, 1166, 2},
+        {0x1E26, 1168, 2},
+        {0x1E27, 1170, 2},
+        {0x1E28, 1172, 2},
+        {0x1E29, 1174, 2},
+        {0x1E2A, 1176, 2},
+        {0x1E2B, 1178, 2},
+        {0x1E2C, 1180, 2},
+        {0x1E2D, 1182, 2},
+        {0x1E2E, 1184, 3},
+        {0x1E2F, 1187, 3},
+        {0x1E30, 1190, 2},
+        {0x1E31, 1192, 2},
+        {0x1E32, 1194, 2},
+        {0x1E33, 1196, 2},
+        {0x1E34, 1198, 2},
+        {0x1E35, 1200, 2},
+        {0x1E36, 1202, 2},
+        {0x1E37, 1204, 2},
+        {0x1E38, 1206, 3},
+        {0x1E39, 1209, 3},
+        {0x1E3A, 1212, 2},
+        {0x1E3B, 1214, 2},
+        {0x1E3C, 1216, 2},
+        {0x1E3D, 1218, 2},
+        {0x1E3E, 1220, 2},
+        {0x1E3F, 1222, 2},
+        {0x1E40, 1224, 2},
+        {0x1E41, 1226, 2},
+        {0x1E42, 1228, 2},
+        {0x1E43, 1230, 2},
+        {0x1E44, 1232, 2},
+        {0x1E45, 1234, 2},
+        {0x1E46, 1236, 2},
+        {0x1E47, 1238, 2},
+        {0x1E48, 1240, 2},
+        {0x1E49, 1242, 2},
+        {0x1E4A, 1244, 2},
+        {0x1E4B, 1246, 2},
+        {0x1E4C, 1248, 3},
+        {0x1E4D, 1251, 3},
+        {0x1E4E, 1254, 3},
+        {0x1E4F, 1257, 3},
+        {0x1E50, 1260, 3},
+        {0x1E51, 1263, 3},
+        {0x1E52, 1266, 3},
+        {0x1E53, 1269, 3},
+        {0x1E54, 1272, 2},
+        {0x1E55, 1274, 2},
+        {0x1E56, 1276, 2},
+        {0x1E57, 1278, 2},
+        {0x1E58, 1280, 2},
+        {0x1E59, 1282, 2},
+        {0x1E5A, 1284, 2},
+        {0x1E5B, 1286, 2},
+        {0x1E5C, 1288, 3},
+        {0x1E5D, 1291, 3},
+        {0x1E5E, 1294, 2},
+        {0x1E5F, 1296, 2},
+        {0x1E60, 1298, 2},
+        {0x1E61, 1300, 2},
+        {0x1E62, 1302, 2},
+        {0x1E63, 1304, 2},
+        {0x1E64, 1306, 3},
+        {0x1E65, 1309, 3},
+        {0x1E66, 1312, 3},
+        {0x1E67, 1315, 3},
+        {0x1E68, 1318, 3},
+        {0x1E69, 1321, 3},
+        {0x1E6A, 1324, 2},
+        {0x1E6B, 1326, 2},
+        {0x1E6C, 1328, 2},
+        {0x1E6D, 1330, 2},
+        {0x1E6E, 1332, 2},
+        {0x1E6F, 1334, 2},
+        {0x1E70, 1336, 2},
+        {0x1E71, 1338, 2},
+        {0x1E72, 1340, 2},
+        {0x1E73, 1342, 2},
+        {0x1E74, 1344, 2},
+        {0x1E75, 1346, 2},
+        {0x1E76, 1348, 2},
+        {0x1E77, 1350, 2},
+        {0x1E78, 1352, 3},
+        {0x1E79, 1355, 3},
+        {0x1E7A, 1358, 3},
+        {0x1E7B, 1361, 3},
+        {0x1E7C, 1364, 2},
+        {0x1E7D, 1366, 2},
+        {0x1E7E, 1368, 2},
+        {0x1E7F, 1370, 2},
+        {0x1E80, 1372, 2},
+        {0x1E81, 1374, 2},
+        {0x1E82, 1376, 2},
+        {0x1E83, 1378, 2},
+        {0x1E84, 1380, 2},
+        {0x1E85, 1382, 2},
+        {0x1E86, 1384, 2},
+        {0x1E87, 1386, 2},
+        {0x1E88, 1388, 2},
+        {0x1E89, 1390, 2},
+        {0x1E8A, 1392, 2},
+        {0x1E8B, 1394, 2},
+        {0x1E8C, 1396, 2},
+        {0x1E8D, 1398, 2},
+        {0x1E8E, 1400, 2},
+        {0x1E8F, 1402, 2},
+        {0x1E90, 1404, 2},
+        {0x1E91, 1406, 2},
+        {0x1E92, 1408, 2},
+        {0x1E93, 1410, 2},
+        {0x1E94, 1412, 2},
+        {0x1E95, 1414, 2},
+        {0x1E96, 1416, 2},
+        {0x1E97, 1418, 2},
+        {0x1E98, 1420, 2},
+        {0x1E99, 1422, 2},
+        {0x1E9B, 1426, 2},
+        {0x1EA0, 1430, 2},
+        {0x1EA1, 1432, 2},
+        {0x1EA2, 1434, 2},
+        {0x1EA3, 1436, 2},
+        {0x1EA4, 1438, 3},
+        {0x1EA5, 1441, 3},
+        {0x1EA6, 1444, 3},
+        {0x1EA7, 1447, 3},
+        {0x1EA8, 1450, 3},
+        {0x1EA9, 1453, 3},
+        {0x1EAA, 1456, 3},
+        {0x1EAB, 1459, 3},
+        {0x1EAC, 1462, 3},
+        {0x1EAD, 1465, 3},
+        {0x1EAE, 1468, 3},
+        {0x1EAF, 1471, 3},
+        {0x1EB0, 1474, 3},
+        {0x1EB1, 1477, 3},
+        {0x1EB2, 1480, 3},
+        {0x1EB3, 1483, 3},
+        {0x1EB4, 1486, 3},
+        {0x1EB5, 1489, 3},
+        {0x1EB6, 1492, 3},
+        {0x1EB7, 1495, 3},
+        {0x1EB8, 1498, 2},
+        {0x1EB9, 1500, 2},
+        {0x1EBA, 1502, 2},
+        {0x1EBB, 1504, 2},
+        {0x1EBC, 1506, 2},
+        {0x1EBD, 1508, 2},
+        {0x1EBE, 1510, 3},
+        {0x1EBF, 1513, 3},
+        {0x1EC0, 1516, 3},
+        {0x1EC1, 1519, 3},
+        {0x1EC2, 1522, 3},
+        {0x1EC3, 1525, 3},
+        {0x1EC4, 1528, 3},
+        {0x1EC5, 1531, 3},
+        {0x1EC6, 1534, 3},
+        {0x1EC7, 1537, 3},
+        {0x1EC8, 1540, 2},
+        {0x1EC9, 1542, 2},
+        {0x1ECA, 1544, 2},
+        {0x1ECB, 1546, 2},
+        {0x1ECC, 1548, 2},
+        {0x1ECD, 1550, 2},
+        {0x1ECE, 1552, 2},
+        {0x1ECF, 1554, 2},
+        {0x1ED0, 1556, 3},
+        {0x1ED1, 1559, 3},
+        {0x1ED2, 1562, 3},
+        {0x1ED3, 1565, 3},
+        {0x1ED4, 1568, 3},
+        {0x1ED5, 1571, 3},
+        {0x1ED6, 1574, 3},
+        {0x1ED7, 1577, 3},
+        {0x1ED8, 1580, 3},
+        {0x1ED9, 1583, 3},
+        {0x1EDA, 1586, 3},
+        {0x1EDB, 1589, 3},
+        {0x1EDC, 1592, 3},
+        {0x1EDD, 1595, 3},
+        {0x1EDE, 1598, 3},
+        {0x1EDF, 1601, 3},
+        {0x1EE0, 1604, 3},
+        {0x1EE1, 1607, 3},
+        {0x1EE2, 1610, 3},
+        {0x1EE3, 1613, 3},
+        {0x1EE4, 1616, 2},
+        {0x1EE5, 1618, 2},
+        {0x1EE6, 1620, 2},
+        {0x1EE7, 1622, 2},
+        {0x1EE8, 1624, 3},
+        {0x1EE9, 1627, 3},
+        {0x1EEA, 1630, 3},
+        {0x1EEB, 1633, 3},
+        {0x1EEC, 1636, 3},
+        {0x1EED, 1639, 3},
+        {0x1EEE, 1642, 3},
+        {0x1EEF, 1645, 3},
+        {0x1EF0, 1648, 3},
+        {0x1EF1, 1651, 3},
+        {0x1EF2, 1654, 2},
+        {0x1EF3, 1656, 2},
+        {0x1EF4, 1658, 2},
+        {0x1EF5, 1660, 2},
+        {0x1EF6, 1662, 2},
+        {0x1EF7, 1664, 2},
+        {0x1EF8, 1666, 2},
+        {0x1EF9, 1668, 2},
+        {0x1F00, 1670, 2},
+        {0x1F01, 1672, 2},
+        {0x1F02, 1674, 3},
+        {0x1F03, 1677, 3},
+        {0x1F04, 1680, 3},
+        {0x1F05, 1683, 3},
+        {0x1F06, 1686, 3},
+        {0x1F07, 1689, 3},
+        {0x1F08, 1692, 2},
+        {0x1F09, 1694, 2},
+        {0x1F0A, 1696, 3},
+        {0x1F0B, 1699, 3},
+        {0x1F0C, 1702, 3},
+        {0x1F0D, 1705, 3},
+        {0x1F0E, 1708, 3},
+        {0x1F0F, 1711, 3},
+        {0x1F10, 1714, 2},
+        {0x1F11, 1716, 2},
+        {0x1F12, 1718, 3},
+        {0x1F13, 1721, 3},
+        {0x1F14, 1724, 3},
+        {0x1F15, 1727, 3},
+        {0x1F18, 1730, 2},
+        {0x1F19, 1732, 2},
+        {0x1F1A, 1734, 3},
+        {0x1F1B, 1737, 3},
+        {0x1F1C, 1740, 3},
+        {0x1F1D, 1743, 3},
+        {0x1F20, 1746, 2},
+        {0x1F21, 1748, 2},
+        {0x1F22, 1750, 3},
+        {0x1F23, 1753, 3},
+        {0x1F24, 1756, 3},
+        {0x1F25, 1759, 3},
+        {0x1F26, 1762, 3},
+        {0x1F27, 1765, 3},
+        {0x1F28, 1768, 2},
+        {0x1F29, 1770, 2},
+        {0x1F2A, 1772, 3},
+        {0x1F2B, 1775, 3},
+        {0x1F2C, 1778, 3},
+        {0x1F2D, 1781, 3},
+        {0x1F2E, 1784, 3},
+        {0x1F2F, 1787, 3},
+        {0x1F30, 1790, 2},
+        {0x1F31, 1792, 2},
+        {0x1F32, 1794, 3},
+        {0x1F33, 1797, 3},
+        {0x1F34, 1800, 3},
+        {0x1F35, 1803, 3},
+        {0x1F36, 1806, 3},
+        {0x1F37, 1809, 3},
+        {0x1F38, 1812, 2},
+        {0x1F39, 1814, 2},
+        {0x1F3A, 1816, 3},
+        {0x1F3B, 1819, 3},
+        {0x1F3C, 1822, 3},
+        {0x1F3D, 1825, 3},
+        {0x1F3E, 1828, 3},
+        {0x1F3F, 1831, 3},
+        {0x1F40, 1834, 2},
+        {0x1F41, 1836, 2},
+        {0x1F42, 1838, 3},
+        {0x1F43, 1841, 3},
+        {0x1F44, 1844, 3},
+        {0x1F45, 1847, 3},
+        {0x1F48, 1850, 2},
+        {0x1F49, 1852, 2},
+        {0x1F4A, 1854, 3},
+        {0x1F4B, 1857, 3},
+        {0x1F4C, 1860, 3},
+        {0x1F4D, 1863, 3},
+        {0x1F50, 1866, 2},
+        {0x1F51, 1868, 2},
+        {0x1F52, 1870, 3},
+        {0x1F53, 1873, 3},
+        {0x1F54, 1876, 3},
+        {0x1F55, 1879, 3},
+        {0x1F56, 1882, 3},
+        {0x1F57, 1885, 3},
+        {0x1F59, 1888, 2},
+        {0x1F5B, 1890, 3},
+        {0x1F5D, 1893, 3},
+        {0x1F5F, 1896, 3},
+        {0x1F60, 1899, 2},
+        {0x1F61, 1901, 2},
+        {0x1F62, 1903, 3},
+        {0x1F63, 1906, 3},
+        {0x1F64, 1909, 3},
+        {0x1F65, 1912, 3},
+        {0x1F66, 1915, 3},
+        {0x1F67, 1918, 3},
+        {0x1F68, 1921, 2},
+        {0x1F69, 1923, 2},
+        {0x1F6A, 1925, 3},
+        {0x1F6B, 1928, 3},
+        {0x1F6C, 1931, 3},
+        {0x1F6D, 1934, 3},
+        {0x1F6E, 1937, 3},
+        {0x1F6F, 1940, 3},
+        {0x1F70, 1943, 2},
+        {0x1F71, 1945, 2},
+        {0x1F72, 1947, 2},
+        {0x1F73, 1949, 2},
+        {0x1F74, 1951, 2},
+        {0x1F75, 1953, 2},
+        {0x1F76, 1955, 2},
+        {0x1F77, 1957, 2},
+        {0x1F78, 1959, 2},
+        {0x1F79, 1961, 2},
+        {0x1F7A, 1963, 2},
+        {0x1F7B, 1965, 2},
+        {0x1F7C, 1967, 2},
+        {0x1F7D, 1969, 2},
+        {0x1F80, 1971, 3},
+        {0x1F81, 1974, 3},
+        {0x1F82, 1977, 4},
+        {0x1F83, 1981, 4},
+        {0x1F84, 1985, 4},
+        {0x1F85, 1989, 4},
+        {0x1F86, 1993, 4},
+        {0x1F87, 1997, 4},
+        {0x1F88, 2001, 3},
+        {0x1F89, 2004, 3},
+        {0x1F8A, 2007, 4},
+        {0x1F8B, 2011, 4},
+        {0x1F8C, 2015, 4},
+        {0x1F8D, 2019, 4},
+        {0x1F8E, 2023, 4},
+        {0x1F8F, 2027, 4},
+        {0x1F90, 2031, 3},
+        {0x1F91, 2034, 3},
+        {0x1F92, 2037, 4},
+        {0x1F93, 2041, 4},
+        {0x1F94, 2045, 4},
+        {0x1F95, 2049, 4},
+        {0x1F96, 2053, 4},
+        {0x1F97, 2057, 4},
+        {0x1F98, 2061, 3},
+        {0x1F99, 2064, 3},
+        {0x1F9A, 2067, 4},
+        {0x1F9B, 2071, 4},
+        {0x1F9C, 2075, 4},
+        {0x1F9D, 2079, 4},
+        {0x1F9E, 2083, 4},
+        {0x1F9F, 2087, 4},
+        {0x1FA0, 2091, 3},
+        {0x1FA1, 2094, 3},
+        {0x1FA2, 2097, 4},
+        {0x1FA3, 2101, 4},
+        {0x1FA4, 2105, 4},
+        {0x1FA5, 2109, 4},
+        {0x1FA6, 2113, 4},
+        {0x1FA7, 2117, 4},
+        {0x1FA8, 2121, 3},
+        {0x1FA9, 2124, 3},
+        {0x1FAA, 2127, 4},
+        {0x1FAB, 2131, 4},
+        {0x1FAC, 2135, 4},
+        {0x1FAD, 2139, 4},
+        {0x1FAE, 2143, 4},
+        {0x1FAF, 2147, 4},
+        {0x1FB0, 2151, 2},
+        {0x1FB1, 2153, 2},
+        {0x1FB2, 2155, 3},
+        {0x1FB3, 2158, 2},
+        {0x1FB4, 2160, 3},
+        {0x1FB6, 2163, 2},
+        {0x1FB7, 2165, 3},
+        {0x1FB8, 2168, 2},
+        {0x1FB9, 2170, 2},
+        {0x1FBA, 2172, 2},
+        {0x1FBB, 2174, 2},
+        {0x1FBC, 2176, 2},
+        {0x1FBE, 2180, 1},
+        {0x1FC1, 2185, 2},
+        {0x1FC2, 2190, 3},
+        {0x1FC3, 2193, 2},
+        {0x1FC4, 2195, 3},
+        {0x1FC6, 2198, 2},
+        {0x1FC7, 2200, 3},
+        {0x1FC8, 2203, 2},
+        {0x1FC9, 2205, 2},
+        {0x1FCA, 2207, 2},
+        {0x1FCB, 2209, 2},
+        {0x1FCC, 2211, 2},
+        {0x1FCD, 2213, 2},
+        {0x1FCE, 2218, 2},
+        {0x1FCF, 2223, 2},
+        {0x1FD0, 2228, 2},
+        {0x1FD1, 2230, 2},
+        {0x1FD2, 2232, 3},
+        {0x1FD3, 2235, 3},
+        {0x1FD6, 2238, 2},
+        {0x1FD7, 2240, 3},
+        {0x1FD8, 2243, 2},
+        {0x1FD9, 2245, 2},
+        {0x1FDA, 2247, 2},
+        {0x1FDB, 2249, 2},
+        {0x1FDD, 2251, 2},
+        {0x1FDE, 2256, 2},
+        {0x1FDF, 2261, 2},
+        {0x1FE0, 2266, 2},
+        {0x1FE1, 2268, 2},
+        {0x1FE2, 2270, 3},
+        {0x1FE3, 2273, 3},
+        {0x1FE4, 2276, 2},
+        {0x1FE5, 2278, 2},
+        {0x1FE6, 2280, 2},
+        {0x1FE7, 2282, 3},
+        {0x1FE8, 2285, 2},
+        {0x1FE9, 2287, 2},
+        {0x1FEA, 2289, 2},
+        {0x1FEB, 2291, 2},
+        {0x1FEC, 2293, 2},
+        {0x1FED, 2295, 2},
+        {0x1FEE, 2300, 2},
+        {0x1FEF, 2305, 1},
+        {0x1FF2, 2306, 3},
+        {0x1FF3, 2309, 2},
+        {0x1FF4, 2311, 3},
+        {0x1FF6, 2314, 2},
+        {0x1FF7, 2316, 3},
+        {0x1FF8, 2319, 2},
+        {0x1FF9, 2321, 2},
+        {0x1FFA, 2323, 2},
+        {0x1FFB, 2325, 2},
+        {0x1FFC, 2327, 2},
+        {0x1FFD, 2329, 1},
+        {0x2000, 2334, 1},
+        {0x2001, 2336, 1},
+        {0x2126, 2470, 1},
+        {0x212A, 2472, 1},
+        {0x212B, 2473, 2},
+        {0x219A, 2611, 2},
+        {0x219B, 2613, 2},
+        {0x21AE, 2615, 2},
+        {0x21CD, 2617, 2},
+        {0x21CE, 2619, 2},
+        {0x21CF, 2621, 2},
+        {0x2204, 2623, 2},
+        {0x2209, 2625, 2},
+        {0x220C, 2627, 2},
+        {0x2224, 2629, 2},
+        {0x2226, 2631, 2},
+        {0x2241, 2643, 2},
+        {0x2244, 2645, 2},
+        {0x2247, 2647, 2},
+        {0x2249, 2649, 2},
+        {0x2260, 2651, 2},
+        {0x2262, 2653, 2},
+        {0x226D, 2655, 2},
+        {0x226E, 2657, 2},
+        {0x226F, 2659, 2},
+        {0x2270, 2661, 2},
+        {0x2271, 2663, 2},
+        {0x2274, 2665, 2},
+        {0x2275, 2667, 2},
+        {0x2278, 2669, 2},
+        {0x2279, 2671, 2},
+        {0x2280, 2673, 2},
+        {0x2281, 2675, 2},
+        {0x2284, 2677, 2},
+        {0x2285, 2679, 2},
+        {0x2288, 2681, 2},
+        {0x2289, 2683, 2},
+        {0x22AC, 2685, 2},
+        {0x22AD, 2687, 2},
+        {0x22AE, 2689, 2},
+        {0x22AF, 2691, 2},
+        {0x22E0, 2693, 2},
+        {0x22E1, 2695, 2},
+        {0x22E2, 2697, 2},
+        {0x22E3, 2699, 2},
+        {0x22EA, 2701, 2},
+        {0x22EB, 2703, 2},
+        {0x22EC, 2705, 2},
+        {0x22ED, 2707, 2},
+        {0x2329, 2709, 1},
+        {0x232A, 2710, 1},
+        {0x2ADC, 3007, 2},
+        {0x304C, 3233, 2},
+        {0x304E, 3235, 2},
+        {0x3050, 3237, 2},
+        {0x3052, 3239, 2},
+        {0x3054, 3241, 2},
+        {0x3056, 3243, 2},
+        {0x3058, 3245, 2},
+        {0x305A, 3247, 2},
+        {0x305C, 3249, 2},
+        {0x305E, 3251, 2},
+        {0x3060, 3253, 2},
+        {0x3062, 3255, 2},
+        {0x3065, 3257, 2},
+        {0x3067, 3259, 2},
+        {0x3069, 3261, 2},
+        {0x3070, 3263, 2},
+        {0x3071, 3265, 2},
+        {0x3073, 3267, 2},
+        {0x3074, 3269, 2},
+        {0x3076, 3271, 2},
+        {0x3077, 3273, 2},
+        {0x3079, 3275, 2},
+        {0x307A, 3277, 2},
+        {0x307C, 3279, 2},
+        {0x307D, 3281, 2},
+        {0x3094, 3283, 2},
+        {0x309E, 3289, 2},
+        {0x30AC, 3293, 2},
+        {0x30AE, 3295, 2},
+        {0x30B0, 3297, 2},
+        {0x30B2, 3299, 2},
+        {0x30B4, 3301, 2},
+        {0x30B6, 3303, 2},
+        {0x30B8, 3305, 2},
+        {0x30BA, 3307, 2},
+        {0x30BC, 3309, 2},
+        {0x30BE, 3311, 2},
+        {0x30C0, 3313, 2},
+        {0x30C2, 3315, 2},
+        {0x30C5, 3317, 2},
+        {0x30C7, 3319, 2},
+        {0x30C9, 3321, 2},
+        {0x30D0, 3323, 2},
+        {0x30D1, 3325, 2},
+        {0x30D3, 3327, 2},
+        {0x30D4, 3329, 2},
+        {0x30D6, 3331, 2},
+        {0x30D7, 3333, 2},
+        {0x30D9, 3335, 2},
+        {0x30DA, 3337, 2},
+        {0x30DC, 3339, 2},
+        {0x30DD, 3341, 2},
+        {0x30F4, 3343, 2},
+        {0x30F7, 3345, 2},
+        {0x30F8, 3347, 2},
+        {0x30F9, 3349, 2},
+        {0x30FA, 3351, 2},
+        {0x30FE, 3353, 2},
+        {0xF900, 4724, 1},
+        {0xF901, 4725, 1},
+        {0xF902, 4726, 1},
+        {0xF903, 4727, 1},
+        {0xF904, 4728, 1},
+        {0xF905, 4729, 1},
+        {0xF906, 4730, 1},
+        {0xF907, 4731, 1},
+        {0xF908, 4732, 1},
+        {0xF909, 4733, 1},
+        {0xF90A, 4734, 1},
+        {0xF90B, 4735, 1},
+        {0xF90C, 4736, 1},
+        {0xF90D, 4737, 1},
+        {0xF90E, 4738, 1},
+        {0xF90F, 4739, 1},
+        {0xF910, 4740, 1},
+        {0xF911, 4741, 1},
+        {0xF912, 4742, 1},
+        {0xF913, 4743, 1},
+        {0xF914, 4744, 1},
+        {0xF915, 4745, 1},
+        {0xF916, 4746, 1},
+        {0xF917, 4747, 1},
+        {0xF918, 4748, 1},
+        {0xF919, 4749, 1},
+        {0xF91A, 4750, 1},
+        {0xF91B, 4751, 1},
+        {0xF91C, 4752, 1},
+        {0xF91D, 4753, 1},
+        {0xF91E, 4754, 1},
+        {0xF91F, 4755, 1},
+        {0xF920, 4756, 1},
+        {0xF921, 4757, 1},
+        {0xF922, 4758, 1},
+        {0xF923, 4759, 1},
+        {0xF924, 4760, 1},
+        {0xF925, 4761, 1},
+        {0xF926, 4762, 1},
+        {0xF927, 4763, 1},
+        {0xF928, 4764, 1},
+        {0xF929, 4765, 1},
+        {0xF92A, 4766, 1},
+        {0xF92B, 4767, 1},
+        {0xF92C, 4768, 1},
+        {0xF92D, 4769, 1},
+        {0xF92E, 4770, 1},
+        {0xF92F, 4771, 1},
+        {0xF930, 4772, 1},
+        {0xF931, 4773, 1},
+        {0xF932, 4774, 1},
+        {0xF933, 4775, 1},
+        {0xF934, 4776, 1},
+        {0xF935, 4777, 1},
+        {0xF936, 4778, 1},
+        {0xF937, 4779, 1},
+        {0xF938, 4780, 1},
+        {0xF939, 4781, 1},
+        {0xF93A, 4782, 1},
+        {0xF93B, 4783, 1},
+        {0xF93C, 4784, 1},
+        {0xF93D, 4785, 1},
+        {0xF93E, 4786, 1},
+        {0xF93F, 4787, 1},
+        {0xF940, 4788, 1},
+        {0xF941, 4789, 1},
+        {0xF942, 4790, 1},
+        {0xF943, 4791, 1},
+        {0xF944, 4792, 1},
+        {0xF945, 4793, 1},
+        {0xF946, 4794, 1},
+        {0xF947, 4795, 1},
+        {0xF948, 4796, 1},
+        {0xF949, 4797, 1},
+        {0xF94A, 4798, 1},
+        {0xF94B, 4799, 1},
+        {0xF94C, 4800, 1},
+        {0xF94D, 4801, 1},
+        {0xF94E, 4802, 1},
+        {0xF94F, 4803, 1},
+        {0xF950, 4804, 1},
+        {0xF951, 4805, 1},
+        {0xF952, 4806, 1},
+        {0xF953, 4807, 1},
+        {0xF954, 4808, 1},
+        {0xF955, 4809, 1},
+        {0xF956, 4810, 1},
+        {0xF957, 4811, 1},
+        {0xF958, 4812, 1},
+        {0xF959, 4813, 1},
+        {0xF95A, 4814, 1},
+        {0xF95B, 4815, 1},
+        {0xF95C, 4816, 1},
+        {0xF95D, 4817, 1},
+        {0xF95E, 4818, 1},
+        {0xF95F, 4819, 1},
+        {0xF960, 4820, 1},
+        {0xF961, 4821, 1},
+        {0xF962, 4822, 1},
+        {0xF963, 4823, 1},
+        {0xF964, 4824, 1},
+        {0xF965, 4825, 1},
+        {0xF966, 4826, 1},
+        {0xF967, 4827, 1},
+        {0xF968, 4828, 1},
+        {0xF969, 4829, 1},
+        {0xF96A, 4830, 1},
+        {0xF96B, 4831, 1},
+        {0xF96C, 4832, 1},
+        {0xF96D, 4833, 1},
+        {0xF96E, 4834, 1},
+        {0xF96F, 4835, 1},
+        {0xF970, 4836, 1},
+        {0xF971, 4837, 1},
+        {0xF972, 4838, 1},
+        {0xF973, 4839, 1},
+        {0xF974, 4840, 1},
+        {0xF975, 4841, 1},
+        {0xF976, 4842, 1},
+        {0xF977, 4843, 1},
+        {0xF978, 4844, 1},
+        {0xF979, 4845, 1},
+        {0xF97A, 4846, 1},
+        {0xF97B, 4847, 1},
+        {0xF97C, 4848, 1},
+        {0xF97D, 4849, 1},
+        {0xF97E, 4850, 1},
+        {0xF97F, 4851, 1},
+        {0xF980, 4852, 1},
+        {0xF981, 4853, 1},
+        {0xF982, 4854, 1},
+        {0xF983, 4855, 1},
+        {0xF984, 4856, 1},
+        {0xF985, 4857, 1},
+        {0xF986, 4858, 1},
+        {0xF987, 4859, 1},
+        {0xF988, 4860, 1},
+        {0xF989, 4861, 1},
+        {0xF98A, 4862, 1},
+        {0xF98B, 4863, 1},
+        {0xF98C, 4864, 1},
+        {0xF98D, 4865, 1},
+        {0xF98E, 4866, 1},
+        {0xF98F, 4867, 1},
+        {0xF990, 4868, 1},
+        {0xF991, 4869, 1},
+        {0xF992, 4870, 1},
+        {0xF993, 4871, 1},
+        {0xF994, 4872, 1},
+        {0xF995, 4873, 1},
+        {0xF996, 4874, 1},
+        {0xF997, 4875, 1},
+        {0xF998, 4876, 1},
+        {0xF999, 4877, 1},
+        {0xF99A, 4878, 1},
+        {0xF99B, 4879, 1},
+        {0xF99C, 4880, 1},
+        {0xF99D, 4881, 1},
+        {0xF99E, 4882, 1},
+        {0xF99F, 4883, 1},
+        {0xF9A0, 4884, 1},
+        {0xF9A1, 4885, 1},
+        {0xF9A2, 4886, 1},
+        {0xF9A3, 4887, 1},
+        {0xF9A4, 4888, 1},
+        {0xF9A5, 4889, 1},
+        {0xF9A6, 4890, 1},
+        {0xF9A7, 4891, 1},
+        {0xF9A8, 4892, 1},
+        {0xF9A9, 4893, 1},
+        {0xF9AA, 4894, 1},
+        {0xF9AB, 4895, 1},
+        {0xF9AC, 4896, 1},
+        {0xF9AD, 4897, 1},
+        {0xF9AE, 4898, 1},
+        {0xF9AF, 4899, 1},
+        {0xF9B0, 4900, 1},
+        {0xF9B1, 4901, 1},
+        {0xF9B2, 4902, 1},
+        {0xF9B3, 4903, 1},
+        {0xF9B4, 4904, 1},
+        {0xF9B5, 4905, 1},
+        {0xF9B6, 4906, 1},
+        {0xF9B7, 4907, 1},
+        {0xF9B8, 4908, 1},
+        {0xF9B9, 4909, 1},
+        {0xF9BA, 4910, 1},
+        {0xF9BB, 4911, 1},
+        {0xF9BC, 4912, 1},
+        {0xF9BD, 4913, 1},
+        {0xF9BE, 4914, 1},
+        {0xF9BF, 4915, 1},
+        {0xF9C0, 4916, 1},
+        {0xF9C1, 4917, 1},
+        {0xF9C2, 4918, 1},
+        {0xF9C3, 4919, 1},
+        {0xF9C4, 4920, 1},
+        {0xF9C5, 4921, 1},
+        {0xF9C6, 4922, 1},
+        {0xF9C7, 4923, 1},
+        {0xF9C8, 4924, 1},
+        {0xF9C9, 4925, 1},
+        {0xF9CA, 4926, 1},
+        {0xF9CB, 4927, 1},
+        {0xF9CC, 4928, 1},
+        {0xF9CD, 4929, 1},
+        {0xF9CE, 4930, 1},
+        {0xF9CF, 4931, 1},
+        {0xF9D0, 4932, 1},
+        {0xF9D1, 4933, 1},
+        {0xF9D2, 4934, 1},
+        {0xF9D3, 4935, 1},
+        {0xF9D4, 4936, 1},
+        {0xF9D5, 4937, 1},
+        {0xF9D6, 4938, 1},
+        {0xF9D7, 4939, 1},
+        {0xF9D8, 4940, 1},
+        {0xF9D9, 4941, 1},
+        {0xF9DA, 4942, 1},
+        {0xF9DB, 4943, 1},
+        {0xF9DC, 4944, 1},
+        {0xF9DD, 4945, 1},
+        {0xF9DE, 4946, 1},
+        {0xF9DF, 4947, 1},
+        {0xF9E0, 4948, 1},
+        {0xF9E1, 4949, 1},
+        {0xF9E2, 4950, 1},
+        {0xF9E3, 4951, 1},
+        {0xF9E4, 4952, 1},
+        {0xF9E5, 4953, 1},
+        {0xF9E6, 4954, 1},
+        {0xF9E7, 4955, 1},
+        {0xF9E8, 4956, 1},
+        {0xF9E9, 4957, 1},
+        {0xF9EA, 4958, 1},
+        {0xF9EB, 4959, 1},
+        {0xF9EC, 4960, 1},
+        {0xF9ED, 4961, 1},
+        {0xF9EE, 4962, 1},
+        {0xF9EF, 4963, 1},
+        {0xF9F0, 4964, 1},
+        {0xF9F1, 4965, 1},
+        {0xF9F2, 4966, 1},
+        {0xF9F3, 4967, 1},
+        {0xF9F4, 4968, 1},
+        {0xF9F5, 4969, 1},
+        {0xF9F6, 4970, 1},
+        {0xF9F7, 4971, 1},
+        {0xF9F8, 4972, 1},
+        {0xF9F9, 4973, 1},
+        {0xF9FA, 4974, 1},
+        {0xF9FB, 4975, 1},
+        {0xF9FC, 4976, 1},
+        {0xF9FD, 4977, 1},
+        {0xF9FE, 4978, 1},
+        {0xF9FF, 4979, 1},
+        {0xFA00, 4980, 1},
+        {0xFA01, 4981, 1},
+        {0xFA02, 4982, 1},
+        {0xFA03, 4983, 1},
+        {0xFA04, 4984, 1},
+        {0xFA05, 4985, 1},
+        {0xFA06, 4986, 1},
+        {0xFA07, 4987, 1},
+        {0xFA08, 4988, 1},
+        {0xFA09, 4989, 1},
+        {0xFA0A, 4990, 1},
+        {0xFA0B, 4991, 1},
+        {0xFA0C, 4992, 1},
+        {0xFA0D, 4993, 1},
+        {0xFA10, 4994, 1},
+        {0xFA12, 4995, 1},
+        {0xFA15, 4996, 1},
+        {0xFA16, 4997, 1},
+        {0xFA17, 4998, 1},
+        {0xFA18, 4999, 1},
+        {0xFA19, 5000, 1},
+        {0xFA1A, 5001, 1},
+        {0xFA1B, 5002, 1},
+        {0xFA1C, 5003, 1},
+        {0xFA1D, 5004, 1},
+        {0xFA1E, 5005, 1},
+        {0xFA20, 5006, 1},
+        {0xFA22, 5007, 1},
+        {0xFA25, 5008, 1},
+        {0xFA26, 5009, 1},
+        {0xFA2A, 5010, 1},
+        {0xFA2B, 5011, 1},
+        {0xFA2C, 5012, 1},
+        {0xFA2D, 5013, 1},
+        {0xFA2E, 5014, 1},
+        {0xFA2F, 5015, 1},
+        {0xFA30, 5016, 1},
+        {0xFA31, 5017, 1},
+        {0xFA32, 5018, 1},
+        {0xFA33, 5019, 1},
+        {0xFA34, 5020, 1},
+        {0xFA35, 5021, 1},
+        {0xFA36, 5022, 1},
+        {0xFA37, 5023, 1},
+        {0xFA38, 5024, 1},
+        {0xFA39, 5025, 1},
+        {0xFA3A, 5026, 1},
+        {0xFA3B, 5027, 1},
+        {0xFA3C, 5028, 1},
+        {0xFA3D, 5029, 1},
+        {0xFA3E, 5030, 1},
+        {0xFA3F, 5031, 1},
+        {0xFA40, 5032, 1},
+        {0xFA41, 5033, 1},
+        {0xFA42, 5034, 1},
+        {0xFA43, 5035, 1},
+        {0xFA44, 5036, 1},
+        {0xFA45, 5037, 1},
+        {0xFA46, 5038, 1},
+        {0xFA47, 5039, 1},
+        {0xFA48, 5040, 1},
+        {0xFA49, 5041, 1},
+        {0xFA4A, 5042, 1},
+        {0xFA4B, 5043, 1},
+        {0xFA4C, 5044, 1},
+        {0xFA4D, 5045, 1},
+        {0xFA4E, 5046, 1},
+        {0xFA4F, 5047, 1},
+        {0xFA50, 5048, 1},
+        {0xFA51, 5049, 1},
+        {0xFA52, 5050, 1},
+        {0xFA53, 5051, 1},
+        {0xFA54, 5052, 1},
+        {0xFA55, 5053, 1},
+        {0xFA56, 5054, 1},
+        {0xFA57, 5055, 1},
+        {0xFA58, 5056, 1},
+        {0xFA59, 5057, 1},
+        {0xFA5A, 5058, 1},
+        {0xFA5B, 5059, 1},
+        {0xFA5C, 5060, 1},
+        {0xFA5D, 5061, 1},
+        {0xFA5E, 5062, 1},
+        {0xFA5F, 5063, 1},
+        {0xFA60, 5064, 1},
+        {0xFA61, 5065, 1},
+        {0xFA62, 5066, 1},
+        {0xFA63, 5067, 1},
+        {0xFA64, 5068, 1},
+        {0xFA65, 5069, 1},
+        {0xFA66, 5070, 1},
+        {0xFA67, 5071, 1},
+        {0xFA68, 5072, 1},
+        {0xFA69, 5073, 1},
+        {0xFA6A, 5074, 1},
+        {0xFA6B, 5075, 1},
+        {0xFA6C, 5076, 1},
+        {0xFA6D, 5077, 1},
+        {0xFA70, 5078, 1},
+        {0xFA71, 5079, 1},
+        {0xFA72, 5080, 1},
+        {0xFA73, 5081, 1},
+        {0xFA74, 5082, 1},
+        {0xFA75, 5083, 1},
+        {0xFA76, 5084, 1},
+        {0xFA77, 5085, 1},
+        {0xFA78, 5086, 1},
+        {0xFA79, 5087, 1},
+        {0xFA7A, 5088, 1},
+        {0xFA7B, 5089, 1},
+        {0xFA7C, 5090, 1},
+        {0xFA7D, 5091, 1},
+        {0xFA7E, 5092, 1},
+        {0xFA7F, 5093, 1},
+        {0xFA80, 5094, 1},
+        {0xFA81, 5095, 1},
+        {0xFA82, 5096, 1},
+        {0xFA83, 5097, 1},
+        {0xFA84, 5098, 1},
+        {0xFA85, 5099, 1},
+        {0xFA86, 5100, 1},
+        {0xFA87, 5101, 1},
+        {0xFA88, 5102, 1},
+        {0xFA89, 5103, 1},
+        {0xFA8A, 5104, 1},
+        {0xFA8B, 5105, 1},
+        {0xFA8C, 5106, 1},
+        {0xFA8D, 5107, 1},
+        {0xFA8E, 5108, 1},
+        {0xFA8F, 5109, 1},
+        {0xFA90, 5110, 1},
+        {0xFA91, 5111, 1},
+        {0xFA92, 5112, 1},
+        {0xFA93, 5113, 1},
+        {0xFA94, 5114, 1},
+        {0xFA95, 5115, 1},
+        {0xFA96, 5116, 1},
+        {0xFA97, 5117, 1},
+        {0xFA98, 5118, 1},
+        {0xFA99, 5119, 1},
+        {0xFA9A, 5120, 1},
+        {0xFA9B, 5121, 1},
+        {0xFA9C, 5122, 1},
+        {0xFA9D, 5123, 1},
+        {0xFA9E, 5124, 1},
+        {0xFA9F, 5125, 1},
+        {0xFAA0, 5126, 1},
+        {0xFAA1, 5127, 1},
+        {0xFAA2, 5128, 1},
+        {0xFAA3, 5129, 1},
+        {0xFAA4, 5130, 1},
+        {0xFAA5, 5131, 1},
+        {0xFAA6, 5132, 1},
+        {0xFAA7, 5133, 1},
+        {0xFAA8, 5134, 1},
+        {0xFAA9, 5135, 1},
+        {0xFAAA, 5136, 1},
+        {0xFAAB, 5137, 1},
+        {0xFAAC, 5138, 1},
+        {0xFAAD, 5139, 1},
+        {0xFAAE, 5140, 1},
+        {0xFAAF, 5141, 1},
+        {0xFAB0, 5142, 1},
+        {0xFAB1, 5143, 1},
+        {0xFAB2, 5144, 1},
+        {0xFAB3, 5145, 1},
+        {0xFAB4, 5146, 1},
+        {0xFAB5, 5147, 1},
+        {0xFAB6, 5148, 1},
+        {0xFAB7, 5149, 1},
+        {0xFAB8, 5150, 1},
+        {0xFAB9, 5151, 1},
+        {0xFABA, 5152, 1},
+        {0xFABB, 5153, 1},
+        {0xFABC, 5154, 1},
+        {0xFABD, 5155, 1},
+        {0xFABE, 5156, 1},
+        {0xFABF, 5157, 1},
+        {0xFAC0, 5158, 1},
+        {0xFAC1, 5159, 1},
+        {0xFAC2, 5160, 1},
+        {0xFAC3, 5161, 1},
+        {0xFAC4, 5162, 1},
+        {0xFAC5, 5163, 1},
+        {0xFAC6, 5164, 1},
+        {0xFAC7, 5165, 1},
+        {0xFAC8, 5166, 1},
+        {0xFAC9, 5167, 1},
+        {0xFACA, 5168, 1},
+        {0xFACB, 5169, 1},
+        {0xFACC, 5170, 1},
+        {0xFACD, 5171, 1},
+        {0xFACE, 5172, 1},
+        {0xFACF, 5173, 1},
+        {0xFAD0, 5174, 1},
+        {0xFAD1, 5175, 1},
+        {0xFAD2, 5176, 1},
+        {0xFAD3, 5177, 1},
+        {0xFAD4, 5178, 1},
+        {0xFAD5, 5179, 1},
+        {0xFAD6, 5180, 1},
+        {0xFAD7, 5181, 1},
+        {0xFAD8, 5182, 1},
+        {0xFAD9, 5183, 1},
+        {0xFB1D, 5210, 2},
+        {0xFB1F, 5212, 2},
+        {0xFB2A, 5224, 2},
+        {0xFB2B, 5226, 2},
+        {0xFB2C, 5228, 3},
+        {0xFB2D, 5231, 3},
+        {0xFB2E, 5234, 2},
+        {0xFB2F, 5236, 2},
+        {0xFB30, 5238, 2},
+        {0xFB31, 5240, 2},
+        {0xFB32, 5242, 2},
+        {0xFB33, 5244, 2},
+        {0xFB34, 5246, 2},
+        {0xFB35, 5248, 2},
+        {0xFB36, 5250, 2},
+        {0xFB38, 5252, 2},
+        {0xFB39, 5254, 2},
+        {0xFB3A, 5256, 2},
+        {0xFB3B, 5258, 2},
+        {0xFB3C, 5260, 2},
+        {0xFB3E, 5262, 2},
+        {0xFB40, 5264, 2},
+        {0xFB41, 5266, 2},
+        {0xFB43, 5268, 2},
+        {0xFB44, 5270, 2},
+        {0xFB46, 5272, 2},
+        {0xFB47, 5274, 2},
+        {0xFB48, 5276, 2},
+        {0xFB49, 5278, 2},
+        {0xFB4A, 5280, 2},
+        {0xFB4B, 5282, 2},
+        {0xFB4C, 5284, 2},
+        {0xFB4D, 5286, 2},
+        {0xFB4E, 5288, 2},
+        {0x1109A, 7094, 2},
+        {0x1109C, 7096, 2},
+        {0x110AB, 7098, 2},
+        {0x1112E, 7100, 2},
+        {0x1112F, 7102, 2},
+        {0x1134B, 7104, 2},
+        {0x1134C, 7106, 2},
+        {0x114BB, 7108, 2},
+        {0x114BC, 7110, 2},
+        {0x114BE, 7112, 2},
+        {0x115BA, 7114, 2},
+        {0x115BB, 7116, 2},
+        {0x11938, 7118, 2},
+        {0x1D15E, 7120, 2},
+        {0x1D15F, 7122, 2},
+        {0x1D160, 7124, 3},
+        {0x1D161, 7127, 3},
+        {0x1D162, 7130, 3},
+        {0x1D163, 7133, 3},
+        {0x1D164, 7136, 3},
+        {0x1D1BB, 7139, 2},
+        {0x1D1BC, 7141, 2},
+        {0x1D1BD, 7143, 3},
+        {0x1D1BE, 7146, 3},
+        {0x1D1BF, 7149, 3},
+        {0x1D1C0, 7152, 3},
+        {0x2F800, 8537, 1},
+        {0x2F801, 8538, 1},
+        {0x2F802, 8539, 1},
+        {0x2F803, 8540, 1},
+        {0x2F804, 8541, 1},
+        {0x2F805, 8542, 1},
+        {0x2F806, 8543, 1},
+        {0x2F807, 8544, 1},
+        {0x2F808, 8545, 1},
+        {0x2F809, 8546, 1},
+        {0x2F80A, 8547, 1},
+        {0x2F80B, 8548, 1},
+        {0x2F80C, 8549, 1},
+        {0x2F80D, 8550, 1},
+        {0x2F80E, 8551, 1},
+        {0x2F80F, 8552, 1},
+        {0x2F810, 8553, 1},
+        {0x2F811, 8554, 1},
+        {0x2F812, 8555, 1},
+        {0x2F813, 8556, 1},
+        {0x2F814, 8557, 1},
+        {0x2F815, 8558, 1},
+        {0x2F816, 8559, 1},
+        {0x2F817, 8560, 1},
+        {0x2F818, 8561, 1},
+        {0x2F819, 8562, 1},
+        {0x2F81A, 8563, 1},
+        {0x2F81B, 8564, 1},
+        {0x2F81C, 8565, 1},
+        {0x2F81D, 8566, 1},
+        {0x2F81E, 8567, 1},
+        {0x2F81F, 8568, 1},
+        {0x2F820, 8569, 1},
+        {0x2F821, 8570, 1},
+        {0x2F822, 8571, 1},
+        {0x2F823, 8572, 1},
+        {0x2F824, 8573, 1},
+        {0x2F825, 8574, 1},
+        {0x2F826, 8575, 1},
+        {0x2F827, 8576, 1},
+        {0x2F828, 8577, 1},
+        {0x2F829, 8578, 1},
+        {0x2F82A, 8579, 1},
+        {0x2F82B, 8580, 1},
+        {0x2F82C, 8581, 1},
+        {0x2F82D, 8582, 1},
+        {0x2F82E, 8583, 1},
+        {0x2F82F, 8584, 1},
+        {0x2F830, 8585, 1},
+        {0x2F831, 8586, 1},
+        {0x2F832, 8587, 1},
+        {0x2F833, 8588, 1},
+        {0x2F834, 8589, 1},
+        {0x2F835, 8590, 1},
+        {0x2F836, 8591, 1},
+        {0x2F837, 8592, 1},
+        {0x2F838, 8593, 1},
+        {0x2F839, 8594, 1},
+        {0x2F83A, 8595, 1},
+        {0x2F83B, 8596, 1},
+        {0x2F83C, 8597, 1},
+        {0x2F83D, 8598, 1},
+        {0x2F83E, 8599, 1},
+        {0x2F83F, 8600, 1},
+        {0x2F840, 8601, 1},
+        {0x2F841, 8602, 1},
+        {0x2F842, 8603, 1},
+        {0x2F843, 8604, 1},
+        {0x2F844, 8605, 1},
+        {0x2F845, 8606, 1},
+        {0x2F846, 8607, 1},
+        {0x2F847, 8608, 1},
+        {0x2F848, 8609, 1},
+        {0x2F849, 8610, 1},
+        {0x2F84A, 8611, 1},
+        {0x2F84B, 8612, 1},
+        {0x2F84C, 8613, 1},
+        {0x2F84D, 8614, 1},
+        {0x2F84E, 8615, 1},
+        {0x2F84F, 8616, 1},
+        {0x2F850, 8617, 1},
+        {0x2F851, 8618, 1},
+        {0x2F852, 8619, 1},
+        {0x2F853, 8620, 1},
+        {0x2F854, 8621, 1},
+        {0x2F855, 8622, 1},
+        {0x2F856, 8623, 1},
+        {0x2F857, 8624, 1},
+        {0x2F858, 8625, 1},
+        {0x2F859, 8626, 1},
+        {0x2F85A, 8627, 1},
+        {0x2F85B, 8628, 1},
+        {0x2F85C, 8629, 1},
+        {0x2F85D, 8630, 1},
+        {0x2F85E, 8631, 1},
+        {0x2F85F, 8632, 1},
+        {0x2F860, 8633, 1},
+        {0x2F861, 8634, 1},
+        {0x2F862, 8635, 1},
+        {0x2F863, 8636, 1},
+        {0x2F864, 8637, 1},
+        {0x2F865, 8638, 1},
+        {0x2F866, 8639, 1},
+        {0x2F867, 8640, 1},
+        {0x2F868, 8641, 1},
+        {0x2F869, 8642, 1},
+        {0x2F86A, 8643, 1},
+        {0x2F86B, 8644, 1},
+        {0x2F86C, 8645, 1},
+        {0x2F86D, 8646, 1},
+        {0x2F86E, 8647, 1},
+        {0x2F86F, 8648, 1},
+        {0x2F870, 8649, 1},
+        {0x2F871, 8650, 1},
+        {0x2F872, 8651, 1},
+        {0x2F873, 8652, 1},
+        {0x2F874, 8653, 1},
+        {0x2F875, 8654, 1},
+        {0x2F876, 8655, 1},
+        {0x2F877, 8656, 1},
+        {0x2F878, 8657, 1},
+        {0x2F879, 8658, 1},
+        {0x2F87A, 8659, 1},
+        {0x2F87B, 8660, 1},
+        {0x2F87C, 8661, 1},
+        {0x2F87D, 8662, 1},
+        {0x2F87E, 8663, 1},
+        {0x2F87F, 8664, 1},
+        {0x2F880, 8665, 1},
+        {0x2F881, 8666, 1},
+        {0x2F882, 8667, 1},
+        {0x2F883, 8668, 1},
+        {0x2F884, 8669, 1},
+        {0x2F885, 8670, 1},
+        {0x2F886, 8671, 1},
+        {0x2F887, 8672, 1},
+        {0x2F888, 8673, 1},
+        {0x2F889, 8674, 1},
+        {0x2F88A, 8675, 1},
+        {0x2F88B, 8676, 1},
+        {0x2F88C, 8677, 1},
+        {0x2F88D, 8678, 1},
+        {0x2F88E, 8679, 1},
+        {0x2F88F, 8680, 1},
+        {0x2F890, 8681, 1},
+        {0x2F891, 8682, 1},
+        {0x2F892, 8683, 1},
+        {0x2F893, 8684, 1},
+        {0x2F894, 8685, 1},
+        {0x2F895, 8686, 1},
+        {0x2F896, 8687, 1},
+        {0x2F897, 8688, 1},
+        {0x2F898, 8689, 1},
+        {0x2F899, 8690, 1},
+        {0x2F89A, 8691, 1},
+        {0x2F89B, 8692, 1},
+        {0x2F89C, 8693, 1},
+        {0x2F89D, 8694, 1},
+        {0x2F89E, 8695, 1},
+        {0x2F89F, 8696, 1},
+        {0x2F8A0, 8697, 1},
+        {0x2F8A1, 8698, 1},
+        {0x2F8A2, 8699, 1},
+        {0x2F8A3, 8700, 1},
+        {0x2F8A4, 8701, 1},
+        {0x2F8A5, 8702, 1},
+        {0x2F8A6, 8703, 1},
+        {0x2F8A7, 8704, 1},
+        {0x2F8A8, 8705, 1},
+        {0x2F8A9, 8706, 1},
+        {0x2F8AA, 8707, 1},
+        {0x2F8AB, 8708, 1},
+        {0x2F8AC, 8709, 1},
+        {0x2F8AD, 8710, 1},
+        {0x2F8AE, 8711, 1},
+        {0x2F8AF, 8712, 1},
+        {0x2F8B0, 8713, 1},
+        {0x2F8B1, 8714, 1},
+        {0x2F8B2, 8715, 1},
+        {0x2F8B3, 8716, 1},
+        {0x2F8B4, 8717, 1},
+        {0x2F8B5, 8718, 1},
+        {0x2F8B6, 8719, 1},
+        {0x2F8B7, 8720, 1},
+        {0x2F8B8, 8721, 1},
+        {0x2F8B9, 8722, 1},
+        {0x2F8BA, 8723, 1},
+        {0x2F8BB, 8724, 1},
+        {0x2F8BC, 8725, 1},
+        {0x2F8BD, 8726, 1},
+        {0x2F8BE, 8727, 1},
+        {0x2F8BF, 8728, 1},
+        {0x2F8C0, 8729, 1},
+        {0x2F8C1, 8730, 1},
+        {0x2F8C2, 8731, 1},
+        {0x2F8C3, 8732, 1},
+        {0x2F8C4, 8733, 1},
+        {0x2F8C5, 8734, 1},
+        {0x2F8C6, 8735, 1},
+        {0x2F8C7, 8736, 1},
+        {0x2F8C8, 8737, 1},
+        {0x2F8C9, 8738, 1},
+        {0x2F8CA, 8739, 1},
+        {0x2F8CB, 8740, 1},
+        {0x2F8CC, 8741, 1},
+        {0x2F8CD, 8742, 1},
+        {0x2F8CE, 8743, 1},
+        {0x2F8CF, 8744, 1},
+        {0x2F8D0, 8745, 1},
+        {0x2F8D1, 8746, 1},
+        {0x2F8D2, 8747, 1},
+        {0x2F8D3, 8748, 1},
+        {0x2F8D4, 8749, 1},
+        {0x2F8D5, 8750, 1},
+        {0x2F8D6, 8751, 1},
+        {0x2F8D7, 8752, 1},
+        {0x2F8D8, 8753, 1},
+        {0x2F8D9, 8754, 1},
+        {0x2F8DA, 8755, 1},
+        {0x2F8DB, 8756, 1},
+        {0x2F8DC, 8757, 1},
+        {0x2F8DD, 8758, 1},
+        {0x2F8DE, 8759, 1},
+        {0x2F8DF, 8760, 1},
+        {0x2F8E0, 8761, 1},
+        {0x2F8E1, 8762, 1},
+        {0x2F8E2, 8763, 1},
+        {0x2F8E3, 8764, 1},
+        {0x2F8E4, 8765, 1},
+        {0x2F8E5, 8766, 1},
+        {0x2F8E6, 8767, 1},
+        {0x2F8E7, 8768, 1},
+        {0x2F8E8, 8769, 1},
+        {0x2F8E9, 8770, 1},
+        {0x2F8EA, 8771, 1},
+        {0x2F8EB, 8772, 1},
+        {0x2F8EC, 8773, 1},
+        {0x2F8ED, 8774, 1},
+        {0x2F8EE, 8775, 1},
+        {0x2F8EF, 8776, 1},
+        {0x2F8F0, 8777, 1},
+        {0x2F8F1, 8778, 1},
+        {0x2F8F2, 8779, 1},
+        {0x2F8F3, 8780, 1},
+        {0x2F8F4, 8781, 1},
+        {0x2F8F5, 8782, 1},
+        {0x2F8F6, 8783, 1},
+        {0x2F8F7, 8784, 1},
+        {0x2F8F8, 8785, 1},
+        {0x2F8F9, 8786, 1},
+        {0x2F8FA, 8787, 1},
+        {0x2F8FB, 8788, 1},
+        {0x2F8FC, 8789, 1},
+        {0x2F8FD, 8790, 1},
+        {0x2F8FE, 8791, 1},
+        {0x2F8FF, 8792, 1},
+        {0x2F900, 8793, 1},
+        {0x2F901, 8794, 1},
+        {0x2F902, 8795, 1},
+        {0x2F903, 8796, 1},
+        {0x2F904, 8797, 1},
+        {0x2F905, 8798, 1},
+        {0x2F906, 8799, 1},
+        {0x2F907, 8800, 1},
+        {0x2F908, 8801, 1},
+        {0x2F909, 8802, 1},
+        {0x2F90A, 8803, 1},
+        {0x2F90B, 8804, 1},
+        {0x2F90C, 8805, 1},
+        {0x2F90D, 8806, 1},
+        {0x2F90E, 8807, 1},
+        {0x2F90F, 8808, 1},
+        {0x2F910, 8809, 1},
+        {0x2F911, 8810, 1},
+        {0x2F912, 8811, 1},
+        {0x2F913, 8812, 1},
+        {0x2F914, 8813, 1},
+        {0x2F915, 8814, 1},
+        {0x2F916, 8815, 1},
+        {0x2F917, 8816, 1},
+        {0x2F918, 8817, 1},
+        {0x2F919, 8818, 1},
+        {0x2F91A, 8819, 1},
+        {0x2F91B, 8820, 1},
+        {0x2F91C, 8821, 1},
+        {0x2F91D, 8822, 1},
+        {0x2F91E, 8823, 1},
+        {0x2F91F, 8824, 1},
+        {0x2F920, 8825, 1},
+        {0x2F921, 8826, 1},
+        {0x2F922, 8827, 1},
+        {0x2F923, 8828, 1},
+        {0x2F924, 8829, 1},
+        {0x2F925, 8830, 1},
+        {0x2F926, 8831, 1},
+        {0x2F927, 8832, 1},
+        {0x2F928, 8833, 1},
+        {0x2F929, 8834, 1},
+        {0x2F92A, 8835, 1},
+        {0x2F92B, 8836, 1},
+        {0x2F92C, 8837, 1},
+        {0x2F92D, 8838, 1},
+        {0x2F92E, 8839, 1},
+        {0x2F92F, 8840, 1},
+        {0x2F930, 8841, 1},
+        {0x2F931, 8842, 1},
+        {0x2F932, 8843, 1},
+        {0x2F933, 8844, 1},
+        {0x2F934, 8845, 1},
+        {0x2F935, 8846, 1},
+        {0x2F936, 8847, 1},
+        {0x2F937, 8848, 1},
+        {0x2F938, 8849, 1},
+        {0x2F939, 8850, 1},
+        {0x2F93A, 8851, 1},
+        {0x2F93B, 8852, 1},
+        {0x2F93C, 8853, 1},
+        {0x2F93D, 8854, 1},
+        {0x2F93E, 8855, 1},
+        {0x2F93F, 8856, 1},
+        {0x2F940, 8857, 1},
+        {0x2F941, 8858, 1},
+        {0x2F942, 8859, 1},
+        {0x2F943, 8860, 1},
+        {0x2F944, 8861, 1},
+        {0x2F945, 8862, 1},
+        {0x2F946, 8863, 1},
+        {0x2F947, 8864, 1},
+        {0x2F948, 8865, 1},
+        {0x2F949, 8866, 1},
+        {0x2F94A, 8867, 1},
+        {0x2F94B, 8868, 1},
+        {0x2F94C, 8869, 1},
+        {0x2F94D, 8870, 1},
+        {0x2F94E, 8871, 1},
+        {0x2F94F, 8872, 1},
+        {0x2F950, 8873, 1},
+        {0x2F951, 8874, 1},
+        {0x2F952, 8875, 1},
+        {0x2F953, 8876, 1},
+        {0x2F954, 8877, 1},
+        {0x2F955, 8878, 1},
+        {0x2F956, 8879, 1},
+        {0x2F957, 8880, 1},
+        {0x2F958, 8881, 1},
+        {0x2F959, 8882, 1},
+        {0x2F95A, 8883, 1},
+        {0x2F95B, 8884, 1},
+        {0x2F95C, 8885, 1},
+        {0x2F95D, 8886, 1},
+        {0x2F95E, 8887, 1},
+        {0x2F95F, 8888, 1},
+        {0x2F960, 8889, 1},
+        {0x2F961, 8890, 1},
+        {0x2F962, 8891, 1},
+        {0x2F963, 8892, 1},
+        {0x2F964, 8893, 1},
+        {0x2F965, 8894, 1},
+        {0x2F966, 8895, 1},
+        {0x2F967, 8896, 1},
+        {0x2F968, 8897, 1},
+        {0x2F969, 8898, 1},
+        {0x2F96A, 8899, 1},
+        {0x2F96B, 8900, 1},
+        {0x2F96C, 8901, 1},
+        {0x2F96D, 8902, 1},
+        {0x2F96E, 8903, 1},
+        {0x2F96F, 8904, 1},
+        {0x2F970, 8905, 1},
+        {0x2F971, 8906, 1},
+        {0x2F972, 8907, 1},
+        {0x2F973, 8908, 1},
+        {0x2F974, 8909, 1},
+        {0x2F975, 8910, 1},
+        {0x2F976, 8911, 1},
+        {0x2F977, 8912, 1},
+        {0x2F978, 8913, 1},
+        {0x2F979, 8914, 1},
+        {0x2F97A, 8915, 1},
+        {0x2F97B, 8916, 1},
+        {0x2F97C, 8917, 1},
+        {0x2F97D, 8918, 1},
+        {0x2F97E, 8919, 1},
+        {0x2F97F, 8920, 1},
+        {0x2F980, 8921, 1},
+        {0x2F981, 8922, 1},
+        {0x2F982, 8923, 1},
+        {0x2F983, 8924, 1},
+        {0x2F984, 8925, 1},
+        {0x2F985, 8926, 1},
+        {0x2F986, 8927, 1},
+        {0x2F987, 8928, 1},
+        {0x2F988, 8929, 1},
+        {0x2F989, 8930, 1},
+        {0x2F98A, 8931, 1},
+        {0x2F98B, 8932, 1},
+        {0x2F98C, 8933, 1},
+        {0x2F98D, 8934, 1},
+        {0x2F98E, 8935, 1},
+        {0x2F98F, 8936, 1},
+        {0x2F990, 8937, 1},
+        {0x2F991, 8938, 1},
+        {0x2F992, 8939, 1},
+        {0x2F993, 8940, 1},
+        {0x2F994, 8941, 1},
+        {0x2F995, 8942, 1},
+        {0x2F996, 8943, 1},
+        {0x2F997, 8944, 1},
+        {0x2F998, 8945, 1},
+        {0x2F999, 8946, 1},
+        {0x2F99A, 8947, 1},
+        {0x2F99B, 8948, 1},
+        {0x2F99C, 8949, 1},
+        {0x2F99D, 8950, 1},
+        {0x2F99E, 8951, 1},
+        {0x2F99F, 8952, 1},
+        {0x2F9A0, 8953, 1},
+        {0x2F9A1, 8954, 1},
+        {0x2F9A2, 8955, 1},
+        {0x2F9A3, 8956, 1},
+        {0x2F9A4, 8957, 1},
+        {0x2F9A5, 8958, 1},
+        {0x2F9A6, 8959, 1},
+        {0x2F9A7, 8960, 1},
+        {0x2F9A8, 8961, 1},
+        {0x2F9A9, 8962, 1},
+        {0x2F9AA, 8963, 1},
+        {0x2F9AB, 8964, 1},
+        {0x2F9AC, 8965, 1},
+        {0x2F9AD, 8966, 1},
+        {0x2F9AE, 8967, 1},
+        {0x2F9AF, 8968, 1},
+        {0x2F9B0, 8969, 1},
+        {0x2F9B1, 8970, 1},
+        {0x2F9B2, 8971, 1},
+        {0x2F9B3, 8972, 1},
+        {0x2F9B4, 8973, 1},
+        {0x2F9B5, 8974, 1},
+        {0x2F9B6, 8975, 1},
+        {0x2F9B7, 8976, 1},
+        {0x2F9B8, 8977, 1},
+        {0x2F9B9, 8978, 1},
+        {0x2F9BA, 8979, 1},
+        {0x2F9BB, 8980, 1},
+        {0x2F9BC, 8981, 1},
+        {0x2F9BD, 8982, 1},
+        {0x2F9BE, 8983, 1},
+        {0x2F9BF, 8984, 1},
+        {0x2F9C0, 8985, 1},
+        {0x2F9C1, 8986, 1},
+        {0x2F9C2, 8987, 1},
+        {0x2F9C3, 8988, 1},
+        {0x2F9C4, 8989, 1},
+        {0x2F9C5, 8990, 1},
+        {0x2F9C6, 8991, 1},
+        {0x2F9C7, 8992, 1},
+        {0x2F9C8, 8993, 1},
+        {0x2F9C9, 8994, 1},
+        {0x2F9CA, 8995, 1},
+        {0x2F9CB, 8996, 1},
+        {0x2F9CC, 8997, 1},
+        {0x2F9CD, 8998, 1},
+        {0x2F9CE, 8999, 1},
+        {0x2F9CF, 9000, 1},
+        {0x2F9D0, 9001, 1},
+        {0x2F9D1, 9002, 1},
+        {0x2F9D2, 9003, 1},
+        {0x2F9D3, 9004, 1},
+        {0x2F9D4, 9005, 1},
+        {0x2F9D5, 9006, 1},
+        {0x2F9D6, 9007, 1},
+        {0x2F9D7, 9008, 1},
+        {0x2F9D8, 9009, 1},
+        {0x2F9D9, 9010, 1},
+        {0x2F9DA, 9011, 1},
+        {0x2F9DB, 9012, 1},
+        {0x2F9DC, 9013, 1},
+        {0x2F9DD, 9014, 1},
+        {0x2F9DE, 9015, 1},
+        {0x2F9DF, 9016, 1},
+        {0x2F9E0, 9017, 1},
+        {0x2F9E1, 9018, 1},
+        {0x2F9E2, 9019, 1},
+        {0x2F9E3, 9020, 1},
+        {0x2F9E4, 9021, 1},
+        {0x2F9E5, 9022, 1},
+        {0x2F9E6, 9023, 1},
+        {0x2F9E7, 9024, 1},
+        {0x2F9E8, 9025, 1},
+        {0x2F9E9, 9026, 1},
+        {0x2F9EA, 9027, 1},
+        {0x2F9EB, 9028, 1},
+        {0x2F9EC, 9029, 1},
+        {0x2F9ED, 9030, 1},
+        {0x2F9EE, 9031, 1},
+        {0x2F9EF, 9032, 1},
+        {0x2F9F0, 9033, 1},
+        {0x2F9F1, 9034, 1},
+        {0x2F9F2, 9035, 1},
+        {0x2F9F3, 9036, 1},
+        {0x2F9F4, 9037, 1},
+        {0x2F9F5, 9038, 1},
+        {0x2F9F6, 9039, 1},
+        {0x2F9F7, 9040, 1},
+        {0x2F9F8, 9041, 1},
+        {0x2F9F9, 9042, 1},
+        {0x2F9FA, 9043, 1},
+        {0x2F9FB, 9044, 1},
+        {0x2F9FC, 9045, 1},
+        {0x2F9FD, 9046, 1},
+        {0x2F9FE, 9047, 1},
+        {0x2F9FF, 9048, 1},
+        {0x2FA00, 9049, 1},
+        {0x2FA01, 9050, 1},
+        {0x2FA02, 9051, 1},
+        {0x2FA03, 9052, 1},
+        {0x2FA04, 9053, 1},
+        {0x2FA05, 9054, 1},
+        {0x2FA06, 9055, 1},
+        {0x2FA07, 9056, 1},
+        {0x2FA08, 9057, 1},
+        {0x2FA09, 9058, 1},
+        {0x2FA0A, 9059, 1},
+        {0x2FA0B, 9060, 1},
+        {0x2FA0C, 9061, 1},
+        {0x2FA0D, 9062, 1},
+        {0x2FA0E, 9063, 1},
+        {0x2FA0F, 9064, 1},
+        {0x2FA10, 9065, 1},
+        {0x2FA11, 9066, 1},
+        {0x2FA12, 9067, 1},
+        {0x2FA13, 9068, 1},
+        {0x2FA14, 9069, 1},
+        {0x2FA15, 9070, 1},
+        {0x2FA16, 9071, 1},
+        {0x2FA17, 9072, 1},
+        {0x2FA18, 9073, 1},
+        {0x2FA19, 9074, 1},
+        {0x2FA1A, 9075, 1},
+        {0x2FA1B, 9076, 1},
+        {0x2FA1C, 9077, 1},
+        {0x2FA1D, 9078, 1}
+};
+
+static const utf8_decomposition utf8_compat_decompositions[3750] = {
+        {0x00A0, 0, 1},
+        {0x00A8, 1, 2},
+        {0x00AA, 3, 1},
+        {0x00AF, 4, 2},
+        {0x00B2, 6, 1},
+        {0x00B3, 7, 1},
+        {0x00B4, 8, 2},
+        {0x00B5, 10, 1},
+        {0x00B8, 11, 2},
+        {0x00B9, 13, 1},
+        {0x00BA, 14, 1},
+        {0x00BC, 15, 3},
+        {0x00BD, 18, 3},
+        {0x00BE, 21, 3},
+        {0x0132, 220, 2},
+        {0x0133, 222, 2},
+        {0x013F, 244, 2},
+        {0x0140, 246, 2},
+        {0x0149, 260, 2},
+        {0x017F, 356, 1},
+        {0x01C4, 365, 3},
+        {0x01C5, 368, 3},
+        {0x01C6, 371, 3},
+        {0x01C7, 374, 2},
+        {0x01C8, 376, 2},
+        {0x01C9, 378, 2},
+        {0x01CA, 380, 2},
+        {0x01CB, 382, 2},
+        {0x01CC, 384, 2},
+        {0x01F1, 466, 2},
+        {0x01F2, 468, 2},
+        {0x01F3, 470, 2},
+        {0x02B0, 588, 1},
+        {0x02B1, 589, 1},
+        {0x02B2, 590, 1},
+        {0x02B3, 591, 1},
+        {0x02B4, 592, 1},
+        {0x02B5, 593, 1},
+        {0x02B6, 594, 1},
+        {0x02B7, 595, 1},
+        {0x02B8, 596, 1},
+        {0x02D8, 597, 2},
+        {0x02D9, 599, 2},
+        {0x02DA, 601, 2},
+        {0x02DB, 603, 2},
+        {0x02DC, 605, 2},
+        {0x02DD, 607, 2},
+        {0x02E0, 609, 1},
+        {0x02E1, 610, 1},
+        {0x02E2, 611, 1},
+        {0x02E3, 612, 1},
+        {0x02E4, 613, 1},
+        {0x037A, 620, 2},
+        {0x0384, 623, 2},
+        {0x0385, 627, 3},
+        {0x03D0, 673, 1},
+        {0x03D1, 674, 1},
+        {0x03D2, 675, 1},
+        {0x03D3, 678, 2},
+        {0x03D4, 682, 2},
+        {0x03D5, 684, 1},
+        {0x03D6, 685, 1},
+        {0x03F0, 686, 1},
+        {0x03F1, 687, 1},
+        {0x03F2, 688, 1},
+        {0x03F4, 689, 1},
+        {0x03F5, 690, 1},
+        {0x03F9, 691, 1},
+        {0x0587, 796, 2},
+        {0x0675, 808, 2},
+        {0x0676, 810, 2},
+        {0x0677, 812, 2},
+        {0x0678, 814, 2},
+        {0x0E33, 912, 2},
+        {0x0EB3, 914, 2},
+        {0x0EDC, 916, 2},
+        {0x0EDD, 918, 2},
+        {0x0F0C, 920, 1},
+        {0x0F77, 939, 3},
+        {0x0F79, 944, 3},
+        {0x10FC, 963, 1},
+        {0x1D2C, 986, 1},
+        {0x1D2D, 987, 1},
+        {0x1D2E, 988, 1},
+        {0x1D30, 989, 1},
+        {0x1D31, 990, 1},
+        {0x1D32, 991, 1},
+        {0x1D33, 992, 1},
+        {0x1D34, 993, 1},
+        {0x1D35, 994, 1},
+        {0x1D36, 995, 1},
+        {0x1D37, 996, 1},
+        {0x1D38, 997, 1},
+        {0x1D39, 998, 1},
+        {0x1D3A, 999, 1},
+        {0x1D3C, 1000, 1},
+        {0x1D3D, 1001, 1},
+        {0x1D3E, 1002, 1},
+        {0x1D3F, 1003, 1},
+        {0x1D40, 1004, 1},
+        {0x1D41, 1005, 1},
+        {0x1D42, 1006, 1},
+        {0x1D43, 1007, 1},
+        {0x1D44, 1008, 1},
+        {0x1D45, 1009, 1},
+        {0x1D46, 1010, 1},
+        {0x1D47, 1011, 1},
+        {0x1D48, 1012, 1},
+        {0x1D49, 1013, 1},
+        {0x1D4A, 1014, 1},
+        {0x1D4B, 1015, 1},
+        {0x1D4C, 1016, 1},
+        {0x1D4D, 1017, 1},
+        {0x1D4F, 1018, 1},
+        {0x1D50, 1019, 1},
+        {0x1D51, 1020, 1},
+        {0x1D52, 1021, 1},
+        {0x1D53, 1022, 1},
+        {0x1D54, 1023, 1},
+        {0x1D55, 1024, 1},
+        {0x1D56, 1025, 1},
+        {0x1D57, 1026, 1},
+        {0x1D58, 1027, 1},
+        {0x1D59, 1028, 1},
+        {0x1D5A, 1029, 1},
+        {0x1D5B, 1030, 1},
+        {0x1D5C, 1031, 1},
+        {0x1D5D, 1032, 1},
+        {0x1D5E, 1033, 1},
+        {0x1D5F, 1034, 1},
+        {0x1D60, 1035, 1},
+        {0x1D61, 1036, 1},
+        {0x1D62, 1037, 1},
+        {0x1D63, 1038, 1},
+        {0x1D64, 1039, 1},
+        {0x1D65, 1040, 1},
+        {0x1D66, 1041, 1},
+        {0x1D67, 1042, 1},
+        {0x1D68, 1043, 1},
+        {0x1D69, 1044, 1},
+        {0x1D6A, 1045, 1},
+        {0x1D78, 1046, 1},
+        {0x1D9B, 1047, 1},
+        {0x1D9C, 1048, 1},
+        {0x1D9D, 1049, 1},
+        {0x1D9E, 1050, 1},
+        {0x1D9F, 1051, 1},
+        {0x1DA0, 1052, 1},
+        {0x1DA1, 1053, 1},
+        {0x1DA2, 1054, 1},
+        {0x1DA3, 1055, 1},
+        {0x1DA4, 1056, 1},
+        {0x1DA5, 1057, 1},
+        {0x1DA6, 1058, 1},
+        {0x1DA7, 1059, 1},
+        {0x1DA8, 1060, 1},
+        {0x1DA9, 1061, 1},
+        {0x1DAA, 1062, 1},
+        {0x1DAB, 1063, 1},
+        {0x1DAC, 1064, 1},
+        {0x1DAD, 1065, 1},
+        {0x1DAE, 1066, 1},
+        {0x1DAF, 1067, 1},
+        {0x1DB0, 1068, 1},
+        {0x1DB1, 1069, 1},
+        {0x1DB2, 1070, 1},
+        {0x1DB3, 1071, 1},
+        {0x1DB4, 1072, 1},
+        {0x1DB5, 1073, 1},
+        {0x1DB6, 1074, 1},
+        {0x1DB7, 1075, 1},
+        {0x1DB8, 1076, 1},
+        {0x1DB9, 1077, 1},
+        {0x1DBA, 1078, 1},
+        {0x1DBB, 1079, 1},
+        {0x1DBC, 1080, 1},
+        {0x1DBD, 1081, 1},
+        {0x1DBE, 1082, 1},
+        {0x1DBF, 1083, 1},
+        {0x1E9A, 1424, 2},
+        {0x1E9B, 1428, 2},
+        {0x1FBD, 2178, 2},
+        {0x1FBF, 2181, 2},
+        {0x1FC0, 2183, 2},
+        {0x1FC1, 2187, 3},
+        {0x1FCD, 2215, 3},
+        {0x1FCE, 2220, 3},
+        {0x1FCF, 2225, 3},
+        {0x1FDD, 2253, 3},
+        {0x1FDE, 2258, 3},
+        {0x1FDF, 2263, 3},
+        {0x1FED, 2297, 3},
+        {0x1FEE, 2302, 3},
+        {0x1FFD, 2330, 2},
+        {0x1FFE, 2332, 2},
+        {0x2000, 2335, 1},
+        {0x2001, 2337, 1},
+        {0x2002, 2338, 1},
+        {0x2003, 2339, 1},
+        {0x2004, 2340, 1},
+        {0x2005, 2341, 1},
+        {0x2006, 2342, 1},
+        {0x2007, 2343, 1},
+        {0x2008, 2344, 1},
+        {0x2009, 2345, 1},
+        {0x200A, 2346, 1},
+        {0x2011, 2347, 1},
+        {0x2017, 2348, 2},
+        {0x2024, 2350, 1},
+        {0x2025, 2351, 2},
+        {0x2026, 2353, 3},
+        {0x202F, 2356, 1},
+        {0x2033, 2357, 2},
+        {0x2034, 2359, 3},
+        {0x2036, 2362, 2},
+        {0x2037, 2364, 3},
+        {0x203C, 2367, 2},
+        {0x203E, 2369, 2},
+        {0x2047, 2371, 2},
+        {0x2048, 2373, 2},
+        {0x2049, 2375, 2},
+        {0x2057, 2377, 4},
+        {0x205F, 2381, 1},
+        {0x2070, 2382, 1},
+        {0x2071, 2383, 1},
+        {0x2074, 2384, 1},
+        {0x2075, 2385, 1},
+        {0x2076, 2386, 1},
+        {0x2077, 2387, 1},
+        {0x2078, 2388, 1},
+        {0x2079, 2389, 1},
+        {0x207A, 2390, 1},
+        {0x207B, 2391, 1},
+        {0x207C, 2392, 1},
+        {0x207D, 2393, 1},
+        {0x207E, 2394, 1},
+        {0x207F, 2395, 1},
+        {0x2080, 2396, 1},
+        {0x2081, 2397, 1},
+        {0x2082, 2398, 1},
+        {0x2083, 2399, 1},
+        {0x2084, 2400, 1},
+        {0x2085, 2401, 1},
+        {0x2086, 2402, 1},
+        {0x2087, 2403, 1},
+        {0x2088, 2404, 1},
+        {0x2089, 2405, 1},
+        {0x208A, 2406, 1},
+        {0x208B, 2407, 1},
+        {0x208C, 2408, 1},
+        {0x208D, 2409, 1},
+        {0x208E, 2410, 1},
+        {0x2090, 2411, 1},
+        {0x2091, 2412, 1},
+        {0x2092, 2413, 1},
+        {0x2093, 2414, 1},
+        {0x2094, 2415, 1},
+        {0x2095, 2416, 1},
+        {0x2096, 2417, 1},
+        {0x2097, 2418, 1},
+        {0x2098, 2419, 1},
+        {0x2099, 2420, 1},
+        {0x209A, 2421, 1},
+        {0x209B, 2422, 1},
+        {0x209C, 2423, 1},
+        {0x20A8, 2424, 2},
+        {0x2100, 2426, 3},
+        {0x2101, 2429, 3},
+        {0x2102, 2432, 1},
+        {0x2103, 2433, 2},
+        {0x2105, 2435, 3},
+        {0x2106, 2438, 3},
+        {0x2107, 2441, 1},
+        {0x2109, 2442, 2},
+        {0x210A, 2444, 1},
+        {0x210B, 2445, 1},
+        {0x210C, 2446, 1},
+        {0x210D, 2447, 1},
+        {0x210E, 2448, 1},
+        {0x210F, 2449, 1},
+        {0x2110, 2450, 1},
+        {0x2111, 2451, 1},
+        {0x2112, 2452, 1},
+        {0x2113, 2453, 1},
+        {0x2115, 2454, 1},
+        {0x2116, 2455, 2},
+        {0x2119, 2457, 1},
+        {0x211A, 2458, 1},
+        {0x211B, 2459, 1},
+        {0x211C, 2460, 1},
+        {0x211D, 2461, 1},
+        {0x2120, 2462, 2},
+        {0x2121, 2464, 3},
+        {0x2122, 2467, 2},
+        {0x2124, 2469, 1},
+        {0x2128, 2471, 1},
+        {0x212C, 2475, 1},
+        {0x212D, 2476, 1},
+        {0x212F, 2477, 1},
+        {0x2130, 2478, 1},
+        {0x2131, 2479, 1},
+        {0x2133, 2480, 1},
+        {0x2134, 2481, 1},
+        {0x2135, 2482, 1},
+        {0x2136, 2483, 1},
+        {0x2137, 2484, 1},
+        {0x2138, 2485, 1},
+        {0x2139, 2486, 1},
+        {0x213B, 2487, 3},
+        {0x213C, 2490, 1},
+        {0x213D, 2491, 1},
+        {0x213E, 2492, 1},
+        {0x213F, 2493, 1},
+        {0x2140, 2494, 1},
+        {0x2145, 2495, 1},
+        {0x2146, 2496, 1},
+        {0x2147, 2497, 1},
+        {0x2148, 2498, 1},
+        {0x2149, 2499, 1},
+        {0x2150, 2500, 3},
+        {0x2151, 2503, 3},
+        {0x2152, 2506, 4},
+        {0x2153, 2510, 3},
+        {0x2154, 2513, 3},
+        {0x2155, 2516, 3},
+        {0x2156, 2519, 3},
+        {0x2157, 2522, 3},
+        {0x2158, 2525, 3},
+        {0x2159, 2528, 3},
+        {0x215A, 2531, 3},
+        {0x215B, 2534, 3},
+        {0x215C, 2537, 3},
+        {0x215D, 2540, 3},
+        {0x215E, 2543, 3},
+        {0x215F, 2546, 2},
+        {0x2160, 2548, 1},
+        {0x2161, 2549, 2},
+        {0x2162, 2551, 3},
+        {0x2163, 2554, 2},
+        {0x2164, 2556, 1},
+        {0x2165, 2557, 2},
+        {0x2166, 2559, 3},
+        {0x2167, 2562, 4},
+        {0x2168, 2566, 2},
+        {0x2169, 2568, 1},
+        {0x216A, 2569, 2},
+        {0x216B, 2571, 3},
+        {0x216C, 2574, 1},
+        {0x216D, 2575, 1},
+        {0x216E, 2576, 1},
+        {0x216F, 2577, 1},
+        {0x2170, 2578, 1},
+        {0x2171, 2579, 2},
+        {0x2172, 2581, 3},
+        {0x2173, 2584, 2},
+        {0x2174, 2586, 1},
+        {0x2175, 2587, 2},
+        {0x2176, 2589, 3},
+        {0x2177, 2592, 4},
+        {0x2178, 2596, 2},
+        {0x2179, 2598, 1},
+        {0x217A, 2599, 2},
+        {0x217B, 2601, 3},
+        {0x217C, 2604, 1},
+        {0x217D, 2605, 1},
+        {0x217E, 2606, 1},
+        {0x217F, 2607, 1},
+        {0x2189, 2608, 3},
+        {0x222C, 2633, 2},
+        {0x222D, 2635, 3},
+        {0x222F, 2638, 2},
+        {0x2230, 2640, 3},
+        {0x2460, 2711, 1},
+        {0x2461, 2712, 1},
+        {0x2462, 2713, 1},
+        {0x2463, 2714, 1},
+        {0x2464, 2715, 1},
+        {0x2465, 2716, 1},
+        {0x2466, 2717, 1},
+        {0x2467, 2718, 1},
+        {0x2468, 2719, 1},
+        {0x2469, 2720, 2},
+        {0x246A, 2722, 2},
+        {0x246B, 2724, 2},
+        {0x246C, 2726, 2},
+        {0x246D, 2728, 2},
+        {0x246E, 2730, 2},
+        {0x246F, 2732, 2},
+        {0x2470, 2734, 2},
+        {0x2471, 2736, 2},
+        {0x2472, 2738, 2},
+        {0x2473, 2740, 2},
+        {0x2474, 2742, 3},
+        {0x2475, 2745, 3},
+        {0x2476, 2748, 3},
+        {0x2477, 2751, 3},
+        {0x2478, 2754, 3},
+        {0x2479, 2757, 3},
+        {0x247A, 2760, 3},
+        {0x247B, 2763, 3},
+        {0x247C, 2766, 3},
+        {0x247D, 2769, 4},
+        {0x247E, 2773, 4},
+        {0x247F, 2777, 4},
+        {0x2480, 2781, 4},
+        {0x2481, 2785, 4},
+        {0x2482, 2789, 4},
+        {0x2483, 2793, 4},
+        {0x2484, 2797, 4},
+        {0x2485, 2801, 4},
+        {0x2486, 2805, 4},
+        {0x2487, 2809, 4},
+        {0x2488, 2813, 2},
+        {0x2489, 2815, 2},
+        {0x248A, 2817, 2},
+        {0x248B, 2819, 2},
+        {0x248C, 2821, 2},
+        {0x248D, 2823, 2},
+        {0x248E, 2825, 2},
+        {0x248F, 2827, 2},
+        {0x2490, 2829, 2},
+        {0x2491, 2831, 3},
+        {0x2492, 2834, 3},
+        {0x2493, 2837, 3},
+        {0x2494, 2840, 3},
+        {0x2495, 2843, 3},
+        {0x2496, 2846, 3},
+        {0x2497, 2849, 3},
+        {0x2498, 2852, 3},
+        {0x2499, 2855, 3},
+        {0x249A, 2858, 3},
+        {0x249B, 2861, 3},
+        {0x249C, 2864, 3},
+        {0x249D, 2867, 3},
+        {0x249E, 2870, 3},
+        {0x249F, 2873, 3},
+        {0x24A0, 2876, 3},
+        {0x24A1, 2879, 3},
+        {0x24A2, 2882, 3},
+        {0x24A3, 2885, 3},
+        {0x24A4, 2888, 3},
+        {0x24A5, 2891, 3},
+        {0x24A6, 2894, 3},
+        {0x24A7, 2897, 3},
+        {0x24A8, 2900, 3},
+        {0x24A9, 2903, 3},
+        {0x24AA, 2906, 3},
+        {0x24AB, 2909, 3},
+        {0x24AC, 2912, 3},
+        {0x24AD, 2915, 3},
+        {0x24AE, 2918, 3},
+        {0x24AF, 2921, 3},
+        {0x24B0, 2924, 3},
+        {0x24B1, 2927, 3},
+        {0x24B2, 2930, 3},
+        {0x24B3, 2933, 3},
+        {0x24B4, 2936, 3},
+        {0x24B5, 2939, 3},
+        {0x24B6, 2942, 1},
+        {0x24B7, 2943, 1},
+        {0x24B8, 2944, 1},
+        {0x24B9, 2945, 1},
+        {0x24BA, 2946, 1},
+        {0x24BB, 2947, 1},
+        {0x24BC, 2948, 1},
+        {0x24BD, 2949, 1},
+        {0x24BE, 2950, 1},
+        {0x24BF, 2951, 1},
+        {0x24C0, 2952, 1},
+        {0x24C1, 2953, 1},
+        {0x24C2, 2954, 1},
+        {0x24C3, 2955, 1},
+        {0x24C4, 2956, 1},
+        {0x24C5, 2957, 1},
+        {0x24C6, 2958, 1},
+        {0x24C7, 2959, 1},
+        {0x24C8, 2960, 1},
+        {0x24C9, 2961, 1},
+        {0x24CA, 2962, 1},
+        {0x24CB, 2963, 1},
+        {0x24CC, 2964, 1},
+        {0x24CD, 2965, 1},
+        {0x24CE, 2966, 1},
+        {0x24CF, 2967, 1},
+        {0x24D0, 2968, 1},
+        {0x24D1, 2969, 1},
+        {0x24D2, 2970, 1},
+        {0x24D3, 2971, 1},
+        {0x24D4, 2972, 1},
+        {0x24D5, 2973, 1},
+        {0x24D6, 2974, 1},
+        {0x24D7, 2975, 1},
+        {0x24D8, 2976, 1},
+        {0x24D9, 2977, 1},
+        {0x24DA, 2978, 1},
+        {0x24DB, 2979, 1},
+        {0x24DC, 2980, 1},
+        {0x24DD, 2981, 1},
+        {0x24DE, 2982, 1},
+        {0x24DF, 2983, 1},
+        {0x24E0, 2984, 1},
+        {0x24E1, 2985, 1},
+        {0x24E2, 2986, 1},
+        {0x24E3, 2987, 1},
+        {0x24E4, 2988, 1},
+        {0x24E5, 2989, 1},
+        {0x24E6, 2990, 1},
+        {0x24E7, 2991, 1},
+        {0x24E8, 2992, 1},
+        {0x24E9, 2993, 1},
+        {0x24EA, 2994, 1},
+        {0x2A0C, 2995, 4},
+        {0x2A74, 2999, 3},
+        {0x2A75, 3002, 2},
+        {0x2A76, 3004, 3},
+        {0x2C7C, 3009, 1},
+        {0x2C7D, 3010, 1},
+        {0x2D6F, 3011, 1},
+        {0x2E9F, 3012, 1},
+        {0x2EF3, 3013, 1},
+        {0x2F00, 3014, 1},
+        {0x2F01, 3015, 1},
+        {0x2F02, 3016, 1},
+        {0x2F03, 3017, 1},
+        {0x2F04, 3018, 1},
+        {0x2F05, 3019, 1},
+        {0x2F06, 3020, 1},
+        {0x2F07, 3021, 1},
+        {0x2F08, 3022, 1},
+        {0x2F09, 3023, 1},
+        {0x2F0A, 3024, 1},
+        {0x2F0B, 3025, 1},
+        {0x2F0C, 3026, 1},
+        {0x2F0D, 3027, 1},
+        {0x2F0E, 3028, 1},
+        {0x2F0F, 3029, 1},
+        {0x2F10, 3030, 1},
+        {0x2F11, 3031, 1},
+        {0x2F12, 3032, 1},
+        {0x2F13, 3033, 1},
+        {0x2F14, 3034, 1},
+        {0x2F15, 3035, 1},
+        {0x2F16, 3036, 1},
+        {0x2F17, 3037, 1},
+        {0x2F18, 3038, 1},
+        {0x2F19, 3039, 1},
+        {0x2F1A, 3040, 1},
+        {0x2F1B, 3041, 1},
+        {0x2F1C, 3042, 1},
+        {0x2F1D, 3043, 1},
+        {0x2F1E, 3044, 1},
+        {0x2F1F, 3045, 1},
+        {0x2F20, 3046, 1},
+        {0x2F21, 3047, 1},
+        {0x2F22, 3048, 1},
+        {0x2F23, 3049, 1},
+        {0x2F24, 3050, 1},
+        {0x2F25, 3051, 1},
+        {0x2F26, 3052, 1},
+        {0x2F27, 3053, 1},
+        {0x2F28, 3054, 1},
+        {0x2F29, 3055, 1},
+        {0x2F2A, 3056, 1},
+        {0x2F2B, 3057, 1},
+        {0x2F2C, 3058, 1},
+        {0x2F2D, 3059, 1},
+        {0x2F2E, 3060, 1},
+        {0x2F2F, 3061, 1},
+        {0x2F30, 3062, 1},
+        {0x2F31, 3063, 1},
+        {0x2F32, 3064, 1},
+        {0x2F33, 3065, 1},
+        {0x2F34, 3066, 1},
+        {0x2F35, 3067, 1},
+        {0x2F36, 3068, 1},
+        {0x2F37, 3069, 1},
+        {0x2F38, 3070, 1},
+        {0x2F39, 3071, 1},
+        {0x2F3A, 3072, 1},
+        {0x2F3B, 3073, 1},
+        {0x2F3C, 3074, 1},
+        {0x2F3D, 3075, 1},
+        {0x2F3E, 3076, 1},
+        {0x2F3F, 3077, 1},
+        {0x2F40, 3078, 1},
+        {0x2F41, 3079, 1},
+        {0x2F42, 3080, 1},
+        {0x2F43, 3081, 1},
+        {0x2F44, 3082, 1},
+        {0x2F45, 3083, 1},
+        {0x2F46, 3084, 1},
+        {0x2F47, 3085, 1},
+        {0x2F48, 3086, 1},
+        {0x2F49, 3087, 1},
+        {0x2F4A, 3088, 1},
+        {0x2F4B, 3089, 1},
+        {0x2F4C, 3090, 1},
+        {0x2F4D, 3091, 1},
+        {0x2F4E, 3092, 1},
+        {0x2F4F, 3093, 1},
+        {0x2F50, 3094, 1},
+        {0x2F51, 3095, 1},
+        {0x2F52, 3096, 1},
+        {0x2F53, 3097, 1},
+        {0x2F54, 3098, 1},
+        {0x2F55, 3099, 1},
+        {0x2F56, 3100, 1},
+        {0x2F57, 3101, 1},
+        {0x2F58, 3102, 1},
+        {0x2F59, 3103, 1},
+        {0x2F5A, 3104, 1},
+        {0x2F5B, 3105, 1},
+        {0x2F5C, 3106, 1},
+        {0x2F5D, 3107, 1},
+        {0x2F5E, 3108, 1},
+        {0x2F5F, 3109, 1},
+        {0x2F60, 3110, 1},
+        {0x2F61, 3111, 1},
+        {0x2F62, 3112, 1},
+        {0x2F63, 3113, 1},
+        {0x2F64, 3114, 1},
+        {0x2F65, 3115, 1},
+        {0x2F66, 3116, 1},
+        {0x2F67, 3117, 1},
+        {0x2F68, 3118, 1},
+        {0x2F69, 3119, 1},
+        {0x2F6A, 3120, 1},
+        {0x2F6B, 3121, 1},
+        {0x2F6C, 3122, 1},
+        {0x2F6D, 3123, 1},
+        {0x2F6E, 3124, 1},
+        {0x2F6F, 3125, 1},
+        {0x2F70, 3126, 1},
+        {0x2F71, 3127, 1},
+        {0x2F72, 3128, 1},
+        {0x2F73, 3129, 1},
+        {0x2F74, 3130, 1},
+        {0x2F75, 3131, 1},
+        {0x2F76, 3132, 1},
+        {0x2F77, 3133, 1},
+        {0x2F78, 3134, 1},
+        {0x2F79, 3135, 1},
+        {0x2F7A, 3136, 1},
+        {0x2F7B, 3137, 1},
+        {0x2F7C, 3138, 1},
+        {0x2F7D, 3139, 1},
+        {0x2F7E, 3140, 1},
+        {0x2F7F, 3141, 1},
+        {0x2F80, 3142, 1},
+        {0x2F81, 3143, 1},
+        {0x2F82, 3144, 1},
+        {0x2F83, 3145, 1},
+        {0x2F84, 3146, 1},
+        {0x2F85, 3147, 1},
+        {0x2F86, 3148, 1},
+        {0x2F87, 3149, 1},
+        {0x2F88, 3150, 1},
+        {0x2F89, 3151, 1},
+        {0x2F8A, 3152, 1},
+        {0x2F8B, 3153, 1},
+        {0x2F8C, 3154, 1},
+        {0x2F8D, 3155, 1},
+        {0x2F8E, 3156, 1},
+        {0x2F8F, 3157, 1},
+        {0x2F90, 3158, 1},
+        {0x2F91, 3159, 1},
+        {0x2F92, 3160, 1},
+        {0x2F93, 3161, 1},
+        {0x2F94, 3162, 1},
+        {0x2F95, 3163, 1},
+        {0x2F96, 3164, 1},
+        {0x2F97, 3165, 1},
+        {0x2F98, 3166, 1},
+        {0x2F99, 3167, 1},
+        {0x2F9A, 3168, 1},
+        {0x2F9B, 3169, 1},
+        {0x2F9C, 3170, 1},
+        {0x2F9D, 3171, 1},
+        {0x2F9E, 3172, 1},
+        {0x2F9F, 3173, 1},
+        {0x2FA0, 3174, 1},
+        {0x2FA1, 3175, 1},
+        {0x2FA2, 3176, 1},
+        {0x2FA3, 3177, 1},
+        {0x2FA4, 3178, 1},
+        {0x2FA5, 3179, 1},
+        {0x2FA6, 3180, 1},
+        {0x2FA7, 3181, 1},
+        {0x2FA8, 3182, 1},
+        {0x2FA9, 3183, 1},
+        {0x2FAA, 3184, 1},
+        {0x2FAB, 3185, 1},
+        {0x2FAC, 3186, 1},
+        {0x2FAD, 3187, 1},
+        {0x2FAE, 3188, 1},
+        {0x2FAF, 3189, 1},
+        {0x2FB0, 3190, 1},
+        {0x2FB1, 3191, 1},
+        {0x2FB2, 3192, 1},
+        {0x2FB3, 3193, 1},
+        {0x2FB4, 3194, 1},
+        {0x2FB5, 3195, 1},
+        {0x2FB6, 3196, 1},
+        {0x2FB7, 3197, 1},
+        {0x2FB8, 3198, 1},
+        {0x2FB9, 3199, 1},
+        {0x2FBA, 3200, 1},
+        {0x2FBB, 3201, 1},
+        {0x2FBC, 3202, 1},
+        {0x2FBD, 3203, 1},
+        {0x2FBE, 3204, 1},
+        {0x2FBF, 3205, 1},
+        {0x2FC0, 3206, 1},
+        {0x2FC1, 3207, 1},
+        {0x2FC2, 3208, 1},
+        {0x2FC3, 3209, 1},
+        {0x2FC4, 3210, 1},
+        {0x2FC5, 3211, 1},
+        {0x2FC6, 3212, 1},
+        {0x2FC7, 3213, 1},
+        {0x2FC8, 3214, 1},
+        {0x2FC9, 3215, 1},
+        {0x2FCA, 3216, 1},
+        {0x2FCB, 3217, 1},
+        {0x2FCC, 3218, 1},
+        {0x2FCD, 3219, 1},
+        {0x2FCE, 3220, 1},
+        {0x2FCF, 3221, 1},
+        {0x2FD0, 3222, 1},
+        {0x2FD1, 3223, 1},
+        {0x2FD2, 3224, 1},
+        {0x2FD3, 3225, 1},
+        {0x2FD4, 3226, 1},
+        {0x2FD5, 3227, 1},
+        {0x3000, 3228, 1},
+        {0x3036, 3229, 1},
+        {0x3038, 3230, 1},
+        {0x3039, 3231, 1},
+        {0x303A, 3232, 1},
+        {0x309B, 3285, 2},
+        {0x309C, 3287, 2},
+        {0x309F, 3291, 2},
+        {0x30FF, 3355, 2},
+        {0x3131, 3357, 1},
+        {0x3132, 3358, 1},
+        {0x3133, 3359, 1},
+        {0x3134, 3360, 1},
+        {0x3135, 3361, 1},
+        {0x3136, 3362, 1},
+        {0x3137, 3363, 1},
+        {0x3138, 3364, 1},
+        {0x3139, 3365, 1},
+        {0x313A, 3366, 1},
+        {0x313B, 3367, 1},
+        {0x313C, 3368, 1},
+        {0x313D, 3369, 1},
+        {0x313E, 3370, 1},
+        {0x313F, 3371, 1},
+        {0x3140, 3372, 1},
+        {0x3141, 3373, 1},
+        {0x3142, 3374, 1},
+        {0x3143, 3375, 1},
+        {0x3144, 3376, 1},
+        {0x3145, 3377, 1},
+        {0x3146, 3378, 1},
+        {0x3147, 3379, 1},
+        {0x3148, 3380, 1},
+        {0x3149, 3381, 1},
+        {0x314A, 3382, 1},
+        {0x314B, 3383, 1},
+        {0x314C, 3384, 1},
+        {0x314D, 3385, 1},
+        {0x314E, 3386, 1},
+        {0x314F, 3387, 1},
+        {0x3150, 3388, 1},
+        {0x3151, 3389, 1},
+        {0x3152, 3390, 1},
+        {0x3153, 3391, 1},
+        {0x3154, 3392, 1},
+        {0x3155, 3393, 1},
+        {0x3156, 3394, 1},
+        {0x3157, 3395, 1},
+        {0x3158, 3396, 1},
+        {0x3159, 3397, 1},
+        {0x315A, 3398, 1},
+        {0x315B, 3399, 1},
+        {0x315C, 3400, 1},
+        {0x315D, 3401, 1},
+        {0x315E, 3402, 1},
+        {0x315F, 3403, 1},
+        {0x3160, 3404, 1},
+        {0x3161, 3405, 1},
+        {0x3162, 3406, 1},
+        {0x3163, 3407, 1},
+        {0x3164, 3408, 1},
+        {0x3165, 3409, 1},
+        {0x3166, 3410, 1},
+        {0x3167, 3411, 1},
+        {0x3168, 3412, 1},
+        {0x3169, 3413, 1},
+        {0x316A, 3414, 1},
+        {0x316B, 3415, 1},
+        {0x316C, 3416, 1},
+        {0x316D, 3417, 1},
+        {0x316E, 3418, 1},
+        {0x316F, 3419, 1},
+        {0x3170, 3420, 1},
+        {0x3171, 3421, 1},
+        {0x3172, 3422, 1},
+        {0x3173, 3423, 1},
+        {0x3174, 3424, 1},
+        {0x3175, 3425, 1},
+        {0x3176, 3426, 1},
+        {0x3177, 3427, 1},
+        {0x3178, 3428, 1},
+        {0x3179, 3429, 1},
+        {0x317A, 3430, 1},
+        {0x317B, 3431, 1},
+        {0x317C, 3432, 1},
+        {0x317D, 3433, 1},
+        {0x317E, 3434, 1},
+        {0x317F, 3435, 1},
+        {0x3180, 3436, 1},
+        {0x3181, 3437, 1},
+        {0x3182, 3438, 1},
+        {0x3183, 3439, 1},
+        {0x3184, 3440, 1},
+        {0x3185, 3441, 1},
+        {0x3186, 3442, 1},
+        {0x3187, 3443, 1},
+        {0x3188, 3444, 1},
+        {0x3189, 3445, 1},
+        {0x318A, 3446, 1},
+        {0x318B, 3447, 1},
+        {0x318C, 3448, 1},
+        {0x318D, 3449, 1},
+        {0x318E, 3450, 1},
+        {0x3192, 3451, 1},
+        {0x3193, 3452, 1},
+        {0x3194, 3453, 1},
+        {0x3195, 3454, 1},
+        {0x3196, 3455, 1},
+        {0x3197, 3456, 1},
+        {0x3198, 3457, 1},
+        {0x3199, 3458, 1},
+        {0x319A, 3459, 1},
+        {0x319B, 3460, 1},
+        {0x319C, 3461, 1},
+        {0x319D, 3462, 1},
+        {0x319E, 3463, 1},
+        {0x319F, 3464, 1},
+        {0x3200, 3465, 3},
+        {0x3201, 3468, 3},
+        {0x3202, 3471, 3},
+        {0x3203, 3474, 3},
+        {0x3204, 3477, 3},
+        {0x3205, 3480, 3},
+        {0x3206, 3483, 3},
+        {0x3207, 3486, 3},
+        {0x3208, 3489, 3},
+        {0x3209, 3492, 3},
+        {0x320A, 3495, 3},
+        {0x320B, 3498, 3},
+        {0x320C, 3501, 3},
+        {0x320D, 3504, 3},
+        {0x320E, 3507, 4},
+        {0x320F, 3511, 4},
+        {0x3210, 3515, 4},
+        {0x3211, 3519, 4},
+        {0x3212, 3523, 4},
+        {0x3213, 3527, 4},
+        {0x3214, 3531, 4},
+        {0x3215, 3535, 4},
+        {0x3216, 3539, 4},
+        {0x3217, 3543, 4},
+        {0x3218, 3547, 4},
+        {0x3219, 3551, 4},
+        {0x321A, 3555, 4},
+        {0x321B, 3559, 4},
+        {0x321C, 3563, 4},
+        {0x321D, 3567, 7},
+        {0x321E, 3574, 6},
+        {0x3220, 3580, 3},
+        {0x3221, 3583, 3},
+        {0x3222, 3586, 3},
+        {0x3223, 3589, 3},
+        {0x3224, 3592, 3},
+        {0x3225, 3595, 3},
+        {0x3226, 3598, 3},
+        {0x3227, 3601, 3},
+        {0x3228, 3604, 3},
+        {0x3229, 3607, 3},
+        {0x322A, 3610, 3},
+        {0x322B, 3613, 3},
+        {0x322C, 3616, 3},
+        {0x322D, 3619, 3},
+        {0x322E, 3622, 3},
+        {0x322F, 3625, 3},
+        {0x3230, 3628, 3},
+        {0x3231, 3631, 3},
+        {0x3232, 3634, 3},
+        {0x3233, 3637, 3},
+        {0x3234, 3640, 3},
+        {0x3235, 3643, 3},
+        {0x3236, 3646, 3},
+        {0x3237, 3649, 3},
+        {0x3238, 3652, 3},
+        {0x3239, 3655, 3},
+        {0x323A, 3658, 3},
+        {0x323B, 3661, 3},
+        {0x323C, 3664, 3},
+        {0x323D, 3667, 3},
+        {0x323E, 3670, 3},
+        {0x323F, 3673, 3},
+        {0x3240, 3676, 3},
+        {0x3241, 3679, 3},
+        {0x3242, 3682, 3},
+        {0x3243, 3685, 3},
+        {0x3244, 3688, 1},
+        {0x3245, 3689, 1},
+        {0x3246, 3690, 1},
+        {0x3247, 3691, 1},
+        {0x3250, 3692, 3},
+        {0x3251, 3695, 2},
+        {0x3252, 3697, 2},
+        {0x3253, 3699, 2},
+        {0x3254, 3701, 2},
+        {0x3255, 3703, 2},
+        {0x3256, 3705, 2},
+        {0x3257, 3707, 2},
+        {0x3258, 3709, 2},
+        {0x3259, 3711, 2},
+        {0x325A, 3713, 2},
+        {0x325B, 3715, 2},
+        {0x325C, 3717, 2},
+        {0x325D, 3719, 2},
+        {0x325E, 3721, 2},
+        {0x325F, 3723, 2},
+        {0x3260, 3725, 1},
+        {0x3261, 3726, 1},
+        {0x3262, 3727, 1},
+        {0x3263, 3728, 1},
+        {0x3264, 3729, 1},
+        {0x3265, 3730, 1},
+        {0x3266, 3731, 1},
+        {0x3267, 3732, 1},
+        {0x3268, 3733, 1},
+        {0x3269, 3734, 1},
+        {0x326A, 3735, 1},
+        {0x326B, 3736, 1},
+        {0x326C, 3737, 1},
+        {0x326D, 3738, 1},
+        {0x326E, 3739, 2},
+        {0x326F, 3741, 2},
+        {0x3270, 3743, 2},
+        {0x3271, 3745, 2},
+        {0x3272, 3747, 2},
+        {0x3273, 3749, 2},
+        {0x3274, 3751, 2},
+        {0x3275, 3753, 2},
+        {0x3276, 3755, 2},
+        {0x3277, 3757, 2},
+        {0x3278, 3759, 2},
+        {0x3279, 3761, 2},
+        {0x327A, 3763, 2},
+        {0x327B, 3765, 2},
+        {0x327C, 3767, 5},
+        {0x327D, 3772, 4},
+        {0x327E, 3776, 2},
+        {0x3280, 3778, 1},
+        {0x3281, 3779, 1},
+        {0x3282, 3780, 1},
+        {0x3283, 3781, 1},
+        {0x3284, 3782, 1},
+        {0x3285, 3783, 1},
+        {0x3286, 3784, 1},
+        {0x3287, 3785, 1},
+        {0x3288, 3786, 1},
+        {0x3289, 3787, 1},
+        {0x328A, 3788, 1},
+        {0x328B, 3789, 1},
+        {0x328C, 3790, 1},
+        {0x328D, 3791, 1},
+        {0x328E, 3792, 1},
+        {0x328F, 3793, 1},
+        {0x3290, 3794, 1},
+        {0x3291, 3795, 1},
+        {0x3292, 3796, 1},
+        {0x3293, 3797, 1},
+        {0x3294, 3798, 1},
+        {0x3295, 3799, 1},
+        {0x3296, 3800, 1},
+        {0x3297, 3801, 1},
+        {0x3298, 3802, 1},
+        {0x3299, 3803, 1},
+        {0x329A, 3804, 1},
+        {0x329B, 3805, 1},
+        {0x329C, 3806, 1},
+        {0x329D, 3807, 1},
+        {0x329E, 3808, 1},
+        {0x329F, 3809, 1},
+        {0x32A0, 3810, 1},
+        {0x32A1, 3811, 1},
+        {0x32A2, 3812, 1},
+        {0x32A3, 3813, 1},
+        {0x32A4, 3814, 1},
+        {0x32A5, 3815, 1},
+        {0x32A6, 3816, 1},
+        {0x32A7, 3817, 1},
+        {0x32A8, 3818, 1},
+        {0x32A9, 3819, 1},
+        {0x32AA, 3820, 1},
+        {0x32AB, 3821, 1},
+        {0x32AC, 3822, 1},
+        {0x32AD, 3823, 1},
+        {0x32AE, 3824, 1},
+        {0x32AF, 3825, 1},
+        {0x32B0, 3826, 1},
+        {0x32B1, 3827, 2},
+        {0x32B2, 3829, 2},
+        {0x32B3, 3831, 2},
+        {0x32B4, 3833, 2},
+        {0x32B5, 3835, 2},
+        {0x32B6, 3837, 2},
+        {0x32B7, 3839, 2},
+        {0x32B8, 3841, 2},
+        {0x32B9, 3843, 2},
+        {0x32BA, 3845, 2},
+        {0x32BB, 3847, 2},
+        {0x32BC, 3849, 2},
+        {0x32BD, 3851, 2},
+        {0x32BE, 3853, 2},
+        {0x32BF, 3855, 2},
+        {0x32C0, 3857, 2},
+        {0x32C1, 3859, 2},
+        {0x32C2, 3861, 2},
+        {0x32C3, 3863, 2},
+        {0x32C4, 3865, 2},
+        {0x32C5, 3867, 2},
+        {0x32C6, 3869, 2},
+        {0x32C7, 3871, 2},
+        {0x32C8, 3873, 2},
+        {0x32C9, 3875, 3},
+        {0x32CA, 3878, 3},
+        {0x32CB, 3881, 3},
+        {0x32CC, 3884, 2},
+        {0x32CD, 3886, 3},
+        {0x32CE, 3889, 2},
+        {0x32CF, 3891, 3},
+        {0x32D0, 3894, 1},
+        {0x32D1, 3895, 1},
+        {0x32D2, 3896, 1},
+        {0x32D3, 3897, 1},
+        {0x32D4, 3898, 1},
+        {0x32D5, 3899, 1},
+        {0x32D6, 3900, 1},
+        {0x32D7, 3901, 1},
+        {0x32D8, 3902, 1},
+        {0x32D9, 3903, 1},
+        {0x32DA, 3904, 1},
+        {0x32DB, 3905, 1},
+        {0x32DC, 3906, 1},
+        {0x32DD, 3907, 1},
+        {0x32DE, 3908, 1},
+        {0x32DF, 3909, 1},
+        {0x32E0, 3910, 1},
+        {0x32E1, 3911, 1},
+        {0x32E2, 3912, 1},
+        {0x32E3, 3913, 1},
+        {0x32E4, 3914, 1},
+        {0x32E5, 3915, 1},
+        {0x32E6, 3916, 1},
+        {0x32E7, 3917, 1},
+        {0x32E8, 3918, 1},
+        {0x32E9, 3919, 1},
+        {0x32EA, 3920, 1},
+        {0x32EB, 3921, 1},
+        {0x32EC, 3922, 1},
+        {0x32ED, 3923, 1},
+        {0x32EE, 3924, 1},
+        {0x32EF, 3925, 1},
+        {0x32F0, 3926, 1},
+        {0x32F1, 3927, 1},
+        {0x32F2, 3928, 1},
+        {0x32F3, 3929, 1},
+        {0x32F4, 3930, 1},
+        {0x32F5, 3931, 1},
+        {0x32F6, 3932, 1},
+        {0x32F7, 3933, 1},
+        {0x32F8, 3934, 1},
+        {0x32F9, 3935, 1},
+        {0x32FA, 3936, 1},
+        {0x32FB, 3937, 1},
+        {0x32FC, 3938, 1},
+        {0x32FD, 3939, 1},
+        {0x32FE, 3940, 1},
+        {0x32FF, 3941, 2},
+        {0x3300, 3943, 5},
+        {0x3301, 3948, 4},
+        {0x3302, 3952, 5},
+        {0x3303, 3957, 3},
+        {0x3304, 3960, 5},
+        {0x3305, 3965, 3},
+        {0x3306, 3968, 3},
+        {0x3307, 3971, 6},
+        {0x3308, 3977, 4},
+        {0x3309, 3981, 3},
+        {0x330A, 3984, 3},
+        {0x330B, 3987, 3},
+        {0x330C, 3990, 4},
+        {0x330D, 3994, 4},
+        {0x330E, 3998, 4},
+        {0x330F, 4002, 4},
+        {0x3310, 4006, 4},
+        {0x3311, 4010, 4},
+        {0x3312, 4014, 4},
+        {0x3313, 4018, 6},
+        {0x3314, 4024, 2},
+        {0x3315, 4026, 6},
+        {0x3316, 4032, 6},
+        {0x3317, 4038, 5},
+        {0x3318, 4043, 4},
+        {0x3319, 4047, 6},
+        {0x331A, 4053, 6},
+        {0x331B, 4059, 4},
+        {0x331C, 4063, 3},
+        {0x331D, 4066, 3},
+        {0x331E, 4069, 4},
+        {0x331F, 4073, 4},
+        {0x3320, 4077, 5},
+        {0x3321, 4082, 5},
+        {0x3322, 4087, 3},
+        {0x3323, 4090, 3},
+        {0x3324, 4093, 4},
+        {0x3325, 4097, 3},
+        {0x3326, 4100, 3},
+        {0x3327, 4103, 2},
+        {0x3328, 4105, 2},
+        {0x3329, 4107, 3},
+        {0x332A, 4110, 3},
+        {0x332B, 4113, 6},
+        {0x332C, 4119, 4},
+        {0x332D, 4123, 5},
+        {0x332E, 4128, 6},
+        {0x332F, 4134, 4},
+        {0x3330, 4138, 3},
+        {0x3331, 4141, 3},
+        {0x3332, 4144, 6},
+        {0x3333, 4150, 4},
+        {0x3334, 4154, 6},
+        {0x3335, 4160, 3},
+        {0x3336, 4163, 5},
+        {0x3337, 4168, 3},
+        {0x3338, 4171, 4},
+        {0x3339, 4175, 3},
+        {0x333A, 4178, 4},
+        {0x333B, 4182, 5},
+        {0x333C, 4187, 4},
+        {0x333D, 4191, 5},
+        {0x333E, 4196, 4},
+        {0x333F, 4200, 2},
+        {0x3340, 4202, 5},
+        {0x3341, 4207, 3},
+        {0x3342, 4210, 3},
+        {0x3343, 4213, 4},
+        {0x3344, 4217, 3},
+        {0x3345, 4220, 3},
+        {0x3346, 4223, 3},
+        {0x3347, 4226, 5},
+        {0x3348, 4231, 4},
+        {0x3349, 4235, 2},
+        {0x334A, 4237, 6},
+        {0x334B, 4243, 3},
+        {0x334C, 4246, 5},
+        {0x334D, 4251, 4},
+        {0x334E, 4255, 4},
+        {0x334F, 4259, 3},
+        {0x3350, 4262, 3},
+        {0x3351, 4265, 4},
+        {0x3352, 4269, 2},
+        {0x3353, 4271, 4},
+        {0x3354, 4275, 5},
+        {0x3355, 4280, 2},
+        {0x3356, 4282, 6},
+        {0x3357, 4288, 3},
+        {0x3358, 4291, 2},
+        {0x3359, 4293, 2},
+        {0x335A, 4295, 2},
+        {0x335B, 4297, 2},
+        {0x335C, 4299, 2},
+        {0x335D, 4301, 2},
+        {0x335E, 4303, 2},
+        {0x335F, 4305, 2},
+        {0x3360, 4307, 2},
+        {0x3361, 4309, 2},
+        {0x3362, 4311, 3},
+        {0x3363, 4314, 3},
+        {0x3364, 4317, 3},
+        {0x3365, 4320, 3},
+        {0x3366, 4323, 3},
+        {0x3367, 4326, 3},
+        {0x3368, 4329, 3},
+        {0x3369, 4332, 3},
+        {0x336A, 4335, 3},
+        {0x336B, 4338, 3},
+        {0x336C, 4341, 3},
+        {0x336D, 4344, 3},
+        {0x336E, 4347, 3},
+        {0x336F, 4350, 3},
+        {0x3370, 4353, 3},
+        {0x3371, 4356, 3},
+        {0x3372, 4359, 2},
+        {0x3373, 4361, 2},
+        {0x3374, 4363, 3},
+        {0x3375, 4366, 2},
+        {0x3376, 4368, 2},
+        {0x3377, 4370, 2},
+        {0x3378, 4372, 3},
+        {0x3379, 4375, 3},
+        {0x337A, 4378, 2},
+        {0x337B, 4380, 2},
+        {0x337C, 4382, 2},
+        {0x337D, 4384, 2},
+        {0x337E, 4386, 2},
+        {0x337F, 4388, 4},
+        {0x3380, 4392, 2},
+        {0x3381, 4394, 2},
+        {0x3382, 4396, 2},
+        {0x3383, 4398, 2},
+        {0x3384, 4400, 2},
+        {0x3385, 4402, 2},
+        {0x3386, 4404, 2},
+        {0x3387, 4406, 2},
+        {0x3388, 4408, 3},
+        {0x3389, 4411, 4},
+        {0x338A, 4415, 2},
+        {0x338B, 4417, 2},
+        {0x338C, 4419, 2},
+        {0x338D, 4421, 2},
+        {0x338E, 4423, 2},
+        {0x338F, 4425, 2},
+        {0x3390, 4427, 2},
+        {0x3391, 4429, 3},
+        {0x3392, 4432, 3},
+        {0x3393, 4435, 3},
+        {0x3394, 4438, 3},
+        {0x3395, 4441, 2},
+        {0x3396, 4443, 2},
+        {0x3397, 4445, 2},
+        {0x3398, 4447, 2},
+        {0x3399, 4449, 2},
+        {0x339A, 4451, 2},
+        {0x339B, 4453, 2},
+        {0x339C, 4455, 2},
+        {0x339D, 4457, 2},
+        {0x339E, 4459, 2},
+        {0x339F, 4461, 3},
+        {0x33A0, 4464, 3},
+        {0x33A1, 4467, 2},
+        {0x33A2, 4469, 3},
+        {0x33A3, 4472, 3},
+        {0x33A4, 4475, 3},
+        {0x33A5, 4478, 2},
+        {0x33A6, 4480, 3},
+        {0x33A7, 4483, 3},
+        {0x33A8, 4486, 4},
+        {0x33A9, 4490, 2},
+        {0x33AA, 4492, 3},
+        {0x33AB, 4495, 3},
+        {0x33AC, 4498, 3},
+        {0x33AD, 4501, 3},
+        {0x33AE, 4504, 5},
+        {0x33AF, 4509, 6},
+        {0x33B0, 4515, 2},
+        {0x33B1, 4517, 2},
+        {0x33B2, 4519, 2},
+        {0x33B3, 4521, 2},
+        {0x33B4, 4523, 2},
+        {0x33B5, 4525, 2},
+        {0x33B6, 4527, 2},
+        {0x33B7, 4529, 2},
+        {0x33B8, 4531, 2},
+        {0x33B9, 4533, 2},
+        {0x33BA, 4535, 2},
+        {0x33BB, 4537, 2},
+        {0x33BC, 4539, 2},
+        {0x33BD, 4541, 2},
+        {0x33BE, 4543, 2},
+        {0x33BF, 4545, 2},
+        {0x33C0, 4547, 2},
+        {0x33C1, 4549, 2},
+        {0x33C2, 4551, 4},
+        {0x33C3, 4555, 2},
+        {0x33C4, 4557, 2},
+        {0x33C5, 4559, 2},
+        {0x33C6, 4561, 4},
+        {0x33C7, 4565, 3},
+        {0x33C8, 4568, 2},
+        {0x33C9, 4570, 2},
+        {0x33CA, 4572, 2},
+        {0x33CB, 4574, 2},
+        {0x33CC, 4576, 2},
+        {0x33CD, 4578, 2},
+        {0x33CE, 4580, 2},
+        {0x33CF, 4582, 2},
+        {0x33D0, 4584, 2},
+        {0x33D1, 4586, 2},
+        {0x33D2, 4588, 3},
+        {0x33D3, 4591, 2},
+        {0x33D4, 4593, 2},
+        {0x33D5, 4595, 3},
+        {0x33D6, 4598, 3},
+        {0x33D7, 4601, 2},
+        {0x33D8, 4603, 4},
+        {0x33D9, 4607, 3},
+        {0x33DA, 4610, 2},
+        {0x33DB, 4612, 2},
+        {0x33DC, 4614, 2},
+        {0x33DD, 4616, 2},
+        {0x33DE, 4618, 3},
+        {0x33DF, 4621, 3},
+        {0x33E0, 4624, 2},
+        {0x33E1, 4626, 2},
+        {0x33E2, 4628, 2},
+        {0x33E3, 4630, 2},
+        {0x33E4, 4632, 2},
+        {0x33E5, 4634, 2},
+        {0x33E6, 4636, 2},
+        {0x33E7, 4638, 2},
+        {0x33E8, 4640, 2},
+        {0x33E9, 4642, 3},
+        {0x33EA, 4645, 3},
+        {0x33EB, 4648, 3},
+        {0x33EC, 4651, 3},
+        {0x33ED, 4654, 3},
+        {0x33EE, 4657, 3},
+        {0x33EF, 4660, 3},
+        {0x33F0, 4663, 3},
+        {0x33F1, 4666, 3},
+        {0x33F2, 4669, 3},
+        {0x33F3, 4672, 3},
+        {0x33F4, 4675, 3},
+        {0x33F5, 4678, 3},
+        {0x33F6, 4681, 3},
+        {0x33F7, 4684, 3},
+        {0x33F8, 4687, 3},
+        {0x33F9, 4690, 3},
+        {0x33FA, 4693, 3},
+        {0x33FB, 4696, 3},
+        {0x33FC, 4699, 3},
+        {0x33FD, 4702, 3},
+        {0x33FE, 4705, 3},
+        {0x33FF, 4708, 3},
+        {0xA69C, 4711, 1},
+        {0xA69D, 4712, 1},
+        {0xA770, 4713, 1},
+        {0xA7F2, 4714, 1},
+        {0xA7F3, 4715, 1},
+        {0xA7F4, 4716, 1},
+        {0xA7F8, 4717, 1},
+        {0xA7F9, 4718, 1},
+        {0xAB5C, 4719, 1},
+        {0xAB5D, 4720, 1},
+        {0xAB5E, 4721, 1},
+        {0xAB5F, 4722, 1},
+        {0xAB69, 4723, 1},
+        {0xFB00, 5184, 2},
+        {0xFB01, 5186, 2},
+        {0xFB02, 5188, 2},
+        {0xFB03, 5190, 3},
+        {0xFB04, 5193, 3},
+        {0xFB05, 5196, 2},
+        {0xFB06, 5198, 2},
+        {0xFB13, 5200, 2},
+        {0xFB14, 5202, 2},
+        {0xFB15, 5204, 2},
+        {0xFB16, 5206, 2},
+        {0xFB17, 5208, 2},
+        {0xFB20, 5214, 1},
+        {0xFB21, 5215, 1},
+        {0xFB22, 5216, 1},
+        {0xFB23, 5217, 1},
+        {0xFB24, 5218, 1},
+        {0xFB25, 5219, 1},
+        {0xFB26, 5220, 1},
+        {0xFB27, 5221, 1},
+        {0xFB28, 5222, 1},
+        {0xFB29, 5223, 1},
+        {0xFB4F, 5290, 2},
+        {0xFB50, 5292, 1},
+        {0xFB51, 5293, 1},
+        {0xFB52, 5294, 1},
+        {0xFB53, 5295, 1},
+        {0xFB54, 5296, 1},
+        {0xFB55, 5297, 1},
+        {0xFB56, 5298, 1},
+        {0xFB57, 5299, 1},
+        {0xFB58, 5300, 1},
+        {0xFB59, 5301, 1},
+        {0xFB5A, 5302, 1},
+        {0xFB5B, 5303, 1},
+        {0xFB5C, 5304, 1},
+        {0xFB5D, 5305, 1},
+        {0xFB5E, 5306, 1},
+        {0xFB5F, 5307, 1},
+        {0xFB60, 5308, 1},
+        {0xFB61, 5309, 1},
+        {0xFB62, 5310, 1},
+        {0xFB63, 5311, 1},
+        {0xFB64, 5312, 1},
+        {0xFB65, 5313, 1},
+        {0xFB66, 5314, 1},
+        {0xFB67, 5315, 1},
+        {0xFB68, 5316, 1},
+        {0xFB69, 5317, 1},
+        {0xFB6A, 5318, 1},
+        {0xFB6B, 5319, 1},
+        {0xFB6C, 5320, 1},
+        {0xFB6D, 5321, 1},
+        {0xFB6E, 5322, 1},
+        {0xFB6F, 5323, 1},
+        {0xFB70, 5324, 1},
+        {0xFB71, 5325, 1},
+        {0xFB72, 5326, 1},
+        {0xFB73, 5327, 1},
+        {0xFB74, 5328, 1},
+        {0xFB75, 5329, 1},
+        {0xFB76, 5330, 1},
+        {0xFB77, 5331, 1},
+        {0xFB78, 5332, 1},
+        {0xFB79, 5333, 1},
+        {0xFB7A, 5334, 1},
+        {0xFB7B, 5335, 1},
+        {0xFB7C, 5336, 1},
+        {0xFB7D, 5337, 1},
+        {0xFB7E, 5338, 1},
+        {0xFB7F, 5339, 1},
+        {0xFB80, 5340, 1},
+        {0xFB81, 5341, 1},
+        {0xFB82, 5342, 1},
+        {0xFB83, 5343, 1},
+        {0xFB84, 5344, 1},
+        {0xFB85, 5345, 1},
+        {0xFB86, 5346, 1},
+        {0xFB87, 5347, 1},
+        {0xFB88, 5348, 1},
+        {0xFB89, 5349, 1},
+        {0xFB8A, 5350, 1},
+        {0xFB8B, 5351, 1},
+        {0xFB8C, 5352, 1},
+        {0xFB8D, 5353, 1},
+        {0xFB8E, 5354, 1},
+        {0xFB8F, 5355, 1},
+        {0xFB90, 5356, 1},
+        {0xFB91, 5357, 1},
+        {0xFB92, 5358, 1},
+        {0xFB93, 5359, 1},
+        {0xFB94, 5360, 1},
+        {0xFB95, 5361, 1},
+        {0xFB96, 5362, 1},
+        {0xFB97, 5363, 1},
+        {0xFB98, 5364, 1},
+        {0xFB99, 5365, 1},
+        {0xFB9A, 5366, 1},
+        {0xFB9B, 5367, 1},
+        {0xFB9C, 5368, 1},
+        {0xFB9D, 5369, 1},
+        {0xFB9E, 5370, 1},
+        {0xFB9F, 5371, 1},
+        {0xFBA0, 5372, 1},
+        {0xFBA1, 5373, 1},
+        {0xFBA2, 5374, 1},
+        {0xFBA3, 5375, 1},
+        {0xFBA4, 5376, 2},
+        {0xFBA5, 5378, 2},
+        {0xFBA6, 5380, 1},
+        {0xFBA7, 5381, 1},
+        {0xFBA8, 5382, 1},
+        {0xFBA9, 5383, 1},
+        {0xFBAA, 5384, 1},
+        {0xFBAB, 5385, 1},
+        {0xFBAC, 5386, 1},
+        {0xFBAD, 5387, 1},
+        {0xFBAE, 5388, 1},
+        {0xFBAF, 5389, 1},
+        {0xFBB0, 5390, 2},
+        {0xFBB1, 5392, 2},
+        {0xFBD3, 5394, 1},
+        {0xFBD4, 5395, 1},
+        {0xFBD5, 5396, 1},
+        {0xFBD6, 5397, 1},
+        {0xFBD7, 5398, 1},
+        {0xFBD8, 5399, 1},
+        {0xFBD9, 5400, 1},
+        {0xFBDA, 5401, 1},
+        {0xFBDB, 5402, 1},
+        {0xFBDC, 5403, 1},
+        {0xFBDD, 5404, 2},
+        {0xFBDE, 5406, 1},
+        {0xFBDF, 5407, 1},
+        {0xFBE0, 5408, 1},
+        {0xFBE1, 5409, 1},
+        {0xFBE2, 5410, 1},
+        {0xFBE3, 5411, 1},
+        {0xFBE4, 5412, 1},
+        {0xFBE5, 5413, 1},
+        {0xFBE6, 5414, 1},
+        {0xFBE7, 5415, 1},
+        {0xFBE8, 5416, 1},
+        {0xFBE9, 5417, 1},
+        {0xFBEA, 5418, 3},
+        {0xFBEB, 5421, 3},
+        {0xFBEC, 5424, 3},
+        {0xFBED, 5427, 3},
+        {0xFBEE, 5430, 3},
+        {0xFBEF, 5433, 3},
+        {0xFBF0, 5436, 3},
+        {0xFBF1, 5439, 3},
+        {0xFBF2, 5442, 3},
+        {0xFBF3, 5445, 3},
+        {0xFBF4, 5448, 3},
+        {0xFBF5, 5451, 3},
+        {0xFBF6, 5454, 3},
+        {0xFBF7, 5457, 3},
+        {0xFBF8, 5460, 3},
+        {0xFBF9, 5463, 3},
+        {0xFBFA, 5466, 3},
+        {0xFBFB, 5469, 3},
+        {0xFBFC, 5472, 1},
+        {0xFBFD, 5473, 1},
+        {0xFBFE, 5474, 1},
+        {0xFBFF, 5475, 1},
+        {0xFC00, 5476, 3},
+        {0xFC01, 5479, 3},
+        {0xFC02, 5482, 3},
+        {0xFC03, 5485, 3},
+        {0xFC04, 5488, 3},
+        {0xFC05, 5491, 2},
+        {0xFC06, 5493, 2},
+        {0xFC07, 5495, 2},
+        {0xFC08, 5497, 2},
+        {0xFC09, 5499, 2},
+        {0xFC0A, 5501, 2},
+        {0xFC0B, 5503, 2},
+        {0xFC0C, 5505, 2},
+        {0xFC0D, 5507, 2},
+        {0xFC0E, 5509, 2},
+        {0xFC0F, 5511, 2},
+        {0xFC10, 5513, 2},
+        {0xFC11, 5515, 2},
+        {0xFC12, 5517, 2},
+        {0xFC13, 5519, 2},
+        {0xFC14, 5521, 2},
+        {0xFC15, 5523, 2},
+        {0xFC16, 5525, 2},
+        {0xFC17, 5527, 2},
+        {0xFC18, 5529, 2},
+        {0xFC19, 5531, 2},
+        {0xFC1A, 5533, 2},
+        {0xFC1B, 5535, 2},
+        {0xFC1C, 5537, 2},
+        {0xFC1D, 5539, 2},
+        {0xFC1E, 5541, 2},
+        {0xFC1F, 5543, 2},
+        {0xFC20, 5545, 2},
+        {0xFC21, 5547, 2},
+        {0xFC22, 5549, 2},
+        {0xFC23, 5551, 2},
+        {0xFC24, 5553, 2},
+        {0xFC25, 5555, 2},
+        {0xFC26, 5557, 2},
+        {0xFC27, 5559, 2},
+        {0xFC28, 5561, 2},
+        {0xFC29, 5563, 2},
+        {0xFC2A, 5565, 2},
+        {0xFC2B, 5567, 2},
+        {0xFC2C, 5569, 2},
+        {0xFC2D, 5571, 2},
+        {0xFC2E, 5573, 2},
+        {0xFC2F, 5575, 2},
+        {0xFC30, 5577, 2},
+        {0xFC31, 5579, 2},
+        {0xFC32, 5581, 2},
+        {0xFC33, 5583, 2},
+        {0xFC34, 5585, 2},
+        {0xFC35, 5587, 2},
+        {0xFC36, 5589, 2},
+        {0xFC37, 5591, 2},
+        {0xFC38, 5593, 2},
+        {0xFC39, 5595, 2},
+        {0xFC3A, 5597, 2},
+        {0xFC3B, 5599, 2},
+        {0xFC3C, 5601, 2},
+        {0xFC3D, 5603, 2},
+        {0xFC3E, 5605, 2},
+        {0xFC3F, 5607, 2},
+        {0xFC40, 5609, 2},
+        {0xFC41, 5611, 2},
+        {0xFC42, 5613, 2},
+        {0xFC43, 5615, 2},
+        {0xFC44, 5617, 2},
+        {0xFC45, 5619, 2},
+        {0xFC46, 5621, 2},
+        {0xFC47, 5623, 2},
+        {0xFC48, 5625, 2},
+        {0xFC49, 5627, 2},
+        {0xFC4A, 5629, 2},
+        {0xFC4B, 5631, 2},
+        {0xFC4C, 5633, 2},
+        {0xFC4D, 5635, 2},
+        {0xFC4E, 5637, 2},
+        {0xFC4F, 5639, 2},
+        {0xFC50, 5641, 2},
+        {0xFC51, 5643, 2},
+        {0xFC52, 5645, 2},
+        {0xFC53, 5647, 2},
+        {0xFC54, 5649, 2},
+        {0xFC55, 5651, 2},
+        {0xFC56, 5653, 2},
+        {0xFC57, 5655, 2},
+        {0xFC58, 5657, 2},
+        {0xFC59, 5659, 2},
+        {0xFC5A, 5661, 2},
+        {0xFC5B, 5663, 2},
+        {0xFC5C, 5665, 2},
+        {0xFC5D, 5667, 2},
+        {0xFC5E, 5669, 3},
+        {0xFC5F, 5672, 3},
+        {0xFC60, 5675, 3},
+        {0xFC61, 5678, 3},
+        {0xFC62, 5681, 3},
+        {0xFC63, 5684, 3},
+        {0xFC64, 5687, 3},
+        {0xFC65, 5690, 3},
+        {0xFC66, 5693, 3},
+        {0xFC67, 5696, 3},
+        {0xFC68, 5699, 3},
+        {0xFC69, 5702, 3},
+        {0xFC6A, 5705, 2},
+        {0xFC6B, 5707, 2},
+        {0xFC6C, 5709, 2},
+        {0xFC6D, 5711, 2},
+        {0xFC6E, 5713, 2},
+        {0xFC6F, 5715, 2},
+        {0xFC70, 5717, 2},
+        {0xFC71, 5719, 2},
+        {0xFC72, 5721, 2},
+        {0xFC73, 5723, 2},
+        {0xFC74, 5725, 2},
+        {0xFC75, 5727, 2},
+        {0xFC76, 5729, 2},
+        {0xFC77, 5731, 2},
+        {0xFC78, 5733, 2},
+        {0xFC79, 5735, 2},
+        {0xFC7A, 5737, 2},
+        {0xFC7B, 5739, 2},
+        {0xFC7C, 5741, 2},
+        {0xFC7D, 5743, 2},
+        {0xFC7E, 5745, 2},
+        {0xFC7F, 5747, 2},
+        {0xFC80, 5749, 2},
+        {0xFC81, 5751, 2},
+        {0xFC82, 5753, 2},
+        {0xFC83, 5755, 2},
+        {0xFC84, 5757, 2},
+        {0xFC85, 5759, 2},
+        {0xFC86, 5761, 2},
+        {0xFC87, 5763, 2},
+        {0xFC88, 5765, 2},
+        {0xFC89, 5767, 2},
+        {0xFC8A, 5769, 2},
+        {0xFC8B, 5771, 2},
+        {0xFC8C, 5773, 2},
+        {0xFC8D, 5775, 2},
+        {0xFC8E, 5777, 2},
+        {0xFC8F, 5779, 2},
+        {0xFC90, 5781, 2},
+        {0xFC91, 5783, 2},
+        {0xFC92, 5785, 2},
+        {0xFC93, 5787, 2},
+        {0xFC94, 5789, 2},
+        {0xFC95, 5791, 2},
+        {0xFC96, 5793, 2},
+        {0xFC97, 5795, 3},
+        {0xFC98, 5798, 3},
+        {0xFC99, 5801, 3},
+        {0xFC9A, 5804, 3},
+        {0xFC9B, 5807, 3},
+        {0xFC9C, 5810, 2},
+        {0xFC9D, 5812, 2},
+        {0xFC9E, 5814, 2},
+        {0xFC9F, 5816, 2},
+        {0xFCA0, 5818, 2},
+        {0xFCA1, 5820, 2},
+        {0xFCA2, 5822, 2},
+        {0xFCA3, 5824, 2},
+        {0xFCA4, 5826, 2},
+        {0xFCA5, 5828, 2},
+        {0xFCA6, 5830, 2},
+        {0xFCA7, 5832, 2},
+        {0xFCA8, 5834, 2},
+        {0xFCA9, 5836, 2},
+        {0xFCAA, 5838, 2},
+        {0xFCAB, 5840, 2},
+        {0xFCAC, 5842, 2},
+        {0xFCAD, 5844, 2},
+        {0xFCAE, 5846, 2},
+        {0xFCAF, 5848, 2},
+        {0xFCB0, 5850, 2},
+        {0xFCB1, 5852, 2},
+        {0xFCB2, 5854, 2},
+        {0xFCB3, 5856, 2},
+        {0xFCB4, 5858, 2},
+        {0xFCB5, 5860, 2},
+        {0xFCB6, 5862, 2},
+        {0xFCB7, 5864, 2},
+        {0xFCB8, 5866, 2},
+        {0xFCB9, 5868, 2},
+        {0xFCBA, 5870, 2},
+        {0xFCBB, 5872, 2},
+        {0xFCBC, 5874, 2},
+        {0xFCBD, 5876, 2},
+        {0xFCBE, 5878, 2},
+        {0xFCBF, 5880, 2},
+        {0xFCC0, 5882, 2},
+        {0xFCC1, 5884, 2},
+        {0xFCC2, 5886, 2},
+        {0xFCC3, 5888, 2},
+        {0xFCC4, 5890, 2},
+        {0xFCC5, 5892, 2},
+        {0xFCC6, 5894, 2},
+        {0xFCC7, 5896, 2},
+        {0xFCC8, 5898, 2},
+        {0xFCC9, 5900, 2},
+        {0xFCCA, 5902, 2},
+        {0xFCCB, 5904, 2},
+        {0xFCCC, 5906, 2},
+        {0xFCCD, 5908, 2},
+        {0xFCCE, 5910, 2},
+        {0xFCCF, 5912, 2},
+        {0xFCD0, 5914, 2},
+        {0xFCD1, 5916, 2},
+        {0xFCD2, 5918, 2},
+        {0xFCD3, 5920, 2},
+        {0xFCD4, 5922, 2},
+        {0xFCD5, 5924, 2},
+        {0xFCD6, 5926, 2},
+        {0xFCD7, 5928, 2},
+        {0xFCD8, 5930, 2},
+        {0xFCD9, 5932, 2},
+        {0xFCDA, 5934, 2},
+        {0xFCDB, 5936, 2},
+        {0xFCDC, 5938, 2},
+        {0xFCDD, 5940, 2},
+        {0xFCDE, 5942, 2},
+        {0xFCDF, 5944, 3},
+        {0xFCE0, 5947, 3},
+        {0xFCE1, 5950, 2},
+        {0xFCE2, 5952, 2},
+        {0xFCE3, 5954, 2},
+        {0xFCE4, 5956, 2},
+        {0xFCE5, 5958, 2},
+        {0xFCE6, 5960, 2},
+        {0xFCE7, 5962, 2},
+        {0xFCE8, 5964, 2},
+        {0xFCE9, 5966, 2},
+        {0xFCEA, 5968, 2},
+        {0xFCEB, 5970, 2},
+        {0xFCEC, 5972, 2},
+        {0xFCED, 5974, 2},
+        {0xFCEE, 5976, 2},
+        {0xFCEF, 5978, 2},
+        {0xFCF0, 5980, 2},
+        {0xFCF1, 5982, 2},
+        {0xFCF2, 5984, 3},
+        {0xFCF3, 5987, 3},
+        {0xFCF4, 5990, 3},
+        {0xFCF5, 5993, 2},
+        {0xFCF6, 5995, 2},
+        {0xFCF7, 5997, 2},
+        {0xFCF8, 5999, 2},
+        {0xFCF9, 6001, 2},
+        {0xFCFA, 6003, 2},
+        {0xFCFB, 6005, 2},
+        {0xFCFC, 6007, 2},
+        {0xFCFD, 6009, 2},
+        {0xFCFE, 6011, 2},
+        {0xFCFF, 6013, 2},
+        {0xFD00, 6015, 2},
+        {0xFD01, 6017, 2},
+        {0xFD02, 6019, 2},
+        {0xFD03, 6021, 2},
+        {0xFD04, 6023, 2},
+        {0xFD05, 6025, 2},
+        {0xFD06, 6027, 2},
+        {0xFD07, 6029, 2},
+        {0xFD08, 6031, 2},
+        {0xFD09, 6033, 2},
+        {0xFD0A, 6035, 2},
+        {0xFD0B, 6037, 2},
+        {0xFD0C, 6039, 2},
+        {0xFD0D, 6041, 2},
+        {0xFD0E, 6043, 2},
+        {0xFD0F, 6045, 2},
+        {0xFD10, 6047, 2},
+        {0xFD11, 6049, 2},
+        {0xFD12, 6051, 2},
+        {0xFD13, 6053, 2},
+        {0xFD14, 6055, 2},
+        {0xFD15, 6057, 2},
+        {0xFD16, 6059, 2},
+        {0xFD17, 6061, 2},
+        {0xFD18, 6063, 2},
+        {0xFD19, 6065, 2},
+        {0xFD1A, 6067, 2},
+        {0xFD1B, 6069, 2},
+        {0xFD1C, 6071, 2},
+        {0xFD1D, 6073, 2},
+        {0xFD1E, 6075, 2},
+        {0xFD1F, 6077, 2},
+        {0xFD20, 6079, 2},
+        {0xFD21, 6081, 2},
+        {0xFD22, 6083, 2},
+        {0xFD23, 6085, 2},
+        {0xFD24, 6087, 2},
+        {0xFD25, 6089, 2},
+        {0xFD26, 6091, 2},
+        {0xFD27, 6093, 2},
+        {0xFD28, 6095, 2},
+        {0xFD29, 6097, 2},
+        {0xFD2A, 6099, 2},
+        {0xFD2B, 6101, 2},
+        {0xFD2C, 6103, 2},
+        {0xFD2D, 6105, 2},
+        {0xFD2E, 6107, 2},
+        {0xFD2F, 6109, 2},
+        {0xFD30, 6111, 2},
+        {0xFD31, 6113, 2},
+        {0xFD32, 6115, 2},
+        {0xFD33, 6117, 2},
+        {0xFD34, 6119, 2},
+        {0xFD35, 6121, 2},
+        {0xFD36, 6123, 2},
+        {0xFD37, 6125, 2},
+        {0xFD38, 6127, 2},
+        {0xFD39, 6129, 2},
+        {0xFD3A, 6131, 2},
+        {0xFD3B, 6133, 2},
+        {0xFD3C, 6135, 2},
+        {0xFD3D, 6137, 2},
+        {0xFD50, 6139, 3},
+        {0xFD51, 6142, 3},
+        {0xFD52, 6145, 3},
+        {0xFD53, 6148, 3},
+        {0xFD54, 6151, 3},
+        {0xFD55, 6154, 3},
+        {0xFD56, 6157, 3},
+        {0xFD57, 6160, 3},
+        {0xFD58, 6163, 3},
+        {0xFD59, 6166, 3},
+        {0xFD5A, 6169, 3},
+        {0xFD5B, 6172, 3},
+        {0xFD5C, 6175, 3},
+        {0xFD5D, 6178, 3},
+        {0xFD5E, 6181, 3},
+        {0xFD5F, 6184, 3},
+        {0xFD60, 6187, 3},
+        {0xFD61, 6190, 3},
+        {0xFD62, 6193, 3},
+        {0xFD63, 6196, 3},
+        {0xFD64, 6199, 3},
+        {0xFD65, 6202, 3},
+        {0xFD66, 6205, 3},
+        {0xFD67, 6208, 3},
+        {0xFD68, 6211, 3},
+        {0xFD69, 6214, 3},
+        {0xFD6A, 6217, 3},
+        {0xFD6B, 6220, 3},
+        {0xFD6C, 6223, 3},
+        {0xFD6D, 6226, 3},
+        {0xFD6E, 6229, 3},
+        {0xFD6F, 6232, 3},
+        {0xFD70, 6235, 3},
+        {0xFD71, 6238, 3},
+        {0xFD72, 6241, 3},
+        {0xFD73, 6244, 3},
+        {0xFD74, 6247, 3},
+        {0xFD75, 6250, 3},
+        {0xFD76, 6253, 3},
+        {0xFD77, 6256, 3},
+        {0xFD78, 6259, 3},
+        {0xFD79, 6262, 3},
+        {0xFD7A, 6265, 3},
+        {0xFD7B, 6268, 3},
+        {0xFD7C, 6271, 3},
+        {0xFD7D, 6274, 3},
+        {0xFD7E, 6277, 3},
+        {0xFD7F, 6280, 3},
+        {0xFD80, 6283, 3},
+        {0xFD81, 6286, 3},
+        {0xFD82, 6289, 3},
+        {0xFD83, 6292, 3},
+        {0xFD84, 6295, 3},
+        {0xFD85, 6298, 3},
+        {0xFD86, 6301, 3},
+        {0xFD87, 6304, 3},
+        {0xFD88, 6307, 3},
+        {0xFD89, 6310, 3},
+        {0xFD8A, 6313, 3},
+        {0xFD8B, 6316, 3},
+        {0xFD8C, 6319, 3},
+        {0xFD8D, 6322, 3},
+        {0xFD8E, 6325, 3},
+        {0xFD8F, 6328, 3},
+        {0xFD92, 6331, 3},
+        {0xFD93, 6334, 3},
+        {0xFD94, 6337, 3},
+        {0xFD95, 6340, 3},
+        {0xFD96, 6343, 3},
+        {0xFD97, 6346, 3},
+        {0xFD98, 6349, 3},
+        {0xFD99, 6352, 3},
+        {0xFD9A, 6355, 3},
+        {0xFD9B, 6358, 3},
+        {0xFD9C, 6361, 3},
+        {0xFD9D, 6364, 3},
+        {0xFD9E, 6367, 3},
+        {0xFD9F, 6370, 3},
+        {0xFDA0, 6373, 3},
+        {0xFDA1, 6376, 3},
+        {0xFDA2, 6379, 3},
+        {0xFDA3, 6382, 3},
+        {0xFDA4, 6385, 3},
+        {0xFDA5, 6388, 3},
+        {0xFDA6, 6391, 3},
+        {0xFDA7, 6394, 3},
+        {0xFDA8, 6397, 3},
+        {0xFDA9, 6400, 3},
+        {0xFDAA, 6403, 3},
+        {0xFDAB, 6406, 3},
+        {0xFDAC, 6409, 3},
+        {0xFDAD, 6412, 3},
+        {0xFDAE, 6415, 3},
+        {0xFDAF, 6418, 3},
+        {0xFDB0, 6421, 3},
+        {0xFDB1, 6424, 3},
+        {0xFDB2, 6427, 3},
+        {0xFDB3, 6430, 3},
+        {0xFDB4, 6433, 3},
+        {0xFDB5, 6436, 3},
+        {0xFDB6, 6439, 3},
+        {0xFDB7, 6442, 3},
+        {0xFDB8, 6445, 3},
+        {0xFDB9, 6448, 3},
+        {0xFDBA, 6451, 3},
+        {0xFDBB, 6454, 3},
+        {0xFDBC, 6457, 3},
+        {0xFDBD, 6460, 3},
+        {0xFDBE, 6463, 3},
+        {0xFDBF, 6466, 3},
+        {0xFDC0, 6469, 3},
+        {0xFDC1, 6472, 3},
+        {0xFDC2, 6475, 3},
+        {0xFDC3, 6478, 3},
+        {0xFDC4, 6481, 3},
+        {0xFDC5, 6484, 3},
+        {0xFDC6, 6487, 3},
+        {0xFDC7, 6490, 3},
+        {0xFDF0, 6493, 3},
+        {0xFDF1, 6496, 3},
+        {0xFDF2, 6499, 4},
+        {0xFDF3, 6503, 4},
+        {0xFDF4, 6507, 4},
+        {0xFDF5, 6511, 4},
+        {0xFDF6, 6515, 4},
+        {0xFDF7, 6519, 4},
+        {0xFDF8, 6523, 4},
+        {0xFDF9, 6527, 3},
+        {0xFDFA, 6530, 18},
+        {0xFDFB, 6548, 8},
+        {0xFDFC, 6556, 4},
+        {0xFE10, 6560, 1},
+        {0xFE11, 6561, 1},
+        {0xFE12, 6562, 1},
+        {0xFE13, 6563, 1},
+        {0xFE14, 6564, 1},
+        {0xFE15, 6565, 1},
+        {0xFE16, 6566, 1},
+        {0xFE17, 6567, 1},
+        {0xFE18, 6568, 1},
+        {0xFE19, 6569, 3},
+        {0xFE30, 6572, 2},
+        {0xFE31, 6574, 1},
+        {0xFE32, 6575, 1},
+        {0xFE33, 6576, 1},
+        {0xFE34, 6577, 1},
+        {0xFE35, 6578, 1},
+        {0xFE36, 6579, 1},
+        {0xFE37, 6580, 1},
+        {0xFE38, 6581, 1},
+        {0xFE39, 6582, 1},
+        {0xFE3A, 6583, 1},
+        {0xFE3B, 6584, 1},
+        {0xFE3C, 6585, 1},
+        {0xFE3D, 6586, 1},
+        {0xFE3E, 6587, 1},
+        {0xFE3F, 6588, 1},
+        {0xFE40, 6589, 1},
+        {0xFE41, 6590, 1},
+        {0xFE42, 6591, 1},
+        {0xFE43, 6592, 1},
+        {0xFE44, 6593, 1},
+        {0xFE47, 6594, 1},
+        {0xFE48, 6595, 1},
+        {0xFE49, 6596, 2},
+        {0xFE4A, 6598, 2},
+        {0xFE4B, 6600, 2},
+        {0xFE4C, 6602, 2},
+        {0xFE4D, 6604, 1},
+        {0xFE4E, 6605, 1},
+        {0xFE4F, 6606, 1},
+        {0xFE50, 6607, 1},
+        {0xFE51, 6608, 1},
+        {0xFE52, 6609, 1},
+        {0xFE54, 6610, 1},
+        {0xFE55, 6611, 1},
+        {0xFE56, 6612, 1},
+        {0xFE57, 6613, 1},
+        {0xFE58, 6614, 1},
+        {0xFE59, 6615, 1},
+        {0xFE5A, 6616, 1},
+        {0xFE5B, 6617, 1},
+        {0xFE5C, 6618, 1},
+        {0xFE5D, 6619, 1},
+        {0xFE5E, 6620, 1},
+        {0xFE5F, 6621, 1},
+        {0xFE60, 6622, 1},
+        {0xFE61, 6623, 1},
+        {0xFE62, 6624, 1},
+        {0xFE63, 6625, 1},
+        {0xFE64, 6626, 1},
+        {0xFE65, 6627, 1},
+        {0xFE66, 6628, 1},
+        {0xFE68, 6629, 1},
+        {0xFE69, 6630, 1},
+        {0xFE6A, 6631, 1},
+        {0xFE6B, 6632, 1},
+        {0xFE70, 6633, 2},
+        {0xFE71, 6635, 2},
+        {0xFE72, 6637, 2},
+        {0xFE74, 6639, 2},
+        {0xFE76, 6641, 2},
+        {0xFE77, 6643, 2},
+        {0xFE78, 6645, 2},
+        {0xFE79, 6647, 2},
+        {0xFE7A, 6649, 2},
+        {0xFE7B, 6651, 2},
+        {0xFE7C, 6653, 2},
+        {0xFE7D, 6655, 2},
+        {0xFE7E, 6657, 2},
+        {0xFE7F, 6659, 2},
+        {0xFE80, 6661, 1},
+        {0xFE81, 6662, 2},
+        {0xFE82, 6664, 2},
+        {0xFE83, 6666, 2},
+        {0xFE84, 6668, 2},
+        {0xFE85, 6670, 2},
+        {0xFE86, 6672, 2},
+        {0xFE87, 6674, 2},
+        {0xFE88, 6676, 2},
+        {0xFE89, 6678, 2},
+        {0xFE8A, 6680, 2},
+        {0xFE8B, 6682, 2},
+        {0xFE8C, 6684, 2},
+        {0xFE8D, 6686, 1},
+        {0xFE8E, 6687, 1},
+        {0xFE8F, 6688, 1},
+        {0xFE90, 6689, 1},
+        {0xFE91, 6690, 1},
+        {0xFE92, 6691, 1},
+        {0xFE93, 6692, 1},
+        {0xFE94, 6693, 1},
+        {0xFE95, 6694, 1},
+        {0xFE96, 6695, 1},
+        {0xFE97, 6696, 1},
+        {0xFE98, 6697, 1},
+        {0xFE99, 6698, 1},
+        {0xFE9A, 6699, 1},
+        {0xFE9B, 6700, 1},
+        {0xFE9C, 6701, 1},
+        {0xFE9D, 6702, 1},
+        {0xFE9E, 6703, 1},
+        {0xFE9F, 6704, 1},
+        {0xFEA0, 6705, 1},
+        {0xFEA1, 6706, 1},
+        {0xFEA2, 6707, 1},
+        {0xFEA3, 6708, 1},
+        {0xFEA4, 6709, 1},
+        {0xFEA5, 6710, 1},
+        {0xFEA6, 6711, 1},
+        {0xFEA7, 6712, 1},
+        {0xFEA8, 6713, 1},
+        {0xFEA9, 6714, 1},
+        {0xFEAA, 6715, 1},
+        {0xFEAB, 6716, 1},
+        {0xFEAC, 6717, 1},
+        {0xFEAD, 6718, 1},
+        {0xFEAE, 6719, 1},
+        {0xFEAF, 6720, 1},
+        {0xFEB0, 6721, 1},
+        {0xFEB1, 6722, 1},
+        {0xFEB2, 6723, 1},
+        {0xFEB3, 6724, 1},
+        {0xFEB4, 6725, 1},
+        {0xFEB5, 6726, 1},
+        {0xFEB6, 6727, 1},
+        {0xFEB7, 6728, 1},
+        {0xFEB8, 6729, 1},
+        {0xFEB9, 6730, 1},
+        {0xFEBA, 6731, 1},
+        {0xFEBB, 6732, 1},
+        {0xFEBC, 6733, 1},
+        {0xFEBD, 6734, 1},
+        {0xFEBE, 6735, 1},
+        {0xFEBF, 6736, 1},
+        {0xFEC0, 6737, 1},
+        {0xFEC1, 6738, 1},
+        {0xFEC2, 6739, 1},
+        {0xFEC3, 6740, 1},
+        {0xFEC4, 6741, 1},
+        {0xFEC5, 6742, 1},
+        {0xFEC6, 6743, 1},
+        {0xFEC7, 6744, 1},
+        {0xFEC8, 6745, 1},
+        {0xFEC9, 6746, 1},
+        {0xFECA, 6747, 1},
+        {0xFECB, 6748, 1},
+        {0xFECC, 6749, 1},
+        {0xFECD, 6750, 1},
+        {0xFECE, 6751, 1},
+        {0xFECF, 6752, 1},
+        {0xFED0, 6753, 1},
+        {0xFED1, 6754, 1},
+        {0xFED2, 6755, 1},
+        {0xFED3, 6756, 1},
+        {0xFED4, 6757, 1},
+        {0xFED5, 6758, 1},
+        {0xFED6, 6759, 1},
+        {0xFED7, 6760, 1},
+        {0xFED8, 6761, 1},
+        {0xFED9, 6762, 1},
+        {0xFEDA, 6763, 1},
+        {0xFEDB, 6764, 1},
+        {0xFEDC, 6765, 1},
+        {0xFEDD, 6766, 1},
+        {0xFEDE, 6767, 1},
+        {0xFEDF, 6768, 1},
+        {0xFEE0, 6769, 1},
+        {0xFEE1, 6770, 1},
+        {0xFEE2, 6771, 1},
+        {0xFEE3, 6772, 1},
+        {0xFEE4, 6773, 1},
+        {0xFEE5, 6774, 1},
+        {0xFEE6, 6775, 1},
+        {0xFEE7, 6776, 1},
+        {0xFEE8, 6777, 1},
+        {0xFEE9, 6778, 1},
+        {0xFEEA, 6779, 1},
+        {0xFEEB, 6780, 1},
+        {0xFEEC, 6781, 1},
+        {0xFEED, 6782, 1},
+        {0xFEEE, 6783, 1},
+        {0xFEEF, 6784, 1},
+        {0xFEF0, 6785, 1},
+        {0xFEF1, 6786, 1},
+        {0xFEF2, 6787, 1},
+        {0xFEF3, 6788, 1},
+        {0xFEF4, 6789, 1},
+        {0xFEF5, 6790, 3},
+        {0xFEF6, 6793, 3},
+        {0xFEF7, 6796, 3},
+        {0xFEF8, 6799, 3},
+        {0xFEF9, 6802, 3},
+        {0xFEFA, 6805, 3},
+        {0xFEFB, 6808, 2},
+        {0xFEFC, 6810, 2},
+        {0xFF01, 6812, 1},
+        {0xFF02, 6813, 1},
+        {0xFF03, 6814, 1},
+        {0xFF04, 6815, 1},
+        {0xFF05, 6816, 1},
+        {0xFF06, 6817, 1},
+        {0xFF07, 6818, 1},
+        {0xFF08, 6819, 1},
+        {0xFF09, 6820, 1},
+        {0xFF0A, 6821, 1},
+        {0xFF0B, 6822, 1},
+        {0xFF0C, 6823, 1},
+        {0xFF0D, 6824, 1},
+        {0xFF0E, 6825, 1},
+        {0xFF0F, 6826, 1},
+        {0xFF10, 6827, 1},
+        {0xFF11, 6828, 1},
+        {0xFF12, 6829, 1},
+        {0xFF13, 6830, 1},
+        {0xFF14, 6831, 1},
+        {0xFF15, 6832, 1},
+        {0xFF16, 6833, 1},
+        {0xFF17, 6834, 1},
+        {0xFF18, 6835, 1},
+        {0xFF19, 6836, 1},
+        {0xFF1A, 6837, 1},
+        {0xFF1B, 6838, 1},
+        {0xFF1C, 6839, 1},
+        {0xFF1D, 6840, 1},
+        {0xFF1E, 6841, 1},
+        {0xFF1F, 6842, 1},
+        {0xFF20, 6843, 1},
+        {0xFF21, 6844, 1},
+        {0xFF22, 6845, 1},
+        {0xFF23, 6846, 1},
+        {0xFF24, 6847, 1},
+        {0xFF25, 6848, 1},
+        {0xFF26, 6849, 1},
+        {0xFF27, 6850, 1},
+        {0xFF28, 6851, 1},
+        {0xFF29, 6852, 1},
+        {0xFF2A, 6853, 1},
+        {0xFF2B, 6854, 1},
+        {0xFF2C, 6855, 1},
+        {0xFF2D, 6856, 1},
+        {0xFF2E, 6857, 1},
+        {0xFF2F, 6858, 1},
+        {0xFF30, 6859, 1},
+        {0xFF31, 6860, 1},
+        {0xFF32, 6861, 1},
+        {0xFF33, 6862, 1},
+        {0xFF34, 6863, 1},
+        {0xFF35, 6864, 1},
+        {0xFF36, 6865, 1},
+        {0xFF37, 6866, 1},
+        {0xFF38, 6867, 1},
+        {0xFF39, 6868, 1},
+        {0xFF3A, 6869, 1},
+        {0xFF3B, 6870, 1},
+        {0xFF3C, 6871, 1},
+        {0xFF3D, 6872, 1},
+        {0xFF3E, 6873, 1},
+        {0xFF3F, 6874, 1},
+        {0xFF40, 6875, 1},
+        {0xFF41, 6876, 1},
+        {0xFF42, 6877, 1},
+        {0xFF43, 6878, 1},
+        {0xFF44, 6879, 1},
+        {0xFF45, 6880, 1},
+        {0xFF46, 6881, 1},
+        {0xFF47, 6882, 1},
+        {0xFF48, 6883, 1},
+        {0xFF49, 6884, 1},
+        {0xFF4A, 6885, 1},
+        {0xFF4B, 6886, 1},
+        {0xFF4C, 6887, 1},
+        {0xFF4D, 6888, 1},
+        {0xFF4E, 6889, 1},
+        {0xFF4F, 6890, 1},
+        {0xFF50, 6891, 1},
+        {0xFF51, 6892, 1},
+        {0xFF52, 6893, 1},
+        {0xFF53, 6894, 1},
+        {0xFF54, 6895, 1},
+        {0xFF55, 6896, 1},
+        {0xFF56, 6897, 1},
+        {0xFF57, 6898, 1},
+        {0xFF58, 6899, 1},
+        {0xFF59, 6900, 1},
+        {0xFF5A, 6901, 1},
+        {0xFF5B, 6902, 1},
+        {0xFF5C, 6903, 1},
+        {0xFF5D, 6904, 1},
+        {0xFF5E, 6905, 1},
+        {0xFF5F, 6906, 1},
+        {0xFF60, 6907, 1},
+        {0xFF61, 6908, 1},
+        {0xFF62, 6909, 1},
+        {0xFF63, 6910, 1},
+        {0xFF64, 6911, 1},
+        {0xFF65, 6912, 1},
+        {0xFF66, 6913, 1},
+        {0xFF67, 6914, 1},
+        {0xFF68, 6915, 1},
+        {0xFF69, 6916, 1},
+        {0xFF6A, 6917, 1},
+        {0xFF6B, 6918, 1},
+        {0xFF6C, 6919, 1},
+        {0xFF6D, 6920, 1},
+        {0xFF6E, 6921, 1},
+        {0xFF6F, 6922, 1},
+        {0xFF70, 6923, 1},
+        {0xFF71, 6924, 1},
+        {0xFF72, 6925, 1},
+        {0xFF73, 6926, 1},
+        {0xFF74, 6927, 1},
+        {0xFF75, 6928, 1},
+        {0xFF76, 6929, 1},
+        {0xFF77, 6930, 1},
+        {0xFF78, 6931, 1},
+        {0xFF79, 6932, 1},
+        {0xFF7A, 6933, 1},
+        {0xFF7B, 6934, 1},
+        {0xFF7C, 6935, 1},
+        {0xFF7D, 6936, 1},
+        {0xFF7E, 6937, 1},
+        {0xFF7F, 6938, 1},
+        {0xFF80, 6939, 1},
+        {0xFF81, 6940, 1},
+        {0xFF82, 6941, 1},
+        {0xFF83, 6942, 1},
+        {0xFF84, 6943, 1},
+        {0xFF85, 6944, 1},
+        {0xFF86, 6945, 1},
+        {0xFF87, 6946, 1},
+        {0xFF88, 6947, 1},
+        {0xFF89, 6948, 1},
+        {0xFF8A, 6949, 1},
+        {0xFF8B, 6950, 1},
+        {0xFF8C, 6951, 1},
+        {0xFF8D, 6952, 1},
+        {0xFF8E, 6953, 1},
+        {0xFF8F, 6954, 1},
+        {0xFF90, 6955, 1},
+        {0xFF91, 6956, 1},
+        {0xFF92, 6957, 1},
+        {0xFF93, 6958, 1},
+        {0xFF94, 6959, 1},
+        {0xFF95, 6960, 1},
+        {0xFF96, 6961, 1},
+        {0xFF97, 6962, 1},
+        {0xFF98, 6963, 1},
+        {0xFF99, 6964, 1},
+        {0xFF9A, 6965, 1},
+        {0xFF9B, 6966, 1},
+        {0xFF9C, 6967, 1},
+        {0xFF9D, 6968, 1},
+        {0xFF9E, 6969, 1},
+        {0xFF9F, 6970, 1},
+        {0xFFA0, 6971, 1},
+        {0xFFA1, 6972, 1},
+        {0xFFA2, 6973, 1},
+        {0xFFA3, 6974, 1},
+        {0xFFA4, 6975, 1},
+        {0xFFA5, 6976, 1},
+        {0xFFA6, 6977, 1},
+        {0xFFA7, 6978, 1},
+        {0xFFA8, 6979, 1},
+        {0xFFA9, 6980, 1},
+        {0xFFAA, 6981, 1},
+        {0xFFAB, 6982, 1},
+        {0xFFAC, 6983, 1},
+        {0xFFAD, 6984, 1},
+        {0xFFAE, 6985, 1},
+        {0xFFAF, 6986, 1},
+        {0xFFB0, 6987, 1},
+        {0xFFB1, 6988, 1},
+        {0xFFB2, 6989, 1},
+        {0xFFB3, 6990, 1},
+        {0xFFB4, 6991, 1},
+        {0xFFB5, 6992, 1},
+        {0xFFB6, 6993, 1},
+        {0xFFB7, 6994, 1},
+        {0xFFB8, 6995, 1},
+        {0xFFB9, 6996, 1},
+        {0xFFBA, 6997, 1},
+        {0xFFBB, 6998, 1},
+        {0xFFBC, 6999, 1},
+        {0xFFBD, 7000, 1},
+        {0xFFBE, 7001, 1},
+        {0xFFC2, 7002, 1},
+        {0xFFC3, 7003, 1},
+        {0xFFC4, 7004, 1},
+        {0xFFC5, 7005, 1},
+        {0xFFC6, 7006, 1},
+        {0xFFC7, 7007, 1},
+        {0xFFCA, 7008, 1},
+        {0xFFCB, 7009, 1},
+        {0xFFCC, 7010, 1},
+        {0xFFCD, 7011, 1},
+        {0xFFCE, 7012, 1},
+        {0xFFCF, 7013, 1},
+        {0xFFD2, 7014, 1},
+        {0xFFD3, 7015, 1},
+        {0xFFD4, 7016, 1},
+        {0xFFD5, 7017, 1},
+        {0xFFD6, 7018, 1},
+        {0xFFD7, 7019, 1},
+        {0xFFDA, 7020, 1},
+        {0xFFDB, 7021, 1},
+        {0xFFDC, 7022, 1},
+        {0xFFE0, 7023, 1},
+        {0xFFE1, 7024, 1},
+        {0xFFE2, 7025, 1},
+        {0xFFE3, 7026, 2},
+        {0xFFE4, 7028, 1},
+        {0xFFE5, 7029, 1},
+        {0xFFE6, 7030, 1},
+        {0xFFE8, 7031, 1},
+        {0xFFE9, 7032, 1},
+        {0xFFEA, 7033, 1},
+        {0xFFEB, 7034, 1},
+        {0xFFEC, 7035, 1},
+        {0xFFED, 7036, 1},
+        {0xFFEE, 7037, 1},
+        {0x10781, 7038, 1},
+        {0x10782, 7039, 1},
+        {0x10783, 7040, 1},
+        {0x10784, 7041, 1},
+        {0x10785, 7042, 1},
+        {0x10787, 7043, 1},
+        {0x10788, 7044, 1},
+        {0x10789, 7045, 1},
+        {0x1078A, 7046, 1},
+        {0x1078B, 7047, 1},
+        {0x1078C, 7048, 1},
+        {0x1078D, 7049, 1},
+        {0x1078E, 7050, 1},
+        {0x1078F, 7051, 1},
+        {0x10790, 7052, 1},
+        {0x10791, 7053, 1},
+        {0x10792, 7054, 1},
+        {0x10793, 7055, 1},
+        {0x10794, 7056, 1},
+        {0x10795, 7057, 1},
+        {0x10796, 7058, 1},
+        {0x10797, 7059, 1},
+        {0x10798, 7060, 1},
+        {0x10799, 7061, 1},
+        {0x1079A, 7062, 1},
+        {0x1079B, 7063, 1},
+        {0x1079C, 7064, 1},
+        {0x1079D, 7065, 1},
+        {0x1079E, 7066, 1},
+        {0x1079F, 7067, 1},
+        {0x107A0, 7068, 1},
+        {0x107A1, 7069, 1},
+        {0x107A2, 7070, 1},
+        {0x107A3, 7071, 1},
+        {0x107A4, 7072, 1},
+        {0x107A5, 7073, 1},
+        {0x107A6, 7074, 1},
+        {0x107A7, 7075, 1},
+        {0x107A8, 7076, 1},
+        {0x107A9, 7077, 1},
+        {0x107AA, 7078, 1},
+        {0x107AB, 7079, 1},
+        {0x107AC, 7080, 1},
+        {0x107AD, 7081, 1},
+        {0x107AE, 7082, 1},
+        {0x107AF, 7083, 1},
+        {0x107B0, 7084, 1},
+        {0x107B2, 7085, 1},
+        {0x107B3, 7086, 1},
+        {0x107B4, 7087, 1},
+        {0x107B5, 7088, 1},
+        {0x107B6, 7089, 1},
+        {0x107B7, 7090, 1},
+        {0x107B8, 7091, 1},
+        {0x107B9, 7092, 1},
+        {0x107BA, 7093, 1},
+        {0x1D400, 7155, 1},
+        {0x1D401, 7156, 1},
+        {0x1D402, 7157, 1},
+        {0x1D403, 7158, 1},
+        {0x1D404, 7159, 1},
+        {0x1D405, 7160, 1},
+        {0x1D406, 7161, 1},
+        {0x1D407, 7162, 1},
+        {0x1D408, 7163, 1},
+        {0x1D409, 7164, 1},
+        {0x1D40A, 7165, 1},
+        {0x1D40B, 7166, 1},
+        {0x1D40C, 7167, 1},
+        {0x1D40D, 7168, 1},
+        {0x1D40E, 7169, 1},
+        {0x1D40F, 7170, 1},
+        {0x1D410, 7171, 1},
+        {0x1D411, 7172, 1},
+        {0x1D412, 7173, 1},
+        {0x1D413, 7174, 1},
+        {0x1D414, 7175, 1},
+        {0x1D415, 7176, 1},
+        {0x1D416, 7177, 1},
+        {0x1D417, 7178, 1},
+        {0x1D418, 7179, 1},
+        {0x1D419, 7180, 1},
+        {0x1D41A, 7181, 1},
+        {0x1D41B, 7182, 1},
+        {0x1D41C, 7183, 1},
+        {0x1D41D, 7184, 1},
+        {0x1D41E, 7185, 1},
+        {0x1D41F, 7186, 1},
+        {0x1D420, 7187, 1},
+        {0x1D421, 7188, 1},
+        {0x1D422, 7189, 1},
+        {0x1D423, 7190, 1},
+        {0x1D424, 7191, 1},
+        {0x1D425, 7192, 1},
+        {0x1D426, 7193, 1},
+        {0x1D427, 7194, 1},
+        {0x1D428, 7195, 1},
+        {0x1D429, 7196, 1},
+        {0x1D42A, 7197, 1},
+        {0x1D42B, 7198, 1},
+        {0x1D42C, 7199, 1},
+        {0x1D42D, 7200, 1},
+        {0x1D42E, 7201, 1},
+        {0x1D42F, 7202, 1},
+        {0x1D430, 7203, 1},
+        {0x1D431, 7204, 1},
+        {0x1D432, 7205, 1},
+        {0x1D433, 7206, 1},
+        {0x1D434, 7207, 1},
+        {0x1D435, 7208, 1},
+        {0x1D436, 7209, 1},
+        {0x1D437, 7210, 1},
+        {0x1D438, 7211, 1},
+        {0x1D439, 7212, 1},
+        {0x1D43A, 7213, 1},
+        {0x1D43B, 7214, 1},
+        {0x1D43C, 7215, 1},
+        {0x1D43D, 7216, 1},
+        {0x1D43E, 7217, 1},
+        {0x1D43F, 7218, 1},
+        {0x1D440, 7219, 1},
+        {0x1D441, 7220, 1},
+        {0x1D442, 7221, 1},
+        {0x1D443, 7222, 1},
+        {0x1D444, 7223, 1},
+        {0x1D445, 7224, 1},
+        {0x1D446, 7225, 1},
+        {0x1D447, 7226, 1},
+        {0x1D448, 7227, 1},
+        {0x1D449, 7228, 1},
+        {0x1D44A, 7229, 1},
+        {0x1D44B, 7230, 1},
+        {0x1D44C, 7231, 1},
+        {0x1D44D, 7232, 1},
+        {0x1D44E, 7233, 1},
+        {0x1D44F, 7234, 1},
+        {0x1D450, 7235, 1},
+        {0x1D451, 7236, 1},
+        {0x1D452, 7237, 1},
+        {0x1D453, 7238, 1},
+        {0x1D454, 7239, 1},
+        {0x1D456, 7240, 1},
+        {0x1D457, 7241, 1},
+        {0x1D458, 7242, 1},
+        {0x1D459, 7243, 1},
+        {0x1D45A, 7244, 1},
+        {0x1D45B, 7245, 1},
+        {0x1D45C, 7246, 1},
+        {0x1D45D, 7247, 1},
+        {0x1D45E, 7248, 1},
+        {0x1D45F, 7249, 1},
+        {0x1D460, 7250, 1},
+        {0x1D461, 7251, 1},
+        {0x1D462, 7252, 1},
+        {0x1D463, 7253, 1},
+        {0x1D464, 7254, 1},
+        {0x1D465, 7255, 1},
+        {0x1D466, 7256, 1},
+        {0x1D467, 7257, 1},
+        {0x1D468, 7258, 1},
+        {0x1D469, 7259, 1},
+        {0x1D46A, 7260, 1},
+        {0x1D46B, 7261, 1},
+        {0x1D46C, 7262, 1},
+        {0x1D46D, 7263, 1},
+        {0x1D46E, 7264, 1},
+        {0x1D46F, 7265, 1},
+        {0x1D470, 7266, 1},
+        {0x1D471, 7267, 1},
+        {0x1D472, 7268, 1},
+        {0x1D473, 7269, 1},
+        {0x1D474, 7270, 1},
+        {0x1D475, 7271, 1},
+        {0x1D476, 7272, 1},
+        {0x1D477, 7273, 1},
+        {0x1D478, 7274, 1},
+        {0x1D479, 7275, 1},
+        {0x1D47A, 7276, 1},
+        {0x1D47B, 7277, 1},
+        {0x1D47C, 7278, 1},
+        {0x1D47D, 7279, 1},
+        {0x1D47E, 7280, 1},
+        {0x1D47F, 7281, 1},
+        {0x1D480, 7282, 1},
+        {0x1D481, 7283, 1},
+        {0x1D482, 7284, 1},
+        {0x1D483, 7285, 1},
+        {0x1D484, 7286, 1},
+        {0x1D485, 7287, 1},
+        {0x1D486, 7288, 1},
+        {0x1D487, 7289, 1},
+        {0x1D488, 7290, 1},
+        {0x1D489, 7291, 1},
+        {0x1D48A, 7292, 1},
+        {0x1D48B, 7293, 1},
+        {0x1D48C, 7294, 1},
+        {0x1D48D, 7295, 1},
+        {0x1D48E, 7296, 1},
+        {0x1D48F, 7297, 1},
+        {0x1D490, 7298, 1},
+        {0x1D491, 7299, 1},
+        {0x1D492, 7300, 1},
+        {0x1D493, 7301, 1},
+        {0x1D494, 7302, 1},
+        {0x1D495, 7303, 1},
+        {0x1D496, 7304, 1},
+        {0x1D497, 7305, 1},
+        {0x1D498, 7306, 1},
+        {0x1D499, 7307, 1},
+        {0x1D49A, 7308, 1},
+        {0x1D49B, 7309, 1},
+        {0x1D49C, 7310, 1},
+        {0x1D49E, 7311, 1},
+        {0x1D49F, 7312, 1},
+        {0x1D4A2, 7313, 1},
+        {0x1D4A5, 7314, 1},
+        {0x1D4A6, 7315, 1},
+        {0x1D4A9, 7316, 1},
+        {0x1D4AA, 7317, 1},
+        {0x1D4AB, 7318, 1},
+        {0x1D4AC, 7319, 1},
+        {0x1D4AE, 7320, 1},
+        {0x1D4AF, 7321, 1},
+        {0x1D4B0, 7322, 1},
+        {0x1D4B1, 7323, 1},
+        {0x1D4B2, 7324, 1},
+        {0x1D4B3, 7325, 1},
+        {0x1D4B4, 7326, 1},
+        {0x1D4B5, 7327, 1},
+        {0x1D4B6, 7328, 1},
+        {0x1D4B7, 7329, 1},
+        {0x1D4B8, 7330, 1},
+        {0x1D4B9, 7331, 1},
+        {0x1D4BB, 7332, 1},
+        {0x1D4BD, 7333, 1},
+        {0x1D4BE, 7334, 1},
+        {0x1D4BF, 7335, 1},
+        {0x1D4C0, 7336, 1},
+        {0x1D4C1, 7337, 1},
+        {0x1D4C2, 7338, 1},
+        {0x1D4C3, 7339, 1},
+        {0x1D4C5, 7340, 1},
+        {0x1D4C6, 7341, 1},
+        {0x1D4C7, 7342, 1},
+        {0x1D4C8, 7343, 1},
+        {0x1D4C9, 7344, 1},
+        {0x1D4CA, 7345, 1},
+        {0x1D4CB, 7346, 1},
+        {0x1D4CC, 7347, 1},
+        {0x1D4CD, 7348, 1},
+        {0x1D4CE, 7349, 1},
+        {0x1D4CF, 7350, 1},
+        {0x1D4D0, 7351, 1},
+        {0x1D4D1, 7352, 1},
+        {0x1D4D2, 7353, 1},
+        {0x1D4D3, 7354, 1},
+        {0x1D4D4, 7355, 1},
+        {0x1D4D5, 7356, 1},
+        {0x1D4D6, 7357, 1},
+        {0x1D4D7, 7358, 1},
+        {0x1D4D8, 7359, 1},
+        {0x1D4D9, 7360, 1},
+        {0x1D4DA, 7361, 1},
+        {0x1D4DB, 7362, 1},
+        {0x1D4DC, 7363, 1},
+        {0x1D4DD, 7364, 1},
+        {0x1D4DE, 7365, 1},
+        {0x1D4DF, 7366, 1},
+        {0x1D4E0, 7367, 1},
+        {0x1D4E1, 7368, 1},
+        {0x1D4E2, 7369, 1},
+        {0x1D4E3, 7370, 1},
+        {0x1D4E4, 7371, 1},
+        {0x1D4E5, 7372, 1},
+        {0x1D4E6, 7373, 1},
+        {0x1D4E7, 7374, 1},
+        {0x1D4E8, 7375, 1},
+        {0x1D4E9, 7376, 1},
+        {0x1D4EA, 7377, 1},
+        {0x1D4EB, 7378, 1},
+        {0x1D4EC, 7379, 1},
+        {0x1D4ED, 7380, 1},
+        {0x1D4EE, 7381, 1},
+        {0x1D4EF, 7382, 1},
+        {0x1D4F0, 7383, 1},
+        {0x1D4F1, 7384, 1},
+        {0x1D4F2, 7385, 1},
+        {0x1D4F3, 7386, 1},
+        {0x1D4F4, 7387, 1},
+        {0x1D4F5, 7388, 1},
+        {0x1D4F6, 7389, 1},
+        {0x1D4F7, 7390, 1},
+        {0x1D4F8, 7391, 1},
+        {0x1D4F9, 7392, 1},
+        {0x1D4FA, 7393, 1},
+        {0x1D4FB, 7394, 1},
+        {0x1D4FC, 7395, 1},
+        {0x1D4FD, 7396, 1},
+        {0x1D4FE, 7397, 1},
+        {0x1D4FF, 7398, 1},
+        {0x1D500, 7399, 1},
+        {0x1D501, 7400, 1},
+        {0x1D502, 7401, 1},
+        {0x1D503, 7402, 1},
+        {0x1D504, 7403, 1},
+        {0x1D505, 7404, 1},
+        {0x1D507, 7405, 1},
+        {0x1D508, 7406, 1},
+        {0x1D509, 7407, 1},
+        {0x1D50A, 7408, 1},
+        {0x1D50D, 7409, 1},
+        {0x1D50E, 7410, 1},
+        {0x1D50F, 7411, 1},
+        {0x1D510, 7412, 1},
+        {0x1D511, 7413, 1},
+        {0x1D512, 7414, 1},
+        {0x1D513, 7415, 1},
+        {0x1D514, 7416, 1},
+        {0x1D516, 7417, 1},
+        {0x1D517, 7418, 1},
+        {0x1D518, 7419, 1},
+        {0x1D519, 7420, 1},
+        {0x1D51A, 7421, 1},
+        {0x1D51B, 7422, 1},
+        {0x1D51C, 7423, 1},
+        {0x1D51E, 7424, 1},
+        {0x1D51F, 7425, 1},
+        {0x1D520, 7426, 1},
+        {0x1D521, 7427, 1},
+        {0x1D522, 7428, 1},
+        {0x1D523, 7429, 1},
+        {0x1D524, 7430, 1},
+        {0x1D525, 7431, 1},
+        {0x1D526, 7432, 1},
+        {0x1D527, 7433, 1},
+        {0x1D528, 7434, 1},
+        {0x1D529, 7435, 1},
+        {0x1D52A, 7436, 1},
+        {0x1D52B, 7437, 1},
+        {0x1D52C, 7438, 1},
+        {0x1D52D, 7439, 1},
+        {0x1D52E, 7440, 1},
+        {0x1D52F, 7441, 1},
+        {0x1D530, 7442, 1},
+        {0x1D531, 7443, 1},
+        {0x1D532, 7444, 1},
+        {0x1D533, 7445, 1},
+        {0x1D534, 7446, 1},
+        {0x1D535, 7447, 1},
+        {0x1D536, 7448, 1},
+        {0x1D537, 7449, 1},
+        {0x1D538, 7450, 1},
+        {0x1D539, 7451, 1},
+        {0x1D53B, 7452, 1},
+        {0x1D53C, 7453, 1},
+        {0x1D53D, 7454, 1},
+        {0x1D53E, 7455, 1},
+        {0x1D540, 7456, 1},
+        {0x1D541, 7457, 1},
+        {0x1D542, 7458, 1},
+        {0x1D543, 7459, 1},
+        {0x1D544, 7460, 1},
+        {0x1D546, 7461, 1},
+        {0x1D54A, 7462, 1},
+        {0x1D54B, 7463, 1},
+        {0x1D54C, 7464, 1},
+        {0x1D54D, 7465, 1},
+        {0x1D54E, 7466, 1},
+        {0x1D54F, 7467, 1},
+        {0x1D550, 7468, 1},
+        {0x1D552, 7469, 1},
+        {0x1D553, 7470, 1},
+        {0x1D554, 7471, 1},
+        {0x1D555, 7472, 1},
+        {0x1D556, 7473, 1},
+        {0x1D557, 7474, 1},
+        {0x1D558, 7475, 1},
+        {0x1D559, 7476, 1},
+        {0x1D55A, 7477, 1},
+        {0x1D55B, 7478, 1},
+        {0x1D55C, 7479, 1},
+        {0x1D55D, 7480, 1},
+        {0x1D55E, 7481, 1},
+        {0x1D55F, 7482, 1},
+        {0x1D560, 7483, 1},
+        {0x1D561, 7484, 1},
+        {0x1D562, 7485, 1},
+        {0x1D563, 7486, 1},
+        {0x1D564, 7487, 1},
+        {0x1D565, 7488, 1},
+        {0x1D566, 7489, 1},
+        {0x1D567, 7490, 1},
+        {0x1D568, 7491, 1},
+        {0x1D569, 7492, 1},
+        {0x1D56A, 7493, 1},
+        {0x1D56B, 7494, 1},
+        {0x1D56C, 7495, 1},
+        {0x1D56D, 7496, 1},
+        {0x1D56E, 7497, 1},
+        {0x1D56F, 7498, 1},
+        {0x1D570, 7499, 1},
+        {0x1D571, 7500, 1},
+        {0x1D572, 7501, 1},
+        {0x1D573, 7502, 1},
+        {0x1D574, 7503, 1},
+        {0x1D575, 7504, 1},
+        {0x1D576, 7505, 1},
+        {0x1D577, 7506, 1},
+        {0x1D578, 7507, 1},
+        {0x1D579, 7508, 1},
+        {0x1D57A, 7509, 1},
+        {0x1D57B, 7510, 1},
+        {0x1D57C, 7511, 1},
+        {0x1D57D, 7512, 1},
+        {0x1D57E, 7513, 1},
+        {0x1D57F, 7514, 1},
+        {0x1D580, 7515, 1},
+        {0x1D581, 7516, 1},
+        {0x1D582, 7517, 1},
+        {0x1D583, 7518, 1},
+        {0x1D584, 7519, 1},
+        {0x1D585, 7520, 1},
+        {0x1D586, 7521, 1},
+        {0x1D587, 7522, 1},
+        {0x1D588, 7523, 1},
+        {0x1D589, 7524, 1},
+        {0x1D58A, 7525, 1},
+        {0x1D58B, 7526, 1},
+        {0x1D58C, 7527, 1},
+        {0x1D58D, 7528, 1},
+        {0x1D58E, 7529, 1},
+        {0x1D58F, 7530, 1},
+        {0x1D590, 7531, 1},
+        {0x1D591, 7532, 1},
+        {0x1D592, 7533, 1},
+        {0x1D593, 7534, 1},
+        {0x1D594, 7535, 1},
+        {0x1D595, 7536, 1},
+        {0x1D596, 7537, 1},
+        {0x1D597, 7538, 1},
+        {0x1D598, 7539, 1},
+        {0x1D599, 7540, 1},
+        {0x1D59A, 7541, 1},
+        {0x1D59B, 7542, 1},
+        {0x1D59C, 7543, 1},
+        {0x1D59D, 7544, 1},
+        {0x1D59E, 7545, 1},
+        {0x1D59F, 7546, 1},
+        {0x1D5A0, 7547, 1},
+        {0x1D5A1, 7548, 1},
+        {0x1D5A2, 7549, 1},
+        {0x1D5A3, 7550, 1},
+        {0x1D5A4, 7551, 1},
+        {0x1D5A5, 7552, 1},
+        {0x1D5A6, 7553, 1},
+        {0x1D5A7, 7554, 1},
+        {0x1D5A8, 7555, 1},
+        {0x1D5A9, 7556, 1},
+        {0x1D5AA, 7557, 1},
+        {0x1D5AB, 7558, 1},
+        {0x1D5AC, 7559, 1},
+        {0x1D5AD, 7560, 1},
+        {0x1D5AE, 7561, 1},
+        {0x1D5AF, 7562, 1},
+        {0x1D5B0, 7563, 1},
+        {0x1D5B1, 7564, 1},
+        {0x1D5B2, 7565, 1},
+        {0x1D5B3, 7566, 1},
+        {0x1D5B4, 7567, 1},
+        {0x1D5B5, 7568, 1},
+        {0x1D5B6, 7569, 1},
+        {0x1D5B7, 7570, 1},
+        {0x1D5B8, 7571, 1},
+        {0x1D5B9, 7572, 1},
+        {0x1D5BA, 7573, 1},
+        {0x1D5BB, 7574, 1},
+        {0x1D5BC, 7575, 1},
+        {0x1D5BD, 7576, 1},
+        {0x1D5BE, 7577, 1},
+        {0x1D5BF, 7578, 1},
+        {0x1D5C0, 7579, 1},
+        {0x1D5C1, 7580, 1},
+        {0x1D5C2, 7581, 1},
+        {0x1D5C3, 7582, 1},
+        {0x1D5C4, 7583, 1},
+        {0x1D5C5, 7584, 1},
+        {0x1D5C6, 7585, 1},
+        {0x1D5C7, 7586, 1},
+        {0x1D5C8, 7587, 1},
+        {0x1D5C9, 7588, 1},
+        {0x1D5CA, 7589, 1},
+        {0x1D5CB, 7590, 1},
+        {0x1D5CC, 7591, 1},
+        {0x1D5CD, 7592, 1},
+        {0x1D5CE, 7593, 1},
+        {0x1D5CF, 7594, 1},
+        {0x1D5D0, 7595, 1},
+        {0x1D5D1, 7596, 1},
+        {0x1D5D2, 7597, 1},
+        {0x1D5D3, 7598, 1},
+        {0x1D5D4, 7599, 1},
+        {0x1D5D5, 7600, 1},
+        {0x1D5D6, 7601, 1},
+        {0x1D5D7, 7602, 1},
+        {0x1D5D8, 7603, 1},
+        {0x1D5D9, 7604, 1},
+        {0x1D5DA, 7605, 1},
+        {0x1D5DB, 7606, 1},
+        {0x1D5DC, 7607, 1},
+        {0x1D5DD, 7608, 1},
+        {0x1D5DE, 7609, 1},
+        {0x1D5DF, 7610, 1},
+        {0x1D5E0, 7611, 1},
+        {0x1D5E1, 7612, 1},
+        {0x1D5E2, 7613, 1},
+        {0x1D5E3, 7614, 1},
+        {0x1D5E4, 7615, 1},
+        {0x1D5E5, 7616, 1},
+        {0x1D5E6, 7617, 1},
+        {0x1D5E7, 7618, 1},
+        {0x1D5E8, 7619, 1},
+        {0x1D5E9, 7620, 1},
+        {0x1D5EA, 7621, 1},
+        {0x1D5EB, 7622, 1},
+        {0x1D5EC, 7623, 1},
+        {0x1D5ED, 7624, 1},
+        {0x1D5EE, 7625, 1},
+        {0x1D5EF, 7626, 1},
+        {0x1D5F0, 7627, 1},
+        {0x1D5F1, 7628, 1},
+        {0x1D5F2, 7629, 1},
+        {0x1D5F3, 7630, 1},
+        {0x1D5F4, 7631, 1},
+        {0x1D5F5, 7632, 1},
+        {0x1D5F6, 7633, 1},
+        {0x1D5F7, 7634, 1},
+        {0x1D5F8, 7635, 1},
+        {0x1D5F9, 7636, 1},
+        {0x1D5FA, 7637, 1},
+        {0x1D5FB, 7638, 1},
+        {0x1D5FC, 7639, 1},
+        {0x1D5FD, 7640, 1},
+        {0x1D5FE, 7641, 1},
+        {0x1D5FF, 7642, 1},
+        {0x1D600, 7643, 1},
+        {0x1D601, 7644, 1},
+        {0x1D602, 7645, 1},
+        {0x1D603, 7646, 1},
+        {0x1D604, 7647, 1},
+        {0x1D605, 7648, 1},
+        {0x1D606, 7649, 1},
+        {0x1D607, 7650, 1},
+        {0x1D608, 7651, 1},
+        {0x1D609, 7652, 1},
+        {0x1D60A, 7653, 1},
+        {0x1D60B, 7654, 1},
+        {0x1D60C, 7655, 1},
+        {0x1D60D, 7656, 1},
+        {0x1D60E, 7657, 1},
+        {0x1D60F, 7658, 1},
+        {0x1D610, 7659, 1},
+        {0x1D611, 7660, 1},
+        {0x1D612, 7661, 1},
+        {0x1D613, 7662, 1},
+        {0x1D614, 7663, 1},
+        {0x1D615, 7664, 1},
+        {0x1D616, 7665, 1},
+        {0x1D617, 7666, 1},
+        {0x1D618, 7667, 1},
+        {0x1D619, 7668, 1},
+        {0x1D61A, 7669, 1},
+        {0x1D61B, 7670, 1},
+        {0x1D61C, 7671, 1},
+        {0x1D61D, 7672, 1},
+        {0x1D61E, 7673, 1},
+        {0x1D61F, 7674, 1},
+        {0x1D620, 7675, 1},
+        {0x1D621, 7676, 1},
+        {0x1D622, 7677, 1},
+        {0x1D623, 7678, 1},
+        {0x1D624, 7679, 1},
+        {0x1D625, 7680, 1},
+        {0x1D626, 7681, 1},
+        {0x1D627, 7682, 1},
+        {0x1D628, 7683, 1},
+        {0x1D629, 7684, 1},
+        {0x1D62A, 7685, 1},
+        {0x1D62B, 7686, 1},
+        {0x1D62C, 7687, 1},
+        {0x1D62D, 7688, 1},
+        {0x1D62E, 7689, 1},
+        {0x1D62F, 7690, 1},
+        {0x1D630, 7691, 1},
+        {0x1D631, 7692, 1},
+        {0x1D632, 7693, 1},
+        {0x1D633, 7694, 1},
+        {0x1D634, 7695, 1},
+        {0x1D635, 7696, 1},
+        {0x1D636, 7697, 1},
+        {0x1D637, 7698, 1},
+        {0x1D638, 7699, 1},
+        {0x1D639, 7700, 1},
+        {0x1D63A, 7701, 1},
+        {0x1D63B, 7702, 1},
+        {0x1D63C, 7703, 1},
+        {0x1D63D, 7704, 1},
+        {0x1D63E, 7705, 1},
+        {0x1D63F, 7706, 1},
+        {0x1D640, 7707, 1},
+        {0x1D641, 7708, 1},
+        {0x1D642, 7709, 1},
+        {0x1D643, 7710, 1},
+        {0x1D644, 7711, 1},
+        {0x1D645, 7712, 1},
+        {0x1D646, 7713, 1},
+        {0x1D647, 7714, 1},
+        {0x1D648, 7715, 1},
+        {0x1D649, 7716, 1},
+        {0x1D64A, 7717, 1},
+        {0x1D64B, 7718, 1},
+        {0x1D64C, 7719, 1},
+        {0x1D64D, 7720, 1},
+        {0x1D64E, 7721, 1},
+        {0x1D64F, 7722, 1},
+        {0x1D650, 7723, 1},
+        {0x1D651, 7724, 1},
+        {0x1D652, 7725, 1},
+        {0x1D653, 7726, 1},
+        {0x1D654, 7727, 1},
+        {0x1D655, 7728, 1},
+        {0x1D656, 7729, 1},
+        {0x1D657, 7730, 1},
+        {0x1D658, 7731, 1},
+        {0x1D659, 7732, 1},
+        {0x1D65A, 7733, 1},
+        {0x1D65B, 7734, 1},
+        {0x1D65C, 7735, 1},
+        {0x1D65D, 7736, 1},
+        {0x1D65E, 7737, 1},
+        {0x1D65F, 7738, 1},
+        {0x1D660, 7739, 1},
+        {0x1D661, 7740, 1},
+        {0x1D662, 7741, 1},
+        {0x1D663, 7742, 1},
+        {0x1D664, 7743, 1},
+        {0x1D665, 7744, 1},
+        {0x1D666, 7745, 1},
+        {0x1D667, 7746, 1},
+        {0x1D668, 7747, 1},
+        {0x1D669, 7748, 1},
+        {0x1D66A, 7749, 1},
+        {0x1D66B, 7750, 1},
+        {0x1D66C, 7751, 1},
+        {0x1D66D, 7752, 1},
+        {0x1D66E, 7753, 1},
+        {0x1D66F, 7754, 1},
+        {0x1D670, 7755, 1},
+        {0x1D671, 7756, 1},
+        {0x1D672, 7757, 1},
+        {0x1D673, 7758, 1},
+        {0x1D674, 7759, 1},
+        {0x1D675, 7760, 1},
+        {0x1D676, 7761, 1},
+        {0x1D677, 7762, 1},
+        {0x1D678, 7763, 1},
+        {0x1D679, 7764, 1},
+        {0x1D67A, 7765, 1},
+        {0x1D67B, 7766, 1},
+        {0x1D67C, 7767, 1},
+        {0x1D67D, 7768, 1},
+        {0x1D67E, 7769, 1},
+        {0x1D67F, 7770, 1},
+        {0x1D680, 7771, 1},
+        {0x1D681, 7772, 1},
+        {0x1D682, 7773, 1},
+        {0x1D683, 7774, 1},
+        {0x1D684, 7775, 1},
+        {0x1D685, 7776, 1},
+        {0x1D686, 7777, 1},
+        {0x1D687, 7778, 1},
+        {0x1D688, 7779, 1},
+        {0x1D689, 7780, 1},
+        {0x1D68A, 7781, 1},
+        {0x1D68B, 7782, 1},
+        {0x1D68C, 7783, 1},
+        {0x1D68D, 7784, 1},
+        {0x1D68E, 7785, 1},
+        {0x1D68F, 7786, 1},
+        {0x1D690, 7787, 1},
+        {0x1D691, 7788, 1},
+        {0x1D692, 7789, 1},
+        {0x1D693, 7790, 1},
+        {0x1D694, 7791, 1},
+        {0x1D695, 7792, 1},
+        {0x1D696, 7793, 1},
+        {0x1D697, 7794, 1},
+        {0x1D698, 7795, 1},
+        {0x1D699, 7796, 1},
+        {0x1D69A, 7797, 1},
+        {0x1D69B, 7798, 1},
+        {0x1D69C, 7799, 1},
+        {0x1D69D, 7800, 1},
+        {0x1D69E, 7801, 1},
+        {0x1D69F, 7802, 1},
+        {0x1D6A0, 7803, 1},
+        {0x1D6A1, 7804, 1},
+        {0x1D6A2, 7805, 1},
+        {0x1D6A3, 7806, 1},
+        {0x1D6A4, 7807, 1},
+        {0x1D6A5, 7808, 1},
+        {0x1D6A8, 7809, 1},
+        {0x1D6A9, 7810, 1},
+        {0x1D6AA, 7811, 1},
+        {0x1D6AB, 7812, 1},
+        {0x1D6AC, 7813, 1},
+        {0x1D6AD, 7814, 1},
+        {0x1D6AE, 7815, 1},
+        {0x1D6AF, 7816, 1},
+        {0x1D6B0, 7817, 1},
+        {0x1D6B1, 7818, 1},
+        {0x1D6B2, 7819, 1},
+        {0x1D6B3, 7820, 1},
+        {0x1D6B4, 7821, 1},
+        {0x1D6B5, 7822, 1},
+        {0x1D6B6, 7823, 1},
+        {0x1D6B7, 7824, 1},
+        {0x1D6B8, 7825, 1},
+        {0x1D6B9, 7826, 1},
+        {0x1D6BA, 7827, 1},
+        {0x1D6BB, 7828, 1},
+        {0x1D6BC, 7829, 1},
+        {0x1D6BD, 7830, 1},
+        {0x1D6BE, 7831, 1},
+        {0x1D6BF, 7832, 1},
+        {0x1D6C0, 7833, 1},
+        {0x1D6C1, 7834, 1},
+        {0x1D6C2, 7835, 1},
+        {0x1D6C3, 7836, 1},
+        {0x1D6C4, 7837, 1},
+        {0x1D6C5, 7838, 1},
+        {0x1D6C6, 7839, 1},
+        {0x1D6C7, 7840, 1},
+        {0x1D6C8, 7841, 1},
+        {0x1D6C9, 7842, 1},
+        {0x1D6CA, 7843, 1},
+        {0x1D6CB, 7844, 1},
+        {0x1D6CC, 7845, 1},
+        {0x1D6CD, 7846, 1},
+        {0x1D6CE, 7847, 1},
+        {0x1D6CF, 7848, 1},
+        {0x1D6D0, 7849, 1},
+        {0x1D6D1, 7850, 1},
+        {0x1D6D2, 7851, 1},
+        {0x1D6D3, 7852, 1},
+        {0x1D6D4, 7853, 1},
+        {0x1D6D5, 7854, 1},
+        {0x1D6D6, 7855, 1},
+        {0x1D6D7, 7856, 1},
+        {0x1D6D8, 7857, 1},
+        {0x1D6D9, 7858, 1},
+        {0x1D6DA, 7859, 1},
+        {0x1D6DB, 7860, 1},
+        {0x1D6DC, 7861, 1},
+        {0x1D6DD, 7862, 1},
+        {0x1D6DE, 7863, 1},
+        {0x1D6DF, 7864, 1},
+        {0x1D6E0, 7865, 1},
+        {0x1D6E1, 7866, 1},
+        {0x1D6E2, 7867, 1},
+        {0x1D6E3, 7868, 1},
+        {0x1D6E4, 7869, 1},
+        {0x1D6E5, 7870, 1},
+        {0x1D6E6, 7871, 1},
+        {0x1D6E7, 7872, 1},
+        {0x1D6E8, 7873, 1},
+        {0x1D6E9, 7874, 1},
+        {0x1D6EA, 7875, 1},
+        {0x1D6EB, 7876, 1},
+        {0x1D6EC, 7877, 1},
+        {0x1D6ED, 7878, 1},
+        {0x1D6EE, 7879, 1},
+        {0x1D6EF, 7880, 1},
+        {0x1D6F0, 7881, 1},
+        {0x1D6F1, 7882, 1},
+        {0x1D6F2, 7883, 1},
+        {0x1D6F3, 7884, 1},
+        {0x1D6F4, 7885, 1},
+        {0x1D6F5, 7886, 1},
+        {0x1D6F6, 7887, 1},
+        {0x1D6F7, 7888, 1},
+        {0x1D6F8, 7889, 1},
+        {0x1D6F9, 7890, 1},
+        {0x1D6FA, 7891, 1},
+        {0x1D6FB, 7892, 1},
+        {0x1D6FC, 7893, 1},
+        {0x1D6FD, 7894, 1},
+        {0x1D6FE, 7895, 1},
+        {0x1D6FF, 7896, 1},
+        {0x1D700, 7897, 1},
+        {0x1D701, 7898, 1},
+        {0x1D702, 7899, 1},
+        {0x1D703, 7900, 1},
+        {0x1D704, 7901, 1},
+        {0x1D705, 7902, 1},
+        {0x1D706, 7903, 1},
+        {0x1D707, 7904, 1},
+        {0x1D708, 7905, 1},
+        {0x1D709, 7906, 1},
+        {0x1D70A, 7907, 1},
+        {0x1D70B, 7908, 1},
+        {0x1D70C, 7909, 1},
+        {0x1D70D, 7910, 1},
+        {0x1D70E, 7911, 1},
+        {0x1D70F, 7912, 1},
+        {0x1D710, 7913, 1},
+        {0x1D711, 7914, 1},
+        {0x1D712, 7915, 1},
+        {0x1D713, 7916, 1},
+        {0x1D714, 7917, 1},
+        {0x1D715, 7918, 1},
+        {0x1D716, 7919, 1},
+        {0x1D717, 7920, 1},
+        {0x1D718, 7921, 1},
+        {0x1D719, 7922, 1},
+        {0x1D71A, 7923, 1},
+        {0x1D71B, 7924, 1},
+        {0x1D71C, 7925, 1},
+        {0x1D71D, 7926, 1},
+        {0x1D71E, 7927, 1},
+        {0x1D71F, 7928, 1},
+        {0x1D720, 7929, 1},
+        {0x1D721, 7930, 1},
+        {0x1D722, 7931, 1},
+        {0x1D723, 7932, 1},
+        {0x1D724, 7933, 1},
+        {0x1D725, 7934, 1},
+        {0x1D726, 7935, 1},
+        {0x1D727, 7936, 1},
+        {0x1D728, 7937, 1},
+        {0x1D729, 7938, 1},
+        {0x1D72A, 7939, 1},
+        {0x1D72B, 7940, 1},
+        {0x1D72C, 7941, 1},
+        {0x1D72D, 7942, 1},
+        {0x1D72E, 7943, 1},
+        {0x1D72F, 7944, 1},
+        {0x1D730, 7945, 1},
+        {0x1D731, 7946, 1},
+        {0x1D732, 7947, 1},
+        {0x1D733, 7948, 1},
+        {0x1D734, 7949, 1},
+        {0x1D735, 7950, 1},
+        {0x1D736, 7951, 1},
+        {0x1D737, 7952, 1},
+        {0x1D738, 7953, 1},
+        {0x1D739, 7954, 1},
+        {0x1D73A, 7955, 1},
+        {0x1D73B, 7956, 1},
+        {0x1D73C, 7957, 1},
+        {0x1D73D, 7958, 1},
+        {0x1D73E, 7959, 1},
+        {0x1D73F, 7960, 1},
+        {0x1D740, 7961, 1},
+        {0x1D741, 7962, 1},
+        {0x1D742, 7963, 1},
+        {0x1D743, 7964, 1},
+        {0x1D744, 7965, 1},
+        {0x1D745, 7966, 1},
+        {0x1D746, 7967, 1},
+        {0x1D747, 7968, 1},
+        {0x1D748, 7969, 1},
+        {0x1D749, 7970, 1},
+        {0x1D74A, 7971, 1},
+        {0x1D74B, 7972, 1},
+        {0x1D74C, 7973, 1},
+        {0x1D74D, 7974, 1},
+        {0x1D74E, 7975, 1},
+        {0x1D74F, 7976, 1},
+        {0x1D750, 7977, 1},
+        {0x1D751, 7978, 1},
+        {0x1D752, 7979, 1},
+        {0x1D753, 7980, 1},
+        {0x1D754, 7981, 1},
+        {0x1D755, 7982, 1},
+        {0x1D756, 7983, 1},
+        {0x1D757, 7984, 1},
+        {0x1D758, 7985, 1},
+        {0x1D759, 7986, 1},
+        {0x1D75A, 7987, 1},
+        {0x1D75B, 7988, 1},
+        {0x1D75C, 7989, 1},
+        {0x1D75D, 7990, 1},
+        {0x1D75E, 7991, 1},
+        {0x1D75F, 7992, 1},
+        {0x1D760, 7993, 1},
+        {0x1D761, 7994, 1},
+        {0x1D762, 7995, 1},
+        {0x1D763, 7996, 1},
+        {0x1D764, 7997, 1},
+        {0x1D765, 7998, 1},
+        {0x1D766, 7999, 1},
+        {0x1D767, 8000, 1},
+        {0x1D768, 8001, 1},
+        {0x1D769, 8002, 1},
+        {0x1D76A, 8003, 1},
+        {0x1D76B, 8004, 1},
+        {0x1D76C, 8005, 1},
+        {0x1D76D, 8006, 1},
+        {0x1D76E, 8007, 1},
+        {0x1D76F, 8008, 1},
+        {0x1D770, 8009, 1},
+        {0x1D771, 8010, 1},
+        {0x1D772, 8011, 1},
+        {0x1D773, 8012, 1},
+        {0x1D774, 8013, 1},
+        {0x1D775, 8014, 1},
+        {0x1D776, 8015, 1},
+        {0x1D777, 8016, 1},
+        {0x1D778, 8017, 1},
+        {0x1D779, 8018, 1},
+        {0x1D77A, 8019, 1},
+        {0x1D77B, 8020, 1},
+        {0x1D77C, 8021, 1},
+        {0x1D77D, 8022, 1},
+        {0x1D77E, 8023, 1},
+        {0x1D77F, 8024, 1},
+        {0x1D780, 8025, 1},
+        {0x1D781, 8026, 1},
+        {0x1D782, 8027, 1},
+        {0x1D783, 8028, 1},
+        {0x1D784, 8029, 1},
+        {0x1D785, 8030, 1},
+        {0x1D786, 8031, 1},
+        {0x1D787, 8032, 1},
+        {0x1D788, 8033, 1},
+        {0x1D789, 8034, 1},
+        {0x1D78A, 8035, 1},
+        {0x1D78B, 8036, 1},
+        {0x1D78C, 8037, 1},
+        {0x1D78D, 8038, 1},
+        {0x1D78E, 8039, 1},
+        {0x1D78F, 8040, 1},
+        {0x1D790, 8041, 1},
+        {0x1D791, 8042, 1},
+        {0x1D792, 8043, 1},
+        {0x1D793, 8044, 1},
+        {0x1D794, 8045, 1},
+        {0x1D795, 8046, 1},
+        {0x1D796, 8047, 1},
+        {0x1D797, 8048, 1},
+        {0x1D798, 8049, 1},
+        {0x1D799, 8050, 1},
+        {0x1D79A, 8051, 1},
+        {0x1D79B, 8052, 1},
+        {0x1D79C, 8053, 1},
+        {0x1D79D, 8054, 1},
+        {0x1D79E, 8055, 1},
+        {0x1D79F, 8056, 1},
+        {0x1D7A0, 8057, 1},
+        {0x1D7A1, 8058, 1},
+        {0x1D7A2, 8059, 1},
+        {0x1D7A3, 8060, 1},
+        {0x1D7A4, 8061, 1},
+        {0x1D7A5, 8062, 1},
+        {0x1D7A6, 8063, 1},
+        {0x1D7A7, 8064, 1},
+        {0x1D7A8, 8065, 1},
+        {0x1D7A9, 8066, 1},
+        {0x1D7AA, 8067, 1},
+        {0x1D7AB, 8068, 1},
+        {0x1D7AC, 8069, 1},
+        {0x1D7AD, 8070, 1},
+        {0x1D7AE, 8071, 1},
+        {0x1D7AF, 8072, 1},
+        {0x1D7B0, 8073, 1},
+        {0x1D7B1, 8074, 1},
+        {0x1D7B2, 8075, 1},
+        {0x1D7B3, 8076, 1},
+        {0x1D7B4, 8077, 1},
+        {0x1D7B5, 8078, 1},
+        {0x1D7B6, 8079, 1},
+        {0x1D7B7, 8080, 1},
+        {0x1D7B8, 8081, 1},
+        {0x1D7B9, 8082, 1},
+        {0x1D7BA, 8083, 1},
+        {0x1D7BB, 8084, 1},
+        {0x1D7BC, 8085, 1},
+        {0x1D7BD, 8086, 1},
+        {0x1D7BE, 8087, 1},
+        {0x1D7BF, 8088, 1},
+        {0x1D7C0, 8089, 1},
+        {0x1D7C1, 8090, 1},
+        {0x1D7C2, 8091, 1},
+        {0x1D7C3, 8092, 1},
+        {0x1D7C4, 8093, 1},
+        {0x1D7C5, 8094, 1},
+        {0x1D7C6, 8095, 1},
+        {0x1D7C7, 8096, 1},
+        {0x1D7C8, 8097, 1},
+        {0x1D7C9, 8098, 1},
+        {0x1D7CA, 8099, 1},
+        {0x1D7CB, 8100, 1},
+        {0x1D7CE, 8101, 1},
+        {0x1D7CF, 8102, 1},
+        {0x1D7D0, 8103, 1},
+        {0x1D7D1, 8104, 1},
+        {0x1D7D2, 8105, 1},
+        {0x1D7D3, 8106, 1},
+        {0x1D7D4, 8107, 1},
+        {0x1D7D5, 8108, 1},
+        {0x1D7D6, 8109, 1},
+        {0x1D7D7, 8110, 1},
+        {0x1D7D8, 8111, 1},
+        {0x1D7D9, 8112, 1},
+        {0x1D7DA, 8113, 1},
+        {0x1D7DB, 8114, 1},
+        {0x1D7DC, 8115, 1},
+        {0x1D7DD, 8116, 1},
+        {0x1D7DE, 8117, 1},
+        {0x1D7DF, 8118, 1},
+        {0x1D7E0, 8119, 1},
+        {0x1D7E1, 8120, 1},
+        {0x1D7E2, 8121, 1},
+        {0x1D7E3, 8122, 1},
+        {0x1D7E4, 8123, 1},
+        {0x1D7E5, 8124, 1},
+        {0x1D7E6, 8125, 1},
+        {0x1D7E7, 8126, 1},
+        {0x1D7E8, 8127, 1},
+        {0x1D7E9, 8128, 1},
+        {0x1D7EA, 8129, 1},
+        {0x1D7EB, 8130, 1},
+        {0x1D7EC, 8131, 1},
+        {0x1D7ED, 8132, 1},
+        {0x1D7EE, 8133, 1},
+        {0x1D7EF, 8134, 1},
+        {0x1D7F0, 8135, 1},
+        {0x1D7F1, 8136, 1},
+        {0x1D7F2, 8137, 1},
+        {0x1D7F3, 8138, 1},
+        {0x1D7F4, 8139, 1},
+        {0x1D7F5, 8140, 1},
+        {0x1D7F6, 8141, 1},
+        {0x1D7F7, 8142, 1},
+        {0x1D7F8, 8143, 1},
+        {0x1D7F9, 8144, 1},
+        {0x1D7FA, 8145, 1},
+        {0x1D7FB, 8146, 1},
+        {0x1D7FC, 8147, 1},
+        {0x1D7FD, 8148, 1},
+        {0x1D7FE, 8149, 1},
+        {0x1D7FF, 8150, 1},
+        {0x1EE00, 8151, 1},
+        {0x1EE01, 8152, 1},
+        {0x1EE02, 8153, 1},
+        {0x1EE03, 8154, 1},
+        {0x1EE05, 8155, 1},
+        {0x1EE06, 8156, 1},
+        {0x1EE07, 8157, 1},
+        {0x1EE08, 8158, 1},
+        {0x1EE09, 8159, 1},
+        {0x1EE0A, 8160, 1},
+        {0x1EE0B, 8161, 1},
+        {0x1EE0C, 8162, 1},
+        {0x1EE0D, 8163, 1},
+        {0x1EE0E, 8164, 1},
+        {0x1EE0F, 8165, 1},
+        {0x1EE10, 8166, 1},
+        {0x1EE11, 8167, 1},
+        {0x1EE12, 8168, 1},
+        {0x1EE13, 8169, 1},
+        {0x1EE14, 8170, 1},
+        {0x1EE15, 8171, 1},
+        {0x1EE16, 8172, 1},
+        {0x1EE17, 8173, 1},
+        {0x1EE18, 8174, 1},
+        {0x1EE19, 8175, 1},
+        {0x1EE1A, 8176, 1},
+        {0x1EE1B, 8177, 1},
+        {0x1EE1C, 8178, 1},
+        {0x1EE1D, 8179, 1},
+        {0x1EE1E, 8180, 1},
+        {0x1EE1F, 8181, 1},
+        {0x1EE21, 8182, 1},
+        {0x1EE22, 8183, 1},
+        {0x1EE24, 8184, 1},
+        {0x1EE27, 8185, 1},
+        {0x1EE29, 8186, 1},
+        {0x1EE2A, 8187, 1},
+        {0x1EE2B, 8188, 1},
+        {0x1EE2C, 8189, 1},
+        {0x1EE2D, 8190, 1},
+        {0x1EE2E, 8191, 1},
+        {0x1EE2F, 8192, 1},
+        {0x1EE30, 8193, 1},
+        {0x1EE31, 8194, 1},
+        {0x1EE32, 8195, 1},
+        {0x1EE34, 8196, 1},
+        {0x1EE35, 8197, 1},
+        {0x1EE36, 8198, 1},
+        {0x1EE37, 8199, 1},
+        {0x1EE39, 8200, 1},
+        {0x1EE3B, 8201, 1},
+        {0x1EE42, 8202, 1},
+        {0x1EE47, 8203, 1},
+        {0x1EE49, 8204, 1},
+        {0x1EE4B, 8205, 1},
+        {0x1EE4D, 8206, 1},
+        {0x1EE4E, 8207, 1},
+        {0x1EE4F, 8208, 1},
+        {0x1EE51, 8209, 1},
+        {0x1EE52, 8210, 1},
+        {0x1EE54, 8211, 1},
+        {0x1EE57, 8212, 1},
+        {0x1EE59, 8213, 1},
+        {0x1EE5B, 8214, 1},
+        {0x1EE5D, 8215, 1},
+        {0x1EE5F, 8216, 1},
+        {0x1EE61, 8217, 1},
+        {0x1EE62, 8218, 1},
+        {0x1EE64, 8219, 1},
+        {0x1EE67, 8220, 1},
+        {0x1EE68, 8221, 1},
+        {0x1EE69, 8222, 1},
+        {0x1EE6A, 8223, 1},
+        {0x1EE6C, 8224, 1},
+        {0x1EE6D, 8225, 1},
+        {0x1EE6E, 8226, 1},
+        {0x1EE6F, 8227, 1},
+        {0x1EE70, 8228, 1},
+        {0x1EE71, 8229, 1},
+        {0x1EE72, 8230, 1},
+        {0x1EE74, 8231, 1},
+        {0x1EE75, 8232, 1},
+        {0x1EE76, 8233, 1},
+        {0x1EE77, 8234, 1},
+        {0x1EE79, 8235, 1},
+        {0x1EE7A, 8236, 1},
+        {0x1EE7B, 8237, 1},
+        {0x1EE7C, 8238, 1},
+        {0x1EE7E, 8239, 1},
+        {0x1EE80, 8240, 1},
+        {0x1EE81, 8241, 1},
+        {0x1EE82, 8242, 1},
+        {0x1EE83, 8243, 1},
+        {0x1EE84, 8244, 1},
+        {0x1EE85, 8245, 1},
+        {0x1EE86, 8246, 1},
+        {0x1EE87, 8247, 1},
+        {0x1EE88, 8248, 1},
+        {0x1EE89, 8249, 1},
+        {0x1EE8B, 8250, 1},
+        {0x1EE8C, 8251, 1},
+        {0x1EE8D, 8252, 1},
+        {0x1EE8E, 8253, 1},
+        {0x1EE8F, 8254, 1},
+        {0x1EE90, 8255, 1},
+        {0x1EE91, 8256, 1},
+        {0x1EE92, 8257, 1},
+        {0x1EE93, 8258, 1},
+        {0x1EE94, 8259, 1},
+        {0x1EE95, 8260, 1},
+        {0x1EE96, 8261, 1},
+        {0x1EE97, 8262, 1},
+        {0x1EE98, 8263, 1},
+        {0x1EE99, 8264, 1},
+        {0x1EE9A, 8265, 1},
+        {0x1EE9B, 8266, 1},
+        {0x1EEA1, 8267, 1},
+        {0x1EEA2, 8268, 1},
+        {0x1EEA3, 8269, 1},
+        {0x1EEA5, 8270, 1},
+        {0x1EEA6, 8271, 1},
+        {0x1EEA7, 8272, 1},
+        {0x1EEA8, 8273, 1},
+        {0x1EEA9, 8274, 1},
+        {0x1EEAB, 8275, 1},
+        {0x1EEAC, 8276, 1},
+        {0x1EEAD, 8277, 1},
+        {0x1EEAE, 8278, 1},
+        {0x1EEAF, 8279, 1},
+        {0x1EEB0, 8280, 1},
+        {0x1EEB1, 8281, 1},
+        {0x1EEB2, 8282, 1},
+        {0x1EEB3, 8283, 1},
+        {0x1EEB4, 8284, 1},
+        {0x1EEB5, 8285, 1},
+        {0x1EEB6, 8286, 1},
+        {0x1EEB7, 8287, 1},
+        {0x1EEB8, 8288, 1},
+        {0x1EEB9, 8289, 1},
+        {0x1EEBA, 8290, 1},
+        {0x1EEBB, 8291, 1},
+        {0x1F100, 8292, 2},
+        {0x1F101, 8294, 2},
+        {0x1F102, 8296, 2},
+        {0x1F103, 8298, 2},
+        {0x1F104, 8300, 2},
+        {0x1F105, 8302, 2},
+        {0x1F106, 8304, 2},
+        {0x1F107, 8306, 2},
+        {0x1F108, 8308, 2},
+        {0x1F109, 8310, 2},
+        {0x1F10A, 8312, 2},
+        {0x1F110, 8314, 3},
+        {0x1F111, 8317, 3},
+        {0x1F112, 8320, 3},
+        {0x1F113, 8323, 3},
+        {0x1F114, 8326, 3},
+        {0x1F115, 8329, 3},
+        {0x1F116, 8332, 3},
+        {0x1F117, 8335, 3},
+        {0x1F118, 8338, 3},
+        {0x1F119, 8341, 3},
+        {0x1F11A, 8344, 3},
+        {0x1F11B, 8347, 3},
+        {0x1F11C, 8350, 3},
+        {0x1F11D, 8353, 3},
+        {0x1F11E, 8356, 3},
+        {0x1F11F, 8359, 3},
+        {0x1F120, 8362, 3},
+        {0x1F121, 8365, 3},
+        {0x1F122, 8368, 3},
+        {0x1F123, 8371, 3},
+        {0x1F124, 8374, 3},
+        {0x1F125, 8377, 3},
+        {0x1F126, 8380, 3},
+        {0x1F127, 8383, 3},
+        {0x1F128, 8386, 3},
+        {0x1F129, 8389, 3},
+        {0x1F12A, 8392, 3},
+        {0x1F12B, 8395, 1},
+        {0x1F12C, 8396, 1},
+        {0x1F12D, 8397, 2},
+        {0x1F12E, 8399, 2},
+        {0x1F130, 8401, 1},
+        {0x1F131, 8402, 1},
+        {0x1F132, 8403, 1},
+        {0x1F133, 8404, 1},
+        {0x1F134, 8405, 1},
+        {0x1F135, 8406, 1},
+        {0x1F136, 8407, 1},
+        {0x1F137, 8408, 1},
+        {0x1F138, 8409, 1},
+        {0x1F139, 8410, 1},
+        {0x1F13A, 8411, 1},
+        {0x1F13B, 8412, 1},
+        {0x1F13C, 8413, 1},
+        {0x1F13D, 8414, 1},
+        {0x1F13E, 8415, 1},
+        {0x1F13F, 8416, 1},
+        {0x1F140, 8417, 1},
+        {0x1F141, 8418, 1},
+        {0x1F142, 8419, 1},
+        {0x1F143, 8420, 1},
+        {0x1F144, 8421, 1},
+        {0x1F145, 8422, 1},
+        {0x1F146, 8423, 1},
+        {0x1F147, 8424, 1},
+        {0x1F148, 8425, 1},
+        {0x1F149, 8426, 1},
+        {0x1F14A, 8427, 2},
+        {0x1F14B, 8429, 2},
+        {0x1F14C, 8431, 2},
+        {0x1F14D, 8433, 2},
+        {0x1F14E, 8435, 3},
+        {0x1F14F, 8438, 2},
+        {0x1F16A, 8440, 2},
+        {0x1F16B, 8442, 2},
+        {0x1F16C, 8444, 2},
+        {0x1F190, 8446, 2},
+        {0x1F200, 8448, 2},
+        {0x1F201, 8450, 2},
+        {0x1F202, 8452, 1},
+        {0x1F210, 8453, 1},
+        {0x1F211, 8454, 1},
+        {0x1F212, 8455, 1},
+        {0x1F213, 8456, 2},
+        {0x1F214, 8458, 1},
+        {0x1F215, 8459, 1},
+        {0x1F216, 8460, 1},
+        {0x1F217, 8461, 1},
+        {0x1F218, 8462, 1},
+        {0x1F219, 8463, 1},
+        {0x1F21A, 8464, 1},
+        {0x1F21B, 8465, 1},
+        {0x1F21C, 8466, 1},
+        {0x1F21D, 8467, 1},
+        {0x1F21E, 8468, 1},
+        {0x1F21F, 8469, 1},
+        {0x1F220, 8470, 1},
+        {0x1F221, 8471, 1},
+        {0x1F222, 8472, 1},
+        {0x1F223, 8473, 1},
+        {0x1F224, 8474, 1},
+        {0x1F225, 8475, 1},
+        {0x1F226, 8476, 1},
+        {0x1F227, 8477, 1},
+        {0x1F228, 8478, 1},
+        {0x1F229, 8479, 1},
+        {0x1F22A, 8480, 1},
+        {0x1F22B, 8481, 1},
+        {0x1F22C, 8482, 1},
+        {0x1F22D, 8483, 1},
+        {0x1F22E, 8484, 1},
+        {0x1F22F, 8485, 1},
+        {0x1F230, 8486, 1},
+        {0x1F231, 8487, 1},
+        {0x1F232, 8488, 1},
+        {0x1F233, 8489, 1},
+        {0x1F234, 8490, 1},
+        {0x1F235, 8491, 1},
+        {0x1F236, 8492, 1},
+        {0x1F237, 8493, 1},
+        {0x1F238, 8494, 1},
+        {0x1F239, 8495, 1},
+        {0x1F23A, 8496, 1},
+        {0x1F23B, 8497, 1},
+        {0x1F240, 8498, 3},
+        {0x1F241, 8501, 3},
+        {0x1F242, 8504, 3},
+        {0x1F243, 8507, 3},
+        {0x1F244, 8510, 3},
+        {0x1F245, 8513, 3},
+        {0x1F246, 8516, 3},
+        {0x1F247, 8519, 3},
+        {0x1F248, 8522, 3},
+        {0x1F250, 8525, 1},
+        {0x1F251, 8526, 1},
+        {0x1FBF0, 8527, 1},
+        {0x1FBF1, 8528, 1},
+        {0x1FBF2, 8529, 1},
+        {0x1FBF3, 8530, 1},
+        {0x1FBF4, 8531, 1},
+        {0x1FBF5, 8532, 1},
+        {0x1FBF6, 8533, 1},
+        {0x1FBF7, 8534, 1},
+        {0x1FBF8, 8535, 1},
+        {0x1FBF9, 8536, 1}
+};
+
+static const uint32_t utf8_decomposition_data[9079] = {
+        0x0020, 0x0020, 0x0308, 0x0061, 0x0020, 0x0304, 0x0032, 0x0033, 0x0020, 0x0301, 0x03BC, 0x0020,
+        0x0327, 0x0031, 0x006F, 0x0031, 0x2044, 0x0034, 0x0031, 0x2044, 0x0032, 0x0033, 0x2044, 0x0034,
+        0x0041, 0x0300, 0x0041, 0x0301, 0x0041, 0x0302, 0x0041, 0x0303, 0x0041, 0x0308, 0x0041, 0x030A,
+        0x0043, 0x0327, 0x0045, 0x0300, 0x0045, 0x0301, 0x0045, 0x0302, 0x0045, 0x0308, 0x0049, 0x0300,
+        0x0049, 0x0301, 0x0049, 0x0302, 0x0049, 0x0308, 0x004E, 0x0303, 0x004F, 0x0300, 0x004F, 0x0301,
+        0x004F, 0x0302, 0x004F, 0x0303, 0x004F, 0x0308, 0x0055, 0x0300, 0x0055, 0x0301, 0x0055, 0x0302,
+        0x0055, 0x0308, 0x0059, 0x0301, 0x0061, 0x0300, 0x0061, 0x0301, 0x0061, 0x0302, 0x0061, 0x0303,
+        0x0061, 0x0308, 0x0061, 0x030A, 0x0063, 0x0327, 0x0065, 0x0300, 0x0065, 0x0301, 0x0065, 0x0302,
+        0x0065, 0x0308, 0x0069, 0x0300, 0x0069, 0x0301, 0x0069, 0x0302, 0x0069, 0x0308, 0x006E, 0x0303,
+        0x006F, 0x0300, 0x006F, 0x0301, 0x006F, 0x0302, 0x006F, 0x0303, 0x006F, 0x0308, 0x0075, 0x0300,
+        0x0075, 0x0301, 0x0075, 0x0302, 0x0075, 0x0308, 0x0079, 0x0301, 0x0079, 0x0308, 0x0041, 0x0304,
+        0x0061, 0x0304, 0x0041, 0x0306, 0x0061, 0x0306, 0x0041, 0x0328, 0x0061, 0x0328, 0x0043, 0x0301,
+        0x0063, 0x0301, 0x0043, 0x0302, 0x0063, 0x0302, 0x0043, 0x0307, 0x0063, 0x0307, 0x0043, 0x030C,
+        0x0063, 0x030C, 0x0044, 0x030C, 0x0064, 0x030C, 0x0045, 0x0304, 0x0065, 0x0304, 0x0045, 0x0306,
+        0x0065, 0x0306, 0x0045, 0x0307, 0x0065, 0x0307, 0x0045, 0x0328, 0x0065, 0x0328, 0x0045, 0x030C,
+        0x0065, 0x030C, 0x0047, 0x0302, 0x0067, 0x0302, 0x0047, 0x0306, 0x0067, 0x0306, 0x0047, 0x0307,
+        0x0067, 0x0307, 0x0047, 0x0327, 0x0067, 0x0327, 0x0048, 0x0302, 0x0068, 0x0302, 0x0049, 0x0303,
+        0x0069, 0x0303, 0x0049, 0x0304, 0x0069, 0x0304, 0x0049, 0x0306, 0x0069, 0x0306, 0x0049, 0x0328,
+        0x0069, 0x0328, 0x0049, 0x0307, 0x0049, 0x004A, 0x0069, 0x006A, 0x004A, 0x0302, 0x006A, 0x0302,
+        0x004B, 0x0327, 0x006B, 0x0327, 0x004C, 0x0301, 0x006C, 0x0301, 0x004C, 0x0327, 0x006C, 0x0327,
+        0x004C, 0x030C, 0x006C, 0x030C, 0x004C, 0x00B7, 0x006C, 0x00B7, 0x004E, 0x0301, 0x006E, 0x0301,
+        0x004E, 0x0327, 0x006E, 0x0327, 0x004E, 0x030C, 0x006E, 0x030C, 0x02BC, 0x006E, 0x004F, 0x0304,
+        0x006F, 0x0304, 0x004F, 0x0306, 0x006F, 0x0306, 0x004F, 0x030B, 0x006F, 0x030B, 0x0052, 0x0301,
+        0x0072, 0x0301, 0x0052, 0x0327, 0x0072, 0x0327, 0x0052, 0x030C, 0x0072, 0x030C, 0x0053, 0x0301,
+        0x0073, 0x0301, 0x0053, 0x0302, 0x0073, 0x0302, 0x0053, 0x0327, 0x0073, 0x0327, 0x0053, 0x030C,
+        0x0073, 0x030C, 0x0054, 0x0327, 0x0074, 0x0327, 0x0054, 0x030C, 0x0074, 0x030C, 0x0055, 0x0303,
+        0x0075, 0x0303, 0x0055, 0x0304, 0x0075, 0x0304, 0x0055, 0x0306, 0x0075, 0x0306, 0x0055, 0x030A,
+        0x0075, 0x030A, 0x0055, 0x030B, 0x0075, 0x030B, 0x0055, 0x0328, 0x0075, 0x0328, 0x0057, 0x0302,
+        0x0077, 0x0302, 0x0059, 0x0302, 0x0079, 0x0302, 0x0059, 0x0308, 0x005A, 0x0301, 0x007A, 0x0301,
+        0x005A, 0x0307, 0x007A, 0x0307, 0x005A, 0x030C, 0x007A, 0x030C, 0x0073, 0x004F, 0x031B, 0x006F,
+        0x031B, 0x0055, 0x031B, 0x0075, 0x031B, 0x0044, 0x005A, 0x030C, 0x0044, 0x007A, 0x030C, 0x0064,
+        0x007A, 0x030C, 0x004C, 0x004A, 0x004C, 0x006A, 0x006C, 0x006A, 0x004E, 0x004A, 0x004E, 0x006A,
+        0x006E, 0x006A, 0x0041, 0x030C, 0x0061, 0x030C, 0x0049, 0x030C, 0x0069, 0x030C, 0x004F, 0x030C,
+        0x006F, 0x030C, 0x0055, 0x030C, 0x0075, 0x030C, 0x0055, 0x0308, 0x0304, 0x0075, 0x0308, 0x0304,
+        0x0055, 0x0308, 0x0301, 0x0075, 0x0308, 0x0301, 0x0055, 0x0308, 0x030C, 0x0075, 0x0308, 0x030C,
+        0x0055, 0x0308, 0x0300, 0x0075, 0x0308, 0x0300, 0x0041, 0x0308, 0x0304, 0x0061, 0x0308, 0x0304,
+        0x0041, 0x0307, 0x0304, 0x0061, 0x0307, 0x0304, 0x00C6, 0x0304, 0x00E6, 0x0304, 0x0047, 0x030C,
+        0x0067, 0x030C, 0x004B, 0x030C, 0x006B, 0x030C, 0x004F, 0x0328, 0x006F, 0x0328, 0x004F, 0x0328,
+        0x0304, 0x006F, 0x0328, 0x0304, 0x01B7, 0x030C, 0x0292, 0x030C, 0x006A, 0x030C, 0x0044, 0x005A,
+        0x0044, 0x007A, 0x0064, 0x007A, 0x0047, 0x0301, 0x0067, 0x0301, 0x004E, 0x0300, 0x006E, 0x0300,
+        0x0041, 0x030A, 0x0301, 0x0061, 0x030A, 0x0301, 0x00C6, 0x0301, 0x00E6, 0x0301, 0x00D8, 0x0301,
+        0x00F8, 0x0301, 0x0041, 0x030F, 0x0061, 0x030F, 0x0041, 0x0311, 0x0061, 0x0311, 0x0045, 0x030F,
+        0x0065, 0x030F, 0x0045, 0x0311, 0x0065, 0x0311, 0x0049, 0x030F, 0x0069, 0x030F, 0x0049, 0x0311,
+        0x0069, 0x0311, 0x004F, 0x030F, 0x006F, 0x030F, 0x004F, 0x0311, 0x006F, 0x0311, 0x0052, 0x030F,
+        0x0072, 0x030F, 0x0052, 0x0311, 0x0072, 0x0311, 0x0055, 0x030F, 0x0075, 0x030F, 0x0055, 0x0311,
+        0x0075, 0x0311, 0x0053, 0x0326, 0x0073, 0x0326, 0x0054, 0x0326, 0x0074, 0x0326, 0x0048, 0x030C,
+        0x0068, 0x030C, 0x0041, 0x0307, 0x0061, 0x0307, 0x0045, 0x0327, 0x0065, 0x0327, 0x004F, 0x0308,
+        0x0304, 0x006F, 0x0308, 0x0304, 0x004F, 0x0303, 0x0304, 0x006F, 0x0303, 0x0304, 0x004F, 0x0307,
+        0x006F, 0x0307, 0x004F, 0x0307, 0x0304, 0x006F, 0x0307, 0x0304, 0x0059, 0x0304, 0x0079, 0x0304,
+        0x0068, 0x0266, 0x006A, 0x0072, 0x0279, 0x027B, 0x0281, 0x0077, 0x0079, 0x0020, 0x0306, 0x0020,
+        0x0307, 0x0020, 0x030A, 0x0020, 0x0328, 0x0020, 0x0303, 0x0020, 0x030B, 0x0263, 0x006C, 0x0073,
+        0x0078, 0x0295, 0x0300, 0x0301, 0x0313, 0x0308, 0x0301, 0x02B9, 0x0020, 0x0345, 0x003B, 0x0020,
+        0x0301, 0x00A8, 0x0301, 0x0020, 0x0308, 0x0301, 0x0391, 0x0301, 0x00B7, 0x0395, 0x0301, 0x0397,
+        0x0301, 0x0399, 0x0301, 0x039F, 0x0301, 0x03A5, 0x0301, 0x03A9, 0x0301, 0x03B9, 0x0308, 0x0301,
+        0x0399, 0x0308, 0x03A5, 0x0308, 0x03B1, 0x0301, 0x03B5, 0x0301, 0x03B7, 0x0301, 0x03B9, 0x0301,
+        0x03C5, 0x0308, 0x0301, 0x03B9, 0x0308, 0x03C5, 0x0308, 0x03BF, 0x0301, 0x03C5, 0x0301, 0x03C9,
+        0x0301, 0x03B2, 0x03B8, 0x03A5, 0x03D2, 0x0301, 0x03A5, 0x0301, 0x03D2, 0x0308, 0x03A5, 0x0308,
+        0x03C6, 0x03C0, 0x03BA, 0x03C1, 0x03C2, 0x0398, 0x03B5, 0x03A3, 0x0415, 0x0300, 0x0415, 0x0308,
+        0x0413, 0x0301, 0x0406, 0x0308, 0x041A, 0x0301, 0x0418, 0x0300, 0x0423, 0x0306, 0x0418, 0x0306,
+        0x0438, 0x0306, 0x0435, 0x0300, 0x0435, 0x0308, 0x0433, 0x0301, 0x0456, 0x0308, 0x043A, 0x0301,
+        0x0438, 0x0300, 0x0443, 0x0306, 0x0474, 0x030F, 0x0475, 0x030F, 0x0416, 0x0306, 0x0436, 0x0306,
+        0x0410, 0x0306, 0x0430, 0x0306, 0x0410, 0x0308, 0x0430, 0x0308, 0x0415, 0x0306, 0x0435, 0x0306,
+        0x04D8, 0x0308, 0x04D9, 0x0308, 0x0416, 0x0308, 0x0436, 0x0308, 0x0417, 0x0308, 0x0437, 0x0308,
+        0x0418, 0x0304, 0x0438, 0x0304, 0x0418, 0x0308, 0x0438, 0x0308, 0x041E, 0x0308, 0x043E, 0x0308,
+        0x04E8, 0x0308, 0x04E9, 0x0308, 0x042D, 0x0308, 0x044D, 0x0308, 0x0423, 0x0304, 0x0443, 0x0304,
+        0x0423, 0x0308, 0x0443, 0x0308, 0x0423, 0x030B, 0x0443, 0x030B, 0x0427, 0x0308, 0x0447, 0x0308,
+        0x042B, 0x0308, 0x044B, 0x0308, 0x0565, 0x0582, 0x0627, 0x0653, 0x0627, 0x0654, 0x0648, 0x0654,
+        0x0627, 0x0655, 0x064A, 0x0654, 0x0627, 0x0674, 0x0648, 0x0674, 0x06C7, 0x0674, 0x064A, 0x0674,
+        0x06D5, 0x0654, 0x06C1, 0x0654, 0x06D2, 0x0654, 0x0928, 0x093C, 0x0930, 0x093C, 0x0933, 0x093C,
+        0x0915, 0x093C, 0x0916, 0x093C, 0x0917, 0x093C, 0x091C, 0x093C, 0x0921, 0x093C, 0x0922, 0x093C,
+        0x092B, 0x093C, 0x092F, 0x093C, 0x09C7, 0x09BE, 0x09C7, 0x09D7, 0x09A1, 0x09BC, 0x09A2, 0x09BC,
+        0x09AF, 0x09BC, 0x0A32, 0x0A3C, 0x0A38, 0x0A3C, 0x0A16, 0x0A3C, 0x0A17, 0x0A3C, 0x0A1C, 0x0A3C,
+        0x0A2B, 0x0A3C, 0x0B47, 0x0B56, 0x0B47, 0x0B3E, 0x0B47, 0x0B57, 0x0B21, 0x0B3C, 0x0B22, 0x0B3C,
+        0x0B92, 0x0BD7, 0x0BC6, 0x0BBE, 0x0BC7, 0x0BBE, 0x0BC6, 0x0BD7, 0x0C46, 0x0C56, 0x0CBF, 0x0CD5,
+        0x0CC6, 0x0CD5, 0x0CC6, 0x0CD6, 0x0CC6, 0x0CC2, 0x0CC6, 0x0CC2, 0x0CD5, 0x0D46, 0x0D3E, 0x0D47,
+        0x0D3E, 0x0D46, 0x0D57, 0x0DD9, 0x0DCA, 0x0DD9, 0x0DCF, 0x0DD9, 0x0DCF, 0x0DCA, 0x0DD9, 0x0DDF,
+        0x0E4D, 0x0E32, 0x0ECD, 0x0EB2, 0x0EAB, 0x0E99, 0x0EAB, 0x0EA1, 0x0F0B, 0x0F42, 0x0FB7, 0x0F4C,
+        0x0FB7, 0x0F51, 0x0FB7, 0x0F56, 0x0FB7, 0x0F5B, 0x0FB7, 0x0F40, 0x0FB5, 0x0F71, 0x0F72, 0x0F71,
+        0x0F74, 0x0FB2, 0x0F80, 0x0FB2, 0x0F71, 0x0F80, 0x0FB3, 0x0F80, 0x0FB3, 0x0F71, 0x0F80, 0x0F71,
+        0x0F80, 0x0F92, 0x0FB7, 0x0F9C, 0x0FB7, 0x0FA1, 0x0FB7, 0x0FA6, 0x0FB7, 0x0FAB, 0x0FB7, 0x0F90,
+        0x0FB5, 0x1025, 0x102E, 0x10DC, 0x1B05, 0x1B35, 0x1B07, 0x1B35, 0x1B09, 0x1B35, 0x1B0B, 0x1B35,
+        0x1B0D, 0x1B35, 0x1B11, 0x1B35, 0x1B3A, 0x1B35, 0x1B3C, 0x1B35, 0x1B3E, 0x1B35, 0x1B3F, 0x1B35,
+        0x1B42, 0x1B35, 0x0041, 0x00C6, 0x0042, 0x0044, 0x0045, 0x018E, 0x0047, 0x0048, 0x0049, 0x004A,
+        0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0222, 0x0050, 0x0052, 0x0054, 0x0055, 0x0057, 0x0061,
+        0x0250, 0x0251, 0x1D02, 0x0062, 0x0064, 0x0065, 0x0259, 0x025B, 0x025C, 0x0067, 0x006B, 0x006D,
+        0x014B, 0x006F, 0x0254, 0x1D16, 0x1D17, 0x0070, 0x0074, 0x0075, 0x1D1D, 0x026F, 0x0076, 0x1D25,
+        0x03B2, 0x03B3, 0x03B4, 0x03C6, 0x03C7, 0x0069, 0x0072, 0x0075, 0x0076, 0x03B2, 0x03B3, 0x03C1,
+        0x03C6, 0x03C7, 0x043D, 0x0252, 0x0063, 0x0255, 0x00F0, 0x025C, 0x0066, 0x025F, 0x0261, 0x0265,
+        0x0268, 0x0269, 0x026A, 0x1D7B, 0x029D, 0x026D, 0x1D85, 0x029F, 0x0271, 0x0270, 0x0272, 0x0273,
+        0x0274, 0x0275, 0x0278, 0x0282, 0x0283, 0x01AB, 0x0289, 0x028A, 0x1D1C, 0x028B, 0x028C, 0x007A,
+        0x0290, 0x0291, 0x0292, 0x03B8, 0x0041, 0x0325, 0x0061, 0x0325, 0x0042, 0x0307, 0x0062, 0x0307,
+        0x0042, 0x0323, 0x0062, 0x0323, 0x0042, 0x0331, 0x0062, 0x0331, 0x0043, 0x0327, 0x0301, 0x0063,
+        0x0327, 0x0301, 0x0044, 0x0307, 0x0064, 0x0307, 0x0044, 0x0323, 0x0064, 0x0323, 0x0044, 0x0331,
+        0x0064, 0x0331, 0x0044, 0x0327, 0x0064, 0x0327, 0x0044, 0x032D, 0x0064, 0x032D, 0x0045, 0x0304,
+        0x0300, 0x0065, 0x0304, 0x0300, 0x0045, 0x0304, 0x0301, 0x0065, 0x0304, 0x0301, 0x0045, 0x032D,
+        0x0065, 0x032D, 0x0045, 0x0330, 0x0065, 0x0330, 0x0045, 0x0327, 0x0306, 0x0065, 0x0327, 0x0306,
+        0x0046, 0x0307, 0x0066, 0x0307, 0x0047, 0x0304, 0x0067, 0x0304, 0x0048, 0x0307, 0x0068, 0x0307,
+        0x0048, 0x0323, 0x0068, 0x0323, 0x0048, 0x0308, 0x0068, 0x0308, 0x0048, 0x0327, 0x0068, 0x0327,
+        0x0048, 0x032E, 0x0068, 0x032E, 0x0049, 0x0330, 0x0069, 0x0330, 0x0049, 0x0308, 0x0301, 0x0069,
+        0x0308, 0x0301, 0x004B, 0x0301, 0x006B, 0x0301, 0x004B, 0x0323, 0x006B, 0x0323, 0x004B, 0x0331,
+        0x006B, 0x0331, 0x004C, 0x0323, 0x006C, 0x0323, 0x004C, 0x0323, 0x0304, 0x006C, 0x0323, 0x0304,
+        0x004C, 0x0331, 0x006C, 0x0331, 0x004C, 0x032D, 0x006C, 0x032D, 0x004D, 0x0301, 0x006D, 0x0301,
+        0x004D, 0x0307, 0x006D, 0x0307, 0x004D, 0x0323, 0x006D, 0x0323, 0x004E, 0x0307, 0x006E, 0x0307,
+        0x004E, 0x0323, 0x006E, 0x0323, 0x004E, 0x0331, 0x006E, 0x0331, 0x004E, 0x032D, 0x006E, 0x032D,
+        0x004F, 0x0303, 0x0301, 0x006F, 0x0303, 0x0301, 0x004F, 0x0303, 0x0308, 0x006F, 0x0303, 0x0308,
+        0x004F, 0x0304, 0x0300, 0x006F, 0x0304, 0x0300, 0x004F, 0x0304, 0x0301, 0x006F, 0x0304, 0x0301,
+        0x0050, 0x0301, 0x0070, 0x0301, 0x0050, 0x0307, 0x0070, 0x0307, 0x0052, 0x0307, 0x0072, 0x0307,
+        0x0052, 0x0323, 0x0072, 0x0323, 0x0052, 0x0323, 0x0304, 0x0072, 0x0323, 0x0304, 0x0052, 0x0331,
+        0x0072, 0x0331, 0x0053, 0x0307, 0x0073, 0x0307, 0x0053, 0x0323, 0x0073, 0x0323, 0x0053, 0x0301,
+        0x0307, 0x0073, 0x0301, 0x0307, 0x0053, 0x030C, 0x0307, 0x0073, 0x030C, 0x0307, 0x0053, 0x0323,
+        0x0307, 0x0073, 0x0323, 0x0307, 0x0054, 0x0307, 0x0074, 0x0307, 0x0054, 0x0323, 0x0074, 0x0323,
+        0x0054, 0x0331, 0x0074, 0x0331, 0x0054, 0x032D, 0x0074, 0x032D, 0x0055, 0x0324, 0x0075, 0x0324,
+        0x0055, 0x0330, 0x0075, 0x0330, 0x0055, 0x032D, 0x0075, 0x032D, 0x0055, 0x0303, 0x0301, 0x0075,
+        0x0303, 0x0301, 0x0055, 0x0304, 0x0308, 0x0075, 0x0304, 0x0308, 0x0056, 0x0303, 0x0076, 0x0303,
+        0x0056, 0x0323, 0x0076, 0x0323, 0x0057, 0x0300, 0x0077, 0x0300, 0x0057, 0x0301, 0x0077, 0x0301,
+        0x0057, 0x0308, 0x0077, 0x0308, 0x0057, 0x0307, 0x0077, 0x0307, 0x0057, 0x0323, 0x0077, 0x0323,
+        0x0058, 0x0307, 0x0078, 0x0307, 0x0058, 0x0308, 0x0078, 0x0308, 0x0059, 0x0307, 0x0079, 0x0307,
+        0x005A, 0x0302, 0x007A, 0x0302, 0x005A, 0x0323, 0x007A, 0x0323, 0x005A, 0x0331, 0x007A, 0x0331,
+        0x0068, 0x0331, 0x0074, 0x0308, 0x0077, 0x030A, 0x0079, 0x030A, 0x0061, 0x02BE, 0x017F, 0x0307,
+        0x0073, 0x0307, 0x0041, 0x0323, 0x0061, 0x0323, 0x0041, 0x0309, 0x0061, 0x0309, 0x0041, 0x0302,
+        0x0301, 0x0061, 0x0302, 0x0301, 0x0041, 0x0302, 0x0300, 0x0061, 0x0302, 0x0300, 0x0041, 0x0302,
+        0x0309, 0x0061, 0x0302, 0x0309, 0x0041, 0x0302, 0x0303, 0x0061, 0x0302, 0x0303, 0x0041, 0x0323,
+        0x0302, 0x0061, 0x0323, 0x0302, 0x0041, 0x0306, 0x0301, 0x0061, 0x0306, 0x0301, 0x0041, 0x0306,
+        0x0300, 0x0061, 0x0306, 0x0300, 0x0041, 0x0306, 0x0309, 0x0061, 0x0306, 0x0309, 0x0041, 0x0306,
+        0x0303, 0x0061, 0x0306, 0x0303, 0x0041, 0x0323, 0x0306, 0x0061, 0x0323, 0x0306, 0x0045, 0x0323,
+        0x0065, 0x0323, 0x0045, 0x0309, 0x0065, 0x0309, 0x0045, 0x0303, 0x0065, 0x0303, 0x0045, 0x0302,
+        0x0301, 0x0065, 0x0302, 0x0301, 0x0045, 0x0302, 0x0300, 0x0065, 0x0302, 0x0300, 0x0045, 0x0302,
+        0x0309, 0x0065, 0x0302, 0x0309, 0x0045, 0x0302, 0x0303, 0x0065, 0x0302, 0x0303, 0x0045, 0x0323,
+        0x0302, 0x0065, 0x0323, 0x0302, 0x0049, 0x0309, 0x0069, 0x0309, 0x0049, 0x0323, 0x0069, 0x0323,
+        0x004F, 0x0323, 0x006F, 0x0323, 0x004F, 0x0309, 0x006F, 0x0309, 0x004F, 0x0302, 0x0301, 0x006F,
+        0x0302, 0x0301, 0x004F, 0x0302, 0x0300, 0x006F, 0x0302, 0x0300, 0x004F, 0x0302, 0x0309, 0x006F,
+        0x0302, 0x0309, 0x004F, 0x0302, 0x0303, 0x006F, 0x0302, 0x0303, 0x004F, 0x0323, 0x0302, 0x006F,
+        0x0323, 0x0302, 0x004F, 0x031B, 0x0301, 0x006F, 0x031B, 0x0301, 0x004F, 0x031B, 0x0300, 0x006F,
+        0x031B, 0x0300, 0x004F, 0x031B, 0x0309, 0x006F, 0x031B, 0x0309, 0x004F, 0x031B, 0x0303, 0x006F,
+        0x031B, 0x0303, 0x004F, 0x031B, 0x0323, 0x006F, 0x031B, 0x0323, 0x0055, 0x0323, 0x0075, 0x0323,
+        0x0055, 0x0309, 0x0075, 0x0309, 0x0055, 0x031B, 0x0301, 0x0075, 0x031B, 0x0301, 0x0055, 0x031B,
+        0x0300, 0x0075, 0x031B, 0x0300, 0x0055, 0x031B, 0x0309, 0x0075, 0x031B, 0x0309, 0x0055, 0x031B,
+        0x0303, 0x0075, 0x031B, 0x0303, 0x0055, 0x031B, 0x0323, 0x0075, 0x031B, 0x0323, 0x0059, 0x0300,
+        0x0079, 0x0300, 0x0059, 0x0323, 0x0079, 0x0323, 0x0059, 0x0309, 0x0079, 0x0309, 0x0059, 0x0303,
+        0x0079, 0x0303, 0x03B1, 0x0313, 0x03B1, 0x0314, 0x03B1, 0x0313, 0x0300, 0x03B1, 0x0314, 0x0300,
+        0x03B1, 0x0313, 0x0301, 0x03B1, 0x0314, 0x0301, 0x03B1, 0x0313, 0x0342, 0x03B1, 0x0314, 0x0342,
+        0x0391, 0x0313, 0x0391, 0x0314, 0x0391, 0x0313, 0x0300, 0x0391, 0x0314, 0x0300, 0x0391, 0x0313,
+        0x0301, 0x0391, 0x0314, 0x0301, 0x0391, 0x0313, 0x0342, 0x0391, 0x0314, 0x0342, 0x03B5, 0x0313,
+        0x03B5, 0x0314, 0x03B5, 0x0313, 0x0300, 0x03B5, 0x0314, 0x0300, 0x03B5, 0x0313, 0x0301, 0x03B5,
+        0x0314, 0x0301, 0x0395, 0x0313, 0x0395, 0x0314, 0x0395, 0x0313, 0x0300, 0x0395, 0x0314, 0x0300,
+        0x0395, 0x0313, 0x0301, 0x0395, 0x0314, 0x0301, 0x03B7, 0x0313, 0x03B7, 0x0314, 0x03B7, 0x0313,
+        0x0300, 0x03B7, 0x0314, 0x0300, 0x03B7, 0x0313, 0x0301, 0x03B7, 0x0314, 0x0301, 0x03B7, 0x0313,
+        0x0342, 0x03B7, 0x0314, 0x0342, 0x0397, 0x0313, 0x0397, 0x0314, 0x0397, 0x0313, 0x0300, 0x0397,
+        0x0314, 0x0300, 0x0397, 0x0313, 0x0301, 0x0397, 0x0314, 0x0301, 0x0397, 0x0313, 0x0342, 0x0397,
+        0x0314, 0x0342, 0x03B9, 0x0313, 0x03B9, 0x0314, 0x03B9, 0x0313, 0x0300, 0x03B9, 0x0314, 0x0300,
+        0x03B9, 0x0313, 0x0301, 0x03B9, 0x0314, 0x0301, 0x03B9, 0x0313, 0x0342, 0x03B9, 0x0314, 0x0342,
+        0x0399, 0x0313, 0x0399, 0x0314, 0x0399, 0x0313, 0x0300, 0x0399, 0x0314, 0x0300, 0x0399, 0x0313,
+        0x0301, 0x0399, 0x0314, 0x0301, 0x0399, 0x0313, 0x0342, 0x0399, 0x0314, 0x0342, 0x03BF, 0x0313,
+        0x03BF, 0x0314, 0x03BF, 0x0313, 0x0300, 0x03BF, 0x0314, 0x0300, 0x03BF, 0x0313, 0x0301, 0x03BF,
+        0x0314, 0x0301, 0x039F, 0x0313, 0x039F, 0x0314, 0x039F, 0x0313, 0x0300, 0x039F, 0x0314, 0x0300,
+        0x039F, 0x0313, 0x0301, 0x039F, 0x0314, 0x0301, 0x03C5, 0x0313, 0x03C5, 0x0314, 0x03C5, 0x0313,
+        0x0300, 0x03C5, 0x0314, 0x0300, 0x03C5, 0x0313, 0x0301, 0x03C5, 0x0314, 0x0301, 0x03C5, 0x0313,
+        0x0342, 0x03C5, 0x0314, 0x0342, 0x03A5, 0x0314, 0x03A5, 0x0314, 0x0300, 0x03A5, 0x0314, 0x0301,
+        0x03A5, 0x0314, 0x0342, 0x03C9, 0x0313, 0x03C9, 0x0314, 0x03C9, 0x0313, 0x0300, 0x03C9, 0x0314,
+        0x0300, 0x03C9, 0x0313, 0x0301, 0x03C9, 0x0314, 0x0301, 0x03C9, 0x0313, 0x0342, 0x03C9, 0x0314,
+        0x0342, 0x03A9, 0x0313, 0x03A9, 0x0314, 0x03A9, 0x0313, 0x0300, 0x03A9, 0x0314, 0x0300, 0x03A9,
+        0x0313, 0x0301, 0x03A9, 0x0314, 0x0301, 0x03A9, 0x0313, 0x0342, 0x03A9, 0x0314, 0x0342, 0x03B1,
+        0x0300, 0x03B1, 0x0301, 0x03B5, 0x0300, 0x03B5, 0x0301, 0x03B7, 0x0300, 0x03B7, 0x0301, 0x03B9,
+        0x0300, 0x03B9, 0x0301, 0x03BF, 0x0300, 0x03BF, 0x0301, 0x03C5, 0x0300, 0x03C5, 0x0301, 0x03C9,
+        0x0300, 0x03C9, 0x0301, 0x03B1, 0x0313, 0x0345, 0x03B1, 0x0314, 0x0345, 0x03B1, 0x0313, 0x0300,
+        0x0345, 0x03B1, 0x0314, 0x0300, 0x0345, 0x03B1, 0x0313, 0x0301, 0x0345, 0x03B1, 0x0314, 0x0301,
+        0x0345, 0x03B1, 0x0313, 0x0342, 0x0345, 0x03B1, 0x0314, 0x0342, 0x0345, 0x0391, 0x0313, 0x0345,
+        0x0391, 0x0314, 0x0345, 0x0391, 0x0313, 0x0300, 0x0345, 0x0391, 0x0314, 0x0300, 0x0345, 0x0391,
+        0x0313, 0x0301, 0x0345, 0x0391, 0x0314, 0x0301, 0x0345, 0x0391, 0x0313, 0x0342, 0x0345, 0x0391,
+        0x0314, 0x0342, 0x0345, 0x03B7, 0x0313, 0x0345, 0x03B7, 0x0314, 0x0345, 0x03B7, 0x0313, 0x0300,
+        0x0345, 0x03B7, 0x0314, 0x0300, 0x0345, 0x03B7, 0x0313, 0x0301, 0x0345, 0x03B7, 0x0314, 0x0301,
+        0x0345, 0x03B7, 0x0313, 0x0342, 0x0345, 0x03B7, 0x0314, 0x0342, 0x0345, 0x0397, 0x0313, 0x0345,
+        0x0397, 0x0314, 0x0345, 0x0397, 0x0313, 0x0300, 0x0345, 0x0397, 0x0314, 0x0300, 0x0345, 0x0397,
+        0x0313, 0x0301, 0x0345, 0x0397, 0x0314, 0x0301, 0x0345, 0x0397, 0x0313, 0x0342, 0x0345, 0x0397,
+        0x0314, 0x0342, 0x0345, 0x03C9, 0x0313, 0x0345, 0x03C9, 0x0314, 0x0345, 0x03C9, 0x0313, 0x0300,
+        0x0345, 0x03C9, 0x0314, 0x0300, 0x0345, 0x03C9, 0x0313, 0x0301, 0x0345, 0x03C9, 0x0314, 0x0301,
+        0x0345, 0x03C9, 0x0313, 0x0342, 0x0345, 0x03C9, 0x0314, 0x0342, 0x0345, 0x03A9, 0x0313, 0x0345,
+        0x03A9, 0x0314, 0x0345, 0x03A9, 0x0313, 0x0300, 0x0345, 0x03A9, 0x0314, 0x0300, 0x0345, 0x03A9,
+        0x0313, 0x0301, 0x0345, 0x03A9, 0x0314, 0x0301, 0x0345, 0x03A9, 0x0313, 0x0342, 0x0345, 0x03A9,
+        0x0314, 0x0342, 0x0345, 0x03B1, 0x0306, 0x03B1, 0x0304, 0x03B1, 0x0300, 0x0345, 0x03B1, 0x0345,
+        0x03B1, 0x0301, 0x0345, 0x03B1, 0x0342, 0x03B1, 0x0342, 0x0345, 0x0391, 0x0306, 0x0391, 0x0304,
+        0x0391, 0x0300, 0x0391, 0x0301, 0x0391, 0x0345, 0x0020, 0x0313, 0x03B9, 0x0020, 0x0313, 0x0020,
+        0x0342, 0x00A8, 0x0342, 0x0020, 0x0308, 0x0342, 0x03B7, 0x0300, 0x0345, 0x03B7, 0x0345, 0x03B7,
+        0x0301, 0x0345, 0x03B7, 0x0342, 0x03B7, 0x0342, 0x0345, 0x0395, 0x0300, 0x0395, 0x0301, 0x0397,
+        0x0300, 0x0397, 0x0301, 0x0397, 0x0345, 0x1FBF, 0x0300, 0x0020, 0x0313, 0x0300, 0x1FBF, 0x0301,
+        0x0020, 0x0313, 0x0301, 0x1FBF, 0x0342, 0x0020, 0x0313, 0x0342, 0x03B9, 0x0306, 0x03B9, 0x0304,
+        0x03B9, 0x0308, 0x0300, 0x03B9, 0x0308, 0x0301, 0x03B9, 0x0342, 0x03B9, 0x0308, 0x0342, 0x0399,
+        0x0306, 0x0399, 0x0304, 0x0399, 0x0300, 0x0399, 0x0301, 0x1FFE, 0x0300, 0x0020, 0x0314, 0x0300,
+        0x1FFE, 0x0301, 0x0020, 0x0314, 0x0301, 0x1FFE, 0x0342, 0x0020, 0x0314, 0x0342, 0x03C5, 0x0306,
+        0x03C5, 0x0304, 0x03C5, 0x0308, 0x0300, 0x03C5, 0x0308, 0x0301, 0x03C1, 0x0313, 0x03C1, 0x0314,
+        0x03C5, 0x0342, 0x03C5, 0x0308, 0x0342, 0x03A5, 0x0306, 0x03A5, 0x0304, 0x03A5, 0x0300, 0x03A5,
+        0x0301, 0x03A1, 0x0314, 0x00A8, 0x0300, 0x0020, 0x0308, 0x0300, 0x00A8, 0x0301, 0x0020, 0x0308,
+        0x0301, 0x0060, 0x03C9, 0x0300, 0x0345, 0x03C9, 0x0345, 0x03C9, 0x0301, 0x0345, 0x03C9, 0x0342,
+        0x03C9, 0x0342, 0x0345, 0x039F, 0x0300, 0x039F, 0x0301, 0x03A9, 0x0300, 0x03A9, 0x0301, 0x03A9,
+        0x0345, 0x00B4, 0x0020, 0x0301, 0x0020, 0x0314, 0x2002, 0x0020, 0x2003, 0x0020, 0x0020, 0x0020,
+        0x0020, 0x0020, 0x0020, 0x0020, 0x0020, 0x0020, 0x0020, 0x2010, 0x0020, 0x0333, 0x002E, 0x002E,
+        0x002E, 0x002E, 0x002E, 0x002E, 0x0020, 0x2032, 0x2032, 0x2032, 0x2032, 0x2032, 0x2035, 0x2035,
+        0x2035, 0x2035, 0x2035, 0x0021, 0x0021, 0x0020, 0x0305, 0x003F, 0x003F, 0x003F, 0x0021, 0x0021,
+        0x003F, 0x2032, 0x2032, 0x2032, 0x2032, 0x0020, 0x0030, 0x0069, 0x0034, 0x0035, 0x0036, 0x0037,
+        0x0038, 0x0039, 0x002B, 0x2212, 0x003D, 0x0028, 0x0029, 0x006E, 0x0030, 0x0031, 0x0032, 0x0033,
+        0x0034, 0x0035, 0x0036, 0x0037, 0x0038, 0x0039, 0x002B, 0x2212, 0x003D, 0x0028, 0x0029, 0x0061,
+        0x0065, 0x006F, 0x0078, 0x0259, 0x0068, 0x006B, 0x006C, 0x006D, 0x006E, 0x0070, 0x0073, 0x0074,
+        0x0052, 0x0073, 0x0061, 0x002F, 0x0063, 0x0061, 0x002F, 0x0073, 0x0043, 0x00B0, 0x0043, 0x0063,
+        0x002F, 0x006F, 0x0063, 0x002F, 0x0075, 0x0190, 0x00B0, 0x0046, 0x0067, 0x0048, 0x0048, 0x0048,
+        0x0068, 0x0127, 0x0049, 0x0049, 0x004C, 0x006C, 0x004E, 0x004E, 0x006F, 0x0050, 0x0051, 0x0052,
+        0x0052, 0x0052, 0x0053, 0x004D, 0x0054, 0x0045, 0x004C, 0x0054, 0x004D, 0x005A, 0x03A9, 0x005A,
+        0x004B, 0x0041, 0x030A, 0x0042, 0x0043, 0x0065, 0x0045, 0x0046, 0x004D, 0x006F, 0x05D0, 0x05D1,
+        0x05D2, 0x05D3, 0x0069, 0x0046, 0x0041, 0x0058, 0x03C0, 0x03B3, 0x0393, 0x03A0, 0x2211, 0x0044,
+        0x0064, 0x0065, 0x0069, 0x006A, 0x0031, 0x2044, 0x0037, 0x0031, 0x2044, 0x0039, 0x0031, 0x2044,
+        0x0031, 0x0030, 0x0031, 0x2044, 0x0033, 0x0032, 0x2044, 0x0033, 0x0031, 0x2044, 0x0035, 0x0032,
+        0x2044, 0x0035, 0x0033, 0x2044, 0x0035, 0x0034, 0x2044, 0x0035, 0x0031, 0x2044, 0x0036, 0x0035,
+        0x2044, 0x0036, 0x0031, 0x2044, 0x0038, 0x0033, 0x2044, 0x0038, 0x0035, 0x2044, 0x0038, 0x0037,
+        0x2044, 0x0038, 0x0031, 0x2044, 0x0049, 0x0049, 0x0049, 0x0049, 0x0049, 0x0049, 0x0049, 0x0056,
+        0x0056, 0x0056, 0x0049, 0x0056, 0x0049, 0x0049, 0x0056, 0x0049, 0x0049, 0x0049, 0x0049, 0x0058,
+        0x0058, 0x0058, 0x0049, 0x0058, 0x0049, 0x0049, 0x004C, 0x0043, 0x0044, 0x004D, 0x0069, 0x0069,
+        0x0069, 0x0069, 0x0069, 0x0069, 0x0069, 0x0076, 0x0076, 0x0076, 0x0069, 0x0076, 0x0069, 0x0069,
+        0x0076, 0x0069, 0x0069, 0x0069, 0x0069, 0x0078, 0x0078, 0x0078, 0x0069, 0x0078, 0x0069, 0x0069,
+        0x006C, 0x0063, 0x0064, 0x006D, 0x0030, 0x2044, 0x0033, 0x2190, 0x0338, 0x2192, 0x0338, 0x2194,
+        0x0338, 0x21D0, 0x0338, 0x21D4, 0x0338, 0x21D2, 0x0338, 0x2203, 0x0338, 0x2208, 0x0338, 0x220B,
+        0x0338, 0x2223, 0x0338, 0x2225, 0x0338, 0x222B, 0x222B, 0x222B, 0x222B, 0x222B, 0x222E, 0x222E,
+        0x222E, 0x222E, 0x222E, 0x223C, 0x0338, 0x2243, 0x0338, 0x2245, 0x0338, 0x2248, 0x0338, 0x003D,
+        0x0338, 0x2261, 0x0338, 0x224D, 0x0338, 0x003C, 0x0338, 0x003E, 0x0338, 0x2264, 0x0338, 0x2265,
+        0x0338, 0x2272, 0x0338, 0x2273, 0x0338, 0x2276, 0x0338, 0x2277, 0x0338, 0x227A, 0x0338, 0x227B,
+        0x0338, 0x2282, 0x0338, 0x2283, 0x0338, 0x2286, 0x0338, 0x2287, 0x0338, 0x22A2, 0x0338, 0x22A8,
+        0x0338, 0x22A9, 0x0338, 0x22AB, 0x0338, 0x227C, 0x0338, 0x227D, 0x0338, 0x2291, 0x0338, 0x2292,
+        0x0338, 0x22B2, 0x0338, 0x22B3, 0x0338, 0x22B4, 0x0338, 0x22B5, 0x0338, 0x3008, 0x3009, 0x0031,
+        0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037, 0x0038, 0x0039, 0x0031, 0x0030, 0x0031, 0x0031,
+        0x0031, 0x0032, 0x0031, 0x0033, 0x0031, 0x0034, 0x0031, 0x0035, 0x0031, 0x0036, 0x0031, 0x0037,
+        0x0031, 0x0038, 0x0031, 0x0039, 0x0032, 0x0030, 0x0028, 0x0031, 0x0029, 0x0028, 0x0032, 0x0029,
+        0x0028, 0x0033, 0x0029, 0x0028, 0x0034, 0x0029, 0x0028, 0x0035, 0x0029, 0x0028, 0x0036, 0x0029,
+        0x0028, 0x0037, 0x0029, 0x0028, 0x0038, 0x0029, 0x0028, 0x0039, 0x0029, 0x0028, 0x0031, 0x0030,
+        0x0029, 0x0028, 0x0031, 0x0031, 0x0029, 0x0028, 0x0031, 0x0032, 0x0029, 0x0028, 0x0031, 0x0033,
+        0x0029, 0x0028, 0x0031, 0x0034, 0x0029, 0x0028, 0x0031, 0x0035, 0x0029, 0x0028, 0x0031, 0x0036,
+        0x0029, 0x0028, 0x0031, 0x0037, 0x0029, 0x0028, 0x0031, 0x0038, 0x0029, 0x0028, 0x0031, 0x0039,
+        0x0029, 0x0028, 0x0032, 0x0030, 0x0029, 0x0031, 0x002E, 0x0032, 0x002E, 0x0033, 0x002E, 0x0034,
+        0x002E, 0x0035, 0x002E, 0x0036, 0x002E, 0x0037, 0x002E, 0x0038, 0x002E, 0x0039, 0x002E, 0x0031,
+        0x0030, 0x002E, 0x0031, 0x0031, 0x002E, 0x0031, 0x0032, 0x002E, 0x0031, 0x0033, 0x002E, 0x0031,
+        0x0034, 0x002E, 0x0031, 0x0035, 0x002E, 0x0031, 0x0036, 0x002E, 0x0031, 0x0037, 0x002E, 0x0031,
+        0x0038, 0x002E, 0x0031, 0x0039, 0x002E, 0x0032, 0x0030, 0x002E, 0x0028, 0x0061, 0x0029, 0x0028,
+        0x0062, 0x0029, 0x0028, 0x0063, 0x0029, 0x0028, 0x0064, 0x0029, 0x0028, 0x0065, 0x0029, 0x0028,
+        0x0066, 0x0029, 0x0028, 0x0067, 0x0029, 0x0028, 0x0068, 0x0029, 0x0028, 0x0069, 0x0029, 0x0028,
+        0x006A, 0x0029, 0x0028, 0x006B, 0x0029, 0x0028, 0x006C, 0x0029, 0x0028, 0x006D, 0x0029, 0x0028,
+        0x006E, 0x0029, 0x0028, 0x006F, 0x0029, 0x0028, 0x0070, 0x0029, 0x0028, 0x0071, 0x0029, 0x0028,
+        0x0072, 0x0029, 0x0028, 0x0073, 0x0029, 0x0028, 0x0074, 0x0029, 0x0028, 0x0075, 0x0029, 0x0028,
+        0x0076, 0x0029, 0x0028, 0x0077, 0x0029, 0x0028, 0x0078, 0x0029, 0x0028, 0x0079, 0x0029, 0x0028,
+        0x007A, 0x0029, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047, 0x0048, 0x0049, 0x004A,
+        0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056,
+        0x0057, 0x0058, 0x0059, 0x005A, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067, 0x0068,
+        0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F, 0x0070, 0x0071, 0x0072, 0x0073, 0x0074,
+        0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x0030, 0x222B, 0x222B, 0x222B, 0x222B, 0x003A,
+        0x003A, 0x003D, 0x003D, 0x003D, 0x003D, 0x003D, 0x003D, 0x2ADD, 0x0338, 0x006A, 0x0056, 0x2D61,
+        0x6BCD, 0x9F9F, 0x4E00, 0x4E28, 0x4E36, 0x4E3F, 0x4E59, 0x4E85, 0x4E8C, 0x4EA0, 0x4EBA, 0x513F,
+        0x5165, 0x516B, 0x5182, 0x5196, 0x51AB, 0x51E0, 0x51F5, 0x5200, 0x529B, 0x52F9, 0x5315, 0x531A,
+        0x5338, 0x5341, 0x535C, 0x5369, 0x5382, 0x53B6, 0x53C8, 0x53E3, 0x56D7, 0x571F, 0x58EB, 0x5902,
+        0x590A, 0x5915, 0x5927, 0x5973, 0x5B50, 0x5B80, 0x5BF8, 0x5C0F, 0x5C22, 0x5C38, 0x5C6E, 0x5C71,
+        0x5DDB, 0x5DE5, 0x5DF1, 0x5DFE, 0x5E72, 0x5E7A, 0x5E7F, 0x5EF4, 0x5EFE, 0x5F0B, 0x5F13, 0x5F50,
+        0x5F61, 0x5F73, 0x5FC3, 0x6208, 0x6236, 0x624B, 0x652F, 0x6534, 0x6587, 0x6597, 0x65A4, 0x65B9,
+        0x65E0, 0x65E5, 0x66F0, 0x6708, 0x6728, 0x6B20, 0x6B62, 0x6B79, 0x6BB3, 0x6BCB, 0x6BD4, 0x6BDB,
+        0x6C0F, 0x6C14, 0x6C34, 0x706B, 0x722A, 0x7236, 0x723B, 0x723F, 0x7247, 0x7259, 0x725B, 0x72AC,
+        0x7384, 0x7389, 0x74DC, 0x74E6, 0x7518, 0x751F, 0x7528, 0x7530, 0x758B, 0x7592, 0x7676, 0x767D,
+        0x76AE, 0x76BF, 0x76EE, 0x77DB, 0x77E2, 0x77F3, 0x793A, 0x79B8, 0x79BE, 0x7A74, 0x7ACB, 0x7AF9,
+        0x7C73, 0x7CF8, 0x7F36, 0x7F51, 0x7F8A, 0x7FBD, 0x8001, 0x800C, 0x8012, 0x8033, 0x807F, 0x8089,
+        0x81E3, 0x81EA, 0x81F3, 0x81FC, 0x820C, 0x821B, 0x821F, 0x826E, 0x8272, 0x8278, 0x864D, 0x866B,
+        0x8840, 0x884C, 0x8863, 0x897E, 0x898B, 0x89D2, 0x8A00, 0x8C37, 0x8C46, 0x8C55, 0x8C78, 0x8C9D,
+        0x8D64, 0x8D70, 0x8DB3, 0x8EAB, 0x8ECA, 0x8F9B, 0x8FB0, 0x8FB5, 0x9091, 0x9149, 0x91C6, 0x91CC,
+        0x91D1, 0x9577, 0x9580, 0x961C, 0x96B6, 0x96B9, 0x96E8, 0x9751, 0x975E, 0x9762, 0x9769, 0x97CB,
+        0x97ED, 0x97F3, 0x9801, 0x98A8, 0x98DB, 0x98DF, 0x9996, 0x9999, 0x99AC, 0x9AA8, 0x9AD8, 0x9ADF,
+        0x9B25, 0x9B2F, 0x9B32, 0x9B3C, 0x9B5A, 0x9CE5, 0x9E75, 0x9E7F, 0x9EA5, 0x9EBB, 0x9EC3, 0x9ECD,
+        0x9ED1, 0x9EF9, 0x9EFD, 0x9F0E, 0x9F13, 0x9F20, 0x9F3B, 0x9F4A, 0x9F52, 0x9F8D, 0x9F9C, 0x9FA0,
+        0x0020, 0x3012, 0x5341, 0x5344, 0x5345, 0x304B, 0x3099, 0x304D, 0x3099, 0x304F, 0x3099, 0x3051,
+        0x3099, 0x3053, 0x3099, 0x3055, 0x3099, 0x3057, 0x3099, 0x3059, 0x3099, 0x305B, 0x3099, 0x305D,
+        0x3099, 0x305F, 0x3099, 0x3061, 0x3099, 0x3064, 0x3099, 0x3066, 0x3099, 0x3068, 0x3099, 0x306F,
+        0x3099, 0x306F, 0x309A, 0x3072, 0x3099, 0x3072, 0x309A, 0x3075, 0x3099, 0x3075, 0x309A, 0x3078,
+        0x3099, 0x3078, 0x309A, 0x307B, 0x3099, 0x307B, 0x309A, 0x3046, 0x3099, 0x0020, 0x3099, 0x0020,
+        0x309A, 0x309D, 0x3099, 0x3088, 0x308A, 0x30AB, 0x3099, 0x30AD, 0x3099, 0x30AF, 0x3099, 0x30B1,
+        0x3099, 0x30B3, 0x3099, 0x30B5, 0x3099, 0x30B7, 0x3099, 0x30B9, 0x3099, 0x30BB, 0x3099, 0x30BD,
+        0x3099, 0x30BF, 0x3099, 0x30C1, 0x3099, 0x30C4, 0x3099, 0x30C6, 0x3099, 0x30C8, 0x3099, 0x30CF,
+        0x3099, 0x30CF, 0x309A, 0x30D2, 0x3099, 0x30D2, 0x309A, 0x30D5, 0x3099, 0x30D5, 0x309A, 0x30D8,
+        0x3099, 0x30D8, 0x309A, 0x30DB, 0x3099, 0x30DB, 0x309A, 0x30A6, 0x3099, 0x30EF, 0x3099, 0x30F0,
+        0x3099, 0x30F1, 0x3099, 0x30F2, 0x3099, 0x30FD, 0x3099, 0x30B3, 0x30C8, 0x1100, 0x1101, 0x11AA,
+        0x1102, 0x11AC, 0x11AD, 0x1103, 0x1104, 0x1105, 0x11B0, 0x11B1, 0x11B2, 0x11B3, 0x11B4, 0x11B5,
+        0x111A, 0x1106, 0x1107, 0x1108, 0x1121, 0x1109, 0x110A, 0x110B, 0x110C, 0x110D, 0x110E, 0x110F,
+        0x1110, 0x1111, 0x1112, 0x1161, 0x1162, 0x1163, 0x1164, 0x1165, 0x1166, 0x1167, 0x1168, 0x1169,
+        0x116A, 0x116B, 0x116C, 0x116D, 0x116E, 0x116F, 0x1170, 0x1171, 0x1172, 0x1173, 0x1174, 0x1175,
+        0x1160, 0x1114, 0x1115, 0x11C7, 0x11C8, 0x11CC, 0x11CE, 0x11D3, 0x11D7, 0x11D9, 0x111C, 0x11DD,
+        0x11DF, 0x111D, 0x111E, 0x1120, 0x1122, 0x1123, 0x1127, 0x1129, 0x112B, 0x112C, 0x112D, 0x112E,
+        0x112F, 0x1132, 0x1136, 0x1140, 0x1147, 0x114C, 0x11F1, 0x11F2, 0x1157, 0x1158, 0x1159, 0x1184,
+        0x1185, 0x1188, 0x1191, 0x1192, 0x1194, 0x119E, 0x11A1, 0x4E00, 0x4E8C, 0x4E09, 0x56DB, 0x4E0A,
+        0x4E2D, 0x4E0B, 0x7532, 0x4E59, 0x4E19, 0x4E01, 0x5929, 0x5730, 0x4EBA, 0x0028, 0x1100, 0x0029,
+        0x0028, 0x1102, 0x0029, 0x0028, 0x1103, 0x0029, 0x0028, 0x1105, 0x0029, 0x0028, 0x1106, 0x0029,
+        0x0028, 0x1107, 0x0029, 0x0028, 0x1109, 0x0029, 0x0028, 0x110B, 0x0029, 0x0028, 0x110C, 0x0029,
+        0x0028, 0x110E, 0x0029, 0x0028, 0x110F, 0x0029, 0x0028, 0x1110, 0x0029, 0x0028, 0x1111, 0x0029,
+        0x0028, 0x1112, 0x0029, 0x0028, 0x1100, 0x1161, 0x0029, 0x0028, 0x1102, 0x1161, 0x0029, 0x0028,
+        0x1103, 0x1161, 0x0029, 0x0028, 0x1105, 0x1161, 0x0029, 0x0028, 0x1106, 0x1161, 0x0029, 0x0028,
+        0x1107, 0x1161, 0x0029, 0x0028, 0x1109, 0x1161, 0x0029, 0x0028, 0x110B, 0x1161, 0x0029, 0x0028,
+        0x110C, 0x1161, 0x0029, 0x0028, 0x110E, 0x1161, 0x0029, 0x0028, 0x110F, 0x1161, 0x0029, 0x0028,
+        0x1110, 0x1161, 0x0029, 0x0028, 0x1111, 0x1161, 0x0029, 0x0028, 0x1112, 0x1161, 0x0029, 0x0028,
+        0x110C, 0x116E, 0x0029, 0x0028, 0x110B, 0x1169, 0x110C, 0x1165, 0x11AB, 0x0029, 0x0028, 0x110B,
+        0x1169, 0x1112, 0x116E, 0x0029, 0x0028, 0x4E00, 0x0029, 0x0028, 0x4E8C, 0x0029, 0x0028, 0x4E09,
+        0x0029, 0x0028, 0x56DB, 0x0029, 0x0028, 0x4E94, 0x0029, 0x0028, 0x516D, 0x0029, 0x0028, 0x4E03,
+        0x0029, 0x0028, 0x516B, 0x0029, 0x0028, 0x4E5D, 0x0029, 0x0028, 0x5341, 0x0029, 0x0028, 0x6708,
+        0x0029, 0x0028, 0x706B, 0x0029, 0x0028, 0x6C34, 0x0029, 0x0028, 0x6728, 0x0029, 0x0028, 0x91D1,
+        0x0029, 0x0028, 0x571F, 0x0029, 0x0028, 0x65E5, 0x0029, 0x0028, 0x682A, 0x0029, 0x0028, 0x6709,
+        0x0029, 0x0028, 0x793E, 0x0029, 0x0028, 0x540D, 0x0029, 0x0028, 0x7279, 0x0029, 0x0028, 0x8CA1,
+        0x0029, 0x0028, 0x795D, 0x0029, 0x0028, 0x52B4, 0x0029, 0x0028, 0x4EE3, 0x0029, 0x0028, 0x547C,
+        0x0029, 0x0028, 0x5B66, 0x0029, 0x0028, 0x76E3, 0x0029, 0x0028, 0x4F01, 0x0029, 0x0028, 0x8CC7,
+        0x0029, 0x0028, 0x5354, 0x0029, 0x0028, 0x796D, 0x0029, 0x0028, 0x4F11, 0x0029, 0x0028, 0x81EA,
+        0x0029, 0x0028, 0x81F3, 0x0029, 0x554F, 0x5E7C, 0x6587, 0x7B8F, 0x0050, 0x0054, 0x0045, 0x0032,
+        0x0031, 0x0032, 0x0032, 0x0032, 0x0033, 0x0032, 0x0034, 0x0032, 0x0035, 0x0032, 0x0036, 0x0032,
+        0x0037, 0x0032, 0x0038, 0x0032, 0x0039, 0x0033, 0x0030, 0x0033, 0x0031, 0x0033, 0x0032, 0x0033,
+        0x0033, 0x0033, 0x0034, 0x0033, 0x0035, 0x1100, 0x1102, 0x1103, 0x1105, 0x1106, 0x1107, 0x1109,
+        0x110B, 0x110C, 0x110E, 0x110F, 0x1110, 0x1111, 0x1112, 0x1100, 0x1161, 0x1102, 0x1161, 0x1103,
+        0x1161, 0x1105, 0x1161, 0x1106, 0x1161, 0x1107, 0x1161, 0x1109, 0x1161, 0x110B, 0x1161, 0x110C,
+        0x1161, 0x110E, 0x1161, 0x110F, 0x1161, 0x1110, 0x1161, 0x1111, 0x1161, 0x1112, 0x1161, 0x110E,
+        0x1161, 0x11B7, 0x1100, 0x1169, 0x110C, 0x116E, 0x110B, 0x1174, 0x110B, 0x116E, 0x4E00, 0x4E8C,
+        0x4E09, 0x56DB, 0x4E94, 0x516D, 0x4E03, 0x516B, 0x4E5D, 0x5341, 0x6708, 0x706B, 0x6C34, 0x6728,
+        0x91D1, 0x571F, 0x65E5, 0x682A, 0x6709, 0x793E, 0x540D, 0x7279, 0x8CA1, 0x795D, 0x52B4, 0x79D8,
+        0x7537, 0x5973, 0x9069, 0x512A, 0x5370, 0x6CE8, 0x9805, 0x4F11, 0x5199, 0x6B63, 0x4E0A, 0x4E2D,
+        0x4E0B, 0x5DE6, 0x53F3, 0x533B, 0x5B97, 0x5B66, 0x76E3, 0x4F01, 0x8CC7, 0x5354, 0x591C, 0x0033,
+        0x0036, 0x0033, 0x0037, 0x0033, 0x0038, 0x0033, 0x0039, 0x0034, 0x0030, 0x0034, 0x0031, 0x0034,
+        0x0032, 0x0034, 0x0033, 0x0034, 0x0034, 0x0034, 0x0035, 0x0034, 0x0036, 0x0034, 0x0037, 0x0034,
+        0x0038, 0x0034, 0x0039, 0x0035, 0x0030, 0x0031, 0x6708, 0x0032, 0x6708, 0x0033, 0x6708, 0x0034,
+        0x6708, 0x0035, 0x6708, 0x0036, 0x6708, 0x0037, 0x6708, 0x0038, 0x6708, 0x0039, 0x6708, 0x0031,
+        0x0030, 0x6708, 0x0031, 0x0031, 0x6708, 0x0031, 0x0032, 0x6708, 0x0048, 0x0067, 0x0065, 0x0072,
+        0x0067, 0x0065, 0x0056, 0x004C, 0x0054, 0x0044, 0x30A2, 0x30A4, 0x30A6, 0x30A8, 0x30AA, 0x30AB,
+        0x30AD, 0x30AF, 0x30B1, 0x30B3, 0x30B5, 0x30B7, 0x30B9, 0x30BB, 0x30BD, 0x30BF, 0x30C1, 0x30C4,
+        0x30C6, 0x30C8, 0x30CA, 0x30CB, 0x30CC, 0x30CD, 0x30CE, 0x30CF, 0x30D2, 0x30D5, 0x30D8, 0x30DB,
+        0x30DE, 0x30DF, 0x30E0, 0x30E1, 0x30E2, 0x30E4, 0x30E6, 0x30E8, 0x30E9, 0x30EA, 0x30EB, 0x30EC,
+        0x30ED, 0x30EF, 0x30F0, 0x30F1, 0x30F2, 0x4EE4, 0x548C, 0x30A2, 0x30CF, 0x309A, 0x30FC, 0x30C8,
+        0x30A2, 0x30EB, 0x30D5, 0x30A1, 0x30A2, 0x30F3, 0x30D8, 0x309A, 0x30A2, 0x30A2, 0x30FC, 0x30EB,
+        0x30A4, 0x30CB, 0x30F3, 0x30AF, 0x3099, 0x30A4, 0x30F3, 0x30C1, 0x30A6, 0x30A9, 0x30F3, 0x30A8,
+        0x30B9, 0x30AF, 0x30FC, 0x30C8, 0x3099, 0x30A8, 0x30FC, 0x30AB, 0x30FC, 0x30AA, 0x30F3, 0x30B9,
+        0x30AA, 0x30FC, 0x30E0, 0x30AB, 0x30A4, 0x30EA, 0x30AB, 0x30E9, 0x30C3, 0x30C8, 0x30AB, 0x30ED,
+        0x30EA, 0x30FC, 0x30AB, 0x3099, 0x30ED, 0x30F3, 0x30AB, 0x3099, 0x30F3, 0x30DE, 0x30AD, 0x3099,
+        0x30AB, 0x3099, 0x30AD, 0x3099, 0x30CB, 0x30FC, 0x30AD, 0x30E5, 0x30EA, 0x30FC, 0x30AD, 0x3099,
+        0x30EB, 0x30BF, 0x3099, 0x30FC, 0x30AD, 0x30ED, 0x30AD, 0x30ED, 0x30AF, 0x3099, 0x30E9, 0x30E0,
+        0x30AD, 0x30ED, 0x30E1, 0x30FC, 0x30C8, 0x30EB, 0x30AD, 0x30ED, 0x30EF, 0x30C3, 0x30C8, 0x30AF,
+        0x3099, 0x30E9, 0x30E0, 0x30AF, 0x3099, 0x30E9, 0x30E0, 0x30C8, 0x30F3, 0x30AF, 0x30EB, 0x30BB,
+        0x3099, 0x30A4, 0x30ED, 0x30AF, 0x30ED, 0x30FC, 0x30CD, 0x30B1, 0x30FC, 0x30B9, 0x30B3, 0x30EB,
+        0x30CA, 0x30B3, 0x30FC, 0x30DB, 0x309A, 0x30B5, 0x30A4, 0x30AF, 0x30EB, 0x30B5, 0x30F3, 0x30C1,
+        0x30FC, 0x30E0, 0x30B7, 0x30EA, 0x30F3, 0x30AF, 0x3099, 0x30BB, 0x30F3, 0x30C1, 0x30BB, 0x30F3,
+        0x30C8, 0x30BF, 0x3099, 0x30FC, 0x30B9, 0x30C6, 0x3099, 0x30B7, 0x30C8, 0x3099, 0x30EB, 0x30C8,
+        0x30F3, 0x30CA, 0x30CE, 0x30CE, 0x30C3, 0x30C8, 0x30CF, 0x30A4, 0x30C4, 0x30CF, 0x309A, 0x30FC,
+        0x30BB, 0x30F3, 0x30C8, 0x30CF, 0x309A, 0x30FC, 0x30C4, 0x30CF, 0x3099, 0x30FC, 0x30EC, 0x30EB,
+        0x30D2, 0x309A, 0x30A2, 0x30B9, 0x30C8, 0x30EB, 0x30D2, 0x309A, 0x30AF, 0x30EB, 0x30D2, 0x309A,
+        0x30B3, 0x30D2, 0x3099, 0x30EB, 0x30D5, 0x30A1, 0x30E9, 0x30C3, 0x30C8, 0x3099, 0x30D5, 0x30A3,
+        0x30FC, 0x30C8, 0x30D5, 0x3099, 0x30C3, 0x30B7, 0x30A7, 0x30EB, 0x30D5, 0x30E9, 0x30F3, 0x30D8,
+        0x30AF, 0x30BF, 0x30FC, 0x30EB, 0x30D8, 0x309A, 0x30BD, 0x30D8, 0x309A, 0x30CB, 0x30D2, 0x30D8,
+        0x30EB, 0x30C4, 0x30D8, 0x309A, 0x30F3, 0x30B9, 0x30D8, 0x309A, 0x30FC, 0x30B7, 0x3099, 0x30D8,
+        0x3099, 0x30FC, 0x30BF, 0x30DB, 0x309A, 0x30A4, 0x30F3, 0x30C8, 0x30DB, 0x3099, 0x30EB, 0x30C8,
+        0x30DB, 0x30F3, 0x30DB, 0x309A, 0x30F3, 0x30C8, 0x3099, 0x30DB, 0x30FC, 0x30EB, 0x30DB, 0x30FC,
+        0x30F3, 0x30DE, 0x30A4, 0x30AF, 0x30ED, 0x30DE, 0x30A4, 0x30EB, 0x30DE, 0x30C3, 0x30CF, 0x30DE,
+        0x30EB, 0x30AF, 0x30DE, 0x30F3, 0x30B7, 0x30E7, 0x30F3, 0x30DF, 0x30AF, 0x30ED, 0x30F3, 0x30DF,
+        0x30EA, 0x30DF, 0x30EA, 0x30CF, 0x3099, 0x30FC, 0x30EB, 0x30E1, 0x30AB, 0x3099, 0x30E1, 0x30AB,
+        0x3099, 0x30C8, 0x30F3, 0x30E1, 0x30FC, 0x30C8, 0x30EB, 0x30E4, 0x30FC, 0x30C8, 0x3099, 0x30E4,
+        0x30FC, 0x30EB, 0x30E6, 0x30A2, 0x30F3, 0x30EA, 0x30C3, 0x30C8, 0x30EB, 0x30EA, 0x30E9, 0x30EB,
+        0x30D2, 0x309A, 0x30FC, 0x30EB, 0x30FC, 0x30D5, 0x3099, 0x30EB, 0x30EC, 0x30E0, 0x30EC, 0x30F3,
+        0x30C8, 0x30B1, 0x3099, 0x30F3, 0x30EF, 0x30C3, 0x30C8, 0x0030, 0x70B9, 0x0031, 0x70B9, 0x0032,
+        0x70B9, 0x0033, 0x70B9, 0x0034, 0x70B9, 0x0035, 0x70B9, 0x0036, 0x70B9, 0x0037, 0x70B9, 0x0038,
+        0x70B9, 0x0039, 0x70B9, 0x0031, 0x0030, 0x70B9, 0x0031, 0x0031, 0x70B9, 0x0031, 0x0032, 0x70B9,
+        0x0031, 0x0033, 0x70B9, 0x0031, 0x0034, 0x70B9, 0x0031, 0x0035, 0x70B9, 0x0031, 0x0036, 0x70B9,
+        0x0031, 0x0037, 0x70B9, 0x0031, 0x0038, 0x70B9, 0x0031, 0x0039, 0x70B9, 0x0032, 0x0030, 0x70B9,
+        0x0032, 0x0031, 0x70B9, 0x0032, 0x0032, 0x70B9, 0x0032, 0x0033, 0x70B9, 0x0032, 0x0034, 0x70B9,
+        0x0068, 0x0050, 0x0061, 0x0064, 0x0061, 0x0041, 0x0055, 0x0062, 0x0061, 0x0072, 0x006F, 0x0056,
+        0x0070, 0x0063, 0x0064, 0x006D, 0x0064, 0x006D, 0x0032, 0x0064, 0x006D, 0x0033, 0x0049, 0x0055,
+        0x5E73, 0x6210, 0x662D, 0x548C, 0x5927, 0x6B63, 0x660E, 0x6CBB, 0x682A, 0x5F0F, 0x4F1A, 0x793E,
+        0x0070, 0x0041, 0x006E, 0x0041, 0x03BC, 0x0041, 0x006D, 0x0041, 0x006B, 0x0041, 0x004B, 0x0042,
+        0x004D, 0x0042, 0x0047, 0x0042, 0x0063, 0x0061, 0x006C, 0x006B, 0x0063, 0x0061, 0x006C, 0x0070,
+        0x0046, 0x006E, 0x0046, 0x03BC, 0x0046, 0x03BC, 0x0067, 0x006D, 0x0067, 0x006B, 0x0067, 0x0048,
+        0x007A, 0x006B, 0x0048, 0x007A, 0x004D, 0x0048, 0x007A, 0x0047, 0x0048, 0x007A, 0x0054, 0x0048,
+        0x007A, 0x03BC, 0x006C, 0x006D, 0x006C, 0x0064, 0x006C, 0x006B, 0x006C, 0x0066, 0x006D, 0x006E,
+        0x006D, 0x03BC, 0x006D, 0x006D, 0x006D, 0x0063, 0x006D, 0x006B, 0x006D, 0x006D, 0x006D, 0x0032,
+        0x0063, 0x006D, 0x0032, 0x006D, 0x0032, 0x006B, 0x006D, 0x0032, 0x006D, 0x006D, 0x0033, 0x0063,
+        0x006D, 0x0033, 0x006D, 0x0033, 0x006B, 0x006D, 0x0033, 0x006D, 0x2215, 0x0073, 0x006D, 0x2215,
+        0x0073, 0x0032, 0x0050, 0x0061, 0x006B, 0x0050, 0x0061, 0x004D, 0x0050, 0x0061, 0x0047, 0x0050,
+        0x0061, 0x0072, 0x0061, 0x0064, 0x0072, 0x0061, 0x0064, 0x2215, 0x0073, 0x0072, 0x0061, 0x0064,
+        0x2215, 0x0073, 0x0032, 0x0070, 0x0073, 0x006E, 0x0073, 0x03BC, 0x0073, 0x006D, 0x0073, 0x0070,
+        0x0056, 0x006E, 0x0056, 0x03BC, 0x0056, 0x006D, 0x0056, 0x006B, 0x0056, 0x004D, 0x0056, 0x0070,
+        0x0057, 0x006E, 0x0057, 0x03BC, 0x0057, 0x006D, 0x0057, 0x006B, 0x0057, 0x004D, 0x0057, 0x006B,
+        0x03A9, 0x004D, 0x03A9, 0x0061, 0x002E, 0x006D, 0x002E, 0x0042, 0x0071, 0x0063, 0x0063, 0x0063,
+        0x0064, 0x0043, 0x2215, 0x006B, 0x0067, 0x0043, 0x006F, 0x002E, 0x0064, 0x0042, 0x0047, 0x0079,
+        0x0068, 0x0061, 0x0048, 0x0050, 0x0069, 0x006E, 0x004B, 0x004B, 0x004B, 0x004D, 0x006B, 0x0074,
+        0x006C, 0x006D, 0x006C, 0x006E, 0x006C, 0x006F, 0x0067, 0x006C, 0x0078, 0x006D, 0x0062, 0x006D,
+        0x0069, 0x006C, 0x006D, 0x006F, 0x006C, 0x0050, 0x0048, 0x0070, 0x002E, 0x006D, 0x002E, 0x0050,
+        0x0050, 0x004D, 0x0050, 0x0052, 0x0073, 0x0072, 0x0053, 0x0076, 0x0057, 0x0062, 0x0056, 0x2215,
+        0x006D, 0x0041, 0x2215, 0x006D, 0x0031, 0x65E5, 0x0032, 0x65E5, 0x0033, 0x65E5, 0x0034, 0x65E5,
+        0x0035, 0x65E5, 0x0036, 0x65E5, 0x0037, 0x65E5, 0x0038, 0x65E5, 0x0039, 0x65E5, 0x0031, 0x0030,
+        0x65E5, 0x0031, 0x0031, 0x65E5, 0x0031, 0x0032, 0x65E5, 0x0031, 0x0033, 0x65E5, 0x0031, 0x0034,
+        0x65E5, 0x0031, 0x0035, 0x65E5, 0x0031, 0x0036, 0x65E5, 0x0031, 0x0037, 0x65E5, 0x0031, 0x0038,
+        0x65E5, 0x0031, 0x0039, 0x65E5, 0x0032, 0x0030, 0x65E5, 0x0032, 0x0031, 0x65E5, 0x0032, 0x0032,
+        0x65E5, 0x0032, 0x0033, 0x65E5, 0x0032, 0x0034, 0x65E5, 0x0032, 0x0035, 0x65E5, 0x0032, 0x0036,
+        0x65E5, 0x0032, 0x0037, 0x65E5, 0x0032, 0x0038, 0x65E5, 0x0032, 0x0039, 0x65E5, 0x0033, 0x0030,
+        0x65E5, 0x0033, 0x0031, 0x65E5, 0x0067, 0x0061, 0x006C, 0x044A, 0x044C, 0xA76F, 0x0043, 0x0046,
+        0x0051, 0x0126, 0x0153, 0xA727, 0xAB37, 0x026B, 0xAB52, 0x028D, 0x8C48, 0x66F4, 0x8ECA, 0x8CC8,
+        0x6ED1, 0x4E32, 0x53E5, 0x9F9C, 0x9F9C, 0x5951, 0x91D1, 0x5587, 0x5948, 0x61F6, 0x7669, 0x7F85,
+        0x863F, 0x87BA, 0x88F8, 0x908F, 0x6A02, 0x6D1B, 0x70D9, 0x73DE, 0x843D, 0x916A, 0x99F1, 0x4E82,
+        0x5375, 0x6B04, 0x721B, 0x862D, 0x9E1E, 0x5D50, 0x6FEB, 0x85CD, 0x8964, 0x62C9, 0x81D8, 0x881F,
+        0x5ECA, 0x6717, 0x6D6A, 0x72FC, 0x90CE, 0x4F86, 0x51B7, 0x52DE, 0x64C4, 0x6AD3, 0x7210, 0x76E7,
+        0x8001, 0x8606, 0x865C, 0x8DEF, 0x9732, 0x9B6F, 0x9DFA, 0x788C, 0x797F, 0x7DA0, 0x83C9, 0x9304,
+        0x9E7F, 0x8AD6, 0x58DF, 0x5F04, 0x7C60, 0x807E, 0x7262, 0x78CA, 0x8CC2, 0x96F7, 0x58D8, 0x5C62,
+        0x6A13, 0x6DDA, 0x6F0F, 0x7D2F, 0x7E37, 0x964B, 0x52D2, 0x808B, 0x51DC, 0x51CC, 0x7A1C, 0x7DBE,
+        0x83F1, 0x9675, 0x8B80, 0x62CF, 0x6A02, 0x8AFE, 0x4E39, 0x5BE7, 0x6012, 0x7387, 0x7570, 0x5317,
+        0x78FB, 0x4FBF, 0x5FA9, 0x4E0D, 0x6CCC, 0x6578, 0x7D22, 0x53C3, 0x585E, 0x7701, 0x8449, 0x8AAA,
+        0x6BBA, 0x8FB0, 0x6C88, 0x62FE, 0x82E5, 0x63A0, 0x7565, 0x4EAE, 0x5169, 0x51C9, 0x6881, 0x7CE7,
+        0x826F, 0x8AD2, 0x91CF, 0x52F5, 0x5442, 0x5973, 0x5EEC, 0x65C5, 0x6FFE, 0x792A, 0x95AD, 0x9A6A,
+        0x9E97, 0x9ECE, 0x529B, 0x66C6, 0x6B77, 0x8F62, 0x5E74, 0x6190, 0x6200, 0x649A, 0x6F23, 0x7149,
+        0x7489, 0x79CA, 0x7DF4, 0x806F, 0x8F26, 0x84EE, 0x9023, 0x934A, 0x5217, 0x52A3, 0x54BD, 0x70C8,
+        0x88C2, 0x8AAA, 0x5EC9, 0x5FF5, 0x637B, 0x6BAE, 0x7C3E, 0x7375, 0x4EE4, 0x56F9, 0x5BE7, 0x5DBA,
+        0x601C, 0x73B2, 0x7469, 0x7F9A, 0x8046, 0x9234, 0x96F6, 0x9748, 0x9818, 0x4F8B, 0x79AE, 0x91B4,
+        0x96B8, 0x60E1, 0x4E86, 0x50DA, 0x5BEE, 0x5C3F, 0x6599, 0x6A02, 0x71CE, 0x7642, 0x84FC, 0x907C,
+        0x9F8D, 0x6688, 0x962E, 0x5289, 0x677B, 0x67F3, 0x6D41, 0x6E9C, 0x7409, 0x7559, 0x786B, 0x7D10,
+        0x985E, 0x516D, 0x622E, 0x9678, 0x502B, 0x5D19, 0x6DEA, 0x8F2A, 0x5F8B, 0x6144, 0x6817, 0x7387,
+        0x9686, 0x5229, 0x540F, 0x5C65, 0x6613, 0x674E, 0x68A8, 0x6CE5, 0x7406, 0x75E2, 0x7F79, 0x88CF,
+        0x88E1, 0x91CC, 0x96E2, 0x533F, 0x6EBA, 0x541D, 0x71D0, 0x7498, 0x85FA, 0x96A3, 0x9C57, 0x9E9F,
+        0x6797, 0x6DCB, 0x81E8, 0x7ACB, 0x7B20, 0x7C92, 0x72C0, 0x7099, 0x8B58, 0x4EC0, 0x8336, 0x523A,
+        0x5207, 0x5EA6, 0x62D3, 0x7CD6, 0x5B85, 0x6D1E, 0x66B4, 0x8F3B, 0x884C, 0x964D, 0x898B, 0x5ED3,
+        0x5140, 0x55C0, 0x585A, 0x6674, 0x51DE, 0x732A, 0x76CA, 0x793C, 0x795E, 0x7965, 0x798F, 0x9756,
+        0x7CBE, 0x7FBD, 0x8612, 0x8AF8, 0x9038, 0x90FD, 0x98EF, 0x98FC, 0x9928, 0x9DB4, 0x90DE, 0x96B7,
+        0x4FAE, 0x50E7, 0x514D, 0x52C9, 0x52E4, 0x5351, 0x559D, 0x5606, 0x5668, 0x5840, 0x58A8, 0x5C64,
+        0x5C6E, 0x6094, 0x6168, 0x618E, 0x61F2, 0x654F, 0x65E2, 0x6691, 0x6885, 0x6D77, 0x6E1A, 0x6F22,
+        0x716E, 0x722B, 0x7422, 0x7891, 0x793E, 0x7949, 0x7948, 0x7950, 0x7956, 0x795D, 0x798D, 0x798E,
+        0x7A40, 0x7A81, 0x7BC0, 0x7DF4, 0x7E09, 0x7E41, 0x7F72, 0x8005, 0x81ED, 0x8279, 0x8279, 0x8457,
+        0x8910, 0x8996, 0x8B01, 0x8B39, 0x8CD3, 0x8D08, 0x8FB6, 0x9038, 0x96E3, 0x97FF, 0x983B, 0x6075,
+        0x242EE, 0x8218, 0x4E26, 0x51B5, 0x5168, 0x4F80, 0x5145, 0x5180, 0x52C7, 0x52FA, 0x559D, 0x5555,
+        0x5599, 0x55E2, 0x585A, 0x58B3, 0x5944, 0x5954, 0x5A62, 0x5B28, 0x5ED2, 0x5ED9, 0x5F69, 0x5FAD,
+        0x60D8, 0x614E, 0x6108, 0x618E, 0x6160, 0x61F2, 0x6234, 0x63C4, 0x641C, 0x6452, 0x6556, 0x6674,
+        0x6717, 0x671B, 0x6756, 0x6B79, 0x6BBA, 0x6D41, 0x6EDB, 0x6ECB, 0x6F22, 0x701E, 0x716E, 0x77A7,
+        0x7235, 0x72AF, 0x732A, 0x7471, 0x7506, 0x753B, 0x761D, 0x761F, 0x76CA, 0x76DB, 0x76F4, 0x774A,
+        0x7740, 0x78CC, 0x7AB1, 0x7BC0, 0x7C7B, 0x7D5B, 0x7DF4, 0x7F3E, 0x8005, 0x8352, 0x83EF, 0x8779,
+        0x8941, 0x8986, 0x8996, 0x8ABF, 0x8AF8, 0x8ACB, 0x8B01, 0x8AFE, 0x8AED, 0x8B39, 0x8B8A, 0x8D08,
+        0x8F38, 0x9072, 0x9199, 0x9276, 0x967C, 0x96E3, 0x9756, 0x97DB, 0x97FF, 0x980B, 0x983B, 0x9B12,
+        0x9F9C, 0x2284A, 0x22844, 0x233D5, 0x3B9D, 0x4018, 0x4039, 0x25249, 0x25CD0, 0x27ED3, 0x9F43, 0x9F8E,
+        0x0066, 0x0066, 0x0066, 0x0069, 0x0066, 0x006C, 0x0066, 0x0066, 0x0069, 0x0066, 0x0066, 0x006C,
+        0x0073, 0x0074, 0x0073, 0x0074, 0x0574, 0x0576, 0x0574, 0x0565, 0x0574, 0x056B, 0x057E, 0x0576,
+        0x0574, 0x056D, 0x05D9, 0x05B4, 0x05F2, 0x05B7, 0x05E2, 0x05D0, 0x05D3, 0x05D4, 0x05DB, 0x05DC,
+        0x05DD, 0x05E8, 0x05EA, 0x002B, 0x05E9, 0x05C1, 0x05E9, 0x05C2, 0x05E9, 0x05BC, 0x05C1, 0x05E9,
+        0x05BC, 0x05C2, 0x05D0, 0x05B7, 0x05D0, 0x05B8, 0x05D0, 0x05BC, 0x05D1, 0x05BC, 0x05D2, 0x05BC,
+        0x05D3, 0x05BC, 0x05D4, 0x05BC, 0x05D5, 0x05BC, 0x05D6, 0x05BC, 0x05D8, 0x05BC, 0x05D9, 0x05BC,
+        0x05DA, 0x05BC, 0x05DB, 0x05BC, 0x05DC, 0x05BC, 0x05DE, 0x05BC, 0x05E0, 0x05BC, 0x05E1, 0x05BC,
+        0x05E3, 0x05BC, 0x05E4, 0x05BC, 0x05E6, 0x05BC, 0x05E7, 0x05BC, 0x05E8, 0x05BC, 0x05E9, 0x05BC,
+        0x05EA, 0x05BC, 0x05D5, 0x05B9, 0x05D1, 0x05BF, 0x05DB, 0x05BF, 0x05E4, 0x05BF, 0x05D0, 0x05DC,
+        0x0671, 0x0671, 0x067B, 0x067B, 0x067B, 0x067B, 0x067E, 0x067E, 0x067E, 0x067E, 0x0680, 0x0680,
+        0x0680, 0x0680, 0x067A, 0x067A, 0x067A, 0x067A, 0x067F, 0x067F, 0x067F, 0x067F, 0x0679, 0x0679,
+        0x0679, 0x0679, 0x06A4, 0x06A4, 0x06A4, 0x06A4, 0x06A6, 0x06A6, 0x06A6, 0x06A6, 0x0684, 0x0684,
+        0x0684, 0x0684, 0x0683, 0x0683, 0x0683, 0x0683, 0x0686, 0x0686, 0x0686, 0x0686, 0x0687, 0x0687,
+        0x0687, 0x0687, 0x068D, 0x068D, 0x068C, 0x068C, 0x068E, 0x068E, 0x0688, 0x0688, 0x0698, 0x0698,
+        0x0691, 0x0691, 0x06A9, 0x06A9, 0x06A9, 0x06A9, 0x06AF, 0x06AF, 0x06AF, 0x06AF, 0x06B3, 0x06B3,
+        0x06B3, 0x06B3, 0x06B1, 0x06B1, 0x06B1, 0x06B1, 0x06BA, 0x06BA, 0x06BB, 0x06BB, 0x06BB, 0x06BB,
+        0x06D5, 0x0654, 0x06D5, 0x0654, 0x06C1, 0x06C1, 0x06C1, 0x06C1, 0x06BE, 0x06BE, 0x06BE, 0x06BE,
+        0x06D2, 0x06D2, 0x06D2, 0x0654, 0x06D2, 0x0654, 0x06AD, 0x06AD, 0x06AD, 0x06AD, 0x06C7, 0x06C7,
+        0x06C6, 0x06C6, 0x06C8, 0x06C8, 0x06C7, 0x0674, 0x06CB, 0x06CB, 0x06C5, 0x06C5, 0x06C9, 0x06C9,
+        0x06D0, 0x06D0, 0x06D0, 0x06D0, 0x0649, 0x0649, 0x064A, 0x0654, 0x0627, 0x064A, 0x0654, 0x0627,
+        0x064A, 0x0654, 0x06D5, 0x064A, 0x0654, 0x06D5, 0x064A, 0x0654, 0x0648, 0x064A, 0x0654, 0x0648,
+        0x064A, 0x0654, 0x06C7, 0x064A, 0x0654, 0x06C7, 0x064A, 0x0654, 0x06C6, 0x064A, 0x0654, 0x06C6,
+        0x064A, 0x0654, 0x06C8, 0x064A, 0x0654, 0x06C8, 0x064A, 0x0654, 0x06D0, 0x064A, 0x0654, 0x06D0,
+        0x064A, 0x0654, 0x06D0, 0x064A, 0x0654, 0x0649, 0x064A, 0x0654, 0x0649, 0x064A, 0x0654, 0x0649,
+        0x06CC, 0x06CC, 0x06CC, 0x06CC, 0x064A, 0x0654, 0x062C, 0x064A, 0x0654, 0x062D, 0x064A, 0x0654,
+        0x0645, 0x064A, 0x0654, 0x0649, 0x064A, 0x0654, 0x064A, 0x0628, 0x062C, 0x0628, 0x062D, 0x0628,
+        0x062E, 0x0628, 0x0645, 0x0628, 0x0649, 0x0628, 0x064A, 0x062A, 0x062C, 0x062A, 0x062D, 0x062A,
+        0x062E, 0x062A, 0x0645, 0x062A, 0x0649, 0x062A, 0x064A, 0x062B, 0x062C, 0x062B, 0x0645, 0x062B,
+        0x0649, 0x062B, 0x064A, 0x062C, 0x062D, 0x062C, 0x0645, 0x062D, 0x062C, 0x062D, 0x0645, 0x062E,
+        0x062C, 0x062E, 0x062D, 0x062E, 0x0645, 0x0633, 0x062C, 0x0633, 0x062D, 0x0633, 0x062E, 0x0633,
+        0x0645, 0x0635, 0x062D, 0x0635, 0x0645, 0x0636, 0x062C, 0x0636, 0x062D, 0x0636, 0x062E, 0x0636,
+        0x0645, 0x0637, 0x062D, 0x0637, 0x0645, 0x0638, 0x0645, 0x0639, 0x062C, 0x0639, 0x0645, 0x063A,
+        0x062C, 0x063A, 0x0645, 0x0641, 0x062C, 0x0641, 0x062D, 0x0641, 0x062E, 0x0641, 0x0645, 0x0641,
+        0x0649, 0x0641, 0x064A, 0x0642, 0x062D, 0x0642, 0x0645, 0x0642, 0x0649, 0x0642, 0x064A, 0x0643,
+        0x0627, 0x0643, 0x062C, 0x0643, 0x062D, 0x0643, 0x062E, 0x0643, 0x0644, 0x0643, 0x0645, 0x0643,
+        0x0649, 0x0643, 0x064A, 0x0644, 0x062C, 0x0644, 0x062D, 0x0644, 0x062E, 0x0644, 0x0645, 0x0644,
+        0x0649, 0x0644, 0x064A, 0x0645, 0x062C, 0x0645, 0x062D, 0x0645, 0x062E, 0x0645, 0x0645, 0x0645,
+        0x0649, 0x0645, 0x064A, 0x0646, 0x062C, 0x0646, 0x062D, 0x0646, 0x062E, 0x0646, 0x0645, 0x0646,
+        0x0649, 0x0646, 0x064A, 0x0647, 0x062C, 0x0647, 0x0645, 0x0647, 0x0649, 0x0647, 0x064A, 0x064A,
+        0x062C, 0x064A, 0x062D, 0x064A, 0x062E, 0x064A, 0x0645, 0x064A, 0x0649, 0x064A, 0x064A, 0x0630,
+        0x0670, 0x0631, 0x0670, 0x0649, 0x0670, 0x0020, 0x064C, 0x0651, 0x0020, 0x064D, 0x0651, 0x0020,
+        0x064E, 0x0651, 0x0020, 0x064F, 0x0651, 0x0020, 0x0650, 0x0651, 0x0020, 0x0651, 0x0670, 0x064A,
+        0x0654, 0x0631, 0x064A, 0x0654, 0x0632, 0x064A, 0x0654, 0x0645, 0x064A, 0x0654, 0x0646, 0x064A,
+        0x0654, 0x0649, 0x064A, 0x0654, 0x064A, 0x0628, 0x0631, 0x0628, 0x0632, 0x0628, 0x0645, 0x0628,
+        0x0646, 0x0628, 0x0649, 0x0628, 0x064A, 0x062A, 0x0631, 0x062A, 0x0632, 0x062A, 0x0645, 0x062A,
+        0x0646, 0x062A, 0x0649, 0x062A, 0x064A, 0x062B, 0x0631, 0x062B, 0x0632, 0x062B, 0x0645, 0x062B,
+        0x0646, 0x062B, 0x0649, 0x062B, 0x064A, 0x0641, 0x0649, 0x0641, 0x064A, 0x0642, 0x0649, 0x0642,
+        0x064A, 0x0643, 0x0627, 0x0643, 0x0644, 0x0643, 0x0645, 0x0643, 0x0649, 0x0643, 0x064A, 0x0644,
+        0x0645, 0x0644, 0x0649, 0x0644, 0x064A, 0x0645, 0x0627, 0x0645, 0x0645, 0x0646, 0x0631, 0x0646,
+        0x0632, 0x0646, 0x0645, 0x0646, 0x0646, 0x0646, 0x0649, 0x0646, 0x064A, 0x0649, 0x0670, 0x064A,
+        0x0631, 0x064A, 0x0632, 0x064A, 0x0645, 0x064A, 0x0646, 0x064A, 0x0649, 0x064A, 0x064A, 0x064A,
+        0x0654, 0x062C, 0x064A, 0x0654, 0x062D, 0x064A, 0x0654, 0x062E, 0x064A, 0x0654, 0x0645, 0x064A,
+        0x0654, 0x0647, 0x0628, 0x062C, 0x0628, 0x062D, 0x0628, 0x062E, 0x0628, 0x0645, 0x0628, 0x0647,
+        0x062A, 0x062C, 0x062A, 0x062D, 0x062A, 0x062E, 0x062A, 0x0645, 0x062A, 0x0647, 0x062B, 0x0645,
+        0x062C, 0x062D, 0x062C, 0x0645, 0x062D, 0x062C, 0x062D, 0x0645, 0x062E, 0x062C, 0x062E, 0x0645,
+        0x0633, 0x062C, 0x0633, 0x062D, 0x0633, 0x062E, 0x0633, 0x0645, 0x0635, 0x062D, 0x0635, 0x062E,
+        0x0635, 0x0645, 0x0636, 0x062C, 0x0636, 0x062D, 0x0636, 0x062E, 0x0636, 0x0645, 0x0637, 0x062D,
+        0x0638, 0x0645, 0x0639, 0x062C, 0x0639, 0x0645, 0x063A, 0x062C, 0x063A, 0x0645, 0x0641, 0x062C,
+        0x0641, 0x062D, 0x0641, 0x062E, 0x0641, 0x0645, 0x0642, 0x062D, 0x0642, 0x0645, 0x0643, 0x062C,
+        0x0643, 0x062D, 0x0643, 0x062E, 0x0643, 0x0644, 0x0643, 0x0645, 0x0644, 0x062C, 0x0644, 0x062D,
+        0x0644, 0x062E, 0x0644, 0x0645, 0x0644, 0x0647, 0x0645, 0x062C, 0x0645, 0x062D, 0x0645, 0x062E,
+        0x0645, 0x0645, 0x0646, 0x062C, 0x0646, 0x062D, 0x0646, 0x062E, 0x0646, 0x0645, 0x0646, 0x0647,
+        0x0647, 0x062C, 0x0647, 0x0645, 0x0647, 0x0670, 0x064A, 0x062C, 0x064A, 0x062D, 0x064A, 0x062E,
+        0x064A, 0x0645, 0x064A, 0x0647, 0x064A, 0x0654, 0x0645, 0x064A, 0x0654, 0x0647, 0x0628, 0x0645,
+        0x0628, 0x0647, 0x062A, 0x0645, 0x062A, 0x0647, 0x062B, 0x0645, 0x062B, 0x0647, 0x0633, 0x0645,
+        0x0633, 0x0647, 0x0634, 0x0645, 0x0634, 0x0647, 0x0643, 0x0644, 0x0643, 0x0645, 0x0644, 0x0645,
+        0x0646, 0x0645, 0x0646, 0x0647, 0x064A, 0x0645, 0x064A, 0x0647, 0x0640, 0x064E, 0x0651, 0x0640,
+        0x064F, 0x0651, 0x0640, 0x0650, 0x0651, 0x0637, 0x0649, 0x0637, 0x064A, 0x0639, 0x0649, 0x0639,
+        0x064A, 0x063A, 0x0649, 0x063A, 0x064A, 0x0633, 0x0649, 0x0633, 0x064A, 0x0634, 0x0649, 0x0634,
+        0x064A, 0x062D, 0x0649, 0x062D, 0x064A, 0x062C, 0x0649, 0x062C, 0x064A, 0x062E, 0x0649, 0x062E,
+        0x064A, 0x0635, 0x0649, 0x0635, 0x064A, 0x0636, 0x0649, 0x0636, 0x064A, 0x0634, 0x062C, 0x0634,
+        0x062D, 0x0634, 0x062E, 0x0634, 0x0645, 0x0634, 0x0631, 0x0633, 0x0631, 0x0635, 0x0631, 0x0636,
+        0x0631, 0x0637, 0x0649, 0x0637, 0x064A, 0x0639, 0x0649, 0x0639, 0x064A, 0x063A, 0x0649, 0x063A,
+        0x064A, 0x0633, 0x0649, 0x0633, 0x064A, 0x0634, 0x0649, 0x0634, 0x064A, 0x062D, 0x0649, 0x062D,
+        0x064A, 0x062C, 0x0649, 0x062C, 0x064A, 0x062E, 0x0649, 0x062E, 0x064A, 0x0635, 0x0649, 0x0635,
+        0x064A, 0x0636, 0x0649, 0x0636, 0x064A, 0x0634, 0x062C, 0x0634, 0x062D, 0x0634, 0x062E, 0x0634,
+        0x0645, 0x0634, 0x0631, 0x0633, 0x0631, 0x0635, 0x0631, 0x0636, 0x0631, 0x0634, 0x062C, 0x0634,
+        0x062D, 0x0634, 0x062E, 0x0634, 0x0645, 0x0633, 0x0647, 0x0634, 0x0647, 0x0637, 0x0645, 0x0633,
+        0x062C, 0x0633, 0x062D, 0x0633, 0x062E, 0x0634, 0x062C, 0x0634, 0x062D, 0x0634, 0x062E, 0x0637,
+        0x0645, 0x0638, 0x0645, 0x0627, 0x064B, 0x0627, 0x064B, 0x062A, 0x062C, 0x0645, 0x062A, 0x062D,
+        0x062C, 0x062A, 0x062D, 0x062C, 0x062A, 0x062D, 0x0645, 0x062A, 0x062E, 0x0645, 0x062A, 0x0645,
+        0x062C, 0x062A, 0x0645, 0x062D, 0x062A, 0x0645, 0x062E, 0x062C, 0x0645, 0x062D, 0x062C, 0x0645,
+        0x062D, 0x062D, 0x0645, 0x064A, 0x062D, 0x0645, 0x0649, 0x0633, 0x062D, 0x062C, 0x0633, 0x062C,
+        0x062D, 0x0633, 0x062C, 0x0649, 0x0633, 0x0645, 0x062D, 0x0633, 0x0645, 0x062D, 0x0633, 0x0645,
+        0x062C, 0x0633, 0x0645, 0x0645, 0x0633, 0x0645, 0x0645, 0x0635, 0x062D, 0x062D, 0x0635, 0x062D,
+        0x062D, 0x0635, 0x0645, 0x0645, 0x0634, 0x062D, 0x0645, 0x0634, 0x062D, 0x0645, 0x0634, 0x062C,
+        0x064A, 0x0634, 0x0645, 0x062E, 0x0634, 0x0645, 0x062E, 0x0634, 0x0645, 0x0645, 0x0634, 0x0645,
+        0x0645, 0x0636, 0x062D, 0x0649, 0x0636, 0x062E, 0x0645, 0x0636, 0x062E, 0x0645, 0x0637, 0x0645,
+        0x062D, 0x0637, 0x0645, 0x062D, 0x0637, 0x0645, 0x0645, 0x0637, 0x0645, 0x064A, 0x0639, 0x062C,
+        0x0645, 0x0639, 0x0645, 0x0645, 0x0639, 0x0645, 0x0645, 0x0639, 0x0645, 0x0649, 0x063A, 0x0645,
+        0x0645, 0x063A, 0x0645, 0x064A, 0x063A, 0x0645, 0x0649, 0x0641, 0x062E, 0x0645, 0x0641, 0x062E,
+        0x0645, 0x0642, 0x0645, 0x062D, 0x0642, 0x0645, 0x0645, 0x0644, 0x062D, 0x0645, 0x0644, 0x062D,
+        0x064A, 0x0644, 0x062D, 0x0649, 0x0644, 0x062C, 0x062C, 0x0644, 0x062C, 0x062C, 0x0644, 0x062E,
+        0x0645, 0x0644, 0x062E, 0x0645, 0x0644, 0x0645, 0x062D, 0x0644, 0x0645, 0x062D, 0x0645, 0x062D,
+        0x062C, 0x0645, 0x062D, 0x0645, 0x0645, 0x062D, 0x064A, 0x0645, 0x062C, 0x062D, 0x0645, 0x062C,
+        0x0645, 0x0645, 0x062E, 0x062C, 0x0645, 0x062E, 0x0645, 0x0645, 0x062C, 0x062E, 0x0647, 0x0645,
+        0x062C, 0x0647, 0x0645, 0x0645, 0x0646, 0x062D, 0x0645, 0x0646, 0x062D, 0x0649, 0x0646, 0x062C,
+        0x0645, 0x0646, 0x062C, 0x0645, 0x0646, 0x062C, 0x0649, 0x0646, 0x0645, 0x064A, 0x0646, 0x0645,
+        0x0649, 0x064A, 0x0645, 0x0645, 0x064A, 0x0645, 0x0645, 0x0628, 0x062E, 0x064A, 0x062A, 0x062C,
+        0x064A, 0x062A, 0x062C, 0x0649, 0x062A, 0x062E, 0x064A, 0x062A, 0x062E, 0x0649, 0x062A, 0x0645,
+        0x064A, 0x062A, 0x0645, 0x0649, 0x062C, 0x0645, 0x064A, 0x062C, 0x062D, 0x0649, 0x062C, 0x0645,
+        0x0649, 0x0633, 0x062E, 0x0649, 0x0635, 0x062D, 0x064A, 0x0634, 0x062D, 0x064A, 0x0636, 0x062D,
+        0x064A, 0x0644, 0x062C, 0x064A, 0x0644, 0x0645, 0x064A, 0x064A, 0x062D, 0x064A, 0x064A, 0x062C,
+        0x064A, 0x064A, 0x0645, 0x064A, 0x0645, 0x0645, 0x064A, 0x0642, 0x0645, 0x064A, 0x0646, 0x062D,
+        0x064A, 0x0642, 0x0645, 0x062D, 0x0644, 0x062D, 0x0645, 0x0639, 0x0645, 0x064A, 0x0643, 0x0645,
+        0x064A, 0x0646, 0x062C, 0x062D, 0x0645, 0x062E, 0x064A, 0x0644, 0x062C, 0x0645, 0x0643, 0x0645,
+        0x0645, 0x0644, 0x062C, 0x0645, 0x0646, 0x062C, 0x062D, 0x062C, 0x062D, 0x064A, 0x062D, 0x062C,
+        0x064A, 0x0645, 0x062C, 0x064A, 0x0641, 0x0645, 0x064A, 0x0628, 0x062D, 0x064A, 0x0643, 0x0645,
+        0x0645, 0x0639, 0x062C, 0x0645, 0x0635, 0x0645, 0x0645, 0x0633, 0x062E, 0x064A, 0x0646, 0x062C,
+        0x064A, 0x0635, 0x0644, 0x06D2, 0x0642, 0x0644, 0x06D2, 0x0627, 0x0644, 0x0644, 0x0647, 0x0627,
+        0x0643, 0x0628, 0x0631, 0x0645, 0x062D, 0x0645, 0x062F, 0x0635, 0x0644, 0x0639, 0x0645, 0x0631,
+        0x0633, 0x0648, 0x0644, 0x0639, 0x0644, 0x064A, 0x0647, 0x0648, 0x0633, 0x0644, 0x0645, 0x0635,
+        0x0644, 0x0649, 0x0635, 0x0644, 0x0649, 0x0020, 0x0627, 0x0644, 0x0644, 0x0647, 0x0020, 0x0639,
+        0x0644, 0x064A, 0x0647, 0x0020, 0x0648, 0x0633, 0x0644, 0x0645, 0x062C, 0x0644, 0x0020, 0x062C,
+        0x0644, 0x0627, 0x0644, 0x0647, 0x0631, 0x06CC, 0x0627, 0x0644, 0x002C, 0x3001, 0x3002, 0x003A,
+        0x003B, 0x0021, 0x003F, 0x3016, 0x3017, 0x002E, 0x002E, 0x002E, 0x002E, 0x002E, 0x2014, 0x2013,
+        0x005F, 0x005F, 0x0028, 0x0029, 0x007B, 0x007D, 0x3014, 0x3015, 0x3010, 0x3011, 0x300A, 0x300B,
+        0x3008, 0x3009, 0x300C, 0x300D, 0x300E, 0x300F, 0x005B, 0x005D, 0x0020, 0x0305, 0x0020, 0x0305,
+        0x0020, 0x0305, 0x0020, 0x0305, 0x005F, 0x005F, 0x005F, 0x002C, 0x3001, 0x002E, 0x003B, 0x003A,
+        0x003F, 0x0021, 0x2014, 0x0028, 0x0029, 0x007B, 0x007D, 0x3014, 0x3015, 0x0023, 0x0026, 0x002A,
+        0x002B, 0x002D, 0x003C, 0x003E, 0x003D, 0x005C, 0x0024, 0x0025, 0x0040, 0x0020, 0x064B, 0x0640,
+        0x064B, 0x0020, 0x064C, 0x0020, 0x064D, 0x0020, 0x064E, 0x0640, 0x064E, 0x0020, 0x064F, 0x0640,
+        0x064F, 0x0020, 0x0650, 0x0640, 0x0650, 0x0020, 0x0651, 0x0640, 0x0651, 0x0020, 0x0652, 0x0640,
+        0x0652, 0x0621, 0x0627, 0x0653, 0x0627, 0x0653, 0x0627, 0x0654, 0x0627, 0x0654, 0x0648, 0x0654,
+        0x0648, 0x0654, 0x0627, 0x0655, 0x0627, 0x0655, 0x064A, 0x0654, 0x064A, 0x0654, 0x064A, 0x0654,
+        0x064A, 0x0654, 0x0627, 0x0627, 0x0628, 0x0628, 0x0628, 0x0628, 0x0629, 0x0629, 0x062A, 0x062A,
+        0x062A, 0x062A, 0x062B, 0x062B, 0x062B, 0x062B, 0x062C, 0x062C, 0x062C, 0x062C, 0x062D, 0x062D,
+        0x062D, 0x062D, 0x062E, 0x062E, 0x062E, 0x062E, 0x062F, 0x062F, 0x0630, 0x0630, 0x0631, 0x0631,
+        0x0632, 0x0632, 0x0633, 0x0633, 0x0633, 0x0633, 0x0634, 0x0634, 0x0634, 0x0634, 0x0635, 0x0635,
+        0x0635, 0x0635, 0x0636, 0x0636, 0x0636, 0x0636, 0x0637, 0x0637, 0x0637, 0x0637, 0x0638, 0x0638,
+        0x0638, 0x0638, 0x0639, 0x0639, 0x0639, 0x0639, 0x063A, 0x063A, 0x063A, 0x063A, 0x0641, 0x0641,
+        0x0641, 0x0641, 0x0642, 0x0642, 0x0642, 0x0642, 0x0643, 0x0643, 0x0643, 0x0643, 0x0644, 0x0644,
+        0x0644, 0x0644, 0x0645, 0x0645, 0x0645, 0x0645, 0x0646, 0x0646, 0x0646, 0x0646, 0x0647, 0x0647,
+        0x0647, 0x0647, 0x0648, 0x0648, 0x0649, 0x0649, 0x064A, 0x064A, 0x064A, 0x064A, 0x0644, 0x0627,
+        0x0653, 0x0644, 0x0627, 0x0653, 0x0644, 0x0627, 0x0654, 0x0644, 0x0627, 0x0654, 0x0644, 0x0627,
+        0x0655, 0x0644, 0x0627, 0x0655, 0x0644, 0x0627, 0x0644, 0x0627, 0x0021, 0x0022, 0x0023, 0x0024,
+        0x0025, 0x0026, 0x0027, 0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F, 0x0030,
+        0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037, 0x0038, 0x0039, 0x003A, 0x003B, 0x003C,
+        0x003D, 0x003E, 0x003F, 0x0040, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047, 0x0048,
+        0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050, 0x0051, 0x0052, 0x0053, 0x0054,
+        0x0055, 0x0056, 0x0057, 0x0058, 0x0059, 0x005A, 0x005B, 0x005C, 0x005D, 0x005E, 0x005F, 0x0060,
+        0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067, 0x0068, 0x0069, 0x006A, 0x006B, 0x006C,
+        0x006D, 0x006E, 0x006F, 0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078,
+        0x0079, 0x007A, 0x007B, 0x007C, 0x007D, 0x007E, 0x2985, 0x2986, 0x3002, 0x300C, 0x300D, 0x3001,
+        0x30FB, 0x30F2, 0x30A1, 0x30A3, 0x30A5, 0x30A7, 0x30A9, 0x30E3, 0x30E5, 0x30E7, 0x30C3, 0x30FC,
+        0x30A2, 0x30A4, 0x30A6, 0x30A8, 0x30AA, 0x30AB, 0x30AD, 0x30AF, 0x30B1, 0x30B3, 0x30B5, 0x30B7,
+        0x30B9, 0x30BB, 0x30BD, 0x30BF, 0x30C1, 0x30C4, 0x30C6, 0x30C8, 0x30CA, 0x30CB, 0x30CC, 0x30CD,
+        0x30CE, 0x30CF, 0x30D2, 0x30D5, 0x30D8, 0x30DB, 0x30DE, 0x30DF, 0x30E0, 0x30E1, 0x30E2, 0x30E4,
+        0x30E6, 0x30E8, 0x30E9, 0x30EA, 0x30EB, 0x30EC, 0x30ED, 0x30EF, 0x30F3, 0x3099, 0x309A, 0x1160,
+        0x1100, 0x1101, 0x11AA, 0x1102, 0x11AC, 0x11AD, 0x1103, 0x1104, 0x1105, 0x11B0, 0x11B1, 0x11B2,
+        0x11B3, 0x11B4, 0x11B5, 0x111A, 0x1106, 0x1107, 0x1108, 0x1121, 0x1109, 0x110A, 0x110B, 0x110C,
+        0x110D, 0x110E, 0x110F, 0x1110, 0x1111, 0x1112, 0x1161, 0x1162, 0x1163, 0x1164, 0x1165, 0x1166,
+        0x1167, 0x1168, 0x1169, 0x116A, 0x116B, 0x116C, 0x116D, 0x116E, 0x116F, 0x1170, 0x1171, 0x1172,
+        0x1173, 0x1174, 0x1175, 0x00A2, 0x00A3, 0x00AC, 0x0020, 0x0304, 0x00A6, 0x00A5, 0x20A9, 0x2502,
+        0x2190, 0x2191, 0x2192, 0x2193, 0x25A0, 0x25CB, 0x02D0, 0x02D1, 0x00E6, 0x0299, 0x0253, 0x02A3,
+        0xAB66, 0x02A5, 0x02A4, 0x0256, 0x0257, 0x1D91, 0x0258, 0x025E, 0x02A9, 0x0264, 0x0262, 0x0260,
+        0x029B, 0x0127, 0x029C, 0x0267, 0x0284, 0x02AA, 0x02AB, 0x026C, 0x1DF04, 0xA78E, 0x026E, 0x1DF05,
+        0x028E, 0x1DF06, 0x00F8, 0x0276, 0x0277, 0x0071, 0x027A, 0x1DF08, 0x027D, 0x027E, 0x0280, 0x02A8,
+        0x02A6, 0xAB67, 0x02A7, 0x0288, 0x2C71, 0x028F, 0x02A1, 0x02A2, 0x0298, 0x01C0, 0x01C1, 0x01C2,
+        0x1DF0A, 0x1DF1E, 0x11099, 0x110BA, 0x1109B, 0x110BA, 0x110A5, 0x110BA, 0x11131, 0x11127, 0x11132, 0x11127,
+        0x11347, 0x1133E, 0x11347, 0x11357, 0x114B9, 0x114BA, 0x114B9, 0x114B0, 0x114B9, 0x114BD, 0x115B8, 0x115AF,
+        0x115B9, 0x115AF, 0x11935, 0x11930, 0x1D157, 0x1D165, 0x1D158, 0x1D165, 0x1D158, 0x1D165, 0x1D16E, 0x1D158,
+        0x1D165, 0x1D16F, 0x1D158, 0x1D165, 0x1D170, 0x1D158, 0x1D165, 0x1D171, 0x1D158, 0x1D165, 0x1D172, 0x1D1B9,
+        0x1D165, 0x1D1BA, 0x1D165, 0x1D1B9, 0x1D165, 0x1D16E, 0x1D1BA, 0x1D165, 0x1D16E, 0x1D1B9, 0x1D165, 0x1D16F,
+        0x1D1BA, 0x1D165, 0x1D16F, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047, 0x0048, 0x0049,
+        0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055,
+        0x0056, 0x0057, 0x0058, 0x0059, 0x005A, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+        0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F, 0x0070, 0x0071, 0x0072, 0x0073,
+        0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045,
+        0x0046, 0x0047, 0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050, 0x0051,
+        0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059, 0x005A, 0x0061, 0x0062, 0x0063,
+        0x0064, 0x0065, 0x0066, 0x0067, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F, 0x0070,
+        0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x0041, 0x0042,
+        0x0043, 0x0044, 0x0045, 0x0046, 0x0047, 0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E,
+        0x004F, 0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059, 0x005A,
+        0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067, 0x0068, 0x0069, 0x006A, 0x006B, 0x006C,
+        0x006D, 0x006E, 0x006F, 0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078,
+        0x0079, 0x007A, 0x0041, 0x0043, 0x0044, 0x0047, 0x004A, 0x004B, 0x004E, 0x004F, 0x0050, 0x0051,
+        0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059, 0x005A, 0x0061, 0x0062, 0x0063, 0x0064,
+        0x0066, 0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x0070, 0x0071, 0x0072, 0x0073,
+        0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045,
+        0x0046, 0x0047, 0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050, 0x0051,
+        0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059, 0x005A, 0x0061, 0x0062, 0x0063,
+        0x0064, 0x0065, 0x0066, 0x0067, 0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+        0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x0041,
+        0x0042, 0x0044, 0x0045, 0x0046, 0x0047, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050,
+        0x0051, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059, 0x0061, 0x0062, 0x0063, 0x0064,
+        0x0065, 0x0066, 0x0067, 0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F, 0x0070,
+        0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x0041, 0x0042,
+        0x0044, 0x0045, 0x0046, 0x0047, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004F, 0x0053, 0x0054,
+        0x0055, 0x0056, 0x0057, 0x0058, 0x0059, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+        0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F, 0x0070, 0x0071, 0x0072, 0x0073,
+        0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045,
+        0x0046, 0x0047, 0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050, 0x0051,
+        0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059, 0x005A, 0x0061, 0x0062, 0x0063,
+        0x0064, 0x0065, 0x0066, 0x0067, 0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+        0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x0041,
+        0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047, 0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D,
+        0x004E, 0x004F, 0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059,
+        0x005A, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067, 0x0068, 0x0069, 0x006A, 0x006B,
+        0x006C, 0x006D, 0x006E, 0x006F, 0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+        0x0078, 0x0079, 0x007A, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047, 0x0048, 0x0049,
+        0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055,
+        0x0056, 0x0057, 0x0058, 0x0059, 0x005A, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+        0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F, 0x0070, 0x0071, 0x0072, 0x0073,
+        0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045,
+        0x0046, 0x0047, 0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050, 0x0051,
+        0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059, 0x005A, 0x0061, 0x0062, 0x0063,
+        0x0064, 0x0065, 0x0066, 0x0067, 0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+        0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x0041,
+        0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047, 0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D,
+        0x004E, 0x004F, 0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059,
+        0x005A, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067, 0x0068, 0x0069, 0x006A, 0x006B,
+        0x006C, 0x006D, 0x006E, 0x006F, 0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+        0x0078, 0x0079, 0x007A, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047, 0x0048, 0x0049,
+        0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055,
+        0x0056, 0x0057, 0x0058, 0x0059, 0x005A, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+        0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F, 0x0070, 0x0071, 0x0072, 0x0073,
+        0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x0131, 0x0237, 0x0391, 0x0392, 0x0393,
+        0x0394, 0x0395, 0x0396, 0x0397, 0x0398, 0x0399, 0x039A, 0x039B, 0x039C, 0x039D, 0x039E, 0x039F,
+        0x03A0, 0x03A1, 0x0398, 0x03A3, 0x03A4, 0x03A5, 0x03A6, 0x03A7, 0x03A8, 0x03A9, 0x2207, 0x03B1,
+        0x03B2, 0x03B3, 0x03B4, 0x03B5, 0x03B6, 0x03B7, 0x03B8, 0x03B9, 0x03BA, 0x03BB, 0x03BC, 0x03BD,
+        0x03BE, 0x03BF, 0x03C0, 0x03C1, 0x03C2, 0x03C3, 0x03C4, 0x03C5, 0x03C6, 0x03C7, 0x03C8, 0x03C9,
+        0x2202, 0x03B5, 0x03B8, 0x03BA, 0x03C6, 0x03C1, 0x03C0, 0x0391, 0x0392, 0x0393, 0x0394, 0x0395,
+        0x0396, 0x0397, 0x0398, 0x0399, 0x039A, 0x039B, 0x039C, 0x039D, 0x039E, 0x039F, 0x03A0, 0x03A1,
+        0x0398, 0x03A3, 0x03A4, 0x03A5, 0x03A6, 0x03A7, 0x03A8, 0x03A9, 0x2207, 0x03B1, 0x03B2, 0x03B3,
+        0x03B4, 0x03B5, 0x03B6, 0x03B7, 0x03B8, 0x03B9, 0x03BA, 0x03BB, 0x03BC, 0x03BD, 0x03BE, 0x03BF,
+        0x03C0, 0x03C1, 0x03C2, 0x03C3, 0x03C4, 0x03C5, 0x03C6, 0x03C7, 0x03C8, 0x03C9, 0x2202, 0x03B5,
+        0x03B8, 0x03BA, 0x03C6, 0x03C1, 0x03C0, 0x0391, 0x0392, 0x0393, 0x0394, 0x0395, 0x0396, 0x0397,
+        0x0398, 0x0399, 0x039A, 0x039B, 0x039C, 0x039D, 0x039E, 0x039F, 0x03A0, 0x03A1, 0x0398, 0x03A3,
+        0x03A4, 0x03A5, 0x03A6, 0x03A7, 0x03A8, 0x03A9, 0x2207, 0x03B1, 0x03B2, 0x03B3, 0x03B4, 0x03B5,
+        0x03B6, 0x03B7, 0x03B8, 0x03B9, 0x03BA, 0x03BB, 0x03BC, 0x03BD, 0x03BE, 0x03BF, 0x03C0, 0x03C1,
+        0x03C2, 0x03C3, 0x03C4, 0x03C5, 0x03C6, 0x03C7, 0x03C8, 0x03C9, 0x2202, 0x03B5, 0x03B8, 0x03BA,
+        0x03C6, 0x03C1, 0x03C0, 0x0391, 0x0392, 0x0393, 0x0394, 0x0395, 0x0396, 0x0397, 0x0398, 0x0399,
+        0x039A, 0x039B, 0x039C, 0x039D, 0x039E, 0x039F, 0x03A0, 0x03A1, 0x0398, 0x03A3, 0x03A4, 0x03A5,
+        0x03A6, 0x03A7, 0x03A8, 0x03A9, 0x2207, 0x03B1, 0x03B2, 0x03B3, 0x03B4, 0x03B5, 0x03B6, 0x03B7,
+        0x03B8, 0x03B9, 0x03BA, 0x03BB, 0x03BC, 0x03BD, 0x03BE, 0x03BF, 0x03C0, 0x03C1, 0x03C2, 0x03C3,
+        0x03C4, 0x03C5, 0x03C6, 0x03C7, 0x03C8, 0x03C9, 0x2202, 0x03B5, 0x03B8, 0x03BA, 0x03C6, 0x03C1,
+        0x03C0, 0x0391, 0x0392, 0x0393, 0x0394, 0x0395, 0x0396, 0x0397, 0x0398, 0x0399, 0x039A, 0x039B,
+        0x039C, 0x039D, 0x039E, 0x039F, 0x03A0, 0x03A1, 0x0398, 0x03A3, 0x03A4, 0x03A5, 0x03A6, 0x03A7,
+        0x03A8, 0x03A9, 0x2207, 0x03B1, 0x03B2, 0x03B3, 0x03B4, 0x03B5, 0x03B6, 0x03B7, 0x03B8, 0x03B9,
+        0x03BA, 0x03BB, 0x03BC, 0x03BD, 0x03BE, 0x03BF, 0x03C0, 0x03C1, 0x03C2, 0x03C3, 0x03C4, 0x03C5,
+        0x03C6, 0x03C7, 0x03C8, 0x03C9, 0x2202, 0x03B5, 0x03B8, 0x03BA, 0x03C6, 0x03C1, 0x03C0, 0x03DC,
+        0x03DD, 0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037, 0x0038, 0x0039, 0x0030,
+        0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037, 0x0038, 0x0039, 0x0030, 0x0031, 0x0032,
+        0x0033, 0x0034, 0x0035, 0x0036, 0x0037, 0x0038, 0x0039, 0x0030, 0x0031, 0x0032, 0x0033, 0x0034,
+        0x0035, 0x0036, 0x0037, 0x0038, 0x0039, 0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036,
+        0x0037, 0x0038, 0x0039, 0x0627, 0x0628, 0x062C, 0x062F, 0x0648, 0x0632, 0x062D, 0x0637, 0x064A,
+        0x0643, 0x0644, 0x0645, 0x0646, 0x0633, 0x0639, 0x0641, 0x0635, 0x0642, 0x0631, 0x0634, 0x062A,
+        0x062B, 0x062E, 0x0630, 0x0636, 0x0638, 0x063A, 0x066E, 0x06BA, 0x06A1, 0x066F, 0x0628, 0x062C,
+        0x0647, 0x062D, 0x064A, 0x0643, 0x0644, 0x0645, 0x0646, 0x0633, 0x0639, 0x0641, 0x0635, 0x0642,
+        0x0634, 0x062A, 0x062B, 0x062E, 0x0636, 0x063A, 0x062C, 0x062D, 0x064A, 0x0644, 0x0646, 0x0633,
+        0x0639, 0x0635, 0x0642, 0x0634, 0x062E, 0x0636, 0x063A, 0x06BA, 0x066F, 0x0628, 0x062C, 0x0647,
+        0x062D, 0x0637, 0x064A, 0x0643, 0x0645, 0x0646, 0x0633, 0x0639, 0x0641, 0x0635, 0x0642, 0x0634,
+        0x062A, 0x062B, 0x062E, 0x0636, 0x0638, 0x063A, 0x066E, 0x06A1, 0x0627, 0x0628, 0x062C, 0x062F,
+        0x0647, 0x0648, 0x0632, 0x062D, 0x0637, 0x064A, 0x0644, 0x0645, 0x0646, 0x0633, 0x0639, 0x0641,
+        0x0635, 0x0642, 0x0631, 0x0634, 0x062A, 0x062B, 0x062E, 0x0630, 0x0636, 0x0638, 0x063A, 0x0628,
+        0x062C, 0x062F, 0x0648, 0x0632, 0x062D, 0x0637, 0x064A, 0x0644, 0x0645, 0x0646, 0x0633, 0x0639,
+        0x0641, 0x0635, 0x0642, 0x0631, 0x0634, 0x062A, 0x062B, 0x062E, 0x0630, 0x0636, 0x0638, 0x063A,
+        0x0030, 0x002E, 0x0030, 0x002C, 0x0031, 0x002C, 0x0032, 0x002C, 0x0033, 0x002C, 0x0034, 0x002C,
+        0x0035, 0x002C, 0x0036, 0x002C, 0x0037, 0x002C, 0x0038, 0x002C, 0x0039, 0x002C, 0x0028, 0x0041,
+        0x0029, 0x0028, 0x0042, 0x0029, 0x0028, 0x0043, 0x0029, 0x0028, 0x0044, 0x0029, 0x0028, 0x0045,
+        0x0029, 0x0028, 0x0046, 0x0029, 0x0028, 0x0047, 0x0029, 0x0028, 0x0048, 0x0029, 0x0028, 0x0049,
+        0x0029, 0x0028, 0x004A, 0x0029, 0x0028, 0x004B, 0x0029, 0x0028, 0x004C, 0x0029, 0x0028, 0x004D,
+        0x0029, 0x0028, 0x004E, 0x0029, 0x0028, 0x004F, 0x0029, 0x0028, 0x0050, 0x0029, 0x0028, 0x0051,
+        0x0029, 0x0028, 0x0052, 0x0029, 0x0028, 0x0053, 0x0029, 0x0028, 0x0054, 0x0029, 0x0028, 0x0055,
+        0x0029, 0x0028, 0x0056, 0x0029, 0x0028, 0x0057, 0x0029, 0x0028, 0x0058, 0x0029, 0x0028, 0x0059,
+        0x0029, 0x0028, 0x005A, 0x0029, 0x3014, 0x0053, 0x3015, 0x0043, 0x0052, 0x0043, 0x0044, 0x0057,
+        0x005A, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047, 0x0048, 0x0049, 0x004A, 0x004B,
+        0x004C, 0x004D, 0x004E, 0x004F, 0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+        0x0058, 0x0059, 0x005A, 0x0048, 0x0056, 0x004D, 0x0056, 0x0053, 0x0044, 0x0053, 0x0053, 0x0050,
+        0x0050, 0x0056, 0x0057, 0x0043, 0x004D, 0x0043, 0x004D, 0x0044, 0x004D, 0x0052, 0x0044, 0x004A,
+        0x307B, 0x304B, 0x30B3, 0x30B3, 0x30B5, 0x624B, 0x5B57, 0x53CC, 0x30C6, 0x3099, 0x4E8C, 0x591A,
+        0x89E3, 0x5929, 0x4EA4, 0x6620, 0x7121, 0x6599, 0x524D, 0x5F8C, 0x518D, 0x65B0, 0x521D, 0x7D42,
+        0x751F, 0x8CA9, 0x58F0, 0x5439, 0x6F14, 0x6295, 0x6355, 0x4E00, 0x4E09, 0x904A, 0x5DE6, 0x4E2D,
+        0x53F3, 0x6307, 0x8D70, 0x6253, 0x7981, 0x7A7A, 0x5408, 0x6E80, 0x6709, 0x6708, 0x7533, 0x5272,
+        0x55B6, 0x914D, 0x3014, 0x672C, 0x3015, 0x3014, 0x4E09, 0x3015, 0x3014, 0x4E8C, 0x3015, 0x3014,
+        0x5B89, 0x3015, 0x3014, 0x70B9, 0x3015, 0x3014, 0x6253, 0x3015, 0x3014, 0x76D7, 0x3015, 0x3014,
+        0x52DD, 0x3015, 0x3014, 0x6557, 0x3015, 0x5F97, 0x53EF, 0x0030, 0x0031, 0x0032, 0x0033, 0x0034,
+        0x0035, 0x0036, 0x0037, 0x0038, 0x0039, 0x4E3D, 0x4E38, 0x4E41, 0x20122, 0x4F60, 0x4FAE, 0x4FBB,
+        0x5002, 0x507A, 0x5099, 0x50E7, 0x50CF, 0x349E, 0x2063A, 0x514D, 0x5154, 0x5164, 0x5177, 0x2051C,
+        0x34B9, 0x5167, 0x518D, 0x2054B, 0x5197, 0x51A4, 0x4ECC, 0x51AC, 0x51B5, 0x291DF, 0x51F5, 0x5203,
+        0x34DF, 0x523B, 0x5246, 0x5272, 0x5277, 0x3515, 0x52C7, 0x52C9, 0x52E4, 0x52FA, 0x5305, 0x5306,
+        0x5317, 0x5349, 0x5351, 0x535A, 0x5373, 0x537D, 0x537F, 0x537F, 0x537F, 0x20A2C, 0x7070, 0x53CA,
+        0x53DF, 0x20B63, 0x53EB, 0x53F1, 0x5406, 0x549E, 0x5438, 0x5448, 0x5468, 0x54A2, 0x54F6, 0x5510,
+        0x5553, 0x5563, 0x5584, 0x5584, 0x5599, 0x55AB, 0x55B3, 0x55C2, 0x5716, 0x5606, 0x5717, 0x5651,
+        0x5674, 0x5207, 0x58EE, 0x57CE, 0x57F4, 0x580D, 0x578B, 0x5832, 0x5831, 0x58AC, 0x214E4, 0x58F2,
+        0x58F7, 0x5906, 0x591A, 0x5922, 0x5962, 0x216A8, 0x216EA, 0x59EC, 0x5A1B, 0x5A27, 0x59D8, 0x5A66,
+        0x36EE, 0x36FC, 0x5B08, 0x5B3E, 0x5B3E, 0x219C8, 0x5BC3, 0x5BD8, 0x5BE7, 0x5BF3, 0x21B18, 0x5BFF,
+        0x5C06, 0x5F53, 0x5C22, 0x3781, 0x5C60, 0x5C6E, 0x5CC0, 0x5C8D, 0x21DE4, 0x5D43, 0x21DE6, 0x5D6E,
+        0x5D6B, 0x5D7C, 0x5DE1, 0x5DE2, 0x382F, 0x5DFD, 0x5E28, 0x5E3D, 0x5E69, 0x3862, 0x22183, 0x387C,
+        0x5EB0, 0x5EB3, 0x5EB6, 0x5ECA, 0x2A392, 0x5EFE, 0x22331, 0x22331, 0x8201, 0x5F22, 0x5F22, 0x38C7,
+        0x232B8, 0x261DA, 0x5F62, 0x5F6B, 0x38E3, 0x5F9A, 0x5FCD, 0x5FD7, 0x5FF9, 0x6081, 0x393A, 0x391C,
+        0x6094, 0x226D4, 0x60C7, 0x6148, 0x614C, 0x614E, 0x614C, 0x617A, 0x618E, 0x61B2, 0x61A4, 0x61AF,
+        0x61DE, 0x61F2, 0x61F6, 0x6210, 0x621B, 0x625D, 0x62B1, 0x62D4, 0x6350, 0x22B0C, 0x633D, 0x62FC,
+        0x6368, 0x6383, 0x63E4, 0x22BF1, 0x6422, 0x63C5, 0x63A9, 0x3A2E, 0x6469, 0x647E, 0x649D, 0x6477,
+        0x3A6C, 0x654F, 0x656C, 0x2300A, 0x65E3, 0x66F8, 0x6649, 0x3B19, 0x6691, 0x3B08, 0x3AE4, 0x5192,
+        0x5195, 0x6700, 0x669C, 0x80AD, 0x43D9, 0x6717, 0x671B, 0x6721, 0x675E, 0x6753, 0x233C3, 0x3B49,
+        0x67FA, 0x6785, 0x6852, 0x6885, 0x2346D, 0x688E, 0x681F, 0x6914, 0x3B9D, 0x6942, 0x69A3, 0x69EA,
+        0x6AA8, 0x236A3, 0x6ADB, 0x3C18, 0x6B21, 0x238A7, 0x6B54, 0x3C4E, 0x6B72, 0x6B9F, 0x6BBA, 0x6BBB,
+        0x23A8D, 0x21D0B, 0x23AFA, 0x6C4E, 0x23CBC, 0x6CBF, 0x6CCD, 0x6C67, 0x6D16, 0x6D3E, 0x6D77, 0x6D41,
+        0x6D69, 0x6D78, 0x6D85, 0x23D1E, 0x6D34, 0x6E2F, 0x6E6E, 0x3D33, 0x6ECB, 0x6EC7, 0x23ED1, 0x6DF9,
+        0x6F6E, 0x23F5E, 0x23F8E, 0x6FC6, 0x7039, 0x701E, 0x701B, 0x3D96, 0x704A, 0x707D, 0x7077, 0x70AD,
+        0x20525, 0x7145, 0x24263, 0x719C, 0x243AB, 0x7228, 0x7235, 0x7250, 0x24608, 0x7280, 0x7295, 0x24735,
+        0x24814, 0x737A, 0x738B, 0x3EAC, 0x73A5, 0x3EB8, 0x3EB8, 0x7447, 0x745C, 0x7471, 0x7485, 0x74CA,
+        0x3F1B, 0x7524, 0x24C36, 0x753E, 0x24C92, 0x7570, 0x2219F, 0x7610, 0x24FA1, 0x24FB8, 0x25044, 0x3FFC,
+        0x4008, 0x76F4, 0x250F3, 0x250F2, 0x25119, 0x25133, 0x771E, 0x771F, 0x771F, 0x774A, 0x4039, 0x778B,
+        0x4046, 0x4096, 0x2541D, 0x784E, 0x788C, 0x78CC, 0x40E3, 0x25626, 0x7956, 0x2569A, 0x256C5, 0x798F,
+        0x79EB, 0x412F, 0x7A40, 0x7A4A, 0x7A4F, 0x2597C, 0x25AA7, 0x25AA7, 0x7AEE, 0x4202, 0x25BAB, 0x7BC6,
+        0x7BC9, 0x4227, 0x25C80, 0x7CD2, 0x42A0, 0x7CE8, 0x7CE3, 0x7D00, 0x25F86, 0x7D63, 0x4301, 0x7DC7,
+        0x7E02, 0x7E45, 0x4334, 0x26228, 0x26247, 0x4359, 0x262D9, 0x7F7A, 0x2633E, 0x7F95, 0x7FFA, 0x8005,
+        0x264DA, 0x26523, 0x8060, 0x265A8, 0x8070, 0x2335F, 0x43D5, 0x80B2, 0x8103, 0x440B, 0x813E, 0x5AB5,
+        0x267A7, 0x267B5, 0x23393, 0x2339C, 0x8201, 0x8204, 0x8F9E, 0x446B, 0x8291, 0x828B, 0x829D, 0x52B3,
+        0x82B1, 0x82B3, 0x82BD, 0x82E6, 0x26B3C, 0x82E5, 0x831D, 0x8363, 0x83AD, 0x8323, 0x83BD, 0x83E7,
+        0x8457, 0x8353, 0x83CA, 0x83CC, 0x83DC, 0x26C36, 0x26D6B, 0x26CD5, 0x452B, 0x84F1, 0x84F3, 0x8516,
+        0x273CA, 0x8564, 0x26F2C, 0x455D, 0x4561, 0x26FB1, 0x270D2, 0x456B, 0x8650, 0x865C, 0x8667, 0x8669,
+        0x86A9, 0x8688, 0x870E, 0x86E2, 0x8779, 0x8728, 0x876B, 0x8786, 0x45D7, 0x87E1, 0x8801, 0x45F9,
+        0x8860, 0x8863, 0x27667, 0x88D7, 0x88DE, 0x4635, 0x88FA, 0x34BB, 0x278AE, 0x27966, 0x46BE, 0x46C7,
+        0x8AA0, 0x8AED, 0x8B8A, 0x8C55, 0x27CA8, 0x8CAB, 0x8CC1, 0x8D1B, 0x8D77, 0x27F2F, 0x20804, 0x8DCB,
+        0x8DBC, 0x8DF0, 0x208DE, 0x8ED4, 0x8F38, 0x285D2, 0x285ED, 0x9094, 0x90F1, 0x9111, 0x2872E, 0x911B,
+        0x9238, 0x92D7, 0x92D8, 0x927C, 0x93F9, 0x9415, 0x28BFA, 0x958B, 0x4995, 0x95B7, 0x28D77, 0x49E6,
+        0x96C3, 0x5DB2, 0x9723, 0x29145, 0x2921A, 0x4A6E, 0x4A76, 0x97E0, 0x2940A, 0x4AB2, 0x29496, 0x980B,
+        0x980B, 0x9829, 0x295B6, 0x98E2, 0x4B33, 0x9929, 0x99A7, 0x99C2, 0x99FE, 0x4BCE, 0x29B30, 0x9B12,
+        0x9C40, 0x9CFD, 0x4CCE, 0x4CED, 0x9D67, 0x2A0CE, 0x4CF8, 0x2A105, 0x2A20E, 0x2A291, 0x9EBB, 0x4D56,
+        0x9EF9, 0x9EFE, 0x9F05, 0x9F0F, 0x9F16, 0x9F3B, 0x2A600
+};
+
+// Primary composites, sorted by (first, second)
+typedef struct utf8_composition {
+    uint32_t first;
+    uint32_t second;
+    uint32_t composite;
+} utf8_composition;
+
+static const utf8_composition utf8_compositions[941] = {
+        {0x003C, 0x0338, 0x226E},
+        {0x003D, 0x0338, 0x2260},
+        {0x003E, 0x0338, 0x226F},
+        {0x0041, 0x0300, 0x00C0},
+        {0x0041, 0x0301, 0x00C1},
+        {0x0041, 0x0302, 0x00C2},
+        {0x0041, 0x0303, 0x00C3},
+        {0x0041, 0x0304, 0x0100},
+        {0x0041, 0x0306, 0x0102},
+        {0x0041, 0x0307, 0x0226},
+        {0x0041, 0x0308, 0x00C4},
+        {0x0041, 0x0309, 0x1EA2},
+        {0x0041, 0x030A, 0x00C5},
+        {0x0041, 0x030C, 0x01CD},
+        {0x0041, 0x030F, 0x0200},
+        {0x0041, 0x0311, 0x0202},
+        {0x0041, 0x0323, 0x1EA0},
+        {0x0041, 0x0325, 0x1E00},
+        {0x0041, 0x0328, 0x0104},
+        {0x0042, 0x0307, 0x1E02},
+        {0x0042, 0x0323, 0x1E04},
+        {0x0042, 0x0331, 0x1E06},
+        {0x0043, 0x0301, 0x0106},
+        {0x0043, 0x0302, 0x0108},
+        {0x0043, 0x0307, 0x010A},
+        {0x0043, 0x030C, 0x010C},
+        {0x0043, 0x0327, 0x00C7},
+        {0x0044, 0x0307, 0x1E0A},
+        {0x0044, 0x030C, 0x010E},
+        {0x0044, 0x0323, 0x1E0C},
+        {0x0044, 0x0327, 0x1E10},
+        {0x0044, 0x032D, 0x1E12},
+        {0x0044, 0x0331, 0x1E0E},
+        {0x0045, 0x0300, 0x00C8},
+        {0x0045, 0x0301, 0x00C9},
+        {0x0045, 0x0302, 0x00CA},
+        {0x0045, 0x0303, 0x1EBC},
+        {0x0045, 0x0304, 0x0112},
+        {0x0045, 0x0306, 0x0114},
+        {0x0045, 0x0307, 0x0116},
+        {0x0045, 0x0308, 0x00CB},
+        {0x0045, 0x0309, 0x1EBA},
+        {0x0045, 0x030C, 0x011A},
+        {0x0045, 0x030F, 0x0204},
+        {0x0045, 0x0311, 0x0206},
+        {0x0045, 0x0323, 0x1EB8},
+        {0x0045, 0x0327, 0x0228},
+        {0x0045, 0x0328, 0x0118},
+        {0x0045, 0x032D, 0x1E18},
+        {0x0045, 0x0330, 0x1E1A},
+        {0x0046, 0x0307, 0x1E1E},
+        {0x0047, 0x0301, 0x01F4},
+        {0x0047, 0x0302, 0x011C},
+        {0x0047, 0x0304, 0x1E20},
+        {0x0047, 0x0306, 0x011E},
+        {0x0047, 0x0307, 0x0120},
+        {0x0047, 0x030C, 0x01E6},
+        {0x0047, 0x0327, 0x0122},
+        {0x0048, 0x0302, 0x0124},
+        {0x0048, 0x0307, 0x1E22},
+        {0x0048, 0x0308, 0x1E26},
+        {0x0048, 0x030C, 0x021E},
+        {0x0048, 0x0323, 0x1E24},
+        {0x0048, 0x0327, 0x1E28},
+        {0x0048, 0x032E, 0x1E2A},
+        {0x0049, 0x0300, 0x00CC},
+        {0x0049, 0x0301, 0x00CD},
+        {0x0049, 0x0302, 0x00CE},
+        {0x0049, 0x0303, 0x0128},
+        {0x0049, 0x0304, 0x012A},
+        {0x0049, 0x0306, 0x012C},
+        {0x0049, 0x0307, 0x0130},
+        {0x0049, 0x0308, 0x00CF},
+        {0x0049, 0x0309, 0x1EC8},
+        {0x0049, 0x030C, 0x01CF},
+        {0x0049, 0x030F, 0x0208},
+        {0x0049, 0x0311, 0x020A},
+        {0x0049, 0x0323, 0x1ECA},
+        {0x0049, 0x0328, 0x012E},
+        {0x0049, 0x0330, 0x1E2C},
+        {0x004A, 0x0302, 0x0134},
+        {0x004B, 0x0301, 0x1E30},
+        {0x004B, 0x030C, 0x01E8},
+        {0x004B, 0x0323, 0x1E32},
+        {0x004B, 0x0327, 0x0136},
+        {0x004B, 0x0331, 0x1E34},
+        {0x004C, 0x0301, 0x0139},
+        {0x004C, 0x030C, 0x013D},
+        {0x004C, 0x0323, 0x1E36},
+        {0x004C, 0x0327, 0x013B},
+        {0x004C, 0x032D, 0x1E3C},
+        {0x004C, 0x0331, 0x1E3A},
+        {0x004D, 0x0301, 0x1E3E},
+        {0x004D, 0x0307, 0x1E40},
+        {0x004D, 0x0323, 0x1E42},
+        {0x004E, 0x0300, 0x01F8},
+        {0x004E, 0x0301, 0x0143},
+        {0x004E, 0x0303, 0x00D1},
+        {0x004E, 0x0307, 0x1E44},
+        {0x004E, 0x030C, 0x0147},
+        {0x004E, 0x0323, 0x1E46},
+        {0x004E, 0x0327, 0x0145},
+        {0x004E, 0x032D, 0x1E4A},
+        {0x004E, 0x0331, 0x1E48},
+        {0x004F, 0x0300, 0x00D2},
+        {0x004F, 0x0301, 0x00D3},
+        {0x004F, 0x0302, 0x00D4},
+        {0x004F, 0x0303, 0x00D5},
+        {0x004F, 0x0304, 0x014C},
+        {0x004F, 0x0306, 0x014E},
+        {0x004F, 0x0307, 0x022E},
+        {0x004F, 0x0308, 0x00D6},
+        {0x004F, 0x0309, 0x1ECE},
+        {0x004F, 0x030B, 0x0150},
+        {0x004F, 0x030C, 0x01D1},
+        {0x004F, 0x030F, 0x020C},
+        {0x004F, 0x0311, 0x020E},
+        {0x004F, 0x031B, 0x01A0},
+        {0x004F, 0x0323, 0x1ECC},
+        {0x004F, 0x0328, 0x01EA},
+        {0x0050, 0x0301, 0x1E54},
+        {0x0050, 0x0307, 0x1E56},
+        {0x0052, 0x0301, 0x0154},
+        {0x0052, 0x0307, 0x1E58},
+        {0x0052, 0x030C, 0x0158},
+        {0x0052, 0x030F, 0x0210},
+        {0x0052, 0x0311, 0x0212},
+        {0x0052, 0x0323, 0x1E5A},
+        {0x0052, 0x0327, 0x0156},
+        {0x0052, 0x0331, 0x1E5E},
+        {0x0053, 0x0301, 0x015A},
+        {0x0053, 0x0302, 0x015C},
+        {0x0053, 0x0307, 0x1E60},
+        {0x0053, 0x030C, 0x0160},
+        {0x0053, 0x0323, 0x1E62},
+        {0x0053, 0x0326, 0x0218},
+        {0x0053, 0x0327, 0x015E},
+        {0x0054, 0x0307, 0x1E6A},
+        {0x0054, 0x030C, 0x0164},
+        {0x0054, 0x0323, 0x1E6C},
+        {0x0054, 0x0326, 0x021A},
+        {0x0054, 0x0327, 0x0162},
+        {0x0054, 0x032D, 0x1E70},
+        {0x0054, 0x0331, 0x1E6E},
+        {0x0055, 0x0300, 0x00D9},
+        {0x0055, 0x0301, 0x00DA},
+        {0x0055, 0x0302, 0x00DB},
+        {0x0055, 0x0303, 0x0168},
+        {0x0055, 0x0304, 0x016A},
+        {0x0055, 0x0306, 0x016C},
+        {0x0055, 0x0308, 0x00DC},
+        {0x0055, 0x0309, 0x1EE6},
+        {0x0055, 0x030A, 0x016E},
+        {0x0055, 0x030B, 0x0170},
+        {0x0055, 0x030C, 0x01D3},
+        {0x0055, 0x030F, 0x0214},
+        {0x0055, 0x0311, 0x0216},
+        {0x0055, 0x031B, 0x01AF},
+        {0x0055, 0x0323, 0x1EE4},
+        {0x0055, 0x0324, 0x1E72},
+        {0x0055, 0x0328, 0x0172},
+        {0x0055, 0x032D, 0x1E76},
+        {0x0055, 0x0330, 0x1E74},
+        {0x0056, 0x0303, 0x1E7C},
+        {0x0056, 0x0323, 0x1E7E},
+        {0x0057, 0x0300, 0x1E80},
+        {0x0057, 0x0301, 0x1E82},
+        {0x0057, 0x0302, 0x0174},
+        {0x0057, 0x0307, 0x1E86},
+        {0x0057, 0x0308, 0x1E84},
+        {0x0057, 0x0323, 0x1E88},
+        {0x0058, 0x0307, 0x1E8A},
+        {0x0058, 0x0308, 0x1E8C},
+        {0x0059, 0x0300, 0x1EF2},
+        {0x0059, 0x0301, 0x00DD},
+        {0x0059, 0x0302, 0x0176},
+        {0x0059, 0x0303, 0x1EF8},
+        {0x0059, 0x0304, 0x0232},
+        {0x0059, 0x0307, 0x1E8E},
+        {0x0059, 0x0308, 0x0178},
+        {0x0059, 0x0309, 0x1EF6},
+        {0x0059, 0x0323, 0x1EF4},
+        {0x005A, 0x0301, 0x0179},
+        {0x005A, 0x0302, 0x1E90},
+        {0x005A, 0x0307, 0x017B},
+        {0x005A, 0x030C, 0x017D},
+        {0x005A, 0x0323, 0x1E92},
+        {0x005A, 0x0331, 0x1E94},
+        {0x0061, 0x0300, 0x00E0},
+        {0x0061, 0x0301, 0x00E1},
+        {0x0061, 0x0302, 0x00E2},
+        {0x0061, 0x0303, 0x00E3},
+        {0x0061, 0x0304, 0x0101},
+        {0x0061, 0x0306, 0x0103},
+        {0x0061, 0x0307, 0x0227},
+        {0x0061, 0x0308, 0x00E4},
+        {0x0061, 0x0309, 0x1EA3},
+        {0x0061, 0x030A, 0x00E5},
+        {0x0061, 0x030C, 0x01CE},
+        {0x0061, 0x030F, 0x0201},
+        {0x0061, 0x0311, 0x0203},
+        {0x0061, 0x0323, 0x1EA1},
+        {0x0061, 0x0325, 0x1E01},
+        {0x0061, 0x0328, 0x0105},
+        {0x0062, 0x0307, 0x1E03},
+        {0x0062, 0x0323, 0x1E05},
+        {0x0062, 0x0331, 0x1E07},
+        {0x0063, 0x0301, 0x0107},
+        {0x0063, 0x0302, 0x0109},
+        {0x0063, 0x0307, 0x010B},
+        {0x0063, 0x030C, 0x010D},
+        {0x0063, 0x0327, 0x00E7},
+        {0x0064, 0x0307, 0x1E0B},
+        {0x0064, 0x030C, 0x010F},
+        {0x0064, 0x0323, 0x1E0D},
+        {0x0064, 0x0327, 0x1E11},
+        {0x0064, 0x032D, 0x1E13},
+        {0x0064, 0x0331, 0x1E0F},
+        {0x0065, 0x0300, 0x00E8},
+        {0x0065, 0x0301, 0x00E9},
+        {0x0065, 0x0302, 0x00EA},
+        {0x0065, 0x0303, 0x1EBD},
+        {0x0065, 0x0304, 0x0113},
+        {0x0065, 0x0306, 0x0115},
+        {0x0065, 0x0307, 0x0117},
+        {0x0065, 0x0308, 0x00EB},
+        {0x0065, 0x0309, 0x1EBB},
+        {0x0065, 0x030C, 0x011B},
+        {0x0065, 0x030F, 0x0205},
+        {0x0065, 0x0311, 0x0207},
+        {0x0065, 0x0323, 0x1EB9},
+        {0x0065, 0x0327, 0x0229},
+        {0x0065, 0x0328, 0x0119},
+        {0x0065, 0x032D, 0x1E19},
+        {0x0065, 0x0330, 0x1E1B},
+        {0x0066, 0x0307, 0x1E1F},
+        {0x0067, 0x0301, 0x01F5},
+        {0x0067, 0x0302, 0x011D},
+        {0x0067, 0x0304, 0x1E21},
+        {0x0067, 0x0306, 0x011F},
+        {0x0067, 0x0307, 0x0121},
+        {0x0067, 0x030C, 0x01E7},
+        {0x0067, 0x0327, 0x0123},
+        {0x0068, 0x0302, 0x0125},
+        {0x0068, 0x0307, 0x1E23},
+        {0x0068, 0x0308, 0x1E27},
+        {0x0068, 0x030C, 0x021F},
+        {0x0068, 0x0323, 0x1E25},
+        {0x0068, 0x0327, 0x1E29},
+        {0x0068, 0x032E, 0x1E2B},
+        {0x0068, 0x0331, 0x1E96},
+        {0x0069, 0x0300, 0x00EC},
+        {0x0069, 0x0301, 0x00ED},
+        {0x0069, 0x0302, 0x00EE},
+        {0x0069, 0x0303, 0x0129},
+        {0x0069, 0x0304, 0x012B},
+        {0x0069, 0x0306, 0x012D},
+        {0x0069, 0x0308, 0x00EF},
+        {0x0069, 0x0309, 0x1EC9},
+        {0x0069, 0x030C, 0x01D0},
+        {0x0069, 0x030F, 0x0209},
+        {0x0069, 0x0311, 0x020B},
+        {0x0069, 0x0323, 0x1ECB},
+        {0x0069, 0x0328, 0x012F},
+        {0x0069, 0x0330, 0x1E2D},
+        {0x006A, 0x0302, 0x0135},
+        {0x006A, 0x030C, 0x01F0},
+        {0x006B, 0x0301, 0x1E31},
+        {0x006B, 0x030C, 0x01E9},
+        {0x006B, 0x0323, 0x1E33},
+        {0x006B, 0x0327, 0x0137},
+        {0x006B, 0x0331, 0x1E35},
+        {0x006C, 0x0301, 0x013A},
+        {0x006C, 0x030C, 0x013E},
+        {0x006C, 0x0323, 0x1E37},
+        {0x006C, 0x0327, 0x013C},
+        {0x006C, 0x032D, 0x1E3D},
+        {0x006C, 0x0331, 0x1E3B},
+        {0x006D, 0x0301, 0x1E3F},
+        {0x006D, 0x0307, 0x1E41},
+        {0x006D, 0x0323, 0x1E43},
+        {0x006E, 0x0300, 0x01F9},
+        {0x006E, 0x0301, 0x0144},
+        {0x006E, 0x0303, 0x00F1},
+        {0x006E, 0x0307, 0x1E45},
+        {0x006E, 0x030C, 0x0148},
+        {0x006E, 0x0323, 0x1E47},
+        {0x006E, 0x0327, 0x0146},
+        {0x006E, 0x032D, 0x1E4B},
+        {0x006E, 0x0331, 0x1E49},
+        {0x006F, 0x0300, 0x00F2},
+        {0x006F, 0x0301, 0x00F3},
+        {0x006F, 0x0302, 0x00F4},
+        {0x006F, 0x0303, 0x00F5},
+        {0x006F, 0x0304, 0x014D},
+        {0x006F, 0x0306, 0x014F},
+        {0x006F, 0x0307, 0x022F},
+        {0x006F, 0x0308, 0x00F6},
+        {0x006F, 0x0309, 0x1ECF},
+        {0x006F, 0x030B, 0x0151},
+        {0x006F, 0x030C, 0x01D2},
+        {0x006F, 0x030F, 0x020D},
+        {0x006F, 0x0311, 0x020F},
+        {0x006F, 0x031B, 0x01A1},
+        {0x006F, 0x0323, 0x1ECD},
+        {0x006F, 0x0328, 0x01EB},
+        {0x0070, 0x0301, 0x1E55},
+        {0x0070, 0x0307, 0x1E57},
+        {0x0072, 0x0301, 0x0155},
+        {0x0072, 0x0307, 0x1E59},
+        {0x0072, 0x030C, 0x0159},
+        {0x0072, 0x030F, 0x0211},
+        {0x0072, 0x0311, 0x0213},
+        {0x0072, 0x0323, 0x1E5B},
+        {0x0072, 0x0327, 0x0157},
+        {0x0072, 0x0331, 0x1E5F},
+        {0x0073, 0x0301, 0x015B},
+        {0x0073, 0x0302, 0x015D},
+        {0x0073, 0x0307, 0x1E61},
+        {0x0073, 0x030C, 0x0161},
+        {0x0073, 0x0323, 0x1E63},
+        {0x0073, 0x0326, 0x0219},
+        {0x0073, 0x0327, 0x015F},
+        {0x0074, 0x0307, 0x1E6B},
+        {0x0074, 0x0308, 0x1E97},
+        {0x0074, 0x030C, 0x0165},
+        {0x0074, 0x0323, 0x1E6D},
+        {0x0074, 0x0326, 0x021B},
+        {0x0074, 0x0327, 0x0163},
+        {0x0074, 0x032D, 0x1E71},
+        {0x0074, 0x0331, 0x1E6F},
+        {0x0075, 0x0300, 0x00F9},
+        {0x0075, 0x0301, 0x00FA},
+        {0x0075, 0x0302, 0x00FB},
+        {0x0075, 0x0303, 0x0169},
+        {0x0075, 0x0304, 0x016B},
+        {0x0075, 0x0306, 0x016D},
+        {0x0075, 0x0308, 0x00FC},
+        {0x0075, 0x0309, 0x1EE7},
+        {0x0075, 0x030A, 0x016F},
+        {0x0075, 0x030B, 0x0171},
+        {0x0075, 0x030C, 0x01D4},
+        {0x0075, 0x030F, 0x0215},
+        {0x0075, 0x0311, 0x0217},
+        {0x0075, 0x031B, 0x01B0},
+        {0x0075, 0x0323, 0x1EE5},
+        {0x0075, 0x0324, 0x1E73},
+        {0x0075, 0x0328, 0x0173},
+        {0x0075, 0x032D, 0x1E77},
+        {0x0075, 0x0330, 0x1E75},
+        {0x0076, 0x0303, 0x1E7D},
+        {0x0076, 0x0323, 0x1E7F},
+        {0x0077, 0x0300, 0x1E81},
+        {0x0077, 0x0301, 0x1E83},
+        {0x0077, 0x0302, 0x0175},
+        {0x0077, 0x0307, 0x1E87},
+        {0x0077, 0x0308, 0x1E85},
+        {0x0077, 0x030A, 0x1E98},
+        {0x0077, 0x0323, 0x1E89},
+        {0x0078, 0x0307, 0x1E8B},
+        {0x0078, 0x0308, 0x1E8D},
+        {0x0079, 0x0300, 0x1EF3},
+        {0x0079, 0x0301, 0x00FD},
+        {0x0079, 0x0302, 0x0177},
+        {0x0079, 0x0303, 0x1EF9},
+        {0x0079, 0x0304, 0x0233},
+        {0x0079, 0x0307, 0x1E8F},
+        {0x0079, 0x0308, 0x00FF},
+        {0x0079, 0x0309, 0x1EF7},
+        {0x0079, 0x030A, 0x1E99},
+        {0x0079, 0x0323, 0x1EF5},
+        {0x007A, 0x0301, 0x017A},
+        {0x007A, 0x0302, 0x1E91},
+        {0x007A, 0x0307, 0x017C},
+        {0x007A, 0x030C, 0x017E},
+        {0x007A, 0x0323, 0x1E93},
+        {0x007A, 0x0331, 0x1E95},
+        {0x00A8, 0x0300, 0x1FED},
+        {0x00A8, 0x0301, 0x0385},
+        {0x00A8, 0x0342, 0x1FC1},
+        {0x00C2, 0x0300, 0x1EA6},
+        {0x00C2, 0x0301, 0x1EA4},
+        {0x00C2, 0x0303, 0x1EAA},
+        {0x00C2, 0x0309, 0x1EA8},
+        {0x00C4, 0x0304, 0x01DE},
+        {0x00C5, 0x0301, 0x01FA},
+        {0x00C6, 0x0301, 0x01FC},
+        {0x00C6, 0x0304, 0x01E2},
+        {0x00C7, 0x0301, 0x1E08},
+        {0x00CA, 0x0300, 0x1EC0},
+        {0x00CA, 0x0301, 0x1EBE},
+        {0x00CA, 0x0303, 0x1EC4},
+        {0x00CA, 0x0309, 0x1EC2},
+        {0x00CF, 0x0301, 0x1E2E},
+        {0x00D4, 0x0300, 0x1ED2},
+        {0x00D4, 0x0301, 0x1ED0},
+        {0x00D4, 0x0303, 0x1ED6},
+        {0x00D4, 0x0309, 0x1ED4},
+        {0x00D5, 0x0301, 0x1E4C},
+        {0x00D5, 0x0304, 0x022C},
+        {0x00D5, 0x0308, 0x1E4E},
+        {0x00D6, 0x0304, 0x022A},
+        {0x00D8, 0x0301, 0x01FE},
+        {0x00DC, 0x0300, 0x01DB},
+        {0x00DC, 0x0301, 0x01D7},
+        {0x00DC, 0x0304, 0x01D5},
+        {0x00DC, 0x030C, 0x01D9},
+        {0x00E2, 0x0300, 0x1EA7},
+        {0x00E2, 0x0301, 0x1EA5},
+        {0x00E2, 0x0303, 0x1EAB},
+        {0x00E2, 0x0309, 0x1EA9},
+        {0x00E4, 0x0304, 0x01DF},
+        {0x00E5, 0x0301, 0x01FB},
+        {0x00E6, 0x0301, 0x01FD},
+        {0x00E6, 0x0304, 0x01E3},
+        {0x00E7, 0x0301, 0x1E09},
+        {0x00EA, 0x0300, 0x1EC1},
+        {0x00EA, 0x0301, 0x1EBF},
+        {0x00EA, 0x0303, 0x1EC5},
+        {0x00EA, 0x0309, 0x1EC3},
+        {0x00EF, 0x0301, 0x1E2F},
+        {0x00F4, 0x0300, 0x1ED3},
+        {0x00F4, 0x0301, 0x1ED1},
+        {0x00F4, 0x0303, 0x1ED7},
+        {0x00F4, 0x0309, 0x1ED5},
+        {0x00F5, 0x0301, 0x1E4D},
+        {0x00F5, 0x0304, 0x022D},
+        {0x00F5, 0x0308, 0x1E4F},
+        {0x00F6, 0x0304, 0x022B},
+        {0x00F8, 0x0301, 0x01FF},
+        {0x00FC, 0x0300, 0x01DC},
+        {0x00FC, 0x0301, 0x01D8},
+        {0x00FC, 0x0304, 0x01D6},
+        {0x00FC, 0x030C, 0x01DA},
+        {0x0102, 0x0300, 0x1EB0},
+        {0x0102, 0x0301, 0x1EAE},
+        {0x0102, 0x0303, 0x1EB4},
+        {0x0102, 0x0309, 0x1EB2},
+        {0x0103, 0x0300, 0x1EB1},
+        {0x0103, 0x0301, 0x1EAF},
+        {0x0103, 0x0303, 0x1EB5},
+        {0x0103, 0x0309, 0x1EB3},
+        {0x0112, 0x0300, 0x1E14},
+        {0x0112, 0x0301, 0x1E16},
+        {0x0113, 0x0300, 0x1E15},
+        {0x0113, 0x0301, 0x1E17},
+        {0x014C, 0x0300, 0x1E50},
+        {0x014C, 0x0301, 0x1E52},
+        {0x014D, 0x0300, 0x1E51},
+        {0x014D, 0x0301, 0x1E53},
+        {0x015A, 0x0307, 0x1E64},
+        {0x015B, 0x0307, 0x1E65},
+        {0x0160, 0x0307, 0x1E66},
+        {0x0161, 0x0307, 0x1E67},
+        {0x0168, 0x0301, 0x1E78},
+        {0x0169, 0x0301, 0x1E79},
+        {0x016A, 0x0308, 0x1E7A},
+        {0x016B, 0x0308, 0x1E7B},
+        {0x017F, 0x0307, 0x1E9B},
+        {0x01A0, 0x0300, 0x1EDC},
+        {0x01A0, 0x0301, 0x1EDA},
+        {0x01A0, 0x0303, 0x1EE0},
+        {0x01A0, 0x0309, 0x1EDE},
+        {0x01A0, 0x0323, 0x1EE2},
+        {0x01A1, 0x0300, 0x1EDD},
+        {0x01A1, 0x0301, 0x1EDB},
+        {0x01A1, 0x0303, 0x1EE1},
+        {0x01A1, 0x0309, 0x1EDF},
+        {0x01A1, 0x0323, 0x1EE3},
+        {0x01AF, 0x0300, 0x1EEA},
+        {0x01AF, 0x0301, 0x1EE8},
+        {0x01AF, 0x0303, 0x1EEE},
+        {0x01AF, 0x0309, 0x1EEC},
+        {0x01AF, 0x0323, 0x1EF0},
+        {0x01B0, 0x0300, 0x1EEB},
+        {0x01B0, 0x0301, 0x1EE9},
+        {0x01B0, 0x0303, 0x1EEF},
+        {0x01B0, 0x0309, 0x1EED},
+        {0x01B0, 0x0323, 0x1EF1},
+        {0x01B7, 0x030C, 0x01EE},
+        {0x01EA, 0x0304, 0x01EC},
+        {0x01EB, 0x0304, 0x01ED},
+        {0x0226, 0x0304, 0x01E0},
+        {0x0227, 0x0304, 0x01E1},
+        {0x0228, 0x0306, 0x1E1C},
+        {0x0229, 0x0306, 0x1E1D},
+        {0x022E, 0x0304, 0x0230},
+        {0x022F, 0x0304, 0x0231},
+        {0x0292, 0x030C, 0x01EF},
+        {0x0391, 0x0300, 0x1FBA},
+        {0x0391, 0x0301, 0x0386},
+        {0x0391, 0x0304, 0x1FB9},
+        {0x0391, 0x0306, 0x1FB8},
+        {0x0391, 0x0313, 0x1F08},
+        {0x0391, 0x0314, 0x1F09},
+        {0x0391, 0x0345, 0x1FBC},
+        {0x0395, 0x0300, 0x1FC8},
+        {0x0395, 0x0301, 0x0388},
+        {0x0395, 0x0313, 0x1F18},
+        {0x0395, 0x0314, 0x1F19},
+        {0x0397, 0x0300, 0x1FCA},
+        {0x0397, 0x0301, 0x0389},
+        {0x0397, 0x0313, 0x1F28},
+        {0x0397, 0x0314, 0x1F29},
+        {0x0397, 0x0345, 0x1FCC},
+        {0x0399, 0x0300, 0x1FDA},
+        {0x0399, 0x0301, 0x038A},
+        {0x0399, 0x0304, 0x1FD9},
+        {0x0399, 0x0306, 0x1FD8},
+        {0x0399, 0x0308, 0x03AA},
+        {0x0399, 0x0313, 0x1F38},
+        {0x0399, 0x0314, 0x1F39},
+        {0x039F, 0x0300, 0x1FF8},
+        {0x039F, 0x0301, 0x038C},
+        {0x039F, 0x0313, 0x1F48},
+        {0x039F, 0x0314, 0x1F49},
+        {0x03A1, 0x0314, 0x1FEC},
+        {0x03A5, 0x0300, 0x1FEA},
+        {0x03A5, 0x0301, 0x038E},
+        {0x03A5, 0x0304, 0x1FE9},
+        {0x03A5, 0x0306, 0x1FE8},
+        {0x03A5, 0x0308, 0x03AB},
+        {0x03A5, 0x0314, 0x1F59},
+        {0x03A9, 0x0300, 0x1FFA},
+        {0x03A9, 0x0301, 0x038F},
+        {0x03A9, 0x0313, 0x1F68},
+        {0x03A9, 0x0314, 0x1F69},
+        {0x03A9, 0x0345, 0x1FFC},
+        {0x03AC, 0x0345, 0x1FB4},
+        {0x03AE, 0x0345, 0x1FC4},
+        {0x03B1, 0x0300, 0x1F70},
+        {0x03B1, 0x0301, 0x03AC},
+        {0x03B1, 0x0304, 0x1FB1},
+        {0x03B1, 0x0306, 0x1FB0},
+        {0x03B1, 0x0313, 0x1F00},
+        {0x03B1, 0x0314, 0x1F01},
+        {0x03B1, 0x0342, 0x1FB6},
+        {0x03B1, 0x0345, 0x1FB3},
+        {0x03B5, 0x0300, 0x1F72},
+        {0x03B5, 0x0301, 0x03AD},
+        {0x03B5, 0x0313, 0x1F10},
+        {0x03B5, 0x0314, 0x1F11},
+        {0x03B7, 0x0300, 0x1F74},
+        {0x03B7, 0x0301, 0x03AE},
+        {0x03B7, 0x0313, 0x1F20},
+        {0x03B7, 0x0314, 0x1F21},
+        {0x03B7, 0x0342, 0x1FC6},
+        {0x03B7, 0x0345, 0x1FC3},
+        {0x03B9, 0x0300, 0x1F76},
+        {0x03B9, 0x0301, 0x03AF},
+        {0x03B9, 0x0304, 0x1FD1},
+        {0x03B9, 0x0306, 0x1FD0},
+        {0x03B9, 0x0308, 0x03CA},
+        {0x03B9, 0x0313, 0x1F30},
+        {0x03B9, 0x0314, 0x1F31},
+        {0x03B9, 0x0342, 0x1FD6},
+        {0x03BF, 0x0300, 0x1F78},
+        {0x03BF, 0x0301, 0x03CC},
+        {0x03BF, 0x0313, 0x1F40},
+        {0x03BF, 0x0314, 0x1F41},
+        {0x03C1, 0x0313, 0x1FE4},
+        {0x03C1, 0x0314, 0x1FE5},
+        {0x03C5, 0x0300, 0x1F7A},
+        {0x03C5, 0x0301, 0x03CD},
+        {0x03C5, 0x0304, 0x1FE1},
+        {0x03C5, 0x0306, 0x1FE0},
+        {0x03C5, 0x0308, 0x03CB},
+        {0x03C5, 0x0313, 0x1F50},
+        {0x03C5, 0x0314, 0x1F51},
+        {0x03C5, 0x0342, 0x1FE6},
+        {0x03C9, 0x0300, 0x1F7C},
+        {0x03C9, 0x0301, 0x03CE},
+        {0x03C9, 0x0313, 0x1F60},
+        {0x03C9, 0x0314, 0x1F61},
+        {0x03C9, 0x0342, 0x1FF6},
+        {0x03C9, 0x0345, 0x1FF3},
+        {0x03CA, 0x0300, 0x1FD2},
+        {0x03CA, 0x0301, 0x0390},
+        {0x03CA, 0x0342, 0x1FD7},
+        {0x03CB, 0x0300, 0x1FE2},
+        {0x03CB, 0x0301, 0x03B0},
+        {0x03CB, 0x0342, 0x1FE7},
+        {0x03CE, 0x0345, 0x1FF4},
+        {0x03D2, 0x0301, 0x03D3},
+        {0x03D2, 0x0308, 0x03D4},
+        {0x0406, 0x0308, 0x0407},
+        {0x0410, 0x0306, 0x04D0},
+        {0x0410, 0x0308, 0x04D2},
+        {0x0413, 0x0301, 0x0403},
+        {0x0415, 0x0300, 0x0400},
+        {0x0415, 0x0306, 0x04D6},
+        {0x0415, 0x0308, 0x0401},
+        {0x0416, 0x0306, 0x04C1},
+        {0x0416, 0x0308, 0x04DC},
+        {0x0417, 0x0308, 0x04DE},
+        {0x0418, 0x0300, 0x040D},
+        {0x0418, 0x0304, 0x04E2},
+        {0x0418, 0x0306, 0x0419},
+        {0x0418, 0x0308, 0x04E4},
+        {0x041A, 0x0301, 0x040C},
+        {0x041E, 0x0308, 0x04E6},
+        {0x0423, 0x0304, 0x04EE},
+        {0x0423, 0x0306, 0x040E},
+        {0x0423, 0x0308, 0x04F0},
+        {0x0423, 0x030B, 0x04F2},
+        {0x0427, 0x0308, 0x04F4},
+        {0x042B, 0x0308, 0x04F8},
+        {0x042D, 0x0308, 0x04EC},
+        {0x0430, 0x0306, 0x04D1},
+        {0x0430, 0x0308, 0x04D3},
+        {0x0433, 0x0301, 0x0453},
+        {0x0435, 0x0300, 0x0450},
+        {0x0435, 0x0306, 0x04D7},
+        {0x0435, 0x0308, 0x0451},
+        {0x0436, 0x0306, 0x04C2},
+        {0x0436, 0x0308, 0x04DD},
+        {0x0437, 0x0308, 0x04DF},
+        {0x0438, 0x0300, 0x045D},
+        {0x0438, 0x0304, 0x04E3},
+        {0x0438, 0x0306, 0x0439},
+        {0x0438, 0x0308, 0x04E5},
+        {0x043A, 0x0301, 0x045C},
+        {0x043E, 0x0308, 0x04E7},
+        {0x0443, 0x0304, 0x04EF},
+        {0x0443, 0x0306, 0x045E},
+        {0x0443, 0x0308, 0x04F1},
+        {0x0443, 0x030B, 0x04F3},
+        {0x0447, 0x0308, 0x04F5},
+        {0x044B, 0x0308, 0x04F9},
+        {0x044D, 0x0308, 0x04ED},
+        {0x0456, 0x0308, 0x0457},
+        {0x0474, 0x030F, 0x0476},
+        {0x0475, 0x030F, 0x0477},
+        {0x04D8, 0x0308, 0x04DA},
+        {0x04D9, 0x0308, 0x04DB},
+        {0x04E8, 0x0308, 0x04EA},
+        {0x04E9, 0x0308, 0x04EB},
+        {0x0627, 0x0653, 0x0622},
+        {0x0627, 0x0654, 0x0623},
+        {0x0627, 0x0655, 0x0625},
+        {0x0648, 0x0654, 0x0624},
+        {0x064A, 0x0654, 0x0626},
+        {0x06C1, 0x0654, 0x06C2},
+        {0x06D2, 0x0654, 0x06D3},
+        {0x06D5, 0x0654, 0x06C0},
+        {0x0928, 0x093C, 0x0929},
+        {0x0930, 0x093C, 0x0931},
+        {0x0933, 0x093C, 0x0934},
+        {0x09C7, 0x09BE, 0x09CB},
+        {0x09C7, 0x09D7, 0x09CC},
+        {0x0B47, 0x0B3E, 0x0B4B},
+        {0x0B47, 0x0B56, 0x0B48},
+        {0x0B47, 0x0B57, 0x0B4C},
+        {0x0B92, 0x0BD7, 0x0B94},
+        {0x0BC6, 0x0BBE, 0x0BCA},
+        {0x0BC6, 0x0BD7, 0x0BCC},
+        {0x0BC7, 0x0BBE, 0x0BCB},
+        {0x0C46, 0x0C56, 0x0C48},
+        {0x0CBF, 0x0CD5, 0x0CC0},
+        {0x0CC6, 0x0CC2, 0x0CCA},
+        {0x0CC6, 0x0CD5, 0x0CC7},
+        {0x0CC6, 0x0CD6, 0x0CC8},
+        {0x0CCA, 0x0CD5, 0x0CCB},
+        {0x0D46, 0x0D3E, 0x0D4A},
+        {0x0D46, 0x0D57, 0x0D4C},
+        {0x0D47, 0x0D3E, 0x0D4B},
+        {0x0DD9, 0x0DCA, 0x0DDA},
+        {0x0DD9, 0x0DCF, 0x0DDC},
+        {0x0DD9, 0x0DDF, 0x0DDE},
+        {0x0DDC, 0x0DCA, 0x0DDD},
+        {0x1025, 0x102E, 0x1026},
+        {0x1B05, 0x1B35, 0x1B06},
+        {0x1B07, 0x1B35, 0x1B08},
+        {0x1B09, 0x1B35, 0x1B0A},
+        {0x1B0B, 0x1B35, 0x1B0C},
+        {0x1B0D, 0x1B35, 0x1B0E},
+        {0x1B11, 0x1B35, 0x1B12},
+        {0x1B3A, 0x1B35, 0x1B3B},
+        {0x1B3C, 0x1B35, 0x1B3D},
+        {0x1B3E, 0x1B35, 0x1B40},
+        {0x1B3F, 0x1B35, 0x1B41},
+        {0x1B42, 0x1B35, 0x1B43},
+        {0x1E36, 0x0304, 0x1E38},
+        {0x1E37, 0x0304, 0x1E39},
+        {0x1E5A, 0x0304, 0x1E5C},
+        {0x1E5B, 0x0304, 0x1E5D},
+        {0x1E62, 0x0307, 0x1E68},
+        {0x1E63, 0x0307, 0x1E69},
+        {0x1EA0, 0x0302, 0x1EAC},
+        {0x1EA0, 0x0306, 0x1EB6},
+        {0x1EA1, 0x0302, 0x1EAD},
+        {0x1EA1, 0x0306, 0x1EB7},
+        {0x1EB8, 0x0302, 0x1EC6},
+        {0x1EB9, 0x0302, 0x1EC7},
+        {0x1ECC, 0x0302, 0x1ED8},
+        {0x1ECD, 0x0302, 0x1ED9},
+        {0x1F00, 0x0300, 0x1F02},
+        {0x1F00, 0x0301, 0x1F04},
+        {0x1F00, 0x0342, 0x1F06},
+        {0x1F00, 0x0345, 0x1F80},
+        {0x1F01, 0x0300, 0x1F03},
+        {0x1F01, 0x0301, 0x1F05},
+        {0x1F01, 0x0342, 0x1F07},
+        {0x1F01, 0x0345, 0x1F81},
+        {0x1F02, 0x0345, 0x1F82},
+        {0x1F03, 0x0345, 0x1F83},
+        {0x1F04, 0x0345, 0x1F84},
+        {0x1F05, 0x0345, 0x1F85},
+        {0x1F06, 0x0345, 0x1F86},
+        {0x1F07, 0x0345, 0x1F87},
+        {0x1F08, 0x0300, 0x1F0A},
+        {0x1F08, 0x0301, 0x1F0C},
+        {0x1F08, 0x0342, 0x1F0E},
+        {0x1F08, 0x0345, 0x1F88},
+        {0x1F09, 0x0300, 0x1F0B},
+        {0x1F09, 0x0301, 0x1F0D},
+        {0x1F09, 0x0342, 0x1F0F},
+        {0x1F09, 0x0345, 0x1F89},
+        {0x1F0A, 0x0345, 0x1F8A},
+        {0x1F0B, 0x0345, 0x1F8B},
+        {0x1F0C, 0x0345, 0x1F8C},
+        {0x1F0D, 0x0345, 0x1F8D},
+        {0x1F0E, 0x0345, 0x1F8E},
+        {0x1F0F, 0x0345, 0x1F8F},
+        {0x1F10, 0x0300, 0x1F12},
+        {0x1F10, 0x0301, 0x1F14},
+        {0x1F11, 0x0300, 0x1F13},
+        {0x1F11, 0x0301, 0x1F15},
+        {0x1F18, 0x0300, 0x1F1A},
+        {0x1F18, 0x0301, 0x1F1C},
+        {0x1F19, 0x0300, 0x1F1B},
+        {0x1F19, 0x0301, 0x1F1D},
+        {0x1F20, 0x0300, 0x1F22},
+        {0x1F20, 0x0301, 0x1F24},
+        {0x1F20, 0x0342, 0x1F26},
+        {0x1F20, 0x0345, 0x1F90},
+        {0x1F21, 0x0300, 0x1F23},
+        {0x1F21, 0x0301, 0x1F25},
+        {0x1F21, 0x0342, 0x1F27},
+        {0x1F21, 0x0345, 0x1F91},
+        {0x1F22, 0x0345, 0x1F92},
+        {0x1F23, 0x0345, 0x1F93},
+        {0x1F24, 0x0345, 0x1F94},
+        {0x1F25, 0x0345, 0x1F95},
+        {0x1F26, 0x0345, 0x1F96},
+        {0x1F27, 0x0345, 0x1F97},
+        {0x1F28, 0x0300, 0x1F2A},
+        {0x1F28, 0x0301, 0x1F2C},
+        {0x1F28, 0x0342, 0x1F2E},
+        {0x1F28, 0x0345, 0x1F98},
+        {0x1F29, 0x0300, 0x1F2B},
+        {0x1F29, 0x0301, 0x1F2D},
+        {0x1F29, 0x0342, 0x1F2F},
+        {0x1F29, 0x0345, 0x1F99},
+        {0x1F2A, 0x0345, 0x1F9A},
+        {0x1F2B, 0x0345, 0x1F9B},
+        {0x1F2C, 0x0345, 0x1F9C},
+        {0x1F2D, 0x0345, 0x1F9D},
+        {0x1F2E, 0x0345, 0x1F9E},
+        {0x1F2F, 0x0345, 0x1F9F},
+        {0x1F30, 0x0300, 0x1F32},
+        {0x1F30, 0x0301, 0x1F34},
+        {0x1F30, 0x0342, 0x1F36},
+        {0x1F31, 0x0300, 0x1F33},
+        {0x1F31, 0x0301, 0x1F35},
+        {0x1F31, 0x0342, 0x1F37},
+        {0x1F38, 0x0300, 0x1F3A},
+        {0x1F38, 0x0301, 0x1F3C},
+        {0x1F38, 0x0342, 0x1F3E},
+        {0x1F39, 0x0300, 0x1F3B},
+        {0x1F39, 0x0301, 0x1F3D},
+        {0x1F39, 0x0342, 0x1F3F},
+        {0x1F40, 0x0300, 0x1F42},
+        {0x1F40, 0x0301, 0x1F44},
+        {0x1F41, 0x0300, 0x1F43},
+        {0x1F41, 0x0301, 0x1F45},
+        {0x1F48, 0x0300, 0x1F4A},
+        {0x1F48, 0x0301, 0x1F4C},
+        {0x1F49, 0x0300, 0x1F4B},
+        {0x1F49, 0x0301, 0x1F4D},
+        {0x1F50, 0x0300, 0x1F52},
+        {0x1F50, 0x0301, 0x1F54},
+        {0x1F50, 0x0342, 0x1F56},
+        {0x1F51, 0x0300, 0x1F53},
+        {0x1F51, 0x0301, 0x1F55},
+        {0x1F51, 0x0342, 0x1F57},
+        {0x1F59, 0x0300, 0x1F5B},
+        {0x1F59, 0x0301, 0x1F5D},
+        {0x1F59, 0x0342, 0x1F5F},
+        {0x1F60, 0x0300, 0x1F62},
+        {0x1F60, 0x0301, 0x1F64},
+        {0x1F60, 0x0342, 0x1F66},
+        {0x1F60, 0x0345, 0x1FA0},
+        {0x1F61, 0x0300, 0x1F63},
+        {0x1F61, 0x0301, 0x1F65},
+        {0x1F61, 0x0342, 0x1F67},
+        {0x1F61, 0x0345, 0x1FA1},
+        {0x1F62, 0x0345, 0x1FA2},
+        {0x1F63, 0x0345, 0x1FA3},
+        {0x1F64, 0x0345, 0x1FA4},
+        {0x1F65, 0x0345, 0x1FA5},
+        {0x1F66, 0x0345, 0x1FA6},
+        {0x1F67, 0x0345, 0x1FA7},
+        {0x1F68, 0x0300, 0x1F6A},
+        {0x1F68, 0x0301, 0x1F6C},
+        {0x1F68, 0x0342, 0x1F6E},
+        {0x1F68, 0x0345, 0x1FA8},
+        {0x1F69, 0x0300, 0x1F6B},
+        {0x1F69, 0x0301, 0x1F6D},
+        {0x1F69, 0x0342, 0x1F6F},
+        {0x1F69, 0x0345, 0x1FA9},
+        {0x1F6A, 0x0345, 0x1FAA},
+        {0x1F6B, 0x0345, 0x1FAB},
+        {0x1F6C, 0x0345, 0x1FAC},
+        {0x1F6D, 0x0345, 0x1FAD},
+        {0x1F6E, 0x0345, 0x1FAE},
+        {0x1F6F, 0x0345, 0x1FAF},
+        {0x1F70, 0x0345, 0x1FB2},
+        {0x1F74, 0x0345, 0x1FC2},
+        {0x1F7C, 0x0345, 0x1FF2},
+        {0x1FB6, 0x0345, 0x1FB7},
+        {0x1FBF, 0x0300, 0x1FCD},
+        {0x1FBF, 0x0301, 0x1FCE},
+        {0x1FBF, 0x0342, 0x1FCF},
+        {0x1FC6, 0x0345, 0x1FC7},
+        {0x1FF6, 0x0345, 0x1FF7},
+        {0x1FFE, 0x0300, 0x1FDD},
+        {0x1FFE, 0x0301, 0x1FDE},
+        {0x1FFE, 0x0342, 0x1FDF},
+        {0x2190, 0x0338, 0x219A},
+        {0x2192, 0x0338, 0x219B},
+        {0x2194, 0x0338, 0x21AE},
+        {0x21D0, 0x0338, 0x21CD},
+        {0x21D2, 0x0338, 0x21CF},
+        {0x21D4, 0x0338, 0x21CE},
+        {0x2203, 0x0338, 0x2204},
+        {0x2208, 0x0338, 0x2209},
+        {0x220B, 0x0338, 0x220C},
+        {0x2223, 0x0338, 0x2224},
+        {0x2225, 0x0338, 0x2226},
+        {0x223C, 0x0338, 0x2241},
+        {0x2243, 0x0338, 0x2244},
+        {0x2245, 0x0338, 0x2247},
+        {0x2248, 0x0338, 0x2249},
+        {0x224D, 0x0338, 0x226D},
+        {0x2261, 0x0338, 0x2262},
+        {0x2264, 0x0338, 0x2270},
+        {0x2265, 0x0338, 0x2271},
+        {0x2272, 0x0338, 0x2274},
+        {0x2273, 0x0338, 0x2275},
+        {0x2276, 0x0338, 0x2278},
+        {0x2277, 0x0338, 0x2279},
+        {0x227A, 0x0338, 0x2280},
+        {0x227B, 0x0338, 0x2281},
+        {0x227C, 0x0338, 0x22E0},
+        {0x227D, 0x0338, 0x22E1},
+        {0x2282, 0x0338, 0x2284},
+        {0x2283, 0x0338, 0x2285},
+        {0x2286, 0x0338, 0x2288},
+        {0x2287, 0x0338, 0x2289},
+        {0x2291, 0x0338, 0x22E2},
+        {0x2292, 0x0338, 0x22E3},
+        {0x22A2, 0x0338, 0x22AC},
+        {0x22A8, 0x0338, 0x22AD},
+        {0x22A9, 0x0338, 0x22AE},
+        {0x22AB, 0x0338, 0x22AF},
+        {0x22B2, 0x0338, 0x22EA},
+        {0x22B3, 0x0338, 0x22EB},
+        {0x22B4, 0x0338, 0x22EC},
+        {0x22B5, 0x0338, 0x22ED},
+        {0x3046, 0x3099, 0x3094},
+        {0x304B, 0x3099, 0x304C},
+        {0x304D, 0x3099, 0x304E},
+        {0x304F, 0x3099, 0x3050},
+        {0x3051, 0x3099, 0x3052},
+        {0x3053, 0x3099, 0x3054},
+        {0x3055, 0x3099, 0x3056},
+        {0x3057, 0x3099, 0x3058},
+        {0x3059, 0x3099, 0x305A},
+        {0x305B, 0x3099, 0x305C},
+        {0x305D, 0x3099, 0x305E},
+        {0x305F, 0x3099, 0x3060},
+        {0x3061, 0x3099, 0x3062},
+        {0x3064, 0x3099, 0x3065},
+        {0x3066, 0x3099, 0x3067},
+        {0x3068, 0x3099, 0x3069},
+        {0x306F, 0x3099, 0x3070},
+        {0x306F, 0x309A, 0x3071},
+        {0x3072, 0x3099, 0x3073},
+        {0x3072, 0x309A, 0x3074},
+        {0x3075, 0x3099, 0x3076},
+        {0x3075, 0x309A, 0x3077},
+        {0x3078, 0x3099, 0x3079},
+        {0x3078, 0x309A, 0x307A},
+        {0x307B, 0x3099, 0x307C},
+        {0x307B, 0x309A, 0x307D},
+        {0x309D, 0x3099, 0x309E},
+        {0x30A6, 0x3099, 0x30F4},
+        {0x30AB, 0x3099, 0x30AC},
+        {0x30AD, 0x3099, 0x30AE},
+        {0x30AF, 0x3099, 0x30B0},
+        {0x30B1, 0x3099, 0x30B2},
+        {0x30B3, 0x3099, 0x30B4},
+        {0x30B5, 0x3099, 0x30B6},
+        {0x30B7, 0x3099, 0x30B8},
+        {0x30B9, 0x3099, 0x30BA},
+        {0x30BB, 0x3099, 0x30BC},
+        {0x30BD, 0x3099, 0x30BE},
+        {0x30BF, 0x3099, 0x30C0},
+        {0x30C1, 0x3099, 0x30C2},
+        {0x30C4, 0x3099, 0x30C5},
+        {0x30C6, 0x3099, 0x30C7},
+        {0x30C8, 0x3099, 0x30C9},
+        {0x30CF, 0x3099, 0x30D0},
+        {0x30CF, 0x309A, 0x30D1},
+        {0x30D2, 0x3099, 0x30D3},
+        {0x30D2, 0x309A, 0x30D4},
+        {0x30D5, 0x3099, 0x30D6},
+        {0x30D5, 0x309A, 0x30D7},
+        {0x30D8, 0x3099, 0x30D9},
+        {0x30D8, 0x309A, 0x30DA},
+        {0x30DB, 0x3099, 0x30DC},
+        {0x30DB, 0x309A, 0x30DD},
+        {0x30EF, 0x3099, 0x30F7},
+        {0x30F0, 0x3099, 0x30F8},
+        {0x30F1, 0x3099, 0x30F9},
+        {0x30F2, 0x3099, 0x30FA},
+        {0x30FD, 0x3099, 0x30FE},
+        {0x11099, 0x110BA, 0x1109A},
+        {0x1109B, 0x110BA, 0x1109C},
+        {0x110A5, 0x110BA, 0x110AB},
+        {0x11131, 0x11127, 0x1112E},
+        {0x11132, 0x11127, 0x1112F},
+        {0x11347, 0x1133E, 0x1134B},
+        {0x11347, 0x11357, 0x1134C},
+        {0x114B9, 0x114B0, 0x114BC},
+        {0x114B9, 0x114BA, 0x114BB},
+        {0x114B9, 0x114BD, 0x114BE},
+        {0x115B8, 0x115AF, 0x115BA},
+        {0x115B9, 0x115AF, 0x115BB},
+        {0x11935, 0x11930, 0x11938}
+};
+
+// Case folding: utf8_fold_records[utf8_fold_stage2[(utf8_fold_stage1[cp >> 7] << 7) | (cp & 127)]]
+// (stage1 ends after the last block with a folding; further code points fold to themselves)
+#define UTF8_FOLD_SHIFT 7
+
+typedef struct utf8_fold_record {
+    int32_t delta;       // simple folding: cp + delta
+    uint16_t fullOffset; // full folding, when it differs from the simple one: utf8_full_fold_data
+    uint16_t fullLength; // 0 when it does not
+} utf8_fold_record;
+
+static const utf8_fold_record utf8_fold_records[198] = {
+        {0, 0, 0},
+        {32, 0, 0},
+        {775, 0, 0},
+        {0, 0, 2},
+        {1, 0, 0},
+        {0, 2, 2},
+        {0, 4, 2},
+        {-121, 0, 0},
+        {-268, 0, 0},
+        {210, 0, 0},
+        {206, 0, 0},
+        {205, 0, 0},
+        {79, 0, 0},
+        {202, 0, 0},
+        {203, 0, 0},
+        {207, 0, 0},
+        {211, 0, 0},
+        {209, 0, 0},
+        {213, 0, 0},
+        {214, 0, 0},
+        {218, 0, 0},
+        {217, 0, 0},
+        {219, 0, 0},
+        {2, 0, 0},
+        {0, 6, 2},
+        {-97, 0, 0},
+        {-56, 0, 0},
+        {-130, 0, 0},
+        {10795, 0, 0},
+        {-163, 0, 0},
+        {10792, 0, 0},
+        {-195, 0, 0},
+        {69, 0, 0},
+        {71, 0, 0},
+        {116, 0, 0},
+        {38, 0, 0},
+        {37, 0, 0},
+        {64, 0, 0},
+        {63, 0, 0},
+        {0, 8, 3},
+        {0, 11, 3},
+        {8, 0, 0},
+        {-30, 0, 0},
+        {-25, 0, 0},
+        {-15, 0, 0},
+        {-22, 0, 0},
+        {-54, 0, 0},
+        {-48, 0, 0},
+        {-60, 0, 0},
+        {-64, 0, 0},
+        {-7, 0, 0},
+        {80, 0, 0},
+        {15, 0, 0},
+        {48, 0, 0},
+        {0, 14, 2},
+        {7264, 0, 0},
+        {-8, 0, 0},
+        {-6222, 0, 0},
+        {-6221, 0, 0},
+        {-6212, 0, 0},
+        {-6210, 0, 0},
+        {-6211, 0, 0},
+        {-6204, 0, 0},
+        {-6180, 0, 0},
+        {35267, 0, 0},
+        {-3008, 0, 0},
+        {0, 16, 2},
+        {0, 18, 2},
+        {0, 20, 2},
+        {0, 22, 2},
+        {0, 24, 2},
+        {-58, 0, 0},
+        {-7615, 26, 2},
+        {0, 28, 2},
+        {0, 30, 3},
+        {0, 33, 3},
+        {0, 36, 3},
+        {0, 39, 2},
+        {0, 41, 2},
+        {0, 43, 2},
+        {0, 45, 2},
+        {0, 47, 2},
+        {0, 49, 2},
+        {0, 51, 2},
+        {0, 53, 2},
+        {-8, 55, 2},
+        {-8, 57, 2},
+        {-8, 59, 2},
+        {-8, 61, 2},
+        {-8, 63, 2},
+        {-8, 65, 2},
+        {-8, 67, 2},
+        {-8, 69, 2},
+        {0, 71, 2},
+        {0, 73, 2},
+        {0, 75, 2},
+        {0, 77, 2},
+        {0, 79, 2},
+        {0, 81, 2},
+        {0, 83, 2},
+        {0, 85, 2},
+        {-8, 87, 2},
+        {-8, 89, 2},
+        {-8, 91, 2},
+        {-8, 93, 2},
+        {-8, 95, 2},
+        {-8, 97, 2},
+        {-8, 99, 2},
+        {-8, 101, 2},
+        {0, 103, 2},
+        {0, 105, 2},
+        {0, 107, 2},
+        {0, 109, 2},
+        {0, 111, 2},
+        {0, 113, 2},
+        {0, 115, 2},
+        {0, 117, 2},
+        {-8, 119, 2},
+        {-8, 121, 2},
+        {-8, 123, 2},
+        {-8, 125, 2},
+        {-8, 127, 2},
+        {-8, 129, 2},
+        {-8, 131, 2},
+        {-8, 133, 2},
+        {0, 135, 2},
+        {0, 137, 2},
+        {0, 139, 2},
+        {0, 141, 2},
+        {0, 143, 3},
+        {-74, 0, 0},
+        {-9, 146, 2},
+        {-7173, 0, 0},
+        {0, 148, 2},
+        {0, 150, 2},
+        {0, 152, 2},
+        {0, 154, 2},
+        {0, 156, 3},
+        {-86, 0, 0},
+        {-9, 159, 2},
+        {0, 161, 3},
+        {0, 164, 2},
+        {0, 166, 3},
+        {-100, 0, 0},
+        {0, 169, 3},
+        {0, 172, 2},
+        {0, 174, 2},
+        {0, 176, 3},
+        {-112, 0, 0},
+        {0, 179, 2},
+        {0, 181, 2},
+        {0, 183, 2},
+        {0, 185, 2},
+        {0, 187, 3},
+        {-128, 0, 0},
+        {-126, 0, 0},
+        {-9, 190, 2},
+        {-7517, 0, 0},
+        {-8383, 0, 0},
+        {-8262, 0, 0},
+        {28, 0, 0},
+        {16, 0, 0},
+        {26, 0, 0},
+        {-10743, 0, 0},
+        {-3814, 0, 0},
+        {-10727, 0, 0},
+        {-10780, 0, 0},
+        {-10749, 0, 0},
+        {-10783, 0, 0},
+        {-10782, 0, 0},
+        {-10815, 0, 0},
+        {-35332, 0, 0},
+        {-42280, 0, 0},
+        {-42308, 0, 0},
+        {-42319, 0, 0},
+        {-42315, 0, 0},
+        {-42305, 0, 0},
+        {-42258, 0, 0},
+        {-42282, 0, 0},
+        {-42261, 0, 0},
+        {928, 0, 0},
+        {-42307, 0, 0},
+        {-35384, 0, 0},
+        {-38864, 0, 0},
+        {0, 192, 2},
+        {0, 194, 2},
+        {0, 196, 2},
+        {0, 198, 3},
+        {0, 201, 3},
+        {0, 204, 2},
+        {0, 206, 2},
+        {0, 208, 2},
+        {0, 210, 2},
+        {0, 212, 2},
+        {0, 214, 2},
+        {40, 0, 0},
+        {39, 0, 0},
+        {34, 0, 0}
+};
+
+static const uint8_t utf8_fold_stage1[979] = {
+        1, 2, 3, 4, 5, 0, 6, 7, 8, 9, 10, 11, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 12, 0, 0, 0, 0, 0, 13, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 14, 0, 0, 15, 16, 17, 18,
+        0, 0, 19, 20, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 22, 23, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 24, 25, 26, 27, 0, 0, 0, 0, 0, 0, 28, 29, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 30, 0, 0, 0, 0, 0, 0, 0, 31, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 32, 33, 34, 35, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 36, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 37, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 38, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 39
+};
+
+static const uint8_t utf8_fold_stage2[5120] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 3,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 5, 0, 4, 0, 4, 0, 4, 0, 0, 4, 0, 4, 0, 4, 0, 4,
+        0, 4, 0, 4, 0, 4, 0, 4, 0, 6, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 7, 4, 0, 4, 0, 4, 0, 8,
+        0, 9, 4, 0, 4, 0, 10, 4, 0, 11, 11, 4, 0, 0, 12, 13, 14, 4, 0, 11, 15, 0, 16, 17, 4, 0, 0, 0, 16, 18, 0, 19,
+        4, 0, 4, 0, 4, 0, 20, 4, 0, 20, 0, 0, 4, 0, 20, 4, 0, 21, 21, 4, 0, 4, 0, 22, 4, 0, 0, 0, 4, 0, 0, 0,
+        0, 0, 0, 0, 23, 4, 0, 23, 4, 0, 23, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 24, 23, 4, 0, 4, 0, 25, 26, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        27, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 28, 4, 0, 29, 30, 0,
+        0, 4, 0, 31, 32, 33, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 34, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 4, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 34,
+        0, 0, 0, 0, 0, 0, 35, 0, 36, 36, 36, 0, 37, 0, 38, 38, 39, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 40, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 41, 42, 43, 0, 0, 0, 44, 45, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 46, 47, 0, 0, 48, 49, 0, 4, 0, 50, 4, 0, 0, 27, 27, 27,
+        51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        52, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 0, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53,
+        53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 54, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55,
+        55, 55, 55, 55, 55, 55, 0, 55, 0, 0, 0, 0, 0, 55, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 56, 56, 56, 56, 56, 56, 0, 0,
+        57, 58, 59, 60, 60, 61, 62, 63, 64, 0, 0, 0, 0, 0, 0, 0, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+        65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 0, 0, 65, 65, 65,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 66, 67, 68, 69, 70, 71, 0, 0, 72, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 56, 56, 56, 56, 56, 56, 56, 56, 0, 0, 0, 0, 0, 0, 0, 0, 56, 56, 56, 56, 56, 56, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 56, 56, 56, 56, 56, 56, 56, 56, 0, 0, 0, 0, 0, 0, 0, 0, 56, 56, 56, 56, 56, 56, 56, 56,
+        0, 0, 0, 0, 0, 0, 0, 0, 56, 56, 56, 56, 56, 56, 0, 0, 73, 0, 74, 0, 75, 0, 76, 0, 0, 56, 0, 56, 0, 56, 0, 56,
+        0, 0, 0, 0, 0, 0, 0, 0, 56, 56, 56, 56, 56, 56, 56, 56, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95, 96, 97, 98, 99, 100, 101, 102, 103, 104, 105, 106, 107, 108,
+        109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 0, 0, 125, 126, 127, 0, 128, 129, 56, 56, 130, 130, 131, 0, 132, 0,
+        0, 0, 133, 134, 135, 0, 136, 137, 138, 138, 138, 138, 139, 0, 0, 0, 0, 0, 140, 39, 0, 0, 141, 142, 56, 56, 143, 143, 0, 0, 0, 0,
+        0, 0, 144, 40, 145, 0, 146, 147, 56, 56, 148, 148, 50, 0, 0, 0, 0, 0, 149, 150, 151, 0, 152, 153, 154, 154, 155, 155, 156, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 157, 0, 0, 0, 158, 159, 0, 0, 0, 0, 0, 0, 160, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        161, 161, 161, 161, 161, 161, 161, 161, 161, 161, 161, 161, 161, 161, 161, 161, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 162, 162, 162, 162, 162, 162, 162, 162, 162, 162,
+        162, 162, 162, 162, 162, 162, 162, 162, 162, 162, 162, 162, 162, 162, 162, 162, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53,
+        53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 0, 163, 164, 165, 0, 0, 4, 0, 4, 0, 4, 0, 166, 167, 168, 169, 0, 4, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 170, 170,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 4, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 0, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 4, 0, 171, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 0, 0, 0, 4, 0, 172, 0, 0, 4, 0, 4, 0, 0, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 173, 174, 175, 176, 173, 0, 177, 178, 179, 180, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0,
+        4, 0, 4, 0, 47, 181, 182, 4, 0, 4, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 4, 0, 4, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183,
+        183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183,
+        183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183, 183,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        184, 185, 186, 187, 188, 189, 189, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 190, 191, 192, 193, 194, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195,
+        195, 195, 195, 195, 195, 195, 195, 195, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195,
+        195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 195, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 196, 196, 196, 196, 196, 196, 196, 196, 196, 196, 196, 0, 196, 196, 196, 196,
+        196, 196, 196, 196, 196, 196, 196, 196, 196, 196, 196, 0, 196, 196, 196, 196, 196, 196, 196, 0, 196, 196, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37,
+        37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197, 197,
+        197, 197, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static const uint32_t utf8_full_fold_data[216] = {
+        0x0073, 0x0073, 0x0069, 0x0307, 0x02BC, 0x006E, 0x006A, 0x030C, 0x03B9, 0x0308, 0x0301, 0x03C5,
+        0x0308, 0x0301, 0x0565, 0x0582, 0x0068, 0x0331, 0x0074, 0x0308, 0x0077, 0x030A, 0x0079, 0x030A,
+        0x0061, 0x02BE, 0x0073, 0x0073, 0x03C5, 0x0313, 0x03C5, 0x0313, 0x0300, 0x03C5, 0x0313, 0x0301,
+        0x03C5, 0x0313, 0x0342, 0x1F00, 0x03B9, 0x1F01, 0x03B9, 0x1F02, 0x03B9, 0x1F03, 0x03B9, 0x1F04,
+        0x03B9, 0x1F05, 0x03B9, 0x1F06, 0x03B9, 0x1F07, 0x03B9, 0x1F00, 0x03B9, 0x1F01, 0x03B9, 0x1F02,
+        0x03B9, 0x1F03, 0x03B9, 0x1F04, 0x03B9, 0x1F05, 0x03B9, 0x1F06, 0x03B9, 0x1F07, 0x03B9, 0x1F20,
+        0x03B9, 0x1F21, 0x03B9, 0x1F22, 0x03B9, 0x1F23, 0x03B9, 0x1F24, 0x03B9, 0x1F25, 0x03B9, 0x1F26,
+        0x03B9, 0x1F27, 0x03B9, 0x1F20, 0x03B9, 0x1F21, 0x03B9, 0x1F22, 0x03B9, 0x1F23, 0x03B9, 0x1F24,
+        0x03B9, 0x1F25, 0x03B9, 0x1F26, 0x03B9, 0x1F27, 0x03B9, 0x1F60, 0x03B9, 0x1F61, 0x03B9, 0x1F62,
+        0x03B9, 0x1F63, 0x03B9, 0x1F64, 0x03B9, 0x1F65, 0x03B9, 0x1F66, 0x03B9, 0x1F67, 0x03B9, 0x1F60,
+        0x03B9, 0x1F61, 0x03B9, 0x1F62, 0x03B9, 0x1F63, 0x03B9, 0x1F64, 0x03B9, 0x1F65, 0x03B9, 0x1F66,
+        0x03B9, 0x1F67, 0x03B9, 0x1F70, 0x03B9, 0x03B1, 0x03B9, 0x03AC, 0x03B9, 0x03B1, 0x0342, 0x03B1,
+        0x0342, 0x03B9, 0x03B1, 0x03B9, 0x1F74, 0x03B9, 0x03B7, 0x03B9, 0x03AE, 0x03B9, 0x03B7, 0x0342,
+        0x03B7, 0x0342, 0x03B9, 0x03B7, 0x03B9, 0x03B9, 0x0308, 0x0300, 0x03B9, 0x0342, 0x03B9, 0x0308,
+        0x0342, 0x03C5, 0x0308, 0x0300, 0x03C1, 0x0313, 0x03C5, 0x0342, 0x03C5, 0x0308, 0x0342, 0x1F7C,
+        0x03B9, 0x03C9, 0x03B9, 0x03CE, 0x03B9, 0x03C9, 0x0342, 0x03C9, 0x0342, 0x03B9, 0x03C9, 0x03B9,
+        0x0066, 0x0066, 0x0066, 0x0069, 0x0066, 0x006C, 0x0066, 0x0066, 0x0069, 0x0066, 0x0066, 0x006C,
+        0x0073, 0x0074, 0x0574, 0x0576, 0x0574, 0x0565, 0x0574, 0x056B, 0x057E, 0x0576, 0x0574, 0x056D
+};
+
+// Grapheme clusters: utf8_gcb_stage2[(utf8_gcb_stage1[cp >> 7] << 7) | (cp & 127)] is the
+// Grapheme_Cluster_Break value, or'ed with UTF8_GCB_PICTOGRAPHIC for Extended_Pictographic
+// (stage1 ends after the last block that is not all Other)
+#define UTF8_GCB_SHIFT 7
+#define UTF8_GCB_OTHER 0
+#define UTF8_GCB_CR 1
+#define UTF8_GCB_LF 2
+#define UTF8_GCB_CONTROL 3
+#define UTF8_GCB_EXTEND 4
+#define UTF8_GCB_ZWJ 5
+#define UTF8_GCB_RI 6
+#define UTF8_GCB_PREPEND 7
+#define UTF8_GCB_SPACINGMARK 8
+#define UTF8_GCB_L 9
+#define UTF8_GCB_V 10
+#define UTF8_GCB_T 11
+#define UTF8_GCB_LV 12
+#define UTF8_GCB_LVT 13
+#define UTF8_GCB_PICTOGRAPHIC 0x10
+
+static const uint8_t utf8_gcb_stage1[7200] = {
+        1, 2, 0, 0, 0, 0, 3, 0, 0, 4, 0, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,
+        26, 27, 28, 29, 0, 0, 30, 0, 0, 0, 0, 0, 0, 0, 31, 32, 33, 34, 35, 0, 36, 37, 38, 39, 40, 41, 0, 42, 0, 0, 0, 0,
+        43, 44, 45, 46, 0, 0, 47, 48, 0, 49, 0, 50, 51, 52, 53, 54, 0, 0, 55, 0, 0, 0, 56, 0, 0, 57, 58, 59, 0, 0, 0, 0,
+        60, 61, 0, 0, 0, 62, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 63, 64, 0, 0, 65, 66, 67, 68, 69, 70, 0, 71, 72, 73, 74, 75, 76, 77, 78, 72,
+        73, 74, 75, 76, 77, 78, 72, 73, 74, 75, 76, 77, 78, 72, 73, 74, 75, 76, 77, 78, 72, 73, 74, 75, 76, 77, 78, 72, 73, 74, 75, 76,
+        77, 78, 72, 73, 74, 75, 76, 77, 78, 72, 73, 74, 75, 76, 77, 78, 72, 73, 74, 75, 76, 77, 78, 72, 73, 74, 75, 76, 77, 78, 72, 73,
+        74, 75, 76, 77, 78, 72, 73, 74, 75, 76, 77, 78, 72, 73, 74, 79, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 80, 0, 0, 0, 0, 0, 81, 82, 0, 83,
+        0, 0, 0, 84, 0, 85, 86, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 87, 88, 0, 0, 0, 0, 89, 0, 0, 90, 91, 92,
+        93, 94, 95, 96, 97, 98, 99, 0, 100, 101, 0, 102, 103, 104, 105, 0, 106, 0, 107, 108, 109, 110, 0, 0, 111, 112, 113, 114, 0, 115, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 116, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 117, 118, 0, 0, 0, 0, 0, 0, 0, 119, 120,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 121, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 122, 0,
+        0, 0, 123, 124, 125, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 126, 127, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        128, 0, 118, 0, 0, 129, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 130, 131, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        132, 132, 133, 134, 135, 132, 132, 136, 132, 132, 137, 132, 138, 132, 139, 140, 141, 142, 143, 132, 132, 132, 0, 0, 132, 132, 132, 132, 132, 132, 132, 144,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        145, 146, 147, 148, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146
+};
+
+static const uint8_t utf8_gcb_stage2[19072] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 2, 3, 3, 1, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3,
+        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 3, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 4,
+        0, 4, 4, 0, 4, 4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        7, 7, 7, 7, 7, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 3, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 7, 0, 4,
+        4, 4, 4, 4, 4, 0, 0, 4, 4, 0, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 0, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 0, 4, 4, 4, 0, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 7, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 8, 4, 0, 8, 8,
+        8, 4, 4, 4, 4, 4, 4, 4, 4, 8, 8, 8, 8, 4, 8, 8, 0, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 4, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 4, 8,
+        8, 4, 4, 4, 4, 0, 0, 8, 8, 0, 0, 8, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0,
+        0, 4, 4, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 8, 8,
+        8, 4, 4, 0, 0, 0, 0, 4, 4, 0, 0, 4, 4, 4, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 4, 4, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 8, 8,
+        8, 4, 4, 4, 4, 4, 0, 4, 4, 8, 0, 8, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4,
+        0, 4, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 4, 4,
+        8, 4, 4, 4, 4, 0, 0, 8, 8, 0, 0, 8, 8, 4, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 8,
+        4, 8, 8, 0, 0, 0, 8, 8, 8, 0, 8, 8, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 8, 8, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 4, 4,
+        4, 8, 8, 8, 8, 0, 4, 4, 4, 0, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 4, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 8, 4,
+        8, 8, 4, 8, 8, 0, 4, 8, 8, 0, 8, 8, 4, 4, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 4, 8,
+        8, 4, 4, 4, 4, 0, 8, 8, 8, 0, 8, 8, 8, 4, 7, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 4, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 4, 8, 8, 4, 4, 4, 0, 4, 0, 8, 8, 8, 8, 8, 8, 8, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 8, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 8, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 4, 0, 4, 0, 0, 0, 0, 8, 8,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 8,
+        4, 4, 4, 4, 4, 0, 4, 4, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 0, 4, 4, 8, 8, 4, 4, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 4, 4, 0, 0, 0, 0, 4, 4,
+        4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 0, 8, 4, 4, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+        9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+        9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+        10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+        10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+        10, 10, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+        11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+        11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 8,
+        8, 8, 8, 8, 8, 8, 4, 8, 8, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 3, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 8, 8, 8, 8, 4, 4, 8, 8, 8, 0, 0, 0, 0, 8, 8, 4, 8, 8, 8, 8, 8, 8, 4, 4, 4, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 8, 8, 4, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 4, 8, 4, 4, 4, 4, 4, 4, 4, 0,
+        4, 0, 4, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 8, 8, 8, 8, 8, 8, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 4, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 8, 4, 8, 8, 8,
+        8, 8, 4, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 8, 4, 4, 4, 4, 8, 8, 4, 4, 8, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 4, 8, 4, 4, 8, 8, 8, 4, 8, 4, 4, 4, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 8, 8, 8, 8, 8, 8, 8, 8, 4, 4, 4, 4, 4, 4, 4, 4, 8, 8, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 8, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 4, 0, 0, 8, 4, 4, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 4, 5, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 0, 0, 0, 0, 16, 16, 16, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 0,
+        16, 16, 16, 16, 16, 16, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 0, 16, 0, 16, 0, 0, 0, 0, 0, 0, 16, 0, 0,
+        0, 16, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 16, 0, 0, 16, 0, 0, 0, 0, 16, 0, 16, 0, 0, 0, 0, 16, 16, 16, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 16, 16, 16, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 16, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 16, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 8, 8, 4, 4, 8, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+        8, 8, 8, 8, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 0, 0, 0,
+        4, 4, 4, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 8, 8, 4, 4, 4, 4, 8, 8, 4, 4, 8, 8,
+        8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 8, 8, 4, 4, 8, 8, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 4, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 4, 4, 4, 0, 0, 4, 4, 0, 0, 0, 0, 0, 4, 4,
+        0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 4, 4, 8, 8, 0, 0, 0, 0, 0, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 8, 8, 4, 8, 8, 4, 8, 8, 0, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+        13, 13, 13, 13, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+        10, 10, 10, 10, 10, 10, 10, 0, 0, 0, 0, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+        11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0,
+        0, 4, 4, 4, 0, 4, 4, 0, 0, 0, 0, 0, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 0, 0, 0, 0, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        8, 4, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4,
+        4, 4, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 8, 4, 4, 4, 4, 8, 8, 4, 4, 0, 0, 7, 0, 0,
+        0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 8, 4, 4, 4, 4, 4, 4, 4, 4, 4, 8,
+        8, 0, 7, 7, 0, 0, 0, 0, 0, 4, 4, 4, 4, 0, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 8, 4, 4, 4, 8, 8, 4, 8, 4, 4, 0, 0, 0, 0, 0, 0, 4, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4,
+        8, 8, 8, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 4, 8,
+        4, 8, 8, 8, 8, 0, 0, 8, 8, 0, 0, 8, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 8, 8, 0, 0, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 8, 4, 4, 4, 4, 4, 4, 4, 4,
+        8, 8, 4, 4, 4, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 8, 8, 4, 4, 4, 4, 4, 4, 8, 4, 8, 8, 4, 8, 4,
+        4, 8, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 8, 8, 4, 4, 4, 4, 0, 0, 8, 8, 8, 8, 4, 4, 8, 4,
+        4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 8, 4, 4, 4, 4, 4, 4, 4, 4, 8, 8, 4, 8, 4,
+        4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 8, 4, 8, 8, 4, 4, 4, 4, 4, 4, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4,
+        0, 0, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 8, 4, 4, 4, 4, 4, 4, 4, 4, 4, 8, 4, 4, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 8, 8, 8, 8, 8, 0, 8, 8, 0, 0, 4, 4, 8, 4, 7,
+        8, 7, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 8, 4, 4, 4, 4, 0, 0, 4, 4, 8, 8, 8, 8,
+        4, 0, 0, 0, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 8, 7, 4, 4, 4, 4, 0,
+        0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 8, 8, 4, 4, 4, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 7, 7, 7, 7, 7, 7, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 8, 4, 4, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 4, 4, 4, 4, 4, 4, 4, 0, 4, 4, 4, 4, 4, 4, 8, 4,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 0, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4, 4, 8, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 0, 0, 0, 4, 0, 4, 4, 0, 4,
+        4, 4, 4, 4, 4, 4, 7, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 8, 8, 8, 0, 4, 4, 0, 8, 8, 4, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 3, 3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+        8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+        8, 8, 8, 8, 8, 8, 8, 8, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0,
+        3, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 4, 8, 4, 4, 4, 0, 0, 0, 8, 4, 4, 4, 4, 4, 3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4,
+        4, 4, 4, 0, 0, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4,
+        0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        4, 4, 4, 4, 4, 4, 4, 0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 4, 4, 4, 4, 4,
+        4, 4, 0, 4, 4, 0, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+        0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 0, 16, 16, 16, 16,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 4, 4, 4, 4, 4,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 0, 0,
+        0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 0, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 0, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+        16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 0, 0,
+        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3
+};
+
+#endif // UNICODE_TABLES_H